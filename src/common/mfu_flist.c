@@ -18,6 +18,10 @@
 #include <time.h> /* asctime / localtime */
 #include <regex.h>
 
+#ifdef HAVE_LIBATTR
+#include <attr/libattr.h>
+#endif /* HAVE_LIBATTR */
+
 /* These headers are needed to query the Lustre MDS for stat
  * information.  This information may be incomplete, but it
  * is faster than a normal stat, which requires communication
@@ -67,6 +71,12 @@ mfu_walk_opts_t* mfu_walk_opts_new(void)
     /* Don't dereference symbolic links by default */
     opts->dereference = 0;
 
+    /* Don't capture xattrs by default */
+    opts->xattrs = XATTR_COPY_NONE;
+
+    /* Walk with all ranks by default */
+    opts->reader_ranks = 0;
+
     return opts;
 }
 
@@ -117,15 +127,21 @@ int mfu_flist_compute_depth(const char* path)
     return depth;
 }
 
-/* return number of bytes needed to pack element */
-static size_t list_elem_pack2_size(int detail, uint64_t chars, const elem_t* elem)
+/* return number of bytes needed to pack element,
+ * xchars is the number of bytes reserved for xattrs */
+static size_t list_elem_pack2_size(int detail, uint64_t chars, uint64_t xchars, const elem_t* elem)
 {
     size_t size;
     if (detail) {
-        size = 2 * 4 + chars + 0 * 4 + 10 * 8;
+        size = 3 * 4 + chars + 0 * 4 + 10 * 8;
     }
     else {
-        size = 2 * 4 + chars + 1 * 4;
+        size = 3 * 4 + chars + 1 * 4;
+    }
+
+    /* add space for size of xattrs and the xattrs themselves */
+    if (xchars > 0) {
+        size += 4 + xchars;
     }
 
     #ifdef DAOS_SUPPORT
@@ -138,7 +154,7 @@ static size_t list_elem_pack2_size(int detail, uint64_t chars, const elem_t* ele
 }
 
 /* pack element into buffer and return number of bytes written */
-static size_t list_elem_pack2(void* buf, int detail, uint64_t chars, const elem_t* elem)
+static size_t list_elem_pack2(void* buf, int detail, uint64_t chars, uint64_t xchars, const elem_t* elem)
 {
     /* set pointer to start of buffer */
     char* start = (char*) buf;
@@ -150,6 +166,9 @@ static size_t list_elem_pack2(void* buf, int detail, uint64_t chars, const elem_
     /* copy in length of file name field */
     mfu_pack_uint32(&ptr, (uint32_t) chars);
 
+    /* copy in length of xattrs field */
+    mfu_pack_uint32(&ptr, (uint32_t) xchars);
+
     /* copy in file name */
     char* file = elem->file;
     if (file != NULL) {
@@ -181,6 +200,17 @@ static size_t list_elem_pack2(void* buf, int detail, uint64_t chars, const elem_
         mfu_pack_uint32(&ptr, elem->type);
     }
 
+    if (xchars > 0) {
+        /* copy in xattrs, a size of 0 means they were not captured */
+        uint32_t xattrs_size = 0;
+        if (elem->xattrs != NULL) {
+            xattrs_size = (uint32_t) elem->xattrs_size;
+            memcpy(ptr + 4, elem->xattrs, xattrs_size);
+        }
+        mfu_pack_uint32(&ptr, xattrs_size);
+        ptr += xchars;
+    }
+
     size_t bytes = (size_t)(ptr - start);
     return bytes;
 }
@@ -200,6 +230,10 @@ static size_t list_elem_unpack2(const void* buf, elem_t* elem)
     uint32_t chars;
     mfu_unpack_uint32(&ptr, &chars);
 
+    /* extract length of xattrs field */
+    uint32_t xchars;
+    mfu_unpack_uint32(&ptr, &xchars);
+
     /* get name and advance pointer */
     const char* file = ptr;
     ptr += chars;
@@ -240,6 +274,20 @@ static size_t list_elem_unpack2(const void* buf, elem_t* elem)
         elem->type = (mfu_filetype) type;
     }
 
+    /* extract xattrs if any */
+    elem->xattrs      = NULL;
+    elem->xattrs_size = 0;
+    if (xchars > 0) {
+        uint32_t xattrs_size;
+        mfu_unpack_uint32(&ptr, &xattrs_size);
+        if (xattrs_size > 0) {
+            elem->xattrs = (char*) MFU_MALLOC((size_t) xattrs_size);
+            memcpy(elem->xattrs, ptr, (size_t) xattrs_size);
+            elem->xattrs_size = (uint64_t) xattrs_size;
+        }
+        ptr += xchars;
+    }
+
     size_t bytes = (size_t)(ptr - start);
     return bytes;
 }
@@ -344,6 +392,15 @@ static void list_insert_copy(flist_t* flist, elem_t* src)
     elem->ctime_nsec = src->ctime_nsec;
     elem->size       = src->size;
 
+    /* copy xattrs if we have them */
+    elem->xattrs      = NULL;
+    elem->xattrs_size = 0;
+    if (src->xattrs != NULL) {
+        elem->xattrs = (char*) MFU_MALLOC((size_t) src->xattrs_size);
+        memcpy(elem->xattrs, src->xattrs, (size_t) src->xattrs_size);
+        elem->xattrs_size = src->xattrs_size;
+    }
+
     /* append element to tail of linked list */
     mfu_flist_insert_elem(flist, elem);
 
@@ -365,6 +422,10 @@ void mfu_flist_insert_stat(flist_t* flist, const char* fpath, mode_t mode, const
     /* set file type */
     elem->type = mfu_flist_mode_to_filetype(mode);
 
+    /* xattrs are attached later if requested */
+    elem->xattrs      = NULL;
+    elem->xattrs_size = 0;
+
     /* copy stat info */
     if (sb != NULL) {
         elem->detail = 1;
@@ -406,6 +467,7 @@ static void list_delete(flist_t* flist)
     while (current != NULL) {
         elem_t* next = current->next;
         mfu_free(&current->file);
+        mfu_free(&current->xattrs);
         mfu_free(&current);
         current = next;
     }
@@ -439,6 +501,7 @@ static void list_compute_summary(flist_t* flist)
     flist->max_file_name  = 0;
     flist->max_user_name  = 0;
     flist->max_group_name = 0;
+    flist->max_xattrs     = 0;
     flist->min_depth      = 0;
     flist->max_depth      = 0;
     flist->total_files    = 0;
@@ -472,6 +535,7 @@ static void list_compute_summary(flist_t* flist)
     int min_depth = -1;
     int max_depth = -1;
     uint64_t max_name = 0;
+    uint64_t max_xattrs = 0;
     elem_t* current = flist->list_head;
     while (current != NULL) {
         if (current->file != NULL) {
@@ -481,6 +545,10 @@ static void list_compute_summary(flist_t* flist)
             }
 	}
 
+        if (current->xattrs != NULL && current->xattrs_size > max_xattrs) {
+            max_xattrs = current->xattrs_size;
+        }
+
         int depth = current->depth;
         if (depth < min_depth || min_depth == -1) {
             min_depth = depth;
@@ -500,6 +568,9 @@ static void list_compute_summary(flist_t* flist)
     uint64_t global_max_name;
     MPI_Allreduce(&max_name, &global_max_name, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
 
+    uint64_t global_max_xattrs;
+    MPI_Allreduce(&max_xattrs, &global_max_xattrs, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
     /* since at least one rank has an item and max will be -1 on ranks
      * without an item, set our min to global max if we have no items,
      * this will ensure that our contribution is >= true global min */
@@ -511,6 +582,7 @@ static void list_compute_summary(flist_t* flist)
 
     /* set summary values */
     flist->max_file_name = global_max_name;
+    flist->max_xattrs = global_max_xattrs;
     flist->min_depth = global_min_depth;
     flist->max_depth = global_max_depth;
 
@@ -541,6 +613,7 @@ mfu_flist mfu_flist_new()
 
     flist->detail = 0;
     flist->total_files = 0;
+    flist->max_xattrs = 0;
 
     /* initialize linked list */
     flist->list_count = 0;
@@ -846,6 +919,31 @@ uint64_t mfu_flist_file_get_perm(mfu_flist bflist, uint64_t idx) {
 void *mfu_flist_file_get_acl(mfu_flist bflist, uint64_t idx, ssize_t *acl_size, char *type)
 {
     flist_t* flist = (flist_t*) bflist;
+
+    /* use xattrs captured during the walk if we have them, unless
+     * libattr could have left this name out of the captured set */
+    size_t xattrs_size;
+    const void* xattrs = mfu_flist_file_get_xattrs(bflist, idx, &xattrs_size);
+    if (xattrs != NULL && mfu_xattrs_select(type, XATTR_USE_LIBATTR)) {
+        *acl_size = 0;
+
+        const char* name;
+        const void* xval;
+        size_t xval_size;
+        size_t pos = 0;
+        while ((pos = mfu_xattrs_next(xattrs, xattrs_size, pos, &name, &xval, &xval_size)) != 0) {
+            if (strcmp(name, type) == 0) {
+                void* val = MFU_MALLOC(xval_size + 1);
+                memcpy(val, xval, xval_size);
+                *acl_size = (ssize_t) xval_size;
+                return val;
+            }
+        }
+
+        /* item has no value for this name */
+        return NULL;
+    }
+
     const char* filename = mfu_flist_file_get_name(flist, idx);
     size_t val_bufsize = 1024;
     void* val = (void*) MFU_MALLOC(val_bufsize);
@@ -885,6 +983,265 @@ void *mfu_flist_file_get_acl(mfu_flist bflist, uint64_t idx, ssize_t *acl_size,
 }
 #endif
 
+/* return 1 if xattr name passes filter, 0 otherwise */
+int mfu_xattrs_select(const char* name, attr_copy_t filter)
+{
+    if (filter == XATTR_COPY_NONE || filter == XATTR_COPY_INVAL) {
+        return 0;
+    }
+
+    /* cached digests describe a particular inode, never copy them */
+    if (strcmp(name, MFU_DIGEST_XATTR) == 0) {
+        return 0;
+    }
+
+    if (filter == XATTR_USE_LIBATTR) {
+#ifdef HAVE_LIBATTR
+        if (attr_copy_action(name, NULL) == ATTR_ACTION_SKIP) {
+            return 0;
+        }
+#endif /* HAVE_LIBATTR */
+    } else if (filter == XATTR_SKIP_LUSTRE) {
+        /* ignore xattrs lustre treats specially */
+        /* list from lustre source file lustre_idl.h */
+        if (    strncmp(name,"lustre.",strlen("lustre.")) == 0 ||
+                strcmp(name,"trusted.som") == 0 || strcmp(name,"trusted.lov") == 0 ||
+                strcmp(name,"trusted.lma") == 0 || strcmp(name,"trusted.lmv") == 0 ||
+                strcmp(name,"trusted.dmv") == 0 || strcmp(name,"trusted.link") == 0 ||
+                strcmp(name,"trusted.fid") == 0 || strcmp(name,"trusted.version") == 0 ||
+                strcmp(name,"trusted.hsm") == 0 || strcmp(name,"trusted.lfsck_bitmap") == 0 ||
+                strcmp(name,"trusted.dummy") == 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* xattrs are packed into a buffer as a uint32_t count of pairs
+ * followed by that many records of:
+ *   uint32_t length of name including terminating NUL
+ *   name
+ *   uint32_t length of value
+ *   value
+ * integers are in network byte order */
+int mfu_xattrs_read(
+    const char* path,
+    attr_copy_t filter,
+    int dereference,
+    mfu_file_t* mfu_file,
+    void** pbuf,
+    size_t* psize)
+{
+    /* assume that we'll succeed */
+    int rc = 0;
+
+    /* start with an empty set */
+    size_t bufsize = 4;
+    char* buf = (char*) MFU_MALLOC(bufsize);
+    uint32_t count = 0;
+
+#if DCOPY_USE_XATTRS
+    /* ask for size of name list, then read the list,
+     * retry if the list grows in between */
+    char* list = NULL;
+    ssize_t list_size = 0;
+    while (1) {
+        errno = 0;
+        if (dereference) {
+            list_size = mfu_file_listxattr(path, NULL, 0, mfu_file);
+        } else {
+            list_size = mfu_file_llistxattr(path, NULL, 0, mfu_file);
+        }
+        if (list_size <= 0) {
+            break;
+        }
+
+        mfu_free(&list);
+        list = (char*) MFU_MALLOC((size_t) list_size);
+
+        ssize_t got;
+        if (dereference) {
+            got = mfu_file_listxattr(path, list, (size_t) list_size, mfu_file);
+        } else {
+            got = mfu_file_llistxattr(path, list, (size_t) list_size, mfu_file);
+        }
+        if (got < 0 && errno == ERANGE) {
+            continue;
+        }
+        list_size = got;
+        break;
+    }
+
+    if (list_size < 0) {
+        if (errno != ENOTSUP) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to get list of extended attributes on `%s' llistxattr() (errno=%d %s)",
+                path, errno, strerror(errno)
+               );
+            rc = -1;
+        }
+        list_size = 0;
+    }
+
+    /* read value of each name that passes the filter */
+    char* name = list;
+    while (name != NULL && name < list + list_size) {
+        size_t namelen = strlen(name) + 1;
+        if (mfu_xattrs_select(name, filter)) {
+            /* get size of value, then the value itself */
+            void* val = NULL;
+            ssize_t val_size;
+            while (1) {
+                errno = 0;
+                if (dereference) {
+                    val_size = mfu_file_getxattr(path, name, NULL, 0, mfu_file);
+                } else {
+                    val_size = mfu_file_lgetxattr(path, name, NULL, 0, mfu_file);
+                }
+                if (val_size <= 0) {
+                    break;
+                }
+
+                mfu_free(&val);
+                val = MFU_MALLOC((size_t) val_size);
+
+                ssize_t got;
+                if (dereference) {
+                    got = mfu_file_getxattr(path, name, val, (size_t) val_size, mfu_file);
+                } else {
+                    got = mfu_file_lgetxattr(path, name, val, (size_t) val_size, mfu_file);
+                }
+                if (got < 0 && errno == ERANGE) {
+                    continue;
+                }
+                val_size = got;
+                break;
+            }
+
+            if (val_size >= 0) {
+                /* append name and value to buffer */
+                size_t need = bufsize + 4 + namelen + 4 + (size_t) val_size;
+                char* newbuf = (char*) MFU_MALLOC(need);
+                memcpy(newbuf, buf, bufsize);
+                mfu_free(&buf);
+                buf = newbuf;
+
+                char* ptr = buf + bufsize;
+                mfu_pack_uint32(&ptr, (uint32_t) namelen);
+                memcpy(ptr, name, namelen);
+                ptr += namelen;
+                mfu_pack_uint32(&ptr, (uint32_t) val_size);
+                if (val_size > 0) {
+                    memcpy(ptr, val, (size_t) val_size);
+                }
+
+                bufsize = need;
+                count++;
+            } else if (errno == ENOATTR) {
+                /* source object no longer has this attribute,
+                 * maybe deleted out from under us, ignore but print warning */
+                MFU_LOG(MFU_LOG_WARN, "Attribute does not exist for name=%s on `%s' lgetxattr() (errno=%d %s)",
+                    name, path, errno, strerror(errno)
+                   );
+            } else {
+                MFU_LOG(MFU_LOG_ERR, "Failed to get value for name=%s on `%s' lgetxattr() (errno=%d %s)",
+                    name, path, errno, strerror(errno)
+                   );
+                rc = -1;
+            }
+
+            mfu_free(&val);
+        }
+
+        /* jump to next name */
+        name += namelen;
+    }
+
+    mfu_free(&list);
+#endif /* DCOPY_USE_XATTRS */
+
+    /* record number of pairs at the front of the buffer */
+    char* ptr = buf;
+    mfu_pack_uint32(&ptr, count);
+
+    *pbuf  = buf;
+    *psize = bufsize;
+    return rc;
+}
+
+size_t mfu_xattrs_next(
+    const void* buf,
+    size_t size,
+    size_t pos,
+    const char** name,
+    const void** val,
+    size_t* val_size)
+{
+    /* skip the count on the first call */
+    if (pos == 0) {
+        pos = 4;
+    }
+
+    /* check that there is a complete record at this position */
+    if (buf == NULL || pos + 4 > size) {
+        return 0;
+    }
+
+    const char* ptr = (const char*) buf + pos;
+    uint32_t namelen;
+    mfu_unpack_uint32(&ptr, &namelen);
+    *name = ptr;
+    ptr += namelen;
+
+    uint32_t vallen;
+    mfu_unpack_uint32(&ptr, &vallen);
+    *val = ptr;
+    *val_size = (size_t) vallen;
+    ptr += vallen;
+
+    return (size_t)(ptr - (const char*) buf);
+}
+
+const void* mfu_flist_file_get_xattrs(mfu_flist bflist, uint64_t idx, size_t* size)
+{
+    *size = 0;
+    flist_t* flist = (flist_t*) bflist;
+    elem_t* elem = list_get_elem(flist, idx);
+    if (elem != NULL && elem->xattrs != NULL) {
+        *size = (size_t) elem->xattrs_size;
+        return elem->xattrs;
+    }
+    return NULL;
+}
+
+void mfu_flist_capture_xattrs(flist_t* flist, const char* path, attr_copy_t filter, int dereference, mfu_file_t* mfu_file)
+{
+    /* only capture xattrs on items we just inserted */
+    elem_t* elem = flist->list_tail;
+    if (elem == NULL) {
+        return;
+    }
+
+    void* buf;
+    size_t size;
+    if (mfu_xattrs_read(path, filter, dereference, mfu_file, &buf, &size) != 0) {
+        /* leave the item without xattrs so that they are read again later */
+        mfu_free(&buf);
+        return;
+    }
+
+    /* every packed item reserves space for the largest set of xattrs,
+     * so leave unusually large sets to be read when they are needed */
+    if (size > MFU_FLIST_XATTRS_MAX) {
+        mfu_free(&buf);
+        return;
+    }
+
+    elem->xattrs      = (char*) buf;
+    elem->xattrs_size = (uint64_t) size;
+}
+
 uint64_t mfu_flist_file_get_uid(mfu_flist bflist, uint64_t idx)
 {
     uint64_t ret = (uint64_t) - 1;
@@ -1300,7 +1657,7 @@ void mfu_flist_file_copy(mfu_flist bsrc, uint64_t idx, mfu_flist bdst)
 size_t mfu_flist_file_pack_size(mfu_flist bflist)
 {
     flist_t* flist = (flist_t*) bflist;
-    size_t size = list_elem_pack2_size(flist->detail, flist->max_file_name, NULL);
+    size_t size = list_elem_pack2_size(flist->detail, flist->max_file_name, flist->max_xattrs, NULL);
     return size;
 }
 
@@ -1310,7 +1667,9 @@ size_t mfu_flist_file_pack(void* buf, mfu_flist bflist, uint64_t idx)
     flist_t* flist = (flist_t*) bflist;
     elem_t* elem = list_get_elem(flist, idx);
     if (elem != NULL) {
-        size_t size = list_elem_pack2(buf, flist->detail, flist->max_file_name, elem);
+        /* reserve only the space this item needs for its own xattrs */
+        uint64_t xchars = (elem->xattrs != NULL) ? elem->xattrs_size : 0;
+        size_t size = list_elem_pack2(buf, flist->detail, flist->max_file_name, xchars, elem);
         return size;
     }
     return 0;
@@ -1350,6 +1709,8 @@ uint64_t mfu_flist_file_create(mfu_flist bflist)
     elem->ctime      = 0;
     elem->ctime_nsec = 0;
     elem->size       = 0;
+    elem->xattrs      = NULL;
+    elem->xattrs_size = 0;
 
     /* for DAOS */
 #ifdef DAOS_SUPPORT
@@ -1522,8 +1883,8 @@ mfu_flist mfu_flist_remap(mfu_flist list, mfu_flist_map_fn map, const void* args
                     idx++;
                 }
 
-                /* post our send */
-                int sendbytes = (int)(elem_count * (uint64_t)pack_size);
+                /* post our send, items vary in size */
+                int sendbytes = (int)(ptr - sendbuf);
                 MPI_Issend(sendbuf, sendbytes, MPI_BYTE, dst, 0, MPI_COMM_WORLD, &request[k]);
                 k++;
             }
@@ -1731,10 +2092,6 @@ void mfu_flist_print(mfu_flist flist)
     int* counts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
     int* disps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
 
-    /* tell rank 0 where the data is coming from */
-    int bytes = num * (int)pack_size;
-    MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
     /* pack items into sendbuf */
     idx = 0;
     char* ptr = (char*) sendbuf;
@@ -1746,6 +2103,10 @@ void mfu_flist_print(mfu_flist flist)
         idx++;
     }
 
+    /* tell rank 0 where the data is coming from */
+    int bytes = (int)(ptr - (char*) sendbuf);
+    MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
     /* compute displacements and total bytes */
     int recvbytes = 0;
     if (rank == 0) {
@@ -1769,8 +2130,7 @@ void mfu_flist_print(mfu_flist flist)
         ptr = (char*) recvbuf;
         char* end = ptr + recvbytes;
         while (ptr < end) {
-            mfu_flist_file_unpack(ptr, tmplist);
-            ptr += pack_size;
+            ptr += mfu_flist_file_unpack(ptr, tmplist);
         }
     }
 
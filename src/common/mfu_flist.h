@@ -309,10 +309,12 @@ mfu_flist mfu_flist_subset(mfu_flist srclist);
 /* copy specified source file into destination list */
 void mfu_flist_file_copy(mfu_flist src, uint64_t index, mfu_flist dest);
 
-/* get number of bytes to pack a file from the specified list */
+/* get max number of bytes to pack a file from the specified list */
 size_t mfu_flist_file_pack_size(mfu_flist flist);
 
-/* pack specified file into buf, return number of bytes used */
+/* pack specified file into buf, return number of bytes used,
+ * which is at most mfu_flist_file_pack_size and varies with
+ * the size of the xattrs captured for the item */
 size_t mfu_flist_file_pack(void* buf, mfu_flist flist, uint64_t index);
 
 /* unpack file from buf and insert into list, return number of bytes read */
@@ -399,9 +401,40 @@ uint64_t mfu_flist_file_get_perm(mfu_flist flist, uint64_t index);
 #if DCOPY_USE_XATTRS
 void *mfu_flist_file_get_acl(mfu_flist bflist, uint64_t idx, ssize_t *acl_size, char *type);
 #endif
+
+/* return pointer to xattrs captured for item during walk and set size,
+ * parse with mfu_xattrs_next, returns NULL if xattrs were not captured */
+const void* mfu_flist_file_get_xattrs(mfu_flist flist, uint64_t index, size_t* size);
 const char* mfu_flist_file_get_username(mfu_flist flist, uint64_t index);
 const char* mfu_flist_file_get_groupname(mfu_flist flist, uint64_t index);
 
+/* return 1 if xattr name passes filter, 0 otherwise */
+int mfu_xattrs_select(const char* name, attr_copy_t filter);
+
+/* read extended attributes of path that pass filter into a newly allocated
+ * buffer, which can be parsed with mfu_xattrs_next, the caller must free
+ * the buffer with mfu_free, returns 0 on success, -1 on error */
+int mfu_xattrs_read(
+    const char* path,
+    attr_copy_t filter,
+    int dereference,
+    mfu_file_t* mfu_file,
+    void** pbuf,
+    size_t* psize
+);
+
+/* iterate over name/value pairs in a buffer from mfu_xattrs_read or
+ * mfu_flist_file_get_xattrs, pass pos=0 to get the first pair,
+ * returns position to pass to get the next pair, or 0 if there are no more */
+size_t mfu_xattrs_next(
+    const void* buf,
+    size_t size,
+    size_t pos,
+    const char** name,
+    const void** val,
+    size_t* val_size
+);
+
 /* set properties on specified item in local flist */
 #ifdef DAOS_SUPPORT
 void mfu_flist_file_set_oid(mfu_flist flist, uint64_t index, daos_obj_id_t oid);
@@ -481,6 +514,26 @@ int mfu_flist_copy(
     mfu_file_t* mfu_dst_file        /* IN - I/O filesystem functions to use for copy of dst */
 );
 
+/* copy items as mfu_flist_copy does, and during the data phase also
+ * compare each file in src_cmp_list with the file at the same index in
+ * dst_cmp_list, replacing any destination data that differs, chunks
+ * being compared are interleaved with chunks being copied on each
+ * process so the copy does not wait for the comparison to finish,
+ * sets results[i] to 1 if item i of src_cmp_list differed and 0
+ * otherwise, returns 0 on success -1 on error */
+int mfu_flist_copy_compare(
+    mfu_flist src_cp_list,          /* IN  - flist providing source items to copy */
+    int numpaths,                   /* IN  - number of source paths */
+    const mfu_param_path* paths,    /* IN  - array of source paths */
+    const mfu_param_path* destpath, /* IN  - destination path */
+    mfu_flist src_cmp_list,         /* IN  - source files to compare */
+    mfu_flist dst_cmp_list,         /* IN  - destination files to compare, same order as src_cmp_list */
+    int* results,                   /* OUT - flag for each item in src_cmp_list, 1 if different */
+    mfu_copy_opts_t* mfu_copy_opts, /* IN  - options to be used during copy */
+    mfu_file_t* mfu_src_file,       /* IN  - I/O filesystem functions to use for copy of src */
+    mfu_file_t* mfu_dst_file        /* IN  - I/O filesystem functions to use for copy of dst */
+);
+
 /* link items in list from source paths to destination,
  * each item in source list must come from the
  * source path, returns 0 on success -1 on error */
@@ -509,7 +562,7 @@ mfu_walk_opts_t* mfu_walk_opts_new(void);
 void mfu_walk_opts_delete(mfu_walk_opts_t** opts);
 
 /* options to configure creation of directories and files */
-typedef struct {
+typedef struct mfu_create_opts {
     bool overwrite;       /* whether to replace unlink existing items (non-directories) */
     bool set_owner;       /* whether to copy uid/gid from flist to item */
     bool set_timestamps;  /* whether to copy timestamps from flist to item */
@@ -518,7 +571,10 @@ typedef struct {
     bool lustre_stripe;   /* whether to apply lustre striping parameters */
     uint64_t lustre_stripe_minsize; /* min file size in bytes for which to stripe file */
     uint64_t lustre_stripe_width;   /* size of a single stripe in bytes */
-    uint64_t lustre_stripe_count;   /* number of stripes */
+    uint64_t lustre_stripe_count;   /* number of stripes, or max number if lustre_stripe_bytes is set */
+    uint64_t lustre_stripe_bytes;   /* if not 0, use one stripe per this many bytes of file size */
+    bool preallocate;               /* whether to reserve space for file data when creating a file */
+    uint64_t preallocate_minsize;   /* min file size in bytes for which to preallocate */
 } mfu_create_opts_t;
 
 /* return a newly allocated create opts structure */
@@ -527,6 +583,26 @@ mfu_create_opts_t* mfu_create_opts_new(void);
 /* free create options allocated from mfu_create_opts_new */
 void mfu_create_opts_delete(mfu_create_opts_t** popts);
 
+/* apply the layout policy in opts to a regular file of the given size
+ * that is about to be created at name, this must be called before the
+ * file exists since striping can't be changed afterwards,
+ * returns 1 if the file was created, 0 if the caller should create it */
+int mfu_create_layout(
+    const char* name,
+    uint64_t size,
+    const mfu_create_opts_t* opts
+);
+
+/* reserve space for all data of a newly created regular file
+ * of the given size if opts requests preallocation,
+ * returns 0 on success or if not supported by the file system, -1 on error */
+int mfu_create_preallocate(
+    const char* name,
+    uint64_t size,
+    const mfu_create_opts_t* opts,
+    mfu_file_t* mfu_file
+);
+
 /* create all directories in flist */
 void mfu_flist_mkdir(
     mfu_flist flist,
@@ -581,6 +657,21 @@ int mfu_flist_file_sync_meta(mfu_flist src_list, uint64_t src_index,
                              mfu_flist dst_list, uint64_t dst_index,
                              mfu_file_t* mfu_file);
 
+/* return 1 if two buffers of xattrs from mfu_xattrs_read or
+ * mfu_flist_file_get_xattrs hold the same name/value pairs,
+ * in any order, and 0 otherwise */
+int mfu_xattrs_match(const void* a, size_t a_size, const void* b, size_t b_size);
+
+/* given a source file and a destination path, set and remove xattrs
+ * selected by copy_opts->copy_xattrs on the destination so that they
+ * match the source, only xattrs that differ are changed,
+ * returns 0 on success -1 on error */
+int mfu_flist_file_sync_xattrs(mfu_flist src_list, uint64_t src_index,
+                               const char* dest_path,
+                               mfu_copy_opts_t* copy_opts,
+                               mfu_file_t* mfu_src_file,
+                               mfu_file_t* mfu_dst_file);
+
 /* TODO: integrate this into the file list proper, or otherwise move it to another file */
 /* element structure in linked list returned by mfu_file_chunk_list_alloc */
 typedef struct mfu_file_chunk_struct {
@@ -615,10 +706,65 @@ void mfu_file_chunk_list_lor(
     int* results                /* OUT - array of output, storing logical OR across all chunks for each item in flist */
 );
 
+/* number of bytes in the digest of a chunk, which is a SHA-256 hash */
+#define MFU_CHUNK_DIGEST_SIZE (32)
+
+/* read the data of each chunk in list from the file named in the chunk
+ * and compute its digest, digests must have space for MFU_CHUNK_DIGEST_SIZE
+ * bytes per chunk, sets errs[i] to 1 if chunk i could not be read and
+ * to 0 otherwise, returns 0 if all chunks were read and -1 otherwise,
+ * if copy_opts->digest_cache is set, digests are taken from an xattr on
+ * files that have not changed since it was written, and the xattr is
+ * updated on files that were read */
+int mfu_file_chunk_list_digest(
+    mfu_flist list,             /* IN  - list the chunk list was generated from */
+    const mfu_file_chunk* head, /* IN  - chunk list */
+    mfu_copy_opts_t* copy_opts, /* IN  - options for buffer size and open flags */
+    unsigned char* digests,     /* OUT - digest of each chunk */
+    int* errs,                  /* OUT - read error flag for each chunk */
+    uint64_t* bytes_read,       /* OUT - number of bytes read */
+    uint64_t* bytes_written,    /* IN  - number of bytes written, reported in progress messages */
+    mfu_progress* prg,          /* IN  - progress message structure */
+    mfu_file_t* mfu_file        /* IN  - I/O filesystem functions to use */
+);
+
+/* remove digests cached on a file, call this before modifying data of
+ * a file in place, since restoring its times afterwards could otherwise
+ * leave a cache that appears to describe the new data */
+void mfu_digest_cache_invalidate(const char* name, mfu_file_t* mfu_file);
+
+/* compare data of chunks in src_head with matching chunks in dst_head,
+ * where both lists were generated from lists of files of the same sizes,
+ * first reads all source chunks and then all destination chunks to
+ * compute their digests, and sets vals[i] to 0 if the digests of chunk i
+ * match and to 1 if they differ or either chunk could not be read,
+ * if copy_opts->reader_ranks is set, source chunks are read by the first
+ * reader_ranks ranks and destination chunks by the remaining ranks,
+ * so that no rank reads both file systems,
+ * returns 0 if all chunks were read and -1 otherwise */
+int mfu_file_chunk_list_digest_compare(
+    mfu_flist src_list,             /* IN  - list of source files */
+    mfu_flist dst_list,             /* IN  - list of destination files */
+    const mfu_file_chunk* src_head, /* IN  - chunk list of source files */
+    const mfu_file_chunk* dst_head, /* IN  - chunk list of destination files */
+    mfu_copy_opts_t* copy_opts,     /* IN  - options for buffer size and open flags */
+    int* vals,                      /* OUT - flag for each chunk, 1 if different */
+    uint64_t* bytes_read,           /* OUT - number of bytes read (src + dest) */
+    uint64_t* bytes_written,        /* IN  - number of bytes written, reported in progress messages */
+    mfu_progress* prg,              /* IN  - progress message structure */
+    mfu_file_t* mfu_src_file,       /* IN  - I/O filesystem functions to use for source */
+    mfu_file_t* mfu_dst_file        /* IN  - I/O filesystem functions to use for destination */
+);
+
 /****************************************
  * Functions to read/write list to file or print to screen
  ****************************************/
 
+/* largest chunk size for archive operations, compressed frames and
+ * write windows of this size are passed to bzip2 and MPI, which take
+ * their lengths as int or unsigned int */
+#define MFU_ARCHIVE_CHUNK_MAX (1024ULL * 1024ULL * 1024ULL)
+
 typedef struct {
     char*   dest_path;
     bool    sync_on_close;
@@ -635,6 +781,12 @@ typedef struct {
     size_t  buf_size;
     size_t  mem_size;
     size_t  header_size;
+    bool    compress;
+    bool    append;
+    bool    update;
+    bool    list;
+    uint64_t member_count;
+    char**  members;
     int     create_libcircle;
     int     extract_libarchive;
 } mfu_archive_opts_t;
@@ -24,6 +24,11 @@
 #include <libcircle.h>
 #include <archive.h>
 #include <archive_entry.h>
+#include <bzlib.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <fnmatch.h>
 #include <string.h>
 #include <getopt.h>
 
@@ -44,6 +49,7 @@
 #define DTAR_MAGIC (0x445441525F494458)
 
 #include "mfu.h"
+#include "strmap.h"
 
 /* libcircle work operation types */
 typedef enum {
@@ -503,45 +509,6 @@ static int encode_header(
     return rc;
 }
 
-/* write header for specified item in flist to archive file */
-static int write_header(
-    mfu_flist flist,               /* flist holding item for which to write header */
-    uint64_t idx,                  /* index of item in flist */
-    const mfu_param_path* cwdpath, /* current working dir, to store relative path from cwd to item */
-    void* buf,                     /* buffer in which to store encoded header */
-    size_t bufsize,                /* size of input buffer */
-    mfu_archive_opts_t* opts,      /* archive options, which may affect encoding */
-    const char* filename,          /* filename of archive to write header to */
-    int fd,                        /* open file descriptor to write header to */
-    uint64_t offset)               /* byte offset in archive at which to write header */
-{
-    /* get name of item for any error messages */
-    const char* name = mfu_flist_file_get_name(flist, idx);
-
-    /* encode header for this entry in our buffer */
-    size_t header_size;
-    int encode_rc = encode_header(flist, idx, cwdpath,
-        buf, bufsize, opts, &header_size
-    );
-    if (encode_rc != MFU_SUCCESS) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to encode header for `%s'",
-            name);
-        DTAR_err = 1;
-        return MFU_FAILURE;
-    }
-
-    /* write header to archive for this entry */
-    ssize_t pwrite_rc = mfu_pwrite(filename, fd, buf, header_size, offset);
-    if (pwrite_rc == -1) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to write header for '%s' at offset %llu in archive file '%s' errno=%d %s",
-            name, offset, filename, errno, strerror(errno));
-        DTAR_err = 1;
-        return MFU_FAILURE;
-    }
-
-    return MFU_SUCCESS;
-}
-
 /* construct a libcircle work item to copy a segment of a user file
  * into the archive */
 static char* DTAR_encode_operation(
@@ -1083,7 +1050,13 @@ void mfu_param_path_check_archive(
         opts->dest_path = MFU_STRDUP(destparam.path);
 
         /* check destination */
-        if (destparam.path_stat_valid) {
+        if (destparam.path_stat_valid && opts->append) {
+            /* archive file already exists, and we'll add entries to it */
+        } else if (opts->append) {
+            /* nothing to append to */
+            MFU_LOG(MFU_LOG_ERR, "Archive file does not exist: '%s'", opts->dest_path);
+            *valid = 0;
+        } else if (destparam.path_stat_valid) {
             /* archive file already exists, let's delete it,
              * we're goind to overwrite the existing file, but we delete it now before we walk
              * so that we don't try to include the archive file as part of the archive */
@@ -2475,384 +2448,809 @@ static void allgather_offsets(
     return;
 }
 
-typedef enum {
-    CREATE_DEFAULT,  /* attempt to dynamically choose best option */
-    CREATE_CHUNK,    /* direct write of data, chunk list */
-    CREATE_LIBCIRCLE /* direct write of data, chunk list to init libcircle */
-} mfu_flist_archive_create_algo;
+/****************************************
+ * Compressed archives
+ ***************************************/
 
-static mfu_flist_archive_create_algo select_create_algo(void)
+/* A compressed archive holds the same byte stream as an uncompressed
+ * archive, split into frames of a fixed size, each of which is
+ * compressed as a separate bzip2 stream.  Since bzip2 decompresses
+ * concatenated streams, the result is a valid .tar.bz2 file.  After
+ * the last frame, we append a trailer that bzip2 ignores, which lists
+ * the offset and length of each compressed frame, the offset of each
+ * entry in the uncompressed stream, and a footer:
+ *
+ *   frame table:   (offset, length) of each frame
+ *   entry offsets: offset of each entry in uncompressed stream
+ *   footer:        frame count, entry count, frame size,
+ *                  uncompressed size, offset of frame table,
+ *                  compression type, version, magic
+ *
+ * All values are 64-bit integers in network order. */
+
+/* for magic value we use "DTAR_FRM" in ASCII (8-bit) */
+#define DTAR_FRAME_MAGIC (0x445441525F46524D)
+
+/* number of 64-bit values in the footer of a compressed archive */
+#define DTAR_FRAME_FOOTER (8)
+
+/* compression type recorded in footer */
+#define DTAR_FRAME_BZIP2 (1)
+
+/* index of a compressed archive */
+typedef struct {
+    uint64_t count;        /* number of frames */
+    uint64_t entries;      /* number of entries */
+    uint64_t frame_size;   /* uncompressed size of each frame, except the last */
+    uint64_t size;         /* size of uncompressed stream in bytes */
+    uint64_t table_offset; /* offset of frame table, end of compressed data */
+    uint64_t* offsets;     /* offset of each compressed frame in archive */
+    uint64_t* lengths;     /* length of each compressed frame in archive */
+    uint64_t* entry_offsets; /* offset of each entry in uncompressed stream */
+} DTAR_frames_t;
+
+/* free memory allocated in frame index */
+static void DTAR_frames_free(DTAR_frames_t* frames)
 {
-    mfu_flist_archive_create_algo algo = CREATE_DEFAULT;
+    mfu_free(&frames->offsets);
+    mfu_free(&frames->lengths);
+    mfu_free(&frames->entry_offsets);
+}
 
-    /* see if the user is trying to request a specific create algorithm */
-    const char varname[] = "MFU_FLIST_ARCHIVE_CREATE";
-    const char* value = getenv(varname);
-    if (value == NULL) {
-        return algo;
-    }
+/* a piece of a frame that some process sends to the process that
+ * compresses the frame, a piece is either literal bytes of an entry
+ * header, which follow this structure, or a range of a file, whose
+ * name follows this structure, bytes of the frame that are not
+ * covered by a piece are zero */
+typedef struct {
+    uint64_t frame;      /* id of frame */
+    uint64_t offset;     /* offset of piece in uncompressed stream */
+    uint64_t length;     /* length of piece in bytes */
+    uint64_t kind;       /* DTAR_PIECE_HEADER or DTAR_PIECE_DATA */
+    uint64_t src_offset; /* offset in source file for data */
+    uint64_t extra;      /* number of bytes that follow, padded to 8 */
+} DTAR_piece_t;
+
+#define DTAR_PIECE_HEADER (1)
+#define DTAR_PIECE_DATA   (2)
+
+/* list of pieces that grows as needed */
+typedef struct {
+    char* buf;      /* packed pieces */
+    size_t size;    /* number of bytes used in buf */
+    size_t max;     /* number of bytes allocated in buf */
+    uint64_t count; /* number of pieces */
+} DTAR_pieces_t;
+
+/* append a piece to the list, followed by extra_size bytes from extra */
+static void DTAR_pieces_add(
+    DTAR_pieces_t* list,
+    uint64_t frame,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t kind,
+    uint64_t src_offset,
+    const void* extra,
+    size_t extra_size)
+{
+    size_t padded = (extra_size + 7) / 8 * 8;
+    size_t need = sizeof(DTAR_piece_t) + padded;
+    if (list->size + need > list->max) {
+        size_t max = (list->max > 0) ? list->max * 2 : 1024 * 1024;
+        while (list->size + need > max) {
+            max *= 2;
+        }
+        list->buf = (char*) realloc(list->buf, max);
+        if (list->buf == NULL) {
+            MFU_ABORT(-1, "Failed to allocate %llu bytes for archive frames",
+                (unsigned long long) max);
+        }
+        list->max = max;
+    }
+
+    char* ptr = list->buf + list->size;
+    memset(ptr, 0, need);
+    DTAR_piece_t* p = (DTAR_piece_t*) ptr;
+    p->frame      = frame;
+    p->offset     = offset;
+    p->length     = length;
+    p->kind       = kind;
+    p->src_offset = src_offset;
+    p->extra      = (uint64_t) padded;
+    memcpy(ptr + sizeof(DTAR_piece_t), extra, extra_size);
+
+    list->size += need;
+    list->count++;
+}
 
-    /* user is trying to request a specific algorithm */
-    if (strcmp(value, "DEFAULT") == 0) {
-        algo = CREATE_DEFAULT;
-    } else if (strcmp(value, "CHUNK") == 0) {
-        algo = CREATE_CHUNK;
-    } else if (strcmp(value, "LIBCIRCLE") == 0) {
-        algo = CREATE_LIBCIRCLE;
-    } else {
-        /* value does not match any known algorithm name,
-         * print an error and fall back to default */
-        if (mfu_rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "%s: unknown value %s", varname, value);
+/* add pieces for the bytes of [start, end) in the uncompressed stream
+ * that fall within [wave_start, wave_end), split at frame boundaries,
+ * bytes come from buf for a header, or from file name at src_offset
+ * for file data */
+static void DTAR_pieces_add_range(
+    DTAR_pieces_t* list,
+    uint64_t frame_size,
+    uint64_t wave_start,
+    uint64_t wave_end,
+    uint64_t start,
+    uint64_t end,
+    uint64_t kind,
+    const char* buf,
+    const char* name,
+    uint64_t src_offset)
+{
+    uint64_t pos = (start > wave_start) ? start : wave_start;
+    uint64_t stop = (end < wave_end) ? end : wave_end;
+    while (pos < stop) {
+        uint64_t frame = pos / frame_size;
+        uint64_t frame_end = (frame + 1) * frame_size;
+        if (frame_end > stop) {
+            frame_end = stop;
+        }
+        uint64_t len = frame_end - pos;
+        if (kind == DTAR_PIECE_HEADER) {
+            DTAR_pieces_add(list, frame, pos, len, kind, 0,
+                buf + (pos - start), (size_t) len);
+        } else {
+            DTAR_pieces_add(list, frame, pos, len, kind, src_offset + (pos - start),
+                name, strlen(name) + 1);
         }
-        value = "DEFAULT";
-        algo = CREATE_DEFAULT;
+        pos = frame_end;
     }
+}
 
-    /* is user tried to select something, echo it back to confirm */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "%s: %s", varname, value);
+/* send pieces to the process that compresses their frame,
+ * returns a newly allocated buffer of pieces sent to us */
+static char* DTAR_pieces_exchange(
+    const DTAR_pieces_t* list,
+    size_t* out_size)
+{
+    mfu_exchange ex;
+    mfu_exchange_init(&ex, MPI_COMM_WORLD);
+
+    /* pack each piece for the process that compresses its frame */
+    size_t pos = 0;
+    while (pos < list->size) {
+        const DTAR_piece_t* p = (const DTAR_piece_t*)(list->buf + pos);
+        size_t size = sizeof(DTAR_piece_t) + (size_t) p->extra;
+        int dest = (int)(p->frame % (uint64_t)ex.ranks);
+        mfu_exchange_pack(&ex, dest, p, size);
+        pos += size;
     }
 
-    return algo;
+    return mfu_exchange_all(&ex, out_size);
 }
 
-int mfu_flist_archive_create(
-    mfu_flist inflist,
-    const char* filename,
-    int numpaths,
-    const mfu_param_path* paths,
-    const mfu_param_path* cwdpath,
+/* copy the bytes of a piece into the buffer of its frame,
+ * returns MFU_SUCCESS on success */
+static int DTAR_piece_fill(
+    const DTAR_piece_t* p,
+    char* frame_buf,
+    uint64_t frame_start,
     mfu_archive_opts_t* opts)
 {
-    /* assume we'll succeed */
-    int rc = MFU_SUCCESS;
+    char* dst = frame_buf + (p->offset - frame_start);
+    const char* extra = (const char*)p + sizeof(DTAR_piece_t);
 
-    /* allow override algorithm choice via environment variable */
-    mfu_flist_archive_create_algo algo = select_create_algo();
-    if (algo == CREATE_LIBCIRCLE) {
-        opts->create_libcircle = 1;
-    } else {
-        opts->create_libcircle = 0;
+    if (p->kind == DTAR_PIECE_HEADER) {
+        memcpy(dst, extra, (size_t) p->length);
+        return MFU_SUCCESS;
     }
 
-    /* print note about what we're doing and the amount of files/data to be moved */
-    if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Writing archive to %s", filename);
+    /* read file data */
+    const char* name = extra;
+    if (mfu_archive_open_file(name, 1, 0, opts->open_noatime, &mfu_archive_src_cache) < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open source file '%s' errno=%d %s",
+            name, errno, strerror(errno));
+        return MFU_FAILURE;
     }
+    int fd = mfu_archive_src_cache.fd;
 
-    /* print summary of item and byte count of items to be archived */
-    mfu_flist_print_summary(inflist);
+    uint64_t done = 0;
+    while (done < p->length) {
+        size_t bytes = (size_t)(p->length - done);
+        off_t pos = (off_t)(p->src_offset + done);
+        ssize_t nread = mfu_pread(name, fd, dst + done, bytes, pos);
+        if (nread < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read source file '%s' errno=%d %s",
+                name, errno, strerror(errno));
+            return MFU_FAILURE;
+        }
+        if (nread == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Source file '%s' shrank while creating archive", name);
+            return MFU_FAILURE;
+        }
+        done += (uint64_t) nread;
+    }
 
-    /* start overall timer */
-    time_t time_started;
-    time(&time_started);
-    double wtime_started = MPI_Wtime();
+    return MFU_SUCCESS;
+}
 
-    /* sort items alphabetically, so they are placed in the archive with parent directories
-     * coming before their children */
-    mfu_flist flist = mfu_flist_sort("name", inflist);
+/* have rank 0 write the frame table, the entry offsets, and the footer
+ * at the end of the compressed frames */
+static int DTAR_frames_write_trailer(
+    const char* filename,
+    int fd,
+    uint64_t frame_count,  /* number of frames in archive */
+    uint64_t my_frames,    /* number of frames we compressed */
+    const uint64_t* my_info, /* (frame, offset, length) of each frame we compressed */
+    uint64_t listsize,     /* number of entries on this process */
+    const uint64_t* entry_offsets, /* offset of each entry in uncompressed stream */
+    uint64_t frame_size,   /* uncompressed size of a frame */
+    uint64_t size,         /* size of uncompressed stream */
+    uint64_t* inout_size)  /* size of compressed frames, returns size of archive */
+{
+    int rc = MFU_SUCCESS;
 
-    /* we'll flip this to 1 if any process hits any error writing the archive */
-    DTAR_err = 0;
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-    /* if archive file will be on lustre, set max striping since this should be big */
-    mfu_set_stripes(filename, cwdpath->path, opts->chunk_size, -1);
+    /* gather frame info and entry offsets to rank 0 */
+    int* counts = (int*) MFU_MALLOC(ranks * sizeof(int));
+    int* disps  = (int*) MFU_MALLOC(ranks * sizeof(int));
 
-    /* create the archive file */
-    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | O_LARGEFILE;
-    int fd = mfu_open(filename, flags, 0664);
-    if (fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open archive '%s' errno=%d %s",
-            filename, errno, strerror(errno));
-        DTAR_err = 1;
+    uint64_t* all_info = NULL;
+    int count_int = (int)(my_frames * 3);
+    MPI_Gather(&count_int, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (mfu_rank == 0) {
+        int disp = 0;
+        int r;
+        for (r = 0; r < ranks; r++) {
+            disps[r] = disp;
+            disp += counts[r];
+        }
+        all_info = (uint64_t*) MFU_MALLOC((size_t)disp * sizeof(uint64_t) + 1);
     }
+    MPI_Gatherv(my_info, count_int, MPI_UINT64_T,
+        all_info, counts, disps, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
-//    int lock_rc = llapi_group_lock(fd, 23);
+    uint64_t entries;
+    MPI_Allreduce(&listsize, &entries, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
 
-    /* Allocate a buffer to encode tar headers.
-     * The entire header must fit in this buffer.
-     * Typical entries will have no problems, but we may exhaust
-     * space for entries that have very long ACLs or XATTRs. */
-    size_t header_bufsize = opts->header_size;
-    void* header_buf = MFU_MALLOC(header_bufsize);
+    uint64_t* all_offsets = NULL;
+    count_int = (int) listsize;
+    MPI_Gather(&count_int, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (mfu_rank == 0) {
+        int disp = 0;
+        int r;
+        for (r = 0; r < ranks; r++) {
+            disps[r] = disp;
+            disp += counts[r];
+        }
+        all_offsets = (uint64_t*) MFU_MALLOC(entries * sizeof(uint64_t) + 1);
+    }
+    MPI_Gatherv(entry_offsets, count_int, MPI_UINT64_T,
+        all_offsets, counts, disps, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
-    /* get number of items in our portion of the list */
-    uint64_t listsize = mfu_flist_size(flist);
+    if (mfu_rank == 0) {
+        /* pack the trailer */
+        uint64_t table_offset = *inout_size;
+        size_t values = (size_t)(frame_count * 2 + entries + DTAR_FRAME_FOOTER);
+        uint64_t* trailer = (uint64_t*) MFU_MALLOC(values * sizeof(uint64_t));
+
+        uint64_t i;
+        for (i = 0; i < frame_count; i++) {
+            uint64_t frame  = all_info[i * 3 + 0];
+            uint64_t offset = all_info[i * 3 + 1];
+            uint64_t length = all_info[i * 3 + 2];
+            trailer[frame * 2 + 0] = mfu_hton64(offset);
+            trailer[frame * 2 + 1] = mfu_hton64(length);
+        }
+
+        uint64_t* ptr = trailer + frame_count * 2;
+        for (i = 0; i < entries; i++) {
+            ptr[i] = mfu_hton64(all_offsets[i]);
+        }
+
+        uint64_t* footer = ptr + entries;
+        footer[0] = mfu_hton64(frame_count);
+        footer[1] = mfu_hton64(entries);
+        footer[2] = mfu_hton64(frame_size);
+        footer[3] = mfu_hton64(size);
+        footer[4] = mfu_hton64(table_offset);
+        footer[5] = mfu_hton64(DTAR_FRAME_BZIP2);
+        footer[6] = mfu_hton64(1);
+        footer[7] = mfu_hton64(DTAR_FRAME_MAGIC);
+
+        /* write the trailer after the last frame */
+        size_t bytes = values * sizeof(uint64_t);
+        size_t written = 0;
+        while (written < bytes) {
+            ssize_t nwritten = mfu_pwrite(filename, fd, (char*)trailer + written,
+                bytes - written, (off_t)(table_offset + written));
+            if (nwritten < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to write index to archive '%s' errno=%d %s",
+                    filename, errno, strerror(errno));
+                rc = MFU_FAILURE;
+                break;
+            }
+            written += (size_t) nwritten;
+        }
 
-    /* allocate memory for file sizes and offsets */
-    uint64_t* header_sizes  = (uint64_t*) MFU_MALLOC(listsize * sizeof(uint64_t));
-    uint64_t* entry_sizes   = (uint64_t*) MFU_MALLOC(listsize * sizeof(uint64_t));
-    uint64_t* entry_offsets = (uint64_t*) MFU_MALLOC(listsize * sizeof(uint64_t));
-    uint64_t* data_offsets  = (uint64_t*) MFU_MALLOC(listsize * sizeof(uint64_t));
+        /* drop anything left from an earlier file */
+        *inout_size = table_offset + (uint64_t) bytes;
+        mfu_ftruncate(fd, (off_t) *inout_size);
 
-    /* allocate buffer to read/write data */
-    size_t bufsize = opts->buf_size;
-    void* buf = MFU_MALLOC(bufsize);
+        mfu_free(&trailer);
+    }
 
-    /* compute local offsets for each item and total
-     * bytes we're contributing to the archive */
-    uint64_t idx;
-    uint64_t bytes = 0;
-    uint64_t data_bytes = 0;
-    compute_entry_sizes(flist, cwdpath, opts,
-        header_buf, header_bufsize,
-        &bytes, &data_bytes, header_sizes, entry_sizes, entry_offsets);
+    MPI_Bcast(inout_size, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
-    /* store total item and data byte count */
-    uint64_t total_items = mfu_flist_global_size(flist);
-    MPI_Allreduce(&data_bytes, &DTAR_total_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    mfu_free(&all_offsets);
+    mfu_free(&all_info);
+    mfu_free(&disps);
+    mfu_free(&counts);
 
-    /* compute total archive size */
-    uint64_t archive_size = 0;
-    MPI_Allreduce(&bytes, &archive_size, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+    return rc;
+}
 
-    /* execute scan to figure our global base offset in the archive file */
-    uint64_t global_offset = 0;
-    MPI_Scan(&bytes, &global_offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    global_offset -= bytes;
+/* write a compressed archive, the uncompressed stream is laid out
+ * as for an uncompressed archive, with entries at entry_offsets
+ * followed by two 512-byte blocks of zeros, and it is split into
+ * frames of chunk_size bytes, frames are compressed in waves with
+ * frame i assigned to rank i % ranks, for each wave, the owner of
+ * each entry sends its header bytes and the location of its file
+ * data to the ranks compressing the frames it falls in, returns the
+ * size of the archive file in inout_size */
+static int mfu_flist_archive_create_compressed(
+    mfu_flist flist,
+    const char* filename,
+    int fd,
+    const mfu_param_path* cwdpath,
+    void* header_buf,
+    size_t header_bufsize,
+    const uint64_t* header_sizes,
+    const uint64_t* entry_offsets,
+    const uint64_t* data_offsets,
+    mfu_archive_opts_t* opts,
+    uint64_t* inout_size)
+{
+    int rc = MFU_SUCCESS;
 
-    /* update offsets for each of our file to their global offset */
-    for (idx = 0; idx < listsize; idx++) {
-        entry_offsets[idx] += global_offset;
-        data_offsets[idx] = entry_offsets[idx] + header_sizes[idx];
-    }
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-    /* print message to user that we're starting */
-    if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Truncating archive");
-    }
+    /* size of uncompressed stream including the two trailing blocks */
+    uint64_t size = *inout_size + 2 * 512;
 
-    /* TODO: delete any existing index */
+    /* compute number of frames */
+    uint64_t frame_size = (uint64_t) opts->chunk_size;
+    uint64_t frame_count = (size + frame_size - 1) / frame_size;
 
-    /* truncate file to correct size to overwrite existing file
-     * and to preallocate space on the file system */
-    if (mfu_rank == 0) {
-        /* truncate to 0 to delete any existing file contents */
-        mfu_ftruncate(fd, 0);
+    /* bzip2 output may be 1% larger than its input plus 600 bytes,
+     * the chunk size limit keeps this within an unsigned int */
+    size_t comp_size = (size_t)(frame_size + frame_size / 100 + 600);
 
-        /* truncate to proper size and preallocate space,
-         * archive size represents the space to hold all entries,
-         * then add on final two 512-blocks that mark the end of the archive */
-        off_t final_size = archive_size + 2 * 512;
-        mfu_ftruncate(fd, final_size);
-        posix_fallocate(fd, 0, final_size);
+    /* number of frames each process compresses per wave,
+     * limited by memory we may use */
+    uint64_t per_wave = (uint64_t) opts->mem_size / (frame_size + comp_size);
+    if (per_wave < 1) {
+        per_wave = 1;
     }
-    MPI_Barrier(MPI_COMM_WORLD);
+    uint64_t wave_frames = per_wave * (uint64_t) ranks;
 
-    /* TODO: include index as entry when truncating/preallocating file above */
-    /* record global offsets in index */
-    write_entry_index(filename, listsize, entry_offsets, opts, &archive_size);
+    char* in_buf  = (char*) MFU_MALLOC((size_t)(per_wave * frame_size));
+    char* out_buf = (char*) MFU_MALLOC((size_t)per_wave * comp_size);
+    uint64_t* lengths = (uint64_t*) MFU_MALLOC(per_wave * sizeof(uint64_t));
+    uint64_t* disps   = (uint64_t*) MFU_MALLOC(per_wave * sizeof(uint64_t));
+    uint64_t* totals  = (uint64_t*) MFU_MALLOC(per_wave * sizeof(uint64_t));
 
-    /* print message to user that we're starting */
-    if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Writing entry headers");
-    }
+    /* record (frame, offset, length) for each frame we compress */
+    uint64_t my_max = (frame_count + (uint64_t)ranks - 1) / (uint64_t)ranks;
+    uint64_t* my_info = (uint64_t*) MFU_MALLOC((my_max * 3 + 1) * sizeof(uint64_t));
+    uint64_t my_frames = 0;
 
-    /* write headers for our files */
-    for (idx = 0; idx < listsize; idx++) {
-        /* we currently only support regular files, directories, and symlinks */
-        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
-        if (type == MFU_TYPE_FILE || type == MFU_TYPE_DIR || type == MFU_TYPE_LINK) {
-            /* write header for this item to the archive,
-             * this sets DTAR_err on any error */
-            write_header(flist, idx, cwdpath,
-                header_buf, header_bufsize, opts,
-                filename, fd, entry_offsets[idx]);
-        } else {
-            /* print a warning that we did not archive this item */
-            const char* item_name = mfu_flist_file_get_name(flist, idx);
-            MFU_LOG(MFU_LOG_WARN, "Unsupported type, cannot archive `%s'", item_name);
+    /* initialize file cache for opening source files */
+    mfu_archive_src_cache.name = NULL;
+
+    /* track progress in bytes of uncompressed stream */
+    DTAR_total_bytes = size;
+    reduce_buf[REDUCE_BYTES] = 0;
+    mfu_progress* create_prog = mfu_progress_start(mfu_progress_timeout, 1, MPI_COMM_WORLD, create_progress_fn);
+
+    uint64_t listsize = mfu_flist_size(flist);
+    uint64_t cursor = 0;
+    uint64_t comp_offset = 0;
+    uint64_t first;
+    for (first = 0; first < frame_count; first += wave_frames) {
+        /* compute range of uncompressed stream in this wave */
+        uint64_t wave_start = first * frame_size;
+        uint64_t wave_end   = (first + wave_frames) * frame_size;
+        if (wave_end > size) {
+            wave_end = size;
+        }
+
+        /* skip entries that end before this wave */
+        while (cursor < listsize) {
+            uint64_t end = data_offsets[cursor];
+            if (mfu_flist_file_get_type(flist, cursor) == MFU_TYPE_FILE) {
+                end += mfu_flist_file_get_size(flist, cursor);
+            }
+            if (end > wave_start) {
+                break;
+            }
+            cursor++;
         }
-    }
 
-    /* print message to user that we're starting */
-    if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Copying file data");
-    }
+        /* describe the bytes of our entries that fall in this wave */
+        DTAR_pieces_t pieces;
+        memset(&pieces, 0, sizeof(pieces));
+        uint64_t idx;
+        for (idx = cursor; idx < listsize && entry_offsets[idx] < wave_end; idx++) {
+            mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+            if (type != MFU_TYPE_FILE && type != MFU_TYPE_DIR && type != MFU_TYPE_LINK) {
+                continue;
+            }
 
-    /* gather global list of offset values */
-    uint64_t total_count;
-    uint64_t* all_offsets;
-    int* rank_disps;
-    allgather_offsets(listsize, data_offsets, &total_count, &all_offsets, &rank_disps);
-
-    /* copy data from files into archive */
-    if (opts->create_libcircle) {
-        /* distribute flist into chunk list across procs,
-         * then insert work items into libcircle */
-        mfu_flist_archive_create_copy_libcircle(flist, filename, fd,
-            header_buf, header_bufsize, buf, bufsize,
-            rank_disps, all_offsets, opts);
-    } else {
-        /* this splits the flist into a chunk list,
-         * and each process directly copies its chunks */
-        mfu_flist_archive_create_copy_chunk(flist, filename, fd,
-            header_buf, header_bufsize, buf, bufsize,
-            rank_disps, all_offsets, opts);
-    }
+            /* encode header if some of it falls in this wave */
+            uint64_t header_start = entry_offsets[idx];
+            uint64_t header_end   = header_start + header_sizes[idx];
+            if (header_end > wave_start) {
+                size_t header_size;
+                if (encode_header(flist, idx, cwdpath, header_buf, header_bufsize,
+                    opts, &header_size) != MFU_SUCCESS ||
+                    header_size != header_sizes[idx])
+                {
+                    const char* name = mfu_flist_file_get_name(flist, idx);
+                    MFU_LOG(MFU_LOG_ERR, "Failed to encode header for `%s'", name);
+                    DTAR_err = 1;
+                } else {
+                    DTAR_pieces_add_range(&pieces, frame_size, wave_start, wave_end,
+                        header_start, header_end, DTAR_PIECE_HEADER, header_buf, NULL, 0);
+                }
+            }
 
-    /* rank 0 finalizes the archive by writing two 512-byte blocks of NUL
-     * (according to tar file format) */
-    if (mfu_rank == 0) {
-        /* write two blocks of 512 bytes of 0 */
-        char buf[1024] = {0};
-        size_t bufsize = sizeof(buf);
-        ssize_t pwrite_rc = mfu_pwrite(filename, fd, buf, bufsize, archive_size);
-        if (pwrite_rc != bufsize) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to write to archive '%s' at offset %llu errno=%d %s",
-                filename, archive_size, errno, strerror(errno));
-            DTAR_err = 1;
+            /* describe file data, the padding that follows is zero */
+            if (type == MFU_TYPE_FILE) {
+                uint64_t data_start = data_offsets[idx];
+                uint64_t data_end   = data_start + mfu_flist_file_get_size(flist, idx);
+                const char* name = mfu_flist_file_get_name(flist, idx);
+                DTAR_pieces_add_range(&pieces, frame_size, wave_start, wave_end,
+                    data_start, data_end, DTAR_PIECE_DATA, NULL, name, 0);
+            }
         }
 
-        /* include final NULL blocks in our stats */
-        archive_size += bufsize;
-    }
-
-//    lock_rc = llapi_group_unlock(fd, 23);
+        /* send pieces to the processes compressing their frames */
+        size_t recv_size;
+        char* recv = DTAR_pieces_exchange(&pieces, &recv_size);
+        free(pieces.buf);
 
-    /* close archive file */
-    int close_rc = mfu_close(filename, fd);
-    if (close_rc == -1) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to close archive '%s' errno=%d %s",
-            filename, errno, strerror(errno));
-        DTAR_err = 1;
-    }
+        /* fill our frames, bytes not covered by a piece are zero */
+        memset(in_buf, 0, (size_t)(per_wave * frame_size));
+        size_t pos = 0;
+        while (pos < recv_size) {
+            const DTAR_piece_t* p = (const DTAR_piece_t*)(recv + pos);
+            uint64_t j = (p->frame - first) / (uint64_t)ranks;
+            char* frame_buf = in_buf + j * frame_size;
+            if (DTAR_piece_fill(p, frame_buf, p->frame * frame_size, opts) != MFU_SUCCESS) {
+                DTAR_err = 1;
+            }
+            pos += sizeof(DTAR_piece_t) + (size_t) p->extra;
+        }
+        mfu_free(&recv);
 
-    /* determine whether everyone succeeded in writing their part */
-    int write_success = mfu_alltrue(DTAR_err == 0, MPI_COMM_WORLD);
-    if (! write_success) {
-        rc = MFU_FAILURE;
-    }
+        /* compress our frames */
+        uint64_t j;
+        for (j = 0; j < per_wave; j++) {
+            lengths[j] = 0;
+            uint64_t frame = first + j * (uint64_t)ranks + (uint64_t)rank;
+            if (frame >= frame_count) {
+                continue;
+            }
 
-    /* wait for all ranks to finish */
-    MPI_Barrier(MPI_COMM_WORLD);
+            uint64_t frame_start = frame * frame_size;
+            uint64_t frame_len = size - frame_start;
+            if (frame_len > frame_size) {
+                frame_len = frame_size;
+            }
 
-    /* free sorted list */
-    mfu_flist_free(&flist);
+            unsigned int out_len = (unsigned int) comp_size;
+            int ret = BZ2_bzBuffToBuffCompress(out_buf + j * comp_size, &out_len,
+                in_buf + j * frame_size, (unsigned int) frame_len, 9, 0, 30);
+            if (ret != BZ_OK) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to compress frame %llu of archive '%s' (bzip2 error %d)",
+                    (unsigned long long) frame, filename, ret);
+                DTAR_err = 1;
+            }
+            lengths[j] = (uint64_t) out_len;
 
-    /* stop overall time */
-    time_t time_ended;
-    time(&time_ended);
-    double wtime_ended = MPI_Wtime();
+            reduce_buf[REDUCE_BYTES] += frame_len;
+            mfu_progress_update(reduce_buf, create_prog);
+        }
 
-    /* print stats */
-    double secs = wtime_ended - wtime_started;
-    if (mfu_rank == 0) {
-        char starttime_str[256];
-        struct tm* localstart = localtime(&time_started);
-        strftime(starttime_str, 256, "%b-%d-%Y, %H:%M:%S", localstart);
+        /* compute offsets of our frames, frames are ordered by id,
+         * which orders them by j and then by rank */
+        MPI_Exscan(lengths, disps, (int)per_wave, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == 0) {
+            for (j = 0; j < per_wave; j++) {
+                disps[j] = 0;
+            }
+        }
+        MPI_Allreduce(lengths, totals, (int)per_wave, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+        /* write our frames */
+        for (j = 0; j < per_wave; j++) {
+            uint64_t frame = first + j * (uint64_t)ranks + (uint64_t)rank;
+            if (frame < frame_count) {
+                uint64_t offset = comp_offset + disps[j];
+                ssize_t nwritten = mfu_pwrite(filename, fd, out_buf + j * comp_size,
+                    (size_t) lengths[j], (off_t) offset);
+                if (nwritten != (ssize_t) lengths[j]) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to write to archive file '%s' errno=%d %s",
+                        filename, errno, strerror(errno));
+                    DTAR_err = 1;
+                }
 
-        char endtime_str[256];
-        struct tm* localend = localtime(&time_ended);
-        strftime(endtime_str, 256, "%b-%d-%Y, %H:%M:%S", localend);
+                my_info[my_frames * 3 + 0] = frame;
+                my_info[my_frames * 3 + 1] = offset;
+                my_info[my_frames * 3 + 2] = lengths[j];
+                my_frames++;
+            }
+            comp_offset += totals[j];
+        }
+    }
 
-        /* convert size to units */
-        double size_tmp;
-        const char* size_units;
-        mfu_format_bytes(archive_size, &size_tmp, &size_units);
+    /* finalize progress messages */
+    mfu_progress_complete(reduce_buf, &create_prog);
 
-        /* convert bandwidth to unit */
-        double agg_rate_tmp;
-        double agg_rate = (double)archive_size / secs;
-        const char* agg_rate_units;
-        mfu_format_bw(agg_rate, &agg_rate_tmp, &agg_rate_units);
+    /* done reading, close any source file that is still open */
+    mfu_archive_close_file(&mfu_archive_src_cache);
 
-        MFU_LOG(MFU_LOG_INFO, "Started:   %s", starttime_str);
-        MFU_LOG(MFU_LOG_INFO, "Completed: %s", endtime_str);
-        MFU_LOG(MFU_LOG_INFO, "Seconds: %.3lf", secs);
-        MFU_LOG(MFU_LOG_INFO, "Archive size: %.3lf %s", size_tmp, size_units);
-        MFU_LOG(MFU_LOG_INFO, "Rate: %.3lf %s " \
-                "(%.3" PRIu64 " bytes in %.3lf seconds)", \
-                agg_rate_tmp, agg_rate_units, archive_size, secs);
+    /* append the index */
+    *inout_size = comp_offset;
+    int tmp_rc = DTAR_frames_write_trailer(filename, fd, frame_count, my_frames, my_info,
+        listsize, entry_offsets, frame_size, size, inout_size);
+    if (tmp_rc != MFU_SUCCESS) {
+        rc = tmp_rc;
     }
 
-    /* clean up */
-    mfu_free(&all_offsets);
-    mfu_free(&rank_disps);
-    mfu_free(&header_buf);
-    mfu_free(&buf);
-    mfu_free(&data_offsets);
-    mfu_free(&entry_offsets);
-    mfu_free(&entry_sizes);
-    mfu_free(&header_sizes);
+    mfu_free(&my_info);
+    mfu_free(&totals);
+    mfu_free(&disps);
+    mfu_free(&lengths);
+    mfu_free(&out_buf);
+    mfu_free(&in_buf);
 
     return rc;
 }
 
-/* copy data from read archive (ar) to write archive (aw),
- * this is used when assigning a full entry to a process
- * copy from one archive to another */
-static int copy_data(struct archive* ar, struct archive* aw)
+/* attempts to read the index of a compressed archive, returns
+ * MFU_SUCCESS if the archive was created with --compress, and
+ * fills in frames with the frame table and entry offsets */
+static int DTAR_frames_read(
+    const char* filename,
+    DTAR_frames_t* frames)
 {
     int rc = MFU_SUCCESS;
 
-    while (1) {
-        /* extract a block of data from the archive */
-        const void* buff;
-        size_t size;
-        off_t offset;
-        int r = archive_read_data_block(ar, &buff, &size, &offset);
-        if (r == ARCHIVE_EOF) {
-            /* hit end of data for entry */
-            break;
-        }
-        if (r != ARCHIVE_OK) {
-            /* read error */
-            MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(ar));
+    memset(frames, 0, sizeof(*frames));
+
+    uint64_t values[5] = {0, 0, 0, 0, 0};
+    if (mfu_rank == 0) {
+        int fd = mfu_open(filename, O_RDONLY);
+        if (fd >= 0) {
+            /* read the footer, since the archive may not have one,
+             * don't bother printing an error if we fail */
+            uint64_t footer[DTAR_FRAME_FOOTER];
+            off_t file_size = mfu_lseek(filename, fd, 0, SEEK_END);
+            if (file_size < (off_t) sizeof(footer)) {
+                rc = MFU_FAILURE;
+            }
+            if (rc == MFU_SUCCESS) {
+                ssize_t nread = mfu_pread(filename, fd, footer, sizeof(footer),
+                    file_size - (off_t) sizeof(footer));
+                if (nread != (ssize_t) sizeof(footer) ||
+                    mfu_ntoh64(footer[7]) != DTAR_FRAME_MAGIC ||
+                    mfu_ntoh64(footer[6]) != 1 ||
+                    mfu_ntoh64(footer[5]) != DTAR_FRAME_BZIP2)
+                {
+                    rc = MFU_FAILURE;
+                }
+            }
+
+            if (rc == MFU_SUCCESS) {
+                frames->count        = mfu_ntoh64(footer[0]);
+                frames->entries      = mfu_ntoh64(footer[1]);
+                frames->frame_size   = mfu_ntoh64(footer[2]);
+                frames->size         = mfu_ntoh64(footer[3]);
+                frames->table_offset = mfu_ntoh64(footer[4]);
+
+                /* read frame table and entry offsets, we never write frames
+                 * larger than the chunk size limit, and decompressing one
+                 * passes its size to bzip2 as an unsigned int */
+                size_t count = (size_t)(frames->count * 2 + frames->entries);
+                size_t bytes = count * sizeof(uint64_t);
+                if (frames->table_offset + bytes + sizeof(footer) != (uint64_t) file_size ||
+                    frames->frame_size == 0 || frames->frame_size > MFU_ARCHIVE_CHUNK_MAX)
+                {
+                    MFU_LOG(MFU_LOG_ERR, "Invalid index in compressed archive '%s'", filename);
+                    rc = MFU_FAILURE;
+                }
+
+                uint64_t* table = NULL;
+                if (rc == MFU_SUCCESS) {
+                    table = (uint64_t*) MFU_MALLOC(bytes + 1);
+                    size_t done = 0;
+                    while (done < bytes) {
+                        ssize_t nread = mfu_pread(filename, fd, (char*)table + done, bytes - done,
+                            (off_t)(frames->table_offset + done));
+                        if (nread <= 0) {
+                            MFU_LOG(MFU_LOG_ERR, "Failed to read index from archive '%s' errno=%d %s",
+                                filename, errno, strerror(errno));
+                            rc = MFU_FAILURE;
+                            break;
+                        }
+                        done += (size_t) nread;
+                    }
+                }
+
+                if (rc == MFU_SUCCESS) {
+                    uint64_t i;
+                    frames->offsets = (uint64_t*) MFU_MALLOC(frames->count * sizeof(uint64_t) + 1);
+                    frames->lengths = (uint64_t*) MFU_MALLOC(frames->count * sizeof(uint64_t) + 1);
+                    frames->entry_offsets = (uint64_t*) MFU_MALLOC(frames->entries * sizeof(uint64_t) + 1);
+                    for (i = 0; i < frames->count; i++) {
+                        frames->offsets[i] = mfu_ntoh64(table[i * 2 + 0]);
+                        frames->lengths[i] = mfu_ntoh64(table[i * 2 + 1]);
+                    }
+                    for (i = 0; i < frames->entries; i++) {
+                        frames->entry_offsets[i] = mfu_ntoh64(table[frames->count * 2 + i]);
+                    }
+                }
+
+                mfu_free(&table);
+            }
+
+            mfu_close(filename, fd);
+        } else {
+            /* leave it to the caller to report errors opening the archive */
             rc = MFU_FAILURE;
-            break;
         }
 
-        /* write that block of data to the item on disk */
-        r = archive_write_data_block(aw, buff, size, offset);
-        if (r != ARCHIVE_OK) {
-            /* write error */
-            MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(ar));
-            rc = MFU_FAILURE;
-            break;
+        if (rc != MFU_SUCCESS) {
+            DTAR_frames_free(frames);
         }
+    }
 
-        /* track number of bytes written so far */
-        reduce_buf[REDUCE_BYTES] += (uint64_t) size;
+    /* bail out if we don't have a compressed archive */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        return MFU_FAILURE;
+    }
 
-        /* update number of items we have completed for progress messages */
-        mfu_progress_update(reduce_buf, extract_prog);
+    /* broadcast index to all ranks */
+    values[0] = frames->count;
+    values[1] = frames->entries;
+    values[2] = frames->frame_size;
+    values[3] = frames->size;
+    values[4] = frames->table_offset;
+    MPI_Bcast(values, 5, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    frames->count        = values[0];
+    frames->entries      = values[1];
+    frames->frame_size   = values[2];
+    frames->size         = values[3];
+    frames->table_offset = values[4];
+
+    if (mfu_rank != 0) {
+        frames->offsets = (uint64_t*) MFU_MALLOC(frames->count * sizeof(uint64_t) + 1);
+        frames->lengths = (uint64_t*) MFU_MALLOC(frames->count * sizeof(uint64_t) + 1);
+        frames->entry_offsets = (uint64_t*) MFU_MALLOC(frames->entries * sizeof(uint64_t) + 1);
     }
+    MPI_Bcast(frames->offsets, (int) frames->count, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(frames->lengths, (int) frames->count, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    MPI_Bcast(frames->entry_offsets, (int) frames->entries, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
-    return rc;
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Read index of %llu compressed frames in %s",
+            (unsigned long long) frames->count, filename);
+    }
+
+    return MFU_SUCCESS;
+}
+
+/* decompress frame i of a compressed archive into buf, which must
+ * hold frame_size bytes, comp_buf must hold the compressed frame,
+ * returns number of bytes in the frame, or -1 on error */
+static int64_t DTAR_frame_read(
+    const char* filename,
+    int fd,
+    const DTAR_frames_t* frames,
+    uint64_t i,
+    char* buf,
+    char* comp_buf)
+{
+    /* read compressed frame */
+    uint64_t length = frames->lengths[i];
+    uint64_t done = 0;
+    while (done < length) {
+        ssize_t nread = mfu_pread(filename, fd, comp_buf + done, (size_t)(length - done),
+            (off_t)(frames->offsets[i] + done));
+        if (nread <= 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read frame %llu from archive '%s' errno=%d %s",
+                (unsigned long long) i, filename, errno, strerror(errno));
+            return -1;
+        }
+        done += (uint64_t) nread;
+    }
+
+    /* compute expected size of frame */
+    uint64_t start = i * frames->frame_size;
+    uint64_t expected = frames->size - start;
+    if (expected > frames->frame_size) {
+        expected = frames->frame_size;
+    }
+
+    unsigned int out_len = (unsigned int) frames->frame_size;
+    int ret = BZ2_bzBuffToBuffDecompress(buf, &out_len, comp_buf, (unsigned int) length, 0, 0);
+    if (ret != BZ_OK || (uint64_t) out_len != expected) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to decompress frame %llu of archive '%s' (bzip2 error %d)",
+            (unsigned long long) i, filename, ret);
+        return -1;
+    }
+
+    return (int64_t) out_len;
+}
+
+/* parse a numeric field of a tar header, which is either octal
+ * or a base-256 value when the high bit of the first byte is set */
+static uint64_t DTAR_header_number(const unsigned char* field, size_t len)
+{
+    uint64_t val = 0;
+    size_t i;
+    if (field[0] & 0x80) {
+        val = field[0] & 0x7f;
+        for (i = 1; i < len; i++) {
+            val = (val << 8) | field[i];
+        }
+        return val;
+    }
+    for (i = 0; i < len; i++) {
+        if (field[i] == ' ') {
+            continue;
+        }
+        if (field[i] < '0' || field[i] > '7') {
+            break;
+        }
+        val = (val << 3) | (uint64_t)(field[i] - '0');
+    }
+    return val;
 }
 
 typedef enum {
-    SCAN_SINGLE,   /* single process scans the archive */
-    SCAN_LINEAR,   /* distributed read, with linear scan across processes */
-    SCAN_PARALLEL, /* distributed read, with parallel scan (experimental, requires a well-formed archive) */
-} mfu_flist_archive_scan_algo;
+    WRITE_POSIX,     /* each process writes its staging buffer with pwrite */
+    WRITE_COLLECTIVE /* processes write staging buffers with MPI-IO collectives */
+} mfu_flist_archive_write_algo;
 
-static mfu_flist_archive_scan_algo select_scan_algo(void)
+static mfu_flist_archive_write_algo select_write_algo(void)
 {
-    mfu_flist_archive_scan_algo algo = SCAN_LINEAR;
+    mfu_flist_archive_write_algo algo = WRITE_POSIX;
 
-    const char varname[] = "MFU_FLIST_ARCHIVE_SCAN";
+    /* see if the user is trying to request a specific write method */
+    const char varname[] = "MFU_FLIST_ARCHIVE_WRITE";
     const char* value = getenv(varname);
     if (value == NULL) {
         return algo;
     }
 
-    if (strcmp(value, "SINGLE") == 0) {
-        algo = SCAN_SINGLE;
-    } else if (strcmp(value, "LINEAR") == 0) {
-        algo = SCAN_LINEAR;
-    } else if (strcmp(value, "PARALLEL") == 0) {
-        algo = SCAN_PARALLEL;
+    /* user is trying to request a specific method */
+    if (strcmp(value, "POSIX") == 0) {
+        algo = WRITE_POSIX;
+    } else if (strcmp(value, "COLLECTIVE") == 0) {
+        algo = WRITE_COLLECTIVE;
     } else {
+        /* value does not match any known method name,
+         * print an error and fall back to default */
         if (mfu_rank == 0) {
             MFU_LOG(MFU_LOG_ERR, "%s: unknown value %s", varname, value);
         }
-        value = "LINEAR";
-        algo = SCAN_LINEAR;
+        value = "POSIX";
+        algo = WRITE_POSIX;
     }
 
+    /* is user tried to select something, echo it back to confirm */
     if (mfu_rank == 0) {
         MFU_LOG(MFU_LOG_INFO, "%s: %s", varname, value);
     }
@@ -2860,912 +3258,1441 @@ static mfu_flist_archive_scan_algo select_scan_algo(void)
     return algo;
 }
 
-/* Given a path to an archive, scan archive to determine number
- * of entries and the byte offset to each one.
- * Returns MFU_SUCCESS if successful, MFU_FAILURE otherwise.
- * Records number of entries in out_count and returns a newly
- * allocated list of offset values in out_offsets if successful. */
-static int index_entries(
-    const char* filename,   /* name of archive to scan */
-    uint64_t* out_count,    /* number of entries found in archive (set if successful) */
-    uint64_t** out_offsets) /* list of byte offsets for each entry (if successful), caller must free */
+/* returns true if the data of the given item is written along with
+ * the headers, files larger than a chunk are instead split into
+ * chunks that are copied by all processes */
+static bool coalesce_file_data(mfu_flist flist, uint64_t idx, const mfu_archive_opts_t* opts)
 {
-    int r;
+    mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+    uint64_t size = mfu_flist_file_get_size(flist, idx);
+    return (type == MFU_TYPE_FILE && size <= (uint64_t) opts->chunk_size);
+}
 
-    /* assume we'll succeed */
+/* tracks the window of the archive being assembled in a staging buffer */
+typedef struct {
+    const char* filename; /* name of archive file */
+    int fd;               /* open file descriptor of archive for pwrite */
+    MPI_File fh;          /* open MPI file of archive for collective writes */
+    int collective;       /* whether to write with MPI_File_write_at_all */
+    char* buf;            /* staging buffer, holds one window */
+    uint64_t size;        /* size of a window in bytes */
+    uint64_t window;      /* id of window in buffer */
+    uint64_t lo;          /* offset of first byte we have in window */
+    uint64_t hi;          /* offset of last byte we have in window plus one */
+    uint64_t writes;      /* number of writes issued */
+} DTAR_stage_t;
+
+/* write the bytes we have in the current window to the archive,
+ * and clear the buffer for the next window */
+static int DTAR_stage_flush(DTAR_stage_t* stage)
+{
     int rc = MFU_SUCCESS;
 
-    /* indicate to user what phase we're in */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Indexing archive");
+    if (stage->hi <= stage->lo) {
+        return rc;
     }
 
-    /* have rank 0 scan archive to count up number of entries */
-    uint64_t count = 0;
-    uint64_t* offsets = NULL;
-    if (mfu_rank == 0) {
-        /* get file size so we can print percent progress as we scan */
-        uint64_t filesize = 0;
-        struct stat st;
-        int stat_rc = mfu_stat(filename, &st);
-        if (stat_rc == 0) {
-            /* stat succeeded, get the file size */
-            filesize = st.st_size;
-        } else {
-            /* failed to stat the archive file,
-             * we'll keep going, but progress messages will be disabled */
-            MFU_LOG(MFU_LOG_ERR, "Failed to stat archive %s (errno=%d %s)",
-                filename, errno, strerror(errno)
-            );
+    uint64_t start = stage->window * stage->size;
+    char* ptr = stage->buf + (stage->lo - start);
+    size_t len = (size_t)(stage->hi - stage->lo);
+
+    if (stage->collective) {
+        /* windows are at most MFU_ARCHIVE_CHUNK_MAX bytes,
+         * so the length fits in an int */
+        MPI_Status status;
+        int mpirc = MPI_File_write_at_all(stage->fh, (MPI_Offset) stage->lo,
+            ptr, (int) len, MPI_BYTE, &status);
+        if (mpirc != MPI_SUCCESS) {
+            char mpierrstr[MPI_MAX_ERROR_STRING];
+            int mpierrlen;
+            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+            MFU_LOG(MFU_LOG_ERR, "Failed to write to archive '%s' at offset %llu rc=%d %s",
+                stage->filename, (unsigned long long) stage->lo, mpirc, mpierrstr);
+            rc = MFU_FAILURE;
+        }
+    } else {
+        size_t written = 0;
+        while (written < len) {
+            ssize_t nwritten = mfu_pwrite(stage->filename, stage->fd, ptr + written,
+                len - written, (off_t)(stage->lo + written));
+            if (nwritten < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to write to archive '%s' at offset %llu errno=%d %s",
+                    stage->filename, (unsigned long long)(stage->lo + written), errno, strerror(errno));
+                rc = MFU_FAILURE;
+                break;
+            }
+            written += (size_t) nwritten;
         }
+    }
 
-        /* initiate archive object for reading */
-        struct archive* a = archive_read_new();
+    stage->writes++;
 
-        /* cannot index an archive that is compressed, only a pure tar format */
-//        archive_read_support_filter_bzip2(a);
-//        archive_read_support_filter_gzip(a);
-//        archive_read_support_filter_compress(a);
-        archive_read_support_format_tar(a);
+    /* clear the part of the buffer we used */
+    memset(ptr, 0, len);
+    stage->lo = 0;
+    stage->hi = 0;
 
-        /* read from stdin if not given a file? */
-        if (filename != NULL && strcmp(filename, "-") == 0) {
-            filename = NULL;
+    return rc;
+}
+
+/* compute the part of [start, end) that falls in the window holding start,
+ * flushing the current window first if start lies in a different window,
+ * returns the end of the part and sets ptr to its location in the buffer */
+static uint64_t DTAR_stage_range(
+    DTAR_stage_t* stage,
+    uint64_t start,
+    uint64_t end,
+    char** ptr,
+    int* rc)
+{
+    uint64_t window = start / stage->size;
+    if (window != stage->window) {
+        if (DTAR_stage_flush(stage) != MFU_SUCCESS) {
+            *rc = MFU_FAILURE;
         }
-    
-        /* just scanning through headers, so we use a smaller blocksize */
-        r = archive_read_open_filename(a, filename, 10240);
-        if (r != ARCHIVE_OK) {
-            /* failed to read archive, either file does not exist
-             * or it may be a format we don't support */
-            rc = MFU_FAILURE;
+        stage->window = window;
+    }
+
+    uint64_t window_end = (window + 1) * stage->size;
+    if (end > window_end) {
+        end = window_end;
+    }
+
+    if (stage->hi <= stage->lo) {
+        stage->lo = start;
+    }
+    stage->hi = end;
+
+    *ptr = stage->buf + (start - window * stage->size);
+    return end;
+}
+
+/* count the number of windows holding headers or coalesced data */
+static uint64_t count_coalesced_windows(
+    mfu_flist flist,
+    const uint64_t* header_sizes,
+    const uint64_t* entry_offsets,
+    const uint64_t* data_offsets,
+    uint64_t window_size,
+    mfu_archive_opts_t* opts)
+{
+    uint64_t count = 0;
+    uint64_t last = UINT64_MAX;
+
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    for (idx = 0; idx < size; idx++) {
+        if (header_sizes[idx] == 0) {
+            continue;
         }
 
-#if 0
-        /* TODO: scan for compression filters and bail out if we find any */
-        // see archive_filter_count/code calls to iterate over filters
-        int filter_count = archive_filter_count(a);
-        int i;
-        for (i = 0; i < filter_count; i++) {
-            uint64_t filter_bytes = archive_filter_bytes(a, i);
-            int filter_code = archive_filter_code(a, i);
-            const char* filter_name = archive_filter_name(a, i);
-            printf("bytes=%llu code=%d name=%s\n", filter_bytes, filter_code, filter_name);
+        uint64_t start = entry_offsets[idx];
+        uint64_t end   = data_offsets[idx];
+        if (coalesce_file_data(flist, idx, opts)) {
+            end += mfu_flist_file_get_size(flist, idx);
         }
-#endif
 
-        /* start timer for progress messages */
-        double start = MPI_Wtime();
-        double last = start;
-    
-        /* read entries one by one until we hit the EOF */
-        size_t maxcount = 1024;
-        offsets = (uint64_t*) malloc(maxcount * sizeof(uint64_t));
-        while (rc == MFU_SUCCESS) {
-            /* increase our buffer capacity if needed */
-            if (count >= maxcount) {
-                /* ran out of slots, double capacity and allocate again */
-                maxcount *= 2;
-                offsets = realloc(offsets, maxcount * sizeof(uint64_t));
-            }
+        uint64_t first = start / window_size;
+        uint64_t final = (end - 1) / window_size;
+        if (last != UINT64_MAX && first <= last) {
+            first = last + 1;
+        }
+        if (final >= first) {
+            count += final - first + 1;
+            last = final;
+        }
+    }
 
-            /* read header for the current entry */
-            struct archive_entry* entry;
-            r = archive_read_next_header(a, &entry);
-            if (r == ARCHIVE_EOF) {
-                /* found the end of the archive, we're done */
-                break;
+    return count;
+}
+
+/* Spread the entries we write with write_entries_coalesced evenly by
+ * the bytes of headers and coalesced data they put in the archive,
+ * rather than by item count, so a process that holds many small files
+ * does not write most of the archive while others hold directories.
+ * Each entry goes to the rank whose share of those bytes covers the
+ * bytes before it, so ranks still hold contiguous ranges of the
+ * archive in order.  Returns the new list and the header size, entry
+ * offset, and data offset of each of its items in newly allocated
+ * arrays. */
+static mfu_flist balance_coalesced(
+    mfu_flist flist,
+    const uint64_t* header_sizes,
+    const uint64_t* entry_offsets,
+    const uint64_t* data_offsets,
+    mfu_archive_opts_t* opts,
+    uint64_t** out_header_sizes,
+    uint64_t** out_entry_offsets,
+    uint64_t** out_data_offsets)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* sum bytes of headers and coalesced data of our entries */
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    uint64_t* bytes = (uint64_t*) MFU_MALLOC((size + 1) * sizeof(uint64_t));
+    uint64_t local = 0;
+    for (idx = 0; idx < size; idx++) {
+        bytes[idx] = 0;
+        if (header_sizes[idx] > 0) {
+            bytes[idx] = data_offsets[idx] - entry_offsets[idx];
+            if (coalesce_file_data(flist, idx, opts)) {
+                bytes[idx] += mfu_flist_file_get_size(flist, idx);
             }
-            if (r != ARCHIVE_OK) {
-                MFU_LOG(MFU_LOG_ERR, "Failed to read entry %s",
-                    archive_error_string(a)
-                );
-                rc = MFU_FAILURE;
-                break;
+        }
+        local += bytes[idx];
+    }
+
+    uint64_t total, before;
+    MPI_Allreduce(&local, &total, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Exscan(&local, &before, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        before = 0;
+    }
+
+    /* send each entry along with its offsets to its new rank */
+    size_t pack_size = mfu_flist_file_pack_size(flist);
+    char* item_buf = (char*) MFU_MALLOC(pack_size);
+    mfu_exchange ex;
+    mfu_exchange_init(&ex, MPI_COMM_WORLD);
+    for (idx = 0; idx < size; idx++) {
+        int dest = 0;
+        if (total > 0) {
+            dest = (int) ((double) before / (double) total * (double) ranks);
+            if (dest >= ranks) {
+                dest = ranks - 1;
             }
+        }
+        before += bytes[idx];
+
+        mfu_exchange_pack_u64(&ex, dest, header_sizes[idx]);
+        mfu_exchange_pack_u64(&ex, dest, entry_offsets[idx]);
+        mfu_exchange_pack_u64(&ex, dest, data_offsets[idx]);
+        size_t item_size = mfu_flist_file_pack(item_buf, flist, idx);
+        mfu_exchange_pack(&ex, dest, item_buf, item_size);
+    }
+    size_t recv_size;
+    char* recv = mfu_exchange_all(&ex, &recv_size);
+
+    /* entries arrive in order of the rank that sent them,
+     * so our new list is still in archive order, packed items
+     * vary in size, so size the arrays for the most we could get */
+    uint64_t max_count = (uint64_t) (recv_size / (3 * sizeof(uint64_t)));
+    uint64_t* hsizes = (uint64_t*) MFU_MALLOC((max_count + 1) * sizeof(uint64_t));
+    uint64_t* eoffs  = (uint64_t*) MFU_MALLOC((max_count + 1) * sizeof(uint64_t));
+    uint64_t* doffs  = (uint64_t*) MFU_MALLOC((max_count + 1) * sizeof(uint64_t));
+    mfu_flist newlist = mfu_flist_subset(flist);
+    const char* ptr = recv;
+    idx = 0;
+    while (ptr < recv + recv_size) {
+        mfu_unpack_uint64(&ptr, &hsizes[idx]);
+        mfu_unpack_uint64(&ptr, &eoffs[idx]);
+        mfu_unpack_uint64(&ptr, &doffs[idx]);
+        ptr += mfu_flist_file_unpack(ptr, newlist);
+        idx++;
+    }
+    mfu_flist_summarize(newlist);
+
+    mfu_free(&recv);
+    mfu_free(&item_buf);
+    mfu_free(&bytes);
+
+    *out_header_sizes  = hsizes;
+    *out_entry_offsets = eoffs;
+    *out_data_offsets  = doffs;
+    return newlist;
+}
 
-            /* get offset of this header */
-            uint64_t offset = (uint64_t) archive_read_header_position(a);
-            offsets[count] = offset;
+/* Write the headers of our entries, along with the data of small files.
+ * Entries are first spread by bytes with balance_coalesced.
+ * Our entries cover a contiguous range of the archive, which we assemble
+ * in a staging buffer one window at a time.  Windows are aligned to the
+ * chunk size, which is the stripe size we set on the archive, so each
+ * write covers at most one stripe and processes only share the stripes
+ * at the ends of their ranges.  Windows that only hold data of large
+ * files are skipped, and data of large files that falls in a window we
+ * write is left as zeros to be copied later. */
+static int write_entries_coalesced(
+    mfu_flist inlist,
+    const char* filename,
+    int fd,
+    const mfu_param_path* cwdpath,
+    void* header_buf,
+    size_t header_bufsize,
+    const uint64_t* in_header_sizes,
+    const uint64_t* in_entry_offsets,
+    const uint64_t* in_data_offsets,
+    mfu_archive_opts_t* opts)
+{
+    int rc = MFU_SUCCESS;
 
-            /* increment our count and move on to next entry */
-            count++;
+    /* even out the bytes each process writes */
+    uint64_t* header_sizes;
+    uint64_t* entry_offsets;
+    uint64_t* data_offsets;
+    mfu_flist flist = balance_coalesced(inlist, in_header_sizes, in_entry_offsets,
+        in_data_offsets, opts, &header_sizes, &entry_offsets, &data_offsets);
+
+    /* get write method */
+    mfu_flist_archive_write_algo algo = select_write_algo();
+
+    DTAR_stage_t stage;
+    stage.filename   = filename;
+    stage.fd         = fd;
+    stage.collective = (algo == WRITE_COLLECTIVE);
+    stage.size       = (uint64_t) opts->chunk_size;
+    if (stage.size > MFU_ARCHIVE_CHUNK_MAX) {
+        stage.size = MFU_ARCHIVE_CHUNK_MAX;
+    }
+    stage.window     = UINT64_MAX;
+    stage.lo         = 0;
+    stage.hi         = 0;
+    stage.writes     = 0;
+    stage.buf        = (char*) MFU_MALLOC((size_t) stage.size);
+    memset(stage.buf, 0, (size_t) stage.size);
+
+    /* with collective writes, every process must call write_at_all
+     * the same number of times, so compute the most writes any
+     * process needs */
+    uint64_t max_writes = 0;
+    if (stage.collective) {
+        uint64_t writes = count_coalesced_windows(flist, header_sizes,
+            entry_offsets, data_offsets, stage.size, opts);
+        MPI_Allreduce(&writes, &max_writes, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+        int mpirc = MPI_File_open(MPI_COMM_WORLD, (char*)filename, MPI_MODE_WRONLY, MPI_INFO_NULL, &stage.fh);
+        if (mpirc != MPI_SUCCESS) {
+            char mpierrstr[MPI_MAX_ERROR_STRING];
+            int mpierrlen;
+            MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
+            MFU_LOG(MFU_LOG_ERR, "Failed to open archive '%s' rc=%d %s",
+                filename, mpirc, mpierrstr);
+            rc = MFU_FAILURE;
+        }
+        if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+            mfu_free(&stage.buf);
+            mfu_free(&data_offsets);
+            mfu_free(&entry_offsets);
+            mfu_free(&header_sizes);
+            mfu_flist_free(&flist);
+            return MFU_FAILURE;
+        }
+    }
 
-            /* print progress message if needed */
-            double now = MPI_Wtime();
-            if (mfu_progress_timeout > 0 &&
-                (now - last) > mfu_progress_timeout &&
-                filesize > 0)
-            {
-                /* compute percent progress and estimated time remaining */
-                double percent = (double)offset * 100.0 / (double)filesize;
-                double secs = now - start;
-                double secs_remaining = 0.0;
-                if (percent > 0.0) {
-                    secs_remaining = (double)(100.0 - percent) * secs / percent;
+    /* count bytes of data we write for progress messages */
+    uint64_t data_bytes = 0;
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    for (idx = 0; idx < size; idx++) {
+        if (coalesce_file_data(flist, idx, opts)) {
+            data_bytes += mfu_flist_file_get_size(flist, idx);
+        }
+    }
+    MPI_Allreduce(&data_bytes, &DTAR_total_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    reduce_buf[REDUCE_BYTES] = 0;
+    mfu_progress* create_prog = mfu_progress_start(mfu_progress_timeout, 1, MPI_COMM_WORLD, create_progress_fn);
+
+    /* initialize file cache for opening source files */
+    mfu_archive_src_cache.name = NULL;
+
+    for (idx = 0; idx < size; idx++) {
+        /* we currently only support regular files, directories, and symlinks */
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+        if (type != MFU_TYPE_FILE && type != MFU_TYPE_DIR && type != MFU_TYPE_LINK) {
+            /* print a warning that we did not archive this item */
+            MFU_LOG(MFU_LOG_WARN, "Unsupported type, cannot archive `%s'", name);
+            continue;
+        }
+
+        /* encode header for this entry */
+        size_t header_size;
+        int encode_rc = encode_header(flist, idx, cwdpath,
+            header_buf, header_bufsize, opts, &header_size);
+        if (encode_rc != MFU_SUCCESS || header_size != header_sizes[idx]) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to encode header for `%s'", name);
+            rc = MFU_FAILURE;
+            continue;
+        }
+
+        /* copy header into staging buffer, it may span windows */
+        uint64_t pos = entry_offsets[idx];
+        uint64_t end = pos + header_size;
+        while (pos < end) {
+            char* ptr;
+            uint64_t part_end = DTAR_stage_range(&stage, pos, end, &ptr, &rc);
+            memcpy(ptr, (char*)header_buf + (pos - entry_offsets[idx]), (size_t)(part_end - pos));
+            pos = part_end;
+        }
+
+        /* copy data of small files into staging buffer,
+         * the padding that follows the data is already zero */
+        if (! coalesce_file_data(flist, idx, opts)) {
+            continue;
+        }
+        uint64_t filesize = mfu_flist_file_get_size(flist, idx);
+        if (filesize == 0) {
+            continue;
+        }
+        if (mfu_archive_open_file(name, 1, 0, opts->open_noatime, &mfu_archive_src_cache) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open source file '%s' errno=%d %s",
+                name, errno, strerror(errno));
+            rc = MFU_FAILURE;
+            continue;
+        }
+        int in_fd = mfu_archive_src_cache.fd;
+
+        pos = data_offsets[idx];
+        end = pos + filesize;
+        while (pos < end) {
+            char* ptr;
+            uint64_t part_end = DTAR_stage_range(&stage, pos, end, &ptr, &rc);
+
+            /* read this part of the file */
+            uint64_t done = 0;
+            uint64_t len = part_end - pos;
+            off_t file_pos = (off_t)(pos - data_offsets[idx]);
+            while (done < len) {
+                ssize_t nread = mfu_pread(name, in_fd, ptr + done, (size_t)(len - done),
+                    file_pos + (off_t) done);
+                if (nread < 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to read source file '%s' errno=%d %s",
+                        name, errno, strerror(errno));
+                    rc = MFU_FAILURE;
+                    break;
                 }
-                MFU_LOG(MFU_LOG_INFO, "Indexed %llu items in %.3lf secs (%.0f%%) %.0f secs left ...",
-                    count, secs, percent, secs_remaining
-                );
-                last = now;
+                if (nread == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Source file '%s' shrank while creating archive", name);
+                    rc = MFU_FAILURE;
+                    break;
+                }
+                done += (uint64_t) nread;
             }
-        }
 
-        /* print a final progress message if we may have printed any */
-        double now = MPI_Wtime();
-        double secs = now - start;
-        if (rc == MFU_SUCCESS &&
-            mfu_progress_timeout > 0 &&
-            secs > mfu_progress_timeout)
-        {
-            MFU_LOG(MFU_LOG_INFO, "Indexed %llu items in %.3lf secs (100%%) done",
-                count, secs
-            );
+            reduce_buf[REDUCE_BYTES] += done;
+            mfu_progress_update(reduce_buf, create_prog);
+
+            pos = part_end;
         }
+    }
 
-        /* close our read archive to clean up */
-        archive_read_close(a);
-        archive_read_free(a);
+    /* write the last window */
+    if (DTAR_stage_flush(&stage) != MFU_SUCCESS) {
+        rc = MFU_FAILURE;
     }
-   
-    /* broadcast whether rank 0 actually read archive successfully */
-    MPI_Bcast(&rc, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
-    /* bail out if rank 0 failed to index the archive */
+    /* participate in collective writes of other processes */
+    if (stage.collective) {
+        while (stage.writes < max_writes) {
+            MPI_Status status;
+            MPI_File_write_at_all(stage.fh, 0, stage.buf, 0, MPI_BYTE, &status);
+            stage.writes++;
+        }
+        MPI_File_close(&stage.fh);
+    }
+
+    /* finalize progress messages */
+    mfu_progress_complete(reduce_buf, &create_prog);
+
+    /* done reading, close any source file that is still open */
+    mfu_archive_close_file(&mfu_archive_src_cache);
+
+    mfu_free(&stage.buf);
+    mfu_free(&data_offsets);
+    mfu_free(&entry_offsets);
+    mfu_free(&header_sizes);
+    mfu_flist_free(&flist);
+
     if (rc != MFU_SUCCESS) {
-        mfu_free(&offsets);
-        return rc;
+        DTAR_err = 1;
     }
+    return rc;
+}
 
-    /* get count of items from rank 0 */
-    MPI_Bcast(&count, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+/****************************************
+ * Append and update
+ ***************************************/
 
-    /* allocate memory to holding incoming offset values */
-    if (mfu_rank != 0) {
-        offsets = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t));
+/* reads headers of existing entries into flist, defined with extraction */
+static int extract_flist_offsets(
+    const char* filename,
+    const mfu_param_path* cwdpath,
+    uint64_t entries,
+    uint64_t entry_start,
+    uint64_t entry_count,
+    uint64_t* offsets,
+    uint64_t** data_offsets,
+    mfu_flist flist);
+
+/* given the offset to the data of the last entry in the index and the
+ * size of that data, compute the offset just past the last entry, which
+ * is where new entries are written, and check that the archive ends
+ * there, apart from an index entry written by dtar and blocks of zeros,
+ * so that we do not overwrite data that dtar does not know about */
+static int archive_entries_end(
+    const char* filename,  /* name of archive file */
+    uint64_t entries,      /* number of entries in index */
+    uint64_t data_offset,  /* offset to data of last entry in index */
+    uint64_t data_size,    /* size of data of last entry in index */
+    uint64_t* out_end)     /* returns offset past last entry */
+{
+    int rc = MFU_FAILURE;
+
+    /* entries end after the data of the last one, padded to a block */
+    uint64_t end = 0;
+    if (entries > 0) {
+        end = data_offset + (data_size + 511) / 512 * 512;
     }
 
-    /* get offset values from rank 0 */
-    MPI_Bcast(offsets, count, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (mfu_rank == 0) {
+        int fd = mfu_open(filename, O_RDONLY);
+        if (fd >= 0) {
+            off_t file_size = mfu_lseek(filename, fd, 0, SEEK_END);
 
-    /* return count and list of offsets */
-    *out_count   = count;
-    *out_offsets = offsets;
+            /* skip past an index entry that dtar wrote after the entries,
+             * its footer sits just before the two trailing blocks */
+            uint64_t zeros = end;
+            size_t footer_size = 6 * sizeof(uint64_t);
+            uint64_t footer[6];
+            off_t footer_pos = file_size - 2 * 512 - (off_t) footer_size;
+            if (footer_pos >= (off_t) end &&
+                mfu_pread(filename, fd, footer, footer_size, footer_pos) == (ssize_t) footer_size &&
+                mfu_ntoh64(footer[5]) == DTAR_MAGIC && mfu_ntoh64(footer[4]) == 1 &&
+                mfu_ntoh64(footer[1]) == end &&
+                end + mfu_ntoh64(footer[3]) == (uint64_t) file_size - 2 * 512)
+            {
+                zeros = (uint64_t) file_size - 2 * 512;
+            }
 
-    return rc; 
-}
+            /* the rest must be the end of archive blocks */
+            if (file_size >= 0 && (uint64_t) file_size >= zeros + 2 * 512) {
+                rc = MFU_SUCCESS;
+            }
+            char buf[4096];
+            uint64_t pos = zeros;
+            while (rc == MFU_SUCCESS && pos < (uint64_t) file_size) {
+                size_t len = sizeof(buf);
+                if ((uint64_t) len > (uint64_t) file_size - pos) {
+                    len = (size_t) ((uint64_t) file_size - pos);
+                }
+                if (mfu_pread(filename, fd, buf, len, (off_t) pos) != (ssize_t) len) {
+                    rc = MFU_FAILURE;
+                    break;
+                }
+                size_t i;
+                for (i = 0; i < len; i++) {
+                    if (buf[i] != 0) {
+                        rc = MFU_FAILURE;
+                        break;
+                    }
+                }
+                pos += (uint64_t) len;
+            }
 
-/* TODO: This algorithm only works correctly on well-formed archive files.
- * Archive files can contain other archive files as constiuent entries.
- * By searching for the first "ustar" string we can find, it's possible that
- * we'll first lock in on an entry inside on of these internal archive files.
- * If all of those internal archives are well-formed, the scan that computes
- * the max file offset will skip over those internal archives, since the
- * outer archive fully contains the inner archives.  However, if an inner
- * is not well formed (e.g., a large inner archive was truncated, but still
- * has a complete header), it's possible the offset we compute from the
- * header on the inner archive will be larger than the offset for the next
- * entry in the outer archive, which will mess up the algorithm.  An
- * improved scan operation may be able to fix this, though we may need to
- * search for *all* ustar strings within the memory range.  This algorithm
- * shouldn't really be used in production until that has been fixed.
- * For now, we leave this here for testing purposes.
- * We could also offer it if the user trusts that any internal archives
- * are all well-formed. */
+            mfu_close(filename, fd);
+        }
 
-static int index_entries_distread_parallelscan(
-    const char* filename,
-    char* buf,
-    size_t bufsize,
-    uint64_t overlap_before,
-    uint64_t offset_start,
-    uint64_t offset_last,
-    uint64_t file_size,
-    uint64_t* out_starting_pos,
-    uint64_t* out_count,
-    uint64_t** out_offsets)
+        if (rc != MFU_SUCCESS) {
+            MFU_LOG(MFU_LOG_ERR, "Archive '%s' has data after its last indexed entry, "
+                "can only append to archives written by dtar", filename);
+        }
+    }
+
+    MPI_Bcast(&rc, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    *out_end = end;
+    return rc;
+}
+
+/* To decide which items to add to an archive, we send a record for
+ * each existing entry and each walked item to the process chosen by
+ * hashing its name, the name follows the record, padded to 8 bytes */
+typedef struct {
+    uint64_t kind;  /* DTAR_APPEND_ENTRY or DTAR_APPEND_ITEM */
+    uint64_t index; /* global index of entry in index or of item in list */
+    uint64_t mtime; /* mtime in seconds */
+    uint64_t size;  /* size in bytes */
+    uint64_t extra; /* number of bytes that follow, padded to 8 */
+} DTAR_append_rec_t;
+
+#define DTAR_APPEND_ENTRY (1)
+#define DTAR_APPEND_ITEM  (2)
+
+/* pack a record followed by name for process dest,
+ * name may be NULL for a record without one */
+static void DTAR_append_rec_pack(
+    mfu_exchange* ex,
+    int dest,
+    uint64_t kind,
+    uint64_t index,
+    uint64_t mtime,
+    uint64_t size,
+    const char* name)
 {
-    int rc = MFU_SUCCESS;
+    size_t len = (name != NULL) ? strlen(name) + 1 : 0;
+    size_t padded = (len + 7) / 8 * 8;
+
+    DTAR_append_rec_t rec;
+    rec.kind  = kind;
+    rec.index = index;
+    rec.mtime = mtime;
+    rec.size  = size;
+    rec.extra = (uint64_t) padded;
+    mfu_exchange_pack(ex, dest, &rec, sizeof(rec));
+
+    if (padded > 0) {
+        char pad[8] = {0};
+        mfu_exchange_pack(ex, dest, name, len);
+        mfu_exchange_pack(ex, dest, pad, padded - len);
+    }
+}
 
-    /* get our rank and the number of ranks in our communicator */
+/* given an existing archive and a list of walked items, returns a new
+ * list of items that are not in the archive, or with update set, that
+ * changed since they were archived (different mtime or size), along
+ * with the offset past the last entry of the archive, on rank 0, also
+ * returns offsets of existing entries to keep in the index, which
+ * omits entries that are replaced by newer copies */
+static int archive_append_select(
+    mfu_flist flist,               /* list of walked items */
+    const char* filename,          /* name of existing archive file */
+    const mfu_param_path* cwdpath, /* current working dir, to build full path of entries */
+    mfu_archive_opts_t* opts,      /* archive options */
+    uint64_t* out_end,             /* returns offset past last entry in archive */
+    uint64_t* out_keep_count,      /* returns number of entries to keep in index (rank 0) */
+    uint64_t** out_keep_offsets,   /* returns offsets of entries to keep in index (rank 0) */
+    mfu_flist* out_flist)          /* returns list of items to add to archive */
+{
     int rank, ranks;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-    /* file offset of the first byte in our read buffer */
-    uint64_t pos = offset_start - overlap_before;
+    /* we need the index to find existing entries */
+    uint64_t entries = 0;
+    uint64_t* offsets = NULL;
+    int rc = read_entry_index(filename, &entries, &offsets);
+    if (rc != MFU_SUCCESS) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read index of archive '%s', "
+                "can only append to uncompressed archives created by dtar", filename);
+        }
+        return MFU_FAILURE;
+    }
 
-    /* each process scans for entries in its overlap and its region,
-     * recording the max offset that should point to a valid entry */
-    uint64_t max_offset = 0;
-    char* ptr = buf;
-    char* ptr_end = ptr + bufsize;
-    while (ptr < ptr_end) {
-        /* scan for the next "ustar" string we can find,
-         * note that this might not really be a valid entry
-         * even if we find the string */
-        size_t bytes_remaining = ptr_end - ptr;
-        char* ptr_found = (char*) memmem(ptr, bytes_remaining, "ustar", strlen("ustar"));
-        if (ptr_found == NULL) {
-            /* no "ustar" found in the rest of the buffer */
-            break;
-        }
-
-        /* found a potential entry, check that we have enough bytes
-         * to read a full header, the "ustar" string starts at offset 257
-         * in the header:
-         * https://en.wikipedia.org/wiki/Tar_(computing)#UStar_format */
-        uint64_t offset = (uint64_t)(ptr_found - ptr);
-        if (offset < 257) {
-            /* we don't have enough bytes before this string to even try,
-             * skip past this instance and try the next one */
-            ptr = ptr_found + strlen("ustar");
-            continue;
-        }
-
-        /* "ustar" string is at least 257 bytes into the buffer,
-         * back up to what should be the start of the header */
-        char* ptr_start = ptr_found - 257;
+    /* read names, mtimes, and sizes of existing entries */
+    uint64_t entry_start, entry_count;
+    mfu_get_start_count(rank, ranks, entries, &entry_start, &entry_count);
+    uint64_t* data_offsets = NULL;
+    mfu_flist oldlist = mfu_flist_new();
+    rc = extract_flist_offsets(filename, cwdpath, entries, entry_start, entry_count,
+        offsets, &data_offsets, oldlist);
+    if (rc != MFU_SUCCESS) {
+        mfu_free(&data_offsets);
+        mfu_flist_free(&oldlist);
+        mfu_free(&offsets);
+        return MFU_FAILURE;
+    }
 
-        /* create a new archive object for reading */
-        struct archive* a = archive_read_new();
-        archive_read_support_format_tar(a);
+    /* get size of data of the last entry from the process that read it */
+    uint64_t oldsize = mfu_flist_size(oldlist);
+    uint64_t last_size = 0;
+    if (oldsize > 0 && entry_start + oldsize == entries) {
+        last_size = mfu_flist_file_get_size(oldlist, oldsize - 1);
+    }
+    uint64_t all_last_size;
+    MPI_Allreduce(&last_size, &all_last_size, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
 
-        /* initialize archive object at start of the header */
-        uint64_t buf_offset = (uint64_t)(ptr_start - buf);
-        uint64_t bufsize_remaining = bufsize - buf_offset;
-        int r = archive_read_open_memory(a, ptr_start, bufsize_remaining);
-        if (r != ARCHIVE_OK) {
-            /* failed to process this location as a valid archive,
-             * skip past this instance of the ustar string and try the next one */
-            archive_read_free(a);
-            ptr = ptr_found + strlen("ustar");
-            continue;
-        }
+    /* find where new entries should be written */
+    uint64_t end;
+    uint64_t last_offset = (entries > 0) ? data_offsets[entries - 1] : 0;
+    rc = archive_entries_end(filename, entries, last_offset, all_last_size, &end);
+    mfu_free(&data_offsets);
+    if (rc != MFU_SUCCESS) {
+        mfu_flist_free(&oldlist);
+        mfu_free(&offsets);
+        return MFU_FAILURE;
+    }
 
-        /* we opened an archive, march through its entries for as
-         * long as we can */
-        ptr = ptr_start;
-        int found_one = 0;
-        while (1) {
-            /* read header of next entry from archive */
-            struct archive_entry* entry;
-            int r = archive_read_next_header(a, &entry);
-            if (r == ARCHIVE_EOF) {
-                /* hit end of the archive, compute size of "end-of-archive" marker */
-                uint64_t eof_start = (uint64_t) archive_read_header_position(a);
-                uint64_t eof_end   = (uint64_t) archive_filter_bytes(a, -1);
-                uint64_t eof_size  = eof_end - eof_start;
+    /* indicate to user what phase we're in */
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Comparing items to %llu entries in %s",
+            (unsigned long long) entries, filename);
+    }
 
-                /* advance past "end-of-archive" marker
-                 * in case another archive starts just beyond */
-                ptr += eof_size;
+    /* get full path to archive and its index file so that
+     * we do not add those to the archive if we walked them */
+    mfu_path* path = mfu_path_from_str(filename);
+    if (! mfu_path_is_absolute(path)) {
+        mfu_path_prepend_str(path, cwdpath->path);
+    }
+    mfu_path_reduce(path);
+    char* archive_name = mfu_path_strdup(path);
+    char* index_name = archive_index_filename(archive_name);
+    mfu_path_delete(&path);
 
-                /* compute file offset to start of next archive, if any */
-                max_offset = pos + buf_offset + eof_start + eof_size;
+    /* send records of existing entries and walked items by name */
+    mfu_exchange records;
+    mfu_exchange_init(&records, MPI_COMM_WORLD);
+    uint64_t idx;
+    for (idx = 0; idx < oldsize; idx++) {
+        const char* name = mfu_flist_file_get_name(oldlist, idx);
+        int dest = (int) (mfu_hash_jenkins(name, strlen(name)) % (uint32_t) ranks);
+        DTAR_append_rec_pack(&records, dest, DTAR_APPEND_ENTRY, entry_start + idx,
+            mfu_flist_file_get_mtime(oldlist, idx),
+            mfu_flist_file_get_size(oldlist, idx), name);
+    }
 
-                break;
-            }
-            if (r != ARCHIVE_OK) {
-                /* We can get an error if a header happens to be split
-                 * by a boundardy, so we don't consider this fatal but move
-                 * on to the next rank to see if it has better luck.
-                 * If this is actually a corrupt entry, then the rank
-                 * following us will also fail trying to process it */
-                if (! found_one) {
-                    /* failed to process the first entry in the archive,
-                     * so skip past this "ustar" instance on to the next */
-                    ptr = ptr_found + strlen("ustar");
+    uint64_t item_start = mfu_flist_global_offset(flist);
+    uint64_t listsize = mfu_flist_size(flist);
+    for (idx = 0; idx < listsize; idx++) {
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        if (strcmp(name, archive_name) == 0 || strcmp(name, index_name) == 0) {
+            continue;
+        }
+        int dest = (int) (mfu_hash_jenkins(name, strlen(name)) % (uint32_t) ranks);
+        DTAR_append_rec_pack(&records, dest, DTAR_APPEND_ITEM, item_start + idx,
+            mfu_flist_file_get_mtime(flist, idx),
+            mfu_flist_file_get_size(flist, idx), name);
+    }
+
+    mfu_free(&index_name);
+    mfu_free(&archive_name);
+    mfu_flist_free(&oldlist);
+
+    size_t recv_size;
+    char* recv = mfu_exchange_all(&records, &recv_size);
+
+    /* index the existing entries we received by name,
+     * recording the position of their record */
+    strmap* map = strmap_new();
+    size_t pos = 0;
+    while (pos < recv_size) {
+        const DTAR_append_rec_t* p = (const DTAR_append_rec_t*)(recv + pos);
+        if (p->kind == DTAR_APPEND_ENTRY) {
+            const char* name = recv + pos + sizeof(DTAR_append_rec_t);
+            char value[32];
+            snprintf(value, sizeof(value), "%llu", (unsigned long long) pos);
+            strmap_set(map, name, value);
+        }
+        pos += sizeof(DTAR_append_rec_t) + (size_t) p->extra;
+    }
+
+    /* get global index of first item on each process,
+     * so we can send decisions back to the owner of each item */
+    uint64_t* item_starts = (uint64_t*) MFU_MALLOC((ranks + 1) * sizeof(uint64_t));
+    MPI_Allgather(&item_start, 1, MPI_UINT64_T, item_starts, 1, MPI_UINT64_T, MPI_COMM_WORLD);
+    item_starts[ranks] = UINT64_MAX;
+
+    /* decide which items to add, send items to add back to their owner,
+     * and send entries that are replaced to rank 0 to drop from index */
+    mfu_exchange replies;
+    mfu_exchange_init(&replies, MPI_COMM_WORLD);
+    pos = 0;
+    while (pos < recv_size) {
+        const DTAR_append_rec_t* p = (const DTAR_append_rec_t*)(recv + pos);
+        if (p->kind == DTAR_APPEND_ITEM) {
+            const char* name = recv + pos + sizeof(DTAR_append_rec_t);
+            const char* value = strmap_get(map, name);
+
+            bool add = false;
+            if (value == NULL) {
+                /* item is not in the archive */
+                add = true;
+            } else if (opts->update) {
+                /* item is in the archive, add it if it changed */
+                size_t old_pos = (size_t) strtoull(value, NULL, 10);
+                const DTAR_append_rec_t* old = (const DTAR_append_rec_t*)(recv + old_pos);
+                if (old->mtime != p->mtime || old->size != p->size) {
+                    add = true;
+                    DTAR_append_rec_pack(&replies, 0, DTAR_APPEND_ENTRY, old->index, 0, 0, NULL);
                 }
-                break;
             }
 
-            /* remember that we processed one entry */
-            found_one = 1;
-
-            /* got a valid entry, record offset of this header */
-            uint64_t header_offset = (uint64_t) archive_read_header_position(a);
-
-            /* get current byte position following the header,
-             * which will be start of data for a regular file */
-            uint64_t data_offset = (uint64_t) archive_filter_bytes(a, -1);
+            if (add) {
+                /* find process owning this item */
+                int owner = 0;
+                while (owner + 1 < ranks && item_starts[owner + 1] <= p->index) {
+                    owner++;
+                }
+                DTAR_append_rec_pack(&replies, owner, DTAR_APPEND_ITEM, p->index, 0, 0, NULL);
+            }
+        }
+        pos += sizeof(DTAR_append_rec_t) + (size_t) p->extra;
+    }
 
-            /* compute size of data segment for the entry based on its size
-             * and any necessary padding */
-            uint64_t data_size = archive_entry_size(entry);
-            uint64_t data_size_padded = get_filesize_padded(data_size);
+    strmap_delete(&map);
+    mfu_free(&item_starts);
+    mfu_free(&recv);
 
-            /* compute byte offset within archive for start of next entry */
-            max_offset = pos + buf_offset + data_offset + data_size_padded;
+    recv = mfu_exchange_all(&replies, &recv_size);
 
-            /* advance our pointer past the current entry */
-            uint64_t header_size = data_offset - header_offset;
-            uint64_t entry_size = header_size + data_size_padded;
-            ptr += entry_size;
+    /* mark the items we add and the entries we drop */
+    uint8_t* selected = (uint8_t*) MFU_MALLOC((size_t) listsize + 1);
+    memset(selected, 0, (size_t) listsize);
+    uint8_t* dropped = NULL;
+    if (rank == 0) {
+        dropped = (uint8_t*) MFU_MALLOC((size_t) entries + 1);
+        memset(dropped, 0, (size_t) entries);
+    }
+    uint64_t drop_count = 0;
+    pos = 0;
+    while (pos < recv_size) {
+        const DTAR_append_rec_t* p = (const DTAR_append_rec_t*)(recv + pos);
+        if (p->kind == DTAR_APPEND_ITEM) {
+            selected[p->index - item_start] = 1;
+        } else {
+            dropped[p->index] = 1;
+            drop_count++;
         }
+        pos += sizeof(DTAR_append_rec_t) + (size_t) p->extra;
+    }
+    mfu_free(&recv);
 
-        /* Done reading from this archive, close it out.
-         * Note that we keep going until we process our entire
-         * read buffer.  It could be that we just scanned through
-         * a tar archive nested within another archive. */
-        archive_read_close(a);
-        archive_read_free(a);
+    /* build list of items to add, in the order we have them */
+    mfu_flist addlist = mfu_flist_subset(flist);
+    for (idx = 0; idx < listsize; idx++) {
+        if (selected[idx]) {
+            mfu_flist_file_copy(flist, idx, addlist);
+        }
     }
+    mfu_flist_summarize(addlist);
+    mfu_free(&selected);
 
-    /* get maximum offset from all ranks before us to use as our starting position */
-    uint64_t starting_pos = 0;
-    MPI_Exscan(&max_offset, &starting_pos, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+    /* rank 0 records offsets of entries to keep in index */
+    uint64_t keep_count = 0;
+    uint64_t* keep_offsets = NULL;
     if (rank == 0) {
-        starting_pos = *out_starting_pos;
+        keep_offsets = (uint64_t*) MFU_MALLOC((size_t) entries * sizeof(uint64_t) + 1);
+        for (idx = 0; idx < entries; idx++) {
+            if (! dropped[idx]) {
+                keep_offsets[keep_count] = offsets[idx];
+                keep_count++;
+            }
+        }
     }
+    mfu_free(&dropped);
+    mfu_free(&offsets);
 
-    /* TODO: also record entry sizes, add to headers, and then check that starting
-     * position on each rank matches where the rank before left off */
+    /* report what we found */
+    uint64_t add_total = mfu_flist_global_size(addlist);
+    MPI_Bcast(&drop_count, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Adding %llu items, replacing %llu entries",
+            (unsigned long long) add_total, (unsigned long long) drop_count);
+    }
 
-    /* advance file position to offset based on our starting offset */
-    pos = starting_pos;
+    *out_end          = end;
+    *out_keep_count   = keep_count;
+    *out_keep_offsets = keep_offsets;
+    *out_flist        = addlist;
+    return MFU_SUCCESS;
+}
 
-    /* variables to count number of entries we find,
-     * and byte offset within archive for each one,
-     * start with 1024 entries, we'll grow this list of offsets as needed */
-    uint64_t count = 0;
-    size_t maxcount = 1024;
-    uint64_t* offsets = (uint64_t*) malloc(maxcount * sizeof(uint64_t));
+typedef enum {
+    CREATE_DEFAULT,  /* attempt to dynamically choose best option */
+    CREATE_CHUNK,    /* direct write of data, chunk list */
+    CREATE_LIBCIRCLE /* direct write of data, chunk list to init libcircle */
+} mfu_flist_archive_create_algo;
 
-    /* so long as starting position does not lie past our region,
-     * and so long as we have not already hit an error, process any
-     * entries from our region of the file */
-    int break_outer = 0;
-    while (bufsize > 0 && pos < offset_last && rc == MFU_SUCCESS && !break_outer) {
-        /* initiate archive object for reading */
-        struct archive* a = archive_read_new();
+static mfu_flist_archive_create_algo select_create_algo(void)
+{
+    mfu_flist_archive_create_algo algo = CREATE_DEFAULT;
 
-        /* we want all the format supports */
-//        archive_read_support_filter_bzip2(a);
-//        archive_read_support_filter_gzip(a);
-//        archive_read_support_filter_compress(a);
-        archive_read_support_format_tar(a);
+    /* see if the user is trying to request a specific create algorithm */
+    const char varname[] = "MFU_FLIST_ARCHIVE_CREATE";
+    const char* value = getenv(varname);
+    if (value == NULL) {
+        return algo;
+    }
 
-        /* count number of bytes we may be starting before or after the start
-         * of our assigned region, which may be positive or negative */
-        int64_t adjustment = (int64_t)pos - (int64_t)offset_start;
-        if ((int64_t)overlap_before + adjustment >= 0) {
-            /* compute position within our buffer and initializes our
-             * archive reader at that particular offset */
-            char* ptr = buf + (int64_t)overlap_before + adjustment;
-            uint64_t bufsize_remaining = bufsize - (uint64_t)(ptr - buf);
-            int r = archive_read_open_memory(a, ptr, bufsize_remaining);
-            if (r != ARCHIVE_OK) {
-                MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(a));
-                rc = MFU_FAILURE;
-            }
-        } else {
-            /* We're trying to read from a part of the file that comes before
-             * our overlap region.  This might happen if rank before hit
-             * an early EOF while processing its region the archive */
-            MFU_LOG(MFU_LOG_ERR, "Early end of file in archive '%s'", filename);
-            rc = MFU_FAILURE;
+    /* user is trying to request a specific algorithm */
+    if (strcmp(value, "DEFAULT") == 0) {
+        algo = CREATE_DEFAULT;
+    } else if (strcmp(value, "CHUNK") == 0) {
+        algo = CREATE_CHUNK;
+    } else if (strcmp(value, "LIBCIRCLE") == 0) {
+        algo = CREATE_LIBCIRCLE;
+    } else {
+        /* value does not match any known algorithm name,
+         * print an error and fall back to default */
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "%s: unknown value %s", varname, value);
         }
+        value = "DEFAULT";
+        algo = CREATE_DEFAULT;
+    }
 
-        /* Skip through entries in our buffer, counting them
-         * and recording their byte offset within the file as
-         * we go. */
-        while (pos < offset_last && rc == MFU_SUCCESS) {
-            /* increase our buffer capacity if needed */
-            if (count >= maxcount) {
-                /* ran out of slots, double capacity and allocate again */
-                maxcount *= 2;
-                offsets = realloc(offsets, maxcount * sizeof(uint64_t));
-            }
+    /* is user tried to select something, echo it back to confirm */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "%s: %s", varname, value);
+    }
 
-            /* read next item from archive */
-            struct archive_entry* entry;
-            int r = archive_read_next_header(a, &entry);
-            if (r == ARCHIVE_EOF) {
-                /* hit end of the archive, compute size of "end-of-archive" marker,
-                 * and advance past it */
-                uint64_t eof_start = (uint64_t) archive_read_header_position(a);
-                uint64_t eof_end   = (uint64_t) archive_filter_bytes(a, -1);
-                pos += (eof_end - eof_start);
-                break;
-            }
-            if (r != ARCHIVE_OK) {
-                /* We can get an error if a header happens to split
-                 * a boundardy, so don't consider this fatal but move
-                 * on to the next rank to see if it has better luck.
-                 * If it actually is a corrupt entry, then the rank
-                 * following us will also fail trying to process it */
-                if (offset_last == file_size) {
-                    /* our section of the file runs to the end,
-                     * so this must be an actual error */
-                    rc = MFU_FAILURE;
-                }
+    return algo;
+}
 
-                /* break the outer loop to pass the ball to the next rank */
-                break_outer = 1;
-                break;
-            }
+int mfu_flist_archive_create(
+    mfu_flist inflist,
+    const char* filename,
+    int numpaths,
+    const mfu_param_path* paths,
+    const mfu_param_path* cwdpath,
+    mfu_archive_opts_t* opts)
+{
+    /* assume we'll succeed */
+    int rc = MFU_SUCCESS;
 
-            /* got a valid entry, record offset of this header */
-            uint64_t header_offset = (uint64_t) archive_read_header_position(a);
-            offsets[count] = starting_pos + header_offset;
+    /* chunks are passed to bzip2 and MPI with int-sized lengths */
+    if (opts->chunk_size > MFU_ARCHIVE_CHUNK_MAX) {
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Chunk size %llu exceeds limit of %llu bytes",
+                (unsigned long long) opts->chunk_size, (unsigned long long) MFU_ARCHIVE_CHUNK_MAX);
+        }
+        return MFU_FAILURE;
+    }
 
-            /* get current byte position following the header,
-             * which will be start of data for a regular file */
-            uint64_t buffer_offset = (uint64_t) archive_filter_bytes(a, -1);
+    /* allow override algorithm choice via environment variable */
+    mfu_flist_archive_create_algo algo = select_create_algo();
+    if (algo == CREATE_LIBCIRCLE) {
+        opts->create_libcircle = 1;
+    } else {
+        opts->create_libcircle = 0;
+    }
 
-            /* compute size of data segment for the entry based on its size
-             * and any necessary padding */
-            uint64_t data_size = archive_entry_size(entry);
-            uint64_t data_size_padded = get_filesize_padded(data_size);
+    /* print note about what we're doing and the amount of files/data to be moved */
+    if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Writing archive to %s", filename);
+    }
 
-            /* get position for start of next entry */
-            pos = starting_pos + buffer_offset + data_size_padded;
+    /* print summary of item and byte count of items to be archived */
+    mfu_flist_print_summary(inflist);
 
-            /* advance to the next item */
-            count++;
+    /* start overall timer */
+    time_t time_started;
+    time(&time_started);
+    double wtime_started = MPI_Wtime();
+
+    /* when appending, find where the existing entries end, which of them
+     * to keep in the index, and which items to add to the archive */
+    uint64_t append_end = 0;
+    uint64_t keep_count = 0;
+    uint64_t* keep_offsets = NULL;
+    mfu_flist addlist = inflist;
+    if (opts->append) {
+        if (opts->compress) {
+            if (mfu_rank == 0) {
+                MFU_LOG(MFU_LOG_ERR, "Cannot append to a compressed archive");
+            }
+            return MFU_FAILURE;
         }
+        int append_rc = archive_append_select(inflist, filename, cwdpath, opts,
+            &append_end, &keep_count, &keep_offsets, &addlist);
+        if (append_rc != MFU_SUCCESS) {
+            return MFU_FAILURE;
+        }
+    }
 
-        /* done reading the archive, so free resources */
-        archive_read_close(a);
-        archive_read_free(a);
+    /* sort items alphabetically, so they are placed in the archive with parent directories
+     * coming before their children */
+    mfu_flist flist = mfu_flist_sort("name", addlist);
+    if (addlist != inflist) {
+        mfu_flist_free(&addlist);
     }
 
-    /* get maximum offset from all ranks before us to use as our starting position */
-    uint64_t max_pos = 0;
-    MPI_Allreduce(&pos, &max_pos, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
-    *out_starting_pos = max_pos;
+    /* we'll flip this to 1 if any process hits any error writing the archive */
+    DTAR_err = 0;
 
-    /* check whether anyone failed */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        /* release the offset array */
-        mfu_free(&offsets);
-        return MFU_FAILURE;
+    /* if archive file will be on lustre, set max striping since this should be big,
+     * this deletes the file, so skip it when appending */
+    if (! opts->append) {
+        mfu_set_stripes(filename, cwdpath->path, opts->chunk_size, -1);
     }
 
-    *out_count   = count;
-    *out_offsets = offsets;
+    /* create the archive file */
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | O_LARGEFILE;
+    int fd = mfu_open(filename, flags, 0664);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive '%s' errno=%d %s",
+            filename, errno, strerror(errno));
+        DTAR_err = 1;
+    }
 
-    return rc;
-}
+//    int lock_rc = llapi_group_lock(fd, 23);
 
-static int index_entries_distread_linearscan(
-    const char* filename,
-    char* buf,
-    size_t bufsize,
-    uint64_t overlap_before,
-    uint64_t offset_start,
-    uint64_t offset_last,
-    uint64_t file_size,
-    uint64_t* out_starting_pos,
-    uint64_t* out_count,
-    uint64_t** out_offsets)
-{
-    int rc = MFU_SUCCESS;
+    /* Allocate a buffer to encode tar headers.
+     * The entire header must fit in this buffer.
+     * Typical entries will have no problems, but we may exhaust
+     * space for entries that have very long ACLs or XATTRs. */
+    size_t header_bufsize = opts->header_size;
+    void* header_buf = MFU_MALLOC(header_bufsize);
 
-    /* get our rank and the number of ranks in our communicator */
-    int rank, ranks;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+    /* get number of items in our portion of the list */
+    uint64_t listsize = mfu_flist_size(flist);
 
-    /* direct scan: rank 0 starts by reading its buffer, and then it sends the
-     * file offset at which rank 1 should pick up and continue */
-    uint64_t starting_pos = *out_starting_pos;
-    if (rank > 0) {
-        /* if we are not the first rank, wait to receive starting offset in file */
-        MPI_Status status;
-        MPI_Recv(&starting_pos, 1, MPI_UINT64_T, rank - 1, 0, MPI_COMM_WORLD, &status);
+    /* allocate memory for file sizes and offsets */
+    uint64_t* header_sizes  = (uint64_t*) MFU_MALLOC(listsize * sizeof(uint64_t));
+    uint64_t* entry_sizes   = (uint64_t*) MFU_MALLOC(listsize * sizeof(uint64_t));
+    uint64_t* entry_offsets = (uint64_t*) MFU_MALLOC(listsize * sizeof(uint64_t));
+    uint64_t* data_offsets  = (uint64_t*) MFU_MALLOC(listsize * sizeof(uint64_t));
 
-        /* also receive any error code for early termination */
-        int tmp_rc;
-        MPI_Recv(&tmp_rc, 1, MPI_INT, rank - 1, 0, MPI_COMM_WORLD, &status);
-        if (tmp_rc != MFU_SUCCESS) {
-            /* someone before us failed, so we'll bail out early */
-            rc = tmp_rc;
-        }
+    /* get buffer to read/write data from the pool */
+    size_t bufsize = opts->buf_size;
+    void* buf = MFU_BUF_GET(bufsize, 1024*1024);
+
+    /* compute local offsets for each item and total
+     * bytes we're contributing to the archive */
+    uint64_t idx;
+    uint64_t bytes = 0;
+    uint64_t data_bytes = 0;
+    compute_entry_sizes(flist, cwdpath, opts,
+        header_buf, header_bufsize,
+        &bytes, &data_bytes, header_sizes, entry_sizes, entry_offsets);
+
+    /* store total item and data byte count */
+    uint64_t total_items = mfu_flist_global_size(flist);
+    MPI_Allreduce(&data_bytes, &DTAR_total_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    /* compute total archive size, new entries follow any existing ones */
+    uint64_t archive_size = 0;
+    MPI_Allreduce(&bytes, &archive_size, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    archive_size += append_end;
+
+    /* execute scan to figure our global base offset in the archive file */
+    uint64_t global_offset = 0;
+    MPI_Scan(&bytes, &global_offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    global_offset -= bytes;
+    global_offset += append_end;
+
+    /* update offsets for each of our file to their global offset */
+    for (idx = 0; idx < listsize; idx++) {
+        entry_offsets[idx] += global_offset;
+        data_offsets[idx] = entry_offsets[idx] + header_sizes[idx];
     }
 
-    /* advance file position to offset based on our starting offset */
-    uint64_t pos = starting_pos;
+    /* list of offsets to the data of each entry, used to copy data */
+    uint64_t total_count;
+    uint64_t* all_offsets = NULL;
+    int* rank_disps = NULL;
 
-    /* variables to count number of entries we find,
-     * and byte offset within archive for each one,
-     * start with 1024 entries, we'll grow this list of offsets as needed */
-    uint64_t count = 0;
-    size_t maxcount = 1024;
-    uint64_t* offsets = (uint64_t*) malloc(maxcount * sizeof(uint64_t));
+    if (opts->compress) {
+        /* print message to user that we're starting */
+        if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Compressing archive");
+        }
 
-    /* so long as starting position does not lie past our region,
-     * and so long as we have not already hit an error, process any
-     * entries from our region of the file */
-    int break_outer = 0;
-    while (pos < offset_last && rc == MFU_SUCCESS && !break_outer) {
-        /* initiate archive object for reading */
-        struct archive* a = archive_read_new();
+        /* truncate to 0 to delete any existing file contents,
+         * we don't know the final size until frames are compressed */
+        if (mfu_rank == 0) {
+            mfu_ftruncate(fd, 0);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
 
-        /* we want all the format supports */
-//        archive_read_support_filter_bzip2(a);
-//        archive_read_support_filter_gzip(a);
-//        archive_read_support_filter_compress(a);
-        archive_read_support_format_tar(a);
+        /* write headers and file data as compressed frames,
+         * followed by the index of frames and entries */
+        int compress_rc = mfu_flist_archive_create_compressed(flist, filename, fd, cwdpath,
+            header_buf, header_bufsize, header_sizes, entry_offsets, data_offsets,
+            opts, &archive_size);
+        if (compress_rc != MFU_SUCCESS) {
+            DTAR_err = 1;
+        }
+    } else {
+        /* print message to user that we're starting */
+        if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Truncating archive");
+        }
 
-        /* count number of bytes we may be starting before or after the start
-         * of our assigned region, may be positive or negative */
-        int64_t adjustment = (int64_t)pos - (int64_t)offset_start;
-        if ((int64_t)overlap_before + adjustment >= 0) {
-            /* compute position within our buffer and initializes our
-             * archive reader at that particular offset */
-            char* ptr = buf + (int64_t)overlap_before + adjustment;
-            uint64_t bufsize_remaining = bufsize - (uint64_t)(ptr - buf);
-            int r = archive_read_open_memory(a, ptr, bufsize_remaining);
-            if (r != ARCHIVE_OK) {
-                /* TODO: We may have landed so deep into our region that
-                 * the header we're trying to is truncated by a boundary,
-                 * so this isn't necessarily an error.  Though it may be
-                 * an error (wrong format or corrupt header).  For now,
-                 * we can't tell so treat it as an error. */
-                rc = MFU_FAILURE;
-            }
+        /* TODO: delete any existing index */
+
+        /* truncate file to correct size to overwrite existing file
+         * and to preallocate space on the file system */
+        if (mfu_rank == 0) {
+            /* truncate to 0 to delete any existing file contents,
+             * when appending, keep existing entries but drop the old index */
+            mfu_ftruncate(fd, (off_t) append_end);
+
+            /* truncate to proper size and preallocate space,
+             * archive size represents the space to hold all entries,
+             * then add on final two 512-blocks that mark the end of the archive */
+            off_t final_size = archive_size + 2 * 512;
+            mfu_ftruncate(fd, final_size);
+            posix_fallocate(fd, 0, final_size);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+
+        /* TODO: include index as entry when truncating/preallocating file above */
+        /* record global offsets in index, rank 0 lists existing entries first */
+        if (keep_count > 0) {
+            uint64_t* index_offsets = (uint64_t*) MFU_MALLOC((keep_count + listsize) * sizeof(uint64_t));
+            memcpy(index_offsets, keep_offsets, keep_count * sizeof(uint64_t));
+            memcpy(index_offsets + keep_count, entry_offsets, listsize * sizeof(uint64_t));
+            write_entry_index(filename, keep_count + listsize, index_offsets, opts, &archive_size);
+            mfu_free(&index_offsets);
         } else {
-            /* We're trying to read from a part of the file that comes before
-             * our overlap region.  This might happen if rank before hit
-             * an early EOF while processing its region the archive */
-            MFU_LOG(MFU_LOG_ERR, "Early end of file in archive '%s'", filename);
-            rc = MFU_FAILURE;
+            write_entry_index(filename, listsize, entry_offsets, opts, &archive_size);
         }
 
-        /* Skip through entries in our buffer, counting them
-         * and recording their byte offset within the file as
-         * we go. */
-        while (pos < offset_last && rc == MFU_SUCCESS) {
-            /* increase our buffer capacity if needed */
-            if (count >= maxcount) {
-                /* ran out of slots, double capacity and allocate again */
-                maxcount *= 2;
-                offsets = realloc(offsets, maxcount * sizeof(uint64_t));
-            }
+        /* print message to user that we're starting */
+        if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Writing entry headers and small files");
+        }
 
-            /* read next item from archive */
-            struct archive_entry* entry;
-            int r = archive_read_next_header(a, &entry);
-            if (r == ARCHIVE_EOF) {
-                /* hit end of the current archive, but there could be another,
-                 * update position past end of the current archive */
-                uint64_t archive_offset = offset_start + adjustment;
-                uint64_t eof_offset = (uint64_t) archive_filter_bytes(a, -1);
-                pos = archive_offset + eof_offset;
-                break;
-            }
-            if (r != ARCHIVE_OK) {
-                /* We can get an error if a header happens to split
-                 * a boundardy, so don't consider this fatal but move
-                 * on to the next rank to see if it has better luck.
-                 * If it actually is a corrupt entry, then the rank
-                 * following us will also fail trying to process it */
-                if (offset_last == file_size) {
-                    /* our section of the file runs to the end,
-                     * so this must be an actual error */
-                    rc = MFU_FAILURE;
-                }
+        /* write headers for our files along with the data of small files,
+         * this sets DTAR_err on any error */
+        write_entries_coalesced(flist, filename, fd, cwdpath,
+            header_buf, header_bufsize,
+            header_sizes, entry_offsets, data_offsets, opts);
 
-                /* break the outer loop to pass the ball to the next rank */
-                break_outer = 1;
-                break;
-            }
+        /* wait for headers to be written, since the windows holding them
+         * may overlap data of large files that we copy next */
+        MPI_Barrier(MPI_COMM_WORLD);
 
-            /* got a valid entry, record offset of this header */
-            uint64_t header_offset = (uint64_t) archive_read_header_position(a);
-            offsets[count] = starting_pos + header_offset;
+        /* print message to user that we're starting */
+        if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Copying file data");
+        }
 
-            /* get current byte position following the header,
-             * which will be start of data for a regular file */
-            uint64_t buffer_offset = (uint64_t) archive_filter_bytes(a, -1);
+        /* build a list of files whose data was not written above */
+        mfu_flist large_flist = mfu_flist_subset(flist);
+        uint64_t* large_offsets = (uint64_t*) MFU_MALLOC(listsize * sizeof(uint64_t));
+        uint64_t large_count = 0;
+        uint64_t large_bytes = 0;
+        for (idx = 0; idx < listsize; idx++) {
+            mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+            if (type == MFU_TYPE_FILE && ! coalesce_file_data(flist, idx, opts)) {
+                mfu_flist_file_copy(flist, idx, large_flist);
+                large_offsets[large_count] = data_offsets[idx];
+                large_bytes += mfu_flist_file_get_size(flist, idx);
+                large_count++;
+            }
+        }
+        mfu_flist_summarize(large_flist);
+        MPI_Allreduce(&large_bytes, &DTAR_total_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
 
-            /* compute size of data segment for the entry based on its size
-             * and any necessary padding */
-            uint64_t data_size = archive_entry_size(entry);
-            uint64_t data_size_padded = get_filesize_padded(data_size);
+        /* gather global list of offset values */
+        allgather_offsets(large_count, large_offsets, &total_count, &all_offsets, &rank_disps);
 
-            /* get position for start of next entry */
-            pos = starting_pos + buffer_offset + data_size_padded;
+        /* copy data from files into archive */
+        if (opts->create_libcircle) {
+            /* distribute flist into chunk list across procs,
+             * then insert work items into libcircle */
+            mfu_flist_archive_create_copy_libcircle(large_flist, filename, fd,
+                header_buf, header_bufsize, buf, bufsize,
+                rank_disps, all_offsets, opts);
+        } else {
+            /* this splits the flist into a chunk list,
+             * and each process directly copies its chunks */
+            mfu_flist_archive_create_copy_chunk(large_flist, filename, fd,
+                header_buf, header_bufsize, buf, bufsize,
+                rank_disps, all_offsets, opts);
+        }
 
-            /* advance to the next item */
-            count++;
+        mfu_free(&large_offsets);
+        mfu_flist_free(&large_flist);
+
+        /* rank 0 finalizes the archive by writing two 512-byte blocks of NUL
+         * (according to tar file format) */
+        if (mfu_rank == 0) {
+            /* write two blocks of 512 bytes of 0 */
+            char buf[1024] = {0};
+            size_t bufsize = sizeof(buf);
+            ssize_t pwrite_rc = mfu_pwrite(filename, fd, buf, bufsize, archive_size);
+            if (pwrite_rc != bufsize) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to write to archive '%s' at offset %llu errno=%d %s",
+                    filename, (unsigned long long) archive_size, errno, strerror(errno));
+                DTAR_err = 1;
+            }
+
+            /* include final NULL blocks in our stats */
+            archive_size += bufsize;
         }
+    }
 
-        /* close the archive that we opened */
-        archive_read_close(a);
+//    lock_rc = llapi_group_unlock(fd, 23);
 
-        /* done reading the archive, so free resources */
-        archive_read_free(a);
+    /* close archive file */
+    int close_rc = mfu_close(filename, fd);
+    if (close_rc == -1) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to close archive '%s' errno=%d %s",
+            filename, errno, strerror(errno));
+        DTAR_err = 1;
     }
 
-    /* send the starting position for the rank to our right */
-    if (rank < ranks - 1) {
-        MPI_Send(&pos, 1, MPI_UINT64_T, rank + 1, 0, MPI_COMM_WORLD);
-        MPI_Send(&rc,  1, MPI_INT,      rank + 1, 0, MPI_COMM_WORLD);
+    /* determine whether everyone succeeded in writing their part */
+    int write_success = mfu_alltrue(DTAR_err == 0, MPI_COMM_WORLD);
+    if (! write_success) {
+        rc = MFU_FAILURE;
     }
 
-    /* get starting position for the next round, if any */
-    *out_starting_pos = pos;
-    MPI_Bcast(out_starting_pos, 1, MPI_UINT64_T, ranks-1, MPI_COMM_WORLD);
+    /* wait for all ranks to finish */
+    MPI_Barrier(MPI_COMM_WORLD);
 
-    /* check whether anyone failed */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        /* release the offset array */
-        mfu_free(&offsets);
-        return MFU_FAILURE;
+    /* free sorted list */
+    mfu_flist_free(&flist);
+
+    /* stop overall time */
+    time_t time_ended;
+    time(&time_ended);
+    double wtime_ended = MPI_Wtime();
+
+    /* print stats */
+    double secs = wtime_ended - wtime_started;
+    if (mfu_rank == 0) {
+        char starttime_str[256];
+        struct tm* localstart = localtime(&time_started);
+        strftime(starttime_str, 256, "%b-%d-%Y, %H:%M:%S", localstart);
+
+        char endtime_str[256];
+        struct tm* localend = localtime(&time_ended);
+        strftime(endtime_str, 256, "%b-%d-%Y, %H:%M:%S", localend);
+
+        /* convert size to units */
+        double size_tmp;
+        const char* size_units;
+        mfu_format_bytes(archive_size, &size_tmp, &size_units);
+
+        /* convert bandwidth to unit */
+        double agg_rate_tmp;
+        double agg_rate = (double)archive_size / secs;
+        const char* agg_rate_units;
+        mfu_format_bw(agg_rate, &agg_rate_tmp, &agg_rate_units);
+
+        MFU_LOG(MFU_LOG_INFO, "Started:   %s", starttime_str);
+        MFU_LOG(MFU_LOG_INFO, "Completed: %s", endtime_str);
+        MFU_LOG(MFU_LOG_INFO, "Seconds: %.3lf", secs);
+        MFU_LOG(MFU_LOG_INFO, "Archive size: %.3lf %s", size_tmp, size_units);
+        MFU_LOG(MFU_LOG_INFO, "Rate: %.3lf %s " \
+                "(%.3" PRIu64 " bytes in %.3lf seconds)", \
+                agg_rate_tmp, agg_rate_units, archive_size, secs);
     }
 
-    *out_count   = count;
-    *out_offsets = offsets;
+    /* clean up */
+    mfu_free(&keep_offsets);
+    mfu_free(&all_offsets);
+    mfu_free(&rank_disps);
+    mfu_free(&header_buf);
+    mfu_buf_put(&buf);
+    mfu_free(&data_offsets);
+    mfu_free(&entry_offsets);
+    mfu_free(&entry_sizes);
+    mfu_free(&header_sizes);
 
     return rc;
 }
 
-/* Given an archive file, determine number of entries and the byte offset
- * to the start of each one */
-static int index_entries_distread(
-    const char* filename,             /* name of archive to scan */
-    mfu_archive_opts_t* opts,         /* options to configure extraction operation */
-    mfu_flist_archive_scan_algo algo, /* whether to use a linear or parallel scan */
-    uint64_t* out_count,              /* number of entries found in archive (if successful) */
-    uint64_t** out_offsets)           /* list of byte offsets for each entry (if successful), caller must free */
+/* copy data from read archive (ar) to write archive (aw),
+ * this is used when assigning a full entry to a process
+ * copy from one archive to another */
+static int copy_data(struct archive* ar, struct archive* aw)
 {
-    /* assume we'll succeed */
     int rc = MFU_SUCCESS;
 
-    /* get file size of the archive */
-    uint64_t file_size = 0;
-    int filesize_rc = get_filesize(filename, &file_size);
-    if (filesize_rc != MFU_SUCCESS) {
-        if (mfu_rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to stat archive file '%s'", filename);
+    while (1) {
+        /* extract a block of data from the archive */
+        const void* buff;
+        size_t size;
+        off_t offset;
+        int r = archive_read_data_block(ar, &buff, &size, &offset);
+        if (r == ARCHIVE_EOF) {
+            /* hit end of data for entry */
+            break;
+        }
+        if (r != ARCHIVE_OK) {
+            /* read error */
+            MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(ar));
+            rc = MFU_FAILURE;
+            break;
         }
-        return MFU_FAILURE;
-    }
 
-    /* indicate to user what phase we're in */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Indexing archive with parallel read");
-    }
+        /* write that block of data to the item on disk */
+        r = archive_write_data_block(aw, buff, size, offset);
+        if (r != ARCHIVE_OK) {
+            /* write error */
+            MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(ar));
+            rc = MFU_FAILURE;
+            break;
+        }
 
-    /* open archive file for reading */
-    int fd = mfu_open(filename, O_RDONLY);
-    if (fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' (errno=%d %s)",
-            filename, errno, strerror(errno)
-        );
-        rc = MFU_FAILURE;
-    }
+        /* track number of bytes written so far */
+        reduce_buf[REDUCE_BYTES] += (uint64_t) size;
 
-    /* bail out with an error if anyone failed to open the archive */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        if (fd >= 0) {
-            mfu_close(filename, fd);
-        }
-        return MFU_FAILURE;
+        /* update number of items we have completed for progress messages */
+        mfu_progress_update(reduce_buf, extract_prog);
     }
 
-    /* get our rank and number of ranks in our communicator */
-    int rank, ranks;
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+    return rc;
+}
 
-    /* start timer for progress messages */
-    double start = MPI_Wtime();
-    double last = start;
+typedef enum {
+    SCAN_SINGLE,   /* single process scans the archive */
+    SCAN_LINEAR,   /* distributed read, with linear scan across processes */
+    SCAN_PARALLEL, /* distributed read, with parallel scan (experimental, requires a well-formed archive) */
+} mfu_flist_archive_scan_algo;
 
-    /* record running count and list of offsets */
-    uint64_t total_count  = 0;
-    uint64_t* all_offsets = NULL;
+static mfu_flist_archive_scan_algo select_scan_algo(void)
+{
+    mfu_flist_archive_scan_algo algo = SCAN_LINEAR;
 
-    /* get max number of bytes to store in memory at one time,
-     * use at least one full buffer size if mem size happens to be lower */
-    uint64_t bytes_per_rank = opts->mem_size;
-    if (bytes_per_rank < opts->buf_size) {
-        bytes_per_rank = opts->buf_size;
+    const char varname[] = "MFU_FLIST_ARCHIVE_SCAN";
+    const char* value = getenv(varname);
+    if (value == NULL) {
+        return algo;
     }
 
-    /* iterate over file length in waves */
-    uint64_t starting_pos = 0;
-    while (starting_pos < file_size && rc == MFU_SUCCESS) {
-        /* compute max segment size we can read in this iteration */
-        uint64_t segment_size = ranks * bytes_per_rank;
-        uint64_t remainder = file_size - starting_pos;
-        if (remainder < segment_size) {
-            segment_size = remainder;
+    if (strcmp(value, "SINGLE") == 0) {
+        algo = SCAN_SINGLE;
+    } else if (strcmp(value, "LINEAR") == 0) {
+        algo = SCAN_LINEAR;
+    } else if (strcmp(value, "PARALLEL") == 0) {
+        algo = SCAN_PARALLEL;
+    } else {
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "%s: unknown value %s", varname, value);
         }
+        value = "LINEAR";
+        algo = SCAN_LINEAR;
+    }
 
-        /* compute amount of file to read per rank,
-         * slice at boundaries of our buffer size */
-        uint64_t chunk_size = opts->buf_size;
-        uint64_t num_chunks = segment_size / chunk_size;
-        if (segment_size > num_chunks * chunk_size) {
-            num_chunks++;
-        }
-    
-        /* spread file chunks evenly among ranks,
-         * get our starting chunk offset and number of chunks */
-        uint64_t chunk_start, chunk_count;
-        mfu_get_start_count(rank, ranks, num_chunks, &chunk_start, &chunk_count);
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "%s: %s", varname, value);
+    }
 
-        /* compute max offset size for this round */
-        off_t offset_max = starting_pos + segment_size;
+    return algo;
+}
 
-        /* byte offset of start of region we are responsible for */
-        off_t offset_start = starting_pos + chunk_start * chunk_size;
-        if (offset_start > offset_max) {
-            /* no need to run past the end of the file segment */
-            offset_start = offset_max;
-        }
+/* Given a path to an archive, scan archive to determine number
+ * of entries and the byte offset to each one.
+ * Returns MFU_SUCCESS if successful, MFU_FAILURE otherwise.
+ * Records number of entries in out_count and returns a newly
+ * allocated list of offset values in out_offsets if successful. */
+static int index_entries(
+    const char* filename,   /* name of archive to scan */
+    uint64_t* out_count,    /* number of entries found in archive (set if successful) */
+    uint64_t** out_offsets) /* list of byte offsets for each entry (if successful), caller must free */
+{
+    int r;
 
-        /* offset of byte one past region we are responsible for */
-        off_t offset_last = offset_start + chunk_count * chunk_size;
-        if (offset_last > offset_max) {
-            /* no need to run past the end of the file segment */
-            offset_last = offset_max;
-        }
+    /* assume we'll succeed */
+    int rc = MFU_SUCCESS;
 
-        /* compute size of our preceding overlap region and
-         * the size of the file region we are responsible for */
-        size_t overlap_size = opts->header_size;
-        size_t region_size = (size_t)(offset_last - offset_start);
-    
-        /* allocate buffer to hold data and read our part of the archive file */
-        size_t bufsize = 0;
-        char* buf = NULL;
-        uint64_t overlap_before = 0;
-        if (region_size > 0) {
-            /* we only bother allocating a buffer and reading data
-             * when we have an actual range of the file to cover */
-
-            /* Compute offset within file to start reading from,
-             * which includes section we're responsible for and any overlap.
-             * Also compute exact number of overlap bytes we will read. */
-            off_t offset;
-            if (offset_start > (off_t)overlap_size) {
-                /* a full overlap region fits before our section */
-                offset = (off_t)(offset_start - overlap_size);
-                overlap_before = overlap_size;
-            } else {
-                /* only a partial overlap section is available
-                 * before our section, so read from the start of the file */
-                offset = 0;
-                overlap_before = (uint64_t)offset_start;
-            }
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Indexing archive");
+    }
 
-            /* allocate buffer to hold our entire region and leading overlap */
-            bufsize = overlap_before + region_size;
-            buf = (char*) MFU_MALLOC(bufsize);
+    /* have rank 0 scan archive to count up number of entries */
+    uint64_t count = 0;
+    uint64_t* offsets = NULL;
+    if (mfu_rank == 0) {
+        /* get file size so we can print percent progress as we scan */
+        uint64_t filesize = 0;
+        struct stat st;
+        int stat_rc = mfu_stat(filename, &st);
+        if (stat_rc == 0) {
+            /* stat succeeded, get the file size */
+            filesize = st.st_size;
+        } else {
+            /* failed to stat the archive file,
+             * we'll keep going, but progress messages will be disabled */
+            MFU_LOG(MFU_LOG_ERR, "Failed to stat archive %s (errno=%d %s)",
+                filename, errno, strerror(errno)
+            );
+        }
 
-            /* seek to offset within the archive file */
-            int lseek_rc = mfu_lseek(filename, fd, offset, SEEK_SET);
-            if (lseek_rc == (off_t)-1) {
-               MFU_LOG(MFU_LOG_ERR, "Failed to seek to offset %llu in archive file '%s' errno=%d %s",
-                   offset, filename, errno, strerror(errno));
-               rc = MFU_FAILURE;
-            }
+        /* initiate archive object for reading */
+        struct archive* a = archive_read_new();
 
-            /* read data from archive into our buffer */
-            size_t total_read = 0;
-            while (total_read < bufsize && rc == MFU_SUCCESS) {
-                char* ptr = buf + total_read;
-                size_t remaining = bufsize - total_read;
-                ssize_t nread = mfu_read(filename, fd, ptr, remaining);
-                if (nread == 0) {
-                    /* hit unexpected end of the archive */
-                    MFU_LOG(MFU_LOG_ERR, "Failed to read all bytes in archive file '%s'",
-                        filename);
-                    rc = MFU_FAILURE;
-                    break;
-                }
-                if (nread < 0) {
-                    /* hit a read error */
-                    MFU_LOG(MFU_LOG_ERR, "Failed to read archive file '%s' errno=%d %s",
-                        filename, errno, strerror(errno));
-                    rc = MFU_FAILURE;
-                    break;
-                }
+        /* cannot index an archive that is compressed, only a pure tar format */
+//        archive_read_support_filter_bzip2(a);
+//        archive_read_support_filter_gzip(a);
+//        archive_read_support_filter_compress(a);
+        archive_read_support_format_tar(a);
 
-                /* total up number of bytes read */
-                total_read += (size_t) nread;
-            }
+        /* read from stdin if not given a file? */
+        if (filename != NULL && strcmp(filename, "-") == 0) {
+            filename = NULL;
         }
-
-        /* variables to count number of entries we find,
-         * and byte offset within archive for each one */
-        uint64_t count = 0;
-        uint64_t* offsets = NULL;
-
-        /* pick among different algorithms to read file section and scan
-         * it for entry offsets, each process returns a list of offsets
-         * from its own region */
-        if (algo == SCAN_LINEAR) {
-            /* all procs read a section, linear scan from low to high rank
-             * to find entry offsets */
-            int tmp_rc = index_entries_distread_linearscan(filename, buf, bufsize,
-                overlap_before, offset_start, offset_last,
-                file_size, &starting_pos, &count, &offsets);
-            if (tmp_rc != MFU_SUCCESS) {
-                rc = tmp_rc;
-            }
-        } else {
-            /* all procs read a section, parallel search for "ustar" boundaries,
-             * and execute a parallel scan to find entry offsets, this currently
-             * can be fooled if an archive contains nested archives that are ill-formed
-             * or truncated */
-            int tmp_rc = index_entries_distread_parallelscan(filename, buf, bufsize,
-                overlap_before, offset_start, offset_last,
-                file_size, &starting_pos, &count, &offsets);
-            if (tmp_rc != MFU_SUCCESS) {
-                rc = tmp_rc;
-            }
+    
+        /* just scanning through headers, so we use a smaller blocksize */
+        r = archive_read_open_filename(a, filename, 10240);
+        if (r != ARCHIVE_OK) {
+            /* failed to read archive, either file does not exist
+             * or it may be a format we don't support */
+            rc = MFU_FAILURE;
         }
 
-        /* gather list of global offsets */
-        uint64_t tmp_count;
-        uint64_t* tmp_offsets;
-        int* tmp_disps;
-        allgather_offsets(count, offsets, &tmp_count, &tmp_offsets, &tmp_disps);
-
-        /* figure out whether anyone failed */
-        if (mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-            /* append offsets from this round to our running list,
-             * allocate memory to hold the full list */
-            uint64_t new_count = total_count + tmp_count;
-            uint64_t* new_offsets = (uint64_t*) MFU_MALLOC(new_count * sizeof(uint64_t));
+#if 0
+        /* TODO: scan for compression filters and bail out if we find any */
+        // see archive_filter_count/code calls to iterate over filters
+        int filter_count = archive_filter_count(a);
+        int i;
+        for (i = 0; i < filter_count; i++) {
+            uint64_t filter_bytes = archive_filter_bytes(a, i);
+            int filter_code = archive_filter_code(a, i);
+            const char* filter_name = archive_filter_name(a, i);
+            printf("bytes=%llu code=%d name=%s\n", filter_bytes, filter_code, filter_name);
+        }
+#endif
 
-            /* copy over existing list and free it */
-            uint64_t total_bytes = total_count * sizeof(uint64_t);
-            if (total_bytes > 0) {
-                memcpy(new_offsets, all_offsets, total_bytes);
-                mfu_free(&all_offsets);
+        /* start timer for progress messages */
+        double start = MPI_Wtime();
+        double last = start;
+    
+        /* read entries one by one until we hit the EOF */
+        size_t maxcount = 1024;
+        offsets = (uint64_t*) malloc(maxcount * sizeof(uint64_t));
+        while (rc == MFU_SUCCESS) {
+            /* increase our buffer capacity if needed */
+            if (count >= maxcount) {
+                /* ran out of slots, double capacity and allocate again */
+                maxcount *= 2;
+                offsets = realloc(offsets, maxcount * sizeof(uint64_t));
             }
 
-            /* append new entries to end of list */
-            char* ptr = (char*)new_offsets + total_bytes;
-            uint64_t tmp_bytes = tmp_count * sizeof(uint64_t);
-            memcpy(ptr, tmp_offsets, tmp_bytes);
+            /* read header for the current entry */
+            struct archive_entry* entry;
+            r = archive_read_next_header(a, &entry);
+            if (r == ARCHIVE_EOF) {
+                /* found the end of the archive, we're done */
+                break;
+            }
+            if (r != ARCHIVE_OK) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read entry %s",
+                    archive_error_string(a)
+                );
+                rc = MFU_FAILURE;
+                break;
+            }
 
-            /* reassing list variables to point to our new, longer list */
-            total_count = new_count;
-            all_offsets = new_offsets;
-        } else {
-            /* someone failed */
-            rc = MFU_FAILURE;
-        }
+            /* get offset of this header */
+            uint64_t offset = (uint64_t) archive_read_header_position(a);
+            offsets[count] = offset;
 
-        /* free memory buffers */
-        mfu_free(&tmp_disps);
-        mfu_free(&tmp_offsets);
-        mfu_free(&offsets);
-        mfu_free(&buf);
+            /* increment our count and move on to next entry */
+            count++;
 
-        if (rank == 0) {
             /* print progress message if needed */
             double now = MPI_Wtime();
             if (mfu_progress_timeout > 0 &&
                 (now - last) > mfu_progress_timeout &&
-                file_size > 0)
+                filesize > 0)
             {
                 /* compute percent progress and estimated time remaining */
-                double percent = (double)starting_pos * 100.0 / (double)file_size;
+                double percent = (double)offset * 100.0 / (double)filesize;
                 double secs = now - start;
                 double secs_remaining = 0.0;
                 if (percent > 0.0) {
                     secs_remaining = (double)(100.0 - percent) * secs / percent;
                 }
                 MFU_LOG(MFU_LOG_INFO, "Indexed %llu items in %.3lf secs (%.0f%%) %.0f secs left ...",
-                    total_count, secs, percent, secs_remaining
+                    count, secs, percent, secs_remaining
                 );
                 last = now;
             }
         }
-    }
 
-    /* print a final progress message if we may have printed any */
-    if (rank == 0) {
+        /* print a final progress message if we may have printed any */
         double now = MPI_Wtime();
         double secs = now - start;
         if (rc == MFU_SUCCESS &&
@@ -3773,471 +4700,1553 @@ static int index_entries_distread(
             secs > mfu_progress_timeout)
         {
             MFU_LOG(MFU_LOG_INFO, "Indexed %llu items in %.3lf secs (100%%) done",
-                total_count, secs
+                count, secs
             );
         }
+
+        /* close our read archive to clean up */
+        archive_read_close(a);
+        archive_read_free(a);
+    }
+   
+    /* broadcast whether rank 0 actually read archive successfully */
+    MPI_Bcast(&rc, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    /* bail out if rank 0 failed to index the archive */
+    if (rc != MFU_SUCCESS) {
+        mfu_free(&offsets);
+        return rc;
     }
 
-    /* done reading the archive file, we can close it */
-    mfu_close(filename, fd);
+    /* get count of items from rank 0 */
+    MPI_Bcast(&count, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
-    /* figure out whether anyone failed */
-    if (rc == MFU_SUCCESS) {
-        /* return count and list of offsets */
-        *out_count   = total_count;
-        *out_offsets = all_offsets;
-    } else {
-        mfu_free(&all_offsets);
-        rc = MFU_FAILURE;
+    /* allocate memory to holding incoming offset values */
+    if (mfu_rank != 0) {
+        offsets = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t));
     }
 
-    return rc;
+    /* get offset values from rank 0 */
+    MPI_Bcast(offsets, count, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    /* return count and list of offsets */
+    *out_count   = count;
+    *out_offsets = offsets;
+
+    return rc; 
 }
 
-/* name in the archive is relative,
- * but paths in flist are absolute (typically),
- * prepend given prefix and reduce resulting path */
-static const char* full_path_to_entry(
-    struct archive_entry* entry,
-    const mfu_path* prefix)
-{
-    /* get name of archive entry, this is likely a relative path */
-    const char* name = archive_entry_pathname(entry);
-    mfu_path* path = mfu_path_from_str(name);
-
-    /* prepend given prefix if entry path is not absolute */
-    if (! mfu_path_is_absolute(path)) {
-        mfu_path_prepend(path, prefix);
-    }
-
-    /* simplify the path */
-    mfu_path_reduce(path);
-
-    /* allocate the new path as a string to return */
-    char* str = mfu_path_strdup(path);
-    mfu_path_delete(&path);
-
-    return str;
-}
+/* TODO: This algorithm only works correctly on well-formed archive files.
+ * Archive files can contain other archive files as constiuent entries.
+ * By searching for the first "ustar" string we can find, it's possible that
+ * we'll first lock in on an entry inside on of these internal archive files.
+ * If all of those internal archives are well-formed, the scan that computes
+ * the max file offset will skip over those internal archives, since the
+ * outer archive fully contains the inner archives.  However, if an inner
+ * is not well formed (e.g., a large inner archive was truncated, but still
+ * has a complete header), it's possible the offset we compute from the
+ * header on the inner archive will be larger than the offset for the next
+ * entry in the outer archive, which will mess up the algorithm.  An
+ * improved scan operation may be able to fix this, though we may need to
+ * search for *all* ustar strings within the memory range.  This algorithm
+ * shouldn't really be used in production until that has been fixed.
+ * For now, we leave this here for testing purposes.
+ * We could also offer it if the user trusts that any internal archives
+ * are all well-formed. */
 
-/* given an entry data structure read from the archive,
- * create a corresponding item in the flist */
-static void insert_entry_into_flist(
-    struct archive_entry* entry, /* entry to be inserted */
-    mfu_flist flist,             /* flist in which to insert item */
-    const mfu_path* prefix)      /* prepend prefix to entry path to get absolute path for flist */
+static int index_entries_distread_parallelscan(
+    const char* filename,
+    char* buf,
+    size_t bufsize,
+    uint64_t overlap_before,
+    uint64_t offset_start,
+    uint64_t offset_last,
+    uint64_t file_size,
+    uint64_t* out_starting_pos,
+    uint64_t* out_count,
+    uint64_t** out_offsets)
 {
-    /* allocate a new item in our list, and get its index */
-    uint64_t idx = mfu_flist_file_create(flist);
+    int rc = MFU_SUCCESS;
 
-    /* name in the archive is relative,
-     * but paths in flist are absolute (typically),
-     * prepend given prefix and reduce resulting path */
-    const char* fullpath = full_path_to_entry(entry, prefix);
-    mfu_flist_file_set_name(flist, idx, fullpath);
-    mfu_free(&fullpath);
+    /* get our rank and the number of ranks in our communicator */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-    /* get mode of entry, and deduce mfu type */
-    mode_t mode = archive_entry_mode(entry);
-    mfu_filetype type = mfu_flist_mode_to_filetype(mode);
-    mfu_flist_file_set_type(flist, idx, type);
+    /* file offset of the first byte in our read buffer */
+    uint64_t pos = offset_start - overlap_before;
 
-    mfu_flist_file_set_mode(flist, idx, mode);
+    /* each process scans for entries in its overlap and its region,
+     * recording the max offset that should point to a valid entry */
+    uint64_t max_offset = 0;
+    char* ptr = buf;
+    char* ptr_end = ptr + bufsize;
+    while (ptr < ptr_end) {
+        /* scan for the next "ustar" string we can find,
+         * note that this might not really be a valid entry
+         * even if we find the string */
+        size_t bytes_remaining = ptr_end - ptr;
+        char* ptr_found = (char*) memmem(ptr, bytes_remaining, "ustar", strlen("ustar"));
+        if (ptr_found == NULL) {
+            /* no "ustar" found in the rest of the buffer */
+            break;
+        }
 
-    uint64_t uid = archive_entry_uid(entry);
-    mfu_flist_file_set_uid(flist, idx, uid);
+        /* found a potential entry, check that we have enough bytes
+         * to read a full header, the "ustar" string starts at offset 257
+         * in the header:
+         * https://en.wikipedia.org/wiki/Tar_(computing)#UStar_format */
+        uint64_t offset = (uint64_t)(ptr_found - ptr);
+        if (offset < 257) {
+            /* we don't have enough bytes before this string to even try,
+             * skip past this instance and try the next one */
+            ptr = ptr_found + strlen("ustar");
+            continue;
+        }
 
-    uint64_t gid = archive_entry_gid(entry);
-    mfu_flist_file_set_gid(flist, idx, gid);
+        /* "ustar" string is at least 257 bytes into the buffer,
+         * back up to what should be the start of the header */
+        char* ptr_start = ptr_found - 257;
 
-    uint64_t atime = archive_entry_atime(entry);
-    mfu_flist_file_set_atime(flist, idx, atime);
+        /* create a new archive object for reading */
+        struct archive* a = archive_read_new();
+        archive_read_support_format_tar(a);
 
-    uint64_t atime_nsec = archive_entry_atime_nsec(entry);
-    mfu_flist_file_set_atime_nsec(flist, idx, atime_nsec);
+        /* initialize archive object at start of the header */
+        uint64_t buf_offset = (uint64_t)(ptr_start - buf);
+        uint64_t bufsize_remaining = bufsize - buf_offset;
+        int r = archive_read_open_memory(a, ptr_start, bufsize_remaining);
+        if (r != ARCHIVE_OK) {
+            /* failed to process this location as a valid archive,
+             * skip past this instance of the ustar string and try the next one */
+            archive_read_free(a);
+            ptr = ptr_found + strlen("ustar");
+            continue;
+        }
 
-    uint64_t mtime = archive_entry_mtime(entry);
-    mfu_flist_file_set_mtime(flist, idx, mtime);
+        /* we opened an archive, march through its entries for as
+         * long as we can */
+        ptr = ptr_start;
+        int found_one = 0;
+        while (1) {
+            /* read header of next entry from archive */
+            struct archive_entry* entry;
+            int r = archive_read_next_header(a, &entry);
+            if (r == ARCHIVE_EOF) {
+                /* hit end of the archive, compute size of "end-of-archive" marker */
+                uint64_t eof_start = (uint64_t) archive_read_header_position(a);
+                uint64_t eof_end   = (uint64_t) archive_filter_bytes(a, -1);
+                uint64_t eof_size  = eof_end - eof_start;
 
-    uint64_t mtime_nsec = archive_entry_mtime_nsec(entry);
-    mfu_flist_file_set_mtime_nsec(flist, idx, mtime_nsec);
+                /* advance past "end-of-archive" marker
+                 * in case another archive starts just beyond */
+                ptr += eof_size;
 
-    uint64_t ctime = archive_entry_ctime(entry);
-    mfu_flist_file_set_ctime(flist, idx, ctime);
+                /* compute file offset to start of next archive, if any */
+                max_offset = pos + buf_offset + eof_start + eof_size;
 
-    uint64_t ctime_nsec = archive_entry_ctime_nsec(entry);
-    mfu_flist_file_set_ctime_nsec(flist, idx, ctime_nsec);
+                break;
+            }
+            if (r != ARCHIVE_OK) {
+                /* We can get an error if a header happens to be split
+                 * by a boundardy, so we don't consider this fatal but move
+                 * on to the next rank to see if it has better luck.
+                 * If this is actually a corrupt entry, then the rank
+                 * following us will also fail trying to process it */
+                if (! found_one) {
+                    /* failed to process the first entry in the archive,
+                     * so skip past this "ustar" instance on to the next */
+                    ptr = ptr_found + strlen("ustar");
+                }
+                break;
+            }
 
-    uint64_t size = archive_entry_size(entry);
-    mfu_flist_file_set_size(flist, idx, size);
-}
+            /* remember that we processed one entry */
+            found_one = 1;
 
-/* Given an archvive file, build file list of corresponding items,
- * given a list of offsets to all items */
-static int extract_flist_offsets(
-    const char* filename,          /* name of archive file */
-    const mfu_param_path* cwdpath, /* path to prepend to any relative path in archive */
-    uint64_t entries,              /* total number of entries in archive */
-    uint64_t entry_start,          /* starting offset this process should handle */
-    uint64_t entry_count,          /* number of consecutive entries this process should read */
-    uint64_t* offsets,             /* offset to header of each entry */
-    uint64_t** data_offsets,       /* returns newly allocated list with offset to start of data for each entry */
-    mfu_flist flist)               /* file list in which to insert items */
-{
-    int r;
+            /* got a valid entry, record offset of this header */
+            uint64_t header_offset = (uint64_t) archive_read_header_position(a);
 
-    /* assume we'll succeed */
-    int rc = MFU_SUCCESS;
+            /* get current byte position following the header,
+             * which will be start of data for a regular file */
+            uint64_t data_offset = (uint64_t) archive_filter_bytes(a, -1);
 
-    /* indicate to user what phase we're in */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Extracting metadata");
-    }
+            /* compute size of data segment for the entry based on its size
+             * and any necessary padding */
+            uint64_t data_size = archive_entry_size(entry);
+            uint64_t data_size_padded = get_filesize_padded(data_size);
 
-    /* prepare list for metadata details */
-    mfu_flist_set_detail(flist, 1);
+            /* compute byte offset within archive for start of next entry */
+            max_offset = pos + buf_offset + data_offset + data_size_padded;
 
-    /* open archive file for reading */
-    int fd = mfu_open(filename, O_RDONLY);
-    if (fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' (errno=%d %s)",
-            filename, errno, strerror(errno)
-        );
-        rc = MFU_FAILURE;
+            /* advance our pointer past the current entry */
+            uint64_t header_size = data_offset - header_offset;
+            uint64_t entry_size = header_size + data_size_padded;
+            ptr += entry_size;
+        }
+
+        /* Done reading from this archive, close it out.
+         * Note that we keep going until we process our entire
+         * read buffer.  It could be that we just scanned through
+         * a tar archive nested within another archive. */
+        archive_read_close(a);
+        archive_read_free(a);
     }
 
-    /* bail out with an error if anyone failed to open the archive */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        if (fd >= 0) {
-            mfu_close(filename, fd);
-        }
-        return MFU_FAILURE;
+    /* get maximum offset from all ranks before us to use as our starting position */
+    uint64_t starting_pos = 0;
+    MPI_Exscan(&max_offset, &starting_pos, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+    if (rank == 0) {
+        starting_pos = *out_starting_pos;
     }
 
-    /* get current working directory to prepend to
-     * each entry to construct full path */
-    mfu_path* cwd = mfu_path_from_str(cwdpath->path);
+    /* TODO: also record entry sizes, add to headers, and then check that starting
+     * position on each rank matches where the rank before left off */
 
-    /* allocate buffer to hold data offset for each of our items */
-    uint64_t* doffsets = (uint64_t*) MFU_MALLOC(entry_count * sizeof(uint64_t));
+    /* advance file position to offset based on our starting offset */
+    pos = starting_pos;
 
-    /* iterate over each entry we're responsible for */
+    /* variables to count number of entries we find,
+     * and byte offset within archive for each one,
+     * start with 1024 entries, we'll grow this list of offsets as needed */
     uint64_t count = 0;
-    while (count < entry_count) {
-        /* compute offset and seek to this entry */
-        uint64_t idx = entry_start + count;
-        off_t offset = (off_t) offsets[idx];
-        off_t pos = mfu_lseek(filename, fd, offset, SEEK_SET);
-        if (pos == (off_t)-1) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to lseek to offset %llu in %s (errno=%d %s)",
-                offset, filename, errno, strerror(errno)
-            );
-            rc = MFU_FAILURE;
-            break;
-        }
+    size_t maxcount = 1024;
+    uint64_t* offsets = (uint64_t*) malloc(maxcount * sizeof(uint64_t));
 
+    /* so long as starting position does not lie past our region,
+     * and so long as we have not already hit an error, process any
+     * entries from our region of the file */
+    int break_outer = 0;
+    while (bufsize > 0 && pos < offset_last && rc == MFU_SUCCESS && !break_outer) {
         /* initiate archive object for reading */
         struct archive* a = archive_read_new();
 
-        /* when using an index, we can assume the archive is not compressed */
+        /* we want all the format supports */
 //        archive_read_support_filter_bzip2(a);
 //        archive_read_support_filter_gzip(a);
 //        archive_read_support_filter_compress(a);
         archive_read_support_format_tar(a);
 
-        /* can use a small block size since we're just reading header info */
-        r = archive_read_open_fd(a, fd, 10240);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to open archive to extract entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(a)
-            );
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
-        }
-
-        /* read entry header from archive */
-        struct archive_entry* entry;
-        r = archive_read_next_header(a, &entry);
-        if (r == ARCHIVE_EOF) {
-            MFU_LOG(MFU_LOG_ERR, "Unexpected end of archive, read %llu of %llu entries",
-                count, entry_count
-            );
-            archive_read_close(a);
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
-        }
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to extract entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(a)
-            );
-            archive_read_close(a);
-            archive_read_free(a);
+        /* count number of bytes we may be starting before or after the start
+         * of our assigned region, which may be positive or negative */
+        int64_t adjustment = (int64_t)pos - (int64_t)offset_start;
+        if ((int64_t)overlap_before + adjustment >= 0) {
+            /* compute position within our buffer and initializes our
+             * archive reader at that particular offset */
+            char* ptr = buf + (int64_t)overlap_before + adjustment;
+            uint64_t bufsize_remaining = bufsize - (uint64_t)(ptr - buf);
+            int r = archive_read_open_memory(a, ptr, bufsize_remaining);
+            if (r != ARCHIVE_OK) {
+                MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(a));
+                rc = MFU_FAILURE;
+            }
+        } else {
+            /* We're trying to read from a part of the file that comes before
+             * our overlap region.  This might happen if rank before hit
+             * an early EOF while processing its region the archive */
+            MFU_LOG(MFU_LOG_ERR, "Early end of file in archive '%s'", filename);
             rc = MFU_FAILURE;
-            break;
         }
 
-        /* read the entry, create a corresponding flist entry for it */
-        insert_entry_into_flist(entry, flist, cwd);
+        /* Skip through entries in our buffer, counting them
+         * and recording their byte offset within the file as
+         * we go. */
+        while (pos < offset_last && rc == MFU_SUCCESS) {
+            /* increase our buffer capacity if needed */
+            if (count >= maxcount) {
+                /* ran out of slots, double capacity and allocate again */
+                maxcount *= 2;
+                offsets = realloc(offsets, maxcount * sizeof(uint64_t));
+            }
 
-        /* get byte position, which would be start of data for a regular file */
-        uint64_t header_size = (uint64_t) archive_filter_bytes(a, -1);
-        doffsets[count] = offset + header_size;
+            /* read next item from archive */
+            struct archive_entry* entry;
+            int r = archive_read_next_header(a, &entry);
+            if (r == ARCHIVE_EOF) {
+                /* hit end of the archive, compute size of "end-of-archive" marker,
+                 * and advance past it */
+                uint64_t eof_start = (uint64_t) archive_read_header_position(a);
+                uint64_t eof_end   = (uint64_t) archive_filter_bytes(a, -1);
+                pos += (eof_end - eof_start);
+                break;
+            }
+            if (r != ARCHIVE_OK) {
+                /* We can get an error if a header happens to split
+                 * a boundardy, so don't consider this fatal but move
+                 * on to the next rank to see if it has better luck.
+                 * If it actually is a corrupt entry, then the rank
+                 * following us will also fail trying to process it */
+                if (offset_last == file_size) {
+                    /* our section of the file runs to the end,
+                     * so this must be an actual error */
+                    rc = MFU_FAILURE;
+                }
 
-        /* close out the read archive, to be sure it doesn't have memory */
-        r = archive_read_close(a);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to close archive after extracting entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(a)
-            );
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
-        }
+                /* break the outer loop to pass the ball to the next rank */
+                break_outer = 1;
+                break;
+            }
 
-        /* release read archive */
-        r = archive_read_free(a);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to free archive after extracting entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(a)
-            );
-            rc = MFU_FAILURE;
-            break;
-        }
+            /* got a valid entry, record offset of this header */
+            uint64_t header_offset = (uint64_t) archive_read_header_position(a);
+            offsets[count] = starting_pos + header_offset;
 
-        /* advance to next entry */
-        count++;
-    }
+            /* get current byte position following the header,
+             * which will be start of data for a regular file */
+            uint64_t buffer_offset = (uint64_t) archive_filter_bytes(a, -1);
 
-    mfu_flist_summarize(flist);
+            /* compute size of data segment for the entry based on its size
+             * and any necessary padding */
+            uint64_t data_size = archive_entry_size(entry);
+            uint64_t data_size_padded = get_filesize_padded(data_size);
 
-    /* gather data offsets for all entries to all ranks */
-    uint64_t total_count;
-    int* rank_disps;
-    allgather_offsets(count, doffsets, &total_count, data_offsets, &rank_disps);
+            /* get position for start of next entry */
+            pos = starting_pos + buffer_offset + data_size_padded;
 
-    mfu_free(&rank_disps);
-    mfu_free(&doffsets);
+            /* advance to the next item */
+            count++;
+        }
 
-    mfu_path_delete(&cwd);
+        /* done reading the archive, so free resources */
+        archive_read_close(a);
+        archive_read_free(a);
+    }
 
-    mfu_close(filename, fd);
+    /* get maximum offset from all ranks before us to use as our starting position */
+    uint64_t max_pos = 0;
+    MPI_Allreduce(&pos, &max_pos, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+    *out_starting_pos = max_pos;
 
-    /* check that all ranks succeeded */
+    /* check whether anyone failed */
     if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        rc = MFU_FAILURE;
+        /* release the offset array */
+        mfu_free(&offsets);
+        return MFU_FAILURE;
     }
 
+    *out_count   = count;
+    *out_offsets = offsets;
+
     return rc;
 }
 
-/* Given an archive file, build file list of corresponding items.
- * All processes scan the archive and extract items in a round-robin manner. */
-static int extract_flist(
-    const char* filename,          /* name of archive file */
-    const mfu_param_path* cwdpath, /* path to prepend to relative path of each entry */
-    mfu_flist flist)               /* flist list to insert items into */
+static int index_entries_distread_linearscan(
+    const char* filename,
+    char* buf,
+    size_t bufsize,
+    uint64_t overlap_before,
+    uint64_t offset_start,
+    uint64_t offset_last,
+    uint64_t file_size,
+    uint64_t* out_starting_pos,
+    uint64_t* out_count,
+    uint64_t** out_offsets)
 {
-    /* assume we'll succeed */
     int rc = MFU_SUCCESS;
 
-    /* prepare list for metadata details */
-    mfu_flist_set_detail(flist, 1);
-
-    /* indicate to user what phase we're in */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Extracting metadata");
-    }
-
-    /* initiate archive object for reading */
-    struct archive* a = archive_read_new();
+    /* get our rank and the number of ranks in our communicator */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-    /* we want all the format supports */
-    archive_read_support_filter_bzip2(a);
-    archive_read_support_filter_gzip(a);
-    archive_read_support_filter_compress(a);
-    archive_read_support_format_tar(a);
+    /* direct scan: rank 0 starts by reading its buffer, and then it sends the
+     * file offset at which rank 1 should pick up and continue */
+    uint64_t starting_pos = *out_starting_pos;
+    if (rank > 0) {
+        /* if we are not the first rank, wait to receive starting offset in file */
+        MPI_Status status;
+        MPI_Recv(&starting_pos, 1, MPI_UINT64_T, rank - 1, 0, MPI_COMM_WORLD, &status);
 
-    if (filename != NULL && strcmp(filename, "-") == 0) {
-        filename = NULL;
+        /* also receive any error code for early termination */
+        int tmp_rc;
+        MPI_Recv(&tmp_rc, 1, MPI_INT, rank - 1, 0, MPI_COMM_WORLD, &status);
+        if (tmp_rc != MFU_SUCCESS) {
+            /* someone before us failed, so we'll bail out early */
+            rc = tmp_rc;
+        }
     }
 
-    /* blocksize set to 1024K */
-    int r = archive_read_open_filename(a, filename, 10240);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(a));
-        exit(r);
-    }
+    /* advance file position to offset based on our starting offset */
+    uint64_t pos = starting_pos;
 
-    /* get current working directory */
-    mfu_path* cwd = mfu_path_from_str(cwdpath->path);
+    /* variables to count number of entries we find,
+     * and byte offset within archive for each one,
+     * start with 1024 entries, we'll grow this list of offsets as needed */
+    uint64_t count = 0;
+    size_t maxcount = 1024;
+    uint64_t* offsets = (uint64_t*) malloc(maxcount * sizeof(uint64_t));
 
-    /* get number of ranks in our communicator */
-    int ranks;
-    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+    /* so long as starting position does not lie past our region,
+     * and so long as we have not already hit an error, process any
+     * entries from our region of the file */
+    int break_outer = 0;
+    while (pos < offset_last && rc == MFU_SUCCESS && !break_outer) {
+        /* initiate archive object for reading */
+        struct archive* a = archive_read_new();
 
-    /* Read through archive and extract items to our list
-     * in a round-robin fashion.  This means different procs
-     * will be reading interleaved entries from the archive,
-     * but it enables all procs to get to work faster rather
-     * than have some end early and others scan to the very
-     * end (load imbalance). */
-    uint64_t count = 0;
-    while (1) {
-        /* read next item from archive */
-        struct archive_entry* entry;
-        r = archive_read_next_header(a, &entry);
-        if (r == ARCHIVE_EOF) {
-            /* hit end of the archive */
-            break;
-        }
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(a));
-            exit(r);
-        }
+        /* we want all the format supports */
+//        archive_read_support_filter_bzip2(a);
+//        archive_read_support_filter_gzip(a);
+//        archive_read_support_filter_compress(a);
+        archive_read_support_format_tar(a);
 
-        /* extract items round-robin across ranks */
-        if (count % ranks == mfu_rank) {
-            insert_entry_into_flist(entry, flist, cwd);
+        /* count number of bytes we may be starting before or after the start
+         * of our assigned region, may be positive or negative */
+        int64_t adjustment = (int64_t)pos - (int64_t)offset_start;
+        if ((int64_t)overlap_before + adjustment >= 0) {
+            /* compute position within our buffer and initializes our
+             * archive reader at that particular offset */
+            char* ptr = buf + (int64_t)overlap_before + adjustment;
+            uint64_t bufsize_remaining = bufsize - (uint64_t)(ptr - buf);
+            int r = archive_read_open_memory(a, ptr, bufsize_remaining);
+            if (r != ARCHIVE_OK) {
+                /* TODO: We may have landed so deep into our region that
+                 * the header we're trying to is truncated by a boundary,
+                 * so this isn't necessarily an error.  Though it may be
+                 * an error (wrong format or corrupt header).  For now,
+                 * we can't tell so treat it as an error. */
+                rc = MFU_FAILURE;
+            }
+        } else {
+            /* We're trying to read from a part of the file that comes before
+             * our overlap region.  This might happen if rank before hit
+             * an early EOF while processing its region the archive */
+            MFU_LOG(MFU_LOG_ERR, "Early end of file in archive '%s'", filename);
+            rc = MFU_FAILURE;
         }
 
-        /* advance to the next item */
-        count++;
-    }
+        /* Skip through entries in our buffer, counting them
+         * and recording their byte offset within the file as
+         * we go. */
+        while (pos < offset_last && rc == MFU_SUCCESS) {
+            /* increase our buffer capacity if needed */
+            if (count >= maxcount) {
+                /* ran out of slots, double capacity and allocate again */
+                maxcount *= 2;
+                offsets = realloc(offsets, maxcount * sizeof(uint64_t));
+            }
 
-    /* close out our list */
-    mfu_flist_summarize(flist);
+            /* read next item from archive */
+            struct archive_entry* entry;
+            int r = archive_read_next_header(a, &entry);
+            if (r == ARCHIVE_EOF) {
+                /* hit end of the current archive, but there could be another,
+                 * update position past end of the current archive */
+                uint64_t archive_offset = offset_start + adjustment;
+                uint64_t eof_offset = (uint64_t) archive_filter_bytes(a, -1);
+                pos = archive_offset + eof_offset;
+                break;
+            }
+            if (r != ARCHIVE_OK) {
+                /* We can get an error if a header happens to split
+                 * a boundardy, so don't consider this fatal but move
+                 * on to the next rank to see if it has better luck.
+                 * If it actually is a corrupt entry, then the rank
+                 * following us will also fail trying to process it */
+                if (offset_last == file_size) {
+                    /* our section of the file runs to the end,
+                     * so this must be an actual error */
+                    rc = MFU_FAILURE;
+                }
 
-    mfu_path_delete(&cwd);
+                /* break the outer loop to pass the ball to the next rank */
+                break_outer = 1;
+                break;
+            }
 
-    archive_read_close(a);
-    archive_read_free(a);
+            /* got a valid entry, record offset of this header */
+            uint64_t header_offset = (uint64_t) archive_read_header_position(a);
+            offsets[count] = starting_pos + header_offset;
 
-    /* figure out whether anyone failed */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        rc = MFU_FAILURE;
-    }
+            /* get current byte position following the header,
+             * which will be start of data for a regular file */
+            uint64_t buffer_offset = (uint64_t) archive_filter_bytes(a, -1);
 
-    return rc;
-}
+            /* compute size of data segment for the entry based on its size
+             * and any necessary padding */
+            uint64_t data_size = archive_entry_size(entry);
+            uint64_t data_size_padded = get_filesize_padded(data_size);
 
-/* progress message to print running count of bytes and items processed
- * while extracting items from the archive */
-static void extract2_progress_fn(const uint64_t* vals, int count, int complete, int ranks, double secs)
-{
-    /* compute average rate */
-    double byte_rate = 0.0;
-    double item_rate = 0.0;
-    if (secs > 0) {
-        byte_rate = (double)vals[REDUCE_BYTES] / secs;
-        item_rate = (double)vals[REDUCE_ITEMS] / secs;
-    }
+            /* get position for start of next entry */
+            pos = starting_pos + buffer_offset + data_size_padded;
 
-    /* format number of bytes for printing */
-    double bytes_val = 0.0;
-    const char* bytes_units = NULL;
-    mfu_format_bytes(vals[REDUCE_BYTES], &bytes_val, &bytes_units);
+            /* advance to the next item */
+            count++;
+        }
 
-    /* format bandwidth for printing */
-    double bw_val = 0.0;
-    const char* bw_units = NULL;
-    mfu_format_bw(byte_rate, &bw_val, &bw_units);
+        /* close the archive that we opened */
+        archive_read_close(a);
 
-    /* compute percentage of bytes extracted */
-    double percent = 0.0;
-    if (DTAR_total_bytes > 0) {
-        percent = (double)vals[REDUCE_BYTES] * 100.0 / (double)DTAR_total_bytes;
+        /* done reading the archive, so free resources */
+        archive_read_free(a);
     }
 
-    /* estimate seconds remaining */
-    double secs_remaining = 0.0;
-    if (byte_rate > 0.0) {
-        secs_remaining = (double)(DTAR_total_bytes - vals[REDUCE_BYTES]) / byte_rate;
+    /* send the starting position for the rank to our right */
+    if (rank < ranks - 1) {
+        MPI_Send(&pos, 1, MPI_UINT64_T, rank + 1, 0, MPI_COMM_WORLD);
+        MPI_Send(&rc,  1, MPI_INT,      rank + 1, 0, MPI_COMM_WORLD);
     }
 
-    if (complete < ranks) {
-        MFU_LOG(MFU_LOG_INFO,
-            "Extracted %llu items and %.3lf %s (%.0f%%) in %.3lf secs (%.3lf items/sec, %.3lf %s) %.0f secs left ...",
-            vals[REDUCE_ITEMS], bytes_val, bytes_units, percent, secs, item_rate, bw_val, bw_units, secs_remaining
-        );
-    } else {
-        MFU_LOG(MFU_LOG_INFO,
-            "Extracted %llu items and %.3lf %s (%.0f%%) in %.3lf secs (%.3lf items/sec, %.3lf %s) done",
-            vals[REDUCE_ITEMS], bytes_val, bytes_units, percent, secs, item_rate, bw_val, bw_units
-        );
-    }
-}
+    /* get starting position for the next round, if any */
+    *out_starting_pos = pos;
+    MPI_Bcast(out_starting_pos, 1, MPI_UINT64_T, ranks-1, MPI_COMM_WORLD);
 
-/* progress message to print sum of bytes while extracting items from the archive */
-static void extract1_progress_fn(const uint64_t* vals, int count, int complete, int ranks, double secs)
-{
-    /* compute average rate */
-    double byte_rate = 0.0;
-    if (secs > 0) {
-        byte_rate = (double)vals[REDUCE_BYTES] / secs;
+    /* check whether anyone failed */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        /* release the offset array */
+        mfu_free(&offsets);
+        return MFU_FAILURE;
     }
 
-    /* format number of bytes for printing */
-    double bytes_val = 0.0;
-    const char* bytes_units = NULL;
-    mfu_format_bytes(vals[REDUCE_BYTES], &bytes_val, &bytes_units);
+    *out_count   = count;
+    *out_offsets = offsets;
 
-    /* format bandwidth for printing */
-    double bw_val = 0.0;
-    const char* bw_units = NULL;
-    mfu_format_bw(byte_rate, &bw_val, &bw_units);
+    return rc;
+}
 
-    /* compute percentage of bytes extracted */
-    double percent = 0.0;
-    if (DTAR_total_bytes > 0) {
-        percent = (double)vals[REDUCE_BYTES] * 100.0 / (double)DTAR_total_bytes;
+/* Given an archive file, determine number of entries and the byte offset
+ * to the start of each one */
+static int index_entries_distread(
+    const char* filename,             /* name of archive to scan */
+    mfu_archive_opts_t* opts,         /* options to configure extraction operation */
+    mfu_flist_archive_scan_algo algo, /* whether to use a linear or parallel scan */
+    uint64_t* out_count,              /* number of entries found in archive (if successful) */
+    uint64_t** out_offsets)           /* list of byte offsets for each entry (if successful), caller must free */
+{
+    /* assume we'll succeed */
+    int rc = MFU_SUCCESS;
+
+    /* get file size of the archive */
+    uint64_t file_size = 0;
+    int filesize_rc = get_filesize(filename, &file_size);
+    if (filesize_rc != MFU_SUCCESS) {
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to stat archive file '%s'", filename);
+        }
+        return MFU_FAILURE;
     }
 
-    /* estimate seconds remaining */
-    double secs_remaining = 0.0;
-    if (byte_rate > 0.0) {
-        secs_remaining = (double)(DTAR_total_bytes - vals[REDUCE_BYTES]) / byte_rate;
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Indexing archive with parallel read");
     }
 
-    if (complete < ranks) {
-        MFU_LOG(MFU_LOG_INFO,
-            "Extracted %.3lf %s (%.0f%%) in %.3lf secs (%.3lf %s) %.0f secs left ...",
-            bytes_val, bytes_units, percent, secs, bw_val, bw_units, secs_remaining
-        );
-    } else {
-        MFU_LOG(MFU_LOG_INFO,
-            "Extracted %.3lf %s (%.0f%%) in %.3lf secs (%.3lf %s) done",
-            bytes_val, bytes_units, percent, secs, bw_val, bw_units
+    /* open archive file for reading */
+    int fd = mfu_open(filename, O_RDONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' (errno=%d %s)",
+            filename, errno, strerror(errno)
         );
+        rc = MFU_FAILURE;
     }
-}
 
-/* compute total bytes in regular files in flist */
-static uint64_t flist_sum_bytes(mfu_flist flist)
-{
-    /* sum up bytes in our portion of the list */
-    uint64_t bytes = 0;
-    if (mfu_flist_have_detail(flist)) {
-        uint64_t idx = 0;
-        uint64_t max = mfu_flist_size(flist);
-        for (idx = 0; idx < max; idx++) {
-            /* get size of regular files */
-            mfu_filetype type = mfu_flist_file_get_type(flist, idx);
-            if (type == MFU_TYPE_FILE) {
-                uint64_t size = mfu_flist_file_get_size(flist, idx);
-                bytes += size;
-            }
+    /* bail out with an error if anyone failed to open the archive */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        if (fd >= 0) {
+            mfu_close(filename, fd);
         }
+        return MFU_FAILURE;
     }
 
-    /* get total bytes across all ranks */
-    uint64_t total_bytes;
-    MPI_Allreduce(&bytes, &total_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-    return total_bytes;
-}
+    /* get our rank and number of ranks in our communicator */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-/* Extract items from a given archive file, given the offset of each entry in the archive.
+    /* start timer for progress messages */
+    double start = MPI_Wtime();
+    double last = start;
+
+    /* record running count and list of offsets */
+    uint64_t total_count  = 0;
+    uint64_t* all_offsets = NULL;
+
+    /* get max number of bytes to store in memory at one time,
+     * use at least one full buffer size if mem size happens to be lower */
+    uint64_t bytes_per_rank = opts->mem_size;
+    if (bytes_per_rank < opts->buf_size) {
+        bytes_per_rank = opts->buf_size;
+    }
+
+    /* iterate over file length in waves */
+    uint64_t starting_pos = 0;
+    while (starting_pos < file_size && rc == MFU_SUCCESS) {
+        /* compute max segment size we can read in this iteration */
+        uint64_t segment_size = ranks * bytes_per_rank;
+        uint64_t remainder = file_size - starting_pos;
+        if (remainder < segment_size) {
+            segment_size = remainder;
+        }
+
+        /* compute amount of file to read per rank,
+         * slice at boundaries of our buffer size */
+        uint64_t chunk_size = opts->buf_size;
+        uint64_t num_chunks = segment_size / chunk_size;
+        if (segment_size > num_chunks * chunk_size) {
+            num_chunks++;
+        }
+    
+        /* spread file chunks evenly among ranks,
+         * get our starting chunk offset and number of chunks */
+        uint64_t chunk_start, chunk_count;
+        mfu_get_start_count(rank, ranks, num_chunks, &chunk_start, &chunk_count);
+
+        /* compute max offset size for this round */
+        off_t offset_max = starting_pos + segment_size;
+
+        /* byte offset of start of region we are responsible for */
+        off_t offset_start = starting_pos + chunk_start * chunk_size;
+        if (offset_start > offset_max) {
+            /* no need to run past the end of the file segment */
+            offset_start = offset_max;
+        }
+
+        /* offset of byte one past region we are responsible for */
+        off_t offset_last = offset_start + chunk_count * chunk_size;
+        if (offset_last > offset_max) {
+            /* no need to run past the end of the file segment */
+            offset_last = offset_max;
+        }
+
+        /* compute size of our preceding overlap region and
+         * the size of the file region we are responsible for */
+        size_t overlap_size = opts->header_size;
+        size_t region_size = (size_t)(offset_last - offset_start);
+    
+        /* allocate buffer to hold data and read our part of the archive file */
+        size_t bufsize = 0;
+        char* buf = NULL;
+        uint64_t overlap_before = 0;
+        if (region_size > 0) {
+            /* we only bother allocating a buffer and reading data
+             * when we have an actual range of the file to cover */
+
+            /* Compute offset within file to start reading from,
+             * which includes section we're responsible for and any overlap.
+             * Also compute exact number of overlap bytes we will read. */
+            off_t offset;
+            if (offset_start > (off_t)overlap_size) {
+                /* a full overlap region fits before our section */
+                offset = (off_t)(offset_start - overlap_size);
+                overlap_before = overlap_size;
+            } else {
+                /* only a partial overlap section is available
+                 * before our section, so read from the start of the file */
+                offset = 0;
+                overlap_before = (uint64_t)offset_start;
+            }
+
+            /* allocate buffer to hold our entire region and leading overlap */
+            bufsize = overlap_before + region_size;
+            buf = (char*) MFU_MALLOC(bufsize);
+
+            /* seek to offset within the archive file */
+            int lseek_rc = mfu_lseek(filename, fd, offset, SEEK_SET);
+            if (lseek_rc == (off_t)-1) {
+               MFU_LOG(MFU_LOG_ERR, "Failed to seek to offset %llu in archive file '%s' errno=%d %s",
+                   offset, filename, errno, strerror(errno));
+               rc = MFU_FAILURE;
+            }
+
+            /* read data from archive into our buffer */
+            size_t total_read = 0;
+            while (total_read < bufsize && rc == MFU_SUCCESS) {
+                char* ptr = buf + total_read;
+                size_t remaining = bufsize - total_read;
+                ssize_t nread = mfu_read(filename, fd, ptr, remaining);
+                if (nread == 0) {
+                    /* hit unexpected end of the archive */
+                    MFU_LOG(MFU_LOG_ERR, "Failed to read all bytes in archive file '%s'",
+                        filename);
+                    rc = MFU_FAILURE;
+                    break;
+                }
+                if (nread < 0) {
+                    /* hit a read error */
+                    MFU_LOG(MFU_LOG_ERR, "Failed to read archive file '%s' errno=%d %s",
+                        filename, errno, strerror(errno));
+                    rc = MFU_FAILURE;
+                    break;
+                }
+
+                /* total up number of bytes read */
+                total_read += (size_t) nread;
+            }
+        }
+
+        /* variables to count number of entries we find,
+         * and byte offset within archive for each one */
+        uint64_t count = 0;
+        uint64_t* offsets = NULL;
+
+        /* pick among different algorithms to read file section and scan
+         * it for entry offsets, each process returns a list of offsets
+         * from its own region */
+        if (algo == SCAN_LINEAR) {
+            /* all procs read a section, linear scan from low to high rank
+             * to find entry offsets */
+            int tmp_rc = index_entries_distread_linearscan(filename, buf, bufsize,
+                overlap_before, offset_start, offset_last,
+                file_size, &starting_pos, &count, &offsets);
+            if (tmp_rc != MFU_SUCCESS) {
+                rc = tmp_rc;
+            }
+        } else {
+            /* all procs read a section, parallel search for "ustar" boundaries,
+             * and execute a parallel scan to find entry offsets, this currently
+             * can be fooled if an archive contains nested archives that are ill-formed
+             * or truncated */
+            int tmp_rc = index_entries_distread_parallelscan(filename, buf, bufsize,
+                overlap_before, offset_start, offset_last,
+                file_size, &starting_pos, &count, &offsets);
+            if (tmp_rc != MFU_SUCCESS) {
+                rc = tmp_rc;
+            }
+        }
+
+        /* gather list of global offsets */
+        uint64_t tmp_count;
+        uint64_t* tmp_offsets;
+        int* tmp_disps;
+        allgather_offsets(count, offsets, &tmp_count, &tmp_offsets, &tmp_disps);
+
+        /* figure out whether anyone failed */
+        if (mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+            /* append offsets from this round to our running list,
+             * allocate memory to hold the full list */
+            uint64_t new_count = total_count + tmp_count;
+            uint64_t* new_offsets = (uint64_t*) MFU_MALLOC(new_count * sizeof(uint64_t));
+
+            /* copy over existing list and free it */
+            uint64_t total_bytes = total_count * sizeof(uint64_t);
+            if (total_bytes > 0) {
+                memcpy(new_offsets, all_offsets, total_bytes);
+                mfu_free(&all_offsets);
+            }
+
+            /* append new entries to end of list */
+            char* ptr = (char*)new_offsets + total_bytes;
+            uint64_t tmp_bytes = tmp_count * sizeof(uint64_t);
+            memcpy(ptr, tmp_offsets, tmp_bytes);
+
+            /* reassing list variables to point to our new, longer list */
+            total_count = new_count;
+            all_offsets = new_offsets;
+        } else {
+            /* someone failed */
+            rc = MFU_FAILURE;
+        }
+
+        /* free memory buffers */
+        mfu_free(&tmp_disps);
+        mfu_free(&tmp_offsets);
+        mfu_free(&offsets);
+        mfu_free(&buf);
+
+        if (rank == 0) {
+            /* print progress message if needed */
+            double now = MPI_Wtime();
+            if (mfu_progress_timeout > 0 &&
+                (now - last) > mfu_progress_timeout &&
+                file_size > 0)
+            {
+                /* compute percent progress and estimated time remaining */
+                double percent = (double)starting_pos * 100.0 / (double)file_size;
+                double secs = now - start;
+                double secs_remaining = 0.0;
+                if (percent > 0.0) {
+                    secs_remaining = (double)(100.0 - percent) * secs / percent;
+                }
+                MFU_LOG(MFU_LOG_INFO, "Indexed %llu items in %.3lf secs (%.0f%%) %.0f secs left ...",
+                    total_count, secs, percent, secs_remaining
+                );
+                last = now;
+            }
+        }
+    }
+
+    /* print a final progress message if we may have printed any */
+    if (rank == 0) {
+        double now = MPI_Wtime();
+        double secs = now - start;
+        if (rc == MFU_SUCCESS &&
+            mfu_progress_timeout > 0 &&
+            secs > mfu_progress_timeout)
+        {
+            MFU_LOG(MFU_LOG_INFO, "Indexed %llu items in %.3lf secs (100%%) done",
+                total_count, secs
+            );
+        }
+    }
+
+    /* done reading the archive file, we can close it */
+    mfu_close(filename, fd);
+
+    /* figure out whether anyone failed */
+    if (rc == MFU_SUCCESS) {
+        /* return count and list of offsets */
+        *out_count   = total_count;
+        *out_offsets = all_offsets;
+    } else {
+        mfu_free(&all_offsets);
+        rc = MFU_FAILURE;
+    }
+
+    return rc;
+}
+
+/* name in the archive is relative,
+ * but paths in flist are absolute (typically),
+ * prepend given prefix and reduce resulting path */
+static const char* full_path_to_entry(
+    struct archive_entry* entry,
+    const mfu_path* prefix)
+{
+    /* get name of archive entry, this is likely a relative path */
+    const char* name = archive_entry_pathname(entry);
+    mfu_path* path = mfu_path_from_str(name);
+
+    /* prepend given prefix if entry path is not absolute */
+    if (! mfu_path_is_absolute(path)) {
+        mfu_path_prepend(path, prefix);
+    }
+
+    /* simplify the path */
+    mfu_path_reduce(path);
+
+    /* allocate the new path as a string to return */
+    char* str = mfu_path_strdup(path);
+    mfu_path_delete(&path);
+
+    return str;
+}
+
+/* given an entry data structure read from the archive,
+ * create a corresponding item in the flist */
+static void insert_entry_into_flist(
+    struct archive_entry* entry, /* entry to be inserted */
+    mfu_flist flist,             /* flist in which to insert item */
+    const mfu_path* prefix)      /* prepend prefix to entry path to get absolute path for flist */
+{
+    /* allocate a new item in our list, and get its index */
+    uint64_t idx = mfu_flist_file_create(flist);
+
+    /* name in the archive is relative,
+     * but paths in flist are absolute (typically),
+     * prepend given prefix and reduce resulting path */
+    const char* fullpath = full_path_to_entry(entry, prefix);
+    mfu_flist_file_set_name(flist, idx, fullpath);
+    mfu_free(&fullpath);
+
+    /* get mode of entry, and deduce mfu type */
+    mode_t mode = archive_entry_mode(entry);
+    mfu_filetype type = mfu_flist_mode_to_filetype(mode);
+    mfu_flist_file_set_type(flist, idx, type);
+
+    mfu_flist_file_set_mode(flist, idx, mode);
+
+    uint64_t uid = archive_entry_uid(entry);
+    mfu_flist_file_set_uid(flist, idx, uid);
+
+    uint64_t gid = archive_entry_gid(entry);
+    mfu_flist_file_set_gid(flist, idx, gid);
+
+    uint64_t atime = archive_entry_atime(entry);
+    mfu_flist_file_set_atime(flist, idx, atime);
+
+    uint64_t atime_nsec = archive_entry_atime_nsec(entry);
+    mfu_flist_file_set_atime_nsec(flist, idx, atime_nsec);
+
+    uint64_t mtime = archive_entry_mtime(entry);
+    mfu_flist_file_set_mtime(flist, idx, mtime);
+
+    uint64_t mtime_nsec = archive_entry_mtime_nsec(entry);
+    mfu_flist_file_set_mtime_nsec(flist, idx, mtime_nsec);
+
+    uint64_t ctime = archive_entry_ctime(entry);
+    mfu_flist_file_set_ctime(flist, idx, ctime);
+
+    uint64_t ctime_nsec = archive_entry_ctime_nsec(entry);
+    mfu_flist_file_set_ctime_nsec(flist, idx, ctime_nsec);
+
+    uint64_t size = archive_entry_size(entry);
+    mfu_flist_file_set_size(flist, idx, size);
+}
+
+/* given the full path of an item in an flist built from an archive,
+ * return a pointer to its path relative to the current working directory,
+ * which is the name the item has in the archive */
+static const char* entry_relative_name(const char* name, const char* cwd)
+{
+    size_t len = strlen(cwd);
+    if (len > 0 && cwd[len - 1] == '/') {
+        /* cwd is the root directory */
+        len--;
+    }
+    if (strncmp(name, cwd, len) == 0 && name[len] == '/') {
+        return name + len + 1;
+    }
+    return name;
+}
+
+/* returns true if the user selected the entry with the given name,
+ * which is the case if no members were specified, if name matches
+ * one of the member patterns, or if name is contained in a directory
+ * that matches one of the patterns */
+static bool entry_selected(const char* name, const mfu_archive_opts_t* opts)
+{
+    /* everything is selected if user did not name any members */
+    if (opts->member_count == 0) {
+        return true;
+    }
+
+    size_t len = strlen(name);
+    char* path = MFU_STRDUP(name);
+
+    bool selected = false;
+    uint64_t i;
+    for (i = 0; i < opts->member_count && !selected; i++) {
+        const char* pattern = opts->members[i];
+
+        /* check the name itself, and then each of its parent directories */
+        size_t end = len;
+        while (1) {
+            path[end] = '\0';
+            if (fnmatch(pattern, path, 0) == 0) {
+                selected = true;
+                break;
+            }
+
+            /* chop the last component */
+            while (end > 0 && path[end - 1] != '/') {
+                end--;
+            }
+            if (end == 0) {
+                break;
+            }
+            end--;
+        }
+
+        /* restore the full name for the next pattern */
+        strcpy(path, name);
+    }
+
+    mfu_free(&path);
+    return selected;
+}
+
+/* keep only the entries on this process that the user selected,
+ * replaces flist and the global lists of entry and data offsets,
+ * and updates the number of entries and our range of entries,
+ * processes may end up with different numbers of entries */
+static void select_entries(
+    const mfu_param_path* cwdpath, /* current working dir prepended to entries in flist */
+    mfu_archive_opts_t* opts,      /* options with list of member patterns */
+    uint64_t* entries,             /* total number of entries in archive */
+    uint64_t* entry_start,         /* global index of our first entry */
+    uint64_t* entry_count,         /* number of entries we have */
+    uint64_t** offsets,            /* global list of offsets to header of each entry */
+    uint64_t** data_offsets,       /* global list of offsets to data of each entry */
+    mfu_flist* flist)              /* list of our entries */
+{
+    uint64_t count = *entry_count;
+    uint64_t* my_offsets  = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t) + 1);
+    uint64_t* my_doffsets = (uint64_t*) MFU_MALLOC(count * sizeof(uint64_t) + 1);
+
+    /* copy entries that match into a new list */
+    mfu_flist selected = mfu_flist_subset(*flist);
+    uint64_t kept = 0;
+    uint64_t idx;
+    for (idx = 0; idx < count; idx++) {
+        const char* name = mfu_flist_file_get_name(*flist, idx);
+        const char* relname = entry_relative_name(name, cwdpath->path);
+        if (entry_selected(relname, opts)) {
+            mfu_flist_file_copy(*flist, idx, selected);
+            my_offsets[kept]  = (*offsets)[*entry_start + idx];
+            my_doffsets[kept] = (*data_offsets)[*entry_start + idx];
+            kept++;
+        }
+    }
+    mfu_flist_summarize(selected);
+
+    /* gather offsets of selected entries */
+    uint64_t total;
+    uint64_t* all_offsets;
+    uint64_t* all_doffsets;
+    int* rank_disps;
+    allgather_offsets(kept, my_offsets, &total, &all_offsets, &rank_disps);
+    mfu_free(&rank_disps);
+    allgather_offsets(kept, my_doffsets, &total, &all_doffsets, &rank_disps);
+    mfu_free(&rank_disps);
+
+    /* compute global index of our first selected entry */
+    uint64_t start;
+    MPI_Scan(&kept, &start, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    start -= kept;
+
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Selected %llu of %llu entries",
+            (unsigned long long) total, (unsigned long long) *entries);
+    }
+
+    /* replace the lists */
+    mfu_flist_free(flist);
+    *flist = selected;
+    mfu_free(offsets);
+    *offsets = all_offsets;
+    mfu_free(data_offsets);
+    *data_offsets = all_doffsets;
+    *entries     = total;
+    *entry_start = start;
+    *entry_count = kept;
+
+    mfu_free(&my_doffsets);
+    mfu_free(&my_offsets);
+}
+
+/* keep only the entries in flist that the user selected */
+static void select_flist(
+    const mfu_param_path* cwdpath,
+    mfu_archive_opts_t* opts,
+    mfu_flist* flist)
+{
+    mfu_flist selected = mfu_flist_subset(*flist);
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(*flist);
+    for (idx = 0; idx < size; idx++) {
+        const char* name = mfu_flist_file_get_name(*flist, idx);
+        const char* relname = entry_relative_name(name, cwdpath->path);
+        if (entry_selected(relname, opts)) {
+            mfu_flist_file_copy(*flist, idx, selected);
+        }
+    }
+    mfu_flist_summarize(selected);
+
+    mfu_flist_free(flist);
+    *flist = selected;
+}
+
+/* when extracting selected entries, the directories that contain
+ * them may not be in the list, so create any missing parents */
+static void create_parent_dirs(mfu_flist flist, const mfu_param_path* cwdpath)
+{
+    size_t cwdlen = strlen(cwdpath->path);
+
+    char* last = NULL;
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    for (idx = 0; idx < size; idx++) {
+        /* get parent directory of item */
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        mfu_path* path = mfu_path_from_str(name);
+        mfu_path_dirname(path);
+        char* dir = mfu_path_strdup(path);
+        mfu_path_delete(&path);
+
+        /* entries are typically grouped by directory,
+         * so skip the common case of a repeated parent */
+        if (last != NULL && strcmp(last, dir) == 0) {
+            mfu_free(&dir);
+            continue;
+        }
+        mfu_free(&last);
+        last = dir;
+
+        /* create each directory below cwd in turn,
+         * others may be creating the same directories */
+        char* ptr = dir;
+        if (strncmp(dir, cwdpath->path, cwdlen) == 0) {
+            ptr = dir + cwdlen;
+        }
+        while (*ptr != '\0') {
+            ptr = strchr(ptr + 1, '/');
+            if (ptr != NULL) {
+                *ptr = '\0';
+            }
+            if (mfu_mkdir(dir, DCOPY_DEF_PERMS_DIR) != 0 && errno != EEXIST) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to create directory `%s' (errno=%d %s)",
+                    dir, errno, strerror(errno));
+            }
+            if (ptr == NULL) {
+                break;
+            }
+            *ptr = '/';
+        }
+    }
+
+    mfu_free(&last);
+}
+
+/* max bytes of listing sent in a single message, which keeps
+ * the count of each message within an int */
+#define DTAR_LIST_PIECE (1024 * 1024 * 1024)
+
+/* print a line in the style of tar -tv for each item in the list,
+ * each process formats its lines and sends them to rank 0 in order */
+static void print_entries(mfu_flist flist, const mfu_param_path* cwdpath)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* compute space needed to format our lines */
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    size_t bufsize = 1;
+    for (idx = 0; idx < size; idx++) {
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        bufsize += strlen(name) + 128;
+    }
+
+    /* format our lines */
+    char* buf = (char*) MFU_MALLOC(bufsize);
+    size_t len = 0;
+    for (idx = 0; idx < size; idx++) {
+        const char* name = mfu_flist_file_get_name(flist, idx);
+        const char* relname = entry_relative_name(name, cwdpath->path);
+
+        char mode_format[11];
+        mfu_format_mode((mode_t) mfu_flist_file_get_mode(flist, idx), mode_format);
+
+        /* fall back to seconds since the epoch for times
+         * that can't be represented as a local time */
+        char time_format[32];
+        time_t mtime = (time_t) mfu_flist_file_get_mtime(flist, idx);
+        struct tm* mtime_tm = localtime(&mtime);
+        if (mtime_tm == NULL ||
+            strftime(time_format, sizeof(time_format), "%Y-%m-%d %H:%M", mtime_tm) == 0)
+        {
+            snprintf(time_format, sizeof(time_format), "%llu",
+                (unsigned long long) mfu_flist_file_get_mtime(flist, idx));
+        }
+
+        len += snprintf(buf + len, bufsize - len, "%s %llu/%llu %12llu %s %s\n",
+            mode_format,
+            (unsigned long long) mfu_flist_file_get_uid(flist, idx),
+            (unsigned long long) mfu_flist_file_get_gid(flist, idx),
+            (unsigned long long) mfu_flist_file_get_size(flist, idx),
+            time_format, relname);
+    }
+
+    /* rank 0 prints lines from each process in turn,
+     * receiving them in pieces of at most DTAR_LIST_PIECE bytes */
+    uint64_t bytes = (uint64_t) len;
+    if (rank == 0) {
+        fwrite(buf, 1, len, stdout);
+
+        int r;
+        for (r = 1; r < ranks; r++) {
+            MPI_Recv(&bytes, 1, MPI_UINT64_T, r, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            size_t piece_size = (bytes < DTAR_LIST_PIECE) ? (size_t) bytes : DTAR_LIST_PIECE;
+            char* recvbuf = (char*) MFU_MALLOC(piece_size + 1);
+            uint64_t done = 0;
+            while (done < bytes) {
+                int count = (int) ((bytes - done < piece_size) ? (bytes - done) : piece_size);
+                MPI_Recv(recvbuf, count, MPI_CHAR, r, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                fwrite(recvbuf, 1, (size_t) count, stdout);
+                done += (uint64_t) count;
+            }
+            mfu_free(&recvbuf);
+        }
+        fflush(stdout);
+    } else {
+        MPI_Send(&bytes, 1, MPI_UINT64_T, 0, 0, MPI_COMM_WORLD);
+        size_t done = 0;
+        while (done < len) {
+            int count = (int) ((len - done < DTAR_LIST_PIECE) ? (len - done) : DTAR_LIST_PIECE);
+            MPI_Send(buf + done, count, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+            done += (size_t) count;
+        }
+    }
+
+    mfu_free(&buf);
+}
+
+/* returns true if the user selected the given entry read from an archive */
+static bool archive_entry_selected(struct archive_entry* entry, const mfu_archive_opts_t* opts)
+{
+    if (opts->member_count == 0) {
+        return true;
+    }
+
+    /* simplify the name as when adding the entry to an flist */
+    mfu_path* path = mfu_path_from_str(archive_entry_pathname(entry));
+    mfu_path_reduce(path);
+    char* name = mfu_path_strdup(path);
+    mfu_path_delete(&path);
+
+    bool selected = entry_selected(name, opts);
+
+    mfu_free(&name);
+    return selected;
+}
+
+/* Given an archvive file, build file list of corresponding items,
+ * given a list of offsets to all items */
+static int extract_flist_offsets(
+    const char* filename,          /* name of archive file */
+    const mfu_param_path* cwdpath, /* path to prepend to any relative path in archive */
+    uint64_t entries,              /* total number of entries in archive */
+    uint64_t entry_start,          /* starting offset this process should handle */
+    uint64_t entry_count,          /* number of consecutive entries this process should read */
+    uint64_t* offsets,             /* offset to header of each entry */
+    uint64_t** data_offsets,       /* returns newly allocated list with offset to start of data for each entry */
+    mfu_flist flist)               /* file list in which to insert items */
+{
+    int r;
+
+    /* assume we'll succeed */
+    int rc = MFU_SUCCESS;
+
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting metadata");
+    }
+
+    /* prepare list for metadata details */
+    mfu_flist_set_detail(flist, 1);
+
+    /* open archive file for reading */
+    int fd = mfu_open(filename, O_RDONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' (errno=%d %s)",
+            filename, errno, strerror(errno)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* bail out with an error if anyone failed to open the archive */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        if (fd >= 0) {
+            mfu_close(filename, fd);
+        }
+        return MFU_FAILURE;
+    }
+
+    /* get current working directory to prepend to
+     * each entry to construct full path */
+    mfu_path* cwd = mfu_path_from_str(cwdpath->path);
+
+    /* allocate buffer to hold data offset for each of our items */
+    uint64_t* doffsets = (uint64_t*) MFU_MALLOC(entry_count * sizeof(uint64_t));
+
+    /* iterate over each entry we're responsible for */
+    uint64_t count = 0;
+    while (count < entry_count) {
+        /* compute offset and seek to this entry */
+        uint64_t idx = entry_start + count;
+        off_t offset = (off_t) offsets[idx];
+        off_t pos = mfu_lseek(filename, fd, offset, SEEK_SET);
+        if (pos == (off_t)-1) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to lseek to offset %llu in %s (errno=%d %s)",
+                offset, filename, errno, strerror(errno)
+            );
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* initiate archive object for reading */
+        struct archive* a = archive_read_new();
+
+        /* when using an index, we can assume the archive is not compressed */
+//        archive_read_support_filter_bzip2(a);
+//        archive_read_support_filter_gzip(a);
+//        archive_read_support_filter_compress(a);
+        archive_read_support_format_tar(a);
+
+        /* can use a small block size since we're just reading header info */
+        r = archive_read_open_fd(a, fd, 10240);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open archive to extract entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(a)
+            );
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* read entry header from archive */
+        struct archive_entry* entry;
+        r = archive_read_next_header(a, &entry);
+        if (r == ARCHIVE_EOF) {
+            MFU_LOG(MFU_LOG_ERR, "Unexpected end of archive, read %llu of %llu entries",
+                count, entry_count
+            );
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to extract entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(a)
+            );
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* read the entry, create a corresponding flist entry for it */
+        insert_entry_into_flist(entry, flist, cwd);
+
+        /* get byte position, which would be start of data for a regular file */
+        uint64_t header_size = (uint64_t) archive_filter_bytes(a, -1);
+        doffsets[count] = offset + header_size;
+
+        /* close out the read archive, to be sure it doesn't have memory */
+        r = archive_read_close(a);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to close archive after extracting entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(a)
+            );
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* release read archive */
+        r = archive_read_free(a);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to free archive after extracting entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(a)
+            );
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* advance to next entry */
+        count++;
+    }
+
+    mfu_flist_summarize(flist);
+
+    /* gather data offsets for all entries to all ranks */
+    uint64_t total_count;
+    int* rank_disps;
+    allgather_offsets(count, doffsets, &total_count, data_offsets, &rank_disps);
+
+    mfu_free(&rank_disps);
+    mfu_free(&doffsets);
+
+    mfu_path_delete(&cwd);
+
+    mfu_close(filename, fd);
+
+    /* check that all ranks succeeded */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+
+    return rc;
+}
+
+/* Given an archive file, build file list of corresponding items.
+ * All processes scan the archive and extract items in a round-robin manner. */
+static int extract_flist(
+    const char* filename,          /* name of archive file */
+    const mfu_param_path* cwdpath, /* path to prepend to relative path of each entry */
+    mfu_flist flist)               /* flist list to insert items into */
+{
+    /* assume we'll succeed */
+    int rc = MFU_SUCCESS;
+
+    /* prepare list for metadata details */
+    mfu_flist_set_detail(flist, 1);
+
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting metadata");
+    }
+
+    /* initiate archive object for reading */
+    struct archive* a = archive_read_new();
+
+    /* we want all the format supports */
+    archive_read_support_filter_bzip2(a);
+    archive_read_support_filter_gzip(a);
+    archive_read_support_filter_compress(a);
+    archive_read_support_format_tar(a);
+
+    if (filename != NULL && strcmp(filename, "-") == 0) {
+        filename = NULL;
+    }
+
+    /* blocksize set to 1024K */
+    int r = archive_read_open_filename(a, filename, 10240);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(a));
+        exit(r);
+    }
+
+    /* get current working directory */
+    mfu_path* cwd = mfu_path_from_str(cwdpath->path);
+
+    /* get number of ranks in our communicator */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* Read through archive and extract items to our list
+     * in a round-robin fashion.  This means different procs
+     * will be reading interleaved entries from the archive,
+     * but it enables all procs to get to work faster rather
+     * than have some end early and others scan to the very
+     * end (load imbalance). */
+    uint64_t count = 0;
+    while (1) {
+        /* read next item from archive */
+        struct archive_entry* entry;
+        r = archive_read_next_header(a, &entry);
+        if (r == ARCHIVE_EOF) {
+            /* hit end of the archive */
+            break;
+        }
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "%s", archive_error_string(a));
+            exit(r);
+        }
+
+        /* extract items round-robin across ranks */
+        if (count % ranks == mfu_rank) {
+            insert_entry_into_flist(entry, flist, cwd);
+        }
+
+        /* advance to the next item */
+        count++;
+    }
+
+    /* close out our list */
+    mfu_flist_summarize(flist);
+
+    mfu_path_delete(&cwd);
+
+    archive_read_close(a);
+    archive_read_free(a);
+
+    /* figure out whether anyone failed */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+
+    return rc;
+}
+
+/* progress message to print running count of bytes and items processed
+ * while extracting items from the archive */
+static void extract2_progress_fn(const uint64_t* vals, int count, int complete, int ranks, double secs)
+{
+    /* compute average rate */
+    double byte_rate = 0.0;
+    double item_rate = 0.0;
+    if (secs > 0) {
+        byte_rate = (double)vals[REDUCE_BYTES] / secs;
+        item_rate = (double)vals[REDUCE_ITEMS] / secs;
+    }
+
+    /* format number of bytes for printing */
+    double bytes_val = 0.0;
+    const char* bytes_units = NULL;
+    mfu_format_bytes(vals[REDUCE_BYTES], &bytes_val, &bytes_units);
+
+    /* format bandwidth for printing */
+    double bw_val = 0.0;
+    const char* bw_units = NULL;
+    mfu_format_bw(byte_rate, &bw_val, &bw_units);
+
+    /* compute percentage of bytes extracted */
+    double percent = 0.0;
+    if (DTAR_total_bytes > 0) {
+        percent = (double)vals[REDUCE_BYTES] * 100.0 / (double)DTAR_total_bytes;
+    }
+
+    /* estimate seconds remaining */
+    double secs_remaining = 0.0;
+    if (byte_rate > 0.0) {
+        secs_remaining = (double)(DTAR_total_bytes - vals[REDUCE_BYTES]) / byte_rate;
+    }
+
+    if (complete < ranks) {
+        MFU_LOG(MFU_LOG_INFO,
+            "Extracted %llu items and %.3lf %s (%.0f%%) in %.3lf secs (%.3lf items/sec, %.3lf %s) %.0f secs left ...",
+            vals[REDUCE_ITEMS], bytes_val, bytes_units, percent, secs, item_rate, bw_val, bw_units, secs_remaining
+        );
+    } else {
+        MFU_LOG(MFU_LOG_INFO,
+            "Extracted %llu items and %.3lf %s (%.0f%%) in %.3lf secs (%.3lf items/sec, %.3lf %s) done",
+            vals[REDUCE_ITEMS], bytes_val, bytes_units, percent, secs, item_rate, bw_val, bw_units
+        );
+    }
+}
+
+/* progress message to print sum of bytes while extracting items from the archive */
+static void extract1_progress_fn(const uint64_t* vals, int count, int complete, int ranks, double secs)
+{
+    /* compute average rate */
+    double byte_rate = 0.0;
+    if (secs > 0) {
+        byte_rate = (double)vals[REDUCE_BYTES] / secs;
+    }
+
+    /* format number of bytes for printing */
+    double bytes_val = 0.0;
+    const char* bytes_units = NULL;
+    mfu_format_bytes(vals[REDUCE_BYTES], &bytes_val, &bytes_units);
+
+    /* format bandwidth for printing */
+    double bw_val = 0.0;
+    const char* bw_units = NULL;
+    mfu_format_bw(byte_rate, &bw_val, &bw_units);
+
+    /* compute percentage of bytes extracted */
+    double percent = 0.0;
+    if (DTAR_total_bytes > 0) {
+        percent = (double)vals[REDUCE_BYTES] * 100.0 / (double)DTAR_total_bytes;
+    }
+
+    /* estimate seconds remaining */
+    double secs_remaining = 0.0;
+    if (byte_rate > 0.0) {
+        secs_remaining = (double)(DTAR_total_bytes - vals[REDUCE_BYTES]) / byte_rate;
+    }
+
+    if (complete < ranks) {
+        MFU_LOG(MFU_LOG_INFO,
+            "Extracted %.3lf %s (%.0f%%) in %.3lf secs (%.3lf %s) %.0f secs left ...",
+            bytes_val, bytes_units, percent, secs, bw_val, bw_units, secs_remaining
+        );
+    } else {
+        MFU_LOG(MFU_LOG_INFO,
+            "Extracted %.3lf %s (%.0f%%) in %.3lf secs (%.3lf %s) done",
+            bytes_val, bytes_units, percent, secs, bw_val, bw_units
+        );
+    }
+}
+
+/* compute total bytes in regular files in flist */
+static uint64_t flist_sum_bytes(mfu_flist flist)
+{
+    /* sum up bytes in our portion of the list */
+    uint64_t bytes = 0;
+    if (mfu_flist_have_detail(flist)) {
+        uint64_t idx = 0;
+        uint64_t max = mfu_flist_size(flist);
+        for (idx = 0; idx < max; idx++) {
+            /* get size of regular files */
+            mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+            if (type == MFU_TYPE_FILE) {
+                uint64_t size = mfu_flist_file_get_size(flist, idx);
+                bytes += size;
+            }
+        }
+    }
+
+    /* get total bytes across all ranks */
+    uint64_t total_bytes;
+    MPI_Allreduce(&bytes, &total_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    return total_bytes;
+}
+
+/* Extract items from a given archive file, given the offset of each entry in the archive.
  * This uses libarchive to actually read data from the archive and write to an item on disk. */
 static int extract_files_offsets_libarchive(
     const char* filename,     /* name of archive file */
@@ -4252,1497 +6261,3646 @@ static int extract_files_offsets_libarchive(
     /* assume we'll succeed */
     int rc = MFU_SUCCESS;
 
-    /* indicate to user what phase we're in */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Extracting items");
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting items");
+    }
+
+    /* intitialize counters to track number of bytes and items extracted */
+    reduce_buf[REDUCE_BYTES] = 0;
+    reduce_buf[REDUCE_ITEMS] = 0;
+
+    /* start progress messages while setting metadata */
+    extract_prog = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, extract2_progress_fn);
+
+    /* open the archive file for reading */
+    int fd = mfu_open(filename, O_RDONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
+            filename, errno, strerror(errno)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* check that everyone opened the archive successfully */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        /* someone failed, close the file if we opened it and return */
+        if (fd >= 0) {
+            mfu_close(filename, fd);
+        }
+        return MFU_FAILURE;
+    }
+
+    /* initiate object for writing items out to disk */
+    struct archive* ext = archive_write_disk_new();
+    int r = archive_write_disk_set_options(ext, flags);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to set options on write object %s",
+            archive_error_string(ext)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* use system calls to lookup uname/gname (follows POSIX pax) */
+    r = archive_write_disk_set_standard_lookup(ext);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to set standard uname/gname lookup on write object %s",
+            archive_error_string(ext)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* iterate over and extract each item we're responsible for */
+    uint64_t count = 0;
+    while (count < entry_count && rc == MFU_SUCCESS) {
+        /* seek to start of the entry in the archive file */
+        uint64_t idx = entry_start + count;
+        off_t offset = (off_t) offsets[idx];
+        off_t pos = mfu_lseek(filename, fd, offset, SEEK_SET);
+        if (pos == (off_t)-1) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to seek to offset %llu in open archive: '%s' errno=%d %s",
+                offset, filename, errno, strerror(errno)
+            );
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* initiate archive object for reading,
+         * we do this new each time to be sure that state is
+         * not left over from the previous item */
+        struct archive* a = archive_read_new();
+
+        /* when using offsets, we assume there is no compression */
+//        archive_read_support_filter_bzip2(a);
+//        archive_read_support_filter_gzip(a);
+//        archive_read_support_filter_compress(a);
+        archive_read_support_format_tar(a);
+
+        /* we can use a large blocksize for reading,
+         * since we'll read headers and data in a contiguous
+         * region of the file */
+        r = archive_read_open_fd(a, fd, opts->buf_size);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "opening archive to extract entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(a)
+            );
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* read the entry header for this item */
+        struct archive_entry* entry;
+        r = archive_read_next_header(a, &entry);
+        if (r == ARCHIVE_EOF) {
+            MFU_LOG(MFU_LOG_ERR, "unexpected end of archive, read %llu of %llu items",
+                count, entry_count
+            );
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "extracting entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(a)
+            );
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* got an entry, create corresponding item on disk and
+         * then copy data */
+        r = archive_write_header(ext, entry);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "writing entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(ext)
+            );
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        } else {
+            /* extract file data (if item is a file) */
+            int tmp_rc = copy_data(a, ext);
+            if (tmp_rc != MFU_SUCCESS) {
+                archive_read_close(a);
+                archive_read_free(a);
+                rc = tmp_rc;
+                break;
+            }
+        }
+
+        /* set any properties on the item that need to be set at end,
+         * e.g., turn off write bit on a file we just wrote or set timestamps */
+        r = archive_write_finish_entry(ext);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "finish writing entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(ext)
+            );
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* increment our count of items extracted */
+        reduce_buf[REDUCE_ITEMS]++;
+
+        /* update number of items we have completed for progress messages */
+        mfu_progress_update(reduce_buf, extract_prog);
+
+        /* close out the read archive object */
+        r = archive_read_close(a);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to close read archive %s",
+                archive_error_string(a)
+            );
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* free memory allocated in read archive object */
+        r = archive_read_free(a);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to free read archive %s",
+                archive_error_string(a)
+            );
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* advance to our next entry */
+        count++;
+    }
+
+    /* close out our write archive, this may update timestamps and permissions on items */
+    r = archive_write_close(ext);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to close archive for writing to disk %s",
+            archive_error_string(ext)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* free off our write archive, this may update timestamps and permissions on items */
+    r = archive_write_free(ext);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to free archive for writing to disk %s",
+            archive_error_string(ext)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* finalize progress messages */
+    mfu_progress_complete(reduce_buf, &extract_prog);
+
+    /* Ensure all ranks have created all items before we close the write archive.
+     * libarchive can update timestamps on directories when closing out,
+     * so we want to ensure all child items exist first. */
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    /* if a directory already exists, libarchive does not currently update
+     * its timestamps when closing the write archive */
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    /* figure out whether anyone failed */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+
+    return rc;
+}
+
+/* Extract items from a given archive file, given the offset of each entry in the archive.
+ * This assumes all items have been created, and it uses mfu chunk lists to directly read
+ * data from the archive. */
+static int extract_files_offsets_chunk_libcircle(
+    const char* filename,     /* name of archive file */
+    int flags,                /* flags - not used in this context */
+    uint64_t entries,         /* number of entries in archive */
+    uint64_t entry_start,     /* global offset for entry this process should start with */
+    uint64_t entry_count,     /* number of consecutive items this process is responsible for */
+    uint64_t* data_offsets,   /* offset to start of data for each entry */
+    mfu_flist flist,          /* file list whose local elements correspond to items to extract */
+    mfu_archive_opts_t* opts) /* options to configure extract operation */
+{
+    /* assume we'll succeed */
+    int rc = MFU_SUCCESS;
+
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting file data");
+    }
+
+    /* open the archive file for reading */
+    int fd = mfu_open(filename, O_RDONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
+            filename, errno, strerror(errno)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* check that everyone opened the archive successfully */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        /* someone failed, close the file if we opened it and return */
+        if (fd >= 0) {
+            mfu_close(filename, fd);
+        }
+        return MFU_FAILURE;
+    }
+
+    /* get number of ranks in our communicator */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* Get list of item offsets across ranks.
+     * This will be used to compute the global index of an item
+     * given an owner rank and local index of that item on its owner rank. */
+    int* rank_disps = (int*) MFU_MALLOC(ranks * sizeof(int));
+    int item_offset = (int) mfu_flist_global_offset(flist);
+    MPI_Allgather(&item_offset, 1, MPI_INT, rank_disps, 1, MPI_INT, MPI_COMM_WORLD);
+
+    /* split the regular files listed in flist into chunks and distribute
+     * those chunks evenly across processes as a linked list */
+    mfu_file_chunk* data_chunks = mfu_file_chunk_list_alloc(flist, opts->chunk_size);
+
+    /* initialize counters to track number of bytes and items extracted */
+    reduce_buf[REDUCE_BYTES] = 0;
+    reduce_buf[REDUCE_ITEMS] = mfu_flist_size(flist);
+
+    /* record name and file descriptor of the open archive file */
+    DTAR_writer.name = filename;
+    DTAR_writer.fd   = fd;
+
+    /* get buffer to read/write data from the pool */
+    DTAR_writer.io_bufsize = opts->buf_size;
+    DTAR_writer.io_buf = MFU_BUF_GET(DTAR_writer.io_bufsize, 1024*1024);
+
+    /* we flip this to 1 if any process hits any error writing the archive */
+    DTAR_err = 0;
+
+    /* save list to global for encode */
+    DTAR_opts         = opts;
+    DTAR_data_offsets = data_offsets;
+    DTAR_rank_disps   = rank_disps;
+    DTAR_data_chunks  = data_chunks;
+
+    /* prepare libcircle */
+    CIRCLE_init(0, NULL, CIRCLE_SPLIT_EQUAL | CIRCLE_CREATE_GLOBAL | CIRCLE_TERM_TREE);
+    CIRCLE_loglevel loglevel = CIRCLE_LOG_WARN;
+    CIRCLE_enable_logging(loglevel);
+
+    /* register callbacks */
+    CIRCLE_cb_create(&DTAR_enqueue_extract);
+    CIRCLE_cb_process(&DTAR_perform_extract);
+
+    /* prepare callbacks and initialize variables for reductions */
+    reduce_start = MPI_Wtime();
+    reduce_bytes = 0;
+    reduce_opstr = "Extracted";
+    CIRCLE_cb_reduce_init(&reduce_init);
+    CIRCLE_cb_reduce_op(&reduce_exec);
+    CIRCLE_cb_reduce_fini(&reduce_fini);
+
+    /* set libcircle reduction period */
+    int reduce_secs = 0;
+    if (mfu_progress_timeout > 0) {
+        reduce_secs = mfu_progress_timeout;
+    }
+    CIRCLE_set_reduce_period(reduce_secs);
+
+    /* run the libcircle job to copy data into archive file */
+    CIRCLE_begin();
+    CIRCLE_finalize();
+
+    /* done writing, close any source file that is still open */
+    mfu_archive_close_file(&mfu_archive_dst_cache);
+
+    /* free chunk list */
+    mfu_file_chunk_list_free(&data_chunks);
+
+    /* set number of bytes we reduced */
+    reduce_buf[REDUCE_BYTES] = reduce_bytes;
+
+    /* free off memory */
+    mfu_free(&rank_disps);
+    mfu_buf_put(&DTAR_writer.io_buf);
+
+    /* figure out whether anyone failed */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+
+    return rc;
+}
+
+/* Extract items from a given archive file, given the offset of each entry in the archive.
+ * This assumes all items have been created, and it uses mfu chunk lists to directly read
+ * data from the archive. */
+static int extract_files_offsets_chunk(
+    const char* filename,     /* name of archive file */
+    int flags,                /* flags - not used in this context */
+    uint64_t entries,         /* number of entries in archive */
+    uint64_t entry_start,     /* global offset for entry this process should start with */
+    uint64_t entry_count,     /* number of consecutive items this process is responsible for */
+    uint64_t* data_offsets,   /* offset to start of data for each entry */
+    mfu_flist flist,          /* file list whose local elements correspond to items to extract */
+    mfu_archive_opts_t* opts) /* options to configure extract operation */
+{
+    /* assume we'll succeed */
+    int rc = MFU_SUCCESS;
+
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting file data");
+    }
+
+    /* open the archive file for reading */
+    int fd = mfu_open(filename, O_RDONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
+            filename, errno, strerror(errno)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* check that everyone opened the archive successfully */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        /* someone failed, close the file if we opened it and return */
+        if (fd >= 0) {
+            mfu_close(filename, fd);
+        }
+        return MFU_FAILURE;
+    }
+
+    /* get number of ranks in our communicator */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* Get list of item offsets across ranks.
+     * This will be used to compute the global index of an item
+     * given an owner rank and local index of that item on its owner rank. */
+    int* rank_disps = (int*) MFU_MALLOC(ranks * sizeof(int));
+    int item_offset = (int) mfu_flist_global_offset(flist);
+    MPI_Allgather(&item_offset, 1, MPI_INT, rank_disps, 1, MPI_INT, MPI_COMM_WORLD);
+
+    /* get I/O buffer to read/write data from the pool */
+    size_t bufsize = opts->buf_size;
+    void* buf = MFU_BUF_GET(bufsize, 1024*1024);
+
+    /* split the regular files listed in flist into chunks and distribute
+     * those chunks evenly across processes as a linked list */
+    mfu_file_chunk* data_chunks = mfu_file_chunk_list_alloc(flist, opts->chunk_size);
+
+    /* initialize counters to track number of bytes and items extracted */
+    reduce_buf[REDUCE_BYTES] = 0;
+    reduce_buf[REDUCE_ITEMS] = mfu_flist_size(flist);
+
+    /* start progress messages while setting metadata,
+     * in this case, we can track bytes accurately but not items */
+    extract_prog = mfu_progress_start(mfu_progress_timeout, 1, MPI_COMM_WORLD, extract1_progress_fn);
+    
+    /* iterate over items and copy data for each one */
+    mfu_file_chunk* p = data_chunks;
+    while (p != NULL && rc == MFU_SUCCESS) {
+        /* compute global index of item */
+        int owner_rank = p->rank_of_owner;
+        uint64_t global_idx = rank_disps[owner_rank] + p->index_of_owner;
+        uint64_t data_offset = data_offsets[global_idx];
+
+        /* open the destination file for writing */
+        const char* out_name = p->name;
+        int out_fd = mfu_open(out_name, O_WRONLY);
+        if (out_fd < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open destination file '%s' errno=%d %s",
+                out_name, errno, strerror(errno));
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* copy data from archive file to destination file */
+        uint64_t bytes_copied = 0;
+        uint64_t length = p->length;
+        while (bytes_copied < length) {
+            /* compute number of bytes to read in this step */
+            size_t bytes_to_read = bufsize;
+            uint64_t remainder = length - bytes_copied;
+            if (remainder < (uint64_t) bytes_to_read) {
+                bytes_to_read = (size_t) remainder;
+            }
+
+            /* read data from archive file */
+            off_t pos_read = (off_t)data_offset + (off_t)p->offset + (off_t)bytes_copied;
+            ssize_t nread = mfu_pread(filename, fd, buf, bytes_to_read, pos_read);
+            if (nread < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read archive file '%s' errno=%d %s",
+                    filename, errno, strerror(errno));
+                rc = MFU_FAILURE;
+                break;
+            }
+            if (nread == 0) {
+                MFU_LOG(MFU_LOG_ERR, "Unexpected end of archive file '%s'",
+                    filename);
+                DTAR_err = 1;
+                rc = MFU_FAILURE;
+                break;
+            }
+
+            /* write data to the file */
+            off_t pos_write = (off_t)p->offset + (off_t)bytes_copied;
+            ssize_t nwritten = mfu_pwrite(out_name, out_fd, buf, nread, pos_write);
+            if (nwritten < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to write to destination file '%s' errno=%d %s",
+                    out_name, errno, strerror(errno));
+                DTAR_err = 1;
+                rc = MFU_FAILURE;
+                break;
+            }
+
+            /* update number of bytes written */
+            bytes_copied += nwritten;
+
+            /* update number of items we have completed for progress messages */
+            reduce_buf[REDUCE_BYTES] += nwritten;
+            mfu_progress_update(reduce_buf, extract_prog);
+        }
+
+        /* close the user file being written */
+        int close_rc = mfu_close(out_name, out_fd);
+        if (close_rc == -1) {
+           /* worth reporting, don't consider this a fatal error */
+           MFU_LOG(MFU_LOG_ERR, "Failed to close destination file '%s' errno=%d %s",
+               out_name, errno, strerror(errno));
+        }
+
+        /* advance to next file segment in our list */
+        p = p->next;
+    }
+
+    /* finalize progress messages */
+    mfu_progress_complete(reduce_buf, &extract_prog);
+
+    /* free chunk list */
+    mfu_file_chunk_list_free(&data_chunks);
+
+    /* free off memory */
+    mfu_free(&rank_disps);
+    mfu_buf_put(&buf);
+
+    /* figure out whether anyone failed */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+
+    return rc;
+}
+
+/* Extract items from the specified archive file the hard way.
+ * Each process reads the archive from the beginning and extracts
+ * items in a round-robin fashion based on its rank number.
+ * This permits processing of compressed archives, and those that
+ * use global headers. */
+static int extract_files(
+    const char* filename,    /* name of the archive file */
+    int flags,               /* flags to pass to archive_write_disk_set_options */
+    uint64_t entries,
+    uint64_t entry_start,
+    uint64_t entry_count,
+    mfu_flist flist,
+    mfu_archive_opts_t* opts)
+{
+    /* assume we'll succeed */
+    int rc = MFU_SUCCESS;
+
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting items");
+    }
+
+    /* initialize counters to track number of bytes extracted */
+    reduce_buf[REDUCE_BYTES] = 0;
+    reduce_buf[REDUCE_ITEMS] = 0;
+
+    /* start progress messages while setting metadata */
+    extract_prog = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, extract2_progress_fn);
+
+    /* initiate archive object for reading */
+    struct archive* a = archive_read_new();
+
+    /* in the general case, we want potential compression
+     * schemes in addition to tar format */
+    archive_read_support_filter_bzip2(a);
+    archive_read_support_filter_gzip(a);
+    archive_read_support_filter_compress(a);
+    archive_read_support_format_tar(a);
+
+    /* initiate archive object for writing items out to disk */
+    struct archive* ext = archive_write_disk_new();
+    int r = archive_write_disk_set_options(ext, flags);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to set options on write object %s",
+            archive_error_string(ext)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* use system calls to lookup uname/gname (follows POSIX pax) */
+    r = archive_write_disk_set_standard_lookup(ext);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to set standard uname/gname lookup on write object %s",
+            archive_error_string(ext)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* read from stdin? */
+    if (filename != NULL && strcmp(filename, "-") == 0) {
+        filename = NULL;
+    }
+
+    /* Block size is a bit hard to choose here.  If there are lots of
+     * small headers/files, it's best to use a small block size to skip through
+     * the list of files quickly without reading excess data.  But if there
+     * are a few large files, it would be better to use a large block size
+     * to efficiently read data once we get to our file.  Strike a balance
+     * of 1MB. */
+    r = archive_read_open_filename(a, filename, 1024 * 1024);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "opening archive '%s' %s",
+            filename, archive_error_string(a)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* get number of ranks in our communicator */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* iterate over all entry from the start of the file,
+     * looking to find the range of items it is responsible for */
+    uint64_t count = 0;
+    while (rc == MFU_SUCCESS) {
+        /* read the next entry from the archive */
+        struct archive_entry* entry;
+        r = archive_read_next_header(a, &entry);
+        if (r == ARCHIVE_EOF) {
+            break;
+        }
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "extracting entry %llu %s",
+                count, archive_error_string(a)
+            );
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* write item out to disk if this is one of our assigned items */
+        if (count % ranks == mfu_rank && archive_entry_selected(entry, opts)) {
+            /* create item on disk */
+            r = archive_write_header(ext, entry);
+            if (r != ARCHIVE_OK) {
+                MFU_LOG(MFU_LOG_ERR, "writing entry %llu %s",
+                    count, archive_error_string(ext)
+                );
+                rc = MFU_FAILURE;
+                break;
+            } else {
+                /* extract file data (if item is a file) */
+                int tmp_rc = copy_data(a, ext);
+                if (tmp_rc != MFU_SUCCESS) {
+                    rc = tmp_rc;
+                    break;
+                }
+            }
+
+            /* set any properties on the item that need to be set at end,
+             * e.g., turn off write bit on a file we just wrote or set timestamps */
+            r = archive_write_finish_entry(ext);
+            if (r != ARCHIVE_OK) {
+                MFU_LOG(MFU_LOG_ERR, "finish writing entry %llu %s",
+                    count, archive_error_string(ext)
+                );
+                rc = MFU_FAILURE;
+                break;
+            }
+
+            /* increment our count of items extracted */
+            reduce_buf[REDUCE_ITEMS]++;
+
+            /* update number of items we have completed for progress messages */
+            mfu_progress_update(reduce_buf, extract_prog);
+        }
+
+        /* advance to next entry in the archive */
+        count++;
+    }
+
+    /* free off our write archive, this may update timestamps and permissions on items */
+    r = archive_write_close(ext);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to close archive for writing to disk %s",
+            archive_error_string(ext)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* free off our write archive, this may update timestamps and permissions on items */
+    r = archive_write_free(ext);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to free archive for writing to disk %s",
+            archive_error_string(ext)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* finalize progress messages */
+    mfu_progress_complete(reduce_buf, &extract_prog);
+
+    /* Ensure all ranks have created all items before we close the write archive.
+     * libarchive will update timestamps on directories when closing out,
+     * so we want to ensure all child items exist at this point. */
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    /* close out the read archive object */
+    r = archive_read_close(a);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to close read archive %s",
+            archive_error_string(a)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* free memory allocated in read archive object */
+    r = archive_read_free(a);
+    if (r != ARCHIVE_OK) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to free read archive %s",
+            archive_error_string(a)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* if a directory already exists, libarchive does not currently update
+     * its timestamps when closing the write archive,
+     * update timestamps on directories */
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    /* figure out whether anyone failed */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+
+    return rc;
+}
+
+/* iterate through our portion of the given file list,
+ * identify symlinks and extract them from archive */
+static int extract_symlinks(
+    const char* filename,     /* name of archive file */
+    mfu_flist flist,          /* file list of items */
+    uint64_t* offsets,        /* offset of each item in the archive */
+    mfu_archive_opts_t* opts) /* options to configure extraction operation */
+{
+    int rc = MFU_SUCCESS;
+
+    /* iterate over all items in our list and count symlinks */
+    uint64_t count = 0;
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    for (idx = 0; idx < size; idx++) {
+        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+        if (type == MFU_TYPE_LINK) {
+            /* found a symlink */
+            count++;
+        }
+    }
+
+    /* count total number of links */
+    uint64_t all_count;
+    MPI_Allreduce(&count, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    /* bail out early if there is nothing to do */
+    if (all_count == 0) {
+        return MFU_SUCCESS;
+    }
+
+    /* let user know what we're doing */
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Creating %llu symlinks", (unsigned long long)all_count);
+    }
+
+    /* open the archive file for reading */
+    int fd = mfu_open(filename, O_RDONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
+            filename, errno, strerror(errno)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* check that everyone opened the archive successfully */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        /* someone failed, close the file if we opened it and return */
+        if (fd >= 0) {
+            mfu_close(filename, fd);
+        }
+        return MFU_FAILURE;
+    }
+
+    /* get global offset of our portion of the list */
+    uint64_t global_offset = mfu_flist_global_offset(flist);
+
+    /* iterate over all items in our list and create any symlinks */
+    for (idx = 0; idx < size; idx++) {
+        /* skip entries that are not symlinks */
+        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+        if (type != MFU_TYPE_LINK) {
+            /* not a symlink, go to next item */
+            continue;
+        }
+
+        /* got a symlink, get its path */
+        const char* name = mfu_flist_file_get_name(flist, idx);
+
+        /* seek to start of the corresponding entry in the archive file */
+        uint64_t global_idx = global_offset + idx;
+        off_t offset = (off_t) offsets[global_idx];
+        off_t pos = mfu_lseek(filename, fd, offset, SEEK_SET);
+        if (pos == (off_t)-1) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to seek to offset %llu in open archive: '%s' errno=%d %s",
+                offset, filename, errno, strerror(errno)
+            );
+            rc = MFU_FAILURE;
+            continue;
+        }
+
+        /* initiate archive object for reading */
+        struct archive* a = archive_read_new();
+
+        /* when using offsets, we assume there is no compression */
+//        archive_read_support_filter_bzip2(a);
+//        archive_read_support_filter_gzip(a);
+//        archive_read_support_filter_compress(a);
+        archive_read_support_format_tar(a);
+
+        /* use a small read block size, since we just need the header */
+        int r = archive_read_open_fd(a, fd, 10240);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "opening archive to extract symlink `%s' at offset %llu %s",
+                name, offset, archive_error_string(a)
+            );
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            continue;
+        }
+
+        /* read the entry header for this item */
+        struct archive_entry* entry;
+        r = archive_read_next_header(a, &entry);
+        if (r == ARCHIVE_EOF) {
+            MFU_LOG(MFU_LOG_ERR, "Unexpected end of archive while extracting symlink `%s' at offset %llu",
+                name, offset
+            );
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            continue;
+        }
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Extracting symlink '%s' at offset %llu %s",
+                name, offset, archive_error_string(a)
+            );
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            continue;
+        }
+
+        /* get target of the link */
+        const char* target = archive_entry_symlink(entry);
+        if (target == NULL) {
+            MFU_LOG(MFU_LOG_ERR, "Item is not a symlink as expected `%s'",
+                name);
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            continue;
+        }
+
+        /* create the link on the file system */
+        int symlink_rc = mfu_symlink(target, name);
+        if (symlink_rc != 0) {
+            /* TODO: check whether user wants overwrite */
+            if (errno == EEXIST) {
+                /* failed because something exists,
+                 * attempt to delete item and try again */
+                mfu_unlink(name);
+                symlink_rc = mfu_symlink(target, name);
+            }
+
+            /* if we still failed, give up */
+            if (symlink_rc != 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to set symlink `%s' (errno=%d %s)",
+                    name, errno, strerror(errno));
+                rc = MFU_FAILURE;
+            }
+        }
+
+        /* close out the read archive object */
+        r = archive_read_close(a);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to close read archive %s",
+                archive_error_string(a)
+            );
+            rc = MFU_FAILURE;
+        }
+
+        /* free memory allocated in read archive object */
+        r = archive_read_free(a);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to free read archive %s",
+                archive_error_string(a)
+            );
+            rc = MFU_FAILURE;
+        }
+    }
+
+    /* close the archive file */
+    mfu_close(filename, fd);
+
+    /* figure out whether anyone failed */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+
+    return rc;
+}
+
+/* Extract xattrs from archive file and copy to item.
+ * This uses libarchive to actually read the entry from the archive */
+static int extract_xattrs(
+    const char* filename,     /* name of archive file */
+    const mfu_param_path* cwdpath, /* path to prepend to any relative path in archive */
+    int flags,                /* flags passed to archive_write_disk_set_options */
+    uint64_t entries,         /* number of total entries in offsets array */
+    uint64_t entry_start,     /* starting offset in offsets we're responsible for */
+    uint64_t entry_count,     /* number of entries we're responsible for */
+    uint64_t* offsets,        /* offset to each entry in the archive */
+    mfu_flist flist,          /* file list corresponding to our subset of entries */
+    mfu_archive_opts_t* opts) /* options to configure extract operation */
+{
+    /* assume we'll succeed */
+    int rc = MFU_SUCCESS;
+
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting xattrs");
+    }
+
+    /* intitialize counters to track number of bytes and items extracted */
+//    reduce_buf[REDUCE_BYTES] = 0;
+//    reduce_buf[REDUCE_ITEMS] = 0;
+
+    /* start progress messages while setting metadata */
+//    extract_prog = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, extract2_progress_fn);
+
+    /* open the archive file for reading */
+    int fd = mfu_open(filename, O_RDONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
+            filename, errno, strerror(errno)
+        );
+        rc = MFU_FAILURE;
+    }
+
+    /* check that everyone opened the archive successfully */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        /* someone failed, close the file if we opened it and return */
+        if (fd >= 0) {
+            mfu_close(filename, fd);
+        }
+        return MFU_FAILURE;
+    }
+
+    /* get current working directory */
+    mfu_path* cwd = mfu_path_from_str(cwdpath->path);
+
+    /* iterate over and extract each item we're responsible for */
+    uint64_t count = 0;
+    while (count < entry_count && rc == MFU_SUCCESS) {
+        /* seek to start of the entry in the archive file */
+        uint64_t idx = entry_start + count;
+        off_t offset = (off_t) offsets[idx];
+        off_t pos = mfu_lseek(filename, fd, offset, SEEK_SET);
+        if (pos == (off_t)-1) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to seek to offset %llu in open archive: '%s' errno=%d %s",
+                offset, filename, errno, strerror(errno)
+            );
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* initiate archive object for reading,
+         * we do this new each time to be sure that state is
+         * not left over from the previous item */
+        struct archive* a = archive_read_new();
+
+        /* when using offsets, we assume there is no compression */
+//        archive_read_support_filter_bzip2(a);
+//        archive_read_support_filter_gzip(a);
+//        archive_read_support_filter_compress(a);
+        archive_read_support_format_tar(a);
+
+        /* use a small block size since we're just reading headers */
+        int r = archive_read_open_fd(a, fd, 10240);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "opening archive to extract entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(a)
+            );
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* read the entry header for this item */
+        struct archive_entry* entry;
+        r = archive_read_next_header(a, &entry);
+        if (r == ARCHIVE_EOF) {
+            MFU_LOG(MFU_LOG_ERR, "unexpected end of archive, read %llu of %llu items",
+                count, entry_count
+            );
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "extracting entry %llu at offset %llu %s",
+                idx, offset, archive_error_string(a)
+            );
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* copy xattrs from entry to file */
+        int num = archive_entry_xattr_count(entry);
+        if (num > 0) {
+            /* get path to entry on the file system */
+            const char* path = full_path_to_entry(entry, cwd);
+
+            /* entry has some xattrs recorded, extract and apply them */
+            int i;
+            archive_entry_xattr_reset(entry);
+            for (i = 0; i < num; i++) {
+                /* read next xattr value recorded in archive entry */
+                const char* xname = NULL;
+                const void* xval  = NULL;
+                size_t xsize = 0;
+                r = archive_entry_xattr_next(entry, &xname, &xval, &xsize);
+                if (r == ARCHIVE_OK) {
+                    /* successfully extracted xattr, now try to set it */
+                    int set_rc = setxattr(path, xname, xval, xsize, 0);
+                    if (set_rc == -1) {
+                        MFU_LOG(MFU_LOG_ERR, "failed to setxattr '%s' on '%s' errno=%d %s",
+                            xname, path, errno, strerror(errno) 
+                        );
+                        rc = MFU_FAILURE;
+                        /* don't break in case other xattrs work */
+                    }
+                } else {
+                    /* failed to read xattr */
+                    MFU_LOG(MFU_LOG_ERR, "failed to extract xattr for '%s' of entry %llu at offset %llu",
+                        path, idx, offset
+                    );
+                    rc = MFU_FAILURE;
+                    /* don't break in case other xattrs work */
+                }
+            }
+
+            mfu_free(&path);
+        }
+
+        /* increment our count of items extracted */
+//        reduce_buf[REDUCE_ITEMS]++;
+
+        /* update number of items we have completed for progress messages */
+//        mfu_progress_update(reduce_buf, extract_prog);
+
+        /* close out the read archive object */
+        r = archive_read_close(a);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to close read archive %s",
+                archive_error_string(a)
+            );
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* free memory allocated in read archive object */
+        r = archive_read_free(a);
+        if (r != ARCHIVE_OK) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to free read archive %s",
+                archive_error_string(a)
+            );
+            rc = MFU_FAILURE;
+            break;
+        }
+
+        /* advance to our next entry */
+        count++;
+    }
+
+    /* free path object of current working directory */
+    mfu_path_delete(&cwd);
+
+    /* finalize progress messages */
+//    mfu_progress_complete(reduce_buf, &extract_prog);
+
+    /* figure out whether anyone failed */
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+
+    return rc;
+}
+
+typedef enum {
+    DEFAULT,        /* attempt to dynamically choose best option */
+    LIBARCHIVE,     /* read/write through libarchvie, round-robin items across ranks */
+    LIBARCHIVE_IDX, /* read/write through libarchvie, lseek to each entry */
+    CHUNK,          /* direct read of data, chunk list */
+    LIBCIRCLE       /* direct read of data, chunk list to init libcircle */
+} mfu_flist_archive_extract_algo;
+
+static mfu_flist_archive_extract_algo select_extract_algo(void)
+{
+    mfu_flist_archive_extract_algo algo = DEFAULT;
+
+    const char varname[] = "MFU_FLIST_ARCHIVE_EXTRACT";
+    const char* value = getenv(varname);
+    if (value == NULL) {
+        return algo;
     }
 
-    /* intitialize counters to track number of bytes and items extracted */
-    reduce_buf[REDUCE_BYTES] = 0;
-    reduce_buf[REDUCE_ITEMS] = 0;
-
-    /* start progress messages while setting metadata */
-    extract_prog = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, extract2_progress_fn);
+    if (strcmp(value, "DEFAULT") == 0) {
+        algo = DEFAULT;
+    } else if (strcmp(value, "LIBARCHIVE") == 0) {
+        algo = LIBARCHIVE;
+    } else if (strcmp(value, "LIBARCHIVE_IDX") == 0) {
+        algo = LIBARCHIVE_IDX;
+    } else if (strcmp(value, "CHUNK") == 0) {
+        algo = CHUNK;
+    } else if (strcmp(value, "LIBCIRCLE") == 0) {
+        algo = LIBCIRCLE;
+    } else {
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "%s: unknown value %s", varname, value);
+        }
+        value = "DEFAULT";
+        algo = DEFAULT;
+    }
 
-    /* open the archive file for reading */
-    int fd = mfu_open(filename, O_RDONLY);
-    if (fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
-            filename, errno, strerror(errno)
-        );
-        rc = MFU_FAILURE;
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "%s: %s", varname, value);
     }
 
-    /* check that everyone opened the archive successfully */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        /* someone failed, close the file if we opened it and return */
-        if (fd >= 0) {
-            mfu_close(filename, fd);
+    return algo;
+}
+
+/* return a file list of just the directories */
+static mfu_flist flist_get_dirs(mfu_flist flist)
+{
+    /* create a subset list to copy items into */
+    mfu_flist flist_dirs = mfu_flist_subset(flist);
+
+    /* iterate over items in our list and copy each directory */
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(flist);
+    for (idx = 0; idx < size; idx++) {
+        /* if item is a directory, copy it to the directory list */
+        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+        if (type == MFU_TYPE_DIR) {
+            mfu_flist_file_copy(flist, idx, flist_dirs);
         }
-        return MFU_FAILURE;
     }
 
-    /* initiate object for writing items out to disk */
-    struct archive* ext = archive_write_disk_new();
-    int r = archive_write_disk_set_options(ext, flags);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to set options on write object %s",
-            archive_error_string(ext)
-        );
-        rc = MFU_FAILURE;
+    /* finalize the directory list */
+    mfu_flist_summarize(flist_dirs);
+
+    return flist_dirs;
+}
+
+/* configure behavior when creating extracted items (overwrite, lustre striping, etc),
+ * caller must free the returned options with mfu_create_opts_delete */
+static mfu_create_opts_t* extract_create_opts_new(const mfu_archive_opts_t* opts)
+{
+    mfu_create_opts_t* create_opts = mfu_create_opts_new();
+
+    /* overwrite any existing files by default */
+    create_opts->overwrite = true;
+
+    /* Set timestamps and permission bits on extracted items by default.
+     * We don't set uid/gid, since the tarball may have encoded uid/gid
+     * from another user. */
+    create_opts->set_owner       = opts->preserve_owner;
+    create_opts->set_timestamps  = opts->preserve_times;
+    create_opts->set_permissions = opts->preserve_permissions;
+
+    /* TODO: set these based on either auto-detection that CWD is lustre
+     * or directives from user */
+    create_opts->lustre_stripe         = false;
+    create_opts->lustre_stripe_width   = opts->chunk_size;
+    create_opts->lustre_stripe_minsize = 1024ULL * 1024ULL * 1024ULL;
+
+    return create_opts;
+}
+
+/* wait for all processes to finish extracting items,
+ * and print timing and a summary of items and bytes extracted */
+static void print_extract_stats(
+    time_t time_started,  /* time at which extract started */
+    double wtime_started) /* MPI_Wtime at which extract started */
+{
+    /* wait for all to finish */
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    /* stop overall timer */
+    time_t time_ended;
+    time(&time_ended);
+    double wtime_ended = MPI_Wtime();
+
+    /* prep our values into buffer */
+    int64_t values[2];
+    values[0] = reduce_buf[REDUCE_ITEMS];
+    values[1] = reduce_buf[REDUCE_BYTES];
+
+    /* sum values across processes */
+    int64_t sums[2];
+    MPI_Allreduce(values, sums, 2, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    /* extract results from allreduce */
+    int64_t agg_items = sums[0];
+    int64_t agg_bytes = sums[1];
+
+    /* compute number of seconds */
+    double secs = wtime_ended - wtime_started;
+
+    /* compute rate of copy */
+    double agg_bw = (double)agg_bytes / secs;
+    if (secs > 0.0) {
+        agg_bw = (double)agg_bytes / secs;
     }
 
-    /* use system calls to lookup uname/gname (follows POSIX pax) */
-    r = archive_write_disk_set_standard_lookup(ext);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to set standard uname/gname lookup on write object %s",
-            archive_error_string(ext)
+    if(mfu_rank == 0) {
+        /* format start time */
+        char starttime_str[256];
+        struct tm* localstart = localtime(&time_started);
+        strftime(starttime_str, 256, "%b-%d-%Y, %H:%M:%S", localstart);
+
+        /* format end time */
+        char endtime_str[256];
+        struct tm* localend = localtime(&time_ended);
+        strftime(endtime_str, 256, "%b-%d-%Y, %H:%M:%S", localend);
+
+        /* convert size to units */
+        double agg_bytes_val;
+        const char* agg_bytes_units;
+        mfu_format_bytes((uint64_t)agg_bytes, &agg_bytes_val, &agg_bytes_units);
+
+        /* convert bandwidth to units */
+        double agg_bw_val;
+        const char* agg_bw_units;
+        mfu_format_bw(agg_bw, &agg_bw_val, &agg_bw_units);
+
+        MFU_LOG(MFU_LOG_INFO, "Started:   %s", starttime_str);
+        MFU_LOG(MFU_LOG_INFO, "Completed: %s", endtime_str);
+        MFU_LOG(MFU_LOG_INFO, "Seconds: %.3lf", secs);
+        MFU_LOG(MFU_LOG_INFO, "Items: %" PRId64, agg_items);
+        MFU_LOG(MFU_LOG_INFO,
+            "Data: %.3lf %s (%" PRId64 " bytes)",
+            agg_bytes_val, agg_bytes_units, agg_bytes
+        );
+        MFU_LOG(MFU_LOG_INFO,
+            "Rate: %.3lf %s (%.3" PRId64 " bytes in %.3lf seconds)",
+            agg_bw_val, agg_bw_units, agg_bytes, secs
         );
-        rc = MFU_FAILURE;
     }
+}
 
-    /* iterate over and extract each item we're responsible for */
-    uint64_t count = 0;
-    while (count < entry_count && rc == MFU_SUCCESS) {
-        /* seek to start of the entry in the archive file */
-        uint64_t idx = entry_start + count;
-        off_t offset = (off_t) offsets[idx];
-        off_t pos = mfu_lseek(filename, fd, offset, SEEK_SET);
-        if (pos == (off_t)-1) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to seek to offset %llu in open archive: '%s' errno=%d %s",
-                offset, filename, errno, strerror(errno)
-            );
-            rc = MFU_FAILURE;
-            break;
-        }
+/* given an archive file name, extract items into cwdpath according to options */
+static int extract_archive(
+    const char* filename,          /* name of archive file */
+    const mfu_param_path* cwdpath, /* path to prepend to entries in archive to build full path */
+    mfu_archive_opts_t* opts)      /* options to configure extract operation */
+{
+    int rc = MFU_SUCCESS;
 
-        /* initiate archive object for reading,
-         * we do this new each time to be sure that state is
-         * not left over from the previous item */
-        struct archive* a = archive_read_new();
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-        /* when using offsets, we assume there is no compression */
-//        archive_read_support_filter_bzip2(a);
-//        archive_read_support_filter_gzip(a);
-//        archive_read_support_filter_compress(a);
-        archive_read_support_format_tar(a);
+    /* start overall timer */
+    MPI_Barrier(MPI_COMM_WORLD);
+    time_t time_started;
+    time(&time_started);
+    double wtime_started = MPI_Wtime();
 
-        /* we can use a large blocksize for reading,
-         * since we'll read headers and data in a contiguous
-         * region of the file */
-        r = archive_read_open_fd(a, fd, opts->buf_size);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "opening archive to extract entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(a)
-            );
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
+    /* indicate to user what phase we're in */
+    if (mfu_rank == 0) {
+        if (opts->list) {
+            MFU_LOG(MFU_LOG_INFO, "Listing %s", filename);
+        } else {
+            MFU_LOG(MFU_LOG_INFO, "Extracting %s", filename);
         }
+    }
+
+    /* get extraction algorithm */
+    mfu_flist_archive_extract_algo algo = select_extract_algo();
+
+    /* configure flags for libarchive based on archive options */
+    int flags = 0;
+    if (opts->preserve_times) {
+        flags |= ARCHIVE_EXTRACT_TIME;
+    }
+    if (opts->preserve_owner) {
+        flags |= ARCHIVE_EXTRACT_OWNER;
+    }
+    if (opts->preserve_permissions) {
+        flags |= ARCHIVE_EXTRACT_PERM;
+    }
+    if (opts->preserve_xattrs) {
+        flags |= ARCHIVE_EXTRACT_XATTR;
+    }
+    if (opts->preserve_acls) {
+        flags |= ARCHIVE_EXTRACT_ACL;
+    }
+    if (opts->preserve_fflags) {
+        flags |= ARCHIVE_EXTRACT_FFLAGS;
+    }
+
+    /* turn on no overwrite so that directories we create are deleted and then replaced */
+    //archive_opts.flags |= ARCHIVE_EXTRACT_NO_OVERWRITE;
+
+    /* configure behavior when creating items (overwrite, lustre striping, etc) */
+    mfu_create_opts_t* create_opts = extract_create_opts_new(opts);
+
+    /* get number of entries in archive */
+    bool have_offsets = false; /* whether we found offsets for the entries */
+    bool have_index   = false; /* whether we have an index file */
+    uint64_t entries  = 0;     /* number of entries */
+    uint64_t* offsets = NULL;  /* byte offset within archive for each entry */
+    if (algo != LIBARCHIVE) {
+        /* optimistically assume we'll get offsets from and index file */
+        have_offsets = true;
+        have_index   = true;
+
+        /* attempt to read offsets from our index if we can find it */
+        int ret = read_entry_index(filename, &entries, &offsets);
+        if (ret != MFU_SUCCESS) {
+            /* don't have an index file */
+            have_index = false;
 
-        /* read the entry header for this item */
-        struct archive_entry* entry;
-        r = archive_read_next_header(a, &entry);
-        if (r == ARCHIVE_EOF) {
-            MFU_LOG(MFU_LOG_ERR, "unexpected end of archive, read %llu of %llu items",
-                count, entry_count
-            );
-            archive_read_close(a);
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
+            /* Next best option is to scan the archive
+             * and see if we can extract entry offsets. */
+            mfu_flist_archive_scan_algo scan_algo = select_scan_algo();
+            if (scan_algo == SCAN_LINEAR || scan_algo == SCAN_PARALLEL) {
+                /* Read the full archive and execute the scan in memory. */
+                ret = index_entries_distread(filename, opts, scan_algo, &entries, &offsets);
+            } else {
+                /* Fall back to scan archive with a single process */
+                ret = index_entries(filename, &entries, &offsets);
+            }
+            if (ret != MFU_SUCCESS) {
+                /* failed to get entry offsets,
+                 * perhaps we have a compressed archive? */
+                have_offsets = false;
+            }
         }
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "extracting entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(a)
-            );
-            archive_read_close(a);
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
+    }
+
+    /* bail out if user requested an algorithm that requires offsets
+     * but we don't have them */
+    if ((algo == LIBARCHIVE_IDX ||
+         algo == CHUNK          ||
+         algo == LIBCIRCLE        ) &&
+         !have_offsets)
+    {
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Selected archive extraction algorithm requires an index");
         }
+        mfu_create_opts_delete(&create_opts);
+        return MFU_FAILURE;
+    }
 
-        /* got an entry, create corresponding item on disk and
-         * then copy data */
-        r = archive_write_header(ext, entry);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "writing entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(ext)
-            );
-            archive_read_close(a);
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
-        } else {
-            /* extract file data (if item is a file) */
-            int tmp_rc = copy_data(a, ext);
-            if (tmp_rc != MFU_SUCCESS) {
-                archive_read_close(a);
-                archive_read_free(a);
-                rc = tmp_rc;
-                break;
+    /* to preserve ACLs and XATTRs, we need to extract with libarchive for now */
+    bool extract_with_libarchive = (opts->preserve_acls || opts->preserve_fflags);
+    if (extract_with_libarchive) {
+        /* if user requested a specific algorithm that is not compatibile,
+         * print and error and return with an error */
+        if (algo == CHUNK || algo == LIBCIRCLE) {
+            if (mfu_rank == 0) {
+                MFU_LOG(MFU_LOG_ERR, "To extract ACLs, one must extract with libarchive: LIBARCHIVE or LIBARCHIVE_IDX");
             }
+            mfu_create_opts_delete(&create_opts);
+            return MFU_FAILURE;
         }
 
-        /* set any properties on the item that need to be set at end,
-         * e.g., turn off write bit on a file we just wrote or set timestamps */
-        r = archive_write_finish_entry(ext);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "finish writing entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(ext)
-            );
-            rc = MFU_FAILURE;
-            break;
+        /* force to an algorithm that extracts items with libarchive */
+        if (have_offsets) {
+            algo = LIBARCHIVE_IDX;
+        } else {
+            algo = LIBARCHIVE;
         }
+    }
 
-        /* increment our count of items extracted */
-        reduce_buf[REDUCE_ITEMS]++;
+    /* divide entries among ranks */
+    uint64_t entry_start, entry_count;
+    mfu_get_start_count(mfu_rank, ranks, entries, &entry_start, &entry_count);
 
-        /* update number of items we have completed for progress messages */
-        mfu_progress_update(reduce_buf, extract_prog);
+    /* if we constructed an offset list by scanning the archive,
+     * save it to an index in case we need to extract again
+     * since scanning can be expensive, but don't write one when
+     * only listing */
+    if (have_offsets && !have_index && !opts->list) {
+        /* TODO: when encoding index as the last entry, we need to know the archive size,
+         * and we'll need to rewrite the two trailing 512-byte blocks */
+        //write_entry_index(filename, entry_count, &offsets[entry_start], opts, &archive_size);
+        write_entry_index(filename, entry_count, &offsets[entry_start], opts, NULL);
+    }
 
-        /* close out the read archive object */
-        r = archive_read_close(a);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to close read archive %s",
-                archive_error_string(a)
-            );
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
+    /* extract metadata for items in archive and construct flist,
+     * also get offsets to start of data region for each entry */
+    int ret;
+    uint64_t* data_offsets = NULL;
+    mfu_flist flist = mfu_flist_new();
+    if (have_offsets) {
+        /* with offsets, we can directly seek to each entry to read its header */
+        ret = extract_flist_offsets(filename, cwdpath, entries, entry_start, entry_count, offsets, &data_offsets, flist);
+    } else {
+        /* don't have entry offsets, so scan archive from the start to build flist,
+         * assume we can't get data offsets in this case either */
+        ret = extract_flist(filename, cwdpath, flist);
+    }
+    if (ret != MFU_SUCCESS) {
+        /* fatal error if we failed to build the flist */
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to extract metadata");
         }
+        mfu_create_opts_delete(&create_opts);
+        mfu_flist_free(&flist);
+        mfu_free(&data_offsets);
+        mfu_free(&offsets);
+        return MFU_FAILURE;
+    }
 
-        /* free memory allocated in read archive object */
-        r = archive_read_free(a);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to free read archive %s",
-                archive_error_string(a)
-            );
-            rc = MFU_FAILURE;
-            break;
+    /* drop entries the user did not ask for */
+    if (opts->member_count > 0) {
+        if (have_offsets) {
+            select_entries(cwdpath, opts, &entries, &entry_start, &entry_count,
+                &offsets, &data_offsets, &flist);
+        } else {
+            select_flist(cwdpath, opts, &flist);
         }
-
-        /* advance to our next entry */
-        count++;
     }
 
-    /* close out our write archive, this may update timestamps and permissions on items */
-    r = archive_write_close(ext);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to close archive for writing to disk %s",
-            archive_error_string(ext)
-        );
-        rc = MFU_FAILURE;
+    /* to list entries, we just need their headers */
+    if (opts->list) {
+        print_entries(flist, cwdpath);
+        mfu_create_opts_delete(&create_opts);
+        mfu_flist_free(&flist);
+        mfu_free(&data_offsets);
+        mfu_free(&offsets);
+        return MFU_SUCCESS;
     }
 
-    /* free off our write archive, this may update timestamps and permissions on items */
-    r = archive_write_free(ext);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to free archive for writing to disk %s",
-            archive_error_string(ext)
-        );
-        rc = MFU_FAILURE;
-    }
+    /* sum up bytes and items in list for tracking progress */
+    DTAR_total_bytes = flist_sum_bytes(flist);
+    DTAR_total_items = mfu_flist_global_size(flist);
 
-    /* finalize progress messages */
-    mfu_progress_complete(reduce_buf, &extract_prog);
+    /* print summary of what's in archive before extracting items */
+    mfu_flist_print_summary(flist);
 
-    /* Ensure all ranks have created all items before we close the write archive.
-     * libarchive can update timestamps on directories when closing out,
-     * so we want to ensure all child items exist first. */
-    MPI_Barrier(MPI_COMM_WORLD);
+    /* Create all directories in advance to avoid races between a process trying to create
+     * a child item and another process responsible for the parent directory.
+     * The libarchive code does not remove existing directories,
+     * even in normal mode with overwrite. */
+    if (opts->member_count > 0) {
+        create_parent_dirs(flist, cwdpath);
+    }
+    mfu_flist_mkdir(flist, create_opts);
 
-    /* if a directory already exists, libarchive does not currently update
-     * its timestamps when closing the write archive */
-    MPI_Barrier(MPI_COMM_WORLD);
+    /* extract files from archive */
+    if (have_offsets) {
+        /* if we have offsets, we can jump to the start of each entry
+         * rather than having to scan from the start of the archive */
+        if (algo == LIBARCHIVE_IDX) {
+            /* in this case we use libarchve to read entries from the archive
+             * and write them to disk, though we can use offsets to seek to
+             * the start of each entry */
+            ret = extract_files_offsets_libarchive(filename, flags,
+                entries, entry_start, entry_count, offsets, flist, opts);
+        } else {
+            /* in this case, we'll use an mfu chunk list to distribute work
+             * to processes and read/write from the archive directly */
 
-    /* figure out whether anyone failed */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        rc = MFU_FAILURE;
-    }
+            /* since more than one process may write to the same file,
+             * create the files in advance */
+            mfu_flist_mknod(flist, create_opts);
 
-    return rc;
-}
+            /* create symlinks */
+            int tmp_rc = extract_symlinks(filename, flist, offsets, opts);
+            if (tmp_rc != MFU_SUCCESS) {
+                /* tried but failed to get some symlink, so mark as failure */
+                ret = tmp_rc;
+            }
 
-/* Extract items from a given archive file, given the offset of each entry in the archive.
- * This assumes all items have been created, and it uses mfu chunk lists to directly read
- * data from the archive. */
-static int extract_files_offsets_chunk_libcircle(
-    const char* filename,     /* name of archive file */
-    int flags,                /* flags - not used in this context */
-    uint64_t entries,         /* number of entries in archive */
-    uint64_t entry_start,     /* global offset for entry this process should start with */
-    uint64_t entry_count,     /* number of consecutive items this process is responsible for */
-    uint64_t* data_offsets,   /* offset to start of data for each entry */
-    mfu_flist flist,          /* file list whose local elements correspond to items to extract */
-    mfu_archive_opts_t* opts) /* options to configure extract operation */
-{
-    /* assume we'll succeed */
-    int rc = MFU_SUCCESS;
+            /* copy xattrs if needed, we do this before writing file data
+             * since some file systems encode data layout properties in xattrs
+             * and those must be defined before writing any data */
+            if (opts->preserve_xattrs) {
+                /* read xattrs from archive and apply to files */
+                tmp_rc = extract_xattrs(filename, cwdpath, flags,
+                    entries, entry_start, entry_count, offsets, flist, opts);
+                if (tmp_rc != MFU_SUCCESS) {
+                    /* failed to copy xattrs, so mark as failure */
+                    ret = tmp_rc;
+                }
+            }
+
+            /* extract file data from archive */
+            if (algo == CHUNK) {
+                ret = extract_files_offsets_chunk(filename, flags,
+                    entries, entry_start, entry_count, data_offsets, flist, opts);
+            } else { /* LIBCIRCLE or DEFAULT */
+                ret = extract_files_offsets_chunk_libcircle(filename, flags,
+                    entries, entry_start, entry_count, data_offsets, flist, opts);
+            }
 
-    /* indicate to user what phase we're in */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Extracting file data");
+            /* set timestamps and permissions on everything */
+            MPI_Barrier(MPI_COMM_WORLD);
+            if (mfu_rank == 0) {
+                MFU_LOG(MFU_LOG_INFO, "Updating timestamps and permissions");
+            }
+            mfu_flist_metadata_apply(flist, create_opts);
+        }
+    } else {
+        /* If we don't have offsets, have each process read the archive from the start.
+         * We use libarchive to read/write entries, which allows us to deal with compressed
+         * archives and those with things like global headers. */ 
+        ret = extract_files(filename, flags,
+            entries, entry_start, entry_count, flist, opts);
     }
-
-    /* open the archive file for reading */
-    int fd = mfu_open(filename, O_RDONLY);
-    if (fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
-            filename, errno, strerror(errno)
-        );
+    if (ret != MFU_SUCCESS) {
+        /* set return code if we failed to extract items */
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to extract all items");
+        }
         rc = MFU_FAILURE;
     }
 
-    /* check that everyone opened the archive successfully */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        /* someone failed, close the file if we opened it and return */
-        if (fd >= 0) {
-            mfu_close(filename, fd);
+    /* If we extracted items with libarchive, we need to update timestamps on
+     * any directories.  This is because we created all directories in advance
+     * and libarchive does not set timestamps on directories if they already exist. */
+    int extracted_with_libarchive = (!have_offsets || algo == LIBARCHIVE_IDX);
+    if (extracted_with_libarchive) {
+        /* first ensure all procs are done writing their items */
+        MPI_Barrier(MPI_COMM_WORLD);
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Updating timestamps and permissions");
         }
-        return MFU_FAILURE;
-    }
 
-    /* get number of ranks in our communicator */
-    int ranks;
-    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+        /* create a file list of just the directories */
+        mfu_flist flist_dirs = flist_get_dirs(flist);
 
-    /* Get list of item offsets across ranks.
-     * This will be used to compute the global index of an item
-     * given an owner rank and local index of that item on its owner rank. */
-    int* rank_disps = (int*) MFU_MALLOC(ranks * sizeof(int));
-    int item_offset = (int) mfu_flist_global_offset(flist);
-    MPI_Allgather(&item_offset, 1, MPI_INT, rank_disps, 1, MPI_INT, MPI_COMM_WORLD);
+        /* set timestamps on the directories, do this after writing all items
+         * since creating items in a directory will have changed its timestamp */
+        mfu_flist_metadata_apply(flist_dirs, create_opts);
 
-    /* split the regular files listed in flist into chunks and distribute
-     * those chunks evenly across processes as a linked list */
-    mfu_file_chunk* data_chunks = mfu_file_chunk_list_alloc(flist, opts->chunk_size);
+        /* free the list of directories */
+        mfu_flist_free(&flist_dirs);
+    }
 
-    /* initialize counters to track number of bytes and items extracted */
-    reduce_buf[REDUCE_BYTES] = 0;
-    reduce_buf[REDUCE_ITEMS] = mfu_flist_size(flist);
+    /* free options structure needed for create calls */
+    mfu_create_opts_delete(&create_opts);
 
-    /* record name and file descriptor of the open archive file */
-    DTAR_writer.name = filename;
-    DTAR_writer.fd   = fd;
+    /* we can now free our file list */
+    mfu_flist_free(&flist);
 
-    /* allocate buffer to read/write data */
-    DTAR_writer.io_bufsize = opts->buf_size;
-    DTAR_writer.io_buf = MFU_MALLOC(DTAR_writer.io_bufsize);
+    /* free offset arrays */
+    mfu_free(&data_offsets);
+    mfu_free(&offsets);
 
-    /* we flip this to 1 if any process hits any error writing the archive */
-    DTAR_err = 0;
+    /* print timing and summary of what we extracted */
+    print_extract_stats(time_started, wtime_started);
 
-    /* save list to global for encode */
-    DTAR_opts         = opts;
-    DTAR_data_offsets = data_offsets;
-    DTAR_rank_disps   = rank_disps;
-    DTAR_data_chunks  = data_chunks;
+    return rc;
+}
 
-    /* prepare libcircle */
-    CIRCLE_init(0, NULL, CIRCLE_SPLIT_EQUAL | CIRCLE_CREATE_GLOBAL | CIRCLE_TERM_TREE);
-    CIRCLE_loglevel loglevel = CIRCLE_LOG_WARN;
-    CIRCLE_enable_logging(loglevel);
+/* reads bytes of the uncompressed stream of a compressed archive,
+ * holding the last frame it decompressed in memory */
+typedef struct {
+    const char* filename;         /* name of compressed archive */
+    int fd;                       /* open file descriptor of archive */
+    const DTAR_frames_t* frames;  /* frame index of archive */
+    char* buf;                    /* decompressed frame */
+    char* comp_buf;               /* compressed frame */
+    uint64_t frame;               /* id of frame in buf, UINT64_MAX if none */
+    uint64_t len;                 /* number of bytes in buf */
+} DTAR_frame_reader_t;
+
+/* copy len bytes at offset pos of the uncompressed stream into out,
+ * decompressing frames as needed, returns MFU_SUCCESS on success */
+static int DTAR_frame_reader_read(
+    DTAR_frame_reader_t* reader,
+    uint64_t pos,
+    char* out,
+    size_t len)
+{
+    const DTAR_frames_t* frames = reader->frames;
+    while (len > 0) {
+        uint64_t f = pos / frames->frame_size;
+        if (f >= frames->count) {
+            MFU_LOG(MFU_LOG_ERR, "Offset %llu is past the end of archive '%s'",
+                (unsigned long long) pos, reader->filename);
+            return MFU_FAILURE;
+        }
 
-    /* register callbacks */
-    CIRCLE_cb_create(&DTAR_enqueue_extract);
-    CIRCLE_cb_process(&DTAR_perform_extract);
+        if (f != reader->frame) {
+            int64_t nread = DTAR_frame_read(reader->filename, reader->fd, frames, f,
+                reader->buf, reader->comp_buf);
+            if (nread < 0) {
+                reader->frame = UINT64_MAX;
+                return MFU_FAILURE;
+            }
+            reader->frame = f;
+            reader->len   = (uint64_t) nread;
+        }
 
-    /* prepare callbacks and initialize variables for reductions */
-    reduce_start = MPI_Wtime();
-    reduce_bytes = 0;
-    reduce_opstr = "Extracted";
-    CIRCLE_cb_reduce_init(&reduce_init);
-    CIRCLE_cb_reduce_op(&reduce_exec);
-    CIRCLE_cb_reduce_fini(&reduce_fini);
+        uint64_t start = pos - f * frames->frame_size;
+        if (start >= reader->len) {
+            MFU_LOG(MFU_LOG_ERR, "Offset %llu is past the end of archive '%s'",
+                (unsigned long long) pos, reader->filename);
+            return MFU_FAILURE;
+        }
+        size_t n = (size_t) (reader->len - start);
+        if (n > len) {
+            n = len;
+        }
+        memcpy(out, reader->buf + start, n);
+        out += n;
+        pos += n;
+        len -= n;
+    }
+    return MFU_SUCCESS;
+}
 
-    /* set libcircle reduction period */
-    int reduce_secs = 0;
-    if (mfu_progress_timeout > 0) {
-        reduce_secs = mfu_progress_timeout;
+/* prepare reader to read the uncompressed stream of
+ * the compressed archive filename, which is open as fd */
+static void DTAR_frame_reader_init(
+    DTAR_frame_reader_t* reader,
+    const char* filename,
+    int fd,
+    const DTAR_frames_t* frames)
+{
+    /* find the largest compressed frame */
+    uint64_t i;
+    uint64_t max_length = 0;
+    for (i = 0; i < frames->count; i++) {
+        if (frames->lengths[i] > max_length) {
+            max_length = frames->lengths[i];
+        }
     }
-    CIRCLE_set_reduce_period(reduce_secs);
 
-    /* run the libcircle job to copy data into archive file */
-    CIRCLE_begin();
-    CIRCLE_finalize();
+    reader->filename = filename;
+    reader->fd       = fd;
+    reader->frames   = frames;
+    reader->buf      = (char*) MFU_MALLOC((size_t) frames->frame_size);
+    reader->comp_buf = (char*) MFU_MALLOC((size_t) max_length + 1);
+    reader->frame    = UINT64_MAX;
+    reader->len      = 0;
+}
 
-    /* done writing, close any source file that is still open */
-    mfu_archive_close_file(&mfu_archive_dst_cache);
+static void DTAR_frame_reader_free(DTAR_frame_reader_t* reader)
+{
+    mfu_free(&reader->comp_buf);
+    mfu_free(&reader->buf);
+}
 
-    /* free chunk list */
-    mfu_file_chunk_list_free(&data_chunks);
+/* read the header of the entry at offset in the uncompressed stream
+ * into hdr, which is grown as needed, extended headers and long names
+ * precede the header of the entry itself, so gather them along with it,
+ * sets hdr_len to the number of bytes in the header */
+static int DTAR_frame_reader_header(
+    DTAR_frame_reader_t* reader,
+    uint64_t offset,
+    char** hdr,
+    size_t* hdr_max,
+    size_t* hdr_len)
+{
+    int rc = MFU_SUCCESS;
 
-    /* set number of bytes we reduced */
-    reduce_buf[REDUCE_BYTES] = reduce_bytes;
+    uint64_t size_stream = reader->frames->size;
+    uint64_t pos = offset;
+    size_t len = 0;
+    while (1) {
+        if (len + 512 > *hdr_max) {
+            *hdr_max *= 2;
+            *hdr = (char*) realloc(*hdr, *hdr_max);
+        }
+        rc = DTAR_frame_reader_read(reader, pos, *hdr + len, 512);
+        if (rc != MFU_SUCCESS) {
+            break;
+        }
 
-    /* free off memory */
-    mfu_free(&rank_disps);
-    mfu_free(&DTAR_writer.io_buf);
+        char type = (*hdr)[len + 156];
+        uint64_t size = DTAR_header_number((unsigned char*) *hdr + len + 124, 12);
+        len += 512;
+        pos += 512;
+        if (type != 'x' && type != 'g' && type != 'L' && type != 'K') {
+            break;
+        }
 
-    /* figure out whether anyone failed */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        rc = MFU_FAILURE;
+        uint64_t padded = get_filesize_padded(size);
+        if (pos > size_stream || padded > size_stream - pos) {
+            MFU_LOG(MFU_LOG_ERR, "Invalid header at offset %llu in '%s'",
+                (unsigned long long) offset, reader->filename);
+            rc = MFU_FAILURE;
+            break;
+        }
+        while (len + (size_t) padded + 512 > *hdr_max) {
+            *hdr_max *= 2;
+        }
+        *hdr = (char*) realloc(*hdr, *hdr_max);
+        rc = DTAR_frame_reader_read(reader, pos, *hdr + len, (size_t) padded);
+        if (rc != MFU_SUCCESS) {
+            break;
+        }
+        len += (size_t) padded;
+        pos += padded;
     }
 
+    *hdr_len = len;
     return rc;
 }
 
-/* Extract items from a given archive file, given the offset of each entry in the archive.
- * This assumes all items have been created, and it uses mfu chunk lists to directly read
- * data from the archive. */
-static int extract_files_offsets_chunk(
-    const char* filename,     /* name of archive file */
-    int flags,                /* flags - not used in this context */
-    uint64_t entries,         /* number of entries in archive */
-    uint64_t entry_start,     /* global offset for entry this process should start with */
-    uint64_t entry_count,     /* number of consecutive items this process is responsible for */
-    uint64_t* data_offsets,   /* offset to start of data for each entry */
-    mfu_flist flist,          /* file list whose local elements correspond to items to extract */
-    mfu_archive_opts_t* opts) /* options to configure extract operation */
-{
-    /* assume we'll succeed */
-    int rc = MFU_SUCCESS;
+/****************************************
+ * Multi-member compressed archives
+ ***************************************/
 
-    /* indicate to user what phase we're in */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Extracting file data");
-    }
+/* Archives written by tools like bgzip or pbzip2, or by concatenating
+ * separately compressed files, are a sequence of complete gzip or bzip2
+ * streams (members), each of which can be decoded on its own.  Note that
+ * pigz writes a single gzip stream even with --independent.  Without an
+ * index, we find the members by searching the archive in parallel for
+ * the magic bytes that start a member.  Those bytes may also occur by
+ * chance inside of compressed data, so each candidate is verified by
+ * decoding it up to the next candidate, and only a chain of members that
+ * starts at the beginning of the archive and ends at its end is
+ * accepted.  A candidate that has not ended by the next candidate is
+ * rejected, so verification decodes each byte at most once, and an
+ * archive with a single candidate is not decoded at all.  A chance
+ * match inside of a member breaks the chain, in which case we fall back
+ * to serial extraction.  Each rank then decodes its members in memory
+ * to find header blocks, and all ranks follow the chain of headers from
+ * the start of the stream to find the entries, the data of each file is
+ * written straight from the members that hold it.  Finding the size of
+ * each member requires decoding it, so members are decoded more than
+ * once, but every pass runs in parallel across members. */
+
+/* number of bytes we check at the start of a member */
+#define DTAR_MEMBER_MAGIC (10)
+
+/* compression formats we can split into members */
+#define DTAR_MEMBER_GZIP  (1)
+#define DTAR_MEMBER_BZIP2 (2)
+
+/* list of members of a compressed archive */
+typedef struct {
+    int type;           /* compression format of members */
+    uint64_t count;     /* number of members */
+    uint64_t size;      /* size of uncompressed stream in bytes */
+    uint64_t* offsets;  /* offset of each member in archive */
+    uint64_t* lengths;  /* length of each member in archive */
+    uint64_t* uoffsets; /* offset of each member in uncompressed stream */
+} DTAR_members_t;
+
+/* free memory allocated in member list */
+static void DTAR_members_free(DTAR_members_t* members)
+{
+    mfu_free(&members->offsets);
+    mfu_free(&members->lengths);
+    mfu_free(&members->uoffsets);
+}
 
-    /* open the archive file for reading */
-    int fd = mfu_open(filename, O_RDONLY);
-    if (fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
-            filename, errno, strerror(errno)
-        );
-        rc = MFU_FAILURE;
+/* given DTAR_MEMBER_MAGIC bytes, return the compression format
+ * of the member they start, or 0 if they do not start a member */
+static int DTAR_member_magic(const unsigned char* p)
+{
+    /* gzip header: ID1 ID2 CM=deflate FLG MTIME(4) XFL OS,
+     * with the reserved flag bits clear */
+    if (p[0] == 0x1f && p[1] == 0x8b && p[2] == 0x08 && (p[3] & 0xe0) == 0 &&
+        (p[8] == 0 || p[8] == 2 || p[8] == 4))
+    {
+        return DTAR_MEMBER_GZIP;
     }
 
-    /* check that everyone opened the archive successfully */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        /* someone failed, close the file if we opened it and return */
-        if (fd >= 0) {
-            mfu_close(filename, fd);
-        }
-        return MFU_FAILURE;
+    /* bzip2 header: "BZh" and block size, followed by the
+     * magic number that starts the first block */
+    if (p[0] == 'B' && p[1] == 'Z' && p[2] == 'h' && p[3] >= '1' && p[3] <= '9' &&
+        p[4] == 0x31 && p[5] == 0x41 && p[6] == 0x59 &&
+        p[7] == 0x26 && p[8] == 0x53 && p[9] == 0x59)
+    {
+        return DTAR_MEMBER_BZIP2;
     }
 
-    /* get number of ranks in our communicator */
-    int ranks;
-    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
-
-    /* Get list of item offsets across ranks.
-     * This will be used to compute the global index of an item
-     * given an owner rank and local index of that item on its owner rank. */
-    int* rank_disps = (int*) MFU_MALLOC(ranks * sizeof(int));
-    int item_offset = (int) mfu_flist_global_offset(flist);
-    MPI_Allgather(&item_offset, 1, MPI_INT, rank_disps, 1, MPI_INT, MPI_COMM_WORLD);
-
-    /* allocate I/O buffer to read/write data */
-    size_t bufsize = opts->buf_size;
-    void* buf = MFU_MALLOC(bufsize);
-
-    /* split the regular files listed in flist into chunks and distribute
-     * those chunks evenly across processes as a linked list */
-    mfu_file_chunk* data_chunks = mfu_file_chunk_list_alloc(flist, opts->chunk_size);
+    return 0;
+}
 
-    /* initialize counters to track number of bytes and items extracted */
-    reduce_buf[REDUCE_BYTES] = 0;
-    reduce_buf[REDUCE_ITEMS] = mfu_flist_size(flist);
+/* state to decode a single member */
+typedef struct {
+    int type;
+    bz_stream bz;
+#ifdef HAVE_ZLIB
+    z_stream z;
+#endif
+} DTAR_decoder_t;
 
-    /* start progress messages while setting metadata,
-     * in this case, we can track bytes accurately but not items */
-    extract_prog = mfu_progress_start(mfu_progress_timeout, 1, MPI_COMM_WORLD, extract1_progress_fn);
-    
-    /* iterate over items and copy data for each one */
-    mfu_file_chunk* p = data_chunks;
-    while (p != NULL && rc == MFU_SUCCESS) {
-        /* compute global index of item */
-        int owner_rank = p->rank_of_owner;
-        uint64_t global_idx = rank_disps[owner_rank] + p->index_of_owner;
-        uint64_t data_offset = data_offsets[global_idx];
+static int DTAR_decoder_init(DTAR_decoder_t* d, int type)
+{
+    memset(d, 0, sizeof(*d));
+    d->type = type;
+    if (type == DTAR_MEMBER_BZIP2) {
+        if (BZ2_bzDecompressInit(&d->bz, 0, 0) != BZ_OK) {
+            return MFU_FAILURE;
+        }
+        return MFU_SUCCESS;
+    }
+#ifdef HAVE_ZLIB
+    if (type == DTAR_MEMBER_GZIP) {
+        /* add 16 to window bits to decode a gzip header and trailer */
+        if (inflateInit2(&d->z, 15 + 16) != Z_OK) {
+            return MFU_FAILURE;
+        }
+        return MFU_SUCCESS;
+    }
+#endif
+    return MFU_FAILURE;
+}
 
-        /* open the destination file for writing */
-        const char* out_name = p->name;
-        int out_fd = mfu_open(out_name, O_WRONLY);
-        if (out_fd < 0) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to open destination file '%s' errno=%d %s",
-                out_name, errno, strerror(errno));
-            rc = MFU_FAILURE;
-            break;
+static void DTAR_decoder_end(DTAR_decoder_t* d)
+{
+    if (d->type == DTAR_MEMBER_BZIP2) {
+        BZ2_bzDecompressEnd(&d->bz);
+    }
+#ifdef HAVE_ZLIB
+    if (d->type == DTAR_MEMBER_GZIP) {
+        inflateEnd(&d->z);
+    }
+#endif
+}
+
+/* decode from in into out, sets the number of bytes consumed and
+ * produced, returns 1 at the end of the member, 0 if more input
+ * is needed, and -1 on error */
+static int DTAR_decoder_step(
+    DTAR_decoder_t* d,
+    char* in,
+    size_t in_len,
+    size_t* in_used,
+    char* out,
+    size_t out_len,
+    size_t* out_used)
+{
+    int ret = -1;
+    *in_used  = 0;
+    *out_used = 0;
+
+    if (d->type == DTAR_MEMBER_BZIP2) {
+        d->bz.next_in   = in;
+        d->bz.avail_in  = (unsigned int) in_len;
+        d->bz.next_out  = out;
+        d->bz.avail_out = (unsigned int) out_len;
+        int bzrc = BZ2_bzDecompress(&d->bz);
+        *in_used  = in_len - d->bz.avail_in;
+        *out_used = out_len - d->bz.avail_out;
+        if (bzrc == BZ_STREAM_END) {
+            ret = 1;
+        } else if (bzrc == BZ_OK) {
+            ret = 0;
+        }
+    }
+#ifdef HAVE_ZLIB
+    if (d->type == DTAR_MEMBER_GZIP) {
+        d->z.next_in   = (Bytef*) in;
+        d->z.avail_in  = (uInt) in_len;
+        d->z.next_out  = (Bytef*) out;
+        d->z.avail_out = (uInt) out_len;
+        int zrc = inflate(&d->z, Z_NO_FLUSH);
+        *in_used  = in_len - d->z.avail_in;
+        *out_used = out_len - d->z.avail_out;
+        if (zrc == Z_STREAM_END) {
+            ret = 1;
+        } else if (zrc == Z_OK || zrc == Z_BUF_ERROR) {
+            ret = 0;
         }
+    }
+#endif
 
-        /* copy data from archive file to destination file */
-        uint64_t bytes_copied = 0;
-        uint64_t length = p->length;
-        while (bytes_copied < length) {
-            /* compute number of bytes to read in this step */
-            size_t bytes_to_read = bufsize;
-            uint64_t remainder = length - bytes_copied;
-            if (remainder < (uint64_t) bytes_to_read) {
-                bytes_to_read = (size_t) remainder;
-            }
+    return ret;
+}
 
-            /* read data from archive file */
-            off_t pos_read = (off_t)data_offset + (off_t)p->offset + (off_t)bytes_copied;
-            ssize_t nread = mfu_pread(filename, fd, buf, bytes_to_read, pos_read);
-            if (nread < 0) {
-                MFU_LOG(MFU_LOG_ERR, "Failed to read archive file '%s' errno=%d %s",
-                    filename, errno, strerror(errno));
-                rc = MFU_FAILURE;
+/* function to consume bytes decoded from a member, called with the
+ * offset of buf in the uncompressed stream, returns 0 to keep decoding,
+ * 1 to stop decoding early, or -1 on error */
+typedef int (*DTAR_member_fn)(uint64_t pos, const char* buf, size_t len, void* arg);
+
+/* decode the member that starts at offset in the archive and at
+ * uoffset in the uncompressed stream, and pass its output to fn
+ * if fn is not NULL, returns MFU_SUCCESS if the member ends cleanly
+ * or if fn stops decoding, and sets its length in the archive and
+ * its uncompressed size as far as we decoded it, when verifying
+ * a candidate, pass quiet to skip printing errors */
+static int DTAR_member_decode(
+    const char* filename,  /* name of archive file */
+    int fd,                /* open file descriptor of archive */
+    uint64_t file_size,    /* offset in archive at which the member must end */
+    int type,              /* compression format of member */
+    uint64_t offset,       /* offset of member in archive */
+    uint64_t uoffset,      /* offset of member in uncompressed stream */
+    DTAR_member_fn fn,     /* function to consume decoded data, or NULL */
+    void* arg,             /* argument to pass to fn */
+    char* in_buf,          /* buffer to read compressed data */
+    char* out_buf,         /* buffer to decode data into */
+    size_t bufsize,        /* size of each buffer in bytes */
+    bool quiet,            /* whether to skip printing decode errors */
+    uint64_t* out_length,  /* length of member in archive */
+    uint64_t* out_usize)   /* size of decoded member */
+{
+    int rc = MFU_SUCCESS;
+
+    DTAR_decoder_t d;
+    if (DTAR_decoder_init(&d, type) != MFU_SUCCESS) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to initialize decoder for archive '%s'", filename);
+        return MFU_FAILURE;
+    }
+
+    uint64_t pos     = offset; /* offset of next byte to read from archive */
+    uint64_t length  = 0;      /* number of bytes consumed by decoder */
+    uint64_t usize   = 0;      /* number of bytes produced by decoder */
+    char* in_ptr     = in_buf;
+    size_t in_avail  = 0;
+    int ret = 0;
+    while (ret == 0) {
+        /* read more compressed data if we need it */
+        if (in_avail == 0) {
+            if (pos >= file_size) {
+                /* member is truncated */
+                ret = -1;
                 break;
             }
-            if (nread == 0) {
-                MFU_LOG(MFU_LOG_ERR, "Unexpected end of archive file '%s'",
-                    filename);
-                DTAR_err = 1;
+            size_t count = bufsize;
+            if ((uint64_t) count > file_size - pos) {
+                count = (size_t)(file_size - pos);
+            }
+            ssize_t nread = mfu_pread(filename, fd, in_buf, count, (off_t) pos);
+            if (nread <= 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read archive '%s' at offset %llu errno=%d %s",
+                    filename, (unsigned long long) pos, errno, strerror(errno));
                 rc = MFU_FAILURE;
                 break;
             }
-
-            /* write data to the file */
-            off_t pos_write = (off_t)p->offset + (off_t)bytes_copied;
-            ssize_t nwritten = mfu_pwrite(out_name, out_fd, buf, nread, pos_write);
-            if (nwritten < 0) {
-                MFU_LOG(MFU_LOG_ERR, "Failed to write to destination file '%s' errno=%d %s",
-                    out_name, errno, strerror(errno));
-                DTAR_err = 1;
+            in_ptr   = in_buf;
+            in_avail = (size_t) nread;
+            pos     += (uint64_t) nread;
+        }
+
+        size_t in_used, out_used;
+        ret = DTAR_decoder_step(&d, in_ptr, in_avail, &in_used, out_buf, bufsize, &out_used);
+        in_ptr   += in_used;
+        in_avail -= in_used;
+        length   += in_used;
+
+        /* pass the decoded data on */
+        bool stop = false;
+        if (fn != NULL && out_used > 0) {
+            int fn_rc = fn(uoffset + usize, out_buf, out_used, arg);
+            if (fn_rc < 0) {
                 rc = MFU_FAILURE;
-                break;
+            } else if (fn_rc > 0) {
+                stop = true;
             }
-
-            /* update number of bytes written */
-            bytes_copied += nwritten;
-
-            /* update number of items we have completed for progress messages */
-            reduce_buf[REDUCE_BYTES] += nwritten;
-            mfu_progress_update(reduce_buf, extract_prog);
         }
-
-        /* close the user file being written */
-        int close_rc = mfu_close(out_name, out_fd);
-        if (close_rc == -1) {
-           /* worth reporting, don't consider this a fatal error */
-           MFU_LOG(MFU_LOG_ERR, "Failed to close destination file '%s' errno=%d %s",
-               out_name, errno, strerror(errno));
+        usize += out_used;
+        if (rc != MFU_SUCCESS || stop) {
+            break;
         }
 
-        /* advance to next file segment in our list */
-        p = p->next;
+        /* the decoder must make progress while it has input */
+        if (ret == 0 && in_avail > 0 && in_used == 0 && out_used == 0) {
+            ret = -1;
+        }
     }
 
-    /* finalize progress messages */
-    mfu_progress_complete(reduce_buf, &extract_prog);
-
-    /* free chunk list */
-    mfu_file_chunk_list_free(&data_chunks);
-
-    /* free off memory */
-    mfu_free(&rank_disps);
-    mfu_free(&buf);
+    DTAR_decoder_end(&d);
 
-    /* figure out whether anyone failed */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+    if (ret < 0 && rc == MFU_SUCCESS) {
+        if (! quiet) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to decode member at offset %llu of archive '%s'",
+                (unsigned long long) offset, filename);
+        }
         rc = MFU_FAILURE;
     }
 
+    *out_length = length;
+    *out_usize  = usize;
     return rc;
 }
 
-/* Extract items from the specified archive file the hard way.
- * Each process reads the archive from the beginning and extracts
- * items in a round-robin fashion based on its rank number.
- * This permits processing of compressed archives, and those that
- * use global headers. */
-static int extract_files(
-    const char* filename,    /* name of the archive file */
-    int flags,               /* flags to pass to archive_write_disk_set_options */
-    uint64_t entries,
-    uint64_t entry_start,
-    uint64_t entry_count,
-    mfu_flist flist,
-    mfu_archive_opts_t* opts)
+/* search the archive in parallel for the start of each member,
+ * verify candidates by decoding them, and return the chain of
+ * members that covers the archive, returns MFU_FAILURE without
+ * printing errors if the archive can not be split into members */
+static int DTAR_members_scan(
+    const char* filename,
+    mfu_archive_opts_t* opts,
+    DTAR_members_t* members)
 {
-    /* assume we'll succeed */
     int rc = MFU_SUCCESS;
 
-    /* indicate to user what phase we're in */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Extracting items");
-    }
-
-    /* initialize counters to track number of bytes extracted */
-    reduce_buf[REDUCE_BYTES] = 0;
-    reduce_buf[REDUCE_ITEMS] = 0;
-
-    /* start progress messages while setting metadata */
-    extract_prog = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, extract2_progress_fn);
-
-    /* initiate archive object for reading */
-    struct archive* a = archive_read_new();
-
-    /* in the general case, we want potential compression
-     * schemes in addition to tar format */
-    archive_read_support_filter_bzip2(a);
-    archive_read_support_filter_gzip(a);
-    archive_read_support_filter_compress(a);
-    archive_read_support_format_tar(a);
+    memset(members, 0, sizeof(*members));
 
-    /* initiate archive object for writing items out to disk */
-    struct archive* ext = archive_write_disk_new();
-    int r = archive_write_disk_set_options(ext, flags);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to set options on write object %s",
-            archive_error_string(ext)
-        );
-        rc = MFU_FAILURE;
-    }
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-    /* use system calls to lookup uname/gname (follows POSIX pax) */
-    r = archive_write_disk_set_standard_lookup(ext);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to set standard uname/gname lookup on write object %s",
-            archive_error_string(ext)
-        );
-        rc = MFU_FAILURE;
+    /* rank 0 checks whether the archive starts with a member
+     * in a format we can decode, and gets the archive size */
+    uint64_t values[2] = {0, 0};
+    if (rank == 0) {
+        int fd = mfu_open(filename, O_RDONLY);
+        if (fd >= 0) {
+            unsigned char magic[DTAR_MEMBER_MAGIC];
+            ssize_t nread = mfu_pread(filename, fd, magic, sizeof(magic), 0);
+            if (nread == (ssize_t) sizeof(magic)) {
+                values[0] = (uint64_t) DTAR_member_magic(magic);
+            }
+            off_t file_size = mfu_lseek(filename, fd, 0, SEEK_END);
+            if (file_size > 0) {
+                values[1] = (uint64_t) file_size;
+            }
+            mfu_close(filename, fd);
+        }
+#ifndef HAVE_ZLIB
+        /* without zlib, leave gzip archives to libarchive */
+        if (values[0] == DTAR_MEMBER_GZIP) {
+            values[0] = 0;
+        }
+#endif
     }
-
-    /* read from stdin? */
-    if (filename != NULL && strcmp(filename, "-") == 0) {
-        filename = NULL;
+    MPI_Bcast(values, 2, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    int type = (int) values[0];
+    uint64_t file_size = values[1];
+    if (type == 0) {
+        return MFU_FAILURE;
     }
 
-    /* Block size is a bit hard to choose here.  If there are lots of
-     * small headers/files, it's best to use a small block size to skip through
-     * the list of files quickly without reading excess data.  But if there
-     * are a few large files, it would be better to use a large block size
-     * to efficiently read data once we get to our file.  Strike a balance
-     * of 1MB. */
-    r = archive_read_open_filename(a, filename, 1024 * 1024);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "opening archive '%s' %s",
-            filename, archive_error_string(a)
-        );
+    int fd = mfu_open(filename, O_RDONLY);
+    if (fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive '%s' errno=%d %s",
+            filename, errno, strerror(errno));
         rc = MFU_FAILURE;
     }
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        if (fd >= 0) {
+            mfu_close(filename, fd);
+        }
+        return MFU_FAILURE;
+    }
 
-    /* get number of ranks in our communicator */
-    int ranks;
-    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
-
-    /* iterate over all entry from the start of the file,
-     * looking to find the range of items it is responsible for */
+    size_t bufsize = opts->buf_size;
+    char* in_buf  = (char*) MFU_MALLOC(bufsize + DTAR_MEMBER_MAGIC);
+    char* out_buf = (char*) MFU_MALLOC(bufsize);
+
+    /* search our part of the archive for candidates, reading a few
+     * bytes past our part to check candidates that start near its end */
+    uint64_t start = file_size * (uint64_t) rank / (uint64_t) ranks;
+    uint64_t end   = file_size * (uint64_t) (rank + 1) / (uint64_t) ranks;
+    uint64_t max = 1024;
     uint64_t count = 0;
-    while (rc == MFU_SUCCESS) {
-        /* read the next entry from the archive */
-        struct archive_entry* entry;
-        r = archive_read_next_header(a, &entry);
-        if (r == ARCHIVE_EOF) {
-            break;
+    uint64_t* candidates = (uint64_t*) MFU_MALLOC(max * sizeof(uint64_t));
+    uint64_t pos = start;
+    while (pos < end) {
+        uint64_t step = end - pos;
+        if (step > (uint64_t) bufsize) {
+            step = (uint64_t) bufsize;
+        }
+        uint64_t want = step + DTAR_MEMBER_MAGIC - 1;
+        if (want > file_size - pos) {
+            want = file_size - pos;
+        }
+
+        uint64_t got = 0;
+        while (got < want) {
+            ssize_t nread = mfu_pread(filename, fd, in_buf + got, (size_t)(want - got),
+                (off_t)(pos + got));
+            if (nread <= 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to read archive '%s' at offset %llu errno=%d %s",
+                    filename, (unsigned long long)(pos + got), errno, strerror(errno));
+                rc = MFU_FAILURE;
+                break;
+            }
+            got += (uint64_t) nread;
         }
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "extracting entry %llu %s",
-                count, archive_error_string(a)
-            );
-            rc = MFU_FAILURE;
+        if (rc != MFU_SUCCESS) {
             break;
         }
 
-        /* write item out to disk if this is one of our assigned items */
-        if (count % ranks == mfu_rank) {
-            /* create item on disk */
-            r = archive_write_header(ext, entry);
-            if (r != ARCHIVE_OK) {
-                MFU_LOG(MFU_LOG_ERR, "writing entry %llu %s",
-                    count, archive_error_string(ext)
-                );
-                rc = MFU_FAILURE;
-                break;
-            } else {
-                /* extract file data (if item is a file) */
-                int tmp_rc = copy_data(a, ext);
-                if (tmp_rc != MFU_SUCCESS) {
-                    rc = tmp_rc;
-                    break;
+        uint64_t j;
+        for (j = 0; j < step && j + DTAR_MEMBER_MAGIC <= got; j++) {
+            if (DTAR_member_magic((unsigned char*) in_buf + j) == type) {
+                if (count == max) {
+                    max *= 2;
+                    candidates = (uint64_t*) realloc(candidates, max * sizeof(uint64_t));
+                    if (candidates == NULL) {
+                        MFU_ABORT(-1, "Failed to allocate %llu bytes for archive members",
+                            (unsigned long long)(max * sizeof(uint64_t)));
+                    }
                 }
+                candidates[count] = pos + j;
+                count++;
             }
-
-            /* set any properties on the item that need to be set at end,
-             * e.g., turn off write bit on a file we just wrote or set timestamps */
-            r = archive_write_finish_entry(ext);
-            if (r != ARCHIVE_OK) {
-                MFU_LOG(MFU_LOG_ERR, "finish writing entry %llu %s",
-                    count, archive_error_string(ext)
-                );
-                rc = MFU_FAILURE;
-                break;
-            }
-
-            /* increment our count of items extracted */
-            reduce_buf[REDUCE_ITEMS]++;
-
-            /* update number of items we have completed for progress messages */
-            mfu_progress_update(reduce_buf, extract_prog);
         }
 
-        /* advance to next entry in the archive */
-        count++;
-    }
-
-    /* free off our write archive, this may update timestamps and permissions on items */
-    r = archive_write_close(ext);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to close archive for writing to disk %s",
-            archive_error_string(ext)
-        );
-        rc = MFU_FAILURE;
-    }
-
-    /* free off our write archive, this may update timestamps and permissions on items */
-    r = archive_write_free(ext);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to free archive for writing to disk %s",
-            archive_error_string(ext)
-        );
-        rc = MFU_FAILURE;
+        pos += step;
     }
 
-    /* finalize progress messages */
-    mfu_progress_complete(reduce_buf, &extract_prog);
-
-    /* Ensure all ranks have created all items before we close the write archive.
-     * libarchive will update timestamps on directories when closing out,
-     * so we want to ensure all child items exist at this point. */
-    MPI_Barrier(MPI_COMM_WORLD);
-
-    /* close out the read archive object */
-    r = archive_read_close(a);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to close read archive %s",
-            archive_error_string(a)
-        );
+    /* gather list of candidates, which is sorted since
+     * ranks search the archive in order */
+    uint64_t total;
+    uint64_t* offsets;
+    int* disps;
+    allgather_offsets(count, candidates, &total, &offsets, &disps);
+    mfu_free(&candidates);
+    mfu_free(&disps);
+
+    /* a single candidate is the one at the start of the archive,
+     * so the archive is a single stream, which we can't split */
+    if (total < 2) {
         rc = MFU_FAILURE;
     }
 
-    /* free memory allocated in read archive object */
-    r = archive_read_free(a);
-    if (r != ARCHIVE_OK) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to free read archive %s",
-            archive_error_string(a)
-        );
-        rc = MFU_FAILURE;
+    /* verify candidates round-robin, recording length and size
+     * of each member that decodes cleanly, a member must end at
+     * or before the next candidate, so stop decoding there */
+    uint64_t* lengths = (uint64_t*) MFU_MALLOC(total * sizeof(uint64_t) + 1);
+    uint64_t* usizes  = (uint64_t*) MFU_MALLOC(total * sizeof(uint64_t) + 1);
+    memset(lengths, 0, total * sizeof(uint64_t));
+    memset(usizes,  0, total * sizeof(uint64_t));
+    uint64_t i;
+    for (i = (uint64_t) rank; i < total && rc == MFU_SUCCESS; i += (uint64_t) ranks) {
+        uint64_t length, usize;
+        uint64_t limit = (i + 1 < total) ? offsets[i + 1] : file_size;
+        int decode_rc = DTAR_member_decode(filename, fd, limit, type, offsets[i],
+            0, NULL, NULL, in_buf, out_buf, bufsize, true, &length, &usize);
+        if (decode_rc == MFU_SUCCESS) {
+            lengths[i] = length;
+            usizes[i]  = usize;
+        }
+    }
+    if (total > 1) {
+        MPI_Allreduce(MPI_IN_PLACE, lengths, (int) total, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, usizes,  (int) total, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
     }
 
-    /* if a directory already exists, libarchive does not currently update
-     * its timestamps when closing the write archive,
-     * update timestamps on directories */
-    MPI_Barrier(MPI_COMM_WORLD);
+    mfu_free(&out_buf);
+    mfu_free(&in_buf);
+    mfu_close(filename, fd);
+
+    if (total < 2) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Could not split %s into independent compressed members", filename);
+        }
+        mfu_free(&usizes);
+        mfu_free(&lengths);
+        mfu_free(&offsets);
+        return MFU_FAILURE;
+    }
 
-    /* figure out whether anyone failed */
     if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        rc = MFU_FAILURE;
+        mfu_free(&usizes);
+        mfu_free(&lengths);
+        mfu_free(&offsets);
+        return MFU_FAILURE;
     }
 
-    return rc;
-}
+    /* follow the chain of members from the start of the archive,
+     * every rank has the same lists, so we all get the same chain */
+    members->type     = type;
+    members->offsets  = (uint64_t*) MFU_MALLOC(total * sizeof(uint64_t) + 1);
+    members->lengths  = (uint64_t*) MFU_MALLOC(total * sizeof(uint64_t) + 1);
+    members->uoffsets = (uint64_t*) MFU_MALLOC(total * sizeof(uint64_t) + 1);
+    bool complete = false;
+    i = 0; /* the first candidate is at offset 0, which rank 0 checked above */
+    while (i < total && lengths[i] > 0) {
+        members->offsets[members->count]  = offsets[i];
+        members->lengths[members->count]  = lengths[i];
+        members->uoffsets[members->count] = members->size;
+        members->size += usizes[i];
+        members->count++;
+
+        /* find the candidate that starts where this member ends */
+        uint64_t next = offsets[i] + lengths[i];
+        if (next == file_size) {
+            complete = true;
+            break;
+        }
+        while (i < total && offsets[i] < next) {
+            i++;
+        }
+        if (i == total || offsets[i] != next) {
+            break;
+        }
+    }
 
-/* iterate through our portion of the given file list,
- * identify symlinks and extract them from archive */
-static int extract_symlinks(
-    const char* filename,     /* name of archive file */
-    mfu_flist flist,          /* file list of items */
-    uint64_t* offsets,        /* offset of each item in the archive */
-    mfu_archive_opts_t* opts) /* options to configure extraction operation */
-{
-    int rc = MFU_SUCCESS;
+    mfu_free(&usizes);
+    mfu_free(&lengths);
+    mfu_free(&offsets);
 
-    /* iterate over all items in our list and count symlinks */
-    uint64_t count = 0;
-    uint64_t idx;
-    uint64_t size = mfu_flist_size(flist);
-    for (idx = 0; idx < size; idx++) {
-        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
-        if (type == MFU_TYPE_LINK) {
-            /* found a symlink */
-            count++;
+    /* we only gain from a chain that covers the archive
+     * and that has more than one member */
+    if (! complete || members->count < 2) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Could not split %s into independent compressed members", filename);
         }
+        DTAR_members_free(members);
+        return MFU_FAILURE;
     }
 
-    /* count total number of links */
-    uint64_t all_count;
-    MPI_Allreduce(&count, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
-
-    /* bail out early if there is nothing to do */
-    if (all_count == 0) {
-        return MFU_SUCCESS;
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Found %llu compressed members in %s",
+            (unsigned long long) members->count, filename);
     }
 
-    /* let user know what we're doing */
-    MPI_Barrier(MPI_COMM_WORLD);
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Creating %llu symlinks", (unsigned long long)all_count);
+    return MFU_SUCCESS;
+}
+
+/****************************************
+ * Extracting compressed archives in memory
+ ***************************************/
+
+/* Compressed archives that we can decode in parallel consist of
+ * segments, each of which decodes on its own: the frames of an
+ * archive written with --compress, or the members of a multi-member
+ * archive.  We extract them without an uncompressed copy of the
+ * archive.  Each process parses the headers of its share of the
+ * entries from memory and creates the items.
+ * The data of each regular file is then split at segment boundaries
+ * into pieces, which are sent to the process that decodes the segment.
+ * Segment i is decoded by rank i % ranks, only if some piece needs it,
+ * and its bytes are written straight to the files. */
+
+/* uncompressed stream of a compressed archive split into segments */
+typedef struct {
+    const char* filename;          /* name of compressed archive */
+    int fd;                        /* open file descriptor of archive */
+    uint64_t count;                /* number of segments */
+    uint64_t size;                 /* size of uncompressed stream in bytes */
+    uint64_t file_size;            /* size of compressed data in archive */
+    const DTAR_frames_t* frames;   /* frame index of archive, or NULL */
+    const DTAR_members_t* members; /* member list of archive, or NULL */
+    char* buf;                     /* buffer to decode a segment */
+    char* comp_buf;                /* buffer to read a compressed segment */
+    size_t bufsize;                /* size of buffers for members */
+} DTAR_stream_t;
+
+/* open the stream of the compressed archive filename on all ranks,
+ * which is split into either frames or members */
+static int DTAR_stream_open(
+    DTAR_stream_t* s,
+    const char* filename,
+    const DTAR_frames_t* frames,
+    const DTAR_members_t* members,
+    const mfu_archive_opts_t* opts)
+{
+    int rc = MFU_SUCCESS;
+
+    memset(s, 0, sizeof(*s));
+    s->filename = filename;
+    s->frames   = frames;
+    s->members  = members;
+    if (frames != NULL) {
+        s->count     = frames->count;
+        s->size      = frames->size;
+        s->file_size = frames->table_offset;
+    } else {
+        /* members are contiguous, so the archive ends where the last one does */
+        uint64_t last = members->count - 1;
+        s->count     = members->count;
+        s->size      = members->size;
+        s->file_size = members->offsets[last] + members->lengths[last];
     }
 
-    /* open the archive file for reading */
-    int fd = mfu_open(filename, O_RDONLY);
-    if (fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
-            filename, errno, strerror(errno)
-        );
+    s->fd = mfu_open(filename, O_RDONLY);
+    if (s->fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open archive '%s' errno=%d %s",
+            filename, errno, strerror(errno));
         rc = MFU_FAILURE;
     }
-
-    /* check that everyone opened the archive successfully */
     if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        /* someone failed, close the file if we opened it and return */
-        if (fd >= 0) {
-            mfu_close(filename, fd);
+        if (s->fd >= 0) {
+            mfu_close(filename, s->fd);
         }
         return MFU_FAILURE;
     }
 
-    /* get global offset of our portion of the list */
-    uint64_t global_offset = mfu_flist_global_offset(flist);
+    /* members are decoded in pieces, a frame is decoded whole */
+    if (members != NULL) {
+        s->bufsize  = opts->buf_size;
+        s->buf      = (char*) MFU_MALLOC(s->bufsize);
+        s->comp_buf = (char*) MFU_MALLOC(s->bufsize);
+        return MFU_SUCCESS;
+    }
 
-    /* iterate over all items in our list and create any symlinks */
-    for (idx = 0; idx < size; idx++) {
-        /* skip entries that are not symlinks */
-        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
-        if (type != MFU_TYPE_LINK) {
-            /* not a symlink, go to next item */
-            continue;
+    /* find the largest compressed frame */
+    uint64_t i;
+    uint64_t max_length = 0;
+    for (i = 0; i < frames->count; i++) {
+        if (frames->lengths[i] > max_length) {
+            max_length = frames->lengths[i];
         }
+    }
+    s->buf      = (char*) MFU_MALLOC((size_t) frames->frame_size);
+    s->comp_buf = (char*) MFU_MALLOC((size_t) max_length + 1);
 
-        /* got a symlink, get its path */
-        const char* name = mfu_flist_file_get_name(flist, idx);
+    return MFU_SUCCESS;
+}
 
-        /* seek to start of the corresponding entry in the archive file */
-        uint64_t global_idx = global_offset + idx;
-        off_t offset = (off_t) offsets[global_idx];
-        off_t pos = mfu_lseek(filename, fd, offset, SEEK_SET);
-        if (pos == (off_t)-1) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to seek to offset %llu in open archive: '%s' errno=%d %s",
-                offset, filename, errno, strerror(errno)
-            );
-            rc = MFU_FAILURE;
-            continue;
+static void DTAR_stream_close(DTAR_stream_t* s)
+{
+    mfu_free(&s->comp_buf);
+    mfu_free(&s->buf);
+    mfu_close(s->filename, s->fd);
+}
+
+/* return the id of the segment that holds byte pos of the stream */
+static uint64_t DTAR_stream_segment(const DTAR_stream_t* s, uint64_t pos)
+{
+    if (s->frames != NULL) {
+        return pos / s->frames->frame_size;
+    }
+
+    /* binary search for the last member that starts at or before pos */
+    const uint64_t* uoffsets = s->members->uoffsets;
+    uint64_t low  = 0;
+    uint64_t high = s->count - 1;
+    while (low < high) {
+        uint64_t mid = (low + high + 1) / 2;
+        if (uoffsets[mid] <= pos) {
+            low = mid;
+        } else {
+            high = mid - 1;
         }
+    }
+    return low;
+}
 
-        /* initiate archive object for reading */
-        struct archive* a = archive_read_new();
+/* return the offset in the stream at which segment i ends */
+static uint64_t DTAR_stream_segment_end(const DTAR_stream_t* s, uint64_t i)
+{
+    if (s->frames == NULL) {
+        return (i + 1 < s->count) ? s->members->uoffsets[i + 1] : s->size;
+    }
 
-        /* when using offsets, we assume there is no compression */
-//        archive_read_support_filter_bzip2(a);
-//        archive_read_support_filter_gzip(a);
-//        archive_read_support_filter_compress(a);
-        archive_read_support_format_tar(a);
+    uint64_t end = (i + 1) * s->frames->frame_size;
+    if (end > s->size) {
+        end = s->size;
+    }
+    return end;
+}
 
-        /* use a small read block size, since we just need the header */
-        int r = archive_read_open_fd(a, fd, 10240);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "opening archive to extract symlink `%s' at offset %llu %s",
-                name, offset, archive_error_string(a)
-            );
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            continue;
-        }
+/* entries of a compressed archive that this process extracts,
+ * along with the headers we need again after creating the items */
+typedef struct {
+    mfu_flist flist;        /* items of our selected entries */
+    uint64_t count;         /* number of items in flist */
+    uint64_t max;           /* number of slots allocated in arrays below */
+    uint64_t* data_offsets; /* offset of the data of each item in the stream */
+    uint64_t* hdr_offsets;  /* offset of saved header of each item in hdrs, or UINT64_MAX */
+    uint64_t* hdr_lengths;  /* length of saved header of each item */
+    char* hdrs;             /* saved headers of symlinks and of items with xattrs */
+    size_t hdrs_size;       /* number of bytes used in hdrs */
+    size_t hdrs_max;        /* number of bytes allocated in hdrs */
+} DTAR_entries_t;
+
+static void DTAR_entries_init(DTAR_entries_t* e)
+{
+    memset(e, 0, sizeof(*e));
+    e->flist = mfu_flist_new();
+    mfu_flist_set_detail(e->flist, 1);
+}
 
-        /* read the entry header for this item */
-        struct archive_entry* entry;
-        r = archive_read_next_header(a, &entry);
-        if (r == ARCHIVE_EOF) {
-            MFU_LOG(MFU_LOG_ERR, "Unexpected end of archive while extracting symlink `%s' at offset %llu",
-                name, offset
-            );
-            archive_read_close(a);
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            continue;
-        }
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Extracting symlink '%s' at offset %llu %s",
-                name, offset, archive_error_string(a)
-            );
-            archive_read_close(a);
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            continue;
-        }
+static void DTAR_entries_free(DTAR_entries_t* e)
+{
+    mfu_flist_free(&e->flist);
+    mfu_free(&e->data_offsets);
+    mfu_free(&e->hdr_offsets);
+    mfu_free(&e->hdr_lengths);
+    mfu_free(&e->hdrs);
+}
 
-        /* get target of the link */
-        const char* target = archive_entry_symlink(entry);
-        if (target == NULL) {
-            MFU_LOG(MFU_LOG_ERR, "Item is not a symlink as expected `%s'",
-                name);
-            archive_read_close(a);
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            continue;
-        }
+/* resize buf to hold bytes, abort if we fail */
+static void* DTAR_realloc(void* buf, size_t bytes)
+{
+    buf = realloc(buf, bytes);
+    if (buf == NULL) {
+        MFU_ABORT(-1, "Failed to allocate %llu bytes for archive entries",
+            (unsigned long long) bytes);
+    }
+    return buf;
+}
 
-        /* create the link on the file system */
-        int symlink_rc = mfu_symlink(target, name);
-        if (symlink_rc != 0) {
-            /* TODO: check whether user wants overwrite */
-            if (errno == EEXIST) {
-                /* failed because something exists,
-                 * attempt to delete item and try again */
-                mfu_unlink(name);
-                symlink_rc = mfu_symlink(target, name);
-            }
+/* parse the header in hdr of the entry at offset in the stream,
+ * and add the entry to our list if the user selected it */
+static int DTAR_entries_add(
+    DTAR_entries_t* e,
+    const char* filename,
+    const char* hdr,
+    size_t hdr_len,
+    uint64_t offset,
+    const mfu_path* cwd,
+    const mfu_archive_opts_t* opts)
+{
+    int rc = MFU_SUCCESS;
 
-            /* if we still failed, give up */
-            if (symlink_rc != 0) {
-                MFU_LOG(MFU_LOG_ERR, "Failed to set symlink `%s' (errno=%d %s)",
-                    name, errno, strerror(errno));
-                rc = MFU_FAILURE;
+    struct archive* a = archive_read_new();
+    archive_read_support_format_tar(a);
+    struct archive_entry* entry;
+    if (archive_read_open_memory(a, (void*) hdr, hdr_len) != ARCHIVE_OK ||
+        archive_read_next_header(a, &entry) != ARCHIVE_OK)
+    {
+        MFU_LOG(MFU_LOG_ERR, "Failed to read header at offset %llu in '%s' %s",
+            (unsigned long long) offset, filename, archive_error_string(a));
+        rc = MFU_FAILURE;
+    } else if (archive_entry_selected(entry, opts)) {
+        if (e->count == e->max) {
+            e->max = (e->max > 0) ? e->max * 2 : 1024;
+            size_t bytes = (size_t) e->max * sizeof(uint64_t);
+            e->data_offsets = (uint64_t*) DTAR_realloc(e->data_offsets, bytes);
+            e->hdr_offsets  = (uint64_t*) DTAR_realloc(e->hdr_offsets,  bytes);
+            e->hdr_lengths  = (uint64_t*) DTAR_realloc(e->hdr_lengths,  bytes);
+        }
+
+        insert_entry_into_flist(entry, e->flist, cwd);
+        e->data_offsets[e->count] = offset + hdr_len;
+        e->hdr_offsets[e->count]  = UINT64_MAX;
+        e->hdr_lengths[e->count]  = 0;
+
+        /* we read the header again to create a symlink or set xattrs */
+        if (S_ISLNK(archive_entry_mode(entry)) ||
+            (opts->preserve_xattrs && archive_entry_xattr_count(entry) > 0))
+        {
+            if (e->hdrs_size + hdr_len > e->hdrs_max) {
+                size_t max = (e->hdrs_max > 0) ? e->hdrs_max * 2 : 1024 * 1024;
+                while (e->hdrs_size + hdr_len > max) {
+                    max *= 2;
+                }
+                e->hdrs = (char*) DTAR_realloc(e->hdrs, max);
+                e->hdrs_max = max;
             }
+            memcpy(e->hdrs + e->hdrs_size, hdr, hdr_len);
+            e->hdr_offsets[e->count] = (uint64_t) e->hdrs_size;
+            e->hdr_lengths[e->count] = (uint64_t) hdr_len;
+            e->hdrs_size += hdr_len;
         }
 
-        /* close out the read archive object */
-        r = archive_read_close(a);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to close read archive %s",
-                archive_error_string(a)
-            );
-            rc = MFU_FAILURE;
-        }
-
-        /* free memory allocated in read archive object */
-        r = archive_read_free(a);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to free read archive %s",
-                archive_error_string(a)
-            );
-            rc = MFU_FAILURE;
-        }
+        e->count++;
     }
+    archive_read_close(a);
+    archive_read_free(a);
 
-    /* close the archive file */
-    mfu_close(filename, fd);
+    return rc;
+}
+
+/* complete the list of entries after each process has added its own,
+ * rc is our return code from adding entries */
+static int DTAR_entries_finish(
+    DTAR_entries_t* e,
+    uint64_t entries,  /* number of entries in archive */
+    const mfu_archive_opts_t* opts,
+    int rc)
+{
+    mfu_flist_summarize(e->flist);
 
-    /* figure out whether anyone failed */
     if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        rc = MFU_FAILURE;
+        return MFU_FAILURE;
     }
 
-    return rc;
-}
-
-/* Extract xattrs from archive file and copy to item.
- * This uses libarchive to actually read the entry from the archive */
-static int extract_xattrs(
-    const char* filename,     /* name of archive file */
-    const mfu_param_path* cwdpath, /* path to prepend to any relative path in archive */
-    int flags,                /* flags passed to archive_write_disk_set_options */
-    uint64_t entries,         /* number of total entries in offsets array */
-    uint64_t entry_start,     /* starting offset in offsets we're responsible for */
-    uint64_t entry_count,     /* number of entries we're responsible for */
-    uint64_t* offsets,        /* offset to each entry in the archive */
-    mfu_flist flist,          /* file list corresponding to our subset of entries */
-    mfu_archive_opts_t* opts) /* options to configure extract operation */
+    if (opts->member_count > 0) {
+        uint64_t total = mfu_flist_global_size(e->flist);
+        if (mfu_rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Selected %llu of %llu entries",
+                (unsigned long long) total, (unsigned long long) entries);
+        }
+    }
+
+    return MFU_SUCCESS;
+}
+
+/* read the headers of our share of the entries of an archive written
+ * with --compress, decompressing in memory the frames that hold them */
+static int DTAR_frames_entries(
+    const DTAR_stream_t* s,
+    const mfu_param_path* cwdpath,
+    const mfu_archive_opts_t* opts,
+    DTAR_entries_t* e)
 {
-    /* assume we'll succeed */
     int rc = MFU_SUCCESS;
 
-    /* indicate to user what phase we're in */
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Extracting xattrs");
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting metadata");
     }
 
-    /* intitialize counters to track number of bytes and items extracted */
-//    reduce_buf[REDUCE_BYTES] = 0;
-//    reduce_buf[REDUCE_ITEMS] = 0;
+    const DTAR_frames_t* frames = s->frames;
+    DTAR_frame_reader_t reader;
+    DTAR_frame_reader_init(&reader, s->filename, s->fd, frames);
 
-    /* start progress messages while setting metadata */
-//    extract_prog = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, extract2_progress_fn);
+    mfu_path* cwd = mfu_path_from_str(cwdpath->path);
 
-    /* open the archive file for reading */
-    int fd = mfu_open(filename, O_RDONLY);
-    if (fd < 0) {
-        MFU_LOG(MFU_LOG_ERR, "Failed to open archive: '%s' errno=%d %s",
-            filename, errno, strerror(errno)
-        );
-        rc = MFU_FAILURE;
-    }
+    /* buffer to gather all blocks of one header */
+    size_t hdr_max = 4 * 512;
+    char* hdr = (char*) MFU_MALLOC(hdr_max);
 
-    /* check that everyone opened the archive successfully */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        /* someone failed, close the file if we opened it and return */
-        if (fd >= 0) {
-            mfu_close(filename, fd);
+    uint64_t entry_start, entry_count;
+    mfu_get_start_count(rank, ranks, frames->entries, &entry_start, &entry_count);
+    uint64_t i;
+    for (i = 0; i < entry_count && rc == MFU_SUCCESS; i++) {
+        uint64_t offset = frames->entry_offsets[entry_start + i];
+        size_t hdr_len;
+        rc = DTAR_frame_reader_header(&reader, offset, &hdr, &hdr_max, &hdr_len);
+        if (rc == MFU_SUCCESS) {
+            rc = DTAR_entries_add(e, s->filename, hdr, hdr_len, offset, cwd, opts);
         }
-        return MFU_FAILURE;
     }
 
-    /* get current working directory */
-    mfu_path* cwd = mfu_path_from_str(cwdpath->path);
+    mfu_free(&hdr);
+    mfu_path_delete(&cwd);
+    DTAR_frame_reader_free(&reader);
 
-    /* iterate over and extract each item we're responsible for */
-    uint64_t count = 0;
-    while (count < entry_count && rc == MFU_SUCCESS) {
-        /* seek to start of the entry in the archive file */
-        uint64_t idx = entry_start + count;
-        off_t offset = (off_t) offsets[idx];
-        off_t pos = mfu_lseek(filename, fd, offset, SEEK_SET);
-        if (pos == (off_t)-1) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to seek to offset %llu in open archive: '%s' errno=%d %s",
-                offset, filename, errno, strerror(errno)
-            );
-            rc = MFU_FAILURE;
-            break;
-        }
+    return DTAR_entries_finish(e, frames->entries, opts, rc);
+}
 
-        /* initiate archive object for reading,
-         * we do this new each time to be sure that state is
-         * not left over from the previous item */
-        struct archive* a = archive_read_new();
+/* largest data of an extended header or long name that we accept
+ * while searching the members of an archive for headers */
+#define DTAR_EXT_MAX (64 * 1024 * 1024)
 
-        /* when using offsets, we assume there is no compression */
-//        archive_read_support_filter_bzip2(a);
-//        archive_read_support_filter_gzip(a);
-//        archive_read_support_filter_compress(a);
-        archive_read_support_format_tar(a);
+/* returns true if the 512-byte block is a tar header whose
+ * checksum matches, tar accepts either signed or unsigned sums */
+static bool DTAR_header_valid(const unsigned char* block)
+{
+    uint64_t expected = DTAR_header_number(block + 148, 8);
+    uint64_t usum = 0;
+    int64_t ssum = 0;
+    int i;
+    for (i = 0; i < 512; i++) {
+        /* the checksum field counts as spaces */
+        unsigned char c = (i >= 148 && i < 156) ? ' ' : block[i];
+        usum += (uint64_t) c;
+        ssum += (int64_t)(signed char) c;
+    }
+    return (usum == expected || (ssum >= 0 && (uint64_t) ssum == expected));
+}
 
-        /* use a small block size since we're just reading headers */
-        int r = archive_read_open_fd(a, fd, 10240);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "opening archive to extract entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(a)
-            );
-            archive_read_free(a);
-            rc = MFU_FAILURE;
+/* return the value of the size record in the data of a pax
+ * extended header, or UINT64_MAX if it has none */
+static uint64_t DTAR_pax_size(const char* data, size_t len)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        /* each record is "<length> <keyword>=<value>\n" */
+        uint64_t reclen = 0;
+        size_t i = pos;
+        while (i < len && data[i] >= '0' && data[i] <= '9') {
+            reclen = reclen * 10 + (uint64_t)(data[i] - '0');
+            i++;
+        }
+        if (reclen == 0 || reclen > (uint64_t)(len - pos) || i >= len || data[i] != ' ') {
             break;
         }
 
-        /* read the entry header for this item */
-        struct archive_entry* entry;
-        r = archive_read_next_header(a, &entry);
-        if (r == ARCHIVE_EOF) {
-            MFU_LOG(MFU_LOG_ERR, "unexpected end of archive, read %llu of %llu items",
-                count, entry_count
-            );
-            archive_read_close(a);
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
+        const char* key = data + i + 1;
+        const char* end = data + pos + reclen;
+        if (end - key > 5 && strncmp(key, "size=", 5) == 0) {
+            return (uint64_t) strtoull(key + 5, NULL, 10);
         }
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "extracting entry %llu at offset %llu %s",
-                idx, offset, archive_error_string(a)
-            );
-            archive_read_close(a);
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
+        pos += (size_t) reclen;
+    }
+    return UINT64_MAX;
+}
+
+/* a block found while searching decoded members that may be the
+ * header of an entry, we save the block along with the data of an
+ * extended header or long name, which describes the entry after it */
+typedef struct {
+    uint64_t offset; /* offset of block in the stream */
+    uint64_t size;   /* size of data that follows the block */
+    uint64_t type;   /* type flag of the header */
+    uint64_t length; /* number of bytes to save */
+    uint64_t got;    /* number of bytes saved so far */
+    uint64_t saved;  /* offset of saved bytes in buf */
+} DTAR_header_t;
+
+/* state to search the decoded members a process owns for header
+ * blocks, and for runs of zero blocks, one of which ends the archive */
+typedef struct {
+    DTAR_header_t* headers; /* header blocks we found */
+    uint64_t count;         /* number of header blocks */
+    uint64_t max;           /* number of slots in headers and pending */
+    uint64_t* pending;      /* index of each header we have yet to save in full */
+    uint64_t pending_count; /* number of headers in pending */
+    char* buf;              /* saved bytes of headers */
+    size_t buf_size;        /* number of bytes used in buf */
+    size_t buf_max;         /* number of bytes allocated in buf */
+    uint64_t* zeros;        /* (start, end) of each run of zero blocks */
+    uint64_t zero_count;    /* number of runs */
+    uint64_t zero_max;      /* number of runs allocated in zeros */
+    uint64_t run_start;     /* start of current run of zero blocks, or UINT64_MAX */
+    uint64_t run_end;       /* end of current run of zero blocks */
+    uint64_t first;         /* first block we check in current member */
+    uint64_t pos;           /* next block to check */
+    uint64_t end;           /* check blocks that start before end */
+    char* work;             /* start of next block followed by decoded bytes */
+    uint64_t work_pos;      /* offset of work in the stream */
+    size_t work_len;        /* number of bytes in work */
+} DTAR_header_scan_t;
+
+/* record the current run of zero blocks, short runs are common in file
+ * data, so keep those only at the start or end of a member where they
+ * may join a run in the neighboring member */
+static void DTAR_header_scan_end_run(DTAR_header_scan_t* sc, bool at_end)
+{
+    if (sc->run_start == UINT64_MAX) {
+        return;
+    }
+
+    if (at_end || sc->run_start == sc->first || sc->run_end - sc->run_start >= 1024) {
+        if (sc->zero_count == sc->zero_max) {
+            sc->zero_max = (sc->zero_max > 0) ? sc->zero_max * 2 : 1024;
+            sc->zeros = (uint64_t*) DTAR_realloc(sc->zeros, (size_t) sc->zero_max * 2 * sizeof(uint64_t));
         }
+        sc->zeros[sc->zero_count * 2 + 0] = sc->run_start;
+        sc->zeros[sc->zero_count * 2 + 1] = sc->run_end;
+        sc->zero_count++;
+    }
 
-        /* copy xattrs from entry to file */
-        int num = archive_entry_xattr_count(entry);
-        if (num > 0) {
-            /* get path to entry on the file system */
-            const char* path = full_path_to_entry(entry, cwd);
+    sc->run_start = UINT64_MAX;
+}
 
-            /* entry has some xattrs recorded, extract and apply them */
-            int i;
-            archive_entry_xattr_reset(entry);
-            for (i = 0; i < num; i++) {
-                /* read next xattr value recorded in archive entry */
-                const char* xname = NULL;
-                const void* xval  = NULL;
-                size_t xsize = 0;
-                r = archive_entry_xattr_next(entry, &xname, &xval, &xsize);
-                if (r == ARCHIVE_OK) {
-                    /* successfully extracted xattr, now try to set it */
-                    int set_rc = setxattr(path, xname, xval, xsize, 0);
-                    if (set_rc == -1) {
-                        MFU_LOG(MFU_LOG_ERR, "failed to setxattr '%s' on '%s' errno=%d %s",
-                            xname, path, errno, strerror(errno) 
-                        );
-                        rc = MFU_FAILURE;
-                        /* don't break in case other xattrs work */
-                    }
-                } else {
-                    /* failed to read xattr */
-                    MFU_LOG(MFU_LOG_ERR, "failed to extract xattr for '%s' of entry %llu at offset %llu",
-                        path, idx, offset
-                    );
-                    rc = MFU_FAILURE;
-                    /* don't break in case other xattrs work */
-                }
-            }
+/* check the block at offset pos of the stream,
+ * avail bytes of the stream follow the block in memory */
+static void DTAR_header_scan_block(
+    DTAR_header_scan_t* sc,
+    const unsigned char* block,
+    uint64_t pos,
+    uint64_t avail)
+{
+    /* track runs of zero blocks */
+    size_t i = 0;
+    while (i < 512 && block[i] == 0) {
+        i++;
+    }
+    if (i == 512) {
+        if (sc->run_start == UINT64_MAX) {
+            sc->run_start = pos;
+        }
+        sc->run_end = pos + 512;
+        return;
+    }
+    DTAR_header_scan_end_run(sc, false);
+
+    if (! DTAR_header_valid(block)) {
+        return;
+    }
+
+    /* extended headers and long names are followed by data that we save,
+     * links, devices, directories, and fifos have no data */
+    char type = (char) block[156];
+    uint64_t size = DTAR_header_number(block + 124, 12);
+    uint64_t length = 512;
+    if (type == 'x' || type == 'g' || type == 'L' || type == 'K') {
+        if (size > DTAR_EXT_MAX) {
+            return;
+        }
+        length += get_filesize_padded(size);
+    } else if (type >= '1' && type <= '6') {
+        size = 0;
+    }
+
+    if (sc->count == sc->max) {
+        sc->max = (sc->max > 0) ? sc->max * 2 : 1024;
+        sc->headers = (DTAR_header_t*) DTAR_realloc(sc->headers, (size_t) sc->max * sizeof(DTAR_header_t));
+        sc->pending = (uint64_t*) DTAR_realloc(sc->pending, (size_t) sc->max * sizeof(uint64_t));
+    }
+    if (sc->buf_size + (size_t) length > sc->buf_max) {
+        size_t max = (sc->buf_max > 0) ? sc->buf_max * 2 : 1024 * 1024;
+        while (sc->buf_size + (size_t) length > max) {
+            max *= 2;
+        }
+        sc->buf = (char*) DTAR_realloc(sc->buf, max);
+        sc->buf_max = max;
+    }
+
+    /* save what we have of the header, and the rest as we decode it */
+    DTAR_header_t* h = &sc->headers[sc->count];
+    h->offset = pos;
+    h->size   = size;
+    h->type   = (uint64_t)(unsigned char) type;
+    h->length = length;
+    h->got    = (avail < length) ? avail : length;
+    h->saved  = (uint64_t) sc->buf_size;
+    memcpy(sc->buf + sc->buf_size, block, (size_t) h->got);
+    sc->buf_size += (size_t) length;
+    if (h->got < h->length) {
+        sc->pending[sc->pending_count] = sc->count;
+        sc->pending_count++;
+    }
+    sc->count++;
+}
 
-            mfu_free(&path);
+/* save the len bytes in buf at offset pos of the stream
+ * into the headers we have yet to save in full */
+static void DTAR_header_scan_save(
+    DTAR_header_scan_t* sc,
+    uint64_t pos,
+    const char* buf,
+    size_t len)
+{
+    uint64_t end = pos + (uint64_t) len;
+    uint64_t i = 0;
+    while (i < sc->pending_count) {
+        DTAR_header_t* h = &sc->headers[sc->pending[i]];
+        uint64_t start = h->offset + h->got;
+        uint64_t stop  = h->offset + h->length;
+        if (stop > end) {
+            stop = end;
+        }
+        if (start >= pos && start < stop) {
+            memcpy(sc->buf + h->saved + h->got, buf + (start - pos), (size_t)(stop - start));
+            h->got += stop - start;
+        }
+
+        /* drop headers we have saved in full from the pending list */
+        if (h->got == h->length) {
+            sc->pending_count--;
+            sc->pending[i] = sc->pending[sc->pending_count];
+        } else {
+            i++;
         }
+    }
+}
 
-        /* increment our count of items extracted */
-//        reduce_buf[REDUCE_ITEMS]++;
+/* check the blocks in bytes decoded from a member, and stop decoding
+ * once we have checked our blocks and saved the headers we found */
+static int DTAR_header_scan_fn(uint64_t pos, const char* buf, size_t len, void* arg)
+{
+    DTAR_header_scan_t* sc = (DTAR_header_scan_t*) arg;
 
-        /* update number of items we have completed for progress messages */
-//        mfu_progress_update(reduce_buf, extract_prog);
+    /* save bytes of headers that extend past what we decoded before */
+    DTAR_header_scan_save(sc, pos, buf, len);
 
-        /* close out the read archive object */
-        r = archive_read_close(a);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to close read archive %s",
-                archive_error_string(a)
-            );
-            archive_read_free(a);
-            rc = MFU_FAILURE;
-            break;
+    if (sc->pos < sc->end) {
+        /* append decoded bytes to the start of the next block */
+        if (sc->work_len == 0) {
+            sc->work_pos = pos;
         }
+        memcpy(sc->work + sc->work_len, buf, len);
+        sc->work_len += len;
 
-        /* free memory allocated in read archive object */
-        r = archive_read_free(a);
-        if (r != ARCHIVE_OK) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to free read archive %s",
-                archive_error_string(a)
-            );
-            rc = MFU_FAILURE;
-            break;
+        /* check each block we have in full */
+        uint64_t work_end = sc->work_pos + (uint64_t) sc->work_len;
+        while (sc->pos < sc->end && sc->pos + 512 <= work_end) {
+            const unsigned char* block = (const unsigned char*) sc->work + (sc->pos - sc->work_pos);
+            DTAR_header_scan_block(sc, block, sc->pos, work_end - sc->pos);
+            sc->pos += 512;
         }
 
-        /* advance to our next entry */
-        count++;
+        /* keep the start of the next block */
+        sc->work_len = 0;
+        if (sc->pos < sc->end && sc->pos < work_end) {
+            size_t keep = (size_t)(work_end - sc->pos);
+            memmove(sc->work, sc->work + (sc->pos - sc->work_pos), keep);
+            sc->work_pos = sc->pos;
+            sc->work_len = keep;
+        }
     }
 
-    /* free path object of current working directory */
-    mfu_path_delete(&cwd);
+    if (sc->pos >= sc->end && sc->pending_count == 0) {
+        return 1;
+    }
+    return 0;
+}
 
-    /* finalize progress messages */
-//    mfu_progress_complete(reduce_buf, &extract_prog);
+/* search the members we own for header blocks, member i is searched
+ * by rank i % ranks, which decodes the members that follow only as far
+ * as needed to check its last block and save the headers it found */
+static int DTAR_header_scan_members(
+    const DTAR_stream_t* s,
+    DTAR_header_scan_t* sc)
+{
+    int rc = MFU_SUCCESS;
 
-    /* figure out whether anyone failed */
-    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
-        rc = MFU_FAILURE;
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    const DTAR_members_t* members = s->members;
+    uint64_t i;
+    for (i = (uint64_t) rank; i < members->count && rc == MFU_SUCCESS; i += (uint64_t) ranks) {
+        /* blocks are aligned in the stream, but members need not be */
+        sc->first     = (members->uoffsets[i] + 511) / 512 * 512;
+        sc->pos       = sc->first;
+        sc->end       = DTAR_stream_segment_end(s, i);
+        sc->work_len  = 0;
+        sc->run_start = UINT64_MAX;
+        if (sc->pos >= sc->end) {
+            continue;
+        }
+
+        uint64_t j;
+        for (j = i; j < members->count; j++) {
+            uint64_t length, usize;
+            rc = DTAR_member_decode(s->filename, s->fd, s->file_size, members->type,
+                members->offsets[j], members->uoffsets[j], DTAR_header_scan_fn, sc,
+                s->comp_buf, s->buf, s->bufsize, false, &length, &usize);
+            if (rc != MFU_SUCCESS || (sc->pos >= sc->end && sc->pending_count == 0)) {
+                break;
+            }
+        }
+
+        /* headers that run past the end of the stream stay incomplete */
+        sc->pending_count = 0;
+
+        /* a run of zero blocks at the end of the member may continue in the next */
+        DTAR_header_scan_end_run(sc, true);
     }
 
     return rc;
 }
 
-typedef enum {
-    DEFAULT,        /* attempt to dynamically choose best option */
-    LIBARCHIVE,     /* read/write through libarchvie, round-robin items across ranks */
-    LIBARCHIVE_IDX, /* read/write through libarchvie, lseek to each entry */
-    CHUNK,          /* direct read of data, chunk list */
-    LIBCIRCLE       /* direct read of data, chunk list to init libcircle */
-} mfu_flist_archive_extract_algo;
+/* a header block found in the stream, and the process that saved it */
+typedef struct {
+    uint64_t offset;   /* offset of block in the stream */
+    uint64_t size;     /* size of data that follows the block */
+    uint64_t type;     /* type flag of the header */
+    uint64_t pax_size; /* size given by a pax extended header, or UINT64_MAX */
+    uint64_t rank;     /* rank that saved the header */
+    uint64_t index;    /* index of header on that rank */
+} DTAR_header_info_t;
+
+/* compare header blocks, or runs of zero blocks, by their offset */
+static int DTAR_offset_cmp(const void* a, const void* b)
+{
+    uint64_t oa = *(const uint64_t*) a;
+    uint64_t ob = *(const uint64_t*) b;
+    if (oa < ob) {
+        return -1;
+    }
+    if (oa > ob) {
+        return 1;
+    }
+    return 0;
+}
 
-static mfu_flist_archive_extract_algo select_extract_algo(void)
+/* returns true for the type of a header that describes the entry after it */
+static bool DTAR_header_type_ext(uint64_t type)
 {
-    mfu_flist_archive_extract_algo algo = DEFAULT;
+    return (type == 'x' || type == 'g' || type == 'L' || type == 'K');
+}
 
-    const char varname[] = "MFU_FLIST_ARCHIVE_EXTRACT";
-    const char* value = getenv(varname);
-    if (value == NULL) {
-        return algo;
+/* find the entries of a multi-member archive, each process searches the
+ * members it owns for header blocks, and then all follow the chain of
+ * headers from the start of the stream, the headers of each entry go to
+ * the process that found its first one, which adds the entry if the
+ * user selected it, sets found to false without an error if the chain
+ * does not reach the end of the archive */
+static int DTAR_members_entries(
+    const DTAR_stream_t* s,
+    const mfu_param_path* cwdpath,
+    const mfu_archive_opts_t* opts,
+    DTAR_entries_t* e,
+    bool* found)
+{
+    int rc = MFU_SUCCESS;
+
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    *found = false;
+
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting metadata");
+    }
+
+    DTAR_header_scan_t sc;
+    memset(&sc, 0, sizeof(sc));
+    sc.work = (char*) MFU_MALLOC(s->bufsize + 512);
+    rc = DTAR_header_scan_members(s, &sc);
+    mfu_free(&sc.work);
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        mfu_free(&sc.headers);
+        mfu_free(&sc.pending);
+        mfu_free(&sc.buf);
+        mfu_free(&sc.zeros);
+        return MFU_FAILURE;
+    }
+
+    /* list the headers we saved in full */
+    uint64_t* my_offsets = (uint64_t*) MFU_MALLOC(sc.count * sizeof(uint64_t) + 1);
+    uint64_t* my_sizes   = (uint64_t*) MFU_MALLOC(sc.count * sizeof(uint64_t) + 1);
+    uint64_t* my_types   = (uint64_t*) MFU_MALLOC(sc.count * sizeof(uint64_t) + 1);
+    uint64_t* my_pax     = (uint64_t*) MFU_MALLOC(sc.count * sizeof(uint64_t) + 1);
+    uint64_t* my_index   = (uint64_t*) MFU_MALLOC(sc.count * sizeof(uint64_t) + 1);
+    uint64_t count = 0;
+    uint64_t i;
+    for (i = 0; i < sc.count; i++) {
+        const DTAR_header_t* h = &sc.headers[i];
+        if (h->got < h->length) {
+            continue;
+        }
+        my_offsets[count] = h->offset;
+        my_sizes[count]   = h->size;
+        my_types[count]   = h->type;
+        my_pax[count]     = UINT64_MAX;
+        if (h->type == 'x') {
+            my_pax[count] = DTAR_pax_size(sc.buf + h->saved + 512, (size_t) h->size);
+        }
+        my_index[count] = i;
+        count++;
+    }
+
+    /* gather the headers that everyone found */
+    uint64_t total;
+    int* disps;
+    uint64_t* all_offsets;
+    uint64_t* all_sizes;
+    uint64_t* all_types;
+    uint64_t* all_pax;
+    uint64_t* all_index;
+    int* tmp_disps;
+    allgather_offsets(count, my_offsets, &total, &all_offsets, &disps);
+    allgather_offsets(count, my_sizes, &total, &all_sizes, &tmp_disps);
+    mfu_free(&tmp_disps);
+    allgather_offsets(count, my_types, &total, &all_types, &tmp_disps);
+    mfu_free(&tmp_disps);
+    allgather_offsets(count, my_pax, &total, &all_pax, &tmp_disps);
+    mfu_free(&tmp_disps);
+    allgather_offsets(count, my_index, &total, &all_index, &tmp_disps);
+    mfu_free(&tmp_disps);
+    mfu_free(&my_index);
+    mfu_free(&my_pax);
+    mfu_free(&my_types);
+    mfu_free(&my_sizes);
+    mfu_free(&my_offsets);
+
+    /* sort the headers by offset, ranks search members round-robin */
+    DTAR_header_info_t* info = (DTAR_header_info_t*) MFU_MALLOC(total * sizeof(DTAR_header_info_t) + 1);
+    int r;
+    for (r = 0; r < ranks; r++) {
+        uint64_t start = (uint64_t) disps[r];
+        uint64_t end = (r + 1 < ranks) ? (uint64_t) disps[r + 1] : total;
+        for (i = start; i < end; i++) {
+            info[i].offset   = all_offsets[i];
+            info[i].size     = all_sizes[i];
+            info[i].type     = all_types[i];
+            info[i].pax_size = all_pax[i];
+            info[i].rank     = (uint64_t) r;
+            info[i].index    = all_index[i];
+        }
+    }
+    qsort(info, (size_t) total, sizeof(DTAR_header_info_t), DTAR_offset_cmp);
+    mfu_free(&all_index);
+    mfu_free(&all_pax);
+    mfu_free(&all_types);
+    mfu_free(&all_sizes);
+    mfu_free(&all_offsets);
+    mfu_free(&disps);
+
+    /* gather runs of zero blocks, sort them, and join runs that
+     * continue from one member into the next */
+    uint64_t* my_starts = (uint64_t*) MFU_MALLOC(sc.zero_count * sizeof(uint64_t) + 1);
+    uint64_t* my_ends   = (uint64_t*) MFU_MALLOC(sc.zero_count * sizeof(uint64_t) + 1);
+    for (i = 0; i < sc.zero_count; i++) {
+        my_starts[i] = sc.zeros[i * 2 + 0];
+        my_ends[i]   = sc.zeros[i * 2 + 1];
+    }
+    uint64_t runs;
+    uint64_t* all_starts;
+    uint64_t* all_ends;
+    allgather_offsets(sc.zero_count, my_starts, &runs, &all_starts, &tmp_disps);
+    mfu_free(&tmp_disps);
+    allgather_offsets(sc.zero_count, my_ends, &runs, &all_ends, &tmp_disps);
+    mfu_free(&tmp_disps);
+    mfu_free(&my_ends);
+    mfu_free(&my_starts);
+
+    uint64_t* zeros = (uint64_t*) MFU_MALLOC(runs * 2 * sizeof(uint64_t) + 1);
+    for (i = 0; i < runs; i++) {
+        zeros[i * 2 + 0] = all_starts[i];
+        zeros[i * 2 + 1] = all_ends[i];
+    }
+    mfu_free(&all_ends);
+    mfu_free(&all_starts);
+    qsort(zeros, (size_t) runs, 2 * sizeof(uint64_t), DTAR_offset_cmp);
+    uint64_t joined = 0;
+    for (i = 0; i < runs; i++) {
+        if (joined > 0 && zeros[(joined - 1) * 2 + 1] == zeros[i * 2 + 0]) {
+            zeros[(joined - 1) * 2 + 1] = zeros[i * 2 + 1];
+        } else {
+            zeros[joined * 2 + 0] = zeros[i * 2 + 0];
+            zeros[joined * 2 + 1] = zeros[i * 2 + 1];
+            joined++;
+        }
     }
+    runs = joined;
+
+    /* follow the chain of headers from the start of the stream, every
+     * rank has the same lists, so we all get the same chain, the chain
+     * ends at two zero blocks, or at the end of the stream */
+    uint64_t* chain = (uint64_t*) MFU_MALLOC(total * sizeof(uint64_t) + 1);
+    uint64_t chain_len = 0;
+    uint64_t pos = 0;
+    uint64_t pax_size = UINT64_MAX;
+    bool ext = false;
+    while (1) {
+        if (pos == s->size) {
+            *found = !ext;
+            break;
+        }
+
+        /* binary search for a header at pos */
+        uint64_t low  = 0;
+        uint64_t high = total;
+        while (low < high) {
+            uint64_t mid = (low + high) / 2;
+            if (info[mid].offset < pos) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        if (low < total && info[low].offset == pos) {
+            const DTAR_header_info_t* h = &info[low];
+            chain[chain_len] = low;
+            chain_len++;
+
+            if (DTAR_header_type_ext(h->type)) {
+                /* a pax header may give the size of the next entry */
+                if (h->pax_size != UINT64_MAX) {
+                    pax_size = h->pax_size;
+                }
+                pos += 512 + get_filesize_padded(h->size);
+                ext = true;
+            } else {
+                uint64_t size = (pax_size != UINT64_MAX) ? pax_size : h->size;
+                pos += 512 + get_filesize_padded(size);
+                pax_size = UINT64_MAX;
+                ext = false;
+            }
+            continue;
+        }
 
-    if (strcmp(value, "DEFAULT") == 0) {
-        algo = DEFAULT;
-    } else if (strcmp(value, "LIBARCHIVE") == 0) {
-        algo = LIBARCHIVE;
-    } else if (strcmp(value, "LIBARCHIVE_IDX") == 0) {
-        algo = LIBARCHIVE_IDX;
-    } else if (strcmp(value, "CHUNK") == 0) {
-        algo = CHUNK;
-    } else if (strcmp(value, "LIBCIRCLE") == 0) {
-        algo = LIBCIRCLE;
-    } else {
-        if (mfu_rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "%s: unknown value %s", varname, value);
+        /* otherwise, we must be at the end of the archive */
+        low  = 0;
+        high = runs;
+        while (low < high) {
+            uint64_t mid = (low + high) / 2;
+            if (zeros[mid * 2 + 1] <= pos) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
         }
-        value = "DEFAULT";
-        algo = DEFAULT;
+        if (! ext && low < runs && zeros[low * 2 + 0] <= pos && zeros[low * 2 + 1] - pos >= 1024) {
+            *found = true;
+        }
+        break;
     }
+    mfu_free(&zeros);
 
-    if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "%s: %s", varname, value);
+    if (! *found) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Could not find the entries of %s in its members", s->filename);
+        }
+        mfu_free(&chain);
+        mfu_free(&info);
+        mfu_free(&sc.headers);
+        mfu_free(&sc.pending);
+        mfu_free(&sc.buf);
+        mfu_free(&sc.zeros);
+        return MFU_SUCCESS;
     }
 
-    return algo;
-}
+    /* send the headers we saved to the process that found the first header
+     * of their entry, as chain index, length, and bytes of each header */
+    mfu_exchange ex;
+    mfu_exchange_init(&ex, MPI_COMM_WORLD);
+    uint64_t entries = 0;
+    uint64_t c = 0;
+    while (c < chain_len) {
+        uint64_t first = c;
+        while (DTAR_header_type_ext(info[chain[c]].type)) {
+            c++;
+        }
+        c++;
+
+        int dest = (int) info[chain[first]].rank;
+        uint64_t k;
+        for (k = first; k < c; k++) {
+            const DTAR_header_info_t* h = &info[chain[k]];
+            if (h->rank != (uint64_t) rank) {
+                continue;
+            }
+            const DTAR_header_t* saved = &sc.headers[h->index];
+            mfu_exchange_pack_u64(&ex, dest, k);
+            mfu_exchange_pack_u64(&ex, dest, saved->length);
+            mfu_exchange_pack(&ex, dest, sc.buf + saved->saved, (size_t) saved->length);
+        }
+        entries++;
+    }
+    size_t recv_size;
+    char* recv = mfu_exchange_all(&ex, &recv_size);
+
+    mfu_free(&sc.headers);
+    mfu_free(&sc.pending);
+    mfu_free(&sc.buf);
+    mfu_free(&sc.zeros);
+
+    /* find each header we received by its chain index */
+    char** parts = (char**) MFU_MALLOC(chain_len * sizeof(char*) + 1);
+    uint64_t* part_lengths = (uint64_t*) MFU_MALLOC(chain_len * sizeof(uint64_t) + 1);
+    memset(parts, 0, chain_len * sizeof(char*));
+    size_t off = 0;
+    while (off < recv_size) {
+        uint64_t k, length;
+        memcpy(&k,      recv + off,                    sizeof(uint64_t));
+        memcpy(&length, recv + off + sizeof(uint64_t), sizeof(uint64_t));
+        off += 2 * sizeof(uint64_t);
+        parts[k]        = recv + off;
+        part_lengths[k] = length;
+        off += (size_t) length;
+    }
+
+    /* parse the entries whose first header we found */
+    mfu_path* cwd = mfu_path_from_str(cwdpath->path);
+    size_t hdr_max = 4 * 512;
+    char* hdr = (char*) MFU_MALLOC(hdr_max);
+    c = 0;
+    while (c < chain_len && rc == MFU_SUCCESS) {
+        uint64_t first = c;
+        while (DTAR_header_type_ext(info[chain[c]].type)) {
+            c++;
+        }
+        c++;
 
-/* return a file list of just the directories */
-static mfu_flist flist_get_dirs(mfu_flist flist)
-{
-    /* create a subset list to copy items into */
-    mfu_flist flist_dirs = mfu_flist_subset(flist);
+        if (info[chain[first]].rank != (uint64_t) rank) {
+            continue;
+        }
 
-    /* iterate over items in our list and copy each directory */
-    uint64_t idx;
-    uint64_t size = mfu_flist_size(flist);
-    for (idx = 0; idx < size; idx++) {
-        /* if item is a directory, copy it to the directory list */
-        mfu_filetype type = mfu_flist_file_get_type(flist, idx);
-        if (type == MFU_TYPE_DIR) {
-            mfu_flist_file_copy(flist, idx, flist_dirs);
+        /* the headers of an entry are contiguous in the stream */
+        size_t hdr_len = 0;
+        uint64_t k;
+        for (k = first; k < c; k++) {
+            size_t length = (size_t) part_lengths[k];
+            if (hdr_len + length > hdr_max) {
+                while (hdr_len + length > hdr_max) {
+                    hdr_max *= 2;
+                }
+                hdr = (char*) DTAR_realloc(hdr, hdr_max);
+            }
+            memcpy(hdr + hdr_len, parts[k], length);
+            hdr_len += length;
         }
+
+        uint64_t offset = info[chain[first]].offset;
+        rc = DTAR_entries_add(e, s->filename, hdr, hdr_len, offset, cwd, opts);
     }
 
-    /* finalize the directory list */
-    mfu_flist_summarize(flist_dirs);
+    mfu_free(&hdr);
+    mfu_path_delete(&cwd);
+    mfu_free(&part_lengths);
+    mfu_free(&parts);
+    mfu_free(&recv);
+    mfu_free(&chain);
+    mfu_free(&info);
 
-    return flist_dirs;
+    return DTAR_entries_finish(e, entries, opts, rc);
 }
 
-/* given an archive file name, extract items into cwdpath according to options */
-int mfu_flist_archive_extract(
-    const char* filename,          /* name of archive file */
-    const mfu_param_path* cwdpath, /* path to prepend to entries in archive to build full path */
-    mfu_archive_opts_t* opts)      /* options to configure extract operation */
+/* create the symlinks and set the xattrs recorded
+ * in the headers we saved for our entries */
+static int DTAR_entries_apply_headers(
+    const DTAR_entries_t* e,
+    const mfu_archive_opts_t* opts)
 {
     int rc = MFU_SUCCESS;
 
-    int ranks;
-    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
-
-    /* start overall timer */
-    MPI_Barrier(MPI_COMM_WORLD);
-    time_t time_started;
-    time(&time_started);
-    double wtime_started = MPI_Wtime();
-
-    /* indicate to user what phase we're in */
+    /* count symlinks to let the user know what we're doing */
+    uint64_t count = 0;
+    uint64_t idx;
+    for (idx = 0; idx < e->count; idx++) {
+        if (mfu_flist_file_get_type(e->flist, idx) == MFU_TYPE_LINK) {
+            count++;
+        }
+    }
+    uint64_t all_count;
+    MPI_Allreduce(&count, &all_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
     if (mfu_rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Extracting %s", filename);
+        if (all_count > 0) {
+            MFU_LOG(MFU_LOG_INFO, "Creating %llu symlinks", (unsigned long long) all_count);
+        }
+        if (opts->preserve_xattrs) {
+            MFU_LOG(MFU_LOG_INFO, "Extracting xattrs");
+        }
     }
 
-    /* get extraction algorithm */
-    mfu_flist_archive_extract_algo algo = select_extract_algo();
+    for (idx = 0; idx < e->count; idx++) {
+        if (e->hdr_offsets[idx] == UINT64_MAX) {
+            continue;
+        }
 
-    /* configure flags for libarchive based on archive options */
-    int flags = 0;
-    if (opts->preserve_times) {
-        flags |= ARCHIVE_EXTRACT_TIME;
-    }
-    if (opts->preserve_owner) {
-        flags |= ARCHIVE_EXTRACT_OWNER;
-    }
-    if (opts->preserve_permissions) {
-        flags |= ARCHIVE_EXTRACT_PERM;
-    }
-    if (opts->preserve_xattrs) {
-        flags |= ARCHIVE_EXTRACT_XATTR;
-    }
-    if (opts->preserve_acls) {
-        flags |= ARCHIVE_EXTRACT_ACL;
-    }
-    if (opts->preserve_fflags) {
-        flags |= ARCHIVE_EXTRACT_FFLAGS;
-    }
+        const char* name = mfu_flist_file_get_name(e->flist, idx);
+        const char* hdr = e->hdrs + e->hdr_offsets[idx];
+        size_t hdr_len = (size_t) e->hdr_lengths[idx];
 
-    /* turn on no overwrite so that directories we create are deleted and then replaced */
-    //archive_opts.flags |= ARCHIVE_EXTRACT_NO_OVERWRITE;
+        struct archive* a = archive_read_new();
+        archive_read_support_format_tar(a);
+        struct archive_entry* entry;
+        if (archive_read_open_memory(a, (void*) hdr, hdr_len) != ARCHIVE_OK ||
+            archive_read_next_header(a, &entry) != ARCHIVE_OK)
+        {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read header of `%s' %s",
+                name, archive_error_string(a));
+            archive_read_close(a);
+            archive_read_free(a);
+            rc = MFU_FAILURE;
+            continue;
+        }
 
-    /* configure behavior when creating items (overwrite, lustre striping, etc) */
-    mfu_create_opts_t* create_opts = mfu_create_opts_new();
+        /* create the link on the file system */
+        if (S_ISLNK(archive_entry_mode(entry))) {
+            const char* target = archive_entry_symlink(entry);
+            if (target == NULL) {
+                MFU_LOG(MFU_LOG_ERR, "Item is not a symlink as expected `%s'", name);
+                rc = MFU_FAILURE;
+            } else {
+                int symlink_rc = mfu_symlink(target, name);
+                if (symlink_rc != 0 && errno == EEXIST) {
+                    /* failed because something exists,
+                     * attempt to delete item and try again */
+                    mfu_unlink(name);
+                    symlink_rc = mfu_symlink(target, name);
+                }
+                if (symlink_rc != 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to set symlink `%s' (errno=%d %s)",
+                        name, errno, strerror(errno));
+                    rc = MFU_FAILURE;
+                }
+            }
+        }
 
-    /* overwrite any existing files by default */
-    create_opts->overwrite = true;
+        /* copy xattrs from entry to item */
+        int num = archive_entry_xattr_count(entry);
+        if (opts->preserve_xattrs && num > 0) {
+            int i;
+            archive_entry_xattr_reset(entry);
+            for (i = 0; i < num; i++) {
+                const char* xname = NULL;
+                const void* xval  = NULL;
+                size_t xsize = 0;
+                if (archive_entry_xattr_next(entry, &xname, &xval, &xsize) != ARCHIVE_OK) {
+                    MFU_LOG(MFU_LOG_ERR, "failed to extract xattr for '%s'", name);
+                    rc = MFU_FAILURE;
+                    continue;
+                }
+                if (mfu_lsetxattr(name, xname, xval, xsize, 0) != 0) {
+                    MFU_LOG(MFU_LOG_ERR, "failed to setxattr '%s' on '%s' errno=%d %s",
+                        xname, name, errno, strerror(errno));
+                    rc = MFU_FAILURE;
+                }
+            }
+        }
 
-    /* Set timestamps and permission bits on extracted items by default.
-     * We don't set uid/gid, since the tarball may have encoded uid/gid
-     * from another user. */
-    create_opts->set_owner       = opts->preserve_owner;
-    create_opts->set_timestamps  = opts->preserve_times;
-    create_opts->set_permissions = opts->preserve_permissions;
+        archive_read_close(a);
+        archive_read_free(a);
+    }
 
-    /* TODO: set these based on either auto-detection that CWD is lustre
-     * or directives from user */
-    create_opts->lustre_stripe         = false;
-    create_opts->lustre_stripe_width   = opts->chunk_size;
-    create_opts->lustre_stripe_minsize = 1024ULL * 1024ULL * 1024ULL;
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
+        rc = MFU_FAILURE;
+    }
+    return rc;
+}
 
-    /* get number of entries in archive */
-    bool have_offsets = false; /* whether we found offsets for the entries */
-    bool have_index   = false; /* whether we have an index file */
-    uint64_t entries  = 0;     /* number of entries */
-    uint64_t* offsets = NULL;  /* byte offset within archive for each entry */
-    if (algo != LIBARCHIVE) {
-        /* optimistically assume we'll get offsets from and index file */
-        have_offsets = true;
-        have_index   = true;
+/* compare pieces by their offset in the stream */
+static int DTAR_piece_cmp(const void* a, const void* b)
+{
+    const DTAR_piece_t* pa = *(const DTAR_piece_t* const*) a;
+    const DTAR_piece_t* pb = *(const DTAR_piece_t* const*) b;
+    if (pa->offset < pb->offset) {
+        return -1;
+    }
+    if (pa->offset > pb->offset) {
+        return 1;
+    }
+    return 0;
+}
 
-        /* attempt to read offsets from our index if we can find it */
-        int ret = read_entry_index(filename, &entries, &offsets);
-        if (ret != MFU_SUCCESS) {
-            /* don't have an index file */
-            have_index = false;
+/* write the len bytes in buf, which start at offset pos of the stream,
+ * to the files of the pieces they cover, pieces are sorted by offset,
+ * and first is the index of the first piece that may still need bytes */
+static int DTAR_pieces_write(
+    DTAR_piece_t** pieces,
+    uint64_t count,
+    uint64_t* first,
+    uint64_t pos,
+    const char* buf,
+    uint64_t len,
+    const mfu_archive_opts_t* opts)
+{
+    uint64_t end = pos + len;
 
-            /* Next best option is to scan the archive
-             * and see if we can extract entry offsets. */
-            mfu_flist_archive_scan_algo scan_algo = select_scan_algo();
-            if (scan_algo == SCAN_LINEAR || scan_algo == SCAN_PARALLEL) {
-                /* Read the full archive and execute the scan in memory. */
-                ret = index_entries_distread(filename, opts, scan_algo, &entries, &offsets);
-            } else {
-                /* Fall back to scan archive with a single process */
-                ret = index_entries(filename, &entries, &offsets);
-            }
-            if (ret != MFU_SUCCESS) {
-                /* failed to get entry offsets,
-                 * perhaps we have a compressed archive? */
-                have_offsets = false;
-            }
-        }
+    /* skip pieces that end before buf starts */
+    while (*first < count && pieces[*first]->offset + pieces[*first]->length <= pos) {
+        (*first)++;
     }
 
-    /* bail out if user requested an algorithm that requires offsets
-     * but we don't have them */
-    if ((algo == LIBARCHIVE_IDX ||
-         algo == CHUNK          ||
-         algo == LIBCIRCLE        ) &&
-         !have_offsets)
-    {
-        if (mfu_rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "Selected archive extraction algorithm requires an index");
+    uint64_t i;
+    for (i = *first; i < count && pieces[i]->offset < end; i++) {
+        const DTAR_piece_t* p = pieces[i];
+        uint64_t start = (p->offset > pos) ? p->offset : pos;
+        uint64_t stop  = p->offset + p->length;
+        if (stop > end) {
+            stop = end;
         }
-        mfu_create_opts_delete(&create_opts);
-        return MFU_FAILURE;
-    }
 
-    /* to preserve ACLs and XATTRs, we need to extract with libarchive for now */
-    bool extract_with_libarchive = (opts->preserve_acls || opts->preserve_fflags);
-    if (extract_with_libarchive) {
-        /* if user requested a specific algorithm that is not compatibile,
-         * print and error and return with an error */
-        if (algo == CHUNK || algo == LIBCIRCLE) {
-            if (mfu_rank == 0) {
-                MFU_LOG(MFU_LOG_ERR, "To extract ACLs, one must extract with libarchive: LIBARCHIVE or LIBARCHIVE_IDX");
-            }
-            mfu_create_opts_delete(&create_opts);
+        /* for extraction, src_offset is the offset of the piece in its file */
+        const char* name = (const char*)p + sizeof(DTAR_piece_t);
+        if (mfu_archive_open_file(name, 0, opts->sync_on_close, 0, &mfu_archive_dst_cache) < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open destination file '%s' errno=%d %s",
+                name, errno, strerror(errno));
             return MFU_FAILURE;
         }
+        int fd = mfu_archive_dst_cache.fd;
 
-        /* force to an algorithm that extracts items with libarchive */
-        if (have_offsets) {
-            algo = LIBARCHIVE_IDX;
-        } else {
-            algo = LIBARCHIVE;
+        uint64_t done = 0;
+        while (start + done < stop) {
+            size_t bytes = (size_t)(stop - start - done);
+            off_t offset = (off_t)(p->src_offset + (start - p->offset) + done);
+            ssize_t nwritten = mfu_pwrite(name, fd, buf + (start - pos) + done, bytes, offset);
+            if (nwritten < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to write to destination file '%s' errno=%d %s",
+                    name, errno, strerror(errno));
+                return MFU_FAILURE;
+            }
+            done += (uint64_t) nwritten;
         }
+
+        /* update number of bytes we have written for progress messages */
+        reduce_buf[REDUCE_BYTES] += done;
+        mfu_progress_update(reduce_buf, extract_prog);
     }
 
-    /* divide entries among ranks */
-    uint64_t entry_start, entry_count;
-    mfu_get_start_count(mfu_rank, ranks, entries, &entry_start, &entry_count);
+    return MFU_SUCCESS;
+}
 
-    /* if we constructed an offset list by scanning the archive,
-     * save it to an index in case we need to extract again
-     * since scanning can be expensive */
-    if (have_offsets && !have_index) {
-        /* TODO: when encoding index as the last entry, we need to know the archive size,
-         * and we'll need to rewrite the two trailing 512-byte blocks */
-        //write_entry_index(filename, entry_count, &offsets[entry_start], opts, &archive_size);
-        write_entry_index(filename, entry_count, &offsets[entry_start], opts, NULL);
+/* pieces to write bytes decoded from a member to */
+typedef struct {
+    DTAR_piece_t** pieces;          /* pieces sorted by offset */
+    uint64_t count;                 /* number of pieces */
+    uint64_t first;                 /* first piece that may still need bytes */
+    const mfu_archive_opts_t* opts; /* options to open files */
+} DTAR_pieces_writer_t;
+
+/* write bytes decoded from a member to our pieces,
+ * and stop decoding once we have written the last one */
+static int DTAR_pieces_write_fn(uint64_t pos, const char* buf, size_t len, void* arg)
+{
+    DTAR_pieces_writer_t* w = (DTAR_pieces_writer_t*) arg;
+    if (DTAR_pieces_write(w->pieces, w->count, &w->first, pos, buf, (uint64_t) len, w->opts) != MFU_SUCCESS) {
+        return -1;
     }
-
-    /* extract metadata for items in archive and construct flist,
-     * also get offsets to start of data region for each entry */
-    int ret;
-    uint64_t* data_offsets = NULL;
-    mfu_flist flist = mfu_flist_new();
-    if (have_offsets) {
-        /* with offsets, we can directly seek to each entry to read its header */
-        ret = extract_flist_offsets(filename, cwdpath, entries, entry_start, entry_count, offsets, &data_offsets, flist);
-    } else {
-        /* don't have entry offsets, so scan archive from the start to build flist,
-         * assume we can't get data offsets in this case either */
-        ret = extract_flist(filename, cwdpath, flist);
+
+    const DTAR_piece_t* last = w->pieces[w->count - 1];
+    if (last->offset + last->length <= pos + (uint64_t) len) {
+        return 1;
     }
-    if (ret != MFU_SUCCESS) {
-        /* fatal error if we failed to build the flist */
-        if (mfu_rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to extract metadata");
+    return 0;
+}
+
+/* decode segment seg of the stream and write its bytes to the
+ * count pieces that need them, which are sorted by offset */
+static int DTAR_stream_decode(
+    DTAR_stream_t* s,
+    uint64_t seg,
+    DTAR_piece_t** pieces,
+    uint64_t count,
+    const mfu_archive_opts_t* opts)
+{
+    /* decode a member only as far as our last piece */
+    if (s->members != NULL) {
+        const DTAR_members_t* members = s->members;
+        DTAR_pieces_writer_t w;
+        w.pieces = pieces;
+        w.count  = count;
+        w.first  = 0;
+        w.opts   = opts;
+
+        uint64_t length, usize;
+        int rc = DTAR_member_decode(s->filename, s->fd, s->file_size, members->type,
+            members->offsets[seg], members->uoffsets[seg], DTAR_pieces_write_fn, &w,
+            s->comp_buf, s->buf, s->bufsize, false, &length, &usize);
+        const DTAR_piece_t* last = pieces[count - 1];
+        if (rc == MFU_SUCCESS && members->uoffsets[seg] + usize < last->offset + last->length) {
+            MFU_LOG(MFU_LOG_ERR, "Member at offset %llu of archive '%s' changed while decoding",
+                (unsigned long long) members->offsets[seg], s->filename);
+            rc = MFU_FAILURE;
         }
-        mfu_create_opts_delete(&create_opts);
-        mfu_flist_free(&flist);
-        mfu_free(&data_offsets);
-        mfu_free(&offsets);
+        return rc;
+    }
+
+    int64_t len = DTAR_frame_read(s->filename, s->fd, s->frames, seg, s->buf, s->comp_buf);
+    if (len < 0) {
         return MFU_FAILURE;
     }
 
-    /* sum up bytes and items in list for tracking progress */
-    DTAR_total_bytes = flist_sum_bytes(flist);
-    DTAR_total_items = mfu_flist_global_size(flist);
+    uint64_t first = 0;
+    uint64_t start = seg * s->frames->frame_size;
+    return DTAR_pieces_write(pieces, count, &first, start, s->buf, (uint64_t) len, opts);
+}
 
-    /* print summary of what's in archive before extracting items */
-    mfu_flist_print_summary(flist);
+/* extract the data of the regular files in our entries, the data of each
+ * file is split into pieces at segment boundaries, and each piece is sent
+ * to the process that decodes its segment and writes it to the file */
+static int DTAR_stream_extract_data(
+    DTAR_stream_t* s,
+    const DTAR_entries_t* e,
+    const mfu_archive_opts_t* opts)
+{
+    int rc = MFU_SUCCESS;
 
-    /* Create all directories in advance to avoid races between a process trying to create
-     * a child item and another process responsible for the parent directory.
-     * The libarchive code does not remove existing directories,
-     * even in normal mode with overwrite. */
-    mfu_flist_mkdir(flist, create_opts);
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Extracting file data");
+    }
 
-    /* extract files from archive */
-    if (have_offsets) {
-        /* if we have offsets, we can jump to the start of each entry
-         * rather than having to scan from the start of the archive */
-        if (algo == LIBARCHIVE_IDX) {
-            /* in this case we use libarchve to read entries from the archive
-             * and write them to disk, though we can use offsets to seek to
-             * the start of each entry */
-            ret = extract_files_offsets_libarchive(filename, flags,
-                entries, entry_start, entry_count, offsets, flist, opts);
-        } else {
-            /* in this case, we'll use an mfu chunk list to distribute work
-             * to processes and read/write from the archive directly */
+    /* split the data of our files at segment boundaries */
+    DTAR_pieces_t list;
+    memset(&list, 0, sizeof(list));
+    uint64_t idx;
+    for (idx = 0; idx < e->count; idx++) {
+        mfu_filetype type = mfu_flist_file_get_type(e->flist, idx);
+        uint64_t size = mfu_flist_file_get_size(e->flist, idx);
+        if (type != MFU_TYPE_FILE || size == 0) {
+            continue;
+        }
 
-            /* since more than one process may write to the same file,
-             * create the files in advance */
-            mfu_flist_mknod(flist, create_opts);
+        const char* name = mfu_flist_file_get_name(e->flist, idx);
+        uint64_t start = e->data_offsets[idx];
+        if (start > s->size || size > s->size - start) {
+            MFU_LOG(MFU_LOG_ERR, "Data of `%s' extends past the end of archive '%s'",
+                name, s->filename);
+            rc = MFU_FAILURE;
+            continue;
+        }
 
-            /* create symlinks */
-            int tmp_rc = extract_symlinks(filename, flist, offsets, opts);
-            if (tmp_rc != MFU_SUCCESS) {
-                /* tried but failed to get some symlink, so mark as failure */
-                ret = tmp_rc;
+        uint64_t end = start + size;
+        uint64_t pos = start;
+        while (pos < end) {
+            uint64_t seg = DTAR_stream_segment(s, pos);
+            uint64_t seg_end = DTAR_stream_segment_end(s, seg);
+            if (seg_end > end) {
+                seg_end = end;
             }
+            DTAR_pieces_add(&list, seg, pos, seg_end - pos, DTAR_PIECE_DATA, pos - start,
+                name, strlen(name) + 1);
+            pos = seg_end;
+        }
+    }
 
-            /* copy xattrs if needed, we do this before writing file data
-             * since some file systems encode data layout properties in xattrs
-             * and those must be defined before writing any data */
-            if (opts->preserve_xattrs) {
-                /* read xattrs from archive and apply to files */
-                tmp_rc = extract_xattrs(filename, cwdpath, flags,
-                    entries, entry_start, entry_count, offsets, flist, opts);
-                if (tmp_rc != MFU_SUCCESS) {
-                    /* failed to copy xattrs, so mark as failure */
-                    ret = tmp_rc;
-                }
-            }
+    /* send pieces to the processes decoding their segments */
+    size_t recv_size;
+    char* recv = DTAR_pieces_exchange(&list, &recv_size);
+    free(list.buf);
 
-            /* extract file data from archive */
-            if (algo == CHUNK) {
-                ret = extract_files_offsets_chunk(filename, flags,
-                    entries, entry_start, entry_count, data_offsets, flist, opts);
-            } else { /* LIBCIRCLE or DEFAULT */
-                ret = extract_files_offsets_chunk_libcircle(filename, flags,
-                    entries, entry_start, entry_count, data_offsets, flist, opts);
-            }
+    /* sort the pieces we got by offset, which groups them by segment */
+    uint64_t count = 0;
+    size_t pos = 0;
+    while (pos < recv_size) {
+        const DTAR_piece_t* p = (const DTAR_piece_t*)(recv + pos);
+        pos += sizeof(DTAR_piece_t) + (size_t) p->extra;
+        count++;
+    }
+    DTAR_piece_t** pieces = (DTAR_piece_t**) MFU_MALLOC(count * sizeof(DTAR_piece_t*) + 1);
+    count = 0;
+    pos = 0;
+    while (pos < recv_size) {
+        DTAR_piece_t* p = (DTAR_piece_t*)(recv + pos);
+        pos += sizeof(DTAR_piece_t) + (size_t) p->extra;
+        pieces[count] = p;
+        count++;
+    }
+    qsort(pieces, (size_t) count, sizeof(DTAR_piece_t*), DTAR_piece_cmp);
 
-            /* set timestamps and permissions on everything */
-            MPI_Barrier(MPI_COMM_WORLD);
-            if (mfu_rank == 0) {
-                MFU_LOG(MFU_LOG_INFO, "Updating timestamps and permissions");
-            }
-            mfu_flist_metadata_apply(flist, create_opts);
+    /* initialize counters to track number of bytes extracted */
+    reduce_buf[REDUCE_BYTES] = 0;
+    reduce_buf[REDUCE_ITEMS] = mfu_flist_size(e->flist);
+
+    /* start progress messages, we track bytes accurately but not items */
+    extract_prog = mfu_progress_start(mfu_progress_timeout, 1, MPI_COMM_WORLD, extract1_progress_fn);
+
+    /* decode each segment that has pieces once */
+    uint64_t i = 0;
+    while (i < count && rc == MFU_SUCCESS) {
+        uint64_t n = i;
+        while (n < count && pieces[n]->frame == pieces[i]->frame) {
+            n++;
         }
-    } else {
-        /* If we don't have offsets, have each process read the archive from the start.
-         * We use libarchive to read/write entries, which allows us to deal with compressed
-         * archives and those with things like global headers. */ 
-        ret = extract_files(filename, flags,
-            entries, entry_start, entry_count, flist, opts);
+        rc = DTAR_stream_decode(s, pieces[i]->frame, &pieces[i], n - i, opts);
+        i = n;
     }
-    if (ret != MFU_SUCCESS) {
-        /* set return code if we failed to extract items */
-        if (mfu_rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "Failed to extract all items");
-        }
+
+    /* finalize progress messages */
+    mfu_progress_complete(reduce_buf, &extract_prog);
+
+    mfu_archive_close_file(&mfu_archive_dst_cache);
+
+    mfu_free(&pieces);
+    mfu_free(&recv);
+
+    if (! mfu_alltrue(rc == MFU_SUCCESS, MPI_COMM_WORLD)) {
         rc = MFU_FAILURE;
     }
+    return rc;
+}
 
-    /* If we extracted items with libarchive, we need to update timestamps on
-     * any directories.  This is because we created all directories in advance
-     * and libarchive does not set timestamps on directories if they already exist. */
-    int extracted_with_libarchive = (!have_offsets || algo == LIBARCHIVE_IDX);
-    if (extracted_with_libarchive) {
-        /* first ensure all procs are done writing their items */
-        MPI_Barrier(MPI_COMM_WORLD);
-        if (mfu_rank == 0) {
-            MFU_LOG(MFU_LOG_INFO, "Updating timestamps and permissions");
-        }
-
-        /* create a file list of just the directories */
-        mfu_flist flist_dirs = flist_get_dirs(flist);
+/* list or extract the entries of a compressed archive whose headers
+ * each process has read into e, the data of regular files is decoded
+ * from the segments of the stream */
+static int extract_stream(
+    DTAR_stream_t* s,
+    const mfu_param_path* cwdpath,
+    DTAR_entries_t* e,
+    mfu_archive_opts_t* opts)
+{
+    int rc = MFU_SUCCESS;
 
-        /* set timestamps on the directories, do this after writing all items
-         * since creating items in a directory will have changed its timestamp */
-        mfu_flist_metadata_apply(flist_dirs, create_opts);
+    mfu_flist flist = e->flist;
 
-        /* free the list of directories */
-        mfu_flist_free(&flist_dirs);
+    /* to list entries, we just need their headers */
+    if (opts->list) {
+        print_entries(flist, cwdpath);
+        return MFU_SUCCESS;
     }
 
-    /* free options structure needed for create calls */
-    mfu_create_opts_delete(&create_opts);
+    /* configure behavior when creating items */
+    mfu_create_opts_t* create_opts = extract_create_opts_new(opts);
 
-    /* we can now free our file list */
-    mfu_flist_free(&flist);
+    /* sum up bytes and items in list for tracking progress */
+    DTAR_total_bytes = flist_sum_bytes(flist);
+    DTAR_total_items = mfu_flist_global_size(flist);
 
-    /* free offset arrays */
-    mfu_free(&data_offsets);
-    mfu_free(&offsets);
+    /* print summary of what's in archive before extracting items */
+    mfu_flist_print_summary(flist);
 
-    /* wait for all to finish */
+    /* create all directories in advance, and then the files,
+     * since more than one process may write to a file */
+    if (opts->member_count > 0) {
+        create_parent_dirs(flist, cwdpath);
+    }
+    mfu_flist_mkdir(flist, create_opts);
+    mfu_flist_mknod(flist, create_opts);
+
+    /* create symlinks and set xattrs, we do this before writing file data
+     * since some file systems encode data layout properties in xattrs */
+    if (DTAR_entries_apply_headers(e, opts) != MFU_SUCCESS) {
+        rc = MFU_FAILURE;
+    }
+
+    /* extract file data from the segments that hold it */
+    if (DTAR_stream_extract_data(s, e, opts) != MFU_SUCCESS) {
+        rc = MFU_FAILURE;
+    }
+
+    /* set timestamps and permissions on everything */
     MPI_Barrier(MPI_COMM_WORLD);
+    if (mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Updating timestamps and permissions");
+    }
+    mfu_flist_metadata_apply(flist, create_opts);
 
-    /* stop overall timer */
-    time_t time_ended;
-    time(&time_ended);
-    double wtime_ended = MPI_Wtime();
+    if (rc != MFU_SUCCESS && mfu_rank == 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to extract all items");
+    }
 
-    /* prep our values into buffer */
-    int64_t values[2];
-    values[0] = reduce_buf[REDUCE_ITEMS];
-    values[1] = reduce_buf[REDUCE_BYTES];
+    mfu_create_opts_delete(&create_opts);
+    return rc;
+}
 
-    /* sum values across processes */
-    int64_t sums[2];
-    MPI_Allreduce(values, sums, 2, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+/* list or extract a compressed archive that is split into frames
+ * or members, without writing its uncompressed stream anywhere */
+static int extract_compressed(
+    const char* filename,
+    const mfu_param_path* cwdpath,
+    const DTAR_frames_t* frames,   /* frame index of archive, or NULL */
+    const DTAR_members_t* members, /* member list of archive, or NULL */
+    mfu_archive_opts_t* opts)
+{
+    /* start overall timer */
+    MPI_Barrier(MPI_COMM_WORLD);
+    time_t time_started;
+    time(&time_started);
+    double wtime_started = MPI_Wtime();
 
-    /* extract results from allreduce */
-    int64_t agg_items = sums[0];
-    int64_t agg_bytes = sums[1];
+    if (mfu_rank == 0) {
+        if (opts->list) {
+            MFU_LOG(MFU_LOG_INFO, "Listing %s", filename);
+        } else {
+            MFU_LOG(MFU_LOG_INFO, "Extracting %s", filename);
+        }
+    }
 
-    /* compute number of seconds */
-    double secs = wtime_ended - wtime_started;
+    DTAR_stream_t s;
+    int rc = DTAR_stream_open(&s, filename, frames, members, opts);
+    if (rc != MFU_SUCCESS) {
+        return rc;
+    }
 
-    /* compute rate of copy */
-    double agg_bw = (double)agg_bytes / secs;
-    if (secs > 0.0) {
-        agg_bw = (double)agg_bytes / secs;
+    DTAR_entries_t e;
+    DTAR_entries_init(&e);
+    bool found = true;
+    if (frames != NULL) {
+        rc = DTAR_frames_entries(&s, cwdpath, opts, &e);
+    } else {
+        rc = DTAR_members_entries(&s, cwdpath, opts, &e, &found);
+    }
+    if (rc == MFU_SUCCESS && found) {
+        rc = extract_stream(&s, cwdpath, &e, opts);
+        if (! opts->list) {
+            print_extract_stats(time_started, wtime_started);
+        }
     }
 
-    if(mfu_rank == 0) {
-        /* format start time */
-        char starttime_str[256];
-        struct tm* localstart = localtime(&time_started);
-        strftime(starttime_str, 256, "%b-%d-%Y, %H:%M:%S", localstart);
+    DTAR_entries_free(&e);
+    DTAR_stream_close(&s);
 
-        /* format end time */
-        char endtime_str[256];
-        struct tm* localend = localtime(&time_ended);
-        strftime(endtime_str, 256, "%b-%d-%Y, %H:%M:%S", localend);
+    /* if we could not follow the headers through the members,
+     * read the archive from the start */
+    if (rc == MFU_SUCCESS && !found) {
+        rc = extract_archive(filename, cwdpath, opts);
+    }
 
-        /* convert size to units */
-        double agg_bytes_val;
-        const char* agg_bytes_units;
-        mfu_format_bytes((uint64_t)agg_bytes, &agg_bytes_val, &agg_bytes_units);
+    return rc;
+}
 
-        /* convert bandwidth to units */
-        double agg_bw_val;
-        const char* agg_bw_units;
-        mfu_format_bw(agg_bw, &agg_bw_val, &agg_bw_units);
+/* given an archive file name, extract items into cwdpath according to options */
+int mfu_flist_archive_extract(
+    const char* filename,          /* name of archive file */
+    const mfu_param_path* cwdpath, /* path to prepend to entries in archive to build full path */
+    mfu_archive_opts_t* opts)      /* options to configure extract operation */
+{
+    /* ACLs and file flags are only applied when libarchive writes
+     * the items, which reads a compressed archive from the start */
+    if ((opts->preserve_acls || opts->preserve_fflags) && !opts->list) {
+        return extract_archive(filename, cwdpath, opts);
+    }
+
+    /* a compressed archive written with --compress is decoded in
+     * parallel, one frame at a time, using its frame index */
+    DTAR_frames_t frames;
+    if (DTAR_frames_read(filename, &frames) == MFU_SUCCESS) {
+        int rc = extract_compressed(filename, cwdpath, &frames, NULL, opts);
+        DTAR_frames_free(&frames);
+        return rc;
+    }
 
-        MFU_LOG(MFU_LOG_INFO, "Started:   %s", starttime_str);
-        MFU_LOG(MFU_LOG_INFO, "Completed: %s", endtime_str);
-        MFU_LOG(MFU_LOG_INFO, "Seconds: %.3lf", secs);
-        MFU_LOG(MFU_LOG_INFO, "Items: %" PRId64, agg_items);
-        MFU_LOG(MFU_LOG_INFO,
-            "Data: %.3lf %s (%" PRId64 " bytes)",
-            agg_bytes_val, agg_bytes_units, agg_bytes
-        );
-        MFU_LOG(MFU_LOG_INFO,
-            "Rate: %.3lf %s (%.3" PRId64 " bytes in %.3lf seconds)",
-            agg_bw_val, agg_bw_units, agg_bytes, secs
-        );
+    /* other compressed archives can be decoded in parallel
+     * if they consist of many independent members */
+    DTAR_members_t members;
+    if (DTAR_members_scan(filename, opts, &members) == MFU_SUCCESS) {
+        int rc = extract_compressed(filename, cwdpath, NULL, &members, opts);
+        DTAR_members_free(&members);
+        return rc;
     }
 
-    return rc;
+    return extract_archive(filename, cwdpath, opts);
 }
 
 /* return a newly allocated archive_opts structure, set default values on its fields */
@@ -5796,6 +9954,21 @@ mfu_archive_opts_t* mfu_archive_opts_new(void)
     /* max size for an entry header */
     opts->header_size = 16ULL * 1024ULL * 1024ULL;
 
+    /* whether to write a compressed archive */
+    opts->compress = false;
+
+    /* whether to add items to an existing archive rather than replace it,
+     * and if so, whether to also add items that changed since archived */
+    opts->append = false;
+    opts->update = false;
+
+    /* whether to list entries rather than extract them */
+    opts->list = false;
+
+    /* patterns to select entries to be listed or extracted, all if none */
+    opts->member_count = 0;
+    opts->members      = NULL;
+
     /* whether to use libcircle (1) vs a static chunk list (0) when creating an archive */
     opts->create_libcircle   = 0;
 
@@ -5813,6 +9986,12 @@ void mfu_archive_opts_delete(mfu_archive_opts_t** popts)
     /* free fields allocated on opts */
     if (opts != NULL) {
       mfu_free(&opts->dest_path);
+
+      uint64_t i;
+      for (i = 0; i < opts->member_count; i++) {
+        mfu_free(&opts->members[i]);
+      }
+      mfu_free(&opts->members);
     }
 
     mfu_free(popts);
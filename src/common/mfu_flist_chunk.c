@@ -1,12 +1,20 @@
+/* for O_NOATIME */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 
 #include <string.h>
 
+#include <openssl/sha.h>
+
 #include "libcircle.h"
 #include "dtcmp.h"
 #include "mfu.h"
+#include "mfu_flist_internal.h"
 
 /****************************************
  * Functions to divide flist into linked list of file sections
@@ -620,3 +628,653 @@ void mfu_file_chunk_list_lor(mfu_flist list, const mfu_file_chunk* head, const i
 
     return;
 }
+
+/* version of the cached digest format */
+#define MFU_DIGEST_XATTR_VERSION (3)
+
+/* number of uint64_t values in header of cached digests:
+ * version, chunk size, file size, mtime, mtime nsecs, ctime,
+ * ctime nsecs, inode, chunk count */
+#define MFU_DIGEST_XATTR_HDR (9)
+
+/* largest xattr value we'll attempt to store */
+#define MFU_DIGEST_XATTR_MAX (65536)
+
+/* setting the xattr changes the ctime of the file, so the cache records
+ * the ctime the file had after a first store, and then accepts a ctime
+ * that is at most this many nanoseconds later to allow for the second
+ * store that writes the recorded value */
+#define MFU_DIGEST_CTIME_SLACK (1000000000ULL)
+
+/* values that identify the version of a file a digest was computed for */
+typedef struct {
+    uint64_t size;
+    uint64_t mtime;
+    uint64_t mtime_nsec;
+    uint64_t ctime;
+    uint64_t ctime_nsec;
+    uint64_t ino;
+} mfu_digest_tuple_t;
+
+/* digest of one chunk of a file, sent to the rank that owns the
+ * file so that it can store digests of all chunks in the cache */
+typedef struct {
+    uint64_t index;           /* index of file in list on its owner */
+    uint64_t chunk;           /* chunk number within file */
+    mfu_digest_tuple_t tuple; /* identity of file when chunk was read */
+    uint64_t cached;          /* whether digest was taken from the cache */
+    unsigned char digest[MFU_CHUNK_DIGEST_SIZE];
+} mfu_digest_record_t;
+
+/* get identity of file, returns 0 on success */
+static int digest_tuple_get(const char* name, mfu_digest_tuple_t* tuple, mfu_file_t* mfu_file)
+{
+    struct stat st;
+    if (mfu_file_lstat(name, &st, mfu_file) != 0) {
+        return -1;
+    }
+
+    uint64_t secs, nsecs;
+    mfu_stat_get_mtimes(&st, &secs, &nsecs);
+    tuple->mtime      = secs;
+    tuple->mtime_nsec = nsecs;
+
+    mfu_stat_get_ctimes(&st, &secs, &nsecs);
+    tuple->ctime      = secs;
+    tuple->ctime_nsec = nsecs;
+
+    tuple->size       = (uint64_t) st.st_size;
+    tuple->ino        = (uint64_t) st.st_ino;
+    return 0;
+}
+
+static int digest_tuple_equal(const mfu_digest_tuple_t* a, const mfu_digest_tuple_t* b)
+{
+    return (a->size       == b->size &&
+            a->mtime      == b->mtime &&
+            a->mtime_nsec == b->mtime_nsec &&
+            a->ctime      == b->ctime &&
+            a->ctime_nsec == b->ctime_nsec &&
+            a->ino        == b->ino);
+}
+
+/* whether a file with identity tuple is the version that a cache
+ * recorded as cached, a write or a change of times, ownership, mode,
+ * or xattrs sets the ctime to the current time, so any change made
+ * after the cache was stored moves ctime past the slack */
+static int digest_tuple_cached(const mfu_digest_tuple_t* cached, const mfu_digest_tuple_t* tuple)
+{
+    uint64_t cached_ctime = cached->ctime * 1000000000ULL + cached->ctime_nsec;
+    uint64_t ctime        = tuple->ctime  * 1000000000ULL + tuple->ctime_nsec;
+    return (cached->size       == tuple->size &&
+            cached->mtime      == tuple->mtime &&
+            cached->mtime_nsec == tuple->mtime_nsec &&
+            cached->ino        == tuple->ino &&
+            ctime >= cached_ctime &&
+            ctime - cached_ctime <= MFU_DIGEST_CTIME_SLACK);
+}
+
+/* pack the cached digest header for a file into buf,
+ * returns pointer to where digests should be written */
+static char* digest_cache_pack(
+    char* buf,
+    uint64_t chunk_size,
+    const mfu_digest_tuple_t* tuple,
+    uint64_t count)
+{
+    char* ptr = buf;
+    mfu_pack_uint64(&ptr, MFU_DIGEST_XATTR_VERSION);
+    mfu_pack_uint64(&ptr, chunk_size);
+    mfu_pack_uint64(&ptr, tuple->size);
+    mfu_pack_uint64(&ptr, tuple->mtime);
+    mfu_pack_uint64(&ptr, tuple->mtime_nsec);
+    mfu_pack_uint64(&ptr, tuple->ctime);
+    mfu_pack_uint64(&ptr, tuple->ctime_nsec);
+    mfu_pack_uint64(&ptr, tuple->ino);
+    mfu_pack_uint64(&ptr, count);
+    return ptr;
+}
+
+/* read cached chunk digests of file into buf, which must hold
+ * MFU_DIGEST_XATTR_MAX bytes, returns the number of chunk digests,
+ * which start at *digests, or 0 if there is no valid cache for
+ * this version of the file */
+static uint64_t digest_cache_load(
+    const char* name,
+    const mfu_digest_tuple_t* tuple,
+    uint64_t chunk_size,
+    char* buf,
+    const unsigned char** digests,
+    mfu_file_t* mfu_file)
+{
+    ssize_t len = mfu_file_lgetxattr(name, MFU_DIGEST_XATTR, buf, MFU_DIGEST_XATTR_MAX, mfu_file);
+    size_t hdr_size = MFU_DIGEST_XATTR_HDR * sizeof(uint64_t);
+    if (len < (ssize_t) hdr_size) {
+        return 0;
+    }
+
+    uint64_t version, cached_chunk_size, count;
+    mfu_digest_tuple_t cached;
+    const char* ptr = buf;
+    mfu_unpack_uint64(&ptr, &version);
+    mfu_unpack_uint64(&ptr, &cached_chunk_size);
+    mfu_unpack_uint64(&ptr, &cached.size);
+    mfu_unpack_uint64(&ptr, &cached.mtime);
+    mfu_unpack_uint64(&ptr, &cached.mtime_nsec);
+    mfu_unpack_uint64(&ptr, &cached.ctime);
+    mfu_unpack_uint64(&ptr, &cached.ctime_nsec);
+    mfu_unpack_uint64(&ptr, &cached.ino);
+    mfu_unpack_uint64(&ptr, &count);
+
+    /* digests are only useful if they were computed for this
+     * version of the file using the same chunk size */
+    if (version != MFU_DIGEST_XATTR_VERSION ||
+        cached_chunk_size != chunk_size ||
+        ! digest_tuple_cached(&cached, tuple) ||
+        (size_t) len != hdr_size + count * MFU_CHUNK_DIGEST_SIZE)
+    {
+        return 0;
+    }
+
+    *digests = (const unsigned char*) ptr;
+    return count;
+}
+
+/* compare records by file index and then by chunk */
+static int digest_record_cmp(const void* a, const void* b)
+{
+    const mfu_digest_record_t* x = (const mfu_digest_record_t*) a;
+    const mfu_digest_record_t* y = (const mfu_digest_record_t*) b;
+    if (x->index != y->index) {
+        return (x->index < y->index) ? -1 : 1;
+    }
+    if (x->chunk != y->chunk) {
+        return (x->chunk < y->chunk) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* send chunk digests to the owner of each file, and have the owner
+ * store the digests of every file whose chunks were all read from the
+ * same version of the file as it has now */
+static void digest_cache_store(
+    mfu_flist list,
+    uint64_t chunk_size,
+    const mfu_digest_record_t* records,
+    const int* dests,
+    uint64_t count,
+    mfu_file_t* mfu_file)
+{
+    /* send records to the owner of each file */
+    uint64_t recv_count;
+    mfu_digest_record_t* recvbuf = (mfu_digest_record_t*) mfu_exchange_items(
+        records, dests, count, sizeof(mfu_digest_record_t), &recv_count, MPI_COMM_WORLD);
+
+    /* group records by file and order them by chunk */
+    qsort(recvbuf, (size_t)recv_count, sizeof(mfu_digest_record_t), digest_record_cmp);
+
+    size_t hdr_size = MFU_DIGEST_XATTR_HDR * sizeof(uint64_t);
+    char* value = (char*) MFU_MALLOC(MFU_DIGEST_XATTR_MAX);
+
+    uint64_t start = 0;
+    while (start < recv_count) {
+        /* find range of records for this file */
+        uint64_t index = recvbuf[start].index;
+        uint64_t end = start + 1;
+        while (end < recv_count && recvbuf[end].index == index) {
+            end++;
+        }
+
+        /* compute number of chunks in this file */
+        uint64_t file_size = mfu_flist_file_get_size(list, index);
+        uint64_t chunks = file_size / chunk_size;
+        if (chunks * chunk_size < file_size || file_size == 0) {
+            chunks++;
+        }
+
+        /* only store if we have every chunk, all read from the same version
+         * of the file, at least one of which was not already in the cache */
+        int store = (end - start == chunks &&
+                     hdr_size + chunks * MFU_CHUNK_DIGEST_SIZE <= MFU_DIGEST_XATTR_MAX);
+        int all_cached = 1;
+        uint64_t j;
+        for (j = start; j < end && store; j++) {
+            if (recvbuf[j].chunk != j - start ||
+                ! digest_tuple_equal(&recvbuf[j].tuple, &recvbuf[start].tuple))
+            {
+                store = 0;
+            }
+            if (! recvbuf[j].cached) {
+                all_cached = 0;
+            }
+        }
+
+        /* check that the file has not changed since it was read */
+        const char* name = mfu_flist_file_get_name(list, index);
+        mfu_digest_tuple_t tuple;
+        if (store && ! all_cached &&
+            digest_tuple_get(name, &tuple, mfu_file) == 0 &&
+            digest_tuple_equal(&tuple, &recvbuf[start].tuple))
+        {
+            /* store the digests, which sets the ctime of the file */
+            char* ptr = digest_cache_pack(value, chunk_size, &tuple, chunks);
+            for (j = start; j < end; j++) {
+                memcpy(ptr, recvbuf[j].digest, MFU_CHUNK_DIGEST_SIZE);
+                ptr += MFU_CHUNK_DIGEST_SIZE;
+            }
+            size_t value_size = (size_t)(ptr - value);
+
+            /* the cache is only an optimization, so ignore failures,
+             * e.g., from file systems that limit the size of xattrs */
+            int rc = mfu_file_lsetxattr(name, MFU_DIGEST_XATTR, value, value_size, 0, mfu_file);
+
+            /* then record the ctime that store left on the file,
+             * and store again in place with the same size */
+            mfu_digest_tuple_t stored;
+            if (rc == 0 && digest_tuple_get(name, &stored, mfu_file) == 0) {
+                tuple.ctime      = stored.ctime;
+                tuple.ctime_nsec = stored.ctime_nsec;
+                digest_cache_pack(value, chunk_size, &tuple, chunks);
+                rc = mfu_file_lsetxattr(name, MFU_DIGEST_XATTR, value, value_size, 0, mfu_file);
+            }
+            if (rc != 0) {
+                MFU_LOG(MFU_LOG_DBG, "Failed to store digests on `%s' (errno=%d %s)",
+                    name, errno, strerror(errno));
+            }
+        }
+
+        start = end;
+    }
+
+    mfu_free(&value);
+    mfu_free(&recvbuf);
+}
+
+void mfu_digest_cache_invalidate(const char* name, mfu_file_t* mfu_file)
+{
+    /* nothing to do if the file has no cache */
+    if (mfu_file->type == POSIX &&
+        mfu_file_lremovexattr(name, MFU_DIGEST_XATTR, mfu_file) != 0 &&
+        errno != ENODATA && errno != ENOTSUP)
+    {
+        MFU_LOG(MFU_LOG_DBG, "Failed to remove digests on `%s' (errno=%d %s)",
+            name, errno, strerror(errno));
+    }
+}
+
+int mfu_file_chunk_list_digest(
+    mfu_flist list,
+    const mfu_file_chunk* head,
+    mfu_copy_opts_t* copy_opts,
+    unsigned char* digests,
+    int* errs,
+    uint64_t* bytes_read,
+    uint64_t* bytes_written,
+    mfu_progress* prg,
+    mfu_file_t* mfu_file)
+{
+    int rc = 0;
+
+    /* get a buffer to read file data */
+    size_t buf_size = copy_opts->buf_size;
+    void* buf = MFU_BUF_GET(buf_size, 1024*1024);
+
+    /* digests are computed for each chunk_size piece of a file,
+     * and an element of the chunk list may hold several pieces */
+    uint64_t chunk_size = (uint64_t) copy_opts->chunk_size;
+
+    /* only POSIX files have a digest cache */
+    int use_cache = (copy_opts->digest_cache && mfu_file->type == POSIX);
+    char* cache_buf = NULL;
+    mfu_digest_record_t* records = NULL;
+    int* record_dests = NULL;
+    uint64_t record_count = 0;
+    if (use_cache) {
+        cache_buf = (char*) MFU_MALLOC(MFU_DIGEST_XATTR_MAX);
+
+        /* allocate a record for each piece we'll digest */
+        uint64_t pieces = 0;
+        const mfu_file_chunk* p;
+        for (p = head; p != NULL; p = p->next) {
+            pieces += (p->length + chunk_size - 1) / chunk_size + 1;
+        }
+        records = (mfu_digest_record_t*) MFU_MALLOC((pieces + 1) * sizeof(mfu_digest_record_t));
+        record_dests = (int*) MFU_MALLOC((pieces + 1) * sizeof(int));
+    }
+
+    /* consecutive chunks often come from the same file,
+     * so keep the last file open until we get to a different one */
+    const char* open_name = NULL;
+    mfu_digest_tuple_t tuple;
+    const unsigned char* cached = NULL;
+    uint64_t cached_count = 0;
+
+    uint64_t i = 0;
+    const mfu_file_chunk* p;
+    for (p = head; p != NULL; p = p->next, i++) {
+        errs[i] = 0;
+
+        /* open file if it is not the one we already have open */
+        if (open_name == NULL || strcmp(open_name, p->name) != 0) {
+            if (open_name != NULL) {
+                mfu_file_close(open_name, mfu_file);
+                open_name = NULL;
+            }
+
+            /* look for digests cached for this version of the file,
+             * we get the identity before reading so that any change
+             * during the read prevents us from storing stale digests */
+            cached_count = 0;
+            if (use_cache && digest_tuple_get(p->name, &tuple, mfu_file) == 0) {
+                cached_count = digest_cache_load(p->name, &tuple, chunk_size, cache_buf, &cached, mfu_file);
+            }
+
+            int flags = O_RDONLY;
+            if (copy_opts->open_noatime) {
+                flags |= O_NOATIME;
+            }
+            if (mfu_file_open(p->name, flags, mfu_file) != 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+                    p->name, errno, strerror(errno));
+                errs[i] = 1;
+                rc = -1;
+                continue;
+            }
+            open_name = p->name;
+
+            /* hint that we'll read from file sequentially */
+            if (mfu_file->type == POSIX) {
+                posix_fadvise(mfu_file->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            }
+        }
+
+        /* the digest of the element is the digest of the digests of its pieces */
+        SHA256_CTX ctx;
+        SHA256_Init(&ctx);
+
+        off_t off = (off_t) p->offset;
+        off_t end = (off_t) (p->offset + p->length);
+        do {
+            /* compute range of this piece */
+            uint64_t piece = (uint64_t) off / chunk_size;
+            off_t piece_end = (off_t) ((piece + 1) * chunk_size);
+            if (piece_end > end) {
+                piece_end = end;
+            }
+
+            unsigned char digest[MFU_CHUNK_DIGEST_SIZE];
+            int from_cache = (piece < cached_count);
+            if (from_cache) {
+                /* file has not changed since we cached this digest */
+                memcpy(digest, cached + piece * MFU_CHUNK_DIGEST_SIZE, MFU_CHUNK_DIGEST_SIZE);
+                off = piece_end;
+            } else {
+                /* read the piece and add its data to the digest */
+                SHA256_CTX piece_ctx;
+                SHA256_Init(&piece_ctx);
+                while (off < piece_end) {
+                    size_t count = buf_size;
+                    if (piece_end - off < (off_t) count) {
+                        count = (size_t) (piece_end - off);
+                    }
+
+                    ssize_t nread = mfu_file_pread(p->name, buf, count, off, mfu_file);
+                    if (nread < 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' at offset %llx (errno=%d %s)",
+                            p->name, (unsigned long long)off, errno, strerror(errno));
+                        errs[i] = 1;
+                        break;
+                    }
+                    if (nread == 0) {
+                        MFU_LOG(MFU_LOG_ERR, "File `%s' is shorter than expected %llx",
+                            p->name, (unsigned long long)off);
+                        errs[i] = 1;
+                        break;
+                    }
+
+                    SHA256_Update(&piece_ctx, buf, (size_t) nread);
+                    off += (off_t) nread;
+
+                    /* update number of bytes read for progress messages */
+                    *bytes_read += (uint64_t) nread;
+                    uint64_t count_bytes[2];
+                    count_bytes[0] = *bytes_read;
+                    count_bytes[1] = *bytes_written;
+                    mfu_progress_update(count_bytes, prg);
+                }
+                SHA256_Final(digest, &piece_ctx);
+            }
+
+            if (errs[i]) {
+                break;
+            }
+
+            SHA256_Update(&ctx, digest, MFU_CHUNK_DIGEST_SIZE);
+
+            /* record digest to be sent to the owner for caching */
+            if (use_cache) {
+                mfu_digest_record_t* rec = &records[record_count];
+                rec->index  = p->index_of_owner;
+                rec->chunk  = piece;
+                rec->tuple  = tuple;
+                rec->cached = (uint64_t) from_cache;
+                memcpy(rec->digest, digest, MFU_CHUNK_DIGEST_SIZE);
+                record_dests[record_count] = (int) p->rank_of_owner;
+                record_count++;
+            }
+        } while (off < end);
+
+        SHA256_Final(digests + i * MFU_CHUNK_DIGEST_SIZE, &ctx);
+
+        /* don't keep a file open after an error */
+        if (errs[i]) {
+            mfu_file_close(open_name, mfu_file);
+            open_name = NULL;
+            rc = -1;
+        }
+    }
+
+    if (open_name != NULL) {
+        mfu_file_close(open_name, mfu_file);
+    }
+
+    /* have owners cache the digests of files we read */
+    if (use_cache) {
+        digest_cache_store(list, chunk_size, records, record_dests, record_count, mfu_file);
+        mfu_free(&record_dests);
+        mfu_free(&records);
+        mfu_free(&cache_buf);
+    }
+
+    mfu_buf_put(&buf);
+
+    return rc;
+}
+
+/* digest of a chunk, returned to the rank that holds the chunk in its list */
+typedef struct {
+    uint64_t index; /* position of chunk in list of the rank it is returned to */
+    uint64_t err;   /* whether the chunk could not be read */
+    unsigned char digest[MFU_CHUNK_DIGEST_SIZE];
+} mfu_chunk_digest_t;
+
+/* compute the digest of each of count chunks in head on one of the
+ * nranks ranks starting at rank base, and set digests and errs for
+ * chunk i on this rank, returns 0 if all chunks were read and -1
+ * otherwise, must be called by all ranks */
+static int digest_side(
+    mfu_flist list,
+    const mfu_file_chunk* head,
+    uint64_t count,
+    int base,
+    int nranks,
+    mfu_copy_opts_t* copy_opts,
+    unsigned char* digests,
+    int* errs,
+    uint64_t* bytes_read,
+    uint64_t* bytes_written,
+    mfu_progress* prg,
+    mfu_file_t* mfu_file)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    /* spread our chunks round robin over the ranks of this side */
+    mfu_exchange ex;
+    mfu_exchange_init(&ex, MPI_COMM_WORLD);
+    uint64_t i = 0;
+    const mfu_file_chunk* p;
+    for (p = head; p != NULL; p = p->next, i++) {
+        int dest = base + (int) (((uint64_t) rank + i) % (uint64_t) nranks);
+        mfu_exchange_pack_u64(&ex, dest, (uint64_t) rank);
+        mfu_exchange_pack_u64(&ex, dest, i);
+        mfu_exchange_pack_u64(&ex, dest, p->offset);
+        mfu_exchange_pack_u64(&ex, dest, p->length);
+        mfu_exchange_pack_u64(&ex, dest, p->file_size);
+        mfu_exchange_pack_u64(&ex, dest, p->rank_of_owner);
+        mfu_exchange_pack_u64(&ex, dest, p->index_of_owner);
+        mfu_exchange_pack_str(&ex, dest, p->name, strlen(p->name));
+    }
+    size_t recv_size;
+    char* recv = mfu_exchange_all(&ex, &recv_size);
+
+    /* build a list of the chunks we were sent, names point into recv */
+    uint64_t recv_count = 0;
+    const char* ptr = recv;
+    while (ptr < recv + recv_size) {
+        ptr += 7 * sizeof(uint64_t);
+        ptr += strlen(ptr) + 1;
+        recv_count++;
+    }
+    mfu_file_chunk* chunks = (mfu_file_chunk*) MFU_MALLOC((recv_count + 1) * sizeof(mfu_file_chunk));
+    mfu_chunk_digest_t* replies = (mfu_chunk_digest_t*) MFU_MALLOC((recv_count + 1) * sizeof(mfu_chunk_digest_t));
+    int* dests = (int*) MFU_MALLOC((recv_count + 1) * sizeof(int));
+    ptr = recv;
+    for (i = 0; i < recv_count; i++) {
+        uint64_t origin;
+        mfu_unpack_uint64(&ptr, &origin);
+        mfu_unpack_uint64(&ptr, &replies[i].index);
+        mfu_unpack_uint64(&ptr, &chunks[i].offset);
+        mfu_unpack_uint64(&ptr, &chunks[i].length);
+        mfu_unpack_uint64(&ptr, &chunks[i].file_size);
+        mfu_unpack_uint64(&ptr, &chunks[i].rank_of_owner);
+        mfu_unpack_uint64(&ptr, &chunks[i].index_of_owner);
+        chunks[i].name = ptr;
+        chunks[i].next = (i + 1 < recv_count) ? &chunks[i + 1] : NULL;
+        ptr += strlen(ptr) + 1;
+        dests[i] = (int) origin;
+    }
+
+    /* read the chunks we were sent */
+    unsigned char* recv_digests = (unsigned char*) MFU_MALLOC((recv_count + 1) * MFU_CHUNK_DIGEST_SIZE);
+    int* recv_errs = (int*) MFU_MALLOC((recv_count + 1) * sizeof(int));
+    mfu_file_chunk* recv_head = (recv_count > 0) ? chunks : NULL;
+    mfu_file_chunk_list_digest(list, recv_head, copy_opts, recv_digests, recv_errs,
+        bytes_read, bytes_written, prg, mfu_file);
+
+    /* return each digest to the rank that holds the chunk */
+    for (i = 0; i < recv_count; i++) {
+        replies[i].err = (uint64_t) recv_errs[i];
+        memcpy(replies[i].digest, recv_digests + i * MFU_CHUNK_DIGEST_SIZE, MFU_CHUNK_DIGEST_SIZE);
+    }
+    uint64_t reply_count;
+    mfu_chunk_digest_t* results = (mfu_chunk_digest_t*) mfu_exchange_items(
+        replies, dests, recv_count, sizeof(mfu_chunk_digest_t), &reply_count, MPI_COMM_WORLD);
+
+    int rc = 0;
+    for (i = 0; i < reply_count; i++) {
+        uint64_t idx = results[i].index;
+        errs[idx] = (int) results[i].err;
+        memcpy(digests + idx * MFU_CHUNK_DIGEST_SIZE, results[i].digest, MFU_CHUNK_DIGEST_SIZE);
+        if (errs[idx]) {
+            rc = -1;
+        }
+    }
+
+    mfu_free(&results);
+    mfu_free(&recv_errs);
+    mfu_free(&recv_digests);
+    mfu_free(&dests);
+    mfu_free(&replies);
+    mfu_free(&chunks);
+    mfu_free(&recv);
+
+    return rc;
+}
+
+int mfu_file_chunk_list_digest_compare(
+    mfu_flist src_list,
+    mfu_flist dst_list,
+    const mfu_file_chunk* src_head,
+    const mfu_file_chunk* dst_head,
+    mfu_copy_opts_t* copy_opts,
+    int* vals,
+    uint64_t* bytes_read,
+    uint64_t* bytes_written,
+    mfu_progress* prg,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* get a count of how many items are the chunk list */
+    uint64_t count = mfu_file_chunk_list_size(src_head);
+
+    unsigned char* src_digests = (unsigned char*) MFU_MALLOC((count + 1) * MFU_CHUNK_DIGEST_SIZE);
+    unsigned char* dst_digests = (unsigned char*) MFU_MALLOC((count + 1) * MFU_CHUNK_DIGEST_SIZE);
+    int* src_errs = (int*) MFU_MALLOC((count + 1) * sizeof(int));
+    int* dst_errs = (int*) MFU_MALLOC((count + 1) * sizeof(int));
+
+    /* with reader ranks, the source is read by the first reader_ranks
+     * ranks and the destination by the rest, each side sends digests
+     * back to the rank holding the chunk, otherwise every rank reads
+     * its own chunks, one side in each pass so only one file system
+     * is being read from at a time */
+    int rc = 0;
+    int readers = copy_opts->reader_ranks;
+    if (readers > 0 && readers < ranks) {
+        if (digest_side(src_list, src_head, count, 0, readers, copy_opts,
+            src_digests, src_errs, bytes_read, bytes_written, prg, mfu_src_file) != 0)
+        {
+            rc = -1;
+        }
+        if (digest_side(dst_list, dst_head, count, readers, ranks - readers, copy_opts,
+            dst_digests, dst_errs, bytes_read, bytes_written, prg, mfu_dst_file) != 0)
+        {
+            rc = -1;
+        }
+    } else {
+        if (mfu_file_chunk_list_digest(src_list, src_head, copy_opts, src_digests, src_errs,
+            bytes_read, bytes_written, prg, mfu_src_file) != 0)
+        {
+            rc = -1;
+        }
+        if (mfu_file_chunk_list_digest(dst_list, dst_head, copy_opts, dst_digests, dst_errs,
+            bytes_read, bytes_written, prg, mfu_dst_file) != 0)
+        {
+            rc = -1;
+        }
+    }
+
+    /* chunk i of each list covers the same range of the same relative
+     * file, and digests come back to the rank holding the chunk, so
+     * join the two sides by position */
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        if (src_errs[i] || dst_errs[i]) {
+            vals[i] = 1;
+        } else {
+            const unsigned char* src_digest = src_digests + i * MFU_CHUNK_DIGEST_SIZE;
+            const unsigned char* dst_digest = dst_digests + i * MFU_CHUNK_DIGEST_SIZE;
+            vals[i] = (memcmp(src_digest, dst_digest, MFU_CHUNK_DIGEST_SIZE) != 0);
+        }
+    }
+
+    mfu_free(&dst_errs);
+    mfu_free(&src_errs);
+    mfu_free(&dst_digests);
+    mfu_free(&src_digests);
+
+    return rc;
+}
@@ -18,10 +18,6 @@
 #include <time.h> /* asctime / localtime */
 #include <regex.h>
 
-#ifdef HAVE_LIBATTR
-#include <attr/libattr.h>
-#endif /* HAVE_LIBATTR */
-
 /* These headers are needed to query the Lustre MDS for stat
  * information.  This information may be incomplete, but it
  * is faster than a normal stat, which requires communication
@@ -99,6 +95,28 @@ typedef struct {
 #endif
 } mfu_copy_file_cache_t;
 
+/* files whose data is compared during the data phase of a copy,
+ * see mfu_flist_copy_compare */
+typedef struct {
+    mfu_flist src_list; /* source files to compare */
+    mfu_flist dst_list; /* destination files, in same order as src_list */
+    int* results;       /* OUT - 1 if data of item differed, 0 otherwise */
+    int done;           /* whether the comparison has been run */
+} mfu_copy_compare_t;
+
+/* tracks progress through the chunks being compared while copying */
+typedef struct {
+    const mfu_file_chunk* src_p; /* next source chunk to compare */
+    const mfu_file_chunk* dst_p; /* next destination chunk to compare */
+    uint64_t index;              /* index of next chunk to compare */
+    uint64_t count;              /* number of chunks to compare */
+    uint64_t bytes;              /* bytes compared so far */
+    uint64_t total_bytes;        /* bytes to compare on this process */
+    int* vals;                   /* 1 if chunk differed, 0 otherwise */
+    mfu_compare_ctx* ctx;        /* holds files open across chunks */
+    int rc;                      /* -1 if any chunk could not be read */
+} mfu_copy_compare_state_t;
+
 /****************************************
  * Define globals
  ***************************************/
@@ -157,6 +175,7 @@ static int mfu_copy_open_file(
     int read_flag,                /* set to 1 to open in read only, 0 for write */
     mfu_copy_file_cache_t* cache, /* cache the open file to avoid repetitive open/close of the same file */
     mfu_copy_opts_t* copy_opts,   /* options configuring the copy operation */
+    int direct,                   /* set to 1 to open with O_DIRECT */
     mfu_file_t* mfu_file)         /* whether the file is in POSIX/DAOS */
 {
     /* see if we have a cached file descriptor */
@@ -181,13 +200,13 @@ static int mfu_copy_open_file(
         if (copy_opts->open_noatime) {
             flags |= O_NOATIME;
         }
-        if (copy_opts->direct) {
+        if (direct) {
             flags |= O_DIRECT;
         }
         mfu_file_open(file, flags, mfu_file);
     } else {
         int flags = O_WRONLY | O_CREAT;
-        if (copy_opts->direct) {
+        if (direct) {
             flags |= O_DIRECT;
         }
         mfu_file_open(file, flags, mfu_file, DCOPY_DEF_PERMS_FILE);
@@ -278,170 +297,40 @@ static int mfu_copy_xattrs(
     /* get source file name */
     const char* src_path = mfu_flist_file_get_name(flist, idx);
 
-    /* start with a reasonable buffer, we'll allocate more as needed */
-    size_t list_bufsize = 1204;
-    char* list = (char*) MFU_MALLOC(list_bufsize);
-
-    /* get list, if list_size == ERANGE, try again */
-    ssize_t list_size;
-    int got_list = 0;
-
-    /* get current estimate for list size */
-    while(! got_list) {
-        errno = 0;
-        if (copy_opts->dereference) {
-            /* listxattr of dereferenced symbolic link */
-            list_size = mfu_file_listxattr(src_path, list, list_bufsize, mfu_src_file);
-        } else {
-            /* llistxattr of the symbolic link itself */
-            list_size = mfu_file_llistxattr(src_path, list, list_bufsize, mfu_src_file);
-        }
+    /* use the xattrs captured during the walk if we have them,
+     * otherwise read them from the source now */
+    void* alloc = NULL;
+    size_t size;
+    const void* buf = mfu_flist_file_get_xattrs(flist, idx, &size);
+    if (buf == NULL) {
+        rc = mfu_xattrs_read(src_path, copy_opts->copy_xattrs,
+            copy_opts->dereference, mfu_src_file, &alloc, &size);
+        buf = alloc;
+    }
 
-        if(list_size < 0) {
-            if(errno == ERANGE) {
-                /* buffer is too small, free our current buffer
-                 * and call it again with size==0 to get new size */
-                mfu_free(&list);
-                list_bufsize = 0;
-            }
-            else if(errno == ENOTSUP) {
-                /* this is common enough that we silently ignore it */
-                break;
-            }
-            else {
-                /* this is a real error */
-                MFU_LOG(MFU_LOG_ERR, "Failed to get list of extended attributes on `%s' llistxattr() (errno=%d %s)",
-                    src_path, errno, strerror(errno)
+    /* set each attribute on destination object, the walk may have
+     * captured a wider set than we are asked to copy so filter again */
+    const char* name;
+    const void* val;
+    size_t val_size;
+    size_t pos = mfu_xattrs_next(buf, size, 0, &name, &val, &val_size);
+    while (pos != 0) {
+        if (mfu_xattrs_select(name, copy_opts->copy_xattrs)) {
+            errno = 0;
+            /* lsetxattr of symbolic link itself. No need to dereference here */
+            int setrc = mfu_file_lsetxattr(dest_path, name, val, val_size, 0, mfu_dst_file);
+            if(setrc != 0) {
+                /* failed to set attribute */
+                MFU_LOG(MFU_LOG_ERR, "Failed to set value for name=%s on `%s' lsetxattr() (errno=%d %s)",
+                    name, dest_path, errno, strerror(errno)
                    );
                 rc = -1;
-                break;
-            }
-        }
-        else {
-            if(list_size > 0 && list_bufsize == 0) {
-                /* called mfu_file_llistxattr with size==0 and got back positive
-                 * number indicating size of buffer we need to allocate */
-                list_bufsize = (size_t) list_size;
-                list = (char*) MFU_MALLOC(list_bufsize);
-            }
-            else {
-                /* got our list, it's size is in list_size, which may be 0 */
-                got_list = 1;
-            }
-        }
-    }
-
-    /* iterate over list and copy values to new object lgetxattr/lsetxattr */
-    if(got_list) {
-        char* name = list;
-        while(name < list + list_size) {
-            /* start with a reasonable buffer,
-             * allocate something bigger as needed */
-            size_t val_bufsize = 1024;
-            void* val = (void*) MFU_MALLOC(val_bufsize);
-            int copy_xattr;
-
-            /* lookup value for name */
-            ssize_t val_size;
-            int got_val = 0;
-
-            copy_xattr = 1; /* copy unless indicated below not to */
-            if (copy_opts->copy_xattrs == XATTR_USE_LIBATTR) {
-#ifdef HAVE_LIBATTR
-                if (attr_copy_action(name, NULL) == ATTR_ACTION_SKIP) {
-                    copy_xattr = 0;
-                }
-#endif /* HAVE_LIBATTR */
-            } else if (copy_opts->copy_xattrs == XATTR_SKIP_LUSTRE) {
-                /* ignore xattrs lustre treats specially */
-                /* list from lustre source file lustre_idl.h */
-                if (    strncmp(name,"lustre.",strlen("lustre.")) == 0 ||
-                        strcmp(name,"trusted.som") == 0 || strcmp(name,"trusted.lov") == 0 ||
-                        strcmp(name,"trusted.lma") == 0 || strcmp(name,"trusted.lmv") == 0 ||
-                        strcmp(name,"trusted.dmv") == 0 || strcmp(name,"trusted.link") == 0 ||
-                        strcmp(name,"trusted.fid") == 0 || strcmp(name,"trusted.version") == 0 ||
-                        strcmp(name,"trusted.hsm") == 0 || strcmp(name,"trusted.lfsck_bitmap") == 0 ||
-                        strcmp(name,"trusted.dummy") == 0)
-                {
-                    copy_xattr = 0;
-                }
-            }
-
-            while(! got_val && copy_xattr) {
-                errno = 0;
-                if (copy_opts->dereference) {
-                    /* getxattr of dereferenced symbolic links */
-                    val_size = mfu_file_getxattr(src_path, name, val, val_bufsize, mfu_src_file);
-                } else {
-                    /* lgetxattr of symbolic the link itself */
-                    val_size = mfu_file_lgetxattr(src_path, name, val, val_bufsize, mfu_src_file);
-                }
-
-                if(val_size < 0) {
-                    if(errno == ERANGE) {
-                        /* buffer is too small, free our current buffer
-                         * and call it again with size==0 to get new size */
-                        mfu_free(&val);
-                        val_bufsize = 0;
-                    }
-                    else if(errno == ENOATTR) {
-                        /* source object no longer has this attribute,
-                         * maybe deleted out from under us, ignore but print warning */
-                        MFU_LOG(MFU_LOG_WARN, "Attribute does not exist for name=%s on `%s' lgetxattr() (errno=%d %s)",
-                            name, src_path, errno, strerror(errno)
-                           );
-                        break;
-                    }
-                    else {
-                        /* this is a real error */
-                        MFU_LOG(MFU_LOG_ERR, "Failed to get value for name=%s on `%s' lgetxattr() (errno=%d %s)",
-                            name, src_path, errno, strerror(errno)
-                           );
-                        rc = -1;
-                        break;
-                    }
-                }
-                else {
-                    if(val_size > 0 && val_bufsize == 0) {
-                        /* called mfu_file_lgetxattr with size==0 and got back positive
-                         * number indicating size of buffer we need to allocate */
-                        val_bufsize = (size_t) val_size;
-                        val = (void*) MFU_MALLOC(val_bufsize);
-                    }
-                    else {
-                        /* got our value, it's size is in val_size, which may be 0 */
-                        got_val = 1;
-                    }
-                }
-            }
-
-            /* set attribute on destination object */
-            if(got_val && copy_xattr) {
-                errno = 0;
-                /* lsetxattr of symbolic link itself. No need to dereference here */
-                int setrc = mfu_file_lsetxattr(dest_path, name, val, (size_t) val_size, 0, mfu_dst_file);
-                if(setrc != 0) {
-                    /* failed to set attribute */
-                    MFU_LOG(MFU_LOG_ERR, "Failed to set value for name=%s on `%s' lsetxattr() (errno=%d %s)",
-                        name, dest_path, errno, strerror(errno)
-                       );
-                    rc = -1;
-                }
             }
-
-            /* free value string */
-            mfu_free(&val);
-            val_bufsize = 0;
-
-            /* jump to next name */
-            size_t namelen = strlen(name) + 1;
-            name += namelen;
         }
+        pos = mfu_xattrs_next(buf, size, pos, &name, &val, &val_size);
     }
 
-    /* free space allocated for list */
-    mfu_free(&list);
-    list_bufsize = 0;
+    mfu_free(&alloc);
 
 #endif /* DCOPY_USE_XATTR */
 
@@ -1235,6 +1124,16 @@ static int mfu_create_file(
         return 0;
     }
 
+    /* get size of source file to select layout and preallocate space */
+    uint64_t src_size = mfu_flist_file_get_size(list, idx);
+
+    /* if user requested a size-based layout, create the file with it,
+     * this only applies to POSIX destinations */
+    int created = 0;
+    if (mfu_dst_file->type == POSIX) {
+        created = mfu_create_layout(dest_path, src_size, copy_opts->create_opts);
+    }
+
     /* since file systems like Lustre require xattrs to be set before file is opened,
      * we first create it with mknod and then set xattrs */
 
@@ -1243,7 +1142,10 @@ static int mfu_create_file(
      * see makedev() to create valid dev */
     dev_t dev;
     memset(&dev, 0, sizeof(dev_t));
-    int mknod_rc = mfu_file_mknod(dest_path, DCOPY_DEF_PERMS_FILE | S_IFREG, dev, mfu_dst_file);
+    int mknod_rc = 0;
+    if (! created) {
+        mknod_rc = mfu_file_mknod(dest_path, DCOPY_DEF_PERMS_FILE | S_IFREG, dev, mfu_dst_file);
+    }
     if(mknod_rc < 0) {
         if(errno == EEXIST) {
             /* destination already exists, no big deal, but print warning */
@@ -1296,6 +1198,16 @@ static int mfu_create_file(
         }
     }
 
+    /* reserve space for file data so that chunks written in any order
+     * by different ranks land in contiguous extents, skip this for
+     * sparse copies since it would allocate the holes */
+    if (! copy_opts->sparse) {
+        int tmp_rc = mfu_create_preallocate(dest_path, src_size, copy_opts->create_opts, mfu_dst_file);
+        if (tmp_rc < 0) {
+            rc = -1;
+        }
+    }
+
 #ifdef HPSS_SUPPORT
 
     /*
@@ -1711,31 +1623,51 @@ static int mfu_copy_file_normal(
     size_t buf_size = copy_opts->buf_size;
     void* buf       = copy_opts->block_buf1;
 
-    /* for O_DIRECT, check that length is multiple of buf_size */
-    if (copy_opts->direct &&           /* using O_DIRECT */
-        offset + length < file_size && /* not at end of file */
-        length % buf_size != 0)        /* length not an integer multiple of block size */
-    {
-        MFU_ABORT(-1, "O_DIRECT requires chunk size to be integer multiple of block size %llu",
-            buf_size);
-    }
+    /* determine which portion of our chunk can use O_DIRECT,
+     * unaligned bytes at the head and tail use buffered I/O */
+    off_t direct_start, direct_end;
+    size_t direct_size;
+    mfu_direct_range(copy_opts, mfu_src_file, mfu_dst_file,
+        (off_t) offset, (off_t) length, (off_t) file_size,
+        &direct_start, &direct_end, &direct_size);
+
+    /* files are only opened with O_DIRECT if this is set */
+    int direct = mfu_direct_enabled(copy_opts, file_size);
+
+    /* cached files may be left in either mode by an earlier chunk,
+     * so use -1 to force a check on the first operation */
+    int direct_on = -1;
 
     /* initialize our starting offset within the file */
     off_t off = offset;
+    off_t end = (off_t) (offset + length);
 
     /* write data */
     uint64_t total_bytes = 0;
     while (total_bytes < length) {
         /* determine number of bytes to read,
-         * O_DIRECT requires read operation of certain size blocks,
-         * even if we know that would run past the end of the file */
-        size_t left_to_read = buf_size;
-        if (! copy_opts->direct) {
-            uint64_t remainder = length - total_bytes;
-            if (remainder < (uint64_t) buf_size) {
-                left_to_read = (size_t) remainder;
+         * and whether this operation is aligned for O_DIRECT */
+        int use_direct;
+        size_t left_to_read = mfu_direct_next(off, end, buf_size,
+            direct_start, direct_end, direct_size, &use_direct);
+
+        /* switch files between direct and buffered modes if needed */
+        if (direct && direct_on != use_direct) {
+            if (mfu_file_set_direct(src, mfu_src_file, use_direct) != 0 ||
+                mfu_file_set_direct(dest, mfu_dst_file, use_direct) != 0)
+            {
+                /* fall back to buffered I/O for the rest of this chunk */
+                MFU_LOG(MFU_LOG_DBG, "Failed to toggle O_DIRECT on `%s' (errno=%d %s)",
+                    dest, errno, strerror(errno));
+                mfu_file_set_direct(src, mfu_src_file, 0);
+                mfu_file_set_direct(dest, mfu_dst_file, 0);
+                direct_size = 0;
+                use_direct  = 0;
+                left_to_read = mfu_direct_next(off, end, buf_size,
+                    direct_start, direct_end, direct_size, &use_direct);
             }
         }
+        direct_on = use_direct;
 
         /* read data from source file */
         ssize_t bytes_read = mfu_file_pread(src, buf, left_to_read, off, mfu_src_file);
@@ -1744,7 +1676,7 @@ static int mfu_copy_file_normal(
          * Retry with same buffer and offset since those must
          * be aligned at block boundaries. */
         int retries = 0;
-        while (copy_opts->direct &&            /* using O_DIRECT */
+        while (use_direct &&                   /* using O_DIRECT */
                bytes_read > 0 &&               /* read was not an error or eof */
                bytes_read < left_to_read &&    /* shorter than requested */
                (off + bytes_read) < file_size) /* not at end of file */
@@ -1774,24 +1706,10 @@ static int mfu_copy_file_normal(
             return -1;
         }
 
-        /* compute number of bytes to write */
+        /* compute number of bytes to write, O_DIRECT operations
+         * are always block aligned and never extend past the end
+         * of the file, so no padding is needed */
         size_t bytes_to_write = (size_t) bytes_read;
-        if (copy_opts->direct) {
-            /* O_DIRECT requires particular write sizes,
-             * ok to write beyond end of file so long as
-             * we truncate in cleanup step */
-            size_t remainder = buf_size - (size_t) bytes_read;
-            if (remainder > 0) {
-                /* zero out the end of the buffer for security,
-                 * don't want to leave data from another file at end of
-                 * current file if we fail before truncating */
-                char* bufzero = ((char*)buf + bytes_read);
-                memset(bufzero, 0, remainder);
-            }
-
-            /* assumes buf_size is magic size for O_DIRECT */
-            bytes_to_write = buf_size;
-        }
 
         /* If in sparse mode, skip writing out blocks that are all 0.
          * Rely on posix hole semantics to account for those 0 values instead.
@@ -1821,7 +1739,7 @@ static int mfu_copy_file_normal(
                  * by advancing by the number of bytes written.  For O_DIRECT, we
                  * need to keep buffer, file offset, and amount to write aligned
                  * on block boundaries, so just retry the entire operation. */
-                if (!copy_opts->direct || bytes_written == bytes_to_write) {
+                if (!use_direct || bytes_written == bytes_to_write) {
                     n += bytes_written;
                 }
             }
@@ -1876,7 +1794,7 @@ static int mfu_copy_file_fiemap(
     mfu_file_t* mfu_dst_file)
 {
     *normal_copy_required = true;
-    if (copy_opts->direct) {
+    if (mfu_direct_enabled(copy_opts, file_size)) {
         goto fail_normal_copy;
     }
 
@@ -2066,9 +1984,12 @@ static int mfu_copy_file(
 {
     int ret;
 
+    /* only use O_DIRECT if the file is large enough to benefit */
+    int direct = mfu_direct_enabled(copy_opts, file_size);
+
     /* open the input file */
     ret = mfu_copy_open_file(src, 1, &mfu_copy_src_cache,
-                             copy_opts, mfu_src_file);
+                             copy_opts, direct, mfu_src_file);
     if (ret) {
         MFU_LOG(MFU_LOG_ERR, "Failed to open input file `%s' (errno=%d %s)",
             src, errno, strerror(errno));
@@ -2077,7 +1998,7 @@ static int mfu_copy_file(
 
     /* open the output file */
     ret = mfu_copy_open_file(dest, 0, &mfu_copy_dst_cache,
-                             copy_opts, mfu_dst_file);
+                             copy_opts, direct, mfu_dst_file);
     if (ret) {
         MFU_LOG(MFU_LOG_ERR, "Failed to open output file `%s' (errno=%d %s)",
                 dest, errno, strerror(errno));
@@ -2100,6 +2021,575 @@ static int mfu_copy_file(
     return ret;
 }
 
+/* number of buffers a reader or writer rank cycles through
+ * when shipping file data between ranks */
+#define MFU_COPY_RING (4)
+
+/* describes a chunk of a file that a reader rank reads
+ * and ships to a writer rank */
+typedef struct {
+    char* name;         /* source file name */
+    char* dest;         /* destination file name, only set on writer */
+    uint64_t offset;    /* starting byte offset in file */
+    uint64_t length;    /* number of bytes in chunk */
+    uint64_t file_size; /* full size of file */
+    int rc;             /* 0 if chunk was copied, 1 otherwise */
+} mfu_copy_remote_chunk;
+
+static size_t mfu_copy_remote_chunk_pack_size(const char* name)
+{
+    return 4 + strlen(name) + 1 + 3 * 8;
+}
+
+static void mfu_copy_remote_chunk_pack(
+    char** pptr,
+    const char* name,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t file_size)
+{
+    uint32_t len = (uint32_t) (strlen(name) + 1);
+    mfu_pack_uint32(pptr, len);
+    memcpy(*pptr, name, len);
+    *pptr += len;
+    mfu_pack_uint64(pptr, offset);
+    mfu_pack_uint64(pptr, length);
+    mfu_pack_uint64(pptr, file_size);
+}
+
+static void mfu_copy_remote_chunk_unpack(const char** pptr, mfu_copy_remote_chunk* c)
+{
+    uint32_t len;
+    mfu_unpack_uint32(pptr, &len);
+    c->name = MFU_STRDUP(*pptr);
+    *pptr += len;
+    mfu_unpack_uint64(pptr, &c->offset);
+    mfu_unpack_uint64(pptr, &c->length);
+    mfu_unpack_uint64(pptr, &c->file_size);
+    c->dest = NULL;
+    c->rc   = 0;
+}
+
+/* unpack count chunks from buf into a newly allocated array */
+static mfu_copy_remote_chunk* mfu_copy_remote_chunk_unpack_all(
+    const char* buf,
+    uint64_t count)
+{
+    mfu_copy_remote_chunk* chunks = (mfu_copy_remote_chunk*) MFU_MALLOC(
+        count * sizeof(mfu_copy_remote_chunk));
+    const char* ptr = buf;
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        mfu_copy_remote_chunk_unpack(&ptr, &chunks[i]);
+    }
+    return chunks;
+}
+
+static void mfu_copy_remote_chunk_free(mfu_copy_remote_chunk** pchunks, uint64_t count)
+{
+    mfu_copy_remote_chunk* chunks = *pchunks;
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        mfu_free(&chunks[i].name);
+        mfu_free(&chunks[i].dest);
+    }
+    mfu_free(pchunks);
+}
+
+/* number of messages used to ship a chunk of the given length */
+static uint64_t mfu_copy_remote_pieces(uint64_t length, size_t buf_size)
+{
+    return (length + buf_size - 1) / buf_size;
+}
+
+/* a writer rank receives the chunks it is to write from the reader rank
+ * it is paired with in the order it sent their descriptions,
+ * each chunk arrives as a series of messages of buf_size bytes,
+ * an empty message means the reader failed to read that portion */
+static void mfu_copy_files_write(
+    MPI_Comm comm,
+    int reader,
+    mfu_copy_remote_chunk* chunks,
+    uint64_t count,
+    mfu_copy_opts_t* copy_opts,
+    mfu_file_t* mfu_dst_file)
+{
+    size_t buf_size = copy_opts->buf_size;
+
+    /* count total number of messages we'll receive */
+    uint64_t total = 0;
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        if (chunks[i].dest != NULL) {
+            total += mfu_copy_remote_pieces(chunks[i].length, buf_size);
+        }
+    }
+
+    /* post receives for the first few messages */
+    void* bufs[MFU_COPY_RING];
+    MPI_Request reqs[MFU_COPY_RING];
+    uint64_t posted = 0;
+    int k;
+    for (k = 0; k < MFU_COPY_RING; k++) {
+        bufs[k] = MFU_BUF_GET(buf_size, 1024*1024);
+        reqs[k] = MPI_REQUEST_NULL;
+        if (posted < total) {
+            MPI_Irecv(bufs[k], (int) buf_size, MPI_BYTE, reader, 0, comm, &reqs[k]);
+            posted++;
+        }
+    }
+
+    uint64_t consumed = 0;
+    for (i = 0; i < count; i++) {
+        mfu_copy_remote_chunk* c = &chunks[i];
+        if (c->dest == NULL) {
+            /* no need to copy this one */
+            continue;
+        }
+
+        /* open the output file, we still drain messages on failure */
+        int ret = mfu_copy_open_file(c->dest, 0, &mfu_copy_dst_cache,
+                                     copy_opts, 0, mfu_dst_file);
+        if (ret) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open output file `%s' (errno=%d %s)",
+                c->dest, errno, strerror(errno));
+            c->rc = 1;
+        }
+
+        off_t off = (off_t) c->offset;
+        uint64_t remaining = c->length;
+        while (remaining > 0) {
+            size_t expected = (remaining < buf_size) ? (size_t) remaining : buf_size;
+
+            /* wait for next message in order */
+            k = (int) (consumed % MFU_COPY_RING);
+            MPI_Status status;
+            MPI_Wait(&reqs[k], &status);
+            int bytes;
+            MPI_Get_count(&status, MPI_BYTE, &bytes);
+            char* buf = (char*) bufs[k];
+
+            if ((size_t) bytes != expected) {
+                /* reader already reported its error */
+                c->rc = 1;
+            }
+
+            /* skip writing blocks of all 0 in sparse mode */
+            if (c->rc == 0 && !(copy_opts->sparse && mfu_is_all_null(buf, expected))) {
+                /* we loop to account for short writes */
+                size_t n = 0;
+                while (n < expected) {
+                    ssize_t bytes_written = mfu_file_pwrite(c->dest, buf + n,
+                        expected - n, off + (off_t) n, mfu_dst_file);
+                    if (bytes_written < 0) {
+                        MFU_LOG(MFU_LOG_ERR, "Write error when copying from `%s' to `%s' (errno=%d %s)",
+                            c->name, c->dest, errno, strerror(errno));
+                        c->rc = 1;
+                        break;
+                    }
+                    n += (size_t) bytes_written;
+                }
+            }
+
+            /* reuse this buffer for a later message */
+            consumed++;
+            if (posted < total) {
+                MPI_Irecv(bufs[k], (int) buf_size, MPI_BYTE, reader, 0, comm, &reqs[k]);
+                posted++;
+            }
+
+            off += (off_t) expected;
+            remaining -= (uint64_t) expected;
+
+            /* update number of bytes we have copied for progress messages */
+            copy_count += (uint64_t) expected;
+            mfu_progress_update(&copy_count, copy_prog);
+        }
+
+        /* if we wrote the last chunk, truncate the file */
+        if (c->rc == 0 && c->offset + c->length >= c->file_size) {
+            if (mfu_file_ftruncate(mfu_dst_file, (off_t) c->file_size) < 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
+                    c->dest, errno, strerror(errno));
+                c->rc = 1;
+            }
+        }
+
+        if (c->rc == 0) {
+            mfu_copy_stats.total_size += (int64_t) c->length;
+            mfu_copy_stats.total_bytes_copied += (int64_t) c->length;
+        }
+    }
+
+    for (k = 0; k < MFU_COPY_RING; k++) {
+        mfu_buf_put(&bufs[k]);
+    }
+}
+
+/* state of a reader rank shipping chunks to one writer */
+typedef struct {
+    int writer;                    /* rank of writer */
+    mfu_copy_remote_chunk* chunks; /* chunks to ship */
+    uint64_t count;                /* number of chunks */
+    uint64_t cur;                  /* index of current chunk */
+    uint64_t done;                 /* bytes shipped from current chunk */
+    int fd;                        /* open source file for current chunk */
+} mfu_copy_stream;
+
+/* advance stream past any chunks that need no messages */
+static void mfu_copy_stream_skip_empty(mfu_copy_stream* s)
+{
+    while (s->cur < s->count && s->chunks[s->cur].length == 0) {
+        s->cur++;
+    }
+}
+
+/* a reader rank reads chunks for each of the writers it serves,
+ * and sends them a piece at a time, round robin across writers,
+ * so that all of its writers make progress together */
+static void mfu_copy_files_read(
+    MPI_Comm comm,
+    mfu_copy_stream* streams,
+    int nstreams,
+    mfu_copy_opts_t* copy_opts)
+{
+    size_t buf_size = copy_opts->buf_size;
+
+    int flags = O_RDONLY;
+    if (copy_opts->open_noatime) {
+        flags |= O_NOATIME;
+    }
+
+    void* bufs[MFU_COPY_RING];
+    MPI_Request reqs[MFU_COPY_RING];
+    int k;
+    for (k = 0; k < MFU_COPY_RING; k++) {
+        bufs[k] = MFU_BUF_GET(buf_size, 1024*1024);
+        reqs[k] = MPI_REQUEST_NULL;
+    }
+
+    int active = 0;
+    int j;
+    for (j = 0; j < nstreams; j++) {
+        mfu_copy_stream_skip_empty(&streams[j]);
+        if (streams[j].cur < streams[j].count) {
+            active++;
+        }
+    }
+
+    while (active > 0) {
+        for (j = 0; j < nstreams; j++) {
+            mfu_copy_stream* s = &streams[j];
+            if (s->cur >= s->count) {
+                continue;
+            }
+            mfu_copy_remote_chunk* c = &s->chunks[s->cur];
+
+            /* find a buffer that is not being sent */
+            for (k = 0; k < MFU_COPY_RING; k++) {
+                if (reqs[k] == MPI_REQUEST_NULL) {
+                    break;
+                }
+            }
+            if (k == MFU_COPY_RING) {
+                MPI_Waitany(MFU_COPY_RING, reqs, &k, MPI_STATUS_IGNORE);
+            }
+            char* buf = (char*) bufs[k];
+
+            uint64_t remaining = c->length - s->done;
+            size_t bytes = (remaining < buf_size) ? (size_t) remaining : buf_size;
+            off_t off = (off_t) (c->offset + s->done);
+
+            /* open the source file on the first piece of each chunk */
+            if (c->rc == 0 && s->fd < 0) {
+                s->fd = mfu_open(c->name, flags);
+                if (s->fd < 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to open input file `%s' (errno=%d %s)",
+                        c->name, errno, strerror(errno));
+                    c->rc = 1;
+                }
+            }
+
+            /* read a full piece, an empty message tells the writer we failed */
+            size_t n = 0;
+            while (c->rc == 0 && n < bytes) {
+                ssize_t bytes_read = mfu_pread(c->name, s->fd, buf + n, bytes - n, off + (off_t) n);
+                if (bytes_read < 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Read error when copying from `%s' (errno=%d %s)",
+                        c->name, errno, strerror(errno));
+                    c->rc = 1;
+                } else if (bytes_read == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Source file `%s' shorter than expected size of %llu bytes",
+                        c->name, (unsigned long long) c->file_size);
+                    c->rc = 1;
+                }
+                n += (bytes_read > 0) ? (size_t) bytes_read : 0;
+            }
+            int send_bytes = (c->rc == 0) ? (int) bytes : 0;
+            MPI_Isend(buf, send_bytes, MPI_BYTE, s->writer, 0, comm, &reqs[k]);
+
+            /* move on to the next chunk once this one is shipped */
+            s->done += (uint64_t) bytes;
+            if (s->done >= c->length) {
+                if (s->fd >= 0) {
+                    mfu_close(c->name, s->fd);
+                    s->fd = -1;
+                }
+                s->cur++;
+                s->done = 0;
+                mfu_copy_stream_skip_empty(s);
+                if (s->cur >= s->count) {
+                    active--;
+                }
+            }
+
+            /* keep progress messages moving */
+            mfu_progress_update(&copy_count, copy_prog);
+        }
+    }
+
+    MPI_Waitall(MFU_COPY_RING, reqs, MPI_STATUSES_IGNORE);
+
+    for (k = 0; k < MFU_COPY_RING; k++) {
+        mfu_buf_put(&bufs[k]);
+    }
+}
+
+/* returns number of ranks reading the source if the copy is split
+ * between readers and writers, and 0 if every rank does both */
+static int mfu_copy_readers(const mfu_copy_opts_t* copy_opts, const mfu_file_t* mfu_src_file)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+    if (copy_opts->reader_ranks > 0 &&
+        copy_opts->reader_ranks < ranks &&
+        mfu_src_file->type == POSIX)
+    {
+        return copy_opts->reader_ranks;
+    }
+    return 0;
+}
+
+/* copy chunks with the first copy_opts->reader_ranks ranks reading
+ * the source and shipping data over MPI to the remaining ranks,
+ * which write the destination, each writer is served by a single reader,
+ * sets vals[i] to 1 for each chunk in the list that failed to copy,
+ * and adds the number of bytes this rank wrote to total_count */
+static void mfu_copy_files_split(
+    const mfu_file_chunk* head,
+    uint64_t list_count,
+    int* vals,
+    int numpaths,
+    const mfu_param_path* paths,
+    const mfu_param_path* destpath,
+    mfu_copy_opts_t* copy_opts,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file,
+    uint64_t* total_count)
+{
+    /* use our own communicator to ship data */
+    MPI_Comm comm;
+    MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+
+    int rank, ranks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &ranks);
+
+    int readers = copy_opts->reader_ranks;
+    int writers = ranks - readers;
+
+    /* spread our chunks round robin across the writers,
+     * count number of chunks we send to each */
+    int* sendchunks = (int*) MFU_CALLOC((size_t)ranks, sizeof(int));
+    int* recvchunks = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    int* targets    = (int*) MFU_MALLOC(list_count * sizeof(int));
+
+    /* pack chunk descriptions grouped by target rank */
+    mfu_exchange ex;
+    mfu_exchange_init(&ex, comm);
+    uint64_t i;
+    const mfu_file_chunk* p = head;
+    for (i = 0; i < list_count; i++) {
+        int target = readers + (int) ((rank + i) % (uint64_t) writers);
+        targets[i] = target;
+        sendchunks[target]++;
+
+        size_t size = mfu_copy_remote_chunk_pack_size(p->name);
+        char* desc = (char*) MFU_MALLOC(size);
+        char* ptr = desc;
+        mfu_copy_remote_chunk_pack(&ptr, p->name, p->offset, p->length, p->file_size);
+        mfu_exchange_pack(&ex, target, desc, size);
+        mfu_free(&desc);
+
+        p = p->next;
+    }
+
+    MPI_Alltoall(sendchunks, 1, MPI_INT, recvchunks, 1, MPI_INT, comm);
+
+    int r;
+    uint64_t count = 0;
+    for (r = 0; r < ranks; r++) {
+        count += (uint64_t) recvchunks[r];
+    }
+
+    size_t recvtotal;
+    char* recvbuf = mfu_exchange_all(&ex, &recvtotal);
+
+    /* writers now hold the chunks they are to write */
+    mfu_copy_remote_chunk* chunks = mfu_copy_remote_chunk_unpack_all(recvbuf, count);
+
+    mfu_free(&recvbuf);
+
+    if (rank >= readers) {
+        /* determine destination names and tell our reader
+         * which chunks to send to us */
+        int reader = (rank - readers) % readers;
+        uint64_t bytes = 0;
+        for (i = 0; i < count; i++) {
+            chunks[i].dest = mfu_param_path_copy_dest(chunks[i].name, numpaths,
+                paths, destpath, copy_opts, mfu_src_file, mfu_dst_file);
+            if (chunks[i].dest != NULL) {
+                bytes += mfu_copy_remote_chunk_pack_size(chunks[i].name);
+            }
+        }
+
+        char* buf = (char*) MFU_MALLOC((size_t) bytes);
+        char* ptr = buf;
+        uint64_t header[2] = {0, bytes};
+        for (i = 0; i < count; i++) {
+            mfu_copy_remote_chunk* c = &chunks[i];
+            if (c->dest != NULL) {
+                mfu_copy_remote_chunk_pack(&ptr, c->name, c->offset, c->length, c->file_size);
+                header[0]++;
+
+                /* add bytes to our running total */
+                *total_count += c->length;
+            }
+        }
+        MPI_Send(header, 2, MPI_UINT64_T, reader, 0, comm);
+        MPI_Send(buf, (int) bytes, MPI_BYTE, reader, 0, comm);
+        mfu_free(&buf);
+
+        mfu_copy_files_write(comm, reader, chunks, count, copy_opts, mfu_dst_file);
+    } else {
+        /* get list of chunks from each writer we serve */
+        int nstreams = (writers - rank + readers - 1) / readers;
+        mfu_copy_stream* streams = (mfu_copy_stream*) MFU_MALLOC(
+            (size_t) nstreams * sizeof(mfu_copy_stream));
+        int j;
+        for (j = 0; j < nstreams; j++) {
+            mfu_copy_stream* s = &streams[j];
+            s->writer = readers + rank + j * readers;
+
+            uint64_t header[2];
+            MPI_Recv(header, 2, MPI_UINT64_T, s->writer, 0, comm, MPI_STATUS_IGNORE);
+            char* buf = (char*) MFU_MALLOC((size_t) header[1]);
+            MPI_Recv(buf, (int) header[1], MPI_BYTE, s->writer, 0, comm, MPI_STATUS_IGNORE);
+            s->chunks = mfu_copy_remote_chunk_unpack_all(buf, header[0]);
+            s->count  = header[0];
+            s->cur    = 0;
+            s->done   = 0;
+            s->fd     = -1;
+            mfu_free(&buf);
+        }
+
+        mfu_copy_files_read(comm, streams, nstreams, copy_opts);
+
+        for (j = 0; j < nstreams; j++) {
+            mfu_copy_remote_chunk_free(&streams[j].chunks, streams[j].count);
+        }
+        mfu_free(&streams);
+    }
+
+    /* return result of each chunk to the rank that sent it */
+    int* results = (int*) MFU_MALLOC(count * sizeof(int));
+    for (i = 0; i < count; i++) {
+        results[i] = chunks[i].rc;
+    }
+    size_t* rcounts = (size_t*) MFU_MALLOC((size_t)ranks * sizeof(size_t));
+    size_t* rdisps  = (size_t*) MFU_MALLOC((size_t)ranks * sizeof(size_t));
+    size_t* sdisps  = (size_t*) MFU_MALLOC((size_t)ranks * sizeof(size_t));
+    size_t rtotal = 0;
+    size_t stotal = 0;
+    for (r = 0; r < ranks; r++) {
+        rcounts[r] = (size_t) recvchunks[r] * sizeof(int);
+        rdisps[r]  = rtotal;
+        sdisps[r]  = stotal;
+        rtotal += (size_t) recvchunks[r];
+        stotal += (size_t) sendchunks[r];
+    }
+    for (r = 0; r < ranks; r++) {
+        rdisps[r] *= sizeof(int);
+    }
+    size_t flags_size;
+    int* flags = (int*) mfu_alltoallv_bytes(results, rcounts, rdisps,
+        NULL, &flags_size, comm);
+
+    /* results come back in the order we packed chunks for each rank */
+    for (i = 0; i < list_count; i++) {
+        vals[i] = flags[sdisps[targets[i]]++];
+    }
+
+    mfu_free(&flags);
+    mfu_free(&sdisps);
+    mfu_free(&rdisps);
+    mfu_free(&rcounts);
+    mfu_free(&results);
+    mfu_copy_remote_chunk_free(&chunks, count);
+    mfu_free(&targets);
+    mfu_free(&recvchunks);
+    mfu_free(&sendchunks);
+
+    MPI_Comm_free(&comm);
+}
+
+/* compare chunks in state until the fraction of bytes compared
+ * catches up with the fraction copied, so that on each process the
+ * comparison advances together with the copy rather than after it,
+ * pass copied == copy_total to compare all remaining chunks */
+static void mfu_copy_compare_advance(
+    mfu_copy_compare_state_t* state,
+    uint64_t copied,
+    uint64_t copy_total)
+{
+    while (state->index < state->count) {
+        /* stop once our share of comparison is ahead of the copy */
+        if (copied < copy_total &&
+            (double)state->bytes * (double)copy_total > (double)copied * (double)state->total_bytes)
+        {
+            break;
+        }
+
+        const mfu_file_chunk* src_p = state->src_p;
+        const mfu_file_chunk* dst_p = state->dst_p;
+
+        /* compare the chunk and replace destination data that differs */
+        uint64_t bytes_read    = 0;
+        uint64_t bytes_written = 0;
+        int compare_rc = mfu_compare_contents_ctx(state->ctx, src_p->name, dst_p->name,
+            (off_t)src_p->offset, (off_t)src_p->length, (off_t)src_p->file_size,
+            1, &bytes_read, &bytes_written, NULL);
+        if (compare_rc == -1) {
+            /* consider the files to be different so they stand out */
+            MFU_LOG(MFU_LOG_ERR,
+              "Failed to open, lseek, or read %s and/or %s. Assuming contents are different.",
+                 src_p->name, dst_p->name);
+            state->rc = -1;
+            compare_rc = 1;
+        }
+        state->vals[state->index] = compare_rc;
+
+        /* count compared bytes in copy progress messages */
+        state->bytes += src_p->length;
+        copy_count += src_p->length;
+        mfu_progress_update(&copy_count, copy_prog);
+
+        state->src_p = src_p->next;
+        state->dst_p = dst_p->next;
+        state->index++;
+    }
+}
+
 /* slices files in list at boundaries of chunk size, evenly distributes
  * chunks, and copies data from source to destination file,
  * returns 0 on success and -1 on error */
@@ -2108,6 +2598,7 @@ static int mfu_copy_files(
     int numpaths,
     const mfu_param_path* paths,
     const mfu_param_path* destpath,
+    mfu_copy_compare_t* cmp,
     mfu_copy_opts_t* copy_opts,
     mfu_file_t* mfu_src_file,
     mfu_file_t* mfu_dst_file)
@@ -2134,6 +2625,17 @@ static int mfu_copy_files(
         }
     }
 
+    /* include bytes of files we compare while copying */
+    if (cmp != NULL) {
+        uint64_t cmp_size = mfu_flist_size(cmp->src_list);
+        for (idx = 0; idx < cmp_size; idx++) {
+            mfu_filetype type = mfu_flist_file_get_type(cmp->src_list, idx);
+            if (type == MFU_TYPE_FILE) {
+                bytes += mfu_flist_file_get_size(cmp->src_list, idx);
+            }
+        }
+    }
+
     /* get total for print percent progress while creating */
     copy_total_count = 0;
     MPI_Allreduce(&bytes, &copy_total_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
@@ -2167,40 +2669,104 @@ static int mfu_copy_files(
      * to be used as input to logical OR to determine state of entire file */
     int* vals = (int*) MFU_MALLOC(list_count * sizeof(int));
 
-    /* loop over and copy data for each file section we're responsible for */
-    uint64_t i;
-    const mfu_file_chunk* p = head;
-    for (i = 0; i < list_count; i++) {
-         /* assume we'll succeed in copying this chunk */
-         vals[i] = 0;
-
-        /* get name of destination file */
-        char* dest = mfu_param_path_copy_dest(p->name, numpaths,
-                paths, destpath, copy_opts, mfu_src_file, mfu_dst_file);
-        if (dest == NULL) {
-            /* No need to copy it */
-            p = p->next;
-            continue;
+    /* split files to compare into chunks the same way */
+    mfu_file_chunk* cmp_src_head = NULL;
+    mfu_file_chunk* cmp_dst_head = NULL;
+    mfu_copy_compare_state_t cmp_state;
+    memset(&cmp_state, 0, sizeof(cmp_state));
+    if (cmp != NULL) {
+        cmp_src_head = mfu_file_chunk_list_alloc(cmp->src_list, copy_opts->chunk_size);
+        cmp_dst_head = mfu_file_chunk_list_alloc(cmp->dst_list, copy_opts->chunk_size);
+
+        cmp_state.src_p = cmp_src_head;
+        cmp_state.dst_p = cmp_dst_head;
+        cmp_state.count = mfu_file_chunk_list_size(cmp_src_head);
+        cmp_state.vals  = (int*) MFU_MALLOC(cmp_state.count * sizeof(int));
+        cmp_state.ctx   = mfu_compare_ctx_new(copy_opts, mfu_src_file, mfu_dst_file);
+
+        const mfu_file_chunk* p;
+        for (p = cmp_src_head; p != NULL; p = p->next) {
+            cmp_state.total_bytes += p->length;
         }
+    }
 
-        /* add bytes to our running total */
-        total_count += (uint64_t)p->length;
+    /* total bytes of copy chunks on this process,
+     * used to pace the comparison against the copy */
+    uint64_t copy_local_bytes = 0;
+    const mfu_file_chunk* chunk_p;
+    for (chunk_p = head; chunk_p != NULL; chunk_p = chunk_p->next) {
+        copy_local_bytes += chunk_p->length;
+    }
 
-        /* copy portion of file corresponding to this chunk,
-         * and record whether copy operation succeeded */
-        int copy_rc = mfu_copy_file(p->name, dest, (uint64_t)p->offset,
-                (uint64_t)p->length, (uint64_t)p->file_size, copy_opts,
-                mfu_src_file, mfu_dst_file);
-        if (copy_rc < 0) {
-            /* error copying file */
-            vals[i] = 1;
+    /* decide whether to split ranks into readers and writers */
+    int split = (mfu_copy_readers(copy_opts, mfu_src_file) > 0);
+    if (copy_opts->reader_ranks > 0 && !split && rank == 0) {
+        int ranks;
+        MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+        if (copy_opts->reader_ranks >= ranks) {
+            MFU_LOG(MFU_LOG_WARN, "Need fewer than %d data readers to leave ranks for writing, "
+                "copying with all ranks", ranks);
+        } else {
+            MFU_LOG(MFU_LOG_WARN, "Data readers require a POSIX source, copying with all ranks");
         }
+    }
 
-        /* free the dest name */
-        mfu_free(&dest);
+    uint64_t i;
+    if (split) {
+        /* readers ship data to writers over MPI */
+        mfu_copy_files_split(head, list_count, vals, numpaths, paths,
+            destpath, copy_opts, mfu_src_file, mfu_dst_file, &total_count);
+    } else {
+        /* loop over and copy data for each file section we're responsible for */
+        const mfu_file_chunk* p = head;
+        uint64_t copied = 0;
+        for (i = 0; i < list_count; i++) {
+             /* assume we'll succeed in copying this chunk */
+             vals[i] = 0;
+
+            /* keep any comparison in step with the copy */
+            if (cmp != NULL) {
+                mfu_copy_compare_advance(&cmp_state, copied, copy_local_bytes);
+            }
+            copied += p->length;
 
-        /* update pointer to next element */
-        p = p->next;
+            /* get name of destination file */
+            char* dest = mfu_param_path_copy_dest(p->name, numpaths,
+                    paths, destpath, copy_opts, mfu_src_file, mfu_dst_file);
+            if (dest == NULL) {
+                /* No need to copy it */
+                p = p->next;
+                continue;
+            }
+
+            /* add bytes to our running total */
+            total_count += (uint64_t)p->length;
+
+            /* copy portion of file corresponding to this chunk,
+             * and record whether copy operation succeeded */
+            int copy_rc = mfu_copy_file(p->name, dest, (uint64_t)p->offset,
+                    (uint64_t)p->length, (uint64_t)p->file_size, copy_opts,
+                    mfu_src_file, mfu_dst_file);
+            if (copy_rc < 0) {
+                /* error copying file */
+                vals[i] = 1;
+            }
+
+            /* free the dest name */
+            mfu_free(&dest);
+
+            /* update pointer to next element */
+            p = p->next;
+        }
+    }
+
+    /* compare any chunks left once the copy is done */
+    if (cmp != NULL) {
+        mfu_copy_compare_advance(&cmp_state, copy_local_bytes, copy_local_bytes);
+        mfu_compare_ctx_free(&cmp_state.ctx);
+        if (cmp_state.rc != 0) {
+            rc = -1;
+        }
     }
 
     /* close files */
@@ -2262,6 +2828,16 @@ static int mfu_copy_files(
     /* free the list of file chunks */
     mfu_file_chunk_list_free(&head);
 
+    /* determine which compared files differed */
+    if (cmp != NULL) {
+        mfu_file_chunk_list_lor(cmp->src_list, cmp_src_head, cmp_state.vals, cmp->results);
+        cmp->done = 1;
+
+        mfu_free(&cmp_state.vals);
+        mfu_file_chunk_list_free(&cmp_src_head);
+        mfu_file_chunk_list_free(&cmp_dst_head);
+    }
+
     /* finalize progress messages for the copy */
     mfu_progress_complete(&copy_count, &copy_prog);
 
@@ -2424,11 +3000,60 @@ static void print_summary(mfu_flist flist)
     return;
 }
 
-int mfu_flist_copy(
+/* copy items in src_cp_list, and if cmp is not NULL, compare the
+ * files it names during the data phase */
+/* map items evenly over all ranks, except those we must still read
+ * from the source to create or set metadata, which go to the readers */
+static int map_readers(mfu_flist flist, uint64_t idx, int ranks, const void* args)
+{
+    const mfu_copy_opts_t* copy_opts = (const mfu_copy_opts_t*) args;
+
+    /* compute global index of this item */
+    uint64_t global_idx = mfu_flist_global_offset(flist) + idx;
+
+    /* symlinks need readlink on the source */
+    mfu_filetype type = mfu_flist_file_get_type(flist, idx);
+    int source = (type == MFU_TYPE_LINK);
+
+    /* xattrs are read from the source unless the walk captured them */
+    size_t size;
+    if (copy_opts->copy_xattrs != XATTR_COPY_NONE &&
+        mfu_flist_file_get_xattrs(flist, idx, &size) == NULL)
+    {
+        source = 1;
+    }
+
+#ifdef GPFS_SUPPORT
+    /* GPFS ACLs are read from the source */
+    if (copy_opts->preserve) {
+        source = 1;
+    }
+#endif
+
+    if (source) {
+        return (int) (global_idx % (uint64_t) copy_opts->reader_ranks);
+    }
+    return (int) (global_idx % (uint64_t) ranks);
+}
+
+/* spread items over ranks to create them and set their metadata */
+static mfu_flist mfu_copy_spread(
+    mfu_flist list,
+    const mfu_copy_opts_t* copy_opts,
+    const mfu_file_t* mfu_src_file)
+{
+    if (mfu_copy_readers(copy_opts, mfu_src_file) > 0) {
+        return mfu_flist_remap(list, map_readers, copy_opts);
+    }
+    return mfu_flist_spread(list);
+}
+
+static int mfu_flist_copy_common(
     mfu_flist src_cp_list,          /* list of source items to be copied */
     int numpaths,                   /* number of entries in paths array below */
     const mfu_param_path* paths,    /* list of paths, each source item is from one path in this list */
     const mfu_param_path* destpath, /* destination path to copy items to */
+    mfu_copy_compare_t* cmp,        /* files to compare while copying, or NULL */
     mfu_copy_opts_t* copy_opts,     /* options to configure how copy is executed */
     mfu_file_t* mfu_src_file,       /* whether source items are coming from POSIX/DAOS */
     mfu_file_t* mfu_dst_file)       /* whether destination is in POSIX/DAOS */
@@ -2459,10 +3084,10 @@ int mfu_flist_copy(
     /* TODO: consider file system striping params here */
     /* hard code some configurables for now */
 
-    /* allocate buffer to read/write files, aligned on 1MB boundaraies */
+    /* get buffers to read/write files from the pool, aligned on 1MB boundaries */
     size_t alignment = 1024*1024;
-    copy_opts->block_buf1 = (char*) MFU_MEMALIGN(copy_opts->buf_size, alignment);
-    copy_opts->block_buf2 = (char*) MFU_MEMALIGN(copy_opts->buf_size, alignment);
+    copy_opts->block_buf1 = (char*) MFU_BUF_GET(copy_opts->buf_size, alignment);
+    copy_opts->block_buf2 = (char*) MFU_BUF_GET(copy_opts->buf_size, alignment);
 
     /* Grab a relative and actual start time for the epilogue. */
     time(&(mfu_copy_stats.time_started));
@@ -2479,6 +3104,14 @@ int mfu_flist_copy(
     mfu_copy_src_cache.name = NULL;
     mfu_copy_dst_cache.name = NULL;
 
+    /* with data readers, the walk left items on the reader ranks,
+     * so spread them out to create them from every rank */
+    mfu_flist spread_cp_list = NULL;
+    if (mfu_copy_readers(copy_opts, mfu_src_file) > 0) {
+        spread_cp_list = mfu_copy_spread(src_cp_list, copy_opts, mfu_src_file);
+        src_cp_list = spread_cp_list;
+    }
+
     /* split items in file list into sublists depending on their
      * directory depth */
     int levels, minlevel;
@@ -2542,7 +3175,7 @@ int mfu_flist_copy(
             uint64_t tmplist_size = mfu_flist_global_size(tmplist);
             if (tmplist_size > 0) {
                 /* spread items evenly over ranks */
-                mfu_flist spreadlist = mfu_flist_spread(tmplist);
+                mfu_flist spreadlist = mfu_copy_spread(tmplist, copy_opts, mfu_src_file);
 
                 /* split items in file list into sublists depending on their
                  * directory depth */
@@ -2557,9 +3190,13 @@ int mfu_flist_copy(
                     rc = -1;
                 }
 
-                /* copy data */
+                /* copy data, comparing files along with the first batch */
+                mfu_copy_compare_t* batch_cmp = NULL;
+                if (cmp != NULL && !cmp->done) {
+                    batch_cmp = cmp;
+                }
                 tmp_rc = mfu_copy_files(spreadlist, numpaths, paths, destpath,
-                    copy_opts, mfu_src_file, mfu_dst_file);
+                    batch_cmp, copy_opts, mfu_src_file, mfu_dst_file);
                 if (tmp_rc < 0) {
                     rc = -1;
                 }
@@ -2655,6 +3292,18 @@ int mfu_flist_copy(
             }
         }
 
+        /* if no batch had files to copy, compare on our own */
+        if (cmp != NULL && !cmp->done) {
+            mfu_flist emptylist = mfu_flist_subset(src_cp_list);
+            mfu_flist_summarize(emptylist);
+            tmp_rc = mfu_copy_files(emptylist, numpaths, paths, destpath,
+                cmp, copy_opts, mfu_src_file, mfu_dst_file);
+            if (tmp_rc < 0) {
+                rc = -1;
+            }
+            mfu_flist_free(&emptylist);
+        }
+
         /* set permissions, ownership, and timestamps if needed */
         mfu_copy_set_metadata_dirs(levels, minlevel, lists, numpaths,
                 paths, destpath, copy_opts, mfu_src_file, mfu_dst_file);
@@ -2673,7 +3322,7 @@ int mfu_flist_copy(
 
         /* copy data */
         tmp_rc = mfu_copy_files(src_cp_list, numpaths, paths, destpath,
-            copy_opts, mfu_src_file, mfu_dst_file);
+            cmp, copy_opts, mfu_src_file, mfu_dst_file);
         if (tmp_rc < 0) {
             rc = -1;
         }
@@ -2693,9 +3342,14 @@ int mfu_flist_copy(
     /* free our lists of levels */
     mfu_flist_array_free(levels, &lists);
 
-    /* free buffers */
-    mfu_free(&copy_opts->block_buf1);
-    mfu_free(&copy_opts->block_buf2);
+    /* free the list we spread for data readers */
+    if (spread_cp_list != NULL) {
+        mfu_flist_free(&spread_cp_list);
+    }
+
+    /* return buffers to the pool */
+    mfu_buf_put(&copy_opts->block_buf1);
+    mfu_buf_put(&copy_opts->block_buf2);
 
     /* Determine the actual and relative end time for the epilogue. */
     mfu_copy_stats.wtime_ended = MPI_Wtime();
@@ -2778,6 +3432,41 @@ int mfu_flist_copy(
     return rc;
 }
 
+int mfu_flist_copy(
+    mfu_flist src_cp_list,          /* list of source items to be copied */
+    int numpaths,                   /* number of entries in paths array below */
+    const mfu_param_path* paths,    /* list of paths, each source item is from one path in this list */
+    const mfu_param_path* destpath, /* destination path to copy items to */
+    mfu_copy_opts_t* copy_opts,     /* options to configure how copy is executed */
+    mfu_file_t* mfu_src_file,       /* whether source items are coming from POSIX/DAOS */
+    mfu_file_t* mfu_dst_file)       /* whether destination is in POSIX/DAOS */
+{
+    return mfu_flist_copy_common(src_cp_list, numpaths, paths, destpath,
+        NULL, copy_opts, mfu_src_file, mfu_dst_file);
+}
+
+int mfu_flist_copy_compare(
+    mfu_flist src_cp_list,
+    int numpaths,
+    const mfu_param_path* paths,
+    const mfu_param_path* destpath,
+    mfu_flist src_cmp_list,
+    mfu_flist dst_cmp_list,
+    int* results,
+    mfu_copy_opts_t* copy_opts,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file)
+{
+    mfu_copy_compare_t cmp;
+    cmp.src_list = src_cmp_list;
+    cmp.dst_list = dst_cmp_list;
+    cmp.results  = results;
+    cmp.done     = 0;
+
+    return mfu_flist_copy_common(src_cp_list, numpaths, paths, destpath,
+        &cmp, copy_opts, mfu_src_file, mfu_dst_file);
+}
+
 /* hold state for progress messages */
 static mfu_progress* fill_prog;
 
@@ -2836,8 +3525,11 @@ static int mfu_fill_file(
     mfu_copy_opts_t* copy_opts,
     mfu_file_t* mfu_file)
 {
+    /* only use O_DIRECT if the file is large enough to benefit */
+    int direct = mfu_direct_enabled(copy_opts, file_size);
+
     /* open the file */
-    int ret = mfu_copy_open_file(dest, 0, &mfu_copy_dst_cache, copy_opts, mfu_file);
+    int ret = mfu_copy_open_file(dest, 0, &mfu_copy_dst_cache, copy_opts, direct, mfu_file);
     if (ret) {
         MFU_LOG(MFU_LOG_ERR, "Failed to open output file `%s' (errno=%d %s)",
             dest, errno, strerror(errno));
@@ -2845,40 +3537,53 @@ static int mfu_fill_file(
     }
     int out_fd = mfu_file->fd;
 
-    /* seek to offset in file */
-    if (mfu_lseek(dest, out_fd, offset, SEEK_SET) == (off_t)-1) {
-        MFU_LOG(MFU_LOG_ERR, "Couldn't seek in destination path `%s' (errno=%d %s)",
-            dest, errno, strerror(errno));
-        return -1;
-    }
-
     /* get buffer */
     size_t buf_size = copy_opts->buf_size;
     void* buf = copy_opts->block_buf1;
 
+    /* determine which portion of our chunk can use O_DIRECT,
+     * unaligned bytes at the head and tail use buffered I/O,
+     * there is no source file so align to the destination alone */
+    off_t direct_start, direct_end;
+    size_t direct_size;
+    mfu_direct_range(copy_opts, mfu_file, mfu_file,
+        (off_t) offset, (off_t) length, (off_t) file_size,
+        &direct_start, &direct_end, &direct_size);
+
+    /* the cached file may be left in either mode by an earlier
+     * chunk, so use -1 to force a check on the first write */
+    int direct_on = -1;
+
     /* fill buffer with data */
 
     /* write data */
+    off_t off = (off_t) offset;
+    off_t end = (off_t) (offset + length);
     size_t total_bytes = 0;
     while (total_bytes < (size_t)length) {
-        /* determine number of bytes that we
-         * can read = max(buf size, remaining chunk) */
-        size_t bytes_to_write = (size_t)length - total_bytes;
-        if (bytes_to_write > buf_size) {
-            bytes_to_write = buf_size;
-        }
-
-        /* compute number of bytes to write */
-        if (copy_opts->direct) {
-            /* O_DIRECT requires particular write sizes,
-             * ok to write beyond end of file so long as
-             * we truncate in cleanup step */
-            /* assumes buf_size is magic size for O_DIRECT */
-            bytes_to_write = buf_size;
+        /* determine number of bytes to write,
+         * and whether this write is aligned for O_DIRECT */
+        int use_direct;
+        size_t bytes_to_write = mfu_direct_next(off, end, buf_size,
+            direct_start, direct_end, direct_size, &use_direct);
+
+        /* switch file between direct and buffered modes if needed */
+        if (direct && direct_on != use_direct) {
+            if (mfu_file_set_direct(dest, mfu_file, use_direct) != 0) {
+                /* fall back to buffered I/O for the rest of this chunk */
+                MFU_LOG(MFU_LOG_DBG, "Failed to toggle O_DIRECT on `%s' (errno=%d %s)",
+                    dest, errno, strerror(errno));
+                mfu_file_set_direct(dest, mfu_file, 0);
+                direct_size = 0;
+                use_direct  = 0;
+                bytes_to_write = mfu_direct_next(off, end, buf_size,
+                    direct_start, direct_end, direct_size, &use_direct);
+            }
         }
+        direct_on = use_direct;
 
         /* write bytes to destination file */
-        ssize_t num_of_bytes_written = mfu_write(dest, out_fd, buf, bytes_to_write);
+        ssize_t num_of_bytes_written = mfu_pwrite(dest, out_fd, buf, bytes_to_write, off);
 
         /* check for an error */
         if (num_of_bytes_written < 0) {
@@ -2887,15 +3592,15 @@ static int mfu_fill_file(
             return -1;
         }
 
-        /* check that we wrote the same number of bytes that we read */
+        /* check that we wrote the number of bytes we asked for */
         if ((size_t)num_of_bytes_written != bytes_to_write) {
             MFU_LOG(MFU_LOG_ERR, "Write error when writing to `%s'",
                 dest);
             return -1;
         }
 
-        /* add bytes to our total (use bytes read,
-         * which may be less than number written) */
+        /* add bytes to our total */
+        off += (off_t) num_of_bytes_written;
         total_bytes += (size_t) num_of_bytes_written;
 
         /* update number of bytes we have written for progress messages */
@@ -2936,9 +3641,9 @@ int mfu_flist_fill(mfu_flist list, mfu_copy_opts_t* copy_opts, mfu_file_t* mfu_f
 {
     int rc = MFU_SUCCESS;
 
-    /* allocate buffer to write files, aligned on 1MB boundaraies */
+    /* get buffer to write files from the pool, aligned on 1MB boundaries */
     size_t alignment = 1024*1024;
-    copy_opts->block_buf1 = (char*) MFU_MEMALIGN(copy_opts->buf_size, alignment);
+    copy_opts->block_buf1 = (char*) MFU_BUF_GET(copy_opts->buf_size, alignment);
 
     /* fill buffer with data */
     //memset(copy_opts->block_buf1, 0, copy_opts->buf_size);
@@ -3287,6 +3992,156 @@ int mfu_flist_file_sync_meta(mfu_flist src_list, uint64_t src_index,
     return rc;
 }
 
+/* search xattrs in buf for one named name, returns 1 and sets val
+ * and val_size if found, 0 otherwise */
+static int mfu_xattrs_find(
+    const void* buf,
+    size_t size,
+    const char* name,
+    const void** val,
+    size_t* val_size)
+{
+    const char* n;
+    const void* v;
+    size_t vsize;
+    size_t pos = mfu_xattrs_next(buf, size, 0, &n, &v, &vsize);
+    while (pos != 0) {
+        if (strcmp(n, name) == 0) {
+            *val      = v;
+            *val_size = vsize;
+            return 1;
+        }
+        pos = mfu_xattrs_next(buf, size, pos, &n, &v, &vsize);
+    }
+    return 0;
+}
+
+int mfu_xattrs_match(const void* a, size_t a_size, const void* b, size_t b_size)
+{
+    /* names are unique within a set, so the sets match if they hold
+     * the same number of pairs and every pair of a is in b */
+    uint32_t a_count = 0;
+    uint32_t b_count = 0;
+    if (a_size >= 4) {
+        const char* ptr = (const char*) a;
+        mfu_unpack_uint32(&ptr, &a_count);
+    }
+    if (b_size >= 4) {
+        const char* ptr = (const char*) b;
+        mfu_unpack_uint32(&ptr, &b_count);
+    }
+    if (a_count != b_count) {
+        return 0;
+    }
+
+    const char* name;
+    const void* val;
+    size_t val_size;
+    size_t pos = mfu_xattrs_next(a, a_size, 0, &name, &val, &val_size);
+    while (pos != 0) {
+        const void* b_val;
+        size_t b_val_size;
+        if (! mfu_xattrs_find(b, b_size, name, &b_val, &b_val_size) ||
+            b_val_size != val_size ||
+            memcmp(b_val, val, val_size) != 0)
+        {
+            return 0;
+        }
+        pos = mfu_xattrs_next(a, a_size, pos, &name, &val, &val_size);
+    }
+    return 1;
+}
+
+int mfu_flist_file_sync_xattrs(mfu_flist src_list, uint64_t src_index,
+                               const char* dest_path,
+                               mfu_copy_opts_t* copy_opts,
+                               mfu_file_t* mfu_src_file,
+                               mfu_file_t* mfu_dst_file)
+{
+    /* assume we'll succeed */
+    int rc = 0;
+
+#if DCOPY_USE_XATTRS
+    /* nothing to do if we are not asked to copy xattrs */
+    attr_copy_t filter = copy_opts->copy_xattrs;
+    if (filter == XATTR_COPY_NONE || filter == XATTR_COPY_INVAL) {
+        return rc;
+    }
+
+    /* use the xattrs captured during the walk if we have them,
+     * otherwise read them from the source now */
+    void* src_alloc = NULL;
+    size_t src_size;
+    const void* src_buf = mfu_flist_file_get_xattrs(src_list, src_index, &src_size);
+    if (src_buf == NULL) {
+        const char* src_path = mfu_flist_file_get_name(src_list, src_index);
+        if (mfu_xattrs_read(src_path, filter, copy_opts->dereference,
+            mfu_src_file, &src_alloc, &src_size) != 0)
+        {
+            mfu_free(&src_alloc);
+            return -1;
+        }
+        src_buf = src_alloc;
+    }
+
+    /* read the current xattrs on the destination */
+    void* dst_buf = NULL;
+    size_t dst_size;
+    if (mfu_xattrs_read(dest_path, filter, 0, mfu_dst_file, &dst_buf, &dst_size) != 0) {
+        mfu_free(&src_alloc);
+        mfu_free(&dst_buf);
+        return -1;
+    }
+
+    /* set any source xattr that is missing or different on the destination */
+    const char* name;
+    const void* val;
+    size_t val_size;
+    size_t pos = mfu_xattrs_next(src_buf, src_size, 0, &name, &val, &val_size);
+    while (pos != 0) {
+        const void* dst_val;
+        size_t dst_val_size;
+        if (mfu_xattrs_select(name, filter)) {
+            int found = mfu_xattrs_find(dst_buf, dst_size, name, &dst_val, &dst_val_size);
+            if (!found || dst_val_size != val_size || memcmp(dst_val, val, val_size) != 0) {
+                errno = 0;
+                int setrc = mfu_file_lsetxattr(dest_path, name, val, val_size, 0, mfu_dst_file);
+                if (setrc != 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Failed to set value for name=%s on `%s' lsetxattr() (errno=%d %s)",
+                        name, dest_path, errno, strerror(errno)
+                       );
+                    rc = -1;
+                }
+            }
+        }
+        pos = mfu_xattrs_next(src_buf, src_size, pos, &name, &val, &val_size);
+    }
+
+    /* remove destination xattrs that the source does not have */
+    pos = mfu_xattrs_next(dst_buf, dst_size, 0, &name, &val, &val_size);
+    while (pos != 0) {
+        const void* src_val;
+        size_t src_val_size;
+        if (!mfu_xattrs_find(src_buf, src_size, name, &src_val, &src_val_size)) {
+            errno = 0;
+            int rmrc = mfu_file_lremovexattr(dest_path, name, mfu_dst_file);
+            if (rmrc != 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to remove name=%s on `%s' lremovexattr() (errno=%d %s)",
+                    name, dest_path, errno, strerror(errno)
+                   );
+                rc = -1;
+            }
+        }
+        pos = mfu_xattrs_next(dst_buf, dst_size, pos, &name, &val, &val_size);
+    }
+
+    mfu_free(&dst_buf);
+    mfu_free(&src_alloc);
+#endif /* DCOPY_USE_XATTRS */
+
+    return rc;
+}
+
 /* return a newly allocated mfu_file structure, set default values on its fields */
 mfu_file_t* mfu_file_new(void)
 {
@@ -3341,6 +4196,9 @@ mfu_copy_opts_t* mfu_copy_opts_new(void)
     /* By default, don't use O_DIRECT. */
     opts->direct = false;
 
+    /* When O_DIRECT is enabled, use it for files of any size */
+    opts->direct_threshold = 0;
+
     /* By default, don't use O_NOATIME. */
     opts->open_noatime = false;
 
@@ -3361,6 +4219,16 @@ mfu_copy_opts_t* mfu_copy_opts_new(void)
     /* By default, do not limit the batch size */
     opts->batch_files = 0;
 
+    /* By default, create files without a size-based layout or preallocation,
+     * if set, this is freed in mfu_copy_opts_delete */
+    opts->create_opts = NULL;
+
+    /* By default, every rank both reads and writes file data */
+    opts->reader_ranks = 0;
+
+    /* By default, don't read or write cached digests */
+    opts->digest_cache = 0;
+
     return opts;
 }
 
@@ -3373,8 +4241,11 @@ void mfu_copy_opts_delete(mfu_copy_opts_t** popts)
     if (opts != NULL) {
       mfu_free(&opts->dest_path);
       mfu_free(&opts->input_file);
-      mfu_free(&opts->block_buf1);
-      mfu_free(&opts->block_buf2);
+      mfu_buf_put(&opts->block_buf1);
+      mfu_buf_put(&opts->block_buf2);
+      if (opts->create_opts != NULL) {
+        mfu_create_opts_delete(&opts->create_opts);
+      }
     }
 
     mfu_free(popts);
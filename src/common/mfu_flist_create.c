@@ -1,5 +1,6 @@
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "mfu.h"
 #include "mfu_flist_internal.h"
@@ -202,7 +203,100 @@ static void mknod_progress_fn(const uint64_t* vals, int count, int complete, int
     }
 }
 
-static int create_file(mfu_flist list, uint64_t idx, mfu_create_opts_t* opts)
+/* upper limit on stripe count when scaling stripes with file size,
+ * matches LOV_MAX_STRIPE_COUNT in Lustre */
+#define MFU_STRIPE_COUNT_MAX (2000)
+
+/* compute number of stripes to use for a file of the given size */
+static int create_stripe_count(const mfu_create_opts_t* opts, uint64_t size)
+{
+    /* by default, use the stripe count as given */
+    int count = (int) opts->lustre_stripe_count;
+
+    /* otherwise, use one stripe per lustre_stripe_bytes,
+     * treating the stripe count as an upper limit */
+    uint64_t bytes = opts->lustre_stripe_bytes;
+    if (bytes > 0) {
+        uint64_t want = (size + bytes - 1) / bytes;
+        if (want == 0) {
+            want = 1;
+        }
+        if (want > MFU_STRIPE_COUNT_MAX) {
+            want = MFU_STRIPE_COUNT_MAX;
+        }
+        if (count <= 0 || want < (uint64_t) count) {
+            count = (int) want;
+        }
+    }
+
+    return count;
+}
+
+int mfu_create_layout(const char* name, uint64_t size, const mfu_create_opts_t* opts)
+{
+    /* nothing to do unless user requested striping */
+    if (opts == NULL || ! opts->lustre_stripe) {
+        return 0;
+    }
+
+    /* only stripe files that are large enough */
+    if (size < opts->lustre_stripe_minsize) {
+        return 0;
+    }
+
+    /* If we are overwriting files, preemptively delete any existing entry.
+     * Once a file exists, its striping parameters can't be changed. */
+    if (opts->overwrite) {
+        mfu_unlink(name);
+    }
+
+    /* file size is big enough, let's stripe */
+    uint64_t stripe_width = opts->lustre_stripe_width;
+    int stripe_count = create_stripe_count(opts, size);
+    mfu_stripe_set(name, stripe_width, stripe_count);
+
+    return 1;
+}
+
+int mfu_create_preallocate(const char* name, uint64_t size, const mfu_create_opts_t* opts, mfu_file_t* mfu_file)
+{
+    /* nothing to do unless user requested preallocation */
+    if (opts == NULL || ! opts->preallocate) {
+        return 0;
+    }
+
+    /* skip empty and small files */
+    if (size == 0 || size < opts->preallocate_minsize) {
+        return 0;
+    }
+
+    /* open the file for writing, this also instantiates any
+     * layout that was set through xattrs */
+    int rc = mfu_file_open(name, O_WRONLY, mfu_file);
+    if (rc != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' to preallocate (errno=%d %s)",
+            name, errno, strerror(errno));
+        return -1;
+    }
+
+    /* reserve blocks for the full file size,
+     * not all file systems support this so just skip it if so */
+    rc = mfu_file_fallocate(name, mfu_file, 0, (off_t) size);
+    if (rc < 0) {
+        if (errno == EOPNOTSUPP || errno == ENOSYS) {
+            rc = 0;
+        } else {
+            MFU_LOG(MFU_LOG_ERR, "Failed to preallocate %llu bytes for `%s' (errno=%d %s)",
+                (unsigned long long) size, name, errno, strerror(errno));
+        }
+    }
+
+    mfu_file_close(name, mfu_file);
+
+    return rc;
+}
+
+static int create_file(mfu_flist list, uint64_t idx, mfu_create_opts_t* opts, mfu_file_t* mfu_file)
 {
     /* get source name */
     const char* name = mfu_flist_file_get_name(list, idx);
@@ -211,24 +305,19 @@ static int create_file(mfu_flist list, uint64_t idx, mfu_create_opts_t* opts)
     //mode_t mode = (mode_t) mfu_flist_file_get_mode(list, idx);
     mode_t mode = DCOPY_DEF_PERMS_FILE;
 
+    /* get size of file */
+    uint64_t filesize = mfu_flist_file_get_size(list, idx);
+
     /* apply lustre striping to item if user requested it */
     if (opts->lustre_stripe) {
         /* can only stripe regular files (this true?) */
         mfu_filetype type = mfu_flist_file_get_type(list, idx);
         if (type == MFU_TYPE_FILE) {
-            /* got a regular file, check its size */
-            uint64_t filesize = mfu_flist_file_get_size(list, idx);
-            if (filesize >= opts->lustre_stripe_minsize) {
-                /* If we are overwriting files, preemptively delete any existing entry.
-                 * Once a file exists, its striping parameters can't be changed. */
-                if (opts->overwrite) {
-                    mfu_unlink(name);
+            /* got a regular file, stripe it if it's big enough */
+            if (mfu_create_layout(name, filesize, opts)) {
+                if (mfu_create_preallocate(name, filesize, opts, mfu_file) < 0) {
+                    return -1;
                 }
-
-                /* file size is big enough, let's stripe */
-                uint64_t stripe_width = opts->lustre_stripe_width;
-                int stripe_count = (int) opts->lustre_stripe_count;
-                mfu_stripe_set(name, stripe_width, stripe_count);
             }
         }
 
@@ -282,6 +371,11 @@ static int create_file(mfu_flist list, uint64_t idx, mfu_create_opts_t* opts)
         }
     }
 
+    /* reserve space for file data if requested */
+    if (mfu_create_preallocate(name, filesize, opts, mfu_file) < 0) {
+        return -1;
+    }
+
     /* TODO: set uid, gid, timestamps? */
 
     return 0;
@@ -326,6 +420,9 @@ void mfu_flist_mknod(mfu_flist flist, mfu_create_opts_t* opts)
     /* start progress messages while setting metadata */
     mfu_progress* mknod_prog = mfu_progress_start(mfu_progress_timeout, 1, MPI_COMM_WORLD, mknod_progress_fn);
 
+    /* files are created on a POSIX file system */
+    mfu_file_t* mfu_file = mfu_file_new();
+
     /* iterate over items and set write bit on directories if needed */
     count = 0;
     for (idx = 0; idx < size; idx++) {
@@ -333,7 +430,7 @@ void mfu_flist_mknod(mfu_flist flist, mfu_create_opts_t* opts)
         mfu_filetype type = mfu_flist_file_get_type(flist, idx);
         if (type == MFU_TYPE_FILE) {
             /* TODO: skip file if it's not readable */
-            create_file(flist, idx, opts);
+            create_file(flist, idx, opts, mfu_file);
 
             /* update our running count for progress messages */
             count++;
@@ -344,6 +441,8 @@ void mfu_flist_mknod(mfu_flist flist, mfu_create_opts_t* opts)
     /* finalize progress messages */
     mfu_progress_complete(&count, &mknod_prog);
 
+    mfu_file_delete(&mfu_file);
+
     /* wait for all procs to finish */
     MPI_Barrier(MPI_COMM_WORLD);
 
@@ -615,6 +714,15 @@ mfu_create_opts_t* mfu_create_opts_new(void)
     /* if applying lustre striping parameteres, number of stripes to use */
     opts->lustre_stripe_count = -1;
 
+    /* if not 0, scale stripe count with file size, using one stripe per this many bytes */
+    opts->lustre_stripe_bytes = 0;
+
+    /* whether to reserve space for file data when creating files */
+    opts->preallocate = false;
+
+    /* if preallocating, only consider files of at least minsize bytes */
+    opts->preallocate_minsize = 0;
+
     return opts;
 }
 
@@ -24,6 +24,15 @@ extern "C" {
  * Define types
  ***************************************/
 
+/* max number of bytes of xattrs to capture for an item during walk,
+ * items sorted or written to a cache file reserve space for the
+ * largest set in the list, so items with more than this are left
+ * to be read when needed */
+#define MFU_FLIST_XATTRS_MAX (4096)
+
+/* name of xattr used to cache chunk digests of a file */
+#define MFU_DIGEST_XATTR "user.mfu.digest"
+
 /* linked list element of stat data used during walk */
 typedef struct list_elem {
     char* file;             /* file name (strdup'd) */
@@ -40,6 +49,8 @@ typedef struct list_elem {
     uint64_t ctime;         /* create time */
     uint64_t ctime_nsec;    /* create time nanoseconds */
     uint64_t size;          /* file size in bytes */
+    char* xattrs;           /* xattr names and values captured during walk, NULL if not captured */
+    uint64_t xattrs_size;   /* number of bytes in xattrs */
     struct list_elem* next; /* pointer to next item */
     /* vars for a non-posix DAOS copy */
     uint64_t obj_id_lo;
@@ -65,6 +76,7 @@ typedef struct flist {
     uint64_t max_file_name;  /* maximum filename strlen()+1 in global list */
     uint64_t max_user_name;  /* maximum username strlen()+1 */
     uint64_t max_group_name; /* maximum groupname strlen()+1 */
+    uint64_t max_xattrs;     /* maximum size of captured xattrs in global list, 0 if none */
     int min_depth;           /* minimum file depth */
     int max_depth;           /* maximum file depth */
 
@@ -116,6 +128,10 @@ void mfu_flist_insert_elem(flist_t* flist, elem_t* elem);
 /* insert a file given its mode and optional stat data */
 void mfu_flist_insert_stat(flist_t* flist, const char* fpath, mode_t mode, const struct stat* sb);
 
+/* read xattrs of path that pass filter and attach them to the element
+ * at the tail of the list, used during walk */
+void mfu_flist_capture_xattrs(flist_t* flist, const char* path, attr_copy_t filter, int dereference, mfu_file_t* mfu_file);
+
 /* given path, return level within directory tree,
  * counts '/' characters assuming path is standardized
  * and absolute */
@@ -226,7 +226,7 @@ static void list_elem_decode(char* buf, elem_t* elem)
 
 /* create a datatype to hold file name and stat info */
 /* return number of bytes needed to pack element */
-static size_t list_elem_pack_size(int detail, uint64_t chars, const elem_t* elem)
+static size_t list_elem_pack_size(int detail, uint64_t chars, uint64_t xchars, const elem_t* elem)
 {
     size_t size;
     if (detail) {
@@ -235,11 +235,16 @@ static size_t list_elem_pack_size(int detail, uint64_t chars, const elem_t* elem
     else {
         size = chars + 1 * 4;
     }
+
+    /* size of xattrs followed by xattrs, if any */
+    if (xchars > 0) {
+        size += 4 + xchars;
+    }
     return size;
 }
 
 /* pack element into buffer and return number of bytes written */
-static size_t list_elem_pack(void* buf, int detail, uint64_t chars, const elem_t* elem)
+static size_t list_elem_pack(void* buf, int detail, uint64_t chars, uint64_t xchars, const elem_t* elem)
 {
     /* set pointer to start of buffer */
     char* start = (char*) buf;
@@ -267,12 +272,26 @@ static size_t list_elem_pack(void* buf, int detail, uint64_t chars, const elem_t
         mfu_pack_io_uint32(&ptr, elem->type);
     }
 
+    if (xchars > 0) {
+        /* copy in xattrs, a size of 0 means they were not captured */
+        uint32_t xattrs_size = 0;
+        if (elem->xattrs != NULL) {
+            xattrs_size = (uint32_t) elem->xattrs_size;
+        }
+        mfu_pack_io_uint32(&ptr, xattrs_size);
+        memset(ptr, 0, xchars);
+        if (xattrs_size > 0) {
+            memcpy(ptr, elem->xattrs, xattrs_size);
+        }
+        ptr += xchars;
+    }
+
     size_t bytes = (size_t)(ptr - start);
     return bytes;
 }
 
 /* unpack element from buffer and return number of bytes read */
-static size_t list_elem_unpack(const void* buf, int detail, uint64_t chars, elem_t* elem)
+static size_t list_elem_unpack(const void* buf, int detail, uint64_t chars, uint64_t xchars, elem_t* elem)
 {
     const char* start = (const char*) buf;
     const char* ptr = start;
@@ -309,6 +328,20 @@ static size_t list_elem_unpack(const void* buf, int detail, uint64_t chars, elem
         mfu_unpack_io_uint32(&ptr, &elem->type);
     }
 
+    /* extract xattrs if any */
+    elem->xattrs      = NULL;
+    elem->xattrs_size = 0;
+    if (xchars > 0) {
+        uint32_t xattrs_size;
+        mfu_unpack_io_uint32(&ptr, &xattrs_size);
+        if (xattrs_size > 0) {
+            elem->xattrs = (char*) MFU_MALLOC((size_t) xattrs_size);
+            memcpy(elem->xattrs, ptr, (size_t) xattrs_size);
+            elem->xattrs_size = (uint64_t) xattrs_size;
+        }
+        ptr += xchars;
+    }
+
     size_t bytes = (size_t)(ptr - start);
     return bytes;
 }
@@ -321,6 +354,8 @@ static void list_insert_decode(flist_t* flist, char* buf)
 
     /* decode buffer and store values in element */
     list_elem_decode(buf, elem);
+    elem->xattrs      = NULL;
+    elem->xattrs_size = 0;
 
     /* append element to tail of linked list */
     mfu_flist_insert_elem(flist, elem);
@@ -329,13 +364,13 @@ static void list_insert_decode(flist_t* flist, char* buf)
 }
 
 /* insert a file given a pointer to packed data */
-static size_t list_insert_ptr(flist_t* flist, char* ptr, int detail, uint64_t chars)
+static size_t list_insert_ptr(flist_t* flist, char* ptr, int detail, uint64_t chars, uint64_t xchars)
 {
     /* create new element to record file path, file type, and stat info */
     elem_t* elem = (elem_t*) MFU_MALLOC(sizeof(elem_t));
 
     /* get name and advance pointer */
-    size_t bytes = list_elem_unpack(ptr, detail, chars, elem);
+    size_t bytes = list_elem_unpack(ptr, detail, chars, xchars, elem);
 
     /* append element to tail of linked list */
     mfu_flist_insert_elem(flist, elem);
@@ -803,7 +838,7 @@ static void read_cache_v3(
             uint64_t packcount = 0;
             while (packcount < (uint64_t) read_count) {
                 /* unpack item from buffer and advance pointer */
-                list_insert_ptr(flist, ptr, 1, chars);
+                list_insert_ptr(flist, ptr, 1, chars, 0);
                 ptr += extent_file;
                 packcount++;
             }
@@ -837,12 +872,15 @@ static void read_cache_v3(
  *   uint64_t max groupname length
  *   uint64_t total number of files
  *   uint64_t max filename length
+ *   uint64_t max xattrs length (version 5 only)
  *   list of <username(str), userid(uint64_t)>
  *   list of <groupname(str), groupid(uint64_t)>
  *   list of <files(str)>
- *   */
+ *
+ * version 5 is version 4 with captured xattrs appended to each file record */
 static void read_cache_v4(
     const char* name,
+    uint64_t version,
     MPI_Offset* outdisp,
     MPI_File fh,
     const char* datarep,
@@ -864,9 +902,11 @@ static void read_cache_v4(
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
-    /* rank 0 reads and broadcasts header */
-    uint64_t header[6];
-    int header_size = 6 * 8; /* 6 consecutive uint64_t */
+    /* rank 0 reads and broadcasts header,
+     * version 5 adds a field for length of xattrs */
+    int header_count = (version == 5) ? 7 : 6;
+    uint64_t header[7] = {0};
+    int header_size = header_count * 8; /* consecutive uint64_t */
     int mpirc = MPI_File_set_view(fh, disp, MPI_BYTE, MPI_BYTE, datarep, MPI_INFO_NULL);
     if (mpirc != MPI_SUCCESS) {
         MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
@@ -874,7 +914,7 @@ static void read_cache_v4(
     }
 
     if (rank == 0) {
-        uint64_t header_packed[6];
+        uint64_t header_packed[7];
         mpirc = MPI_File_read_at(fh, 0, header_packed, header_size, MPI_BYTE, &status);
         if (mpirc != MPI_SUCCESS) {
             MPI_Error_string(mpirc, mpierrstr, &mpierrlen);
@@ -882,14 +922,12 @@ static void read_cache_v4(
         }
 
         const char* ptr = (const char*) header_packed;
-        mfu_unpack_io_uint64(&ptr, &header[0]);
-        mfu_unpack_io_uint64(&ptr, &header[1]);
-        mfu_unpack_io_uint64(&ptr, &header[2]);
-        mfu_unpack_io_uint64(&ptr, &header[3]);
-        mfu_unpack_io_uint64(&ptr, &header[4]);
-        mfu_unpack_io_uint64(&ptr, &header[5]);
-    }
-    MPI_Bcast(header, 6, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+        int i;
+        for (i = 0; i < header_count; i++) {
+            mfu_unpack_io_uint64(&ptr, &header[i]);
+        }
+    }
+    MPI_Bcast(header, 7, MPI_UINT64_T, 0, MPI_COMM_WORLD);
     disp += header_size;
 
     uint64_t all_count;
@@ -899,6 +937,7 @@ static void read_cache_v4(
     groups->chars    = header[3];
     all_count        = header[4];
     uint64_t chars   = header[5];
+    uint64_t xchars  = header[6];
 
     /* compute count for each process */
     uint64_t count = all_count / (uint64_t)ranks;
@@ -991,7 +1030,7 @@ static void read_cache_v4(
     /* read files, if any */
     if (all_count > 0 && chars > 0) {
         /* get size of file element */
-        size_t elem_size = list_elem_pack_size(flist->detail, (int)chars, NULL);
+        size_t elem_size = list_elem_pack_size(flist->detail, (int)chars, xchars, NULL);
 
         /* in order to avoid blowing out memory, we'll pack into a smaller
          * buffer and iteratively make many collective reads */
@@ -1059,7 +1098,7 @@ static void read_cache_v4(
             uint64_t packcount = 0;
             while (packcount < (uint64_t) read_count) {
                 /* unpack item from buffer and advance pointer */
-                list_insert_ptr(flist, ptr, 1, chars);
+                list_insert_ptr(flist, ptr, 1, chars, xchars);
                 ptr += elem_size;
                 packcount++;
             }
@@ -1139,8 +1178,8 @@ void mfu_flist_read_cache(
     disp += 1 * 8; /* 9 consecutive uint64_t types in external32 */
 
     /* read data from file */
-    if (version == 4) {
-        read_cache_v4(name, &disp, fh, datarep, flist);
+    if (version == 4 || version == 5) {
+        read_cache_v4(name, version, &disp, fh, datarep, flist);
     } else if (version == 3) {
         /* need a couple of dummy params to record walk start and end times */
         uint64_t outstart = 0;
@@ -1193,7 +1232,10 @@ void mfu_flist_read_cache(
  * 2: version, start, end, files, file chars, list (file, type)
  * 3: version, start, end, files, users, user chars, groups, group chars,
  *    files, file chars, list (user, userid), list (group, groupid),
- *    list (stat) */
+ *    list (stat)
+ * 4: version, users, user chars, groups, group chars, files, file chars,
+ *    list (user, userid), list (group, groupid), list (stat)
+ * 5: same as 4 with xattr chars after file chars, list (stat, xattrs) */
 
 /* write each record in ASCII format, terminated with newlines */
 static void write_cache_readdir_variable(
@@ -1356,8 +1398,18 @@ static void write_cache_stat_v4(
     }
     chars *= 8;
 
+    /* reserve space for xattrs in integer number of 8 byte segments,
+     * we only use the version 5 format if some item has xattrs */
+    int xmax = (int) flist->max_xattrs;
+    int xchars = xmax / 8;
+    if (xchars * 8 < xmax) {
+        xchars++;
+    }
+    xchars *= 8;
+    uint64_t version = (xchars > 0) ? 5 : 4;
+
     /* compute size of each element */
-    size_t elem_size = list_elem_pack_size(flist->detail, chars, NULL);
+    size_t elem_size = list_elem_pack_size(flist->detail, chars, (uint64_t)xchars, NULL);
 
     /* open file */
     MPI_Status status;
@@ -1386,16 +1438,19 @@ static void write_cache_stat_v4(
     }
 
     /* prepare header */
-    int header_bytes = 7 * 8;
-    uint64_t header[7];
+    int header_bytes = (version == 5) ? 8 * 8 : 7 * 8;
+    uint64_t header[8];
     char* ptr = (char*) header;
-    mfu_pack_io_uint64(&ptr, 4);               /* file version */
+    mfu_pack_io_uint64(&ptr, version);         /* file version */
     mfu_pack_io_uint64(&ptr, users->count);    /* number of user records */
     mfu_pack_io_uint64(&ptr, users->chars);    /* number of chars in user name */
     mfu_pack_io_uint64(&ptr, groups->count);   /* number of group records */
     mfu_pack_io_uint64(&ptr, groups->chars);   /* number of chars in group name */
     mfu_pack_io_uint64(&ptr, all_count);       /* total number of stat entries */
     mfu_pack_io_uint64(&ptr, (uint64_t)chars); /* number of chars in file name */
+    if (version == 5) {
+        mfu_pack_io_uint64(&ptr, (uint64_t)xchars); /* number of bytes in xattrs */
+    }
 
     /* set view to write the header */
     MPI_Offset disp = 0;
@@ -1506,7 +1561,7 @@ static void write_cache_stat_v4(
         uint64_t packcount = 0;
         while (current != NULL && packcount < bufbytes) {
             /* pack item into buffer and advance pointer */
-            size_t pack_bytes = list_elem_pack(ptr, flist->detail, (uint64_t)chars, current);
+            size_t pack_bytes = list_elem_pack(ptr, flist->detail, (uint64_t)chars, (uint64_t)xchars, current);
             ptr += pack_bytes;
             packcount += (uint64_t)pack_bytes;
             current = current->next;
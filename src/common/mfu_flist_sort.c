@@ -184,7 +184,8 @@ static mfu_flist sort_files_readdir(const char* sortfields, mfu_flist flist)
         }
 
         /* pack file element */
-        sortptr += mfu_flist_file_pack(sortptr, flist, idx);
+        mfu_flist_file_pack(sortptr, flist, idx);
+        sortptr += bytes;
 
         idx++;
     }
@@ -207,7 +208,8 @@ static mfu_flist sort_files_readdir(const char* sortfields, mfu_flist flist)
     sortptr = (char*) outsortbuf;
     while (idx < (uint64_t)outsortcount) {
         sortptr += key_extent;
-        sortptr += mfu_flist_file_unpack(sortptr, flist2);
+        mfu_flist_file_unpack(sortptr, flist2);
+        sortptr += bytes;
         idx++;
     }
 
@@ -524,7 +526,8 @@ static mfu_flist sort_files_stat(const char* sortfields, mfu_flist flist)
         }
 
         /* pack file element */
-        sortptr += mfu_flist_file_pack(sortptr, flist, idx);
+        mfu_flist_file_pack(sortptr, flist, idx);
+        sortptr += bytes;
 
         idx++;
     }
@@ -547,7 +550,8 @@ static mfu_flist sort_files_stat(const char* sortfields, mfu_flist flist)
     sortptr = (char*) outsortbuf;
     while (idx < (uint64_t)outsortcount) {
         sortptr += key_extent;
-        sortptr += mfu_flist_file_unpack(sortptr, flist2);
+        mfu_flist_file_unpack(sortptr, flist2);
+        sortptr += bytes;
         idx++;
     }
 
@@ -51,6 +51,7 @@ static flist_t* CURRENT_LIST;
 static int SET_DIR_PERMS;
 static int REMOVE_FILES;
 static int DEREFERENCE;
+static attr_copy_t WALK_XATTRS;
 static mfu_file_t** CURRENT_PFILE;
 
 /****************************************
@@ -97,6 +98,15 @@ static void reduce_fini(const void* buf, size_t size)
  * Global helper functions
  ***************************************/
 
+/* record xattrs of the item just inserted into the current list,
+ * if we have been asked to capture them */
+static void walk_capture_xattrs(const char* path, mfu_file_t* mfu_file)
+{
+    if (WALK_XATTRS != XATTR_COPY_NONE) {
+        mfu_flist_capture_xattrs(CURRENT_LIST, path, WALK_XATTRS, DEREFERENCE, mfu_file);
+    }
+}
+
 /** Build a full path from a dirname and basename in the form:
  * <dir> + '/' + <name> + '/0'
  * up to path_len long.
@@ -297,6 +307,7 @@ static void walk_getdents_create(CIRCLE_handle* handle)
 
         /* record item info */
         mfu_flist_insert_stat(CURRENT_LIST, path, st.st_mode, &st);
+        walk_capture_xattrs(path, mfu_file);
 
         /* recurse into directory */
         if (S_ISDIR(st.st_mode)) {
@@ -393,6 +404,7 @@ static void walk_readdir_process_dir(const char* dir, CIRCLE_handle* handle)
                                 mfu_file_unlink(newpath, mfu_file);
                             } else {
                                 mfu_flist_insert_stat(CURRENT_LIST, newpath, mode, &st);
+                                walk_capture_xattrs(newpath, mfu_file);
                             }
                         }
                         else {
@@ -441,6 +453,7 @@ static void walk_readdir_create(CIRCLE_handle* handle)
 
         /* record item info */
         mfu_flist_insert_stat(CURRENT_LIST, path, st.st_mode, &st);
+        walk_capture_xattrs(path, mfu_file);
 
         /* recurse into directory */
         if (S_ISDIR(st.st_mode)) {
@@ -466,7 +479,8 @@ static void walk_readdir_process(CIRCLE_handle* handle)
  * Walk directory tree using stat on every object
  ***************************************/
 
-static void walk_stat_process_dir(char* dir, CIRCLE_handle* handle)
+/* read entries of directory and pass the path of each to add */
+static void walk_stat_read_dir(const char* dir, void (*add)(const char* path, void* arg), void* arg)
 {
     /* TODO: may need to try these functions multiple times */
     mfu_file_t* mfu_file = *CURRENT_PFILE;
@@ -492,7 +506,7 @@ static void walk_stat_process_dir(char* dir, CIRCLE_handle* handle)
                 int rc = build_path(newpath, CIRCLE_MAX_STRING_LEN, dir, name);
                 if (rc == 0) {
                     /* add item to queue */
-                    handle->enqueue(newpath);
+                    add(newpath, arg);
                 }
             }
         }
@@ -501,6 +515,18 @@ static void walk_stat_process_dir(char* dir, CIRCLE_handle* handle)
     return;
 }
 
+/* add item to libcircle queue */
+static void walk_stat_enqueue(const char* path, void* arg)
+{
+    CIRCLE_handle* handle = (CIRCLE_handle*) arg;
+    handle->enqueue((char*)path);
+}
+
+static void walk_stat_process_dir(char* dir, CIRCLE_handle* handle)
+{
+    walk_stat_read_dir(dir, walk_stat_enqueue, handle);
+}
+
 /** Call back given to initialize the dataset. */
 static void walk_stat_create(CIRCLE_handle* handle)
 {
@@ -512,12 +538,9 @@ static void walk_stat_create(CIRCLE_handle* handle)
     }
 }
 
-/** Callback given to process the dataset. */
-static void walk_stat_process(CIRCLE_handle* handle)
+/* stat and record item, returns 1 if it is a directory to recurse into */
+static int walk_stat_item(const char* path)
 {
-    /* get path from queue */
-    char path[CIRCLE_MAX_STRING_LEN];
-    handle->dequeue(path);
     mfu_file_t* mfu_file = *CURRENT_PFILE;
 
     /* stat item */
@@ -533,7 +556,7 @@ static void walk_stat_process(CIRCLE_handle* handle)
     if (status != 0) {
         MFU_LOG(MFU_LOG_ERR, "Failed to stat: '%s' (errno=%d %s)",
                 path, errno, strerror(errno));
-        return;
+        return 0;
     }
 
     /* increment our item count */
@@ -546,6 +569,7 @@ static void walk_stat_process(CIRCLE_handle* handle)
     } else {
         /* record info for item in list */
         mfu_flist_insert_stat(CURRENT_LIST, path, st.st_mode, &st);
+        walk_capture_xattrs(path, mfu_file);
     }
 
     /* recurse into directory */
@@ -564,11 +588,133 @@ static void walk_stat_process(CIRCLE_handle* handle)
             }
         }
         /* TODO: check that we can recurse into directory */
+        return 1;
+    }
+    return 0;
+}
+
+/** Callback given to process the dataset. */
+static void walk_stat_process(CIRCLE_handle* handle)
+{
+    /* get path from queue */
+    char path[CIRCLE_MAX_STRING_LEN];
+    handle->dequeue(path);
+    if (walk_stat_item(path)) {
         walk_stat_process_dir(path, handle);
     }
     return;
 }
 
+/****************************************
+ * Walk directory tree on a subset of ranks
+ ***************************************/
+
+/* libcircle balances work over every rank in the job, so to keep
+ * file system reads on the first few ranks we instead walk one
+ * directory level at a time and deal the items of each level
+ * round robin to those ranks */
+typedef struct {
+    mfu_exchange ex;  /* items packed for the next level */
+    int walk_ranks;   /* number of ranks reading the file system */
+    uint64_t next;    /* round robin counter to pick a rank */
+} walk_ranks_t;
+
+/* pack item to be visited in the next level */
+static void walk_ranks_add(const char* path, void* arg)
+{
+    walk_ranks_t* state = (walk_ranks_t*) arg;
+    int dest = (int) (state->next % (uint64_t) state->walk_ranks);
+    mfu_exchange_pack_str(&state->ex, dest, path, strlen(path));
+    state->next++;
+}
+
+static void walk_ranks_paths(uint64_t num_paths, const char** paths, int walk_ranks)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    walk_ranks_t state;
+    state.walk_ranks = walk_ranks;
+    state.next       = (uint64_t) rank;
+
+    /* rank 0 deals out the top level items */
+    mfu_exchange_init(&state.ex, MPI_COMM_WORLD);
+    if (rank == 0) {
+        uint64_t i;
+        for (i = 0; i < num_paths; i++) {
+            walk_ranks_add(paths[i], &state);
+        }
+    }
+
+    while (1) {
+        /* get items we are to visit in this level */
+        size_t size;
+        char* buf = mfu_exchange_all(&state.ex, &size);
+
+        /* stop when no rank has anything left to visit */
+        uint64_t bytes = (uint64_t) size;
+        uint64_t total_bytes;
+        MPI_Allreduce(&bytes, &total_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        if (total_bytes == 0) {
+            mfu_free(&buf);
+            break;
+        }
+
+        /* stat each item, and pack entries of directories for next level */
+        mfu_exchange_init(&state.ex, MPI_COMM_WORLD);
+        char* path = buf;
+        while (path < buf + size) {
+            if (walk_stat_item(path)) {
+                walk_stat_read_dir(path, walk_ranks_add, &state);
+            }
+            path += strlen(path) + 1;
+        }
+
+        mfu_free(&buf);
+    }
+}
+
+/* walk paths recorded in globals with libcircle */
+static void walk_circle(int use_stat)
+{
+    /* initialize libcircle */
+    CIRCLE_init(0, NULL, CIRCLE_SPLIT_EQUAL | CIRCLE_TERM_TREE);
+
+    /* set libcircle verbosity level */
+    enum CIRCLE_loglevel loglevel = CIRCLE_LOG_WARN;
+    CIRCLE_enable_logging(loglevel);
+
+    /* register callbacks */
+    if (use_stat) {
+        /* walk directories by calling stat on every item */
+        CIRCLE_cb_create(&walk_stat_create);
+        CIRCLE_cb_process(&walk_stat_process);
+    }
+    else {
+        /* walk directories using file types in readdir */
+        CIRCLE_cb_create(&walk_readdir_create);
+        CIRCLE_cb_process(&walk_readdir_process);
+        //        CIRCLE_cb_create(&walk_getdents_create);
+        //        CIRCLE_cb_process(&walk_getdents_process);
+    }
+
+    /* prepare callbacks for reductions */
+    CIRCLE_cb_reduce_init(&reduce_init);
+    CIRCLE_cb_reduce_op(&reduce_exec);
+    CIRCLE_cb_reduce_fini(&reduce_fini);
+
+    /* set libcircle reduction period */
+    int reduce_secs = 0;
+    if (mfu_progress_timeout > 0) {
+        reduce_secs = mfu_progress_timeout;
+    }
+    CIRCLE_set_reduce_period(reduce_secs);
+
+    /* run the libcircle job */
+    CIRCLE_begin();
+    CIRCLE_finalize();
+}
+
 /* Set up and execute directory walk */
 void mfu_flist_walk_path(const char* dirpath,
                          mfu_walk_opts_t* walk_opts,
@@ -605,14 +751,29 @@ void mfu_flist_walk_paths(uint64_t num_paths, const char** paths,
         DEREFERENCE = 1;
     }
 
-    /* convert handle to flist_t */
-    flist_t* flist = (flist_t*) bflist;
-
     /* get our rank and number of ranks in job */
     int rank, ranks;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &ranks);
 
+    /* limit file system reads to the first reader_ranks ranks if asked,
+     * that walk always stats each item */
+    int walk_ranks = 0;
+    int use_stat = walk_opts->use_stat;
+    if (walk_opts->reader_ranks > 0 && walk_opts->reader_ranks < ranks) {
+        walk_ranks = walk_opts->reader_ranks;
+        use_stat = 1;
+    }
+
+    /* xattrs are only captured for items we stat */
+    WALK_XATTRS = XATTR_COPY_NONE;
+    if (use_stat) {
+        WALK_XATTRS = walk_opts->xattrs;
+    }
+
+    /* convert handle to flist_t */
+    flist_t* flist = (flist_t*) bflist;
+
     /* print message to user that we're starting */
     if (mfu_debug_level >= MFU_LOG_VERBOSE && mfu_rank == 0) {
         uint64_t i;
@@ -621,13 +782,6 @@ void mfu_flist_walk_paths(uint64_t num_paths, const char** paths,
         }
     }
 
-    /* initialize libcircle */
-    CIRCLE_init(0, NULL, CIRCLE_SPLIT_EQUAL | CIRCLE_TERM_TREE);
-
-    /* set libcircle verbosity level */
-    enum CIRCLE_loglevel loglevel = CIRCLE_LOG_WARN;
-    CIRCLE_enable_logging(loglevel);
-
     /* TODO: check that paths is not NULL */
     /* TODO: check that each path is within limits */
 
@@ -639,7 +793,7 @@ void mfu_flist_walk_paths(uint64_t num_paths, const char** paths,
     /* we lookup users and groups first in case we can use
      * them to filter the walk */
     flist->detail = 0;
-    if (walk_opts->use_stat) {
+    if (use_stat) {
         flist->detail = 1;
         if (flist->have_users == 0) {
             mfu_flist_usrgrp_get_users(flist);
@@ -649,38 +803,17 @@ void mfu_flist_walk_paths(uint64_t num_paths, const char** paths,
         }
     }
 
-    /* register callbacks */
+    /* set I/O functions and initialize variables for reductions */
     CURRENT_PFILE = &mfu_file;
-    if (walk_opts->use_stat) {
-        /* walk directories by calling stat on every item */
-        CIRCLE_cb_create(&walk_stat_create);
-        CIRCLE_cb_process(&walk_stat_process);
-    }
-    else {
-        /* walk directories using file types in readdir */
-        CIRCLE_cb_create(&walk_readdir_create);
-        CIRCLE_cb_process(&walk_readdir_process);
-        //        CIRCLE_cb_create(&walk_getdents_create);
-        //        CIRCLE_cb_process(&walk_getdents_process);
-    }
-
-    /* prepare callbacks and initialize variables for reductions */
     reduce_start = start_walk;
     reduce_items = 0;
-    CIRCLE_cb_reduce_init(&reduce_init);
-    CIRCLE_cb_reduce_op(&reduce_exec);
-    CIRCLE_cb_reduce_fini(&reduce_fini);
 
-    /* set libcircle reduction period */
-    int reduce_secs = 0;
-    if (mfu_progress_timeout > 0) {
-        reduce_secs = mfu_progress_timeout;
+    if (walk_ranks > 0) {
+        /* walk without libcircle so other ranks stay off the file system */
+        walk_ranks_paths(num_paths, paths, walk_ranks);
+    } else {
+        walk_circle(use_stat);
     }
-    CIRCLE_set_reduce_period(reduce_secs);
-
-    /* run the libcircle job */
-    CIRCLE_begin();
-    CIRCLE_finalize();
 
     /* compute global summary */
     mfu_flist_summarize(bflist);
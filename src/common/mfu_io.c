@@ -1259,6 +1259,79 @@ int mfu_file_ftruncate(mfu_file_t* mfu_file, off_t length)
     }
 }
 
+/* enable or disable O_DIRECT on an open file */
+int mfu_set_direct(const char* file, int fd, int direct)
+{
+    /* get current flags on file descriptor */
+    errno = 0;
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) {
+        return -1;
+    }
+
+    /* nothing to do if O_DIRECT is already in the requested state */
+    int new_flags = direct ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+    if (new_flags == flags) {
+        return 0;
+    }
+
+    /* this fails with EINVAL on file systems that do not support O_DIRECT */
+    int rc = fcntl(fd, F_SETFL, new_flags);
+    return rc;
+}
+
+int mfu_file_set_direct(const char* file, mfu_file_t* mfu_file, int direct)
+{
+    if (mfu_file->type == POSIX) {
+        int rc = mfu_set_direct(file, mfu_file->fd, direct);
+        return rc;
+    } else if (mfu_file->type == DFS) {
+        /* DFS does not go through the page cache, nothing to change */
+        return 0;
+    } else {
+        MFU_ABORT(-1, "File type not known: %s type=%d",
+                  file, mfu_file->type);
+    }
+}
+
+/* reserve space for a range of bytes in an open file, uses fallocate
+ * rather than posix_fallocate so that we never fall back to writing zeros */
+int mfu_fallocate(const char* file, int fd, off_t offset, off_t length)
+{
+    double start = MPI_Wtime();
+    int rc;
+    int tries = MFU_IO_TRIES;
+retry:
+    errno = 0;
+    rc = fallocate(fd, 0, offset, length);
+    if (rc != 0) {
+        if (errno == EINTR || errno == EIO) {
+            tries--;
+            if (tries > 0) {
+                /* sleep a bit before consecutive tries */
+                usleep(MFU_IO_USLEEP);
+                goto retry;
+            }
+        }
+    }
+    double end = MPI_Wtime();
+    record_timing(start, end);
+    return rc;
+}
+
+int mfu_file_fallocate(const char* file, mfu_file_t* mfu_file, off_t offset, off_t length)
+{
+    if (mfu_file->type == POSIX) {
+        int rc = mfu_fallocate(file, mfu_file->fd, offset, length);
+        return rc;
+    } else if (mfu_file->type == DFS) {
+        /* DFS allocates space as data is written */
+        return 0;
+    } else {
+        MFU_ABORT(-1, "File type not known: %s type=%d",
+                  file, mfu_file->type);
+    }
+}
 
 /* unlink a file */
 int mfu_file_unlink(const char* file, mfu_file_t* mfu_file)
@@ -1309,6 +1382,52 @@ retry:
 }
 
 
+/* rename an item */
+int mfu_file_rename(const char* oldpath, const char* newpath, mfu_file_t* mfu_file)
+{
+    if (mfu_file->type == POSIX) {
+        int rc = mfu_rename(oldpath, newpath);
+        return rc;
+    } else if (mfu_file->type == DFS) {
+        int rc = daos_rename(oldpath, newpath, mfu_file);
+        return rc;
+    } else {
+        MFU_ABORT(-1, "File type not known, type=%d",
+                  mfu_file->type);
+    }
+}
+
+int daos_rename(const char* oldpath, const char* newpath, mfu_file_t* mfu_file)
+{
+    /* not supported through the DFS sys interface,
+     * callers fall back to copying the item */
+    return mfu_errno2rc(ENOTSUP);
+}
+
+int mfu_rename(const char* oldpath, const char* newpath)
+{
+    double start = MPI_Wtime();
+    int rc;
+    int tries = MFU_IO_TRIES;
+retry:
+    errno = 0;
+    rc = rename(oldpath, newpath);
+    if (rc != 0) {
+        if (errno == EINTR || errno == EIO) {
+            tries--;
+            if (tries > 0) {
+                /* sleep a bit before consecutive tries */
+                usleep(MFU_IO_USLEEP);
+                goto retry;
+            }
+        }
+    }
+    double end = MPI_Wtime();
+    record_timing(start, end);
+    return rc;
+}
+
+
 /* force flush of written data */
 int mfu_fsync(const char* file, int fd)
 {
@@ -1802,3 +1921,37 @@ int daos_lsetxattr(const char* path, const char* name, const void* value, size_t
     return mfu_errno2rc(ENOSYS);
 #endif
 }
+
+/* remove xattrs (link interrogation) */
+int mfu_file_lremovexattr(const char* path, const char* name, mfu_file_t* mfu_file)
+{
+    if (mfu_file->type == POSIX) {
+        int rc = mfu_lremovexattr(path, name);
+        return rc;
+    } else if (mfu_file->type == DFS) {
+        int rc = daos_lremovexattr(path, name, mfu_file);
+        return rc;
+    } else {
+        MFU_ABORT(-1, "File type not known, type=%d",
+                  mfu_file->type);
+    }
+}
+
+int mfu_lremovexattr(const char* path, const char* name)
+{
+    double start = MPI_Wtime();
+    int rc = lremovexattr(path, name);
+    double end = MPI_Wtime();
+    md_record_timing(start, end);
+    return rc;
+}
+
+int daos_lremovexattr(const char* path, const char* name, mfu_file_t* mfu_file)
+{
+#ifdef DAOS_SUPPORT
+    int rc = dfs_sys_removexattr(mfu_file->dfs_sys, path, name, O_NOFOLLOW);
+    return mfu_errno2rc(rc);
+#else
+    return mfu_errno2rc(ENOSYS);
+#endif
+}
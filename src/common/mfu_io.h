@@ -136,6 +136,11 @@ int mfu_lsetxattr(const char* path, const char* name, const void* value, size_t
 int daos_lsetxattr(const char* path, const char* name, const void* value, size_t size, int flags,
                            mfu_file_t* mfu_file);
 
+/* remove xattrs (link interrogation) */
+int mfu_file_lremovexattr(const char* path, const char* name, mfu_file_t* mfu_file);
+int mfu_lremovexattr(const char* path, const char* name);
+int daos_lremovexattr(const char* path, const char* name, mfu_file_t* mfu_file);
+
 /* calls realpath */
 char* mfu_file_realpath(const char* path, char* resolved_path, mfu_file_t* mfu_file);
 char* mfu_realpath(const char* path, char* resolved_path);
@@ -208,11 +213,26 @@ int mfu_file_ftruncate(mfu_file_t* mfu_file, off_t length);
 int daos_ftruncate(mfu_file_t* mfu_file, off_t length);
 int mfu_ftruncate(int fd, off_t length);
 
+/* enable (direct=1) or disable (direct=0) O_DIRECT on an open file,
+ * returns -1 with errno set if the flag cannot be changed */
+int mfu_file_set_direct(const char* file, mfu_file_t* mfu_file, int direct);
+int mfu_set_direct(const char* file, int fd, int direct);
+
+/* reserve space for length bytes starting at offset in an open file,
+ * returns -1 with errno=EOPNOTSUPP if the file system does not support it */
+int mfu_file_fallocate(const char* file, mfu_file_t* mfu_file, off_t offset, off_t length);
+int mfu_fallocate(const char* file, int fd, off_t offset, off_t length);
+
 /* delete a file */
 int mfu_file_unlink(const char* file, mfu_file_t* mfu_file);
 int daos_unlink(const char* file, mfu_file_t* mfu_file);
 int mfu_unlink(const char* file);
 
+/* rename an item, retry a few times on EINTR or EIO */
+int mfu_file_rename(const char* oldpath, const char* newpath, mfu_file_t* mfu_file);
+int daos_rename(const char* oldpath, const char* newpath, mfu_file_t* mfu_file);
+int mfu_rename(const char* oldpath, const char* newpath);
+
 /* force flush of written data */
 int mfu_fsync(const char* file, int fd);
 
@@ -107,13 +107,8 @@ void mfu_param_path_check_copy(
     int* flag_copy_into_dir         /* OUT - flag indicating whether source items should be copied into destination directory (1) or not (0) */
 );
 
-/* options passed to walk that effect how the walk is executed */
-typedef struct {
-    int dir_perms;      /* flag option to update dir perms during walk */
-    int remove;         /* flag option to remove files during walk */
-    int use_stat;       /* flag option on whether or not to stat files during walk */
-    int dereference;    /* flag option to dereference symbolic links */
-} mfu_walk_opts_t;
+/* defined in mfu_flist.h */
+struct mfu_create_opts;
 
 typedef enum {
     XATTR_COPY_INVAL,
@@ -123,6 +118,16 @@ typedef enum {
     XATTR_COPY_ALL,
 } attr_copy_t;
 
+/* options passed to walk that effect how the walk is executed */
+typedef struct {
+    int dir_perms;      /* flag option to update dir perms during walk */
+    int remove;         /* flag option to remove files during walk */
+    int use_stat;       /* flag option on whether or not to stat files during walk */
+    int dereference;    /* flag option to dereference symbolic links */
+    attr_copy_t xattrs; /* which xattrs to capture in the list during walk, XATTR_COPY_NONE for none */
+    int reader_ranks;   /* if > 0, only the first reader_ranks ranks read the file system during walk */
+} mfu_walk_opts_t;
+
 /* options passed to mfu_ */
 typedef struct {
     int          copy_into_dir;    /* flag indicating whether copying into existing dir */
@@ -135,6 +140,7 @@ typedef struct {
                                     * this is not a perfect opposite of no_dereference */
     int          no_dereference;   /* if true, don't dereference source symbolic links */
     bool         direct;           /* whether to use O_DIRECT */
+    uint64_t     direct_threshold; /* only use O_DIRECT on files of at least this many bytes */
     bool         open_noatime;     /* whether to use O_NOATIME */
     bool         sparse;           /* whether to create sparse files */
     size_t       chunk_size;       /* size to chunk files by */
@@ -143,6 +149,10 @@ typedef struct {
     char*        block_buf2;       /* another buffer to read / write data */
     int          grouplock_id;     /* Lustre grouplock ID */
     uint64_t     batch_files;      /* max batch size to copy files, 0 implies no limit */
+    struct mfu_create_opts* create_opts; /* layout and preallocation policy for new files, may be NULL */
+    int          reader_ranks;     /* if > 0, number of ranks that read the source, they ship file data to the
+                                    * others and keep items whose metadata must still be read from the source */
+    int          digest_cache;     /* whether to cache chunk digests of files in an xattr */
 } mfu_copy_opts_t;
 
 /*
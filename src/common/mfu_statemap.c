@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stdint.h>
+
+#include "mfu_statemap.h"
+#include "mfu.h"
+
+/* number of bits used to store the state of each field */
+#define MFU_STATEMAP_STATE_BITS (4)
+
+mfu_statemap* mfu_statemap_new(uint64_t count)
+{
+    mfu_statemap* map = (mfu_statemap*) MFU_MALLOC(sizeof(mfu_statemap));
+    map->count = count;
+
+    /* keep the table at most half full so probe sequences stay short */
+    uint64_t table_size = 16;
+    while (table_size < count * 2) {
+        table_size *= 2;
+    }
+    map->table_size = table_size;
+
+    map->keys   = (const char**) MFU_CALLOC(count + 1, sizeof(const char*));
+    map->states = (uint64_t*) MFU_CALLOC(count + 1, sizeof(uint64_t));
+    map->table  = (uint64_t*) MFU_CALLOC(table_size, sizeof(uint64_t));
+
+    return map;
+}
+
+void mfu_statemap_delete(mfu_statemap** pmap)
+{
+    if (pmap != NULL) {
+        mfu_statemap* map = *pmap;
+        if (map != NULL) {
+            mfu_free(&map->keys);
+            mfu_free(&map->states);
+            mfu_free(&map->table);
+        }
+        mfu_free(pmap);
+    }
+}
+
+/* return slot holding key, or the empty slot where it would go */
+static uint64_t mfu_statemap_slot(const mfu_statemap* map, const char* key)
+{
+    uint64_t mask = map->table_size - 1;
+    uint64_t slot = mfu_hash_fnv(MFU_HASH_FNV_INIT, key, strlen(key)) & mask;
+    while (map->table[slot] != 0) {
+        uint64_t idx = map->table[slot] - 1;
+        if (strcmp(map->keys[idx], key) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void mfu_statemap_insert(mfu_statemap* map, uint64_t index, const char* key)
+{
+    if (index >= map->count) {
+        MFU_ABORT(-1, "Index %llu out of range for state map of %llu items",
+            (unsigned long long) index, (unsigned long long) map->count);
+    }
+
+    uint64_t slot = mfu_statemap_slot(map, key);
+    if (map->table[slot] != 0) {
+        /* drop the earlier item with this key */
+        uint64_t old = map->table[slot] - 1;
+        map->keys[old] = NULL;
+    }
+
+    map->keys[index] = key;
+    map->table[slot] = index + 1;
+}
+
+int mfu_statemap_lookup(const mfu_statemap* map, const char* key, uint64_t* item_index)
+{
+    uint64_t slot = mfu_statemap_slot(map, key);
+    if (map->table[slot] == 0) {
+        return -1;
+    }
+    *item_index = map->table[slot] - 1;
+    return 0;
+}
+
+const char* mfu_statemap_key(const mfu_statemap* map, uint64_t index)
+{
+    return map->keys[index];
+}
+
+int mfu_statemap_get(const mfu_statemap* map, uint64_t index, int field)
+{
+    int shift = field * MFU_STATEMAP_STATE_BITS;
+    return (int) ((map->states[index] >> shift) & MFU_STATEMAP_STATE_MAX);
+}
+
+void mfu_statemap_set(mfu_statemap* map, uint64_t index, int field, int state)
+{
+    int shift = field * MFU_STATEMAP_STATE_BITS;
+    uint64_t mask = ((uint64_t) MFU_STATEMAP_STATE_MAX) << shift;
+    uint64_t bits = ((uint64_t) state & MFU_STATEMAP_STATE_MAX) << shift;
+    map->states[index] = (map->states[index] & ~mask) | bits;
+}
+
+uint64_t mfu_statemap_next(const mfu_statemap* map, uint64_t index)
+{
+    index++;
+    while (index < map->count && map->keys[index] == NULL) {
+        index++;
+    }
+    return index;
+}
+
+uint64_t mfu_statemap_first(const mfu_statemap* map)
+{
+    uint64_t index = 0;
+    while (index < map->count && map->keys[index] == NULL) {
+        index++;
+    }
+    return index;
+}
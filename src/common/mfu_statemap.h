@@ -0,0 +1,75 @@
+#ifndef MFU_STATEMAP_H
+#define MFU_STATEMAP_H
+
+/* Maps the name of each item in a file list to its index in the list,
+ * and records a small state value for each of a fixed set of fields
+ * per item.  This is used to track the result of comparing items
+ * field by field, as in dcmp and dsync.
+ *
+ * Items are stored in an array by index, and names are located with
+ * an open addressing hash table.  States are packed into 4 bits per
+ * field.  Key strings are not copied, so they must remain valid
+ * until the map is deleted, e.g., by pointing into names of the
+ * file list the map was built from. */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* max number of fields we can track per item */
+#define MFU_STATEMAP_FIELDS_MAX (16)
+
+/* max state value that can be stored for a field */
+#define MFU_STATEMAP_STATE_MAX (15)
+
+typedef struct mfu_statemap_struct {
+    uint64_t count;      /* number of items */
+    const char** keys;   /* key for each item, NULL if not set */
+    uint64_t* states;    /* packed field states for each item */
+    uint64_t* table;     /* hash table slots, holds item index + 1, 0 if empty */
+    uint64_t table_size; /* number of slots in hash table, power of two */
+} mfu_statemap;
+
+/* allocate a map to hold count items, with every field
+ * of every item set to state 0 */
+mfu_statemap* mfu_statemap_new(uint64_t count);
+
+/* free a map and set caller's pointer to NULL */
+void mfu_statemap_delete(mfu_statemap** pmap);
+
+/* record key for item at index, if the key is already
+ * in the map, the item at index replaces the earlier one */
+void mfu_statemap_insert(mfu_statemap* map, uint64_t index, const char* key);
+
+/* look up key and return its index in item_index,
+ * returns 0 on success, -1 if key is not in map */
+int mfu_statemap_lookup(const mfu_statemap* map, const char* key, uint64_t* item_index);
+
+/* return key of item at index, NULL if item has no key */
+const char* mfu_statemap_key(const mfu_statemap* map, uint64_t index);
+
+/* return state of field for item at index */
+int mfu_statemap_get(const mfu_statemap* map, uint64_t index, int field);
+
+/* set state of field for item at index */
+void mfu_statemap_set(mfu_statemap* map, uint64_t index, int field, int state);
+
+/* return index of first item with a key, or count if there is none */
+uint64_t mfu_statemap_first(const mfu_statemap* map);
+
+/* return index of next item with a key after index, or count if there is none */
+uint64_t mfu_statemap_next(const mfu_statemap* map, uint64_t index);
+
+/* iterate over index of each item with a key, in index order */
+#define mfu_statemap_foreach(map, index) \
+    for ((index) = mfu_statemap_first(map); \
+         (index) < (map)->count; \
+         (index) = mfu_statemap_next(map, index))
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* MFU_STATEMAP_H */
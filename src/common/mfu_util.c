@@ -19,6 +19,7 @@
 #include <unistd.h>
 
 #include <sys/vfs.h>
+#include <sys/mman.h>
 
 #ifndef ULLONG_MAX
 #define ULLONG_MAX (__LONG_LONG_MAX__ * 2UL + 1UL)
@@ -41,6 +42,10 @@ mfu_loglevel mfu_debug_level = MFU_LOG_ERR;
 /* default progress message timeout in seconds */
 int mfu_progress_timeout = 10;
 
+/* use transparent huge pages unless asked for hugetlbfs pages,
+ * set by MFU_BUF_HUGEPAGES=1 in the environment */
+int mfu_buf_hugepages = 0;
+
 /* initialize mfu library,
  * reference counting allows for multiple init/finalize pairs */
 int mfu_init()
@@ -51,6 +56,13 @@ int mfu_init()
         mfu_debug_stream = stdout;
         DTCMP_Init();
         mfu_init_filesystem_list();
+
+        /* let the user request hugetlbfs pages for I/O buffers */
+        const char* value = getenv("MFU_BUF_HUGEPAGES");
+        if (value != NULL && atoi(value) != 0) {
+            mfu_buf_hugepages = 1;
+        }
+
         mfu_initialized++;
     }
 
@@ -66,6 +78,7 @@ int mfu_finalize()
     }
     if (mfu_initialized == 0) {
         mfu_destroy_filesystem_list();
+        mfu_buf_pool_free();
     }
     return MFU_SUCCESS;
 }
@@ -210,6 +223,182 @@ void mfu_free(void* p)
     }
 }
 
+/* Each process keeps a list of the I/O buffers it has allocated.
+ * Buffers are handed out by mfu_buf_get and returned by mfu_buf_put,
+ * and a returned buffer is reused by the next request it can satisfy,
+ * so the data path does not allocate memory for each chunk.
+ * Buffers of at least MFU_BUF_HUGE bytes are aligned to a huge page
+ * and backed by huge pages where possible to reduce TLB misses.
+ * Buffers are zeroed when allocated so that their pages are first
+ * touched by this process and placed on its NUMA node. */
+#define MFU_BUF_HUGE (2 * 1024 * 1024)
+
+/* max number of free buffers we keep in the pool */
+#define MFU_BUF_POOL_FREE_MAX (8)
+
+typedef struct mfu_buf {
+    void* ptr;            /* start of buffer */
+    size_t size;          /* size of buffer in bytes */
+    int mapped;           /* whether buffer was allocated with mmap */
+    int in_use;           /* whether buffer is currently handed out */
+    struct mfu_buf* next; /* next buffer in pool */
+} mfu_buf_t;
+
+static mfu_buf_t* mfu_buf_pool = NULL;
+
+/* allocate a new buffer and add it to the pool */
+static mfu_buf_t* mfu_buf_alloc(size_t size, size_t alignment, const char* file, int line)
+{
+    mfu_buf_t* buf = (mfu_buf_t*) mfu_malloc(sizeof(mfu_buf_t), file, line);
+    buf->ptr    = NULL;
+    buf->size   = size;
+    buf->mapped = 0;
+
+    if (size >= MFU_BUF_HUGE) {
+        /* round large buffers up to a whole number of huge pages */
+        buf->size = (size + MFU_BUF_HUGE - 1) / MFU_BUF_HUGE * MFU_BUF_HUGE;
+
+#ifdef MAP_HUGETLB
+        /* hugetlbfs pages need to be reserved by the administrator,
+         * so only try them if asked and fall back if there are none */
+        if (mfu_buf_hugepages && alignment <= MFU_BUF_HUGE) {
+            void* ptr = mmap(NULL, buf->size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (ptr != MAP_FAILED) {
+                buf->ptr    = ptr;
+                buf->mapped = 1;
+            }
+        }
+#endif
+
+        /* otherwise align to a huge page so the kernel can back
+         * the buffer with transparent huge pages */
+        if (alignment < MFU_BUF_HUGE) {
+            alignment = MFU_BUF_HUGE;
+        }
+    }
+
+    if (buf->ptr == NULL) {
+        buf->ptr = mfu_memalign(buf->size, alignment, file, line);
+#ifdef MADV_HUGEPAGE
+        if (buf->size >= MFU_BUF_HUGE) {
+            madvise(buf->ptr, buf->size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    /* touch every page from this process */
+    memset(buf->ptr, 0, buf->size);
+
+    buf->in_use = 0;
+    buf->next = mfu_buf_pool;
+    mfu_buf_pool = buf;
+    return buf;
+}
+
+static void mfu_buf_release(mfu_buf_t* buf)
+{
+    if (buf->mapped) {
+        munmap(buf->ptr, buf->size);
+    } else {
+        free(buf->ptr);
+    }
+    free(buf);
+}
+
+void* mfu_buf_get(size_t size, size_t alignment, const char* file, int line)
+{
+    /* only bother if size > 0 */
+    if (size == 0) {
+        return NULL;
+    }
+
+    /* posix_memalign needs at least pointer alignment */
+    if (alignment < sizeof(void*)) {
+        alignment = sizeof(void*);
+    }
+
+    /* look for the smallest free buffer that satisfies the request */
+    mfu_buf_t* best = NULL;
+    mfu_buf_t* buf;
+    for (buf = mfu_buf_pool; buf != NULL; buf = buf->next) {
+        if (!buf->in_use && buf->size >= size &&
+            ((uintptr_t) buf->ptr) % alignment == 0)
+        {
+            if (best == NULL || buf->size < best->size) {
+                best = buf;
+            }
+        }
+    }
+
+    /* allocate a new buffer if none is free */
+    if (best == NULL) {
+        best = mfu_buf_alloc(size, alignment, file, line);
+    }
+
+    best->in_use = 1;
+    return best->ptr;
+}
+
+void mfu_buf_put(void* p)
+{
+    /* verify that we got a valid pointer to a pointer */
+    if (p == NULL) {
+        return;
+    }
+
+    void* ptr = *(void**)p;
+    if (ptr != NULL) {
+        /* mark the buffer as free and count free buffers */
+        int found = 0;
+        int free_count = 0;
+        mfu_buf_t* buf;
+        for (buf = mfu_buf_pool; buf != NULL; buf = buf->next) {
+            if (buf->ptr == ptr) {
+                buf->in_use = 0;
+                found = 1;
+            }
+            if (!buf->in_use) {
+                free_count++;
+            }
+        }
+
+        if (!found) {
+            MFU_ABORT(1, "Buffer %p was not allocated from the buffer pool", ptr);
+        }
+
+        /* limit the memory we hold on to by releasing
+         * the buffer we just got back if we have too many */
+        if (free_count > MFU_BUF_POOL_FREE_MAX) {
+            mfu_buf_t** prev = &mfu_buf_pool;
+            while ((*prev)->ptr != ptr) {
+                prev = &(*prev)->next;
+            }
+            buf = *prev;
+            *prev = buf->next;
+            mfu_buf_release(buf);
+        }
+    }
+
+    /* set caller's pointer to NULL */
+    *(void**)p = NULL;
+}
+
+void mfu_buf_pool_free(void)
+{
+    /* release free buffers, leaving any still handed out in the pool */
+    mfu_buf_t** prev = &mfu_buf_pool;
+    while (*prev != NULL) {
+        mfu_buf_t* buf = *prev;
+        if (buf->in_use) {
+            prev = &buf->next;
+        } else {
+            *prev = buf->next;
+            mfu_buf_release(buf);
+        }
+    }
+}
+
 void mfu_bcast_strdup(const char* send, char** recv, int root, MPI_Comm comm)
 {
     /* get our rank in the communicator */
@@ -592,6 +781,346 @@ uint32_t mfu_hash_jenkins(const char* key, size_t len)
     return hash;
 }
 
+uint64_t mfu_hash_fnv(uint64_t hash, const void* data, size_t len)
+{
+    const unsigned char* p = (const unsigned char*) data;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        hash ^= (uint64_t) p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* largest message sent in one piece when counts do not fit in an int */
+#define MFU_EXCHANGE_PIECE (1024 * 1024 * 1024)
+
+void* mfu_alltoallv_bytes(
+    const void* sendbuf,
+    const size_t* sendcounts,
+    const size_t* senddisps,
+    size_t* recvcounts,
+    size_t* recv_total,
+    MPI_Comm comm)
+{
+    int rank, ranks;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &ranks);
+
+    /* tell each rank how many bytes it will receive from us */
+    uint64_t* scounts = (uint64_t*) MFU_MALLOC((size_t)ranks * sizeof(uint64_t));
+    uint64_t* rcounts = (uint64_t*) MFU_MALLOC((size_t)ranks * sizeof(uint64_t));
+    int i;
+    for (i = 0; i < ranks; i++) {
+        scounts[i] = (uint64_t) sendcounts[i];
+    }
+    MPI_Alltoall(scounts, 1, MPI_UINT64_T, rcounts, 1, MPI_UINT64_T, comm);
+
+    /* compute size of receive buffer and the largest count or
+     * displacement we need to describe on either side */
+    uint64_t send_end = 0;
+    uint64_t recv_end = 0;
+    for (i = 0; i < ranks; i++) {
+        uint64_t end = (uint64_t) senddisps[i] + scounts[i];
+        if (end > send_end) {
+            send_end = end;
+        }
+        recv_end += rcounts[i];
+    }
+    uint64_t local_max = (send_end > recv_end) ? send_end : recv_end;
+    uint64_t global_max;
+    MPI_Allreduce(&local_max, &global_max, 1, MPI_UINT64_T, MPI_MAX, comm);
+
+    char* recvbuf = (char*) MFU_MALLOC((size_t)recv_end + 1);
+
+    if (global_max <= (uint64_t) INT_MAX) {
+        /* everything fits, let MPI schedule the exchange */
+        int* sc = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+        int* sd = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+        int* rc = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+        int* rd = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+        int disp = 0;
+        for (i = 0; i < ranks; i++) {
+            sc[i] = (int) scounts[i];
+            sd[i] = (int) senddisps[i];
+            rc[i] = (int) rcounts[i];
+            rd[i] = disp;
+            disp += rc[i];
+        }
+        MPI_Alltoallv(
+            (void*) sendbuf, sc, sd, MPI_BYTE,
+            recvbuf, rc, rd, MPI_BYTE, comm
+        );
+        mfu_free(&rd);
+        mfu_free(&rc);
+        mfu_free(&sd);
+        mfu_free(&sc);
+    } else {
+        /* send each peer its bytes as a sequence of pieces, messages
+         * between a pair of ranks on the same tag arrive in order */
+        uint64_t nreqs = 0;
+        for (i = 0; i < ranks; i++) {
+            if (i != rank) {
+                nreqs += (scounts[i] + MFU_EXCHANGE_PIECE - 1) / MFU_EXCHANGE_PIECE;
+                nreqs += (rcounts[i] + MFU_EXCHANGE_PIECE - 1) / MFU_EXCHANGE_PIECE;
+            }
+        }
+        MPI_Request* reqs = (MPI_Request*) MFU_MALLOC((size_t)nreqs * sizeof(MPI_Request) + 1);
+
+        int n = 0;
+        uint64_t disp = 0;
+        for (i = 0; i < ranks; i++) {
+            uint64_t off = 0;
+            while (i != rank && off < rcounts[i]) {
+                uint64_t len = rcounts[i] - off;
+                if (len > MFU_EXCHANGE_PIECE) {
+                    len = MFU_EXCHANGE_PIECE;
+                }
+                MPI_Irecv(recvbuf + disp + off, (int) len, MPI_BYTE, i, 0, comm, &reqs[n++]);
+                off += len;
+            }
+            if (i == rank && rcounts[i] > 0) {
+                memcpy(recvbuf + disp, (const char*)sendbuf + senddisps[i], (size_t) rcounts[i]);
+            }
+            disp += rcounts[i];
+        }
+        for (i = 0; i < ranks; i++) {
+            uint64_t off = 0;
+            while (i != rank && off < scounts[i]) {
+                uint64_t len = scounts[i] - off;
+                if (len > MFU_EXCHANGE_PIECE) {
+                    len = MFU_EXCHANGE_PIECE;
+                }
+                const char* ptr = (const char*)sendbuf + senddisps[i] + off;
+                MPI_Isend((void*) ptr, (int) len, MPI_BYTE, i, 0, comm, &reqs[n++]);
+                off += len;
+            }
+        }
+        MPI_Waitall(n, reqs, MPI_STATUSES_IGNORE);
+        mfu_free(&reqs);
+    }
+
+    if (recvcounts != NULL) {
+        for (i = 0; i < ranks; i++) {
+            recvcounts[i] = (size_t) rcounts[i];
+        }
+    }
+    *recv_total = (size_t) recv_end;
+
+    mfu_free(&rcounts);
+    mfu_free(&scounts);
+
+    return recvbuf;
+}
+
+void* mfu_exchange_items(
+    const void* items,
+    const int* dests,
+    uint64_t count,
+    size_t item_size,
+    uint64_t* recv_count,
+    MPI_Comm comm)
+{
+    int ranks;
+    MPI_Comm_size(comm, &ranks);
+
+    /* count bytes we send to each rank */
+    size_t* sendcounts = (size_t*) MFU_CALLOC((size_t)ranks, sizeof(size_t));
+    size_t* senddisps  = (size_t*) MFU_MALLOC((size_t)ranks * sizeof(size_t));
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        sendcounts[dests[i]] += item_size;
+    }
+
+    /* pack items in order of destination rank */
+    int r;
+    size_t disp = 0;
+    for (r = 0; r < ranks; r++) {
+        senddisps[r] = disp;
+        disp += sendcounts[r];
+    }
+    char* sendbuf = (char*) MFU_MALLOC(disp + 1);
+    size_t* offsets = (size_t*) MFU_MALLOC((size_t)ranks * sizeof(size_t));
+    memcpy(offsets, senddisps, (size_t)ranks * sizeof(size_t));
+    const char* src = (const char*) items;
+    for (i = 0; i < count; i++) {
+        int dest = dests[i];
+        memcpy(sendbuf + offsets[dest], src + i * item_size, item_size);
+        offsets[dest] += item_size;
+    }
+
+    size_t recv_total;
+    void* recvbuf = mfu_alltoallv_bytes(sendbuf, sendcounts, senddisps,
+        NULL, &recv_total, comm);
+    *recv_count = (uint64_t) (recv_total / item_size);
+
+    mfu_free(&offsets);
+    mfu_free(&sendbuf);
+    mfu_free(&senddisps);
+    mfu_free(&sendcounts);
+
+    return recvbuf;
+}
+
+void mfu_exchange_init(mfu_exchange* ex, MPI_Comm comm)
+{
+    int ranks;
+    MPI_Comm_size(comm, &ranks);
+    ex->comm  = comm;
+    ex->ranks = ranks;
+    ex->sizes = (size_t*) MFU_CALLOC((size_t)ranks, sizeof(size_t));
+    ex->caps  = (size_t*) MFU_CALLOC((size_t)ranks, sizeof(size_t));
+    ex->bufs  = (char**)  MFU_CALLOC((size_t)ranks, sizeof(char*));
+}
+
+void mfu_exchange_pack(mfu_exchange* ex, int rank, const void* data, size_t len)
+{
+    size_t need = ex->sizes[rank] + len;
+    if (need > ex->caps[rank]) {
+        size_t cap = (ex->caps[rank] > 0) ? ex->caps[rank] : 4096;
+        while (cap < need) {
+            cap *= 2;
+        }
+        char* buf = (char*) realloc(ex->bufs[rank], cap);
+        if (buf == NULL) {
+            MFU_ABORT(-1, "Failed to allocate %llu bytes", (unsigned long long) cap);
+        }
+        ex->bufs[rank] = buf;
+        ex->caps[rank] = cap;
+    }
+    memcpy(ex->bufs[rank] + ex->sizes[rank], data, len);
+    ex->sizes[rank] = need;
+}
+
+void mfu_exchange_pack_u64(mfu_exchange* ex, int rank, uint64_t val)
+{
+    mfu_exchange_pack(ex, rank, &val, sizeof(val));
+}
+
+void mfu_exchange_pack_str(mfu_exchange* ex, int rank, const char* str, size_t len)
+{
+    char nul = '\0';
+    mfu_exchange_pack(ex, rank, str, len);
+    mfu_exchange_pack(ex, rank, &nul, 1);
+}
+
+char* mfu_exchange_all(mfu_exchange* ex, size_t* size)
+{
+    int i;
+    int ranks = ex->ranks;
+
+    /* concatenate records into a single send buffer */
+    size_t* senddisps = (size_t*) MFU_MALLOC((size_t)ranks * sizeof(size_t));
+    size_t send_total = 0;
+    for (i = 0; i < ranks; i++) {
+        senddisps[i] = send_total;
+        send_total += ex->sizes[i];
+    }
+    char* sendbuf = (char*) MFU_MALLOC(send_total + 1);
+    for (i = 0; i < ranks; i++) {
+        if (ex->sizes[i] > 0) {
+            memcpy(sendbuf + senddisps[i], ex->bufs[i], ex->sizes[i]);
+        }
+        mfu_free(&ex->bufs[i]);
+    }
+
+    char* recvbuf = (char*) mfu_alltoallv_bytes(sendbuf, ex->sizes, senddisps,
+        NULL, size, ex->comm);
+
+    mfu_free(&sendbuf);
+    mfu_free(&senddisps);
+    mfu_free(&ex->bufs);
+    mfu_free(&ex->sizes);
+    mfu_free(&ex->caps);
+
+    return recvbuf;
+}
+
+#define MFU_DIGEST_P1 (0x9E3779B185EBCA87ULL)
+#define MFU_DIGEST_P2 (0xC2B2AE3D27D4EB4FULL)
+
+static inline uint64_t mfu_digest_rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/* final avalanche step so every input bit affects every output bit */
+static inline uint64_t mfu_digest_fmix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* mix one 8-byte word into both lanes */
+static inline void mfu_digest_word(mfu_digest_ctx* ctx, const unsigned char* p)
+{
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    ctx->h1 = mfu_digest_rotl(ctx->h1 ^ (w * MFU_DIGEST_P2), 31) * MFU_DIGEST_P1;
+    ctx->h2 = mfu_digest_rotl(ctx->h2 ^ (w * MFU_DIGEST_P1), 27) * MFU_DIGEST_P2 + w;
+}
+
+void mfu_digest_init(mfu_digest_ctx* ctx)
+{
+    ctx->h1 = MFU_DIGEST_P1;
+    ctx->h2 = MFU_DIGEST_P2;
+    ctx->len = 0;
+    ctx->tail_len = 0;
+}
+
+void mfu_digest_update(mfu_digest_ctx* ctx, const void* buf, size_t size)
+{
+    const unsigned char* p = (const unsigned char*) buf;
+    ctx->len += (uint64_t) size;
+
+    /* complete a partial word left from the last call */
+    if (ctx->tail_len > 0) {
+        while (ctx->tail_len < 8 && size > 0) {
+            ctx->tail[ctx->tail_len++] = *p++;
+            size--;
+        }
+        if (ctx->tail_len < 8) {
+            return;
+        }
+        mfu_digest_word(ctx, ctx->tail);
+        ctx->tail_len = 0;
+    }
+
+    /* consume full words */
+    while (size >= 8) {
+        mfu_digest_word(ctx, p);
+        p    += 8;
+        size -= 8;
+    }
+
+    /* save any remaining bytes for the next call */
+    memcpy(ctx->tail, p, size);
+    ctx->tail_len = size;
+}
+
+void mfu_digest_final(mfu_digest_ctx* ctx, unsigned char* out)
+{
+    /* pad out last partial word with zeros,
+     * the length mixed in below distinguishes the padding */
+    if (ctx->tail_len > 0) {
+        memset(ctx->tail + ctx->tail_len, 0, 8 - ctx->tail_len);
+        mfu_digest_word(ctx, ctx->tail);
+        ctx->tail_len = 0;
+    }
+
+    uint64_t h1 = mfu_digest_fmix(ctx->h1 ^ ctx->len);
+    uint64_t h2 = mfu_digest_fmix(ctx->h2 + ctx->len);
+    h1 += h2;
+    h2 += h1;
+
+    memcpy(out,     &h1, sizeof(h1));
+    memcpy(out + 8, &h2, sizeof(h2));
+}
+
 void mfu_stat_get_atimes(const struct stat* sb, uint64_t* secs, uint64_t* nsecs)
 {
     *secs = (uint64_t) sb->st_atime;
@@ -706,34 +1235,203 @@ void mfu_stat_set_ctimes (struct stat* sb, uint64_t secs, uint64_t nsecs)
 #endif
 }
 
-/* compares contents of two files and optionally overwrite dest with source,
- * returns -1 on error, 0 if equal, 1 if different */
-int mfu_compare_contents(
-    const char* src_name,          /* IN  - path name to source file */
-    const char* dst_name,          /* IN  - path name to destination file */
-    off_t offset,                  /* IN  - offset with file to start comparison */
-    off_t length,                  /* IN  - number of bytes to be compared */
-    off_t file_size,               /* IN  - size of file */
-    int overwrite,                 /* IN  - whether to replace dest with source contents (1) or not (0) */
-    mfu_copy_opts_t* copy_opts,    /* IN  - options for data compare/copy step */
-    uint64_t* count_bytes_read,    /* OUT - number of bytes read (src + dest) */
-    uint64_t* count_bytes_written, /* OUT - number of bytes written to dest */
-    mfu_progress* prg,             /* IN  - progress message structure */
-    mfu_file_t* mfu_src_file,      /* IN  - I/O filesystem functions to use for source */
-    mfu_file_t* mfu_dst_file)      /* IN  - I/O filesystem functions to use for destination */
+/* returns 1 if a file of the given size should be read and written
+ * with O_DIRECT according to the copy options, 0 otherwise */
+int mfu_direct_enabled(const mfu_copy_opts_t* opts, uint64_t file_size)
 {
-    /* extract values from copy options */
-    int direct = copy_opts->direct;
-    size_t buf_size = copy_opts->buf_size;
-    bool noatime = copy_opts->open_noatime;
-
-    /* for O_DIRECT, check that length is a multiple of buf_size */
-    if (direct &&                      /* using O_DIRECT */
-        offset + length < file_size && /* not at end of file */
-        length % buf_size != 0)        /* length not an integer multiple of block size */
-    {
-        MFU_ABORT(-1, "O_DIRECT requires chunk size to be integer multiple of block size %llu",
-            buf_size);
+    /* O_DIRECT must be requested by the user */
+    if (! opts->direct) {
+        return 0;
+    }
+
+    /* small files are cheaper to move through the page cache */
+    if (file_size < opts->direct_threshold) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/* return preferred I/O block size of an open file, or 0 if unknown */
+static size_t mfu_direct_blksize(mfu_file_t* mfu_file)
+{
+    struct stat st;
+    if (fstat(mfu_file->fd, &st) != 0 || st.st_blksize <= 0) {
+        return 0;
+    }
+    return (size_t) st.st_blksize;
+}
+
+void mfu_direct_range(
+    const mfu_copy_opts_t* opts,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file,
+    off_t offset,
+    off_t length,
+    off_t file_size,
+    off_t* direct_start,
+    off_t* direct_end,
+    size_t* direct_size)
+{
+    /* default to buffered I/O for the full range */
+    *direct_start = offset;
+    *direct_end   = offset;
+    *direct_size  = 0;
+
+    if (! mfu_direct_enabled(opts, (uint64_t) file_size)) {
+        return;
+    }
+
+    /* O_DIRECT only applies to POSIX files */
+    if (mfu_src_file->type != POSIX || mfu_dst_file->type != POSIX) {
+        return;
+    }
+
+    /* look up block size of each file */
+    size_t src_blksize = mfu_direct_blksize(mfu_src_file);
+    size_t dst_blksize = mfu_direct_blksize(mfu_dst_file);
+    if (src_blksize == 0 || dst_blksize == 0) {
+        return;
+    }
+
+    /* align to the least common multiple of the two block sizes */
+    size_t a = src_blksize;
+    size_t b = dst_blksize;
+    while (b != 0) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    size_t align = (src_blksize / a) * dst_blksize;
+
+    /* use the largest multiple of the alignment that fits in our buffer */
+    size_t size = opts->buf_size - (opts->buf_size % align);
+    if (size == 0) {
+        return;
+    }
+
+    /* round start up and end down to alignment boundaries */
+    off_t start = ((offset + (off_t)align - 1) / (off_t)align) * (off_t)align;
+    off_t end   = ((offset + length) / (off_t)align) * (off_t)align;
+    if (end <= start) {
+        return;
+    }
+
+    *direct_start = start;
+    *direct_end   = end;
+    *direct_size  = size;
+}
+
+size_t mfu_direct_next(
+    off_t off,
+    off_t end,
+    size_t buf_size,
+    off_t direct_start,
+    off_t direct_end,
+    size_t direct_size,
+    int* direct)
+{
+    /* assume buffered I/O up to the end of the transfer */
+    off_t limit = end;
+    size_t max  = buf_size;
+    *direct = 0;
+
+    if (direct_size > 0) {
+        if (off < direct_start) {
+            /* unaligned head, stop at start of aligned range */
+            limit = direct_start;
+        } else if (off < direct_end) {
+            /* within aligned range */
+            limit = direct_end;
+            max   = direct_size;
+            *direct = 1;
+        }
+    }
+
+    off_t remainder = limit - off;
+    if (remainder < (off_t) max) {
+        return (size_t) remainder;
+    }
+    return max;
+}
+
+mfu_compare_ctx* mfu_compare_ctx_new(
+    mfu_copy_opts_t* copy_opts,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file)
+{
+    mfu_compare_ctx* ctx = (mfu_compare_ctx*) MFU_MALLOC(sizeof(mfu_compare_ctx));
+    ctx->copy_opts = copy_opts;
+
+    /* take our own copies so the descriptors we cache
+     * are not replaced by other opens on the caller's structures */
+    ctx->src_file = *mfu_src_file;
+    ctx->dst_file = *mfu_dst_file;
+
+    ctx->src_name   = NULL;
+    ctx->dst_name   = NULL;
+    ctx->dst_rw     = 0;
+    ctx->dst_dirty  = 0;
+    ctx->known_differ = 0;
+    ctx->direct     = 0;
+    ctx->direct_on  = 0;
+
+    /* get buffers to compare files from the pool, aligned on 1MB boundaries */
+    size_t alignment = 1024*1024;
+    ctx->buf_size = copy_opts->buf_size;
+    ctx->src_buf  = MFU_BUF_GET(ctx->buf_size, alignment);
+    ctx->dst_buf  = MFU_BUF_GET(ctx->buf_size, alignment);
+
+    return ctx;
+}
+
+/* close any files held open in compare context */
+static void mfu_compare_ctx_close(mfu_compare_ctx* ctx)
+{
+    if (ctx->dst_name != NULL) {
+        mfu_file_close(ctx->dst_name, &ctx->dst_file);
+        mfu_free(&ctx->dst_name);
+    }
+    if (ctx->src_name != NULL) {
+        mfu_file_close(ctx->src_name, &ctx->src_file);
+        mfu_free(&ctx->src_name);
+    }
+}
+
+void mfu_compare_ctx_free(mfu_compare_ctx** pctx)
+{
+    if (pctx != NULL) {
+        mfu_compare_ctx* ctx = *pctx;
+        if (ctx != NULL) {
+            mfu_compare_ctx_close(ctx);
+            mfu_buf_put(&ctx->src_buf);
+            mfu_buf_put(&ctx->dst_buf);
+        }
+        mfu_free(pctx);
+    }
+}
+
+/* open source and destination files, reusing the files held open
+ * from the previous call when they match, returns 0 on success */
+static int mfu_compare_ctx_open(
+    mfu_compare_ctx* ctx,
+    const char* src_name,
+    const char* dst_name,
+    int overwrite,
+    int direct)
+{
+    bool noatime = ctx->copy_opts->open_noatime;
+
+    /* reuse the open files if they are the same pair in a compatible mode */
+    if (ctx->src_name != NULL) {
+        if (ctx->direct == direct &&
+            (ctx->dst_rw || !overwrite) &&
+            strcmp(ctx->src_name, src_name) == 0 &&
+            strcmp(ctx->dst_name, dst_name) == 0)
+        {
+            return 0;
+        }
+        mfu_compare_ctx_close(ctx);
     }
 
     /* open source as read only, with optional O_DIRECT */
@@ -746,13 +1444,14 @@ int mfu_compare_contents(
     }
 
     /* open source file */
-    int src_rc = mfu_file_open(src_name, src_flags, mfu_src_file);
+    int src_rc = mfu_file_open(src_name, src_flags, &ctx->src_file);
     if (src_rc != 0) {
         /* log error if there is an open failure on the src side */
         MFU_LOG(MFU_LOG_ERR, "Failed to open source file `%s' (errno=%d %s)",
                 src_name, errno, strerror(errno));
         return -1;
     }
+    ctx->src_name = MFU_STRDUP(src_name);
 
     /* avoid opening file in write mode if we're only reading,
      * optionally enable O_DIRECT */
@@ -768,35 +1467,90 @@ int mfu_compare_contents(
     }
 
     /* open destination file */
-    int dst_rc = mfu_file_open(dst_name, dst_flags, mfu_dst_file);
+    int dst_rc = mfu_file_open(dst_name, dst_flags, &ctx->dst_file);
     if (dst_rc != 0) {
         /* log error if there is an open failure on the dst side */
         MFU_LOG(MFU_LOG_ERR, "Failed to open destination file `%s' (errno=%d %s)",
                 dst_name, errno, strerror(errno));
-        mfu_file_close(src_name, mfu_src_file);
+        mfu_compare_ctx_close(ctx);
         return -1;
     }
+    ctx->dst_name  = MFU_STRDUP(dst_name);
+    ctx->dst_rw    = overwrite;
+    ctx->dst_dirty = 0;
 
-    /* hint that we'll read from file sequentially */
-    if (mfu_src_file->type != DAOS && mfu_src_file->type != DFS) {
-        posix_fadvise(mfu_src_file->fd, offset, length, POSIX_FADV_SEQUENTIAL);
+    /* newly opened files start out in O_DIRECT mode if requested */
+    ctx->direct    = direct;
+    ctx->direct_on = direct;
+
+    return 0;
+}
+
+/* hint that we will soon read the given range from a file */
+static void mfu_compare_prefetch(mfu_file_t* mfu_file, off_t off, off_t len)
+{
+    if (len > 0 && mfu_file->type == POSIX) {
+        posix_fadvise(mfu_file->fd, off, len, POSIX_FADV_WILLNEED);
+    }
+}
+
+/* compares contents of two files and optionally overwrite dest with source,
+ * reusing open files and buffers held in ctx,
+ * returns -1 on error, 0 if equal, 1 if different */
+int mfu_compare_contents_ctx(
+    mfu_compare_ctx* ctx,          /* IN  - compare context from mfu_compare_ctx_new */
+    const char* src_name,          /* IN  - path name to source file */
+    const char* dst_name,          /* IN  - path name to destination file */
+    off_t offset,                  /* IN  - offset with file to start comparison */
+    off_t length,                  /* IN  - number of bytes to be compared */
+    off_t file_size,               /* IN  - size of file */
+    int overwrite,                 /* IN  - whether to replace dest with source contents (1) or not (0) */
+    uint64_t* count_bytes_read,    /* OUT - number of bytes read (src + dest) */
+    uint64_t* count_bytes_written, /* OUT - number of bytes written to dest */
+    mfu_progress* prg)             /* IN  - progress message structure */
+{
+    /* extract values from copy options */
+    mfu_copy_opts_t* copy_opts = ctx->copy_opts;
+    size_t buf_size = ctx->buf_size;
+    mfu_file_t* mfu_src_file = &ctx->src_file;
+    mfu_file_t* mfu_dst_file = &ctx->dst_file;
+
+    /* only use O_DIRECT if the file is large enough to benefit */
+    int direct = mfu_direct_enabled(copy_opts, (uint64_t) file_size);
+
+    /* get source and destination files open, reusing those from the last call */
+    if (mfu_compare_ctx_open(ctx, src_name, dst_name, overwrite, direct) != 0) {
+        return -1;
+    }
+
+    /* hint that we'll read both files sequentially */
+    if (mfu_src_file->type == POSIX) {
         posix_fadvise(mfu_src_file->fd, offset, length, POSIX_FADV_SEQUENTIAL);
     }
+    if (mfu_dst_file->type == POSIX) {
+        posix_fadvise(mfu_dst_file->fd, offset, length, POSIX_FADV_SEQUENTIAL);
+    }
+
+    /* determine which portion of our range can use O_DIRECT,
+     * unaligned bytes at the head and tail use buffered I/O */
+    off_t direct_start, direct_end;
+    size_t direct_size;
+    mfu_direct_range(copy_opts, mfu_src_file, mfu_dst_file,
+        offset, length, file_size, &direct_start, &direct_end, &direct_size);
+
+    /* track whether O_DIRECT is currently set on the open files */
+    int direct_on = ctx->direct_on;
 
     /* assume we'll find that file contents are the same */
     int rc = 0;
 
-    /* TODO: replace this with mfu_copy_opts->buf */
-    /* allocate buffer to write files, aligned on 1MB boundaraies */
-    size_t alignment = 1024*1024;
-    void* src_buf = (char*) MFU_MEMALIGN(buf_size, alignment);
-    void* dst_buf = (char*) MFU_MEMALIGN(buf_size, alignment);
+    /* use buffers held in the context */
+    void* src_buf = ctx->src_buf;
+    void* dst_buf = ctx->dst_buf;
 
     /* initialize our starting offset within the file */
     off_t off = offset;
-
-    /* if we write with O_DIRECT, we may need to truncate file */
-    int need_truncate = 0;
+    off_t end = offset + length;
 
     /* read and compare data from files */
     off_t total_bytes = 0;
@@ -804,13 +1558,28 @@ int mfu_compare_contents(
         /* whether we should copy the source bytes to the destination */
         int need_copy = 0;
 
-        /* determine number of bytes to read in this iteration */
-        size_t left_to_read = buf_size;
-        if (! direct) {
-            off_t remainder = length - total_bytes;
-            if (remainder < (off_t)buf_size) {
-                left_to_read = (size_t) remainder;
+        /* determine number of bytes to read in this iteration,
+         * and whether this operation is aligned for O_DIRECT */
+        int use_direct;
+        size_t left_to_read = mfu_direct_next(off, end, buf_size,
+            direct_start, direct_end, direct_size, &use_direct);
+
+        /* switch files between direct and buffered modes if needed */
+        if (direct && direct_on != use_direct) {
+            if (mfu_file_set_direct(src_name, mfu_src_file, use_direct) != 0 ||
+                mfu_file_set_direct(dst_name, mfu_dst_file, use_direct) != 0)
+            {
+                /* fall back to buffered I/O for the rest of this range */
+                MFU_LOG(MFU_LOG_DBG, "Failed to toggle O_DIRECT on `%s' (errno=%d %s)",
+                    dst_name, errno, strerror(errno));
+                mfu_file_set_direct(src_name, mfu_src_file, 0);
+                mfu_file_set_direct(dst_name, mfu_dst_file, 0);
+                direct_size = 0;
+                use_direct  = 0;
+                left_to_read = mfu_direct_next(off, end, buf_size,
+                    direct_start, direct_end, direct_size, &use_direct);
             }
+            direct_on = use_direct;
         }
 
         /* read data from source file */
@@ -819,7 +1588,7 @@ int mfu_compare_contents(
         /* If we're using O_DIRECT, deal with short reads.
          * Retry with same buffer and offset since those must
          * be aligned at block boundaries. */
-        while (direct &&                     /* using O_DIRECT */
+        while (use_direct &&                 /* using O_DIRECT */
                src_read > 0 &&               /* read was not an error or eof */
                src_read < left_to_read &&    /* shorter than requested */
                (off + src_read) < file_size) /* not at end of file */
@@ -849,42 +1618,46 @@ int mfu_compare_contents(
         /* tally up number of bytes read */
         *count_bytes_read += (uint64_t) src_read;
 
-        /* read data from destination file */
-        ssize_t dst_read = mfu_file_pread(dst_name, (ssize_t*)dst_buf, left_to_read, off, mfu_dst_file);
+        /* read data from destination file, unless the caller already
+         * knows this range differs and only wants it copied */
+        ssize_t dst_read = src_read;
+        if (! ctx->known_differ) {
+            dst_read = mfu_file_pread(dst_name, (ssize_t*)dst_buf, left_to_read, off, mfu_dst_file);
+
+            /* If we're using O_DIRECT, deal with short reads.
+             * Retry with same buffer and offset since those must
+             * be aligned at block boundaries. */
+            while (use_direct &&                 /* using O_DIRECT */
+                   dst_read > 0 &&               /* read was not an error or eof */
+                   dst_read < left_to_read &&    /* shorter than requested */
+                   (off + dst_read) < file_size) /* not at end of file */
+            {
+                /* TODO: probably should retry a limited number of times then abort */
+                dst_read = mfu_file_pread(dst_name, dst_buf, left_to_read, off, mfu_dst_file);
+            }
 
-        /* If we're using O_DIRECT, deal with short reads.
-         * Retry with same buffer and offset since those must
-         * be aligned at block boundaries. */
-        while (direct &&                     /* using O_DIRECT */
-               dst_read > 0 &&               /* read was not an error or eof */
-               dst_read < left_to_read &&    /* shorter than requested */
-               (off + dst_read) < file_size) /* not at end of file */
-        {
-            /* TODO: probably should retry a limited number of times then abort */
-            dst_read = mfu_file_pread(dst_name, dst_buf, left_to_read, off, mfu_dst_file);
-        }
+            /* check for read error */
+            if (dst_read < 0) {
+                /* hit a read error */
+                MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' at offset %llx (errno=%d %s)",
+                    dst_name, (unsigned long long)off, errno, strerror(errno));
+                rc = -1;
+                break;
+            }
 
-        /* check for read error */
-        if (dst_read < 0) {
-            /* hit a read error */
-            MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' at offset %llx (errno=%d %s)",
-                dst_name, (unsigned long long)off, errno, strerror(errno));
-            rc = -1;
-            break;
-        }
+            /* check for early EOF */
+            if (dst_read == 0) {
+                /* destination is shorter than expected, consider this to be an error */
+                MFU_LOG(MFU_LOG_ERR, "Destination `%s' is shorter than expected %llx (errno=%d %s)",
+                    dst_name, (unsigned long long)off, errno, strerror(errno));
+                rc = -1;
+                break;
+            }
 
-        /* check for early EOF */
-        if (dst_read == 0) {
-            /* destination is shorter than expected, consider this to be an error */
-            MFU_LOG(MFU_LOG_ERR, "Destination `%s' is shorter than expected %llx (errno=%d %s)",
-                dst_name, (unsigned long long)off, errno, strerror(errno));
-            rc = -1;
-            break;
+            /* tally up number of bytes read */
+            *count_bytes_read += (uint64_t) dst_read;
         }
 
-        /* tally up number of bytes read */
-        *count_bytes_read += (uint64_t) dst_read;
-
         /* we could have a non-error short read, so adjust number
          * of bytes we compare and update offset to shorter of the two values
          * numread = min(src_read, dst_read) */
@@ -893,8 +1666,23 @@ int mfu_compare_contents(
             min_read = dst_read;
         }
 
+        /* ask the kernel to start reading the next block of both files
+         * while we compare this one, O_DIRECT reads bypass the page cache */
+        if (! use_direct && off + min_read < end) {
+            off_t next_len = end - (off + min_read);
+            if (next_len > (off_t) buf_size) {
+                next_len = (off_t) buf_size;
+            }
+            mfu_compare_prefetch(mfu_src_file, off + min_read, next_len);
+            if (! ctx->known_differ) {
+                mfu_compare_prefetch(mfu_dst_file, off + min_read, next_len);
+            }
+        }
+
         /* if have same size buffers, and read some data, let's check the contents */
-        if (memcmp((ssize_t*)src_buf, (ssize_t*)dst_buf, (size_t)min_read) != 0) {
+        if (ctx->known_differ ||
+            memcmp((ssize_t*)src_buf, (ssize_t*)dst_buf, (size_t)min_read) != 0)
+        {
             /* memory contents are different */
             rc = 1;
             if (! overwrite) {
@@ -904,30 +1692,19 @@ int mfu_compare_contents(
         }
 
         /* if the bytes are different,
-         * then copy the bytes from the source into the destination */
+         * then copy the bytes from the source into the destination,
+         * O_DIRECT operations are always block aligned and never extend
+         * past the end of the file, so no padding or truncation is needed */
         if (overwrite && need_copy) {
+            /* drop digests cached on the destination before changing it,
+             * since its times may be reset to those of the source */
+            if (! ctx->dst_dirty) {
+                mfu_digest_cache_invalidate(dst_name, mfu_dst_file);
+                ctx->dst_dirty = 1;
+            }
+
             /* compute number of bytes to write */
             size_t bytes_to_write = (size_t) min_read;
-            if (direct) {
-                /* O_DIRECT requires particular write sizes,
-                 * ok to write beyond end of file so long as
-                 * we truncate in cleanup step */
-                size_t remainder = buf_size - (size_t) min_read;
-                if (remainder > 0) {
-                    /* zero out the end of the buffer for security,
-                     * don't want to leave data from another file at end of
-                     * current file if we fail before truncating */
-                    char* bufzero = ((char*)src_buf + min_read);
-                    memset(bufzero, 0, remainder);
-
-                    /* remember that we might need to truncate,
-                     * because we may write past the end of the file */
-                    need_truncate = 1;
-                }
-
-                /* assumes buf_size is magic size for O_DIRECT */
-                bytes_to_write = buf_size;
-            }
 
             /* we loop to account for short writes */
             ssize_t n = 0;
@@ -939,7 +1716,7 @@ int mfu_compare_contents(
                 /* check for write error */
                 if (bytes_written < 0) {
                     MFU_LOG(MFU_LOG_ERR, "Failed to write `%s' at offset %llx (errno=%d %s)", 
-                        dst_name, (unsigned long long)off + n, strerror(errno));
+                        dst_name, (unsigned long long)off + n, errno, strerror(errno));
                     rc = -1;
                     break;
                 }
@@ -948,7 +1725,7 @@ int mfu_compare_contents(
                  * by advancing by the number of bytes written.  For O_DIRECT, we
                  * need to keep buffer, file offset, and amount to write aligned
                  * on block boundaries, so just retry the entire operation. */
-                if (!direct || bytes_written == bytes_to_write) {
+                if (!use_direct || bytes_written == bytes_to_write) {
                     /* advance index by number of bytes written */
                     n += bytes_written;
 
@@ -969,30 +1746,37 @@ int mfu_compare_contents(
         mfu_progress_update(count_bytes, prg);
     }
 
-    /* truncate destination file if we might have written past the end */
-    if (need_truncate) {
-        off_t last_written = offset + length;
-        off_t file_size_offt = (off_t) file_size;
-        if (last_written >= file_size_offt) {
-            /* Use ftruncate() here rather than truncate(), because grouplock
-             * of Lustre would cause block to truncate() since the fd is different
-             * from the out_fd. */
-            if (mfu_file_ftruncate(mfu_dst_file, file_size_offt) < 0) {
-                MFU_LOG(MFU_LOG_ERR, "Failed to truncate destination file: %s (errno=%d %s)",
-                    dst_name, errno, strerror(errno));
-                rc = -1;
-            }
-        }
-    }
+    /* remember O_DIRECT mode for the next call on these files */
+    ctx->direct_on = direct_on;
 
-    /* free buffers */
-    mfu_free(&src_buf);
-    mfu_free(&dst_buf);
+    /* don't hold files open after an error */
+    if (rc < 0) {
+        mfu_compare_ctx_close(ctx);
+    }
 
-    /* close files */
-    mfu_file_close(dst_name, mfu_dst_file);
-    mfu_file_close(src_name, mfu_src_file);
+    return rc;
+}
 
+/* compares contents of two files and optionally overwrite dest with source,
+ * returns -1 on error, 0 if equal, 1 if different */
+int mfu_compare_contents(
+    const char* src_name,          /* IN  - path name to source file */
+    const char* dst_name,          /* IN  - path name to destination file */
+    off_t offset,                  /* IN  - offset with file to start comparison */
+    off_t length,                  /* IN  - number of bytes to be compared */
+    off_t file_size,               /* IN  - size of file */
+    int overwrite,                 /* IN  - whether to replace dest with source contents (1) or not (0) */
+    mfu_copy_opts_t* copy_opts,    /* IN  - options for data compare/copy step */
+    uint64_t* count_bytes_read,    /* OUT - number of bytes read (src + dest) */
+    uint64_t* count_bytes_written, /* OUT - number of bytes written to dest */
+    mfu_progress* prg,             /* IN  - progress message structure */
+    mfu_file_t* mfu_src_file,      /* IN  - I/O filesystem functions to use for source */
+    mfu_file_t* mfu_dst_file)      /* IN  - I/O filesystem functions to use for destination */
+{
+    mfu_compare_ctx* ctx = mfu_compare_ctx_new(copy_opts, mfu_src_file, mfu_dst_file);
+    int rc = mfu_compare_contents_ctx(ctx, src_name, dst_name, offset, length, file_size,
+        overwrite, count_bytes_read, count_bytes_written, prg);
+    mfu_compare_ctx_free(&ctx);
     return rc;
 }
 
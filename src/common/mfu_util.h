@@ -80,6 +80,9 @@ extern mfu_loglevel mfu_debug_level;
 /* defines timeout period between progress messages */
 extern int mfu_progress_timeout;
 
+/* if set, back large pool buffers with huge pages from hugetlbfs */
+extern int mfu_buf_hugepages;
+
 #define MFU_LOG(level, ...) do {  \
         if (mfu_initialized && level <= mfu_debug_level) { \
             char timestamp[256]; \
@@ -158,6 +161,25 @@ void* mfu_memalign(
   int line
 );
 
+/* if size > 0, returns a buffer of at least size bytes aligned with
+ * specified alignment from a per-process pool of I/O buffers,
+ * allocating a new one if none is free, calls mfu_abort on failure,
+ * returns NULL if size == 0, return the buffer with mfu_buf_put */
+#define MFU_BUF_GET(X, Y) mfu_buf_get(X, Y, __FILE__, __LINE__)
+void* mfu_buf_get(
+  size_t size,
+  size_t alignment,
+  const char* file,
+  int line
+);
+
+/* caller passes in void** like mfu_free, return buffer to the pool
+ * so that it can be handed out again, set pointer to NULL */
+void mfu_buf_put(void* p);
+
+/* release all free buffers held in the pool, called in mfu_finalize */
+void mfu_buf_pool_free(void);
+
 /* if str != NULL, call strdup and return pointer, calls mfu_abort
  * if strdup fails */
 #define MFU_STRDUP(X) mfu_strdup(X, __FILE__, __LINE__)
@@ -239,6 +261,88 @@ void mfu_unpack_uint64(const char** pptr, uint64_t* value);
 /* Bob Jenkins one-at-a-time hash: http://en.wikipedia.org/wiki/Jenkins_hash_function */
 uint32_t mfu_hash_jenkins(const char* key, size_t len);
 
+/* initial value of a 64-bit FNV-1a hash */
+#define MFU_HASH_FNV_INIT (14695981039346656037ULL)
+
+/* continue a 64-bit FNV-1a hash over len bytes of data,
+ * start a new hash by passing MFU_HASH_FNV_INIT */
+uint64_t mfu_hash_fnv(uint64_t hash, const void* data, size_t len);
+
+/* send sendcounts[i] bytes starting at sendbuf + senddisps[i] to
+ * rank i of comm, unlike MPI_Alltoallv the counts may exceed INT_MAX,
+ * returns a newly allocated buffer holding the bytes received ordered
+ * by source rank, sets recv_total to its size, and if recvcounts is
+ * not NULL, sets recvcounts[i] to the number of bytes from rank i */
+void* mfu_alltoallv_bytes(
+    const void* sendbuf,
+    const size_t* sendcounts,
+    const size_t* senddisps,
+    size_t* recvcounts,
+    size_t* recv_total,
+    MPI_Comm comm
+);
+
+/* send each of count items of item_size bytes to the rank of comm
+ * given in dests, returns a newly allocated array of the items sent
+ * to this rank ordered by source rank and sets recv_count to the
+ * number of items in it */
+void* mfu_exchange_items(
+    const void* items,
+    const int* dests,
+    uint64_t count,
+    size_t item_size,
+    uint64_t* recv_count,
+    MPI_Comm comm
+);
+
+/* buffers of variable-size records packed for each rank of a
+ * communicator, to be delivered with mfu_exchange_all */
+typedef struct {
+    MPI_Comm comm;  /* communicator to exchange records on */
+    int ranks;      /* number of ranks in comm */
+    size_t* sizes;  /* bytes packed for each rank */
+    size_t* caps;   /* bytes allocated for each rank */
+    char** bufs;    /* packed records for each rank */
+} mfu_exchange;
+
+/* initialize empty record buffers for each rank of comm */
+void mfu_exchange_init(mfu_exchange* ex, MPI_Comm comm);
+
+/* append len bytes of data to records for rank */
+void mfu_exchange_pack(mfu_exchange* ex, int rank, const void* data, size_t len);
+
+/* append value to records for rank */
+void mfu_exchange_pack_u64(mfu_exchange* ex, int rank, uint64_t val);
+
+/* append first len bytes of str to records for rank as a terminated string */
+void mfu_exchange_pack_str(mfu_exchange* ex, int rank, const char* str, size_t len);
+
+/* send packed records to their ranks and free the record buffers,
+ * returns a newly allocated buffer of the records received from all
+ * ranks ordered by source rank and sets size to its total size */
+char* mfu_exchange_all(mfu_exchange* ex, size_t* size);
+
+/* number of bytes in a data digest computed with mfu_digest */
+#define MFU_DIGEST_SIZE (16)
+
+/* state to compute a 128-bit digest of a stream of bytes, this is
+ * a fast non-cryptographic hash to detect differences in file data */
+typedef struct {
+    uint64_t h1, h2;     /* hash lanes */
+    uint64_t len;        /* number of bytes added so far */
+    unsigned char tail[8]; /* bytes not yet consumed as a full word */
+    size_t tail_len;     /* number of valid bytes in tail */
+} mfu_digest_ctx;
+
+/* initialize digest state */
+void mfu_digest_init(mfu_digest_ctx* ctx);
+
+/* add size bytes from buf to digest */
+void mfu_digest_update(mfu_digest_ctx* ctx, const void* buf, size_t size);
+
+/* write final MFU_DIGEST_SIZE byte digest into out */
+void mfu_digest_final(mfu_digest_ctx* ctx, unsigned char* out);
+
 /* get secs and nsecs values from stat structure */
 void mfu_stat_get_atimes(const struct stat* sb, uint64_t* secs, uint64_t* nsecs);
 void mfu_stat_get_mtimes(const struct stat* sb, uint64_t* secs, uint64_t* nsecs);
@@ -249,6 +353,56 @@ void mfu_stat_set_atimes(struct stat* sb, uint64_t secs, uint64_t nsecs);
 void mfu_stat_set_mtimes(struct stat* sb, uint64_t secs, uint64_t nsecs);
 void mfu_stat_set_ctimes(struct stat* sb, uint64_t secs, uint64_t nsecs);
 
+/* state kept across calls to mfu_compare_contents_ctx, holds the
+ * most recent pair of files open so that consecutive chunks of the
+ * same file do not reopen it, and keeps the compare buffers */
+typedef struct {
+    mfu_copy_opts_t* copy_opts; /* options to use in compare/copy */
+    mfu_file_t src_file;        /* source I/O functions, holds open source file */
+    mfu_file_t dst_file;        /* destination I/O functions, holds open destination file */
+    char* src_name;             /* name of open source file, NULL if none */
+    char* dst_name;             /* name of open destination file, NULL if none */
+    int dst_rw;                 /* whether destination is open for writing */
+    int dst_dirty;              /* whether we have written to the open destination */
+    int known_differ;           /* set to skip reading the destination of ranges
+                                 * the caller already knows differ, with overwrite
+                                 * the source is then copied over the whole range */
+    int direct;                 /* whether files were opened with O_DIRECT */
+    int direct_on;              /* whether O_DIRECT is currently set on files */
+    size_t buf_size;            /* size of each buffer */
+    void* src_buf;              /* buffer to read source data */
+    void* dst_buf;              /* buffer to read destination data */
+} mfu_compare_ctx;
+
+/* allocate a compare context, copy_opts must remain valid until
+ * the context is freed */
+mfu_compare_ctx* mfu_compare_ctx_new(
+    mfu_copy_opts_t* copy_opts,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file
+);
+
+/* close any files held open, free buffers and the context,
+ * and set caller's pointer to NULL */
+void mfu_compare_ctx_free(mfu_compare_ctx** ctx);
+
+/* same as mfu_compare_contents, but reuses open files and buffers
+ * held in ctx, the files remain open until a call names a different
+ * pair of files or the context is freed,
+ * returns -1 on error, 0 if equal, 1 if different */
+int mfu_compare_contents_ctx(
+    mfu_compare_ctx* ctx,     /* IN  - compare context */
+    const char* src,          /* IN  - path name to souce file */
+    const char* dst,          /* IN  - path name to destination file */
+    off_t offset,             /* IN  - offset with file to start comparison */
+    off_t length,             /* IN  - number of bytes to be compared */
+    off_t file_size,          /* IN  - size of file to be compared */
+    int overwrite,            /* IN  - whether to replace dest with source contents (1) or not (0) */
+    uint64_t* bytes_read,     /* OUT - number of bytes read (src + dest) */
+    uint64_t* bytes_written,  /* OUT - number of bytes written to dest */
+    mfu_progress* prg         /* IN  - progress message structure */
+);
+
 /* compares contents of two files and optionally overwrite dest with source,
  * returns -1 on error, 0 if equal, 1 if different */
 int mfu_compare_contents(
@@ -266,6 +420,42 @@ int mfu_compare_contents(
     mfu_file_t* mfu_dst_file  /* IN  - I/O filesystem functions to use for destination */
 );
 
+/* returns 1 if a file of the given size should be read and written
+ * with O_DIRECT according to the copy options, 0 otherwise */
+int mfu_direct_enabled(const mfu_copy_opts_t* opts, uint64_t file_size);
+
+/* given source and destination files that are open to transfer
+ * bytes [offset, offset+length), compute the subrange that can be
+ * transferred with O_DIRECT and the I/O size to use within it,
+ * the subrange and I/O size are aligned to the preferred block size
+ * (st_blksize) of both files, bytes before and after the subrange
+ * should be transferred with buffered I/O, sets direct_size to 0
+ * if O_DIRECT should not be used at all */
+void mfu_direct_range(
+    const mfu_copy_opts_t* opts, /* IN  - options for data compare/copy step */
+    mfu_file_t* mfu_src_file,    /* IN  - open source file */
+    mfu_file_t* mfu_dst_file,    /* IN  - open destination file */
+    off_t offset,                /* IN  - offset within file to start transfer */
+    off_t length,                /* IN  - number of bytes to be transferred */
+    off_t file_size,             /* IN  - size of file */
+    off_t* direct_start,         /* OUT - first byte to transfer with O_DIRECT */
+    off_t* direct_end,           /* OUT - one past last byte to transfer with O_DIRECT */
+    size_t* direct_size          /* OUT - I/O size to use with O_DIRECT, 0 to disable */
+);
+
+/* given the current offset, the end of the transfer, and the range
+ * computed by mfu_direct_range, return the number of bytes for the
+ * next I/O operation, sets direct=1 if that operation should use O_DIRECT */
+size_t mfu_direct_next(
+    off_t off,           /* IN  - current offset within file */
+    off_t end,           /* IN  - one past last byte of transfer */
+    size_t buf_size,     /* IN  - size of I/O buffer */
+    off_t direct_start,  /* IN  - first byte to transfer with O_DIRECT */
+    off_t direct_end,    /* IN  - one past last byte to transfer with O_DIRECT */
+    size_t direct_size,  /* IN  - I/O size to use with O_DIRECT */
+    int* direct          /* OUT - whether next operation should use O_DIRECT */
+);
+
 /* uses the lustre api to obtain stripe count and stripe size of a file */
 int mfu_stripe_get(const char *path, uint64_t *stripe_size, uint64_t *stripe_count);
 
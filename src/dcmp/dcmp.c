@@ -15,9 +15,10 @@
 /* for bool type, true/false macros */
 #include <stdbool.h>
 #include <assert.h>
+#include <math.h>
 
 #include "mfu.h"
-#include "strmap.h"
+#include "mfu_statemap.h"
 #include "list.h"
 
 /* for daos */
@@ -45,11 +46,17 @@ static void print_usage(void)
     printf("      --daos-api            - DAOS API in {DFS, DAOS} (default uses DFS for POSIX containers)\n");
 #endif
     printf("  -s, --direct              - open files with O_DIRECT\n");
+    printf("      --direct-threshold <SIZE> - read only files of at least SIZE bytes with O_DIRECT when comparing contents (implies --direct)\n");
     printf("      --open-noatime        - open files with O_NOATIME\n");
     printf("      --progress <N>        - print progress every N seconds\n");
     printf("  -v, --verbose             - verbose output\n");
     printf("  -q, --quiet               - quiet output\n");
     printf("  -l, --lite                - only compares file modification time and size\n");
+    printf("      --digest              - compare digests of data read separately from source and target\n");
+    printf("      --data-readers <N>    - with --digest, first N ranks read the source and the others the target\n");
+    printf("      --sample <FRACTION>   - compare only FRACTION of the chunks of each file, in (0,1]\n");
+    printf("      --sample-bytes <SIZE> - compare sampled chunks totaling at most SIZE bytes overall\n");
+    printf("      --sample-seed <N>     - seed used to choose sampled chunks (default 0)\n");
     //printf("  -d, --debug               - run in debug mode\n");
     printf("  -h, --help                - print usage\n");
     printf("\n");
@@ -180,6 +187,10 @@ struct dcmp_options {
     int format;                    /* output data format, 0 for text, 1 for raw */
     int base;                      /* whether to do base check */
     int debug;                     /* check result after get result */
+    int digest;                    /* compare digests of data read separately from each side */
+    double sample;                 /* fraction of chunks to compare in each file, 0 to compare all */
+    uint64_t sample_bytes;         /* total bytes to compare across all files, 0 for no budget */
+    uint64_t sample_seed;          /* seed used to choose which chunks are sampled */
     int need_compare[DCMPF_MAX];   /* fields that need to be compared  */
 };
 
@@ -191,6 +202,10 @@ struct dcmp_options options = {
     .format       = 1,
     .base         = 0,
     .debug        = 0,
+    .digest       = 0,
+    .sample       = 0.0,
+    .sample_bytes = 0,
+    .sample_seed  = 0,
     .need_compare = {0,}
 };
 
@@ -364,117 +379,78 @@ static int dcmp_state_from_string(const char* string, dcmp_state *state)
     return -ENOENT;
 }
 
-/* given a filename as the key, encode an index followed
- * by the init state */
+/* given a filename as the key, record its index,
+ * all fields start in the init state */
 static void dcmp_strmap_item_init(
-    strmap* map,
+    mfu_statemap* map,
     const char *key,
     uint64_t item_index)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char val[21 + DCMPF_MAX];
-    int i;
-
-    /* encode the index */
-    int len = snprintf(val, sizeof(val), "%llu",
-                       (unsigned long long) item_index);
-
-    /* encode the state (state characters and trailing NUL) */
-    assert((size_t)len + DCMPF_MAX + 1 <= (sizeof(val)));
-    size_t position = strlen(val);
-    for (i = 0; i < DCMPF_MAX; i++) {
-        val[position] = DCMPS_INIT;
-        position++;
-    }
-    val[position] = '\0';
-
     /* add item to map */
-    strmap_set(map, key, val);
+    mfu_statemap_insert(map, item_index, key);
 }
 
 static void dcmp_strmap_item_update(
-    strmap* map,
+    mfu_statemap* map,
     const char *key,
     dcmp_field field,
     dcmp_state state)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char new_val[21 + DCMPF_MAX];
-
     /* lookup item from map */
-    const char* val = strmap_get(map, key);
-
-    /* copy existing index over */
+    uint64_t item_index;
+    int rc = mfu_statemap_lookup(map, key, &item_index);
+    assert(rc == 0);
     assert(field < DCMPF_MAX);
-    assert(strlen(val) + 1 <= sizeof(new_val));
-    strcpy(new_val, val);
 
     /* set new state value */
-    size_t position = strlen(new_val) - DCMPF_MAX;
-    new_val[position + field] = state;
-
-    /* reinsert item in map */
-    strmap_set(map, key, new_val);
+    mfu_statemap_set(map, item_index, field, state - DCMPS_INIT);
 }
 
 static int dcmp_strmap_item_index(
-    strmap* map,
+    mfu_statemap* map,
     const char *key,
     uint64_t *item_index)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char new_val[21 + DCMPF_MAX];
-
     /* lookup item from map */
-    const char* val = strmap_get(map, key);
-    if (val == NULL) {
-        return -1;
-    }
-
-    /* extract index */
-    assert(strlen(val) + 1 <= sizeof(new_val));
-    strcpy(new_val, val);
-    new_val[strlen(new_val) - DCMPF_MAX] = '\0';
-    *item_index = strtoull(new_val, NULL, 0);
-
-    return 0;
+    return mfu_statemap_lookup(map, key, item_index);
 }
 
 static int dcmp_strmap_item_state(
-    strmap* map,
+    mfu_statemap* map,
     const char *key,
     dcmp_field field,
     dcmp_state *state)
 {
     /* lookup item from map */
-    const char* val = strmap_get(map, key);
-    if (val == NULL) {
+    uint64_t item_index;
+    if (mfu_statemap_lookup(map, key, &item_index) != 0) {
         return -1;
     }
 
     /* extract state */
-    assert(strlen(val) > DCMPF_MAX);
     assert(field < DCMPF_MAX);
-    size_t position = strlen(val) - DCMPF_MAX;
-    *state = val[position + field];
+    *state = DCMPS_INIT + mfu_statemap_get(map, item_index, field);
 
     return 0;
 }
 
 /* map each file name to its index in the file list and initialize
- * its state for comparison operation */
-static strmap* dcmp_strmap_creat(mfu_flist list, const char* prefix)
+ * its state for comparison operation, the map refers to names
+ * in the list, so it must be deleted before the list is freed */
+static mfu_statemap* dcmp_strmap_creat(mfu_flist list, const char* prefix)
 {
-    /* create a new string map to map a file name to a string
-     * encoding its index and state */
-    strmap* map = strmap_new();
+    /* iterate over each item in the file list */
+    uint64_t i = 0;
+    uint64_t count = mfu_flist_size(list);
+
+    /* create a new map from a file name to its index and state */
+    assert(DCMPF_MAX <= MFU_STATEMAP_FIELDS_MAX);
+    assert(DCMPS_MAX - DCMPS_INIT <= MFU_STATEMAP_STATE_MAX);
+    mfu_statemap* map = mfu_statemap_new(count);
 
     /* determine length of prefix string */
     size_t prefix_len = strlen(prefix);
 
-    /* iterate over each item in the file list */
-    uint64_t i = 0;
-    uint64_t count = mfu_flist_size(list);
     while (i < count) {
         /* get full path of file name */
         const char* name = mfu_flist_file_get_name(list, i);
@@ -498,8 +474,8 @@ static void dcmp_compare_acl(
     uint64_t src_index,
     mfu_flist dst_list,
     uint64_t dst_index,
-    strmap* src_map,
-    strmap* dst_map,
+    mfu_statemap* src_map,
+    mfu_statemap* dst_map,
     int *diff)
 {
     void *src_val, *dst_val;
@@ -570,10 +546,10 @@ static int dcmp_option_need_compare(dcmp_field field)
 /* Return -1 when error, return 0 when equal, return > 0 when diff */
 static int dcmp_compare_metadata(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     uint64_t src_index,
     mfu_flist dst_list,
-    strmap* dst_map,
+    mfu_statemap* dst_map,
     uint64_t dst_index,
     const char* key)
 {
@@ -763,14 +739,419 @@ static void compare_progress_fn(const uint64_t* vals, int count, int complete, i
     }
 }
 
+/* confidence level used when reporting results of a sampled compare */
+#define DCMP_SAMPLE_CONFIDENCE 0.95
+
+/* hash a file name together with the sampling seed, every process
+ * computes the same value for a given file */
+static uint64_t dcmp_sample_hash(uint64_t seed, const char* name)
+{
+    /* FNV-1a over the name, starting from a basis mixed with the seed */
+    uint64_t hash = mfu_hash_fnv(MFU_HASH_FNV_INIT ^ seed, name, strlen(name));
+
+    /* finalize so that small changes in seed spread to all bits */
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static uint64_t dcmp_sample_gcd(uint64_t a, uint64_t b)
+{
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* number of chunks a file of the given size is split into */
+static uint64_t dcmp_sample_chunks(uint64_t file_size, uint64_t chunk_size)
+{
+    uint64_t chunks = file_size / chunk_size;
+    if (chunks * chunk_size < file_size || chunks == 0) {
+        chunks++;
+    }
+    return chunks;
+}
+
+/* number of chunks taken from a file of the given number of chunks,
+ * a file contributes ceil(fraction * chunks) of them, at least one */
+static uint64_t dcmp_sample_want(uint64_t chunks, double fraction)
+{
+    uint64_t want = (uint64_t) ceil(fraction * (double) chunks);
+    if (want > chunks) {
+        want = chunks;
+    }
+    if (want == 0) {
+        want = 1;
+    }
+    return want;
+}
+
+/* return 1 if a file is part of the sample when only a threshold
+ * fraction of files is sampled, every process decides the same */
+static int dcmp_sample_file(const char* name, double threshold)
+{
+    if (threshold >= 1.0) {
+        return 1;
+    }
+    uint64_t hash = dcmp_sample_hash(options.sample_seed ^ 0x9e3779b97f4a7c15ULL, name);
+    double u = (double) (hash >> 11) / 9007199254740992.0;
+    return (u < threshold);
+}
+
+/* which chunks of one file are taken for the sample */
+typedef struct {
+    uint64_t chunks; /* number of chunks in the file */
+    uint64_t want;   /* number of chunks taken, 0 if the file is left out */
+    uint64_t a, b;   /* chunk k is taken if (a * k + b) mod chunks < want */
+} dcmp_sample_plan;
+
+/* compute which chunks of file name are taken, so that the chunks of
+ * a file can be decided independently on whichever processes hold them */
+static void dcmp_sample_plan_init(
+    dcmp_sample_plan* plan,
+    const char* name,
+    uint64_t file_size,
+    uint64_t chunk_size,
+    double fraction,
+    double threshold)
+{
+    plan->chunks = dcmp_sample_chunks(file_size, chunk_size);
+    plan->want   = dcmp_sample_want(plan->chunks, fraction);
+    plan->a      = 1;
+    plan->b      = 0;
+    if (! dcmp_sample_file(name, threshold)) {
+        plan->want = 0;
+        return;
+    }
+    if (plan->want >= plan->chunks) {
+        return;
+    }
+
+    /* pick a multiplier coprime to the chunk count and an offset,
+     * so that k -> (a * k + b) mod chunks is a permutation, there are
+     * at least two chunks here and chunks - 1 is always coprime */
+    uint64_t hash = dcmp_sample_hash(options.sample_seed, name);
+    uint64_t a = 1 + (hash % (plan->chunks - 1));
+    while (dcmp_sample_gcd(a, plan->chunks) != 1) {
+        a++;
+    }
+    plan->a = a;
+    plan->b = (hash >> 32) % plan->chunks;
+}
+
+/* return 1 if chunk k of the file is part of the sample */
+static int dcmp_sample_plan_take(const dcmp_sample_plan* plan, uint64_t k)
+{
+    if (plan->want >= plan->chunks) {
+        return 1;
+    }
+    uint64_t pos = ((plan->a % plan->chunks) * k + plan->b) % plan->chunks;
+    return (pos < plan->want);
+}
+
+/* return an upper bound on the number of bytes sampled across all
+ * files in list for the given fraction and threshold */
+static uint64_t dcmp_sample_bytes(
+    mfu_flist list,
+    size_t strlen_prefix,
+    uint64_t chunk_size,
+    double fraction,
+    double threshold)
+{
+    uint64_t bytes = 0;
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(list);
+    for (idx = 0; idx < size; idx++) {
+        if (mfu_flist_file_get_type(list, idx) != MFU_TYPE_FILE) {
+            continue;
+        }
+        const char* name = mfu_flist_file_get_name(list, idx) + strlen_prefix;
+        if (! dcmp_sample_file(name, threshold)) {
+            continue;
+        }
+        uint64_t file_size = mfu_flist_file_get_size(list, idx);
+        uint64_t chunks = dcmp_sample_chunks(file_size, chunk_size);
+        uint64_t want = dcmp_sample_want(chunks, fraction);
+        if (want >= chunks) {
+            bytes += file_size;
+        } else {
+            bytes += want * chunk_size;
+        }
+    }
+
+    uint64_t all_bytes;
+    MPI_Allreduce(&bytes, &all_bytes, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    return all_bytes;
+}
+
+/* choose the fraction of chunks to take from each file, and the
+ * fraction of files to take at all, so that no more than budget
+ * bytes are compared, files are only left out when taking a single
+ * chunk from every file would exceed the budget */
+static void dcmp_sample_budget(
+    mfu_flist list,
+    size_t strlen_prefix,
+    uint64_t chunk_size,
+    uint64_t budget,
+    double* fraction,
+    double* threshold)
+{
+    *fraction  = 1.0;
+    *threshold = 1.0;
+    if (dcmp_sample_bytes(list, strlen_prefix, chunk_size, 1.0, 1.0) <= budget) {
+        return;
+    }
+
+    /* the sampled bytes only grow with the fraction, so bisect for
+     * the largest fraction that stays within budget */
+    int iter;
+    double lo = 0.0;
+    double hi = 1.0;
+    if (dcmp_sample_bytes(list, strlen_prefix, chunk_size, 0.0, 1.0) <= budget) {
+        for (iter = 0; iter < 40; iter++) {
+            double mid = (lo + hi) / 2.0;
+            if (dcmp_sample_bytes(list, strlen_prefix, chunk_size, mid, 1.0) <= budget) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        *fraction = lo;
+        return;
+    }
+
+    /* otherwise take one chunk from as many files as fit */
+    for (iter = 0; iter < 40; iter++) {
+        double mid = (lo + hi) / 2.0;
+        if (dcmp_sample_bytes(list, strlen_prefix, chunk_size, 0.0, mid) <= budget) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    *fraction  = 0.0;
+    *threshold = lo;
+}
+
+/* append a copy of chunk p to the list given by head and tail */
+static void dcmp_sample_chunk_append(
+    const mfu_file_chunk* p,
+    mfu_file_chunk** head,
+    mfu_file_chunk** tail)
+{
+    mfu_file_chunk* elem = (mfu_file_chunk*) MFU_MALLOC(sizeof(mfu_file_chunk));
+    *elem = *p;
+    elem->name = MFU_STRDUP(p->name);
+    elem->next = NULL;
+
+    if (*tail != NULL) {
+        (*tail)->next = elem;
+    } else {
+        *head = elem;
+    }
+    *tail = elem;
+}
+
+/* per-file counts of sampled chunks, sent to the owner of the file */
+typedef struct {
+    uint64_t index;   /* index of file in list on its owner */
+    uint64_t sampled; /* number of chunks of the file we compared */
+    uint64_t differ;  /* number of those that differ */
+} dcmp_sample_stat;
+
+/* totals over all files of a sampled compare */
+typedef struct {
+    uint64_t counts[5];      /* total, sampled, differing chunks, total and sampled bytes */
+    uint64_t exact_chunks;   /* chunks in files that were compared in full */
+    uint64_t exact_differ;   /* differing chunks in files compared in full */
+    uint64_t part_chunks;    /* chunks in files that were partly compared */
+    uint64_t skipped_files;  /* files with no chunk compared */
+    uint64_t skipped_chunks; /* chunks in files with no chunk compared */
+    double part_differ;      /* estimated differing chunks in partly compared files */
+    double part_weight;      /* sum over partly compared files of chunks^2 / sampled */
+} dcmp_sample_totals;
+
+/* given the file index and comparison result of each sampled chunk
+ * held by this process, gather the counts for each file on its owner
+ * and sum the per-file strata into totals on every process */
+static void dcmp_sample_strata(
+    mfu_flist list,
+    uint64_t chunk_size,
+    const mfu_file_chunk* head,
+    const uint64_t* elems,
+    const int* cmp_vals,
+    uint64_t cmp_count,
+    dcmp_sample_totals* totals)
+{
+    /* sum up counts for each file whose chunks we compared, sampled
+     * chunks of the same element are consecutive */
+    dcmp_sample_stat* stats = (dcmp_sample_stat*) MFU_MALLOC(
+        cmp_count * sizeof(dcmp_sample_stat) + 1);
+    int* dests = (int*) MFU_MALLOC(cmp_count * sizeof(int) + 1);
+    uint64_t nstats = 0;
+    uint64_t elem = 0;
+    const mfu_file_chunk* p = head;
+    uint64_t i;
+    for (i = 0; i < cmp_count; i++) {
+        while (elem < elems[i]) {
+            p = p->next;
+            elem++;
+        }
+        if (nstats == 0 || stats[nstats - 1].index != p->index_of_owner ||
+            dests[nstats - 1] != (int) p->rank_of_owner)
+        {
+            stats[nstats].index   = p->index_of_owner;
+            stats[nstats].sampled = 0;
+            stats[nstats].differ  = 0;
+            dests[nstats] = (int) p->rank_of_owner;
+            nstats++;
+        }
+        stats[nstats - 1].sampled++;
+        if (cmp_vals[i] != 0) {
+            stats[nstats - 1].differ++;
+            totals->counts[2]++;
+        }
+    }
+
+    uint64_t recv_count;
+    dcmp_sample_stat* recv = (dcmp_sample_stat*) mfu_exchange_items(
+        stats, dests, nstats, sizeof(dcmp_sample_stat), &recv_count, MPI_COMM_WORLD);
+
+    /* add up counts for each of our files */
+    uint64_t size = mfu_flist_size(list);
+    uint64_t* sampled = (uint64_t*) MFU_CALLOC(size + 1, sizeof(uint64_t));
+    uint64_t* differ  = (uint64_t*) MFU_CALLOC(size + 1, sizeof(uint64_t));
+    for (i = 0; i < recv_count; i++) {
+        sampled[recv[i].index] += recv[i].sampled;
+        differ[recv[i].index]  += recv[i].differ;
+    }
+
+    /* each file is a stratum, files compared in full are known
+     * exactly, and the others contribute an estimate weighted by
+     * their number of chunks */
+    for (i = 0; i < size; i++) {
+        if (mfu_flist_file_get_type(list, i) != MFU_TYPE_FILE) {
+            continue;
+        }
+        uint64_t chunks = dcmp_sample_chunks(mfu_flist_file_get_size(list, i), chunk_size);
+        double n = (double) chunks;
+        if (sampled[i] == 0) {
+            totals->skipped_files++;
+            totals->skipped_chunks += chunks;
+        } else if (sampled[i] >= chunks) {
+            totals->exact_chunks += chunks;
+            totals->exact_differ += differ[i];
+        } else {
+            totals->part_chunks += chunks;
+            totals->part_differ += n * (double) differ[i] / (double) sampled[i];
+            totals->part_weight += n * n / (double) sampled[i];
+        }
+    }
+
+    uint64_t vals[10];
+    memcpy(vals, totals->counts, sizeof(totals->counts));
+    vals[5] = totals->exact_chunks;
+    vals[6] = totals->exact_differ;
+    vals[7] = totals->part_chunks;
+    vals[8] = totals->skipped_files;
+    vals[9] = totals->skipped_chunks;
+    uint64_t all_vals[10];
+    MPI_Allreduce(vals, all_vals, 10, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    memcpy(totals->counts, all_vals, sizeof(totals->counts));
+    totals->exact_chunks   = all_vals[5];
+    totals->exact_differ   = all_vals[6];
+    totals->part_chunks    = all_vals[7];
+    totals->skipped_files  = all_vals[8];
+    totals->skipped_chunks = all_vals[9];
+
+    double dvals[2] = {totals->part_differ, totals->part_weight};
+    double all_dvals[2];
+    MPI_Allreduce(dvals, all_dvals, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    totals->part_differ = all_dvals[0];
+    totals->part_weight = all_dvals[1];
+
+    mfu_free(&differ);
+    mfu_free(&sampled);
+    mfu_free(&recv);
+    mfu_free(&dests);
+    mfu_free(&stats);
+}
+
+/* report how much data was sampled and an upper bound, at
+ * DCMP_SAMPLE_CONFIDENCE, on the fraction of chunks that differ
+ * in the files that were sampled */
+static void dcmp_sample_report(const dcmp_sample_totals* totals)
+{
+    uint64_t total_chunks   = totals->counts[0];
+    uint64_t sampled_chunks = totals->counts[1];
+    uint64_t differ_chunks  = totals->counts[2];
+    uint64_t total_bytes    = totals->counts[3];
+    uint64_t sampled_bytes  = totals->counts[4];
+
+    /* upper bound on fraction of differing chunks in partly compared
+     * files, treating the stratified estimate as a proportion over
+     * the effective sample size of the strata */
+    double part_bound = 0.0;
+    double part_chunks = (double) totals->part_chunks;
+    if (totals->part_chunks > 0) {
+        double n = part_chunks * part_chunks / totals->part_weight;
+        double phat = totals->part_differ / part_chunks;
+        if (phat <= 0.0) {
+            /* no difference seen in n draws, probability of that when a
+             * fraction p differs is (1 - p)^n, solve for the p that
+             * would have been seen with the given confidence */
+            part_bound = 1.0 - pow(1.0 - DCMP_SAMPLE_CONFIDENCE, 1.0 / n);
+        } else {
+            /* one-sided Wilson score interval */
+            double z = 1.6449;
+            double z2n = z * z / n;
+            double center = phat + z2n / 2.0;
+            double spread = z * sqrt(phat * (1.0 - phat) / n + z2n / (4.0 * n));
+            part_bound = (center + spread) / (1.0 + z2n);
+        }
+        if (part_bound > 1.0) {
+            part_bound = 1.0;
+        }
+    }
+
+    /* files compared in full are known exactly */
+    double covered = (double) totals->exact_chunks + part_chunks;
+    double bound = 0.0;
+    if (covered > 0.0) {
+        bound = ((double) totals->exact_differ + part_bound * part_chunks) / covered;
+    }
+
+    double sampled_tmp, total_tmp;
+    const char* sampled_units;
+    const char* total_units;
+    mfu_format_bytes(sampled_bytes, &sampled_tmp, &sampled_units);
+    mfu_format_bytes(total_bytes, &total_tmp, &total_units);
+
+    MFU_LOG(MFU_LOG_INFO, "Sampled %" PRIu64 " of %" PRIu64 " chunks (%.3lf %s of %.3lf %s), seed %" PRIu64,
+        sampled_chunks, total_chunks, sampled_tmp, sampled_units, total_tmp, total_units,
+        options.sample_seed);
+    MFU_LOG(MFU_LOG_INFO, "Sampled chunks that differ: %" PRIu64, differ_chunks);
+    MFU_LOG(MFU_LOG_INFO, "With %.0f%% confidence, at most %.4f%% of chunks in sampled files differ",
+        DCMP_SAMPLE_CONFIDENCE * 100.0, bound * 100.0);
+    if (totals->skipped_files > 0) {
+        MFU_LOG(MFU_LOG_INFO, "Files with no sampled chunks, not covered by this bound: %" PRIu64 " (%" PRIu64 " chunks)",
+            totals->skipped_files, totals->skipped_chunks);
+    }
+    MFU_LOG(MFU_LOG_INFO, "Files reported with CONTENT=COMMON only had their sampled chunks compared");
+}
+
 /* given a list of source/destination files to compare, spread file
  * sections to processes to compare in parallel, fill
  * in comparison results in source and dest string maps */
 static int dcmp_strmap_compare_data(
     mfu_flist src_compare_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist dst_compare_list,
-    strmap* dst_map,
+    mfu_statemap* dst_map,
     size_t strlen_prefix,
     mfu_copy_opts_t* copy_opts,
     mfu_file_t* mfu_src_file,
@@ -810,6 +1191,7 @@ static int dcmp_strmap_compare_data(
     mfu_file_chunk* dst_head = mfu_file_chunk_list_alloc(dst_compare_list, chunk_size);
 
     /* get a count of how many items are the chunk list */
+    uint64_t i = 0;
     uint64_t list_count = mfu_file_chunk_list_size(src_head);
 
     /* allocate a flag for each element in chunk list,
@@ -817,47 +1199,153 @@ static int dcmp_strmap_compare_data(
      * to be used as input to logical OR to determine state of entire file */
     int* vals = (int*) MFU_MALLOC(list_count * sizeof(int));
 
+    /* by default we compare every chunk in the list */
+    const mfu_file_chunk* cmp_src_head = src_head;
+    const mfu_file_chunk* cmp_dst_head = dst_head;
+    uint64_t cmp_count = list_count;
+    int* cmp_vals = vals;
+
+    /* when sampling, build lists holding only the chosen chunks,
+     * since the chunk list is already spread evenly across processes
+     * and each process holds about the same fraction of every file,
+     * the sampled work remains balanced, an element of the chunk list
+     * may cover several chunks, so split it at chunk boundaries and
+     * decide on each chunk, and record which element each came from */
+    int sampling = (options.sample > 0.0 || options.sample_bytes > 0);
+    mfu_file_chunk* sample_src_head = NULL;
+    mfu_file_chunk* sample_dst_head = NULL;
+    uint64_t* elems = NULL;
+    dcmp_sample_totals totals;
+    memset(&totals, 0, sizeof(totals));
+    if (sampling) {
+        /* compute the fraction of chunks to take from each file */
+        double fraction  = options.sample;
+        double threshold = 1.0;
+        if (options.sample_bytes > 0) {
+            dcmp_sample_budget(src_compare_list, strlen_prefix, chunk_size,
+                options.sample_bytes, &fraction, &threshold);
+        }
+
+        uint64_t elems_cap = 1024;
+        elems = (uint64_t*) MFU_MALLOC(elems_cap * sizeof(uint64_t));
+
+        mfu_file_chunk* src_tail = NULL;
+        mfu_file_chunk* dst_tail = NULL;
+        const mfu_file_chunk* src_p = src_head;
+        const mfu_file_chunk* dst_p = dst_head;
+        uint64_t sampled_bytes = 0;
+        for (i = 0; i < list_count; i++) {
+            dcmp_sample_plan plan;
+            dcmp_sample_plan_init(&plan, src_p->name + strlen_prefix, src_p->file_size,
+                chunk_size, fraction, threshold);
+
+            /* walk the chunks this element covers, a zero-length
+             * element still stands for the single chunk of its file */
+            uint64_t offset = src_p->offset;
+            uint64_t end = src_p->offset + src_p->length;
+            do {
+                uint64_t length = end - offset;
+                if (length > chunk_size) {
+                    length = chunk_size;
+                }
+                totals.counts[0]++;
+                if (dcmp_sample_plan_take(&plan, offset / chunk_size)) {
+                    dcmp_sample_chunk_append(src_p, &sample_src_head, &src_tail);
+                    dcmp_sample_chunk_append(dst_p, &sample_dst_head, &dst_tail);
+                    src_tail->offset = offset;
+                    src_tail->length = length;
+                    dst_tail->offset = offset;
+                    dst_tail->length = length;
+
+                    if (totals.counts[1] == elems_cap) {
+                        elems_cap *= 2;
+                        elems = (uint64_t*) realloc(elems, elems_cap * sizeof(uint64_t));
+                        if (elems == NULL) {
+                            MFU_ABORT(-1, "Failed to allocate %llu bytes",
+                                (unsigned long long) (elems_cap * sizeof(uint64_t)));
+                        }
+                    }
+                    elems[totals.counts[1]] = i;
+                    totals.counts[1]++;
+                    sampled_bytes += length;
+                }
+                offset += length;
+            } while (offset < end);
+            totals.counts[3] += src_p->length;
+
+            src_p = src_p->next;
+            dst_p = dst_p->next;
+        }
+        totals.counts[4] = sampled_bytes;
+
+        cmp_src_head = sample_src_head;
+        cmp_dst_head = sample_dst_head;
+        cmp_count    = totals.counts[1];
+        cmp_vals     = (int*) MFU_MALLOC(cmp_count * sizeof(int) + 1);
+
+        /* progress is measured against the bytes we will actually read */
+        sampled_bytes *= 2;
+        MPI_Allreduce(&sampled_bytes, &compare_total_count, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    }
+
     /* start progress messages when comparing data */
     mfu_progress* prg = mfu_progress_start(mfu_progress_timeout, 2, MPI_COMM_WORLD, compare_progress_fn);
 
-    /* compare bytes for each file section and set flag based on what we find */
-    uint64_t i = 0;
-    const mfu_file_chunk* src_p = src_head;
-    const mfu_file_chunk* dst_p = dst_head;
     uint64_t bytes_read    = 0;
     uint64_t bytes_written = 0;
-    for (i = 0; i < list_count; i++) {
-        /* get offset into file that we should compare (bytes) */
-        off_t offset = (off_t)src_p->offset;
-
-        /* get length of section that we should compare (bytes) */
-        off_t length = (off_t)src_p->length;
-
-        /* get size of file that we should compare (bytes) */
-        off_t filesize = (off_t)src_p->file_size;
-
-        /* compare the contents of the files */
-        int overwrite = 0;
-        int compare_rc = mfu_compare_contents(src_p->name, dst_p->name, offset, length, filesize,
-                overwrite, copy_opts, &bytes_read, &bytes_written, prg, mfu_src_file, mfu_dst_file);
-        if (compare_rc == -1) {
-            /* we hit an error while reading */
+    if (options.digest) {
+        /* read source and destination chunks in separate passes
+         * and compare their digests */
+        int digest_rc = mfu_file_chunk_list_digest_compare(src_compare_list, dst_compare_list,
+            cmp_src_head, cmp_dst_head, copy_opts, cmp_vals, &bytes_read, &bytes_written, prg,
+            mfu_src_file, mfu_dst_file);
+        if (digest_rc != 0) {
+            /* chunks we failed to read are marked as different */
             rc = -1;
-            MFU_LOG(MFU_LOG_ERR,
-              "Failed to open, lseek, or read %s and/or %s. Assuming contents are different.",
-                 src_p->name, dst_p->name);
-
-            /* consider files to be different,
-             * they could be the same, but we'll draw attention to them this way */
-            compare_rc = 1;
         }
+    } else {
+        /* keep files open and buffers allocated across chunks */
+        mfu_compare_ctx* compare_ctx = mfu_compare_ctx_new(copy_opts, mfu_src_file, mfu_dst_file);
+
+        /* compare bytes for each file section and set flag based on what we find */
+        const mfu_file_chunk* src_p = cmp_src_head;
+        const mfu_file_chunk* dst_p = cmp_dst_head;
+        for (i = 0; i < cmp_count; i++) {
+            /* get offset into file that we should compare (bytes) */
+            off_t offset = (off_t)src_p->offset;
+
+            /* get length of section that we should compare (bytes) */
+            off_t length = (off_t)src_p->length;
+
+            /* get size of file that we should compare (bytes) */
+            off_t filesize = (off_t)src_p->file_size;
+
+            /* compare the contents of the files */
+            int overwrite = 0;
+            int compare_rc = mfu_compare_contents_ctx(compare_ctx, src_p->name, dst_p->name, offset, length, filesize,
+                    overwrite, &bytes_read, &bytes_written, prg);
+            if (compare_rc == -1) {
+                /* we hit an error while reading */
+                rc = -1;
+                MFU_LOG(MFU_LOG_ERR,
+                  "Failed to open, lseek, or read %s and/or %s. Assuming contents are different.",
+                     src_p->name, dst_p->name);
+
+                /* consider files to be different,
+                 * they could be the same, but we'll draw attention to them this way */
+                compare_rc = 1;
+            }
 
-        /* record results of comparison */
-        vals[i] = compare_rc;
+            /* record results of comparison */
+            cmp_vals[i] = compare_rc;
+
+            /* update pointers for src and dest in linked list */
+            src_p = src_p->next;
+            dst_p = dst_p->next;
+        }
 
-        /* update pointers for src and dest in linked list */
-        src_p = src_p->next;
-        dst_p = dst_p->next;
+        /* close files and release buffers */
+        mfu_compare_ctx_free(&compare_ctx);
     }
 
     /* finalize progress messages */
@@ -866,6 +1354,31 @@ static int dcmp_strmap_compare_data(
     count_bytes[1] = bytes_written;
     mfu_progress_complete(count_bytes, &prg);
 
+    if (sampling) {
+        /* chunks left out of the sample are taken to be the same,
+         * an element differs if any of its sampled chunks does */
+        for (i = 0; i < list_count; i++) {
+            vals[i] = 0;
+        }
+        for (i = 0; i < cmp_count; i++) {
+            if (cmp_vals[i] != 0) {
+                vals[elems[i]] = 1;
+            }
+        }
+
+        /* sum up counts for each file and report what we found */
+        dcmp_sample_strata(src_compare_list, chunk_size, src_head,
+            elems, cmp_vals, cmp_count, &totals);
+        if (mfu_rank == 0) {
+            dcmp_sample_report(&totals);
+        }
+
+        mfu_free(&cmp_vals);
+        mfu_free(&elems);
+        mfu_file_chunk_list_free(&sample_src_head);
+        mfu_file_chunk_list_free(&sample_dst_head);
+    }
+
     /* allocate a flag for each item in our file list */
     int* results = (int*) MFU_MALLOC(size * sizeof(int));
 
@@ -970,9 +1483,9 @@ static void time_strmap_compare(mfu_flist src_list, double start_compare,
 /* compare entries from src into dst */
 static int dcmp_strmap_compare(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist dst_list,
-    strmap* dst_map,
+    mfu_statemap* dst_map,
     size_t strlen_prefix,
     mfu_copy_opts_t* copy_opts,
     const mfu_param_path* src_path,
@@ -1009,11 +1522,11 @@ static int dcmp_strmap_compare(
     uint64_t dst_mtime_nsec;
 
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
+    uint64_t node;
+    mfu_statemap_foreach(src_map, node) {
 
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_statemap_key(src_map, node);
 
         /* get index of source file */
         uint64_t src_index;
@@ -1154,7 +1667,12 @@ static int dcmp_strmap_compare(
 
     /* get total bytes read (if any) */
     if (cmp_global_size > 0) {
-        total_bytes_read = get_total_bytes_read(src_compare_list);
+        if (options.sample > 0.0 || options.sample_bytes > 0) {
+            /* only sampled chunks were read */
+            total_bytes_read = compare_total_count;
+        } else {
+            total_bytes_read = get_total_bytes_read(src_compare_list);
+        }
     }
 
     time_strmap_compare(src_list, start_compare, end_compare, &time_started,
@@ -1168,15 +1686,15 @@ static int dcmp_strmap_compare(
 }
 
 /* loop on the src map to check the results */
-static void dcmp_strmap_check_src(strmap* src_map,
-                                  strmap* dst_map)
+static void dcmp_strmap_check_src(mfu_statemap* src_map,
+                                  mfu_statemap* dst_map)
 {
     assert(dcmp_option_need_compare(DCMPF_EXIST));
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
+    uint64_t node;
+    mfu_statemap_foreach(src_map, node) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_statemap_key(src_map, node);
         int only_src = 0;
 
         /* get index of source file */
@@ -1256,16 +1774,16 @@ static void dcmp_strmap_check_src(strmap* src_map,
 }
 
 /* loop on the dest map to check the results */
-static void dcmp_strmap_check_dst(strmap* src_map,
-    strmap* dst_map)
+static void dcmp_strmap_check_dst(mfu_statemap* src_map,
+    mfu_statemap* dst_map)
 {
     assert(dcmp_option_need_compare(DCMPF_EXIST));
 
     /* iterate over each item in dest map */
-    const strmap_node* node;
-    strmap_foreach(dst_map, node) {
+    uint64_t node;
+    mfu_statemap_foreach(dst_map, node) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_statemap_key(dst_map, node);
         int only_dest = 0;
 
         /* get index of destination file */
@@ -1357,8 +1875,8 @@ static void dcmp_strmap_check_dst(strmap* src_map,
 
 /* check the result maps are valid */
 static void dcmp_strmap_check(
-    strmap* src_map,
-    strmap* dst_map)
+    mfu_statemap* src_map,
+    mfu_statemap* dst_map)
 {
     dcmp_strmap_check_src(src_map, dst_map);
     dcmp_strmap_check_dst(src_map, dst_map);
@@ -1452,7 +1970,7 @@ static void dcmp_expression_print(
 
 static int dcmp_expression_match(
     struct dcmp_expression *expression,
-    strmap* map,
+    mfu_statemap* map,
     const char* key)
 {
     int ret;
@@ -1581,7 +2099,7 @@ static void dcmp_conjunction_print(
 /* if matched return 1, else return 0 */
 static int dcmp_conjunction_match(
     struct dcmp_conjunction *conjunction,
-    strmap* map,
+    mfu_statemap* map,
     const char* key)
 {
     struct dcmp_expression* expression;
@@ -1680,7 +2198,7 @@ static void dcmp_disjunction_print(
 /* if matched return 1, else return 0 */
 static int dcmp_disjunction_match(
     struct dcmp_disjunction* disjunction,
-    strmap* map,
+    mfu_statemap* map,
     const char* key,
     int is_src)
 {
@@ -1773,19 +2291,19 @@ static void dcmp_option_add_comparison(dcmp_field field)
 
 static int dcmp_output_flist_match(
     struct dcmp_output *output,
-    strmap* map,
+    mfu_statemap* map,
     mfu_flist flist,
     mfu_flist new_flist,
     mfu_flist *matched_flist,
     int is_src)
 {
-    const strmap_node* node;
+    uint64_t node;
     struct dcmp_conjunction *conjunction;
 
     /* iterate over each item in map */
-    strmap_foreach(map, node) {
+    mfu_statemap_foreach(map, node) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_statemap_key(map, node);
 
         /* get index of file */
         uint64_t idx;
@@ -1816,9 +2334,9 @@ static int dcmp_output_flist_match(
 static int dcmp_output_write(
     struct dcmp_output *output,
     mfu_flist src_flist,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist dst_flist,
-    strmap* dst_map)
+    mfu_statemap* dst_map)
 {
     int ret = 0;
     mfu_flist new_flist = mfu_flist_subset(src_flist);
@@ -1873,9 +2391,9 @@ static int dcmp_output_write(
 
 static int dcmp_outputs_write(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist dst_list,
-    strmap* dst_map)
+    mfu_statemap* dst_map)
 {
     struct dcmp_output* output;
     int ret = 0;
@@ -2121,11 +2639,17 @@ int main(int argc, char **argv)
         {"chunksize",     1, 0, 'k'},
         {"daos-api",      1, 0, 'x'},
         {"direct",        0, 0, 's'},
+        {"direct-threshold", 1, 0, 'T'},
         {"open-noatime",  0, 0, 'U'},
         {"progress",      1, 0, 'R'},
         {"verbose",       0, 0, 'v'},
         {"quiet",         0, 0, 'q'},
         {"lite",          0, 0, 'l'},
+        {"digest",        0, 0, 'G'},
+        {"data-readers",  1, 0, 'r'},
+        {"sample",        1, 0, 'P'},
+        {"sample-bytes",  1, 0, 'Y'},
+        {"sample-seed",   1, 0, 'E'},
         {"debug",         0, 0, 'd'},
         {"help",          0, 0, 'h'},
         {0, 0, 0, 0}
@@ -2188,6 +2712,21 @@ int main(int argc, char **argv)
                 MFU_LOG(MFU_LOG_INFO, "Using O_DIRECT");
             }
             break;
+        case 'T':
+            if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS) {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR,
+                            "Failed to parse direct threshold: '%s'", optarg);
+                }
+                usage = 1;
+            } else {
+                copy_opts->direct = true;
+                copy_opts->direct_threshold = (uint64_t)bytes;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Using O_DIRECT for files of at least %llu bytes", bytes);
+                }
+            }
+            break;
         case 'U':
             copy_opts->open_noatime = true;
             if(rank == 0) {
@@ -2211,6 +2750,40 @@ int main(int argc, char **argv)
         case 'l':
             options.lite++;
             break;
+        case 'G':
+            options.digest = 1;
+            break;
+        case 'r':
+            copy_opts->reader_ranks = atoi(optarg);
+            break;
+        case 'P': {
+            char* end = NULL;
+            double fraction = strtod(optarg, &end);
+            if (end == optarg || *end != '\0' || !(fraction > 0.0 && fraction <= 1.0)) {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR,
+                            "Sample fraction must be in (0,1]: '%s'", optarg);
+                }
+                usage = 1;
+            } else {
+                options.sample = fraction;
+            }
+            break;
+        }
+        case 'Y':
+            if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS || bytes == 0) {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR,
+                            "Failed to parse sample bytes: '%s'", optarg);
+                }
+                usage = 1;
+            } else {
+                options.sample_bytes = (uint64_t)bytes;
+            }
+            break;
+        case 'E':
+            options.sample_seed = (uint64_t) strtoull(optarg, NULL, 0);
+            break;
         case 'd':
             options.debug++;
             break;
@@ -2241,6 +2814,32 @@ int main(int argc, char **argv)
         usage = 1;
     }
 
+    /* check that we leave at least one rank to read the target */
+    if (copy_opts->reader_ranks < 0 || copy_opts->reader_ranks >= ranks) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Number of data readers must be less than the number of ranks %d: %d invalid",
+                ranks, copy_opts->reader_ranks);
+        }
+        usage = 1;
+    }
+
+    /* only one way of sizing the sample can be used */
+    if (options.sample > 0.0 && options.sample_bytes > 0) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Only one of --sample and --sample-bytes may be given");
+        }
+        usage = 1;
+    }
+
+    /* lite mode never reads file data, so there is nothing to sample */
+    if (options.lite && (options.sample > 0.0 || options.sample_bytes > 0)) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_WARN, "Ignoring sample options since --lite does not compare file contents");
+        }
+        options.sample = 0.0;
+        options.sample_bytes = 0;
+    }
+
     /* Generate default output */
     if (options.base || list_empty(&options.outputs)) {
         /*
@@ -2346,8 +2945,8 @@ int main(int argc, char **argv)
     mfu_flist flist4 = mfu_flist_remap(flist2, (mfu_flist_map_fn)dcmp_map_fn, (const void*)path2);
 
     /* map each file name to its index and its comparison state */
-    strmap* map1 = dcmp_strmap_creat(flist3, path1);
-    strmap* map2 = dcmp_strmap_creat(flist4, path2);
+    mfu_statemap* map1 = dcmp_strmap_creat(flist3, path1);
+    mfu_statemap* map2 = dcmp_strmap_creat(flist4, path2);
 
     /* compare files in map1 with those in map2 */
     int tmp_rc = dcmp_strmap_compare(flist3, map1, flist4, map2, strlen(path1), copy_opts, srcpath, destpath,
@@ -2366,8 +2965,8 @@ int main(int argc, char **argv)
     dcmp_outputs_write(flist3, map1, flist4, map2);
 
     /* free maps of file names to comparison state info */
-    strmap_delete(&map1);
-    strmap_delete(&map2);
+    mfu_statemap_delete(&map1);
+    mfu_statemap_delete(&map2);
 
     /* free file lists */
     mfu_flist_free(&flist1);
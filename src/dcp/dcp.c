@@ -21,6 +21,14 @@
 
 #include "timing.h"
 
+/* map items round robin to the data readers given in args */
+static int map_readers(mfu_flist flist, uint64_t idx, int ranks, const void* args)
+{
+    int readers = *(const int*) args;
+    uint64_t global_idx = mfu_flist_global_offset(flist) + idx;
+    return (int) (global_idx % (uint64_t) readers);
+}
+
 static int input_flist_skip(const char* name, void *args)
 {
     /* nothing to do if args are NULL */
@@ -82,6 +90,7 @@ void print_usage(void)
     printf("  -b, --bufsize <SIZE>     - IO buffer size in bytes (default " MFU_BUFFER_SIZE_STR ")\n");
     printf("  -k, --chunksize <SIZE>   - work size per task in bytes (default " MFU_CHUNK_SIZE_STR ")\n");
     printf("  -X, --xattrs <OPT>       - copy xattrs (none, all, non-lustre, libattr)\n");
+    printf("      --walk-xattrs        - read xattrs while walking the source rather than during the copy\n");
 #ifdef DAOS_SUPPORT
     printf("      --daos-api           - DAOS API in {DFS, DAOS} (default uses DFS for POSIX containers)\n");
 #ifdef HDF5_SUPPORT
@@ -94,8 +103,14 @@ void print_usage(void)
     printf("  -P, --no-dereference     - don't follow links in source\n");
     printf("  -p, --preserve           - preserve permissions, ownership, timestamps (see also --xattrs)\n");
     printf("  -s, --direct             - open files with O_DIRECT\n");
+    printf("      --direct-threshold <SIZE> - copy files smaller than SIZE through the page cache, larger ones with O_DIRECT (implies --direct)\n");
     printf("      --open-noatime       - open files with O_NOATIME\n");
     printf("  -S, --sparse             - create sparse files when possible\n");
+    printf("      --preallocate        - reserve space for file data when creating files\n");
+#ifdef LUSTRE_SUPPORT
+    printf("      --stripe-bytes <SIZE> - stripe new files with one stripe per SIZE bytes of data\n");
+#endif
+    printf("      --data-readers <N>   - first N ranks walk and read the source and send data to the others to write\n");
     printf("      --progress <N>       - print progress every N seconds\n");
     printf("  -G  --gid <GID>          - Set the group id to perform copy\n");
     printf("  -U  --uid <UID>          - Set the user id to perform copy\n");
@@ -149,6 +164,9 @@ int main(int argc, char** argv)
     /* By default, don't have iput file. */
     char* inputname = NULL;
 
+    /* whether to capture xattrs while walking */
+    int walk_xattrs = 0;
+
 #ifdef DAOS_SUPPORT
     /* DAOS vars */ 
     daos_args_t* daos_args = daos_args_new();    
@@ -164,13 +182,20 @@ int main(int argc, char** argv)
         {"input"                , required_argument, 0, 'i'},
         {"chunksize"            , required_argument, 0, 'k'},
         {"xattrs"               , required_argument, 0, 'X'},
+        {"walk-xattrs"          , no_argument      , 0, 'E'},
         {"dereference"          , no_argument      , 0, 'L'},
         {"no-dereference"       , no_argument      , 0, 'P'},
         {"preserve"             , no_argument      , 0, 'p'},
         {"synchronous"          , no_argument      , 0, 's'},
         {"direct"               , no_argument      , 0, 's'},
+        {"direct-threshold"     , required_argument, 0, 'T'},
         {"open-noatime"         , no_argument      , 0, 'A'},
         {"sparse"               , no_argument      , 0, 'S'},
+        {"preallocate"          , no_argument      , 0, 'F'},
+#ifdef LUSTRE_SUPPORT
+        {"stripe-bytes"         , required_argument, 0, 'W'},
+#endif
+        {"data-readers"         , required_argument, 0, 'r'},
         {"progress"             , required_argument, 0, 'R'},
         {"gid"                  , required_argument, 0, 'G'},
         {"uid"                  , required_argument, 0, 'U'},
@@ -257,6 +282,9 @@ int main(int argc, char** argv)
                     usage = 1;
                 }
                 break;
+            case 'E':
+                walk_xattrs = 1;
+                break;
 #ifdef LUSTRE_SUPPORT
             case 'g':
                 mfu_copy_opts->grouplock_id = atoi(optarg);
@@ -324,6 +352,21 @@ int main(int argc, char** argv)
                     MFU_LOG(MFU_LOG_INFO, "Using O_DIRECT");
                 }
                 break;
+            case 'T':
+                if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR,
+                                "Failed to parse direct threshold: '%s'", optarg);
+                    }
+                    usage = 1;
+                } else {
+                    mfu_copy_opts->direct = true;
+                    mfu_copy_opts->direct_threshold = (uint64_t)bytes;
+                    if(rank == 0) {
+                        MFU_LOG(MFU_LOG_INFO, "Using O_DIRECT for files of at least %llu bytes", bytes);
+                    }
+                }
+                break;
             case 'A':
                 mfu_copy_opts->open_noatime = true;
                 if(rank == 0) {
@@ -336,6 +379,35 @@ int main(int argc, char** argv)
                     MFU_LOG(MFU_LOG_INFO, "Using sparse file");
                 }
                 break;
+            case 'F':
+                if (mfu_copy_opts->create_opts == NULL) {
+                    mfu_copy_opts->create_opts = mfu_create_opts_new();
+                }
+                mfu_copy_opts->create_opts->preallocate = true;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Preallocating space for new files");
+                }
+                break;
+#ifdef LUSTRE_SUPPORT
+            case 'W':
+                if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS || bytes == 0) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR,
+                                "Failed to parse stripe bytes: '%s'", optarg);
+                    }
+                    usage = 1;
+                } else {
+                    if (mfu_copy_opts->create_opts == NULL) {
+                        mfu_copy_opts->create_opts = mfu_create_opts_new();
+                    }
+                    mfu_copy_opts->create_opts->lustre_stripe       = true;
+                    mfu_copy_opts->create_opts->lustre_stripe_bytes = (uint64_t)bytes;
+                }
+                break;
+#endif
+            case 'r':
+                mfu_copy_opts->reader_ranks = atoi(optarg);
+                break;
             case 'R':
                 mfu_progress_timeout = atoi(optarg);
                 break;
@@ -375,6 +447,35 @@ int main(int argc, char** argv)
         usage = 1;
     }
 
+    /* capture the xattrs we will copy during the walk,
+     * so we don't list and read them again when copying */
+    if (walk_xattrs) {
+        walk_opts->xattrs = mfu_copy_opts->copy_xattrs;
+        if (walk_opts->xattrs == XATTR_COPY_NONE) {
+            walk_opts->xattrs = XATTR_COPY_ALL;
+        }
+    }
+
+    /* check that we leave at least one rank to write */
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+    if (mfu_copy_opts->reader_ranks < 0 || mfu_copy_opts->reader_ranks >= ranks) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Number of data readers must be less than the number of ranks %d: %d invalid",
+                ranks, mfu_copy_opts->reader_ranks);
+        }
+        usage = 1;
+    }
+
+    /* keep the source walk on the data readers, and capture the xattrs
+     * we copy so writers need not read them from the source */
+    if (mfu_copy_opts->reader_ranks > 0) {
+        walk_opts->reader_ranks = mfu_copy_opts->reader_ranks;
+        if (walk_opts->xattrs == XATTR_COPY_NONE) {
+            walk_opts->xattrs = mfu_copy_opts->copy_xattrs;
+        }
+    }
+
     /* If we need to print the usage
      * then do so before internal processing */
     if (usage) {
@@ -526,6 +627,14 @@ int main(int argc, char** argv)
             mfu_flist input_flist = mfu_flist_new();
             mfu_flist_read_cache(inputname, input_flist);
 
+            /* only data readers stat the source */
+            if (walk_opts->reader_ranks > 0) {
+                mfu_flist readers_flist = mfu_flist_remap(input_flist, map_readers,
+                    &walk_opts->reader_ranks);
+                mfu_flist_free(&input_flist);
+                input_flist = readers_flist;
+            }
+
             skip_args.numpaths = numpaths_src;
             skip_args.paths = paths;
             mfu_flist_stat(input_flist, flist, input_flist_skip, (void *)&skip_args,
@@ -7,6 +7,10 @@
 #include <openssl/sha.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
 
 #include "mpi.h"
 #include "dtcmp.h"
@@ -17,9 +21,101 @@
  * 1 for group ID + (SHA256_DIGEST_LENGTH / 8) */
 #define DDUP_KEY_SIZE 5
 
-/* amount of data to read in order to compute hash */
+/* number of bytes hashed from the head and from the tail of each
+ * file in the first round, the span hashed from the head doubles
+ * with each round after that */
+#define DDUP_HEAD_SIZE 4096
+
+/* size of buffer used to read data from files */
 #define DDUP_CHUNK_SIZE 1048576
 
+/* once the hashed span would grow beyond this size, the remainder
+ * of each file is split into chunks of this size that are hashed in
+ * parallel across all ranks and combined into a Merkle tree */
+#define DDUP_MERKLE_CHUNK_SIZE (64ULL * 1024ULL * 1024ULL)
+
+/* magic value at the start of a digest cache file ("ddupcach") */
+#define DDUP_CACHE_MAGIC (0x6464757063616368ULL)
+
+/* version of the digest cache file format */
+#define DDUP_CACHE_VERSION (1)
+
+/* number of uint64_t values in header of digest cache file:
+ * magic, version, entry count */
+#define DDUP_CACHE_HDR (3)
+
+/* number of uint64_t values that identify a version of a file:
+ * device, inode, size, mtime in nsecs, ctime in nsecs */
+#define DDUP_CACHE_KEY (5)
+
+/* number of bytes in each entry of the digest cache file */
+#define DDUP_CACHE_ENTRY (DDUP_CACHE_KEY * 8 + SHA256_DIGEST_LENGTH)
+
+/* max number of bytes to dedupe in a single FIDEDUPERANGE call,
+ * some file systems limit the length of a call */
+#define DDUP_DEDUPE_SIZE (16ULL * 1024ULL * 1024ULL)
+
+/* state of the hash used to filter candidate files */
+typedef struct {
+    SHA256_CTX sha256;
+} ddup_hash_ctx;
+
+/* functions to compute the hash used to filter candidate files,
+ * a digest is at most SHA256_DIGEST_LENGTH bytes */
+typedef struct {
+    size_t size;      /* number of bytes in digest */
+    void (*init)(ddup_hash_ctx* ctx);
+    void (*update)(ddup_hash_ctx* ctx, const void* buf, size_t size);
+    void (*final)(ddup_hash_ctx* ctx, unsigned char* digest);
+} ddup_hash;
+
+static void ddup_sha256_init(ddup_hash_ctx* ctx)
+{
+    SHA256_Init(&ctx->sha256);
+}
+
+static void ddup_sha256_update(ddup_hash_ctx* ctx, const void* buf, size_t size)
+{
+    SHA256_Update(&ctx->sha256, buf, size);
+}
+
+static void ddup_sha256_final(ddup_hash_ctx* ctx, unsigned char* digest)
+{
+    SHA256_Final(digest, &ctx->sha256);
+}
+
+/* hash used to filter candidate files, which also defines
+ * the digests we report and cache */
+static const ddup_hash ddup_sha256 = {
+    SHA256_DIGEST_LENGTH, ddup_sha256_init, ddup_sha256_update, ddup_sha256_final
+};
+#define DDUP_SHA256 (&ddup_sha256)
+
+/* ways to reclaim space used by duplicate files */
+typedef enum {
+    DDUP_RECLAIM_NONE = 0, /* only report duplicates */
+    DDUP_RECLAIM_DEDUPE,   /* share extents with FIDEDUPERANGE */
+    DDUP_RECLAIM_CLONE,    /* replace with a FICLONE copy */
+    DDUP_RECLAIM_HARDLINK, /* replace with a hard link */
+} ddup_reclaim_mode;
+
+struct ddup_options {
+    bool open_noatime;         /* whether to open files with O_NOATIME */
+    char* cache;               /* path to digest cache file, NULL if not used */
+    ddup_reclaim_mode reclaim; /* how to reclaim space of duplicates */
+    bool chunks;               /* whether to analyze duplicate chunks instead */
+    uint64_t chunk_size;       /* average chunk size for chunk analysis */
+};
+
+/* default options */
+static struct ddup_options options = {
+    .open_noatime = false,
+    .cache        = NULL,
+    .reclaim      = DDUP_RECLAIM_NONE,
+    .chunks       = false,
+    .chunk_size   = 64 * 1024,
+};
+
 /* Print a usage message */
 static void print_usage(void)
 {
@@ -28,6 +124,10 @@ static void print_usage(void)
     printf("\n");
     printf("Options:\n");
     printf("      --open-noatime   - open files with O_NOATIME\n");
+    printf("      --cache <FILE>   - read and update digests cached in FILE\n");
+    printf("      --reclaim <MODE> - reclaim space of duplicates, one of: dedupe,clone,hardlink\n");
+    printf("      --chunks         - report duplicate data in content-defined chunks instead of files\n");
+    printf("      --chunk-size <N> - average chunk size for --chunks (default 64KB)\n");
     printf("  -d, --debug <DEBUG>  - set verbosity, one of: fatal,err,warn,info,dbg\n");
     printf("  -v, --verbose        - verbose output\n");
     printf("  -q, --quiet          - quiet output\n");
@@ -37,126 +137,2020 @@ static void print_usage(void)
     fflush(stdout);
 }
 
-/* create MPI datatypes for key and key and satellite data */
-static void mpi_type_init(MPI_Datatype* key, MPI_Datatype* keysat)
+/* create MPI datatypes for key and key and satellite data */
+static void mpi_type_init(MPI_Datatype* key, MPI_Datatype* keysat)
+{
+    assert(SHA256_DIGEST_LENGTH == (DDUP_KEY_SIZE - 1) * 8);
+
+    /*
+     * Build MPI datatype for key.
+     * 1 for group ID + (SHA256_DIGEST_LENGTH / 8)
+     */
+    MPI_Type_contiguous(DDUP_KEY_SIZE, MPI_UINT64_T, key);
+    MPI_Type_commit(key);
+
+    /*
+     * Build MPI datatype for key + satellite
+     * length of key + 1 for index in flist
+     */
+    MPI_Type_contiguous(DDUP_KEY_SIZE + 1, MPI_UINT64_T, keysat);
+    MPI_Type_commit(keysat);
+}
+
+/* free off the MPI types */
+static void mpi_type_fini(MPI_Datatype* key, MPI_Datatype* keysat)
+{
+    MPI_Type_free(keysat);
+    MPI_Type_free(key);
+}
+
+/* create a comparison operation for our key */
+static int mtcmp_cmp_init(DTCMP_Op* cmp)
+{
+    int i;
+    DTCMP_Op series[DDUP_KEY_SIZE];
+    for (i = 0; i < DDUP_KEY_SIZE; i++) {
+        series[i] = DTCMP_OP_UINT64T_ASCEND;
+    }
+    return DTCMP_Op_create_series(DDUP_KEY_SIZE, series, cmp);
+}
+
+/* free the comparison operation */
+static void mtcmp_cmp_fini(DTCMP_Op* cmp)
+{
+    DTCMP_Op_free(cmp);
+}
+
+struct file_item {
+    ddup_hash_ctx ctx;  /* hash of bytes read from start of file so far */
+    uint64_t offset;    /* number of bytes from start of file in ctx */
+    int fd;             /* file descriptor if held open, -1 otherwise */
+    bool error;         /* whether we failed to read the file */
+    bool cached;        /* whether digest was found in the cache */
+    bool candidate;     /* whether file shares its size with another file */
+    bool ident_valid;   /* whether ident holds identity of the file */
+    uint64_t ident[DDUP_CACHE_KEY]; /* identity of file in the cache */
+    unsigned char digest[SHA256_DIGEST_LENGTH]; /* digest we report */
+};
+
+/* determine whether we may open a file owned by the given user
+ * with O_NOATIME, if requested */
+static bool ddup_noatime(uid_t owner, const mfu_proc_t* proc)
+{
+    return options.open_noatime &&
+           (proc->geteuid == owner || proc->cap_fowner);
+}
+
+/* compute the end of the span of bytes from the start of each file
+ * that should be hashed by the given round, this begins with a small
+ * head and doubles each round, so that the number of rounds is
+ * logarithmic in the size of the largest file */
+static uint64_t ddup_round_end(uint64_t round)
+{
+    assert(round > 0);
+    uint64_t end = DDUP_HEAD_SIZE;
+    while (round > 1) {
+        if (end > UINT64_MAX / 2) {
+            return UINT64_MAX;
+        }
+        end *= 2;
+        round--;
+    }
+    return end;
+}
+
+/* open the file for the given item if it is not already open,
+ * we keep files open across rounds as long as we have not hit
+ * our limit on open descriptors, returns file descriptor or -1 */
+static int ddup_open(
+    struct file_item* item,
+    const char* fname,
+    bool noatime,
+    uint64_t* open_count,
+    uint64_t open_max)
+{
+    /* nothing to do if file is already open */
+    if (item->fd >= 0) {
+        return item->fd;
+    }
+
+    /* open the file */
+    int flags = O_RDONLY;
+    if (noatime) {
+        flags |= O_NOATIME;
+    }
+    int fd = mfu_open(fname, flags);
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* hold on to the descriptor for later rounds if we can */
+    if (*open_count < open_max) {
+        item->fd = fd;
+        (*open_count)++;
+    }
+
+    return fd;
+}
+
+/* close the file descriptor used to read from the file,
+ * unless it is being held open for a later round */
+static void ddup_release(struct file_item* item, const char* fname, int fd)
+{
+    if (fd >= 0 && fd != item->fd) {
+        mfu_close(fname, fd);
+    }
+}
+
+/* close the file for the given item if it is held open */
+static void ddup_close(struct file_item* item, const char* fname, uint64_t* open_count)
+{
+    if (item->fd >= 0) {
+        mfu_close(fname, item->fd);
+        item->fd = -1;
+        (*open_count)--;
+    }
+}
+
+/* read length bytes starting at offset from the file and add them
+ * to the given hash context, returns -1 on any read error or if the
+ * file is shorter than expected */
+static int hash_data(
+    const char* fname,
+    int fd,
+    const ddup_hash* hash,
+    ddup_hash_ctx* ctx,
+    char* buf,
+    uint64_t offset,
+    uint64_t length)
+{
+    while (length > 0) {
+        /* read up to a full buffer */
+        size_t bytes = DDUP_CHUNK_SIZE;
+        if ((uint64_t)bytes > length) {
+            bytes = (size_t) length;
+        }
+        ssize_t read_size = mfu_pread(fname, fd, buf, bytes, (off_t)offset);
+        if (read_size <= 0) {
+            /* read failed or file size has been changed */
+            return -1;
+        }
+
+        hash->update(ctx, buf, (size_t)read_size);
+
+        offset += (uint64_t)read_size;
+        length -= (uint64_t)read_size;
+    }
+    return 0;
+}
+
+/* digest of one chunk of a file, sent to the rank that owns the file */
+struct ddup_leaf {
+    uint64_t index; /* index of file in candidate list on its owner */
+    uint64_t chunk; /* chunk number within file */
+    uint64_t error; /* whether the chunk could not be read */
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+};
+
+/* compare leaves by file index and then by chunk */
+static int ddup_leaf_cmp(const void* a, const void* b)
+{
+    const struct ddup_leaf* x = (const struct ddup_leaf*) a;
+    const struct ddup_leaf* y = (const struct ddup_leaf*) b;
+    if (x->index != y->index) {
+        return (x->index < y->index) ? -1 : 1;
+    }
+    if (x->chunk != y->chunk) {
+        return (x->chunk < y->chunk) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* compute the Merkle root of count leaf digests in place, each
+ * parent is the hash of its two children, and an odd node at the
+ * end of a level is carried up unchanged, the root is left in the
+ * first digest */
+static void ddup_merkle_root(const ddup_hash* hash, struct ddup_leaf* leaves, uint64_t count)
+{
+    unsigned char type = 1;
+    while (count > 1) {
+        uint64_t parents = 0;
+        uint64_t i;
+        for (i = 0; i < count; i += 2) {
+            if (i + 1 < count) {
+                ddup_hash_ctx ctx;
+                hash->init(&ctx);
+                hash->update(&ctx, &type, 1);
+                hash->update(&ctx, leaves[i].digest, hash->size);
+                hash->update(&ctx, leaves[i + 1].digest, hash->size);
+                hash->final(&ctx, leaves[parents].digest);
+            } else {
+                memcpy(leaves[parents].digest, leaves[i].digest, hash->size);
+            }
+            parents++;
+        }
+        count = parents;
+    }
+}
+
+/* hash the bytes of the given files beyond skip in parallel, the
+ * files are split into DDUP_MERKLE_CHUNK_SIZE chunks that are spread
+ * evenly across ranks, each rank hashes its chunks and sends the
+ * digests to the rank that owns the file, which combines them into
+ * a Merkle root and adds that root to the hash of the file */
+static void ddup_merkle(
+    mfu_flist flist,
+    struct file_item* file_items,
+    const uint64_t* idxs,
+    uint64_t count,
+    uint64_t skip,
+    const ddup_hash* hash,
+    const mfu_proc_t* proc,
+    char* buf)
+{
+    uint64_t i;
+
+    /* build a list of the files, so that the item at index i
+     * in this list is the item at flist index idxs[i] */
+    mfu_flist mlist = mfu_flist_subset(flist);
+    for (i = 0; i < count; i++) {
+        mfu_flist_file_copy(flist, idxs[i], mlist);
+    }
+    mfu_flist_summarize(mlist);
+
+    /* split files into chunks and spread them evenly across ranks */
+    uint64_t chunk_size = DDUP_MERKLE_CHUNK_SIZE;
+    mfu_file_chunk* head = mfu_file_chunk_list_alloc(mlist, chunk_size);
+
+    /* an element of the chunk list may cover several chunks */
+    uint64_t leaf_max = 0;
+    const mfu_file_chunk* p;
+    for (p = head; p != NULL; p = p->next) {
+        leaf_max += (p->length + chunk_size - 1) / chunk_size;
+    }
+    struct ddup_leaf* leaves = (struct ddup_leaf*) MFU_MALLOC((leaf_max + 1) * sizeof(struct ddup_leaf));
+    int* dests = (int*) MFU_MALLOC((leaf_max + 1) * sizeof(int));
+
+    /* hash each of our chunks, skipping bytes already hashed by the
+     * owner, a chunk that lies entirely within the skipped region
+     * contributes the digest of no data */
+    uint64_t leaf_count = 0;
+    for (p = head; p != NULL; p = p->next) {
+        /* open file with O_NOATIME if requested and if possible,
+         * we check the owner here since we may not own the file */
+        int flags = O_RDONLY;
+        if (options.open_noatime) {
+            struct stat st;
+            if (mfu_lstat(p->name, &st) == 0 && ddup_noatime(st.st_uid, proc)) {
+                flags |= O_NOATIME;
+            }
+        }
+        int fd = mfu_open(p->name, flags);
+
+        uint64_t off = p->offset;
+        uint64_t end = p->offset + p->length;
+        while (off < end) {
+            /* compute range of this chunk */
+            struct ddup_leaf* leaf = &leaves[leaf_count];
+            memset(leaf, 0, sizeof(*leaf));
+            leaf->index = p->index_of_owner;
+            leaf->chunk = off / chunk_size;
+            leaf->error = (fd < 0);
+            dests[leaf_count] = (int) p->rank_of_owner;
+            leaf_count++;
+
+            uint64_t chunk_end = (leaf->chunk + 1) * chunk_size;
+            if (chunk_end > end) {
+                chunk_end = end;
+            }
+            uint64_t start = (off > skip) ? off : skip;
+
+            unsigned char type = 0;
+            ddup_hash_ctx ctx;
+            hash->init(&ctx);
+            hash->update(&ctx, &type, 1);
+            if (fd >= 0 && start < chunk_end) {
+                if (hash_data(p->name, fd, hash, &ctx, buf, start, chunk_end - start)) {
+                    leaf->error = 1;
+                }
+            }
+            hash->final(&ctx, leaf->digest);
+
+            off = chunk_end;
+        }
+
+        if (fd >= 0) {
+            mfu_close(p->name, fd);
+        }
+    }
+
+    mfu_file_chunk_list_free(&head);
+
+    /* send leaves to the owner of each file */
+    uint64_t recv_count;
+    struct ddup_leaf* recvbuf = (struct ddup_leaf*) mfu_exchange_items(
+        leaves, dests, leaf_count, sizeof(struct ddup_leaf), &recv_count, MPI_COMM_WORLD);
+
+    /* group leaves by file and order them by chunk, so that
+     * the tree we build does not depend on the number of ranks */
+    qsort(recvbuf, (size_t)recv_count, sizeof(struct ddup_leaf), ddup_leaf_cmp);
+
+    uint64_t start = 0;
+    while (start < recv_count) {
+        /* find range of leaves for this file */
+        uint64_t index = recvbuf[start].index;
+        uint64_t end = start + 1;
+        while (end < recv_count && recvbuf[end].index == index) {
+            end++;
+        }
+
+        uint64_t idx = idxs[index];
+        struct file_item* item = &file_items[idx];
+
+        uint64_t j;
+        for (j = start; j < end; j++) {
+            if (recvbuf[j].error) {
+                item->error = true;
+            }
+        }
+
+        /* add the root of the tree to the hash of the skipped bytes */
+        ddup_merkle_root(hash, &recvbuf[start], end - start);
+        hash->update(&item->ctx, recvbuf[start].digest, hash->size);
+        item->offset = mfu_flist_file_get_size(flist, idx);
+
+        start = end;
+    }
+
+    mfu_free(&recvbuf);
+    mfu_free(&dests);
+    mfu_free(&leaves);
+    mfu_flist_free(&mlist);
+}
+
+/* compute the digest we report for each of the given files, this is
+ * the SHA256 digest of the first DDUP_MERKLE_CHUNK_SIZE bytes of the
+ * file, followed by the Merkle root of the SHA256 digests of chunks
+ * after that, which is the same digest the filter rounds compute */
+static void ddup_confirm(
+    mfu_flist flist,
+    struct file_item* file_items,
+    const uint64_t* idxs,
+    uint64_t count,
+    const mfu_proc_t* proc,
+    char* buf)
+{
+    const ddup_hash* hash = DDUP_SHA256;
+
+    /* list of files that have bytes beyond the first chunk */
+    uint64_t* large = (uint64_t*) MFU_MALLOC((count + 1) * sizeof(uint64_t));
+    uint64_t large_count = 0;
+
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        uint64_t idx = idxs[i];
+        struct file_item* item = &file_items[idx];
+        const char* fname = mfu_flist_file_get_name(flist, idx);
+        uint64_t file_size = mfu_flist_file_get_size(flist, idx);
+
+        /* hash the first chunk of the file */
+        hash->init(&item->ctx);
+        item->error = false;
+
+        uint64_t end = file_size;
+        if (end > DDUP_MERKLE_CHUNK_SIZE) {
+            end = DDUP_MERKLE_CHUNK_SIZE;
+        }
+
+        int flags = O_RDONLY;
+        uid_t owner = (uid_t) mfu_flist_file_get_uid(flist, idx);
+        if (ddup_noatime(owner, proc)) {
+            flags |= O_NOATIME;
+        }
+        int fd = mfu_open(fname, flags);
+        if (fd < 0) {
+            item->error = true;
+        } else {
+            if (hash_data(fname, fd, hash, &item->ctx, buf, 0, end)) {
+                item->error = true;
+            }
+            mfu_close(fname, fd);
+        }
+        item->offset = end;
+
+        if (end < file_size) {
+            large[large_count] = idx;
+            large_count++;
+        }
+    }
+
+    /* hash the rest of large files in parallel */
+    ddup_merkle(flist, file_items, large, large_count,
+                DDUP_MERKLE_CHUNK_SIZE, hash, proc, buf);
+
+    for (i = 0; i < count; i++) {
+        struct file_item* item = &file_items[idxs[i]];
+        hash->final(&item->ctx, item->digest);
+    }
+
+    mfu_free(&large);
+}
+
+/* entry of the digest cache, also used to look up and return digests
+ * of files on the rank that holds the cache entries for them */
+struct ddup_cache_entry {
+    uint64_t key[DDUP_CACHE_KEY]; /* device, inode, size, mtime, ctime */
+    uint64_t rank;                /* rank that looked up the file */
+    uint64_t index;               /* index of file in flist on that rank */
+    uint64_t found;               /* whether the entry matched the query */
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+};
+
+/* get identity of the file to look up its digest in the cache,
+ * fails if the file is no longer the regular file of the given
+ * size that we found in the walk, returns 0 on success */
+static int ddup_cache_ident(const char* fname, uint64_t file_size, uint64_t* key)
+{
+    struct stat st;
+    if (mfu_lstat(fname, &st) != 0 ||
+        ! S_ISREG(st.st_mode) ||
+        (uint64_t) st.st_size != file_size)
+    {
+        return -1;
+    }
+
+    uint64_t secs, nsecs;
+    key[0] = (uint64_t) st.st_dev;
+    key[1] = (uint64_t) st.st_ino;
+    key[2] = (uint64_t) st.st_size;
+    mfu_stat_get_mtimes(&st, &secs, &nsecs);
+    key[3] = secs * 1000000000ULL + nsecs;
+    mfu_stat_get_ctimes(&st, &secs, &nsecs);
+    key[4] = secs * 1000000000ULL + nsecs;
+    return 0;
+}
+
+/* the rank that holds cache entries for the file with the given key */
+static int ddup_cache_home(const uint64_t* key, int ranks)
+{
+    uint32_t hash = mfu_hash_jenkins((const char*)key, 2 * sizeof(uint64_t));
+    return (int)(hash % (uint32_t)ranks);
+}
+
+/* compare cache entries by device and inode */
+static int ddup_cache_cmp(const void* a, const void* b)
+{
+    const struct ddup_cache_entry* x = (const struct ddup_cache_entry*) a;
+    const struct ddup_cache_entry* y = (const struct ddup_cache_entry*) b;
+    int i;
+    for (i = 0; i < 2; i++) {
+        if (x->key[i] != y->key[i]) {
+            return (x->key[i] < y->key[i]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/* read the digest cache file, each rank reads an even share of the
+ * entries and sends each to its home rank, returns the entries held
+ * by this rank sorted by device and inode and sets count */
+static struct ddup_cache_entry* ddup_cache_load(const char* path, uint64_t* count)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    size_t hdr_size = DDUP_CACHE_HDR * sizeof(uint64_t);
+
+    /* rank 0 checks the header to get the number of entries,
+     * a missing cache is not an error, we'll create it */
+    uint64_t total = 0;
+    if (rank == 0) {
+        struct stat st;
+        if (mfu_lstat(path, &st) == 0) {
+            uint64_t magic = 0, version = 0, entries = 0;
+            int fd = mfu_open(path, O_RDONLY);
+            if (fd >= 0) {
+                char hdr[DDUP_CACHE_HDR * sizeof(uint64_t)];
+                if (mfu_pread(path, fd, hdr, hdr_size, 0) == (ssize_t) hdr_size) {
+                    const char* ptr = hdr;
+                    mfu_unpack_uint64(&ptr, &magic);
+                    mfu_unpack_uint64(&ptr, &version);
+                    mfu_unpack_uint64(&ptr, &entries);
+                }
+                mfu_close(path, fd);
+            }
+
+            if (magic == DDUP_CACHE_MAGIC &&
+                version == DDUP_CACHE_VERSION &&
+                (uint64_t) st.st_size == hdr_size + entries * DDUP_CACHE_ENTRY)
+            {
+                total = entries;
+            } else {
+                MFU_LOG(MFU_LOG_WARN, "Ignoring invalid digest cache `%s'", path);
+            }
+        }
+    }
+    MPI_Bcast(&total, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+
+    /* compute range of entries we read */
+    uint64_t per_rank  = total / (uint64_t)ranks;
+    uint64_t remainder = total % (uint64_t)ranks;
+    uint64_t start = per_rank * (uint64_t)rank;
+    uint64_t n = per_rank;
+    if ((uint64_t)rank < remainder) {
+        start += (uint64_t)rank;
+        n++;
+    } else {
+        start += remainder;
+    }
+
+    /* read our entries */
+    size_t bytes = (size_t) (n * DDUP_CACHE_ENTRY);
+    char* buf = (char*) MFU_MALLOC(bytes + 1);
+    if (n > 0) {
+        size_t done = 0;
+        int fd = mfu_open(path, O_RDONLY);
+        if (fd >= 0) {
+            off_t offset = (off_t) (hdr_size + start * DDUP_CACHE_ENTRY);
+            while (done < bytes) {
+                ssize_t nread = mfu_pread(path, fd, buf + done, bytes - done, offset + (off_t)done);
+                if (nread <= 0) {
+                    break;
+                }
+                done += (size_t) nread;
+            }
+            mfu_close(path, fd);
+        }
+
+        /* the cache is only an optimization, so drop entries we can't read */
+        if (done < bytes) {
+            MFU_LOG(MFU_LOG_WARN, "Failed to read digest cache `%s'", path);
+            n = 0;
+        }
+    }
+
+    /* unpack entries and send each to its home rank */
+    struct ddup_cache_entry* entries = (struct ddup_cache_entry*) MFU_MALLOC((n + 1) * sizeof(struct ddup_cache_entry));
+    int* dests = (int*) MFU_MALLOC((n + 1) * sizeof(int));
+    const char* ptr = buf;
+    uint64_t i;
+    for (i = 0; i < n; i++) {
+        struct ddup_cache_entry* e = &entries[i];
+        int k;
+        for (k = 0; k < DDUP_CACHE_KEY; k++) {
+            mfu_unpack_uint64(&ptr, &e->key[k]);
+        }
+        memcpy(e->digest, ptr, SHA256_DIGEST_LENGTH);
+        ptr += SHA256_DIGEST_LENGTH;
+        e->rank  = 0;
+        e->index = 0;
+        e->found = 0;
+        dests[i] = ddup_cache_home(e->key, ranks);
+    }
+
+    struct ddup_cache_entry* table = (struct ddup_cache_entry*) mfu_exchange_items(
+        entries, dests, n, sizeof(struct ddup_cache_entry), count, MPI_COMM_WORLD);
+    qsort(table, (size_t)*count, sizeof(struct ddup_cache_entry), ddup_cache_cmp);
+
+    mfu_free(&dests);
+    mfu_free(&entries);
+    mfu_free(&buf);
+
+    return table;
+}
+
+/* look up the digests of files identified by the given queries, and
+ * mark each file whose digest is found as cached */
+static void ddup_cache_lookup(
+    struct ddup_cache_entry* table,
+    uint64_t table_count,
+    struct ddup_cache_entry* queries,
+    uint64_t query_count,
+    struct file_item* file_items)
+{
+    int ranks;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* send each query to the home rank of its file */
+    int* dests = (int*) MFU_MALLOC((query_count + 1) * sizeof(int));
+    uint64_t i;
+    for (i = 0; i < query_count; i++) {
+        dests[i] = ddup_cache_home(queries[i].key, ranks);
+    }
+    uint64_t recv_count;
+    struct ddup_cache_entry* recv = (struct ddup_cache_entry*) mfu_exchange_items(
+        queries, dests, query_count, sizeof(struct ddup_cache_entry), &recv_count, MPI_COMM_WORLD);
+    mfu_free(&dests);
+
+    /* look up each query and send the answer back */
+    dests = (int*) MFU_MALLOC((recv_count + 1) * sizeof(int));
+    for (i = 0; i < recv_count; i++) {
+        struct ddup_cache_entry* q = &recv[i];
+        q->found = 0;
+        dests[i] = (int) q->rank;
+
+        struct ddup_cache_entry* e = (struct ddup_cache_entry*) bsearch(
+            q, table, (size_t)table_count, sizeof(struct ddup_cache_entry), ddup_cache_cmp);
+        if (e == NULL) {
+            continue;
+        }
+
+        /* there may be several entries for this inode,
+         * e.g., if it has several hard links */
+        while (e > table && ddup_cache_cmp(e - 1, q) == 0) {
+            e--;
+        }
+        for (; e < table + table_count && ddup_cache_cmp(e, q) == 0; e++) {
+            if (memcmp(e->key, q->key, sizeof(q->key)) == 0) {
+                q->found = 1;
+                memcpy(q->digest, e->digest, SHA256_DIGEST_LENGTH);
+            }
+        }
+    }
+
+    uint64_t reply_count;
+    struct ddup_cache_entry* replies = (struct ddup_cache_entry*) mfu_exchange_items(
+        recv, dests, recv_count, sizeof(struct ddup_cache_entry), &reply_count, MPI_COMM_WORLD);
+
+    for (i = 0; i < reply_count; i++) {
+        struct ddup_cache_entry* r = &replies[i];
+        if (r->found) {
+            struct file_item* item = &file_items[r->index];
+            item->cached = true;
+            memcpy(item->digest, r->digest, SHA256_DIGEST_LENGTH);
+        }
+    }
+
+    mfu_free(&replies);
+    mfu_free(&dests);
+    mfu_free(&recv);
+}
+
+/* write the digest cache file with the given entries, replacing
+ * all entries of the old file, returns 0 on success */
+static int ddup_cache_store(
+    const char* path,
+    const struct ddup_cache_entry* entries,
+    uint64_t entry_count)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    size_t hdr_size = DDUP_CACHE_HDR * sizeof(uint64_t);
+
+    /* pack the entries we write */
+    size_t bufsize = (size_t) (entry_count * DDUP_CACHE_ENTRY);
+    char* buf = (char*) MFU_MALLOC(bufsize + 1);
+    char* ptr = buf;
+    uint64_t count = 0;
+    uint64_t i;
+    for (i = 0; i < entry_count; i++) {
+        const struct ddup_cache_entry* e = &entries[i];
+        int k;
+        for (k = 0; k < DDUP_CACHE_KEY; k++) {
+            mfu_pack_uint64(&ptr, e->key[k]);
+        }
+        memcpy(ptr, e->digest, SHA256_DIGEST_LENGTH);
+        ptr += SHA256_DIGEST_LENGTH;
+        count++;
+    }
+    size_t bytes = (size_t)(ptr - buf);
+
+    /* compute total entries and our offset into the file */
+    uint64_t total, offset;
+    MPI_Allreduce(&count, &total, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Exscan(&count, &offset, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        offset = 0;
+    }
+
+    /* write to a temporary file and rename it when complete,
+     * so that an interrupted run leaves the old cache intact */
+    size_t tmp_len = strlen(path) + 5;
+    char* tmp = (char*) MFU_MALLOC(tmp_len);
+    snprintf(tmp, tmp_len, "%s.tmp", path);
+
+    /* rank 0 creates the file and writes the header */
+    int rc = 0;
+    if (rank == 0) {
+        int fd = mfu_open(tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            rc = -1;
+        } else {
+            char hdr[DDUP_CACHE_HDR * sizeof(uint64_t)];
+            char* hptr = hdr;
+            mfu_pack_uint64(&hptr, DDUP_CACHE_MAGIC);
+            mfu_pack_uint64(&hptr, DDUP_CACHE_VERSION);
+            mfu_pack_uint64(&hptr, total);
+            if (mfu_pwrite(tmp, fd, hdr, hdr_size, 0) != (ssize_t) hdr_size) {
+                rc = -1;
+            }
+            mfu_close(tmp, fd);
+        }
+    }
+    MPI_Bcast(&rc, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    /* each rank writes its entries */
+    if (rc == 0 && bytes > 0) {
+        int fd = mfu_open(tmp, O_WRONLY);
+        if (fd < 0) {
+            rc = -1;
+        } else {
+            off_t pos = (off_t) (hdr_size + offset * DDUP_CACHE_ENTRY);
+            size_t done = 0;
+            while (done < bytes) {
+                ssize_t nwrite = mfu_pwrite(tmp, fd, buf + done, bytes - done, pos + (off_t)done);
+                if (nwrite <= 0) {
+                    rc = -1;
+                    break;
+                }
+                done += (size_t) nwrite;
+            }
+            mfu_close(tmp, fd);
+        }
+    }
+
+    int all_rc;
+    MPI_Allreduce(&rc, &all_rc, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        if (all_rc == 0) {
+            if (mfu_rename(tmp, path) != 0) {
+                all_rc = -1;
+            }
+        } else {
+            mfu_unlink(tmp);
+        }
+        if (all_rc != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to write digest cache `%s'", path);
+        }
+    }
+    MPI_Bcast(&all_rc, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    mfu_free(&tmp);
+    mfu_free(&buf);
+
+    return all_rc;
+}
+
+/* given a value for each of count files, compute the sum of the
+ * values across all files that have the same size */
+static void ddup_sum_by_size(
+    uint64_t count,
+    const uint64_t* sizes,
+    const uint64_t* vals,
+    uint64_t* sums)
+{
+    uint64_t* ltr = (uint64_t*) MFU_MALLOC((count + 1) * sizeof(uint64_t));
+    uint64_t* rtl = (uint64_t*) MFU_MALLOC((count + 1) * sizeof(uint64_t));
+
+    DTCMP_Segmented_exscanv(
+        (int)count, sizes, MPI_UINT64_T, DTCMP_OP_UINT64T_ASCEND,
+        vals, ltr, rtl, MPI_UINT64_T, MPI_SUM,
+        DTCMP_FLAG_NONE, MPI_COMM_WORLD
+    );
+
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        sums[i] = vals[i] + ltr[i] + rtl[i];
+    }
+
+    mfu_free(&rtl);
+    mfu_free(&ltr);
+}
+
+/* append the file at flist index idx with its final digest to
+ * the list to be grouped by digest */
+static void ddup_done_append(
+    uint64_t** pptr,
+    uint64_t file_size,
+    const struct file_item* item,
+    uint64_t idx)
+{
+    uint64_t* ptr = *pptr;
+    ptr[0] = file_size;
+    memcpy(ptr + 1, item->digest, SHA256_DIGEST_LENGTH);
+    ptr[DDUP_KEY_SIZE] = idx;
+    *pptr = ptr + DDUP_KEY_SIZE + 1;
+}
+
+/* copy all extended attributes of the file src to the file dst,
+ * returns 0 on success */
+static int ddup_copy_xattrs(const char* src, const char* dst)
+{
+    ssize_t list_size = mfu_llistxattr(src, NULL, 0);
+    if (list_size < 0) {
+        /* nothing to copy if the file system has no xattrs */
+        return (errno == ENOTSUP) ? 0 : -1;
+    }
+    if (list_size == 0) {
+        return 0;
+    }
+
+    int rc = 0;
+    char* list = (char*) MFU_MALLOC((size_t)list_size);
+    list_size = mfu_llistxattr(src, list, (size_t)list_size);
+    if (list_size < 0) {
+        rc = -1;
+    }
+
+    char* name = list;
+    while (rc == 0 && name < list + list_size) {
+        ssize_t val_size = mfu_lgetxattr(src, name, NULL, 0);
+        if (val_size < 0) {
+            rc = -1;
+            break;
+        }
+        char* val = (char*) MFU_MALLOC((size_t)val_size + 1);
+        val_size = mfu_lgetxattr(src, name, val, (size_t)val_size);
+        if (val_size < 0 || mfu_lsetxattr(dst, name, val, (size_t)val_size, 0) != 0) {
+            rc = -1;
+        }
+        mfu_free(&val);
+        name += strlen(name) + 1;
+    }
+
+    mfu_free(&list);
+    return rc;
+}
+
+/* return 1 if the files a and b have the same extended attributes,
+ * 0 if they differ, and -1 on error */
+static int ddup_xattrs_match(const char* a, const char* b)
+{
+    ssize_t list_size = mfu_llistxattr(a, NULL, 0);
+    ssize_t b_size    = mfu_llistxattr(b, NULL, 0);
+    if (list_size < 0 || b_size < 0) {
+        /* neither file has xattrs if the file system has none */
+        return (errno == ENOTSUP) ? 1 : -1;
+    }
+    if (list_size != b_size) {
+        return 0;
+    }
+    if (list_size == 0) {
+        return 1;
+    }
+
+    /* names are unique and the lists have the same size,
+     * so the sets match if every name of a has the same value in b */
+    int rc = 1;
+    char* list = (char*) MFU_MALLOC((size_t)list_size);
+    list_size = mfu_llistxattr(a, list, (size_t)list_size);
+    if (list_size < 0) {
+        rc = -1;
+    }
+
+    char* name = list;
+    while (rc == 1 && name < list + list_size) {
+        ssize_t a_val_size = mfu_lgetxattr(a, name, NULL, 0);
+        ssize_t b_val_size = mfu_lgetxattr(b, name, NULL, 0);
+        if (a_val_size < 0) {
+            rc = -1;
+            break;
+        }
+        if (b_val_size != a_val_size) {
+            rc = (b_val_size < 0 && errno != ENOATTR) ? -1 : 0;
+            break;
+        }
+        char* a_val = (char*) MFU_MALLOC((size_t)a_val_size + 1);
+        char* b_val = (char*) MFU_MALLOC((size_t)a_val_size + 1);
+        if (mfu_lgetxattr(a, name, a_val, (size_t)a_val_size) != a_val_size ||
+            mfu_lgetxattr(b, name, b_val, (size_t)a_val_size) != a_val_size)
+        {
+            rc = -1;
+        } else if (memcmp(a_val, b_val, (size_t)a_val_size) != 0) {
+            rc = 0;
+        }
+        mfu_free(&b_val);
+        mfu_free(&a_val);
+        name += strlen(name) + 1;
+    }
+
+    mfu_free(&list);
+    return rc;
+}
+
+/* return the number of bytes of the file that are not shared with
+ * another file, which is what we free by sharing its data, falls back
+ * to the allocated size if the file system does not support FIEMAP */
+static uint64_t ddup_unshared_bytes(const char* path, uint64_t file_size)
+{
+    struct stat st;
+    if (mfu_lstat(path, &st) != 0) {
+        return 0;
+    }
+    uint64_t bytes = (uint64_t) st.st_blocks * 512;
+    if (bytes > file_size) {
+        bytes = file_size;
+    }
+
+    int fd = mfu_open(path, O_RDONLY);
+    if (fd < 0) {
+        return bytes;
+    }
+
+    /* first ask for the number of extents, then get them */
+    struct fiemap* fiemap = (struct fiemap*) MFU_MALLOC(sizeof(struct fiemap));
+    memset(fiemap, 0, sizeof(struct fiemap));
+    fiemap->fm_start  = 0;
+    fiemap->fm_length = FIEMAP_MAX_OFFSET;
+    fiemap->fm_flags  = FIEMAP_FLAG_SYNC;
+    if (ioctl(fd, FS_IOC_FIEMAP, fiemap) == 0) {
+        uint32_t count = fiemap->fm_mapped_extents;
+        size_t fiemap_size = sizeof(struct fiemap) + count * sizeof(struct fiemap_extent);
+        mfu_free(&fiemap);
+        fiemap = (struct fiemap*) MFU_MALLOC(fiemap_size);
+        memset(fiemap, 0, fiemap_size);
+        fiemap->fm_start        = 0;
+        fiemap->fm_length       = FIEMAP_MAX_OFFSET;
+        fiemap->fm_flags        = FIEMAP_FLAG_SYNC;
+        fiemap->fm_extent_count = count;
+        if (ioctl(fd, FS_IOC_FIEMAP, fiemap) == 0) {
+            bytes = 0;
+            uint32_t i;
+            for (i = 0; i < fiemap->fm_mapped_extents; i++) {
+                const struct fiemap_extent* ext = &fiemap->fm_extents[i];
+                if (ext->fe_flags & FIEMAP_EXTENT_SHARED) {
+                    continue;
+                }
+                if (ext->fe_logical >= file_size) {
+                    continue;
+                }
+                uint64_t len = ext->fe_length;
+                if (len > file_size - ext->fe_logical) {
+                    len = file_size - ext->fe_logical;
+                }
+                bytes += len;
+            }
+        }
+    }
+
+    mfu_free(&fiemap);
+    mfu_close(path, fd);
+    return bytes;
+}
+
+/* share the extents of the file keep with the duplicate file dup,
+ * the kernel compares the data of both files and only shares ranges
+ * that are identical, returns 0 on success, 1 if the data differs,
+ * and -1 on error */
+static int ddup_dedupe(const char* dup, const char* keep, uint64_t file_size)
+{
+#ifdef FIDEDUPERANGE
+    int src_fd = mfu_open(keep, O_RDONLY);
+    if (src_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+            keep, errno, strerror(errno));
+        return -1;
+    }
+
+    /* since Linux 4.19 the destination only needs to be open for
+     * reading if we own it */
+    int dst_fd = mfu_open(dup, O_RDONLY);
+    if (dst_fd < 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+            dup, errno, strerror(errno));
+        mfu_close(keep, src_fd);
+        return -1;
+    }
+
+    size_t range_size = sizeof(struct file_dedupe_range) + sizeof(struct file_dedupe_range_info);
+    struct file_dedupe_range* range = (struct file_dedupe_range*) MFU_MALLOC(range_size);
+
+    int rc = 0;
+    uint64_t offset = 0;
+    while (offset < file_size) {
+        uint64_t length = file_size - offset;
+        if (length > DDUP_DEDUPE_SIZE) {
+            length = DDUP_DEDUPE_SIZE;
+        }
+
+        memset(range, 0, range_size);
+        range->src_offset = offset;
+        range->src_length = length;
+        range->dest_count = 1;
+        range->info[0].dest_fd     = dst_fd;
+        range->info[0].dest_offset = offset;
+
+        if (ioctl(src_fd, FIDEDUPERANGE, range) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to dedupe `%s' with `%s' (errno=%d %s)",
+                dup, keep, errno, strerror(errno));
+            rc = -1;
+            break;
+        }
+
+        struct file_dedupe_range_info* info = &range->info[0];
+        if (info->status == FILE_DEDUPE_RANGE_DIFFERS) {
+            MFU_LOG(MFU_LOG_WARN, "Skipping `%s', data differs from `%s'", dup, keep);
+            rc = 1;
+            break;
+        }
+        if (info->status < 0 || info->bytes_deduped == 0) {
+            int err = (info->status < 0) ? -info->status : EIO;
+            MFU_LOG(MFU_LOG_ERR, "Failed to dedupe `%s' with `%s' (errno=%d %s)",
+                dup, keep, err, strerror(err));
+            rc = -1;
+            break;
+        }
+
+        offset += info->bytes_deduped;
+    }
+
+    mfu_free(&range);
+    mfu_close(dup, dst_fd);
+    mfu_close(keep, src_fd);
+    return rc;
+#else
+    MFU_LOG(MFU_LOG_ERR, "FIDEDUPERANGE is not supported, cannot dedupe `%s'", dup);
+    return -1;
+#endif
+}
+
+/* create a temporary file next to the duplicate file dup that refers
+ * to the data of the file keep, either as a FICLONE copy that gets
+ * the metadata of dup, or as a hard link to keep, and then rename it
+ * over dup, so that dup is replaced atomically, returns 0 on success,
+ * 1 if the file was skipped, and -1 on error */
+static int ddup_replace(
+    ddup_reclaim_mode mode,
+    const char* dup,
+    const uint64_t* dup_ident,
+    const char* keep,
+    uint64_t file_size)
+{
+    struct stat st;
+    if (mfu_lstat(dup, &st) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to stat `%s' (errno=%d %s)",
+            dup, errno, strerror(errno));
+        return -1;
+    }
+
+    /* a hard link shares the metadata of the file we keep, so we
+     * only link files whose ownership, mode, modification time,
+     * and extended attributes match, so no name loses its own */
+    if (mode == DDUP_RECLAIM_HARDLINK) {
+        struct stat keep_st;
+        if (mfu_lstat(keep, &keep_st) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to stat `%s' (errno=%d %s)",
+                keep, errno, strerror(errno));
+            return -1;
+        }
+        if (st.st_mode != keep_st.st_mode ||
+            st.st_uid  != keep_st.st_uid  ||
+            st.st_gid  != keep_st.st_gid)
+        {
+            MFU_LOG(MFU_LOG_DBG, "Skipping `%s', mode or owner differs from `%s'", dup, keep);
+            return 1;
+        }
+        if (st.st_mtim.tv_sec  != keep_st.st_mtim.tv_sec ||
+            st.st_mtim.tv_nsec != keep_st.st_mtim.tv_nsec)
+        {
+            MFU_LOG(MFU_LOG_DBG, "Skipping `%s', modification time differs from `%s'", dup, keep);
+            return 1;
+        }
+        int match = ddup_xattrs_match(dup, keep);
+        if (match < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to compare xattrs of `%s' and `%s' (errno=%d %s)",
+                dup, keep, errno, strerror(errno));
+            return -1;
+        }
+        if (match == 0) {
+            MFU_LOG(MFU_LOG_DBG, "Skipping `%s', xattrs differ from `%s'", dup, keep);
+            return 1;
+        }
+    }
+
+    size_t tmp_len = strlen(dup) + 10;
+    char* tmp = (char*) MFU_MALLOC(tmp_len);
+    snprintf(tmp, tmp_len, "%s.ddup-tmp", dup);
+
+    int rc = 0;
+    if (mode == DDUP_RECLAIM_HARDLINK) {
+        if (mfu_hardlink(keep, tmp) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to link `%s' to `%s' (errno=%d %s)",
+                tmp, keep, errno, strerror(errno));
+            mfu_free(&tmp);
+            return -1;
+        }
+    } else {
+#ifdef FICLONE
+        int src_fd = mfu_open(keep, O_RDONLY);
+        if (src_fd < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+                keep, errno, strerror(errno));
+            mfu_free(&tmp);
+            return -1;
+        }
+        int dst_fd = mfu_open(tmp, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        if (dst_fd < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to create `%s' (errno=%d %s)",
+                tmp, errno, strerror(errno));
+            mfu_close(keep, src_fd);
+            mfu_free(&tmp);
+            return -1;
+        }
+        if (ioctl(dst_fd, FICLONE, src_fd) != 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to clone `%s' to `%s' (errno=%d %s)",
+                keep, tmp, errno, strerror(errno));
+            rc = -1;
+        }
+        mfu_close(tmp, dst_fd);
+        mfu_close(keep, src_fd);
+
+        /* give the clone the metadata of the duplicate, set owner
+         * before mode since chown may clear setuid bits, and set
+         * times last since the other calls change them */
+        struct timespec times[2];
+        times[0] = st.st_atim;
+        times[1] = st.st_mtim;
+        if (rc == 0 &&
+            (mfu_lchown(tmp, st.st_uid, st.st_gid) != 0 ||
+             mfu_chmod(tmp, st.st_mode & 07777) != 0 ||
+             ddup_copy_xattrs(dup, tmp) != 0 ||
+             mfu_utimensat(AT_FDCWD, tmp, times, AT_SYMLINK_NOFOLLOW) != 0))
+        {
+            MFU_LOG(MFU_LOG_ERR, "Failed to copy metadata of `%s' to `%s' (errno=%d %s)",
+                dup, tmp, errno, strerror(errno));
+            rc = -1;
+        }
+#else
+        MFU_LOG(MFU_LOG_ERR, "FICLONE is not supported, cannot clone `%s'", keep);
+        mfu_free(&tmp);
+        return -1;
+#endif
+    }
+
+    /* check once more that the duplicate has not changed,
+     * and then replace it */
+    uint64_t ident[DDUP_CACHE_KEY];
+    if (rc == 0 &&
+        (ddup_cache_ident(dup, file_size, ident) != 0 ||
+         memcmp(ident, dup_ident, sizeof(ident)) != 0))
+    {
+        MFU_LOG(MFU_LOG_WARN, "Skipping `%s', it changed since it was hashed", dup);
+        rc = 1;
+    }
+    if (rc == 0 && mfu_rename(tmp, dup) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to rename `%s' to `%s' (errno=%d %s)",
+            tmp, dup, errno, strerror(errno));
+        rc = -1;
+    }
+    if (rc != 0) {
+        mfu_unlink(tmp);
+    }
+
+    mfu_free(&tmp);
+    return rc;
+}
+
+/* an inode whose data we shared, sent to the rank that totals the
+ * bytes freed for that inode, so that an inode with several names
+ * is only counted once */
+struct ddup_freed {
+    uint64_t dev;   /* device of duplicate */
+    uint64_t ino;   /* inode of duplicate */
+    uint64_t nlink; /* number of links of duplicate before it was replaced */
+    uint64_t bytes; /* bytes of duplicate that were not shared */
+};
+
+/* order by device and inode */
+static int ddup_freed_cmp(const void* a, const void* b)
+{
+    const struct ddup_freed* x = (const struct ddup_freed*) a;
+    const struct ddup_freed* y = (const struct ddup_freed*) b;
+    if (x->dev != y->dev) {
+        return (x->dev < y->dev) ? -1 : 1;
+    }
+    if (x->ino != y->ino) {
+        return (x->ino < y->ino) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* reclaim the space of the duplicate file dup, whose contents match
+ * the file keep, after checking that neither file has changed since
+ * it was hashed, returns 0 on success, 1 if the file was skipped,
+ * and -1 on error, records the inode of dup and its unshared bytes
+ * in freed */
+static int ddup_reclaim_file(
+    ddup_reclaim_mode mode,
+    const char* dup,
+    const uint64_t* dup_ident,
+    const char* keep,
+    const uint64_t* keep_ident,
+    struct ddup_freed* freed)
+{
+    uint64_t file_size = dup_ident[2];
+
+    /* nothing to do if both names refer to the same inode */
+    if (dup_ident[0] == keep_ident[0] && dup_ident[1] == keep_ident[1]) {
+        return 1;
+    }
+
+    /* data can only be shared within a file system */
+    if (dup_ident[0] != keep_ident[0]) {
+        MFU_LOG(MFU_LOG_DBG, "Skipping `%s', on a different file system than `%s'", dup, keep);
+        return 1;
+    }
+
+    /* skip files that changed since we hashed them, other ranks
+     * may link or clone the file we keep while we run, which changes
+     * its ctime, so we only check its mtime */
+    uint64_t ident[DDUP_CACHE_KEY];
+    if (ddup_cache_ident(dup, file_size, ident) != 0 ||
+        memcmp(ident, dup_ident, sizeof(ident)) != 0 ||
+        ddup_cache_ident(keep, file_size, ident) != 0 ||
+        memcmp(ident, keep_ident, (DDUP_CACHE_KEY - 1) * sizeof(uint64_t)) != 0)
+    {
+        MFU_LOG(MFU_LOG_WARN, "Skipping `%s', it or `%s' changed since it was hashed", dup, keep);
+        return 1;
+    }
+
+    /* note the links and unshared bytes of the duplicate before we
+     * share its data, extents already shared free nothing */
+    struct stat st;
+    if (mfu_lstat(dup, &st) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to stat `%s' (errno=%d %s)",
+            dup, errno, strerror(errno));
+        return -1;
+    }
+    freed->dev   = dup_ident[0];
+    freed->ino   = dup_ident[1];
+    freed->nlink = (uint64_t) st.st_nlink;
+    freed->bytes = ddup_unshared_bytes(dup, file_size);
+
+    if (mode == DDUP_RECLAIM_DEDUPE) {
+        return ddup_dedupe(dup, keep, file_size);
+    }
+    return ddup_replace(mode, dup, dup_ident, keep, file_size);
+}
+
+/* a duplicate file sent to the rank that collects the name of the
+ * file we keep in its group, and then sent back to the owner of the
+ * duplicate with the name and identity of the file we keep, the name
+ * follows this structure in the message */
+struct ddup_keeper {
+    uint64_t group; /* id of duplicate group */
+    uint64_t keep;  /* whether this is the file we keep */
+    uint64_t rank;  /* rank that owns the duplicate */
+    uint64_t index; /* flist index of duplicate on its owner */
+    uint64_t valid; /* whether ident is valid */
+    uint64_t ident[DDUP_CACHE_KEY]; /* identity of file we keep */
+};
+
+/* order by group, with the file we keep first */
+static int ddup_keeper_cmp(const void* a, const void* b)
+{
+    const struct ddup_keeper* x = (const struct ddup_keeper*) a;
+    const struct ddup_keeper* y = (const struct ddup_keeper*) b;
+    if (x->group != y->group) {
+        return (x->group < y->group) ? -1 : 1;
+    }
+    if (x->keep != y->keep) {
+        return (x->keep > y->keep) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* reclaim the space used by duplicate files in parallel, the first
+ * file in each group of duplicates is kept and every other file in
+ * the group is replaced by a file that shares its data */
+static void ddup_reclaim(
+    mfu_flist flist,
+    struct file_item* file_items,
+    const uint64_t* done_list,
+    uint64_t done_files,
+    const uint64_t* group_id,
+    const uint64_t* group_ranks,
+    const uint64_t* group_rank)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    /* get the longest name of a file we keep */
+    uint64_t i;
+    uint64_t max_name = 0;
+    const uint64_t* ptr = done_list;
+    for (i = 0; i < done_files; i++) {
+        uint64_t idx = ptr[DDUP_KEY_SIZE];
+        if (group_ranks[i] > 1 && group_rank[i] == 0) {
+            const char* fname = mfu_flist_file_get_name(flist, idx);
+            uint64_t len = (uint64_t) strlen(fname) + 1;
+            if (len > max_name) {
+                max_name = len;
+            }
+        }
+        ptr += DDUP_KEY_SIZE + 1;
+    }
+    uint64_t all_max_name;
+    MPI_Allreduce(&max_name, &all_max_name, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    /* each message holds a header and a name, padded to 8 bytes */
+    size_t item_size = sizeof(struct ddup_keeper) + (size_t)((all_max_name + 7) / 8 * 8);
+
+    /* send every file in a group of duplicates to the rank
+     * that collects the name of the file we keep in the group */
+    char* items = (char*) MFU_MALLOC((done_files + 1) * item_size);
+    int* dests = (int*) MFU_MALLOC((done_files + 1) * sizeof(int));
+    uint64_t count = 0;
+    ptr = done_list;
+    for (i = 0; i < done_files; i++) {
+        uint64_t idx = ptr[DDUP_KEY_SIZE];
+        if (group_ranks[i] > 1) {
+            char* item = items + count * item_size;
+            memset(item, 0, item_size);
+            struct ddup_keeper* k = (struct ddup_keeper*) item;
+            k->group = group_id[i];
+            k->keep  = (group_rank[i] == 0);
+            k->rank  = (uint64_t) rank;
+            k->index = idx;
+            if (k->keep) {
+                struct file_item* f = &file_items[idx];
+                k->valid = f->ident_valid;
+                memcpy(k->ident, f->ident, sizeof(k->ident));
+                strcpy(item + sizeof(struct ddup_keeper), mfu_flist_file_get_name(flist, idx));
+            }
+            dests[count] = (int)(group_id[i] % (uint64_t)ranks);
+            count++;
+        }
+        ptr += DDUP_KEY_SIZE + 1;
+    }
+
+    uint64_t recv_count;
+    char* recv = (char*) mfu_exchange_items(items, dests, count, item_size, &recv_count, MPI_COMM_WORLD);
+    mfu_free(&dests);
+    mfu_free(&items);
+
+    /* find the file we keep in each group, and send its name
+     * and identity to the owners of the other files */
+    qsort(recv, (size_t)recv_count, item_size, ddup_keeper_cmp);
+
+    char* replies = (char*) MFU_MALLOC((recv_count + 1) * item_size);
+    dests = (int*) MFU_MALLOC((recv_count + 1) * sizeof(int));
+    const char* keeper = NULL;
+    uint64_t reply_count = 0;
+    for (i = 0; i < recv_count; i++) {
+        const char* item = recv + i * item_size;
+        const struct ddup_keeper* k = (const struct ddup_keeper*) item;
+        if (k->keep) {
+            keeper = item;
+            continue;
+        }
+
+        /* fill in the file we keep in this group */
+        const struct ddup_keeper* kk = (const struct ddup_keeper*) keeper;
+        if (keeper == NULL || kk->group != k->group) {
+            continue;
+        }
+        char* reply = replies + reply_count * item_size;
+        memcpy(reply, item, sizeof(struct ddup_keeper));
+        struct ddup_keeper* r = (struct ddup_keeper*) reply;
+        r->valid = kk->valid;
+        memcpy(r->ident, kk->ident, sizeof(r->ident));
+        memcpy(reply + sizeof(struct ddup_keeper), keeper + sizeof(struct ddup_keeper),
+               item_size - sizeof(struct ddup_keeper));
+        dests[reply_count] = (int) r->rank;
+        reply_count++;
+    }
+    mfu_free(&recv);
+
+    uint64_t dup_count;
+    char* dups = (char*) mfu_exchange_items(replies, dests, reply_count, item_size, &dup_count, MPI_COMM_WORLD);
+    mfu_free(&dests);
+    mfu_free(&replies);
+
+    /* reclaim the space of each of our duplicates */
+    uint64_t counts[4] = {0, 0, 0, 0}; /* reclaimed, bytes, skipped, failed */
+    struct ddup_freed* freed = (struct ddup_freed*) MFU_MALLOC((dup_count + 1) * sizeof(struct ddup_freed));
+    dests = (int*) MFU_MALLOC((dup_count + 1) * sizeof(int));
+    uint64_t freed_count = 0;
+    for (i = 0; i < dup_count; i++) {
+        const char* item = dups + i * item_size;
+        const struct ddup_keeper* k = (const struct ddup_keeper*) item;
+        const char* keep = item + sizeof(struct ddup_keeper);
+        struct file_item* f = &file_items[k->index];
+        const char* dup = mfu_flist_file_get_name(flist, k->index);
+
+        int rc = 1;
+        if (f->ident_valid && k->valid) {
+            rc = ddup_reclaim_file(options.reclaim, dup, f->ident, keep, k->ident, &freed[freed_count]);
+        }
+        if (rc == 0) {
+            dests[freed_count] = ddup_cache_home(f->ident, ranks);
+            freed_count++;
+            counts[0]++;
+        } else if (rc > 0) {
+            counts[2]++;
+        } else {
+            counts[3]++;
+        }
+    }
+    mfu_free(&dups);
+
+    /* total the bytes freed for each inode once, replacing a name
+     * of an inode with other links only frees its data once we
+     * replaced all of them, while dedupe shares the data of the
+     * inode under all of its names at once */
+    uint64_t recv_freed;
+    struct ddup_freed* inodes = (struct ddup_freed*) mfu_exchange_items(freed, dests, freed_count,
+        sizeof(struct ddup_freed), &recv_freed, MPI_COMM_WORLD);
+    mfu_free(&dests);
+    mfu_free(&freed);
+
+    qsort(inodes, (size_t)recv_freed, sizeof(struct ddup_freed), ddup_freed_cmp);
+    i = 0;
+    while (i < recv_freed) {
+        uint64_t names = 0;
+        uint64_t nlink = 0;
+        uint64_t bytes = 0;
+        uint64_t j = i;
+        while (j < recv_freed && ddup_freed_cmp(&inodes[i], &inodes[j]) == 0) {
+            /* the first name we replaced saw all links, and the
+             * first name we deduped saw all unshared extents */
+            names++;
+            if (inodes[j].nlink > nlink) {
+                nlink = inodes[j].nlink;
+            }
+            if (inodes[j].bytes > bytes) {
+                bytes = inodes[j].bytes;
+            }
+            j++;
+        }
+        if (options.reclaim == DDUP_RECLAIM_DEDUPE || names >= nlink) {
+            counts[1] += bytes;
+        }
+        i = j;
+    }
+    mfu_free(&inodes);
+
+    /* report a summary */
+    uint64_t all_counts[4];
+    MPI_Allreduce(counts, all_counts, 4, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        double bytes_val;
+        const char* bytes_units;
+        mfu_format_bytes(all_counts[1], &bytes_val, &bytes_units);
+        MFU_LOG(MFU_LOG_INFO, "Reclaimed %.3lf %s from %" PRIu64 " files, "
+            "skipped %" PRIu64 " files, failed on %" PRIu64 " files",
+            bytes_val, bytes_units, all_counts[0], all_counts[2], all_counts[3]);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Block-level duplicate analysis with content-defined chunking
+ * ------------------------------------------------------------------- */
+
+/* table of random values used to compute the gear hash */
+static uint64_t ddup_gear[256];
+
+/* fill the gear table with pseudo random values from a fixed seed,
+ * so that chunk boundaries are the same on every rank and every run */
+static void ddup_gear_init(void)
 {
-    assert(SHA256_DIGEST_LENGTH == (DDUP_KEY_SIZE - 1) * 8);
+    uint64_t x = 0x6464757067656172ULL;
+    int i;
+    for (i = 0; i < 256; i++) {
+        /* splitmix64 */
+        x += 0x9e3779b97f4a7c15ULL;
+        uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        ddup_gear[i] = z ^ (z >> 31);
+    }
+}
 
-    /*
-     * Build MPI datatype for key.
-     * 1 for group ID + (SHA256_DIGEST_LENGTH / 8)
-     */
-    MPI_Type_contiguous(DDUP_KEY_SIZE, MPI_UINT64_T, key);
-    MPI_Type_commit(key);
+/* parameters of the chunker */
+struct ddup_cdc {
+    uint64_t min;    /* min chunk size in bytes */
+    uint64_t avg;    /* target average chunk size in bytes */
+    uint64_t max;    /* max chunk size in bytes */
+    uint64_t mask_s; /* mask used before a chunk reaches avg bytes */
+    uint64_t mask_l; /* mask used after a chunk reaches avg bytes */
+};
 
-    /*
-     * Build MPI datatype for key + satellite
-     * length of key + 1 for index in flist
-     */
-    MPI_Type_contiguous(DDUP_KEY_SIZE + 1, MPI_UINT64_T, keysat);
-    MPI_Type_commit(keysat);
+/* return a mask with the given number of the most significant bits set,
+ * the top bits of the gear hash depend on the last 64 bytes */
+static uint64_t ddup_cdc_mask(int bits)
+{
+    if (bits <= 0) {
+        return 0;
+    }
+    return ~0ULL << (64 - bits);
 }
 
-/* free off the MPI types */
-static void mpi_type_fini(MPI_Datatype* key, MPI_Datatype* keysat)
+/* compute chunker parameters for a given average chunk size,
+ * which is rounded down to a power of two, we use normalized
+ * chunking with a harder mask before the average size and an
+ * easier one after it to narrow the distribution of sizes */
+static void ddup_cdc_init(struct ddup_cdc* cdc, uint64_t avg)
 {
-    MPI_Type_free(keysat);
-    MPI_Type_free(key);
+    int bits = 0;
+    while ((2ULL << bits) <= avg) {
+        bits++;
+    }
+    cdc->avg    = 1ULL << bits;
+    cdc->min    = cdc->avg / 4;
+    cdc->max    = cdc->avg * 8;
+    cdc->mask_s = ddup_cdc_mask(bits + 2);
+    cdc->mask_l = ddup_cdc_mask(bits - 2);
 }
 
-/* create a comparison operation for our key */
-static int mtcmp_cmp_init(DTCMP_Op* cmp)
+/* a chunk found in a file */
+struct ddup_cdc_chunk {
+    unsigned char digest[MFU_DIGEST_SIZE]; /* digest of chunk data */
+    uint64_t dir;                          /* id of directory holding file */
+    uint64_t size;                         /* chunk size in bytes */
+};
+
+/* order chunks by digest and then by directory */
+static int ddup_cdc_chunk_cmp(const void* a, const void* b)
 {
-    int i;
-    DTCMP_Op series[DDUP_KEY_SIZE];
-    for (i = 0; i < DDUP_KEY_SIZE; i++) {
-        series[i] = DTCMP_OP_UINT64T_ASCEND;
+    const struct ddup_cdc_chunk* x = (const struct ddup_cdc_chunk*) a;
+    const struct ddup_cdc_chunk* y = (const struct ddup_cdc_chunk*) b;
+    int rc = memcmp(x->digest, y->digest, MFU_DIGEST_SIZE);
+    if (rc != 0) {
+        return rc;
     }
-    return DTCMP_Op_create_series(DDUP_KEY_SIZE, series, cmp);
+    if (x->dir != y->dir) {
+        return (x->dir < y->dir) ? -1 : 1;
+    }
+    return 0;
 }
 
-/* free the comparison operation */
-static void mtcmp_cmp_fini(DTCMP_Op* cmp)
+/* a list of chunks that grows as needed */
+struct ddup_cdc_list {
+    struct ddup_cdc_chunk* chunks; /* array of chunks */
+    int* dests;                    /* rank to send each chunk to */
+    uint64_t count;                /* number of chunks in array */
+    uint64_t max;                  /* number of chunks allocated */
+};
+
+/* add a chunk to the list, each chunk is sent to a rank
+ * chosen from its digest to find duplicates */
+static void ddup_cdc_append(
+    struct ddup_cdc_list* list,
+    mfu_digest_ctx* ctx,
+    uint64_t dir,
+    uint64_t size,
+    int ranks)
 {
-    DTCMP_Op_free(cmp);
+    if (list->count == list->max) {
+        list->max = (list->max > 0) ? list->max * 2 : 1024;
+        list->chunks = (struct ddup_cdc_chunk*) realloc(list->chunks, list->max * sizeof(struct ddup_cdc_chunk));
+        list->dests  = (int*) realloc(list->dests, list->max * sizeof(int));
+        if (list->chunks == NULL || list->dests == NULL) {
+            MFU_ABORT(-1, "Failed to allocate memory for %llu chunks",
+                (unsigned long long) list->max);
+        }
+    }
+
+    struct ddup_cdc_chunk* c = &list->chunks[list->count];
+    mfu_digest_final(ctx, c->digest);
+    c->dir  = dir;
+    c->size = size;
+
+    uint64_t h;
+    memcpy(&h, c->digest, sizeof(h));
+    list->dests[list->count] = (int)(h % (uint64_t)ranks);
+    list->count++;
 }
 
-/* open the specified file, read specified chunk, and close file,
- * returns -1 on any read error */
-static int read_data(
+/* split length bytes starting at offset in a file into chunks,
+ * chunk boundaries are found with a gear hash over the file data,
+ * skipping the first min bytes of each chunk as in FastCDC,
+ * returns 0 on success */
+static int ddup_cdc_segment(
     const char* fname,
-    bool noatime,
-    char* chunk_buf,
-    uint64_t chunk_id,
-    uint64_t chunk_size,
-    uint64_t file_size,
-    uint64_t* data_size)
+    int fd,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t dir,
+    const struct ddup_cdc* cdc,
+    struct ddup_cdc_list* list,
+    char* buf,
+    int ranks)
 {
-    int status = 0;
+    mfu_digest_ctx ctx;
+    mfu_digest_init(&ctx);
+
+    uint64_t fp = 0;
+    uint64_t size = 0;
+    uint64_t done = 0;
+    while (done < length) {
+        size_t read_size = DDUP_CHUNK_SIZE;
+        if (length - done < (uint64_t) read_size) {
+            read_size = (size_t)(length - done);
+        }
+        ssize_t nread = mfu_pread(fname, fd, buf, read_size, (off_t)(offset + done));
+        if (nread <= 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to read `%s' (errno=%d %s)",
+                fname, errno, strerror(errno));
+            return -1;
+        }
 
-    assert(chunk_id > 0);
+        const unsigned char* data = (const unsigned char*) buf;
+        size_t n = (size_t) nread;
+        size_t start = 0;
+        size_t pos = 0;
+        while (pos < n) {
+            /* bytes before the min chunk size can not end a chunk */
+            if (size < cdc->min) {
+                size_t skip = (size_t)(cdc->min - size);
+                if (skip > n - pos) {
+                    skip = n - pos;
+                }
+                pos  += skip;
+                size += skip;
+                continue;
+            }
 
-    /* compute byte offset to read from in file */
-    uint64_t offset = (chunk_id - 1) * chunk_size;
+            fp = (fp << 1) + ddup_gear[data[pos]];
+            pos++;
+            size++;
+
+            uint64_t mask = (size < cdc->avg) ? cdc->mask_s : cdc->mask_l;
+            if ((fp & mask) == 0 || size >= cdc->max) {
+                mfu_digest_update(&ctx, data + start, pos - start);
+                ddup_cdc_append(list, &ctx, dir, size, ranks);
+                mfu_digest_init(&ctx);
+                start = pos;
+                fp = 0;
+                size = 0;
+            }
+        }
+        mfu_digest_update(&ctx, data + start, n - start);
 
-    /* zero out our buffer */
-    memset(chunk_buf, 0, chunk_size);
+        done += (uint64_t) nread;
+    }
 
-    /* open the file */
-    int flags = O_RDONLY;
-    if (noatime) {
-        flags |= O_NOATIME;
+    /* the end of the segment ends the last chunk */
+    if (size > 0) {
+        ddup_cdc_append(list, &ctx, dir, size, ranks);
     }
-    int fd = mfu_open(fname, flags);
-    if (fd < 0) {
-        return -1;
+
+    return 0;
+}
+
+/* totals for a directory */
+struct ddup_cdc_dir {
+    uint64_t dir;     /* id of directory */
+    uint64_t files;   /* number of files */
+    uint64_t chunks;  /* number of chunks */
+    uint64_t logical; /* bytes in all chunks */
+    uint64_t unique;  /* bytes in distinct chunks within directory */
+};
+
+/* order directory totals by id */
+static int ddup_cdc_dir_cmp(const void* a, const void* b)
+{
+    const struct ddup_cdc_dir* x = (const struct ddup_cdc_dir*) a;
+    const struct ddup_cdc_dir* y = (const struct ddup_cdc_dir*) b;
+    if (x->dir != y->dir) {
+        return (x->dir < y->dir) ? -1 : 1;
     }
+    return 0;
+}
 
-    /* seek to the correct offset */
-    if (mfu_lseek(fname, fd, (off_t)offset, SEEK_SET) == (off_t) - 1) {
-        status = -1;
-        goto out;
+/* order directory totals by the name that follows them */
+static int ddup_cdc_dir_name_cmp(const void* a, const void* b)
+{
+    const char* x = (const char*) a + sizeof(struct ddup_cdc_dir);
+    const char* y = (const char*) b + sizeof(struct ddup_cdc_dir);
+    return strcmp(x, y);
+}
+
+/* return the length of the name of the directory that we report a
+ * file under, which is the entry right below the top level directory
+ * that holds the file, or the top level directory itself */
+static size_t ddup_cdc_dir_len(const char* fname, const char* top, size_t top_len)
+{
+    if (strncmp(fname, top, top_len) != 0 || fname[top_len] != '/') {
+        return top_len;
+    }
+    const char* name = fname + top_len;
+    while (*name == '/') {
+        name++;
     }
+    const char* slash = strchr(name, '/');
+    if (slash == NULL) {
+        return top_len;
+    }
+    return (size_t)(slash - fname);
+}
 
-    /* read data from file */
-    ssize_t read_size = mfu_read(fname, fd, chunk_buf, chunk_size);
-    if (read_size < 0) {
-        /* read failed */
-        status = -1;
-        goto out;
+/* compute the id of a directory from its name */
+static uint64_t ddup_cdc_dir_id(const char* name, size_t len)
+{
+    unsigned char digest[MFU_DIGEST_SIZE];
+    mfu_digest_ctx ctx;
+    mfu_digest_init(&ctx);
+    mfu_digest_update(&ctx, name, len);
+    mfu_digest_final(&ctx, digest);
+
+    uint64_t id;
+    memcpy(&id, digest, sizeof(id));
+    return id;
+}
+
+/* merge consecutive totals for the same directory in a list sorted
+ * by id, keeping the first name we find, returns the new count */
+static uint64_t ddup_cdc_dir_merge(char* items, uint64_t count, size_t item_size)
+{
+    size_t hdr = sizeof(struct ddup_cdc_dir);
+    uint64_t merged = 0;
+    uint64_t i;
+    for (i = 0; i < count; i++) {
+        char* item = items + i * item_size;
+        struct ddup_cdc_dir* d = (struct ddup_cdc_dir*) item;
+        if (merged > 0) {
+            char* last = items + (merged - 1) * item_size;
+            struct ddup_cdc_dir* l = (struct ddup_cdc_dir*) last;
+            if (l->dir == d->dir) {
+                l->files   += d->files;
+                l->chunks  += d->chunks;
+                l->logical += d->logical;
+                l->unique  += d->unique;
+                if (last[hdr] == '\0') {
+                    memcpy(last + hdr, item + hdr, item_size - hdr);
+                }
+                continue;
+            }
+        }
+        if (item != items + merged * item_size) {
+            memcpy(items + merged * item_size, item, item_size);
+        }
+        merged++;
     }
+    return merged;
+}
 
-    /* compute number of bytes we expect to read */
-    ssize_t expect_size = (ssize_t) chunk_size;
-    if (chunk_id * chunk_size > file_size) {
-        if (offset >= file_size) {
-          /* have gone past the end of the file, expect to read 0 */
-          expect_size = 0;
-        } else {
-          /* read partial chunk */
-          expect_size = (ssize_t) (file_size - offset);
+/* split all regular files into content-defined chunks in parallel,
+ * count distinct chunks by sending each to a rank chosen from its
+ * digest, and print the bytes that remain after removing duplicate
+ * chunks for each directory right below top and for the whole tree,
+ * this only reads files */
+static void ddup_chunks(
+    mfu_flist flist,
+    const char* top,
+    uint64_t avg,
+    const mfu_proc_t* proc,
+    char* buf)
+{
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    ddup_gear_init();
+
+    struct ddup_cdc cdc;
+    ddup_cdc_init(&cdc, avg);
+
+    /* drop trailing slashes from the top level directory */
+    size_t top_len = strlen(top);
+    while (top_len > 1 && top[top_len - 1] == '/') {
+        top_len--;
+    }
+
+    /* build a list of the regular files that have data */
+    uint64_t i;
+    mfu_flist clist = mfu_flist_subset(flist);
+    uint64_t size = mfu_flist_size(flist);
+    for (i = 0; i < size; i++) {
+        mode_t mode = (mode_t) mfu_flist_file_get_mode(flist, i);
+        if (S_ISREG(mode) && mfu_flist_file_get_size(flist, i) > 0) {
+            mfu_flist_file_copy(flist, i, clist);
+        }
+    }
+    mfu_flist_summarize(clist);
+
+    /* get the longest name of a directory we report */
+    uint64_t files = mfu_flist_size(clist);
+    uint64_t max_name = 0;
+    for (i = 0; i < files; i++) {
+        const char* fname = mfu_flist_file_get_name(clist, i);
+        uint64_t len = (uint64_t) ddup_cdc_dir_len(fname, top, top_len) + 1;
+        if (len > max_name) {
+            max_name = len;
         }
     }
+    uint64_t all_max_name;
+    MPI_Allreduce(&max_name, &all_max_name, 1, MPI_UINT64_T, MPI_MAX, MPI_COMM_WORLD);
+
+    /* each directory total is followed by its name, padded to 8 bytes */
+    size_t hdr = sizeof(struct ddup_cdc_dir);
+    size_t item_size = hdr + (size_t)((all_max_name + 7) / 8 * 8);
+
+    /* split each file into segments that are spread evenly across
+     * ranks, and split each segment into chunks, a chunk never spans
+     * two segments so that chunks do not depend on the number of ranks */
+    uint64_t seg_size = DDUP_MERKLE_CHUNK_SIZE;
+    mfu_file_chunk* head = mfu_file_chunk_list_alloc(clist, seg_size);
+
+    struct ddup_cdc_list list;
+    memset(&list, 0, sizeof(list));
+    uint64_t errors = 0;
+    const mfu_file_chunk* p;
+    for (p = head; p != NULL; p = p->next) {
+        size_t dir_len = ddup_cdc_dir_len(p->name, top, top_len);
+        uint64_t dir = ddup_cdc_dir_id(p->name, dir_len);
+
+        /* open file with O_NOATIME if requested and if possible,
+         * we check the owner here since we may not own the file */
+        int flags = O_RDONLY;
+        if (options.open_noatime) {
+            struct stat st;
+            if (mfu_lstat(p->name, &st) == 0 && ddup_noatime(st.st_uid, proc)) {
+                flags |= O_NOATIME;
+            }
+        }
+        int fd = mfu_open(p->name, flags);
+        if (fd < 0) {
+            MFU_LOG(MFU_LOG_ERR, "Failed to open `%s' (errno=%d %s)",
+                p->name, errno, strerror(errno));
+            errors++;
+            continue;
+        }
 
-    /* check that we read all bytes we expected */
-    if (read_size != expect_size) {
-        /* File size has been changed */
-        status = -1;
-        goto out;
+        uint64_t off = p->offset;
+        uint64_t end = p->offset + p->length;
+        while (off < end) {
+            uint64_t seg_end = (off / seg_size + 1) * seg_size;
+            if (seg_end > end) {
+                seg_end = end;
+            }
+            if (ddup_cdc_segment(p->name, fd, off, seg_end - off, dir, &cdc, &list, buf, ranks)) {
+                errors++;
+                break;
+            }
+            off = seg_end;
+        }
+
+        mfu_close(p->name, fd);
     }
 
-    /* return number of bytes read */
-    *data_size = (uint64_t)read_size;
+    mfu_file_chunk_list_free(&head);
+
+    /* send each chunk to the rank that counts chunks with its digest */
+    uint64_t recv_count;
+    struct ddup_cdc_chunk* recv = (struct ddup_cdc_chunk*) mfu_exchange_items(
+        list.chunks, list.dests, list.count, sizeof(struct ddup_cdc_chunk), &recv_count, MPI_COMM_WORLD);
+    free(list.chunks);
+    free(list.dests);
+
+    /* sort chunks by digest, each run of equal digests is a set of
+     * duplicate chunks, and count the bytes of one chunk from each run
+     * for the whole tree, and one chunk from each run for each
+     * directory that holds the chunk */
+    qsort(recv, (size_t)recv_count, sizeof(struct ddup_cdc_chunk), ddup_cdc_chunk_cmp);
+
+    uint64_t totals[5] = {0, 0, 0, 0, 0}; /* files, chunks, bytes, unique bytes, errors */
+    char* dirs = (char*) MFU_MALLOC((recv_count + files + 1) * item_size);
+    uint64_t dir_count = 0;
+    uint64_t start = 0;
+    while (start < recv_count) {
+        const struct ddup_cdc_chunk* c = &recv[start];
+        totals[3] += c->size;
+
+        uint64_t end = start;
+        while (end < recv_count && memcmp(recv[end].digest, c->digest, MFU_DIGEST_SIZE) == 0) {
+            /* find range of this chunk in the same directory */
+            uint64_t dir = recv[end].dir;
+            char* item = dirs + dir_count * item_size;
+            memset(item, 0, item_size);
+            struct ddup_cdc_dir* d = (struct ddup_cdc_dir*) item;
+            d->dir    = dir;
+            d->unique = recv[end].size;
+            while (end < recv_count && recv[end].dir == dir &&
+                   memcmp(recv[end].digest, c->digest, MFU_DIGEST_SIZE) == 0)
+            {
+                d->chunks++;
+                d->logical += recv[end].size;
+                end++;
+            }
+            totals[1] += d->chunks;
+            totals[2] += d->logical;
+            dir_count++;
+        }
 
-out:
-    /* close our file and return */
-    mfu_close(fname, fd);
-    return status;
-}
+        start = end;
+    }
+    mfu_free(&recv);
+
+    /* add the name of each directory and the files we own in it */
+    for (i = 0; i < files; i++) {
+        const char* fname = mfu_flist_file_get_name(clist, i);
+        size_t dir_len = ddup_cdc_dir_len(fname, top, top_len);
+        char* item = dirs + dir_count * item_size;
+        memset(item, 0, item_size);
+        struct ddup_cdc_dir* d = (struct ddup_cdc_dir*) item;
+        d->dir   = ddup_cdc_dir_id(fname, dir_len);
+        d->files = 1;
+        memcpy(item + hdr, fname, dir_len);
+        dir_count++;
+    }
+    totals[0] = files;
+    totals[4] = errors;
 
-struct file_item {
-    SHA256_CTX ctx;
-};
+    /* sum the totals of each directory on a rank chosen from its id */
+    qsort(dirs, (size_t)dir_count, item_size, ddup_cdc_dir_cmp);
+    dir_count = ddup_cdc_dir_merge(dirs, dir_count, item_size);
+
+    int* dests = (int*) MFU_MALLOC((dir_count + 1) * sizeof(int));
+    for (i = 0; i < dir_count; i++) {
+        const struct ddup_cdc_dir* d = (const struct ddup_cdc_dir*)(dirs + i * item_size);
+        dests[i] = (int)(d->dir % (uint64_t)ranks);
+    }
+    uint64_t home_count;
+    char* home = (char*) mfu_exchange_items(dirs, dests, dir_count, item_size, &home_count, MPI_COMM_WORLD);
+    mfu_free(&dests);
+    mfu_free(&dirs);
+
+    qsort(home, (size_t)home_count, item_size, ddup_cdc_dir_cmp);
+    home_count = ddup_cdc_dir_merge(home, home_count, item_size);
+
+    /* gather directory totals to rank 0 */
+    int bytes = (int)(home_count * item_size);
+    int* counts = NULL;
+    int* disps  = NULL;
+    char* all = NULL;
+    uint64_t all_count = 0;
+    if (rank == 0) {
+        counts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+        disps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
+    }
+    MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        int disp = 0;
+        int r;
+        for (r = 0; r < ranks; r++) {
+            disps[r] = disp;
+            disp += counts[r];
+        }
+        all = (char*) MFU_MALLOC((size_t)disp + 1);
+        all_count = (uint64_t)disp / item_size;
+    }
+    MPI_Gatherv(home, bytes, MPI_BYTE, all, counts, disps, MPI_BYTE, 0, MPI_COMM_WORLD);
+    mfu_free(&home);
+
+    uint64_t all_totals[5];
+    MPI_Allreduce(totals, all_totals, 5, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+    /* print the totals of each directory and of the whole tree,
+     * the ratio of a directory only counts chunks that are
+     * duplicated within that directory */
+    if (rank == 0) {
+        double val;
+        const char* units;
+        mfu_format_bytes(cdc.avg, &val, &units);
+        printf("Average chunk size: %.3lf %s\n", val, units);
+
+        qsort(all, (size_t)all_count, item_size, ddup_cdc_dir_name_cmp);
+        for (i = 0; i <= all_count; i++) {
+            const char* name;
+            uint64_t d_files, d_chunks, d_logical, d_unique;
+            if (i < all_count) {
+                const char* item = all + i * item_size;
+                const struct ddup_cdc_dir* d = (const struct ddup_cdc_dir*) item;
+                name      = item + hdr;
+                d_files   = d->files;
+                d_chunks  = d->chunks;
+                d_logical = d->logical;
+                d_unique  = d->unique;
+            } else {
+                name      = "Total";
+                d_files   = all_totals[0];
+                d_chunks  = all_totals[1];
+                d_logical = all_totals[2];
+                d_unique  = all_totals[3];
+            }
+
+            double ratio = (d_unique > 0) ? (double)d_logical / (double)d_unique : 1.0;
+
+            double logical_val, unique_val;
+            const char* logical_units;
+            const char* unique_units;
+            mfu_format_bytes(d_logical, &logical_val, &logical_units);
+            mfu_format_bytes(d_unique, &unique_val, &unique_units);
+            printf("%s: %" PRIu64 " files, %" PRIu64 " chunks, %.3lf %s, "
+                "%.3lf %s unique, dedup ratio %.2f\n",
+                name, d_files, d_chunks, logical_val, logical_units,
+                unique_val, unique_units, ratio);
+        }
+        fflush(stdout);
+
+        if (all_totals[4] > 0) {
+            MFU_LOG(MFU_LOG_WARN, "Hit %" PRIu64 " errors reading files, data after an error is not counted",
+                all_totals[4]);
+        }
+    }
+
+    mfu_free(&all);
+    mfu_free(&disps);
+    mfu_free(&counts);
+    mfu_flist_free(&clist);
+}
 
 /* print SHA256 value to stdout */
 static void dump_sha256_digest(char* digest_string, unsigned char digest[])
@@ -173,9 +2167,7 @@ int main(int argc, char** argv)
     int status;
     uint64_t file_size;
 
-    uint64_t chunk_size = DDUP_CHUNK_SIZE;
-
-    SHA256_CTX* ctx_ptr;
+    ddup_hash_ctx* ctx_ptr;
 
     MPI_Init(NULL, NULL);
     mfu_init();
@@ -189,10 +2181,12 @@ int main(int argc, char** argv)
 
     mfu_debug_level = MFU_LOG_VERBOSE;
 
-    bool open_noatime = false;
-
     static struct option long_options[] = {
         {"open-noatime", 0, 0, 'U'},
+        {"cache",    1, 0, 'C'},
+        {"reclaim",  1, 0, 'R'},
+        {"chunks",   0, 0, 'K'},
+        {"chunk-size", 1, 0, 'S'},
         {"debug",    0, 0, 'd'},
         {"verbose",  0, 0, 'v'},
         {"quiet",    0, 0, 'q'},
@@ -205,12 +2199,44 @@ int main(int argc, char** argv)
     int help  = 0;
     int c;
     int option_index = 0;
+    unsigned long long bytes = 0;
     while ((c = getopt_long(argc, argv, "d:vqh", \
                             long_options, &option_index)) != -1)
     {
         switch (c) {
         case 'U':
-            open_noatime = true;
+            options.open_noatime = true;
+            break;
+        case 'C':
+            mfu_free(&options.cache);
+            options.cache = MFU_STRDUP(optarg);
+            break;
+        case 'R':
+            if (strcmp(optarg, "dedupe") == 0) {
+                options.reclaim = DDUP_RECLAIM_DEDUPE;
+            } else if (strcmp(optarg, "clone") == 0) {
+                options.reclaim = DDUP_RECLAIM_CLONE;
+            } else if (strcmp(optarg, "hardlink") == 0) {
+                options.reclaim = DDUP_RECLAIM_HARDLINK;
+            } else {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Unknown reclaim mode `%s'", optarg);
+                }
+                usage = 1;
+            }
+            break;
+        case 'K':
+            options.chunks = true;
+            break;
+        case 'S':
+            if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS || bytes < 1024) {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR, "Chunk size must be at least 1KB: '%s'", optarg);
+                }
+                usage = 1;
+            } else {
+                options.chunk_size = (uint64_t) bytes;
+            }
             break;
         case 'd':
             if (strncmp(optarg, "fatal", 5) == 0) {
@@ -304,6 +2330,9 @@ int main(int argc, char** argv)
     /* get the directory name */
     const char* dir = argv[optind];
 
+    /* get the hash used to filter candidates */
+    const ddup_hash* hash = DDUP_SHA256;
+
     /* create MPI datatypes */
     MPI_Datatype key;
     MPI_Datatype keysat;
@@ -331,23 +2360,41 @@ int main(int argc, char** argv)
     mfu_proc_t proc;
     mfu_proc_set(&proc);
 
+    /* report duplicate chunks and skip the search for duplicate files */
+    if (options.chunks) {
+        ddup_chunks(flist, dir, options.chunk_size, &proc, chunk_buf);
+
+        mfu_walk_opts_delete(&walk_opts);
+        mfu_file_delete(&mfu_file);
+        mfu_free(&chunk_buf);
+        mfu_flist_free(&flist);
+        mtcmp_cmp_fini(&cmp);
+        mpi_type_fini(&key, &keysat);
+        status = 0;
+        goto out;
+    }
+
+    /* limit the number of files we hold open across rounds,
+     * leaving plenty of descriptors for MPI and the library */
+    uint64_t open_count = 0;
+    uint64_t open_max = 0;
+    long max_fds = sysconf(_SC_OPEN_MAX);
+    if (max_fds > 64) {
+        open_max = (uint64_t)(max_fds / 2);
+    }
+
     /* get local number of items in flist */
     uint64_t checking_files = mfu_flist_size(flist);
 
-    /* allocate memory to hold SHA256 context values */
+    /* allocate memory to hold hash state of each file */
     struct file_item* file_items = (struct file_item*) MFU_MALLOC(checking_files * sizeof(*file_items));
 
-    /* Allocate two lists of length size, where each
-     * element has (DDUP_KEY_SIZE + 1) uint64_t values
-     * (id, checksum, index)
-     */
-    size_t list_bytes = checking_files * (DDUP_KEY_SIZE + 1) * sizeof(uint64_t);
-    uint64_t* list     = (uint64_t*) MFU_MALLOC(list_bytes);
-    uint64_t* new_list = (uint64_t*) MFU_MALLOC(list_bytes);
-
-    /* Initialize the list */
-    uint64_t* ptr = list;
-    uint64_t new_checking_files = 0;
+    /* gather the size of each regular file */
+    uint64_t* idxs  = (uint64_t*) MFU_MALLOC((checking_files + 1) * sizeof(uint64_t));
+    uint64_t* sizes = (uint64_t*) MFU_MALLOC((checking_files + 1) * sizeof(uint64_t));
+    uint64_t* vals  = (uint64_t*) MFU_MALLOC((checking_files + 1) * sizeof(uint64_t));
+    uint64_t* sums  = (uint64_t*) MFU_MALLOC((checking_files + 1) * sizeof(uint64_t));
+    uint64_t regular_files = 0;
     for (i = 0; i < checking_files; i++) {
         /* check that item is a regular file */
         mode_t mode = (mode_t) mfu_flist_file_get_mode(flist, i);
@@ -362,30 +2409,151 @@ int main(int argc, char** argv)
             continue;
         }
 
-        /* for first pass, group all files with same file size */
-        ptr[0] = file_size;
+        struct file_item* item = &file_items[i];
+        item->cached      = false;
+        item->candidate   = false;
+        item->ident_valid = false;
+
+        idxs[regular_files]  = i;
+        sizes[regular_files] = file_size;
+        vals[regular_files]  = 1;
+        regular_files++;
+    }
 
-        /* we'll leave the middle part of the key unset */
+    /* look up digests of all regular files in the cache, so that
+     * entries of files we still have are kept even if those files
+     * are not candidates this time */
+    struct ddup_cache_entry* cache_table = NULL;
+    uint64_t cache_count = 0;
+    if (options.cache != NULL) {
+        cache_table = ddup_cache_load(options.cache, &cache_count);
+
+        struct ddup_cache_entry* queries = (struct ddup_cache_entry*) MFU_MALLOC((regular_files + 1) * sizeof(struct ddup_cache_entry));
+        uint64_t query_count = 0;
+        for (i = 0; i < regular_files; i++) {
+            uint64_t idx = idxs[i];
+            struct file_item* item = &file_items[idx];
+            const char* fname = mfu_flist_file_get_name(flist, idx);
+            if (ddup_cache_ident(fname, sizes[i], item->ident) == 0) {
+                item->ident_valid = true;
+
+                struct ddup_cache_entry* q = &queries[query_count];
+                memcpy(q->key, item->ident, sizeof(q->key));
+                q->rank  = (uint64_t) rank;
+                q->index = idx;
+                q->found = 0;
+                query_count++;
+            }
+        }
+        ddup_cache_lookup(cache_table, cache_count, queries, query_count, file_items);
+        mfu_free(&queries);
+        mfu_free(&cache_table);
+    }
 
-        /* record our index in flist */
-        ptr[DDUP_KEY_SIZE] = i;
+    /* only files that share their size with another file
+     * can have duplicates, so drop all others before we
+     * read any data */
+    ddup_sum_by_size(regular_files, sizes, vals, sums);
+    uint64_t candidates = 0;
+    for (i = 0; i < regular_files; i++) {
+        if (sums[i] > 1) {
+            idxs[candidates]  = idxs[i];
+            sizes[candidates] = sizes[i];
+            candidates++;
+        }
+    }
 
-        /* initialize the SHA256 hash state for this file */
-        SHA256_Init(&file_items[i].ctx);
+    /* initialize the state for each candidate */
+    for (i = 0; i < candidates; i++) {
+        struct file_item* item = &file_items[idxs[i]];
+        hash->init(&item->ctx);
+        item->offset    = 0;
+        item->fd        = -1;
+        item->error     = false;
+        item->candidate = true;
+    }
 
-        /* increment our file count */
-        new_checking_files++;
+    /* record the identity of each candidate before we read it,
+     * to detect changes before we reclaim its space */
+    if (options.cache == NULL && options.reclaim != DDUP_RECLAIM_NONE) {
+        for (i = 0; i < candidates; i++) {
+            uint64_t idx = idxs[i];
+            struct file_item* item = &file_items[idx];
+            const char* fname = mfu_flist_file_get_name(flist, idx);
+            if (ddup_cache_ident(fname, sizes[i], item->ident) == 0) {
+                item->ident_valid = true;
+            }
+        }
+    }
 
-        /* advance to next spot in the list */
-        ptr += DDUP_KEY_SIZE + 1;
+    /* count cached files of each size, we can only tell whether
+     * an uncached file duplicates a cached file by computing its
+     * full digest */
+    for (i = 0; i < candidates; i++) {
+        vals[i] = (uint64_t) file_items[idxs[i]].cached;
+    }
+    ddup_sum_by_size(candidates, sizes, vals, sums);
+
+    uint64_t counts[2], all_counts[2];
+    counts[0] = candidates;
+    counts[1] = 0;
+    for (i = 0; i < candidates; i++) {
+        counts[1] += vals[i];
+    }
+    MPI_Allreduce(counts, all_counts, 2, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (options.cache != NULL && rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Found digests of %" PRIu64 " of %" PRIu64 " candidate files in cache",
+            all_counts[1], all_counts[0]);
     }
 
-    /* reduce our list count based on any files filtered out above */
-    checking_files = new_checking_files;
+    /* Allocate lists of length candidates, where each
+     * element has (DDUP_KEY_SIZE + 1) uint64_t values
+     * (id, checksum, index), one list for files we filter
+     * by reading data in rounds, and one for files whose
+     * digest we have computed */
+    size_t list_bytes = (candidates + 1) * (DDUP_KEY_SIZE + 1) * sizeof(uint64_t);
+    uint64_t* list      = (uint64_t*) MFU_MALLOC(list_bytes);
+    uint64_t* new_list  = (uint64_t*) MFU_MALLOC(list_bytes);
+    uint64_t* done_list = (uint64_t*) MFU_MALLOC(list_bytes);
+
+    /* flist indices of files we must compute the full digest for */
+    uint64_t* confirm = (uint64_t*) MFU_MALLOC((candidates + 1) * sizeof(uint64_t));
+    uint64_t confirm_count = 0;
+
+    /* Initialize the lists */
+    uint64_t* ptr = list;
+    uint64_t* done_ptr = done_list;
+    checking_files = 0;
+    for (i = 0; i < candidates; i++) {
+        uint64_t idx = idxs[i];
+        struct file_item* item = &file_items[idx];
+        if (item->cached) {
+            /* we already have the digest of this file */
+            ddup_done_append(&done_ptr, sizes[i], item, idx);
+        } else if (sums[i] > 0) {
+            /* file has same size as a cached file */
+            confirm[confirm_count] = idx;
+            confirm_count++;
+        } else {
+            /* for first pass, group all files with same file size */
+            ptr[0] = sizes[i];
+
+            /* we'll leave the middle part of the key unset */
+
+            /* record our index in flist */
+            ptr[DDUP_KEY_SIZE] = idx;
+
+            /* increment our file count */
+            checking_files++;
+
+            /* advance to next spot in the list */
+            ptr += DDUP_KEY_SIZE + 1;
+        }
+    }
 
     /* allocate arrays to hold result from DTCMP_Rankv call to
      * assign group and rank values to each item */
-    uint64_t output_bytes = checking_files * sizeof(uint64_t);
+    uint64_t output_bytes = (candidates + 1) * sizeof(uint64_t);
     uint64_t* group_id    = (uint64_t*) MFU_MALLOC(output_bytes);
     uint64_t* group_ranks = (uint64_t*) MFU_MALLOC(output_bytes);
     uint64_t* group_rank  = (uint64_t*) MFU_MALLOC(output_bytes);
@@ -395,56 +2563,122 @@ int main(int argc, char** argv)
     MPI_Allreduce(&checking_files, &sum_checking_files, 1,
                   MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
 
-    uint64_t chunk_id = 0;
+    uint64_t round = 0;
     while (sum_checking_files > 1) {
-        /* update the chunk id we'll read from all files */
-        chunk_id++;
+        /* each round hashes bytes from the start of every file
+         * up to a point which doubles each round */
+        round++;
+        uint64_t round_end = ddup_round_end(round);
+
+        /* once the span to hash gets large, hash the rest of every
+         * remaining file in parallel across ranks */
+        if (round_end > DDUP_MERKLE_CHUNK_SIZE) {
+            /* bytes up to the end of the last round are hashed */
+            ptr = list;
+            for (i = 0; i < checking_files; i++) {
+                uint64_t idx = ptr[DDUP_KEY_SIZE];
+                const char* fname = mfu_flist_file_get_name(flist, idx);
+                ddup_close(&file_items[idx], fname, &open_count);
+                idxs[i] = idx;
+                ptr += DDUP_KEY_SIZE + 1;
+            }
 
-        /* iterate over our list and compute SHA256 value for each */
-        ptr = list;
-        for (i = 0; i < checking_files; i++) {
-            /* get the flist index for this item */
-            uint64_t idx = ptr[DDUP_KEY_SIZE];
+            uint64_t skip = ddup_round_end(round - 1);
+            ddup_merkle(flist, file_items, idxs, checking_files, skip,
+                        hash, &proc, chunk_buf);
+
+            /* use hash value as key */
+            ptr = list;
+            for (i = 0; i < checking_files; i++) {
+                uint64_t idx = ptr[DDUP_KEY_SIZE];
+                ddup_hash_ctx ctx_tmp = file_items[idx].ctx;
+                memset(ptr + 1, 0, SHA256_DIGEST_LENGTH);
+                hash->final(&ctx_tmp, (unsigned char*)(ptr + 1));
+                if (file_items[idx].error) {
+                    const char* fname = mfu_flist_file_get_name(flist, idx);
+                    MFU_LOG(MFU_LOG_WARN, "Failed to read %s, size may have changed", fname);
+                }
+                ptr += DDUP_KEY_SIZE + 1;
+            }
+        } else {
+            /* iterate over our list and compute hash value for each */
+            ptr = list;
+            for (i = 0; i < checking_files; i++) {
+                /* get the flist index for this item */
+                uint64_t idx = ptr[DDUP_KEY_SIZE];
+                struct file_item* item = &file_items[idx];
 
-            /* look up file name */
-            const char* fname = mfu_flist_file_get_name(flist, idx);
+                /* look up file name */
+                const char* fname = mfu_flist_file_get_name(flist, idx);
 
-            /* look up file size */
-            file_size = mfu_flist_file_get_size(flist, idx);
+                /* look up file size */
+                file_size = mfu_flist_file_get_size(flist, idx);
 
-            /* open file with O_NOATIME if requested and if possible */
-            bool noatime = false;
-            if (open_noatime) {
+                /* open file with O_NOATIME if requested and if possible */
                 uid_t owner = (uid_t) mfu_flist_file_get_uid(flist, idx);
-                if (proc.geteuid == owner || proc.cap_fowner) {
-                    noatime = true;
+                bool noatime = ddup_noatime(owner, &proc);
+
+                /* compute the span of bytes to add to the hash this round */
+                uint64_t end = round_end;
+                if (end > file_size) {
+                    end = file_size;
                 }
-            }
 
-            /* read a chunk of data from the file into chunk_buf */
-            uint64_t data_size;
-            status = read_data(fname, noatime, chunk_buf, chunk_id,
-                               chunk_size, file_size, &data_size);
-            if (status) {
-                /* File size has been changed, TODO: handle */
-                MFU_LOG(MFU_LOG_WARN, "Failed to read %s, size may have changed", fname);
-            }
+                /* get a pointer to the hash context for this file */
+                ctx_ptr = &item->ctx;
+
+                /* add the next span of bytes to the hash */
+                int fd = ddup_open(item, fname, noatime, &open_count, open_max);
+                if (fd < 0) {
+                    item->error = true;
+                } else if (! item->error) {
+                    status = hash_data(fname, fd, hash, ctx_ptr, chunk_buf,
+                                       item->offset, end - item->offset);
+                    if (status) {
+                        item->error = true;
+                    }
+                }
+                item->offset = end;
 
-            /* update the SHA256 context for this file */
-            ctx_ptr = &file_items[idx].ctx;
-            SHA256_Update(ctx_ptr, chunk_buf, data_size);
+                /*
+                 * Use hash value as key.
+                 * Finalizing changes the context, so we
+                 * finalize a copy of it
+                 */
+                ddup_hash_ctx ctx_tmp = *ctx_ptr;
+
+                /* in the first round, also hash the tail of the file,
+                 * since files that differ often do so at the end, this
+                 * goes into the key only, the group id carries it into
+                 * later rounds */
+                if (round == 1 && end < file_size && fd >= 0 && ! item->error) {
+                    uint64_t tail_size = file_size - end;
+                    if (tail_size > DDUP_HEAD_SIZE) {
+                        tail_size = DDUP_HEAD_SIZE;
+                    }
+                    status = hash_data(fname, fd, hash, &ctx_tmp, chunk_buf,
+                                       file_size - tail_size, tail_size);
+                    if (status) {
+                        item->error = true;
+                    }
+                }
 
-            /*
-             * Use SHA256 value as key.
-             * This is actually an hack, but SHA256_Final can't
-             * be called multiple times with out changing ctx
-             */
-            SHA256_CTX ctx_tmp;
-            memcpy(&ctx_tmp, ctx_ptr, sizeof(ctx_tmp));
-            SHA256_Final((unsigned char*)(ptr + 1), &ctx_tmp);
+                memset(ptr + 1, 0, SHA256_DIGEST_LENGTH);
+                hash->final(&ctx_tmp, (unsigned char*)(ptr + 1));
 
-            /* move on to next file in the list */
-            ptr += DDUP_KEY_SIZE + 1;
+                if (item->error) {
+                    MFU_LOG(MFU_LOG_WARN, "Failed to read %s, size may have changed", fname);
+                }
+
+                /* close the file if we are done reading from it */
+                ddup_release(item, fname, fd);
+                if (item->offset >= file_size || item->error) {
+                    ddup_close(item, fname, &open_count);
+                }
+
+                /* move on to next file in the list */
+                ptr += DDUP_KEY_SIZE + 1;
+            }
         }
 
         /* Assign group ids and compute group sizes */
@@ -459,7 +2693,7 @@ int main(int argc, char** argv)
          * any files in groups sizes > 1 for which we've read
          * all bytes are the same, and filter all other files
          * into a new list for another iteration */
-        new_checking_files = 0;
+        uint64_t new_checking_files = 0;
         ptr = list;
         uint64_t* new_ptr = new_list;
         for (i = 0; i < checking_files; i++) {
@@ -472,15 +2706,19 @@ int main(int argc, char** argv)
             /* look up file size */
             file_size = mfu_flist_file_get_size(flist, idx);
 
-            /* get a pointer to the SHA256 context for this file */
-            ctx_ptr = &file_items[idx].ctx;
+            /* get a pointer to the hash context for this file */
+            struct file_item* item = &file_items[idx];
+            ctx_ptr = &item->ctx;
 
             if (group_ranks[i] == 1) {
                 /*
                  * Only one file in this group,
                  * mfu_flist_file_name(flist, idx) is unique
                  */
-            } else if (file_size <= (chunk_id * chunk_size)) {
+                ddup_close(item, fname, &open_count);
+            } else if (item->error) {
+                /* failed to read this file, drop it from the list */
+            } else if (file_size <= item->offset) {
                 /*
                  * We've run out of bytes to checksum, and we
                  * still have a group size > 1
@@ -488,12 +2726,9 @@ int main(int argc, char** argv)
                  * duplicate with other files that also have
                  * matching group_id[i]
                  */
-                unsigned char digest[SHA256_DIGEST_LENGTH];
-                SHA256_Final(digest, ctx_ptr);
-
-                char digest_string[SHA256_DIGEST_LENGTH * 2 + 1];
-                dump_sha256_digest(digest_string, digest);
-                printf("%s %s\n", fname, digest_string);
+                /* this is the digest we report */
+                hash->final(ctx_ptr, item->digest);
+                ddup_done_append(&done_ptr, file_size, item, idx);
             } else {
                 /* Have multiple files with the same checksum,
                  * but still have bytes left to read, so keep
@@ -516,9 +2751,9 @@ int main(int argc, char** argv)
                 new_ptr += DDUP_KEY_SIZE + 1;
 
                 MFU_LOG(MFU_LOG_DBG, "checking file "
-                          "\"%s\" for chunk index %d of size %"
-                          PRIu64"\n", fname, (int)chunk_id,
-                          chunk_size);
+                          "\"%s\" hashed %" PRIu64 " of %"
+                          PRIu64 " bytes", fname, item->offset,
+                          file_size);
             }
 
             /* move on to next file in the list */
@@ -539,6 +2774,94 @@ int main(int argc, char** argv)
                       MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
     }
 
+    /* close any files still held open */
+    ptr = list;
+    for (i = 0; i < checking_files; i++) {
+        uint64_t idx = ptr[DDUP_KEY_SIZE];
+        const char* fname = mfu_flist_file_get_name(flist, idx);
+        ddup_close(&file_items[idx], fname, &open_count);
+        ptr += DDUP_KEY_SIZE + 1;
+    }
+
+    /* compute the digest of files that have the same size
+     * as a cached file */
+    ddup_confirm(flist, file_items, confirm, confirm_count, &proc, chunk_buf);
+    for (i = 0; i < confirm_count; i++) {
+        uint64_t idx = confirm[i];
+        struct file_item* item = &file_items[idx];
+        file_size = mfu_flist_file_get_size(flist, idx);
+        if (item->error) {
+            const char* fname = mfu_flist_file_get_name(flist, idx);
+            MFU_LOG(MFU_LOG_WARN, "Failed to read %s, size may have changed", fname);
+            continue;
+        }
+        ddup_done_append(&done_ptr, file_size, item, idx);
+    }
+
+    /* group files by size and digest, any file in a group
+     * of size > 1 is a duplicate of the others in its group */
+    uint64_t done_files = (uint64_t)(done_ptr - done_list) / (DDUP_KEY_SIZE + 1);
+    uint64_t groups;
+    DTCMP_Rankv(
+        (int)done_files, done_list,
+        &groups, group_id, group_ranks, group_rank,
+        key, keysat, cmp, DTCMP_FLAG_NONE, MPI_COMM_WORLD
+    );
+
+    ptr = done_list;
+    for (i = 0; i < done_files; i++) {
+        uint64_t idx = ptr[DDUP_KEY_SIZE];
+        if (group_ranks[i] > 1) {
+            const char* fname = mfu_flist_file_get_name(flist, idx);
+            char digest_string[SHA256_DIGEST_LENGTH * 2 + 1];
+            dump_sha256_digest(digest_string, file_items[idx].digest);
+            printf("%s %s\n", fname, digest_string);
+        }
+        ptr += DDUP_KEY_SIZE + 1;
+    }
+
+    /* reclaim space used by duplicates */
+    if (options.reclaim != DDUP_RECLAIM_NONE) {
+        ddup_reclaim(flist, file_items, done_list, done_files,
+                     group_id, group_ranks, group_rank);
+    }
+
+    /* store digests of files we know in the cache, entries of files
+     * we did not find in this walk are dropped */
+    if (options.cache != NULL) {
+        uint64_t items = mfu_flist_size(flist);
+        struct ddup_cache_entry* entries = (struct ddup_cache_entry*) MFU_MALLOC((items + 1) * sizeof(struct ddup_cache_entry));
+        uint64_t entry_count = 0;
+        for (i = 0; i < items; i++) {
+            /* keep cached digests of files that were not candidates */
+            mode_t mode = (mode_t) mfu_flist_file_get_mode(flist, i);
+            if (! S_ISREG(mode) || mfu_flist_file_get_size(flist, i) == 0) {
+                continue;
+            }
+            struct file_item* item = &file_items[i];
+            if (item->ident_valid && item->cached && ! item->candidate) {
+                struct ddup_cache_entry* e = &entries[entry_count];
+                memcpy(e->key, item->ident, sizeof(e->key));
+                memcpy(e->digest, item->digest, SHA256_DIGEST_LENGTH);
+                entry_count++;
+            }
+        }
+        ptr = done_list;
+        for (i = 0; i < done_files; i++) {
+            uint64_t idx = ptr[DDUP_KEY_SIZE];
+            struct file_item* item = &file_items[idx];
+            if (item->ident_valid) {
+                struct ddup_cache_entry* e = &entries[entry_count];
+                memcpy(e->key, item->ident, sizeof(e->key));
+                memcpy(e->digest, item->digest, SHA256_DIGEST_LENGTH);
+                entry_count++;
+            }
+            ptr += DDUP_KEY_SIZE + 1;
+        }
+        ddup_cache_store(options.cache, entries, entry_count);
+        mfu_free(&entries);
+    }
+
     /* free the walk options */
     mfu_walk_opts_delete(&walk_opts);
 
@@ -548,8 +2871,14 @@ int main(int argc, char** argv)
     mfu_free(&group_rank);
     mfu_free(&group_ranks);
     mfu_free(&group_id);
+    mfu_free(&confirm);
+    mfu_free(&done_list);
     mfu_free(&new_list);
     mfu_free(&list);
+    mfu_free(&sums);
+    mfu_free(&vals);
+    mfu_free(&sizes);
+    mfu_free(&idxs);
     mfu_free(&file_items);
     mfu_free(&chunk_buf);
     mfu_flist_free(&flist);
@@ -560,6 +2889,8 @@ int main(int argc, char** argv)
     status = 0;
 
 out:
+    mfu_free(&options.cache);
+
     mfu_finalize();
     MPI_Finalize();
 
@@ -202,7 +202,8 @@ static int sort_files_readdir(const char* sortfields, mfu_flist* pflist)
         }
 
         /* pack file element */
-        sortptr += mfu_flist_file_pack(sortptr, flist, idx);
+        mfu_flist_file_pack(sortptr, flist, idx);
+        sortptr += bytes;
 
         idx++;
     }
@@ -225,7 +226,8 @@ static int sort_files_readdir(const char* sortfields, mfu_flist* pflist)
     sortptr = (char*) outsortbuf;
     while (idx < (uint64_t)outsortcount) {
         sortptr += key_extent;
-        sortptr += mfu_flist_file_unpack(sortptr, flist2);
+        mfu_flist_file_unpack(sortptr, flist2);
+        sortptr += bytes;
         idx++;
     }
 
@@ -1160,7 +1162,8 @@ static int sort_files_stat(const char* sortfields, mfu_flist* pflist)
         }
 
         /* pack file element */
-        sortptr += mfu_flist_file_pack(sortptr, flist, idx);
+        mfu_flist_file_pack(sortptr, flist, idx);
+        sortptr += bytes;
 
         idx++;
     }
@@ -1183,7 +1186,8 @@ static int sort_files_stat(const char* sortfields, mfu_flist* pflist)
     sortptr = (char*) outsortbuf;
     while (idx < (uint64_t)outsortcount) {
         sortptr += key_extent;
-        sortptr += mfu_flist_file_unpack(sortptr, flist2);
+        mfu_flist_file_unpack(sortptr, flist2);
+        sortptr += bytes;
         idx++;
     }
 
@@ -1505,10 +1509,6 @@ static void print_files(mfu_flist flist, mfu_path* path)
     int* counts = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
     int* disps  = (int*) MFU_MALLOC((size_t)ranks * sizeof(int));
 
-    /* tell rank 0 where the data is coming from */
-    int bytes = num * (int)pack_size;
-    MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
     /* pack items into sendbuf */
     idx = 0;
     char* ptr = (char*) sendbuf;
@@ -1520,6 +1520,10 @@ static void print_files(mfu_flist flist, mfu_path* path)
         idx++;
     }
 
+    /* tell rank 0 where the data is coming from */
+    int bytes = (int)(ptr - (char*) sendbuf);
+    MPI_Gather(&bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
     /* compute displacements and total bytes */
     int recvbytes = 0;
     if (rank == 0) {
@@ -1543,8 +1547,7 @@ static void print_files(mfu_flist flist, mfu_path* path)
         ptr = (char*) recvbuf;
         char* end = ptr + recvbytes;
         while (ptr < end) {
-            mfu_flist_file_unpack(ptr, tmplist);
-            ptr += pack_size;
+            ptr += mfu_flist_file_unpack(ptr, tmplist);
         }
     }
 
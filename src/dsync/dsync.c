@@ -39,6 +39,7 @@
 
 #include "mfu.h"
 #include "strmap.h"
+#include "mfu_statemap.h"
 #include "list.h"
 
 #include "mfu_errors.h"
@@ -64,17 +65,29 @@ static void print_usage(void)
     printf("      --bufsize <SIZE>    - IO buffer size in bytes (default " MFU_BUFFER_SIZE_STR ")\n");
     printf("      --chunksize <SIZE>  - minimum work size per task in bytes (default " MFU_CHUNK_SIZE_STR ")\n");
     printf("  -X, --xattrs <OPT>      - copy xattrs (none, all, non-lustre, libattr)\n");
+    printf("      --walk-xattrs       - read xattrs while walking the source rather than during the copy\n");
 #ifdef DAOS_SUPPORT
     printf("      --daos-api          - DAOS API in {DFS, DAOS} (default uses DFS for POSIX containers)\n");
 #endif
     printf("  -c, --contents          - read and compare file contents rather than compare size and mtime\n");
+    printf("      --digest            - like --contents, but compare digests of data read separately from each side\n");
+    printf("      --digest-cache      - like --digest, but cache digests in an xattr on each file to skip unchanged files\n");
+    printf("      --data-readers <N>  - first N ranks walk and read the source, the others read the target\n");
     printf("  -D, --delete            - delete extraneous files from target\n");
+    printf("      --detect-renames    - with --delete, rename items in target that were moved in source\n");
+    printf("      --delta             - rewrite only the changed chunks of files that differ in size or mtime\n");
+    printf("      --stream            - with --contents, copy new and changed items while comparing contents\n");
     printf("  -L, --dereference       - copy original files instead of links\n");
     printf("  -P, --no-dereference    - don't follow links in source\n"); 
     printf("  -s, --direct            - open files with O_DIRECT\n");
+    printf("      --direct-threshold <SIZE> - use O_DIRECT to copy or compare only files of at least SIZE bytes (implies --direct)\n");
     printf("      --open-noatime      - open files with O_NOATIME\n");
     printf("      --link-dest <DIR>   - hardlink to files in DIR when unchanged\n");
     printf("  -S, --sparse            - create sparse files when possible\n");
+    printf("      --preallocate       - reserve space for file data when creating files\n");
+#ifdef LUSTRE_SUPPORT
+    printf("      --stripe-bytes <SIZE> - stripe new files with one stripe per SIZE bytes of data\n");
+#endif
     printf("      --progress <N>      - print progress every N seconds\n");
     printf("  -v, --verbose           - verbose output\n");
     printf("  -q, --quiet             - quiet output\n");
@@ -186,6 +199,10 @@ struct dsync_options {
     int debug;                     /* check result after get result */
     int delete;                    /* delete extraneous files from destination dirs */
     char* link_dest;               /* link dest dir */
+    int digest;                    /* compare digests of data read separately from each side */
+    int renames;                   /* rename items in destination that were moved in source */
+    int delta;                     /* patch changed files in place rather than copying them */
+    int stream;                    /* compare contents during the copy rather than before it */
     int need_compare[DCMPF_MAX];   /* fields that need to be compared  */
 };
 
@@ -198,6 +215,10 @@ struct dsync_options options = {
     .debug        = 0,
     .delete       = 0,
     .link_dest    = NULL,
+    .digest       = 0,
+    .renames      = 0,
+    .delta        = 0,
+    .stream       = 0,
     .need_compare = {0,}
 };
 
@@ -376,117 +397,78 @@ static int dsync_state_from_string(const char* string, dsync_state *state)
     return -ENOENT;
 }
 
-/* given a filename as the key, encode an index followed
- * by the init state */
+/* given a filename as the key, record its index,
+ * all fields start in the init state */
 static void dsync_strmap_item_init(
-    strmap* map,
+    mfu_statemap* map,
     const char *key,
     uint64_t item_index)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char val[21 + DCMPF_MAX];
-    int i;
-
-    /* encode the index */
-    int len = snprintf(val, sizeof(val), "%llu",
-                       (unsigned long long) item_index);
-
-    /* encode the state (state characters and trailing NUL) */
-    assert((size_t)len + DCMPF_MAX + 1 <= (sizeof(val)));
-    size_t position = strlen(val);
-    for (i = 0; i < DCMPF_MAX; i++) {
-        val[position] = DCMPS_INIT;
-        position++;
-    }
-    val[position] = '\0';
-
     /* add item to map */
-    strmap_set(map, key, val);
+    mfu_statemap_insert(map, item_index, key);
 }
 
 static void dsync_strmap_item_update(
-    strmap* map,
+    mfu_statemap* map,
     const char *key,
     dsync_field field,
     dsync_state state)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char new_val[21 + DCMPF_MAX];
-
     /* lookup item from map */
-    const char* val = strmap_get(map, key);
-
-    /* copy existing index over */
+    uint64_t item_index;
+    int rc = mfu_statemap_lookup(map, key, &item_index);
+    assert(rc == 0);
     assert(field < DCMPF_MAX);
-    assert(strlen(val) + 1 <= sizeof(new_val));
-    strcpy(new_val, val);
 
     /* set new state value */
-    size_t position = strlen(new_val) - DCMPF_MAX;
-    new_val[position + field] = state;
-
-    /* reinsert item in map */
-    strmap_set(map, key, new_val);
+    mfu_statemap_set(map, item_index, field, state - DCMPS_INIT);
 }
 
 static int dsync_strmap_item_index(
-    strmap* map,
+    mfu_statemap* map,
     const char *key,
     uint64_t *item_index)
 {
-    /* Should be long enough for 64 bit number and DCMPF_MAX */
-    char new_val[21 + DCMPF_MAX];
-
     /* lookup item from map */
-    const char* val = strmap_get(map, key);
-    if (val == NULL) {
-        return -1;
-    }
-
-    /* extract index */
-    assert(strlen(val) + 1 <= sizeof(new_val));
-    strcpy(new_val, val);
-    new_val[strlen(new_val) - DCMPF_MAX] = '\0';
-    *item_index = strtoull(new_val, NULL, 0);
-
-    return 0;
+    return mfu_statemap_lookup(map, key, item_index);
 }
 
 static int dsync_strmap_item_state(
-    strmap* map,
+    mfu_statemap* map,
     const char *key,
     dsync_field field,
     dsync_state *state)
 {
     /* lookup item from map */
-    const char* val = strmap_get(map, key);
-    if (val == NULL) {
+    uint64_t item_index;
+    if (mfu_statemap_lookup(map, key, &item_index) != 0) {
         return -1;
     }
 
     /* extract state */
-    assert(strlen(val) > DCMPF_MAX);
     assert(field < DCMPF_MAX);
-    size_t position = strlen(val) - DCMPF_MAX;
-    *state = val[position + field];
+    *state = DCMPS_INIT + mfu_statemap_get(map, item_index, field);
 
     return 0;
 }
 
 /* map each file name to its index in the file list and initialize
- * its state for comparison operation */
-static strmap* dsync_strmap_creat(mfu_flist list, const char* prefix)
+ * its state for comparison operation, the map refers to names
+ * in the list, so it must be deleted before the list is freed */
+static mfu_statemap* dsync_strmap_creat(mfu_flist list, const char* prefix)
 {
-    /* create a new string map to map a file name to a string
-     * encoding its index and state */
-    strmap* map = strmap_new();
+    /* iterate over each item in the file list */
+    uint64_t i = 0;
+    uint64_t count = mfu_flist_size(list);
+
+    /* create a new map from a file name to its index and state */
+    assert(DCMPF_MAX <= MFU_STATEMAP_FIELDS_MAX);
+    assert(DCMPS_MAX - DCMPS_INIT <= MFU_STATEMAP_STATE_MAX);
+    mfu_statemap* map = mfu_statemap_new(count);
 
     /* determine length of prefix string */
     size_t prefix_len = strlen(prefix);
 
-    /* iterate over each item in the file list */
-    uint64_t i = 0;
-    uint64_t count = mfu_flist_size(list);
     while (i < count) {
         /* get full path of file name */
         const char* name = mfu_flist_file_get_name(list, i);
@@ -525,8 +507,8 @@ static void dsync_compare_acl(
     uint64_t src_index,
     mfu_flist dst_list,
     uint64_t dst_index,
-    strmap* src_map,
-    strmap* dst_map,
+    mfu_statemap* src_map,
+    mfu_statemap* dst_map,
     int *diff)
 {
     void *src_val, *dst_val;
@@ -597,10 +579,10 @@ static int dsync_option_need_compare(dsync_field field)
 /* Return -1 when error, return 0 when equal, return > 0 when diff */
 static int dsync_compare_metadata(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     uint64_t src_index,
     mfu_flist dst_list,
-    strmap* dst_map,
+    mfu_statemap* dst_map,
     uint64_t dst_index,
     const char* key)
 {
@@ -707,6 +689,111 @@ static void compare_progress_fn(const uint64_t* vals, int count, int complete, i
     }
 }
 
+/* compare data of each chunk in src_head with the matching chunk in
+ * dst_head, set vals[i] to 1 if chunk i differs and 0 otherwise,
+ * and if overwrite is set, replace differing bytes in the destination,
+ * if errs is not NULL, set errs[i] to 1 if chunk i could not be
+ * compared or rewritten and 0 otherwise,
+ * returns 0 on success and -1 if any chunk could not be read */
+static int dsync_compare_chunks(
+    mfu_flist src_list,
+    mfu_flist dst_list,
+    const mfu_file_chunk* src_head,
+    const mfu_file_chunk* dst_head,
+    uint64_t list_count,
+    int* vals,
+    int* errs,
+    int overwrite,
+    mfu_copy_opts_t* copy_opts,
+    uint64_t* count_bytes_read,
+    uint64_t* count_bytes_written,
+    mfu_progress* compare_prog,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file)
+{
+    int rc = 0;
+
+    uint64_t i = 0;
+    if (errs != NULL) {
+        for (i = 0; i < list_count; i++) {
+            errs[i] = 0;
+        }
+    }
+
+    if (options.digest) {
+        /* read source and destination chunks in separate passes
+         * and compare their digests */
+        rc = mfu_file_chunk_list_digest_compare(src_list, dst_list, src_head, dst_head, copy_opts, vals,
+            count_bytes_read, count_bytes_written, compare_prog, mfu_src_file, mfu_dst_file);
+        if (! overwrite) {
+            return rc;
+        }
+
+        /* otherwise fall through to rewrite only those chunks
+         * whose digests differ */
+    }
+
+    /* keep files open and buffers allocated across chunks */
+    mfu_compare_ctx* compare_ctx = mfu_compare_ctx_new(copy_opts, mfu_src_file, mfu_dst_file);
+
+    /* digests already tell us which chunks differ,
+     * so copy those without reading the destination again */
+    compare_ctx->known_differ = options.digest;
+
+    const mfu_file_chunk* src_p = src_head;
+    const mfu_file_chunk* dst_p = dst_head;
+    for (i = 0; i < list_count; i++) {
+        /* skip chunks whose digests already match */
+        if (options.digest && vals[i] == 0) {
+            src_p = src_p->next;
+            dst_p = dst_p->next;
+            continue;
+        }
+
+        /* get offset into file that we should compare (bytes) */
+        off_t offset = (off_t)src_p->offset;
+
+        /* get length of section that we should compare (bytes) */
+        off_t length = (off_t)src_p->length;
+
+        /* get length of file that we should compare (bytes) */
+        off_t filesize = (off_t)src_p->file_size;
+
+        /* compare the contents of the files */
+        int compare_rc = mfu_compare_contents_ctx(compare_ctx, src_p->name, dst_p->name, offset, length, filesize,
+                overwrite, count_bytes_read, count_bytes_written, compare_prog);
+        if (compare_rc == -1) {
+            /* we hit an error while reading */
+            rc = -1;
+            MFU_LOG(MFU_LOG_ERR,
+              "Failed to open, lseek, or read %s and/or %s. Assuming contents are different.",
+                 src_p->name, dst_p->name);
+
+            /* set flag to consider files to be different,
+             * could actually be the same, but we'll draw attention to them this way */
+            compare_rc = 1;
+
+            /* a partial overwrite may have left the destination
+             * chunk in neither its old nor its new state */
+            if (errs != NULL) {
+                errs[i] = 1;
+            }
+        }
+
+        /* record results of comparison */
+        vals[i] = compare_rc;
+
+        /* update pointers for src and dest in linked list */
+        src_p = src_p->next;
+        dst_p = dst_p->next;
+    }
+
+    /* close files and release buffers */
+    mfu_compare_ctx_free(&compare_ctx);
+
+    return rc;
+}
+
 /* given a list of source/destination files to compare, spread file
  * sections to processes to compare in parallel, fill
  * in comparison results in source and dest string maps */
@@ -768,40 +855,11 @@ static void dsync_strmap_compare_data_link_dest(
 
     /* compare bytes for each file section and set flag based on what we find */
     uint64_t i = 0;
-    const mfu_file_chunk* src_p = src_head;
-    const mfu_file_chunk* dst_p = dst_head;
-    for (i = 0; i < list_count; i++) {
-        /* get offset into file that we should compare (bytes) */
-        off_t offset = (off_t)src_p->offset;
-
-        /* get length of section that we should compare (bytes) */
-        off_t length = (off_t)src_p->length;
-        
-        /* get length of file that we should compare (bytes) */
-        off_t filesize = (off_t)src_p->file_size;
-        
-        /* compare the contents of the files */
-        int compare_rc = mfu_compare_contents(src_p->name, dst_p->name, offset, length, filesize,
-                overwrite, copy_opts, count_bytes_read, count_bytes_written, compare_prog,
-                mfu_src_file, mfu_dst_file);
-        if (compare_rc == -1) {
-            /* we hit an error while reading */
-            rc = -1;
-            MFU_LOG(MFU_LOG_ERR,
-              "Failed to open, lseek, or read %s and/or %s. Assuming contents are different.",
-                 src_p->name, dst_p->name);
-
-            /* set flag to consider files to be different,
-             * could actually be the same, but we'll draw attention to them this way */
-            compare_rc = 1;
-        }
-
-        /* record results of comparison */
-        vals[i] = compare_rc;
-
-        /* update pointers for src and dest in linked list */
-        src_p = src_p->next;
-        dst_p = dst_p->next;
+    int compare_rc = dsync_compare_chunks(src_compare_list, link_compare_list, src_head, dst_head,
+        list_count, vals, NULL, overwrite, copy_opts, count_bytes_read, count_bytes_written,
+        compare_prog, mfu_src_file, mfu_dst_file);
+    if (compare_rc != 0) {
+        rc = -1;
     }
 
     /* finalize progress messages */
@@ -842,9 +900,9 @@ static void dsync_strmap_compare_data_link_dest(
 
 static int dsync_strmap_compare_data(
     mfu_flist src_compare_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist dst_compare_list,
-    strmap* dst_map,
+    mfu_statemap* dst_map,
     mfu_flist src_list,
     mfu_flist src_cp_list,
     mfu_flist dst_same_list,
@@ -894,6 +952,9 @@ static int dsync_strmap_compare_data(
      * to be used as input to logical OR to determine state of entire file */
     int* vals = (int*) MFU_MALLOC(list_count * sizeof(int));
 
+    /* flag chunks we failed to compare or rewrite */
+    int* errs = (int*) MFU_MALLOC(list_count * sizeof(int));
+
     /* whether we should overwrite bytes in destination file during compare */
     int overwrite = 1;
     if (options.dry_run || use_hardlinks) {
@@ -908,40 +969,11 @@ static int dsync_strmap_compare_data(
 
     /* compare bytes for each file section and set flag based on what we find */
     uint64_t i = 0;
-    const mfu_file_chunk* src_p = src_head;
-    const mfu_file_chunk* dst_p = dst_head;
-    for (i = 0; i < list_count; i++) {
-        /* get offset into file that we should compare (bytes) */
-        off_t offset = (off_t)src_p->offset;
-
-        /* get length of section that we should compare (bytes) */
-        off_t length = (off_t)src_p->length;
-
-        /* get length of file that we should compare (bytes) */
-        off_t filesize = (off_t)src_p->file_size;
-        
-        /* compare the contents of the files */
-        int compare_rc = mfu_compare_contents(src_p->name, dst_p->name, offset, length, filesize,
-                overwrite, copy_opts, count_bytes_read, count_bytes_written, compare_prog,
-                mfu_src_file, mfu_dst_file);
-        if (compare_rc == -1) {
-            /* we hit an error while reading */
-            rc = -1;
-            MFU_LOG(MFU_LOG_ERR,
-              "Failed to open, lseek, or read %s and/or %s. Assuming contents are different.",
-                 src_p->name, dst_p->name);
-
-            /* set flag to consider files to be different,
-             * could actually be the same, but we'll draw attention to them this way */
-            compare_rc = 1;
-        }
-
-        /* record results of comparison */
-        vals[i] = compare_rc;
-
-        /* update pointers for src and dest in linked list */
-        src_p = src_p->next;
-        dst_p = dst_p->next;
+    int compare_rc = dsync_compare_chunks(src_compare_list, dst_compare_list, src_head, dst_head,
+        list_count, vals, errs, overwrite, copy_opts, count_bytes_read, count_bytes_written,
+        compare_prog, mfu_src_file, mfu_dst_file);
+    if (compare_rc != 0) {
+        rc = -1;
     }
 
     /* finalize progress messages */
@@ -955,6 +987,10 @@ static int dsync_strmap_compare_data(
     /* execute logical OR over chunks for each file */
     mfu_file_chunk_list_lor(src_compare_list, src_head, vals, results);
 
+    /* likewise flag each file with a chunk we failed to compare or rewrite */
+    int* failed = (int*) MFU_MALLOC(size * sizeof(int));
+    mfu_file_chunk_list_lor(src_compare_list, src_head, errs, failed);
+
     /* unpack contents of recv buffer & store results in strmap */
     for (i = 0; i < size; i++) {
         /* lookup name of file based on id to send to strmap updata call */
@@ -972,15 +1008,19 @@ static int dsync_strmap_compare_data(
             dsync_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
             dsync_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
 
-            /* mark file to be deleted from destination, copied from source */
-            if (use_hardlinks) {
+            /* mark file to be deleted from destination, copied from source,
+             * we also replace any file we may have partially rewritten,
+             * which drops it from the metadata update, so that a later
+             * run does not take it to be in sync based on its mtime */
+            if (use_hardlinks || (overwrite && failed[i])) {
                 mfu_flist_file_copy(dst_compare_list, i, dst_remove_list);
                 mfu_flist_file_copy(src_compare_list, i, src_cp_list);
             }
 
             /* Note: File does not need to be truncated for syncing because the size
              * of the dst and src will be the same. It is one of the checks in
-             * dsync_strmap_compare */
+             * dsync_strmap_compare, and dsync_strmap_compare_delta truncates
+             * files it patches before comparing them */
         } else {
             /* update to say contents of the files were found to be the same */
             dsync_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_COMMON);
@@ -994,7 +1034,9 @@ static int dsync_strmap_compare_data(
     }
 
     /* free memory */
+    mfu_free(&failed);
     mfu_free(&results);
+    mfu_free(&errs);
     mfu_free(&vals);
     mfu_file_chunk_list_free(&src_head);
     mfu_file_chunk_list_free(&dst_head);
@@ -1008,6 +1050,103 @@ static int dsync_strmap_compare_data(
     return rc;
 }
 
+/* whether to patch a changed destination file in place, comparing it
+ * chunk by chunk with the source and rewriting only the chunks that
+ * differ, rather than deleting it and copying the whole file again */
+static int dsync_delta_file(
+    mfu_flist dst_list,
+    uint64_t dst_index,
+    const mfu_param_path* link_path,
+    const mfu_copy_opts_t* copy_opts,
+    mfu_file_t* mfu_dst_file)
+{
+    /* files in link-dest are hardlinked rather than modified,
+     * and files smaller than a chunk are cheaper to copy */
+    if (!options.delta || options.dry_run || link_path != NULL ||
+        mfu_flist_file_get_size(dst_list, dst_index) < copy_opts->chunk_size)
+    {
+        return 0;
+    }
+
+    /* rewriting a file in place would also change every other name
+     * linked to it, the walk does not record the link count */
+    struct stat st;
+    const char* name = mfu_flist_file_get_name(dst_list, dst_index);
+    if (mfu_file_lstat(name, &st, mfu_dst_file) != 0 || st.st_nlink > 1) {
+        return 0;
+    }
+
+    return 1;
+}
+
+/* given a list of source and destination files whose size or mtime
+ * differ, set each destination file to the size of its source and
+ * then compare and overwrite chunks that differ in parallel */
+static int dsync_strmap_compare_delta(
+    mfu_flist src_delta_list,
+    mfu_statemap* src_map,
+    mfu_flist dst_delta_list,
+    mfu_statemap* dst_map,
+    mfu_flist src_list,
+    mfu_flist src_cp_list,
+    mfu_flist dst_remove_list,
+    size_t strlen_prefix,
+    mfu_copy_opts_t* copy_opts,
+    uint64_t* count_bytes_read,
+    uint64_t* count_bytes_written,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file)
+{
+    /* lists of files we could resize, destination items
+     * are described with the size of their source, so that
+     * chunks of source and destination files line up */
+    mfu_flist src_patch_list = mfu_flist_subset(src_delta_list);
+    mfu_flist dst_patch_list = mfu_flist_subset(dst_delta_list);
+
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(src_delta_list);
+    for (idx = 0; idx < size; idx++) {
+        uint64_t src_size = mfu_flist_file_get_size(src_delta_list, idx);
+        uint64_t dst_size = mfu_flist_file_get_size(dst_delta_list, idx);
+
+        /* drop data past end of source or extend with a hole,
+         * which will read as zeros during the compare */
+        if (src_size != dst_size) {
+            const char* dst_name = mfu_flist_file_get_name(dst_delta_list, idx);
+            if (mfu_file_truncate(dst_name, (off_t) src_size, mfu_dst_file) != 0) {
+                MFU_LOG(MFU_LOG_ERR, "Failed to truncate `%s' (errno=%d %s), will copy instead",
+                    dst_name, errno, strerror(errno));
+
+                /* fall back to replacing the file */
+                const char* name = mfu_flist_file_get_name(src_delta_list, idx) + strlen_prefix;
+                dsync_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
+                dsync_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
+                mfu_flist_file_copy(src_delta_list, idx, src_cp_list);
+                mfu_flist_file_copy(dst_delta_list, idx, dst_remove_list);
+                continue;
+            }
+        }
+
+        mfu_flist_file_copy(src_delta_list, idx, src_patch_list);
+        mfu_flist_file_copy(dst_delta_list, idx, dst_patch_list);
+        mfu_flist_file_set_size(dst_patch_list, mfu_flist_size(dst_patch_list) - 1, src_size);
+    }
+    mfu_flist_summarize(src_patch_list);
+    mfu_flist_summarize(dst_patch_list);
+
+    /* compare chunks and overwrite those that differ */
+    int rc = dsync_strmap_compare_data(src_patch_list, src_map,
+        dst_patch_list, dst_map, src_list, src_cp_list, MFU_FLIST_NULL,
+        dst_remove_list, strlen_prefix, false, copy_opts,
+        count_bytes_read, count_bytes_written, mfu_src_file, mfu_dst_file
+    );
+
+    mfu_flist_free(&dst_patch_list);
+    mfu_flist_free(&src_patch_list);
+
+    return rc;
+}
+
 /* given the list of files in the destination, the original list of files
  * to be copied to the destination, the list of files in the destination
  * that are the same as the source, and the list of files in link-dest
@@ -1018,7 +1157,7 @@ static void dsync_generate_real_lists(
     size_t src_strlen_prefix,   /* length of prefix string to source directory */
     const mfu_param_path *link_path, /* param path for link-dest directory */
     mfu_flist dst_list,         /* list of files in destination */
-    strmap *dst_map,            /* map each file in destination to its index in dst_list */
+    mfu_statemap* dst_map,            /* map each file in destination to its index in dst_list */
     mfu_flist src_cp_list,      /* list of files to be copied to destination */
     mfu_flist dst_same_list,    /* list of files in destination that are same as in source */
     mfu_flist link_same_list,   /* list of files in link-dest that are same as in source */
@@ -1030,7 +1169,7 @@ static void dsync_generate_real_lists(
     uint64_t idx;
 
     /* create map of item name to index in its respective list */
-    strmap* link_same_map = dsync_strmap_creat(link_same_list, link_path->path);
+    mfu_statemap* link_same_map = dsync_strmap_creat(link_same_list, link_path->path);
 
     /* walk list of files we need to copy from source to destination,
      * and split into set that must actually be copied and set that
@@ -1123,7 +1262,7 @@ static void dsync_generate_real_lists(
     mfu_flist_summarize(dst_remove_list);
 
     /* free the map */
-    strmap_delete(&link_same_map);
+    mfu_statemap_delete(&link_same_map);
 }
 
 /* given a list of source/destination files to compare, spread file
@@ -1166,10 +1305,10 @@ static int dsync_strmap_compare_lite(
     mfu_flist src_compare_list,
     mfu_flist src_cp_list,
     mfu_flist dst_same_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist dst_compare_list,
     mfu_flist dst_remove_list,
-    strmap* dst_map,
+    mfu_statemap* dst_map,
     size_t strlen_prefix,
     bool use_hardlinks)
 {
@@ -1241,102 +1380,1212 @@ static void print_comparison_stats(
     MPI_Allreduce(&bytes_read,    &total_bytes_read,    1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
     MPI_Allreduce(&bytes_written, &total_bytes_written, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
 
-    /* if the verbose option is set print the timing data
-     * report compare count, time, and rate */
-    if (mfu_rank == 0) {
-       /* get the amount of time the compare function took */
-       double time_diff = end_compare - start_compare;
+    /* if the verbose option is set print the timing data
+     * report compare count, time, and rate */
+    if (mfu_rank == 0) {
+       /* get the amount of time the compare function took */
+       double time_diff = end_compare - start_compare;
+
+       /* calculate byte and file rate */
+       double file_rate  = 0.0;
+       double read_rate  = 0.0;
+       double write_rate = 0.0;
+       if (time_diff > 0.0) {
+           file_rate  = ((double)num_files) / time_diff;
+           read_rate  = ((double)total_bytes_read)    / time_diff;
+           write_rate = ((double)total_bytes_written) / time_diff;
+       }
+
+       /* convert uint64 to strings for printing to user */
+       char starttime_str[256];
+       char endtime_str[256];
+
+       struct tm* localstart = localtime(time_started);
+       struct tm cp_localstart = *localstart;
+       struct tm* localend = localtime(time_ended);
+       struct tm cp_localend = *localend;
+
+       strftime(starttime_str, 256, "%b-%d-%Y, %H:%M:%S", &cp_localstart);
+       strftime(endtime_str, 256, "%b-%d-%Y, %H:%M:%S", &cp_localend);
+
+       /* convert read size to units */
+       double read_size_tmp;
+       const char* read_size_units;
+       mfu_format_bytes(total_bytes_read, &read_size_tmp, &read_size_units);
+
+       /* convert write size to units */
+       double write_size_tmp;
+       const char* write_size_units;
+       mfu_format_bytes(total_bytes_written, &write_size_tmp, &write_size_units);
+
+       /* convert read bandwidth to units */
+       double read_rate_tmp;
+       const char* read_rate_units;
+       mfu_format_bw(read_rate, &read_rate_tmp, &read_rate_units);
+
+       /* convert write bandwidth to units */
+       double write_rate_tmp;
+       const char* write_rate_units;
+       mfu_format_bw(write_rate, &write_rate_tmp, &write_rate_units);
+
+       MFU_LOG(MFU_LOG_INFO, "Started   : %s", starttime_str);
+       MFU_LOG(MFU_LOG_INFO, "Completed : %s", endtime_str);
+       MFU_LOG(MFU_LOG_INFO, "Seconds   : %.3lf", time_diff);
+       MFU_LOG(MFU_LOG_INFO, "Items     : %" PRId64, num_files);
+       MFU_LOG(MFU_LOG_INFO, "Item Rate : %lu items in %f seconds (%f items/sec)",
+            num_files, time_diff, file_rate);
+       if (options.contents) {
+           MFU_LOG(MFU_LOG_INFO, "Bytes read   : %.3lf %s (%" PRId64 " bytes)",
+                read_size_tmp, read_size_units, total_bytes_read);
+           MFU_LOG(MFU_LOG_INFO, "Bytes written: %.3lf %s (%" PRId64 " bytes)",
+                write_size_tmp, write_size_units, total_bytes_written);
+           MFU_LOG(MFU_LOG_INFO, "Read Rate    : %.3lf %s (%" PRId64 " bytes in %.3lf seconds)",
+                read_rate_tmp, read_rate_units, total_bytes_read, time_diff);
+           MFU_LOG(MFU_LOG_INFO, "Write Rate   : %.3lf %s (%" PRId64 " bytes in %.3lf seconds)",
+            write_rate_tmp, write_rate_units, total_bytes_written, time_diff);
+       }
+    }
+}
+
+/* loop on the dest map to check for files only in the dst list
+ * and copy to a remove_list for the --sync option */
+static void dsync_only_dst(mfu_statemap* src_map,
+    mfu_statemap* dst_map, mfu_flist dst_list, mfu_flist dst_remove_list)
+{
+    /* iterate over each item in dest map */
+    uint64_t node;
+    mfu_statemap_foreach(dst_map, node) {
+        /* get file name */
+        const char* key = mfu_statemap_key(dst_map, node);
+
+        /* get index of destination file */
+        uint64_t dst_index;
+        int ret = dsync_strmap_item_index(dst_map, key, &dst_index);
+        assert(ret == 0);
+
+        /* get index of source file */
+        uint64_t src_index;
+        ret = dsync_strmap_item_index(src_map, key, &src_index);
+        if (ret) {
+            /* This file only exist in dest */
+            mfu_flist_file_copy(dst_list, dst_index, dst_remove_list);
+        }
+    }
+}
+
+/* bytes read from each of the start, middle, and end of a file
+ * when checking that a destination file matches a moved source file */
+#define DSYNC_RENAME_SAMPLE (64 * 1024)
+
+/* types of records sent to the rank responsible for a directory */
+#define DSYNC_RENAME_VOTE (0)
+#define DSYNC_RENAME_STAT (1)
+
+static uint64_t dsync_unpack_u64(const char** ptr)
+{
+    uint64_t val;
+    memcpy(&val, *ptr, sizeof(val));
+    *ptr += sizeof(val);
+    return val;
+}
+
+static const char* dsync_unpack_str(const char** ptr)
+{
+    const char* str = *ptr;
+    *ptr += strlen(str) + 1;
+    return str;
+}
+
+/* compare the first alen bytes of a to the first blen bytes of b */
+static int dsync_rename_name_cmp(const char* a, size_t alen, const char* b, size_t blen)
+{
+    size_t n = (alen < blen) ? alen : blen;
+    int cmp = memcmp(a, b, n);
+    if (cmp != 0) {
+        return cmp;
+    }
+    if (alen != blen) {
+        return (alen < blen) ? -1 : 1;
+    }
+    return 0;
+}
+
+/* rank responsible for the first len bytes of directory name on side */
+static int dsync_rename_owner(uint64_t side, const char* name, size_t len, int ranks)
+{
+    uint64_t hash = mfu_hash_fnv(MFU_HASH_FNV_INIT, &side, sizeof(side));
+    hash = mfu_hash_fnv(hash, name, len);
+    return (int) (hash % (uint64_t) ranks);
+}
+
+/* return newly allocated path of prefix followed by first len bytes of name */
+static char* dsync_rename_join(const char* prefix, const char* name, size_t len)
+{
+    size_t prefix_len = strlen(prefix);
+    char* path = (char*) MFU_MALLOC(prefix_len + len + 1);
+    memcpy(path, prefix, prefix_len);
+    memcpy(path + prefix_len, name, len);
+    path[prefix_len + len] = '\0';
+    return path;
+}
+
+/* a file or link that exists on only one side */
+typedef struct dsync_rename_item_struct {
+    uint64_t side;       /* 0 if only in source, 1 if only in destination */
+    uint64_t type;       /* mfu_filetype of item */
+    uint64_t size;       /* size in bytes */
+    uint64_t mtime;      /* modification time seconds */
+    uint64_t mtime_nsec; /* modification time nanoseconds */
+    uint64_t rank;       /* rank holding item in copy or remove list */
+    uint64_t index;      /* index of item in that list */
+    const char* name;    /* path relative to top level directory */
+    const char* base;    /* last component of name */
+    int used;            /* whether item has been paired */
+} dsync_rename_item;
+
+/* a source item paired with the destination item it was moved from */
+typedef struct dsync_rename_pair_struct {
+    const dsync_rename_item* src;
+    const dsync_rename_item* dst;
+} dsync_rename_pair;
+
+/* whether two items have the same type, size, and mtime */
+static int dsync_rename_item_same(const dsync_rename_item* x, const dsync_rename_item* y)
+{
+    return (x->type       == y->type &&
+            x->size       == y->size &&
+            x->mtime      == y->mtime &&
+            x->mtime_nsec == y->mtime_nsec);
+}
+
+/* order items by type, size, and mtime, then by last component of name */
+static int dsync_rename_item_cmp(const void* a, const void* b)
+{
+    const dsync_rename_item* x = (const dsync_rename_item*) a;
+    const dsync_rename_item* y = (const dsync_rename_item*) b;
+    if (x->type != y->type) {
+        return (x->type < y->type) ? -1 : 1;
+    }
+    if (x->size != y->size) {
+        return (x->size < y->size) ? -1 : 1;
+    }
+    if (x->mtime != y->mtime) {
+        return (x->mtime < y->mtime) ? -1 : 1;
+    }
+    if (x->mtime_nsec != y->mtime_nsec) {
+        return (x->mtime_nsec < y->mtime_nsec) ? -1 : 1;
+    }
+    int cmp = strcmp(x->base, y->base);
+    if (cmp != 0) {
+        return cmp;
+    }
+    if (x->side != y->side) {
+        return (x->side < y->side) ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+/* send each file and link in list that does not exist on the
+ * other side to the rank responsible for its size and mtime */
+static void dsync_rename_pack_items(
+    mfu_exchange* pack,
+    mfu_flist list,
+    uint64_t side,
+    size_t prefix_len,
+    mfu_statemap* other_map)
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(list);
+    for (idx = 0; idx < size; idx++) {
+        /* directories are matched by their contents */
+        mfu_filetype type = mfu_flist_file_get_type(list, idx);
+        if (type != MFU_TYPE_FILE && type != MFU_TYPE_LINK) {
+            continue;
+        }
+
+        /* skip items that exist on both sides */
+        const char* name = mfu_flist_file_get_name(list, idx) + prefix_len;
+        uint64_t other_index;
+        if (dsync_strmap_item_index(other_map, name, &other_index) == 0) {
+            continue;
+        }
+
+        uint64_t vals[7];
+        vals[0] = side;
+        vals[1] = (uint64_t) type;
+        vals[2] = mfu_flist_file_get_size(list, idx);
+        vals[3] = mfu_flist_file_get_mtime(list, idx);
+        vals[4] = mfu_flist_file_get_mtime_nsec(list, idx);
+        vals[5] = (uint64_t) rank;
+        vals[6] = idx;
+
+        /* items that may match hash to the same rank */
+        uint64_t hash = mfu_hash_fnv(MFU_HASH_FNV_INIT, &vals[1], 4 * sizeof(uint64_t));
+        int dest = (int) (hash % (uint64_t) pack->ranks);
+        mfu_exchange_pack(pack, dest, vals, sizeof(vals));
+        mfu_exchange_pack_str(pack, dest, name, strlen(name));
+    }
+}
+
+/* check that a destination item holds the same data as a source item,
+ * compares link targets, and samples file contents if --contents is set,
+ * returns 1 if the items match */
+static int dsync_rename_verify(
+    const char* src_name,
+    const char* dst_name,
+    const dsync_rename_item* item,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file)
+{
+    if (item->type == MFU_TYPE_LINK) {
+        char src_target[PATH_MAX];
+        char dst_target[PATH_MAX];
+        ssize_t src_len = mfu_file_readlink(src_name, src_target, sizeof(src_target), mfu_src_file);
+        ssize_t dst_len = mfu_file_readlink(dst_name, dst_target, sizeof(dst_target), mfu_dst_file);
+        return (src_len >= 0 && src_len == dst_len &&
+                memcmp(src_target, dst_target, (size_t) src_len) == 0);
+    }
+
+    /* otherwise we trust size and mtime */
+    if (!options.contents || item->size == 0) {
+        return 1;
+    }
+
+    /* use private copies since the open file is tracked in the structure */
+    mfu_file_t src_file = *mfu_src_file;
+    mfu_file_t dst_file = *mfu_dst_file;
+
+    if (mfu_file_open(src_name, O_RDONLY, &src_file) != 0) {
+        return 0;
+    }
+    if (mfu_file_open(dst_name, O_RDONLY, &dst_file) != 0) {
+        mfu_file_close(src_name, &src_file);
+        return 0;
+    }
+
+    /* read a block from the start, middle, and end of each file,
+     * or the whole file once if it is no larger than the three blocks */
+    size_t len = DSYNC_RENAME_SAMPLE;
+    int samples = 3;
+    if (item->size <= 3 * (uint64_t) len) {
+        len = (size_t) item->size;
+        samples = 1;
+    }
+    off_t offsets[3];
+    offsets[0] = 0;
+    offsets[1] = (off_t) ((item->size - len) / 2);
+    offsets[2] = (off_t) (item->size - len);
+
+    char* src_buf = (char*) MFU_MALLOC(len);
+    char* dst_buf = (char*) MFU_MALLOC(len);
+
+    int same = 1;
+    int i;
+    for (i = 0; i < samples && same; i++) {
+        ssize_t src_read = mfu_file_pread(src_name, src_buf, len, offsets[i], &src_file);
+        ssize_t dst_read = mfu_file_pread(dst_name, dst_buf, len, offsets[i], &dst_file);
+        if (src_read != (ssize_t) len || dst_read != (ssize_t) len ||
+            memcmp(src_buf, dst_buf, len) != 0)
+        {
+            same = 0;
+        }
+    }
+
+    mfu_free(&dst_buf);
+    mfu_free(&src_buf);
+
+    mfu_file_close(dst_name, &dst_file);
+    mfu_file_close(src_name, &src_file);
+
+    return same;
+}
+
+/* given items received from all ranks sorted by type, size, mtime,
+ * and name, pair source and destination items that are unambiguous
+ * matches, first by equal last name component, and then if a single
+ * source and destination item remain, returns number of pairs */
+static uint64_t dsync_rename_pair_items(
+    dsync_rename_item* items,
+    uint64_t count,
+    dsync_rename_pair* pairs,
+    const char* src_prefix,
+    const char* dst_prefix,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file)
+{
+    uint64_t npairs = 0;
+    uint64_t start = 0;
+    while (start < count) {
+        /* find range of items with the same type, size, and mtime */
+        uint64_t end = start + 1;
+        while (end < count && dsync_rename_item_same(&items[start], &items[end])) {
+            end++;
+        }
+
+        /* pair items whose last components are equal and unique */
+        uint64_t i = start;
+        while (i < end) {
+            uint64_t j = i + 1;
+            while (j < end && strcmp(items[i].base, items[j].base) == 0) {
+                j++;
+            }
+
+            /* sorted by side within a name, so expect one of each */
+            if (j - i == 2 && items[i].side == 0 && items[i + 1].side == 1) {
+                pairs[npairs].src = &items[i];
+                pairs[npairs].dst = &items[i + 1];
+                items[i].used     = 1;
+                items[i + 1].used = 1;
+                npairs++;
+            }
+            i = j;
+        }
+
+        /* pair what's left over if there is exactly one on each side */
+        dsync_rename_item* src = NULL;
+        dsync_rename_item* dst = NULL;
+        uint64_t src_left = 0;
+        uint64_t dst_left = 0;
+        for (i = start; i < end; i++) {
+            if (items[i].used) {
+                continue;
+            }
+            if (items[i].side == 0) {
+                src = &items[i];
+                src_left++;
+            } else {
+                dst = &items[i];
+                dst_left++;
+            }
+        }
+        if (src_left == 1 && dst_left == 1) {
+            pairs[npairs].src = src;
+            pairs[npairs].dst = dst;
+            src->used = 1;
+            dst->used = 1;
+            npairs++;
+        }
+
+        start = end;
+    }
+
+    /* drop any pairs whose data does not match */
+    uint64_t kept = 0;
+    uint64_t i;
+    for (i = 0; i < npairs; i++) {
+        const dsync_rename_item* src = pairs[i].src;
+        const dsync_rename_item* dst = pairs[i].dst;
+        char* src_name = dsync_rename_join(src_prefix, src->name, strlen(src->name));
+        char* dst_name = dsync_rename_join(dst_prefix, dst->name, strlen(dst->name));
+        if (dsync_rename_verify(src_name, dst_name, src, mfu_src_file, mfu_dst_file)) {
+            pairs[kept] = pairs[i];
+            kept++;
+        }
+        mfu_free(&dst_name);
+        mfu_free(&src_name);
+    }
+
+    return kept;
+}
+
+/* summary of the items below a directory that exists on only one side,
+ * two directories hold the same tree if they have the same counts and sig */
+typedef struct dsync_rename_stat_struct {
+    uint64_t side;    /* 0 if only in source, 1 if only in destination */
+    const char* name; /* path relative to top level directory, NULL if slot is empty */
+    size_t len;       /* length of name, which may not be terminated */
+    uint64_t files;   /* number of items below directory that are not directories */
+    uint64_t dirs;    /* number of directories below directory */
+    uint64_t sig;     /* sum of hashes of relative path and type of items below directory */
+    uint64_t exists;  /* whether directory itself exists on only this side */
+} dsync_rename_stat;
+
+/* open addressing hash table of directory summaries */
+typedef struct dsync_rename_stats_struct {
+    dsync_rename_stat* slots; /* table slots */
+    uint64_t size;            /* number of slots, power of two */
+    uint64_t count;           /* number of slots in use */
+} dsync_rename_stats;
+
+/* return slot holding directory name, or the empty slot where it would go */
+static dsync_rename_stat* dsync_rename_stats_slot(
+    dsync_rename_stat* slots,
+    uint64_t size,
+    uint64_t side,
+    const char* name,
+    size_t len)
+{
+    uint64_t mask = size - 1;
+    uint64_t hash = mfu_hash_fnv(MFU_HASH_FNV_INIT, &side, sizeof(side));
+    uint64_t slot = mfu_hash_fnv(hash, name, len) & mask;
+    while (slots[slot].name != NULL) {
+        dsync_rename_stat* s = &slots[slot];
+        if (s->side == side && s->len == len && memcmp(s->name, name, len) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return &slots[slot];
+}
+
+/* return summary for directory name, adding it if needed */
+static dsync_rename_stat* dsync_rename_stats_get(
+    dsync_rename_stats* stats,
+    uint64_t side,
+    const char* name,
+    size_t len)
+{
+    /* keep the table at most half full */
+    if ((stats->count + 1) * 2 > stats->size) {
+        uint64_t size = (stats->size > 0) ? stats->size * 2 : 1024;
+        dsync_rename_stat* slots = (dsync_rename_stat*) MFU_CALLOC(size, sizeof(dsync_rename_stat));
+        uint64_t i;
+        for (i = 0; i < stats->size; i++) {
+            dsync_rename_stat* s = &stats->slots[i];
+            if (s->name != NULL) {
+                *dsync_rename_stats_slot(slots, size, s->side, s->name, s->len) = *s;
+            }
+        }
+        mfu_free(&stats->slots);
+        stats->slots = slots;
+        stats->size  = size;
+    }
+
+    dsync_rename_stat* s = dsync_rename_stats_slot(stats->slots, stats->size, side, name, len);
+    if (s->name == NULL) {
+        s->side = side;
+        s->name = name;
+        s->len  = len;
+        stats->count++;
+    }
+    return s;
+}
+
+/* add each item in list that does not exist on the other side
+ * to the summary of each of its parent directories */
+static void dsync_rename_add_stats(
+    dsync_rename_stats* stats,
+    mfu_flist list,
+    uint64_t side,
+    size_t prefix_len,
+    mfu_statemap* other_map)
+{
+    uint64_t idx;
+    uint64_t size = mfu_flist_size(list);
+    for (idx = 0; idx < size; idx++) {
+        /* skip items that exist on both sides */
+        const char* name = mfu_flist_file_get_name(list, idx) + prefix_len;
+        uint64_t other_index;
+        if (dsync_strmap_item_index(other_map, name, &other_index) == 0) {
+            continue;
+        }
+
+        /* nothing to do for top level directory */
+        size_t len = strlen(name);
+        if (len == 0) {
+            continue;
+        }
+
+        uint64_t type = (uint64_t) mfu_flist_file_get_type(list, idx);
+        if (type == MFU_TYPE_DIR) {
+            dsync_rename_stat* s = dsync_rename_stats_get(stats, side, name, len);
+            s->exists = 1;
+        }
+
+        /* walk up through parent directories, stopping below top level */
+        size_t p;
+        for (p = len - 1; p > 0; p--) {
+            if (name[p] != '/') {
+                continue;
+            }
+
+            dsync_rename_stat* s = dsync_rename_stats_get(stats, side, name, p);
+            if (type == MFU_TYPE_DIR) {
+                s->dirs++;
+            } else {
+                s->files++;
+            }
+
+            uint64_t hash = mfu_hash_fnv(MFU_HASH_FNV_INIT, name + p, len - p);
+            s->sig += mfu_hash_fnv(hash, &type, sizeof(type));
+        }
+    }
+}
+
+/* order directory summaries by side and name */
+static int dsync_rename_stat_cmp(const void* a, const void* b)
+{
+    const dsync_rename_stat* x = (const dsync_rename_stat*) a;
+    const dsync_rename_stat* y = (const dsync_rename_stat*) b;
+    if (x->side != y->side) {
+        return (x->side < y->side) ? -1 : 1;
+    }
+    return dsync_rename_name_cmp(x->name, x->len, y->name, y->len);
+}
+
+/* a source directory that may have been moved from a destination directory */
+typedef struct dsync_rename_dir_struct {
+    const char* src; /* source directory relative to top level */
+    const char* dst; /* destination directory relative to top level */
+    uint64_t files;  /* number of paired files below both directories */
+    uint64_t dirs;   /* number of directories below source directory */
+    uint64_t sig;    /* summary signature of source directory */
+    int nested;      /* whether parent directories also match */
+} dsync_rename_dir;
+
+/* order directory pairs by destination and then source name */
+static int dsync_rename_dir_cmp(const void* a, const void* b)
+{
+    const dsync_rename_dir* x = (const dsync_rename_dir*) a;
+    const dsync_rename_dir* y = (const dsync_rename_dir*) b;
+    int cmp = strcmp(x->dst, y->dst);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return strcmp(x->src, y->src);
+}
+
+/* order directory pairs by source and then destination name */
+static int dsync_rename_dir_src_cmp(const void* a, const void* b)
+{
+    const dsync_rename_dir* x = (const dsync_rename_dir*) a;
+    const dsync_rename_dir* y = (const dsync_rename_dir*) b;
+    int cmp = strcmp(x->src, y->src);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return strcmp(x->dst, y->dst);
+}
+
+/* look up summary of first len bytes of name in sorted array,
+ * returns NULL if not found */
+static const dsync_rename_stat* dsync_rename_find_stat(
+    const dsync_rename_stat* stats,
+    uint64_t count,
+    uint64_t side,
+    const char* name,
+    size_t len)
+{
+    dsync_rename_stat key;
+    key.side = side;
+    key.name = name;
+    key.len  = len;
+    return (const dsync_rename_stat*) bsearch(&key, stats, (size_t) count,
+        sizeof(dsync_rename_stat), dsync_rename_stat_cmp);
+}
+
+/* look up first len bytes of name in sorted array of names,
+ * returns 1 if found */
+static int dsync_rename_find_name(const char** names, uint64_t count, const char* name, size_t len)
+{
+    uint64_t lo = 0;
+    uint64_t hi = count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        int cmp = dsync_rename_name_cmp(name, len, names[mid], strlen(names[mid]));
+        if (cmp == 0) {
+            return 1;
+        }
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return 0;
+}
+
+/* return 1 if name or one of its parent directories is in sorted array of names */
+static int dsync_rename_covered(const char** names, uint64_t count, const char* name)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    size_t len = strlen(name);
+    size_t p;
+    for (p = 1; p <= len; p++) {
+        if (p == len || name[p] == '/') {
+            if (dsync_rename_find_name(names, count, name, p)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int dsync_strcmp_ptr(const void* a, const void* b)
+{
+    return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+/* vote for each pair of parent directories of a paired source and
+ * destination item that end in the same path components, e.g., if
+ * /a/x/f was moved to /b/x/f, vote for (/b/x, /a/x) and (/b, /a) */
+static void dsync_rename_pack_votes(mfu_exchange* pack, const dsync_rename_pair* pair)
+{
+    const char* src = pair->src->name;
+    const char* dst = pair->dst->name;
+    size_t src_len = strlen(src);
+    size_t dst_len = strlen(dst);
+    while (src_len > 0 && dst_len > 0) {
+        /* find last component of each path */
+        size_t sp = src_len;
+        while (sp > 0 && src[sp - 1] != '/') {
+            sp--;
+        }
+        size_t dp = dst_len;
+        while (dp > 0 && dst[dp - 1] != '/') {
+            dp--;
+        }
+
+        /* stop at the first component that differs */
+        if (src_len - sp != dst_len - dp ||
+            memcmp(src + sp, dst + dp, src_len - sp) != 0)
+        {
+            break;
+        }
+
+        /* strip component and its leading slash,
+         * stop when we reach the top level directory */
+        if (sp < 2 || dp < 2) {
+            break;
+        }
+        src_len = sp - 1;
+        dst_len = dp - 1;
+
+        int dest = dsync_rename_owner(0, src, src_len, pack->ranks);
+        mfu_exchange_pack_u64(pack, dest, DSYNC_RENAME_VOTE);
+        mfu_exchange_pack_str(pack, dest, src, src_len);
+        mfu_exchange_pack_str(pack, dest, dst, dst_len);
+    }
+}
+
+/* rename old_name to new_name, creating missing parent directories
+ * of new_name below the top level directory, which has length
+ * prefix_len, and never replacing an existing item,
+ * returns 0 on success */
+static int dsync_rename_path(
+    const char* old_name,
+    const char* new_name,
+    size_t prefix_len,
+    mfu_file_t* mfu_dst_file)
+{
+    struct stat st;
+    if (mfu_file_lstat(new_name, &st, mfu_dst_file) == 0) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    int rc = mfu_file_rename(old_name, new_name, mfu_dst_file);
+    if (rc != 0 && errno == ENOENT) {
+        /* parent directory may be new in source, these are also
+         * in the copy list, so the copy will set their metadata */
+        char* path = MFU_STRDUP(new_name);
+        char* p;
+        for (p = path + prefix_len + 1; *p != '\0'; p++) {
+            if (*p == '/') {
+                *p = '\0';
+                mfu_file_mkdir(path, S_IRWXU, mfu_dst_file);
+                *p = '/';
+            }
+        }
+        mfu_free(&path);
+
+        rc = mfu_file_rename(old_name, new_name, mfu_dst_file);
+    }
+    return rc;
+}
+
+/* set metadata on a renamed item in the destination to match the source,
+ * meta_list collects a description of each renamed item as it is now */
+static int dsync_rename_sync_meta(
+    mfu_flist src_list,
+    uint64_t src_index,
+    mfu_flist meta_list,
+    const char* dst_name,
+    mfu_file_t* mfu_dst_file)
+{
+    struct stat st;
+    if (mfu_file_lstat(dst_name, &st, mfu_dst_file) != 0) {
+        MFU_LOG(MFU_LOG_ERR, "Failed to stat `%s' lstat() (errno=%d %s)",
+            dst_name, errno, strerror(errno));
+        return -1;
+    }
+
+    /* describe the renamed item as it is in the destination */
+    mfu_flist_file_copy(src_list, src_index, meta_list);
+    uint64_t idx = mfu_flist_size(meta_list) - 1;
+    mfu_flist_file_set_name(meta_list, idx, dst_name);
+    mfu_flist_file_set_mode(meta_list, idx, (uint64_t) st.st_mode);
+    mfu_flist_file_set_uid(meta_list, idx, (uint64_t) st.st_uid);
+    mfu_flist_file_set_gid(meta_list, idx, (uint64_t) st.st_gid);
+    mfu_flist_file_set_atime(meta_list, idx, (uint64_t) st.st_atim.tv_sec);
+    mfu_flist_file_set_atime_nsec(meta_list, idx, (uint64_t) st.st_atim.tv_nsec);
+    mfu_flist_file_set_mtime(meta_list, idx, (uint64_t) st.st_mtim.tv_sec);
+    mfu_flist_file_set_mtime_nsec(meta_list, idx, (uint64_t) st.st_mtim.tv_nsec);
+
+    return mfu_flist_file_sync_meta(src_list, src_index, meta_list, idx, mfu_dst_file);
+}
+
+/* Find items that only exist in the source and items that only exist
+ * in the destination which are likely the same item moved to a new
+ * name, and rename them in the destination rather than deleting and
+ * copying them again.  Files and links are paired when they have the
+ * same size and mtime and either the same last path component or are
+ * the only such items on both sides.  Link targets are compared, and
+ * when --contents is given, blocks sampled from the start, middle,
+ * and end of each file must also match.  A whole directory is renamed
+ * when every file below it is paired with the file at the same
+ * relative path below a destination directory, and both directories
+ * hold the same tree.  Returns new copy and remove lists without the
+ * items that were renamed. */
+static void dsync_rename_items(
+    const mfu_param_path* src_path,
+    const mfu_param_path* dest_path,
+    mfu_statemap* src_map,
+    mfu_statemap* dst_map,
+    mfu_flist src_cp_list,
+    mfu_flist dst_remove_list,
+    mfu_flist* out_cp_list,
+    mfu_flist* out_remove_list,
+    mfu_file_t* mfu_src_file,
+    mfu_file_t* mfu_dst_file)
+{
+    uint64_t i;
+
+    /* get our rank and number of ranks */
+    int rank, ranks;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Detecting items renamed in source");
+    }
 
-       /* calculate byte and file rate */
-       double file_rate  = 0.0;
-       double read_rate  = 0.0;
-       double write_rate = 0.0;
-       if (time_diff > 0.0) {
-           file_rate  = ((double)num_files) / time_diff;
-           read_rate  = ((double)total_bytes_read)    / time_diff;
-           write_rate = ((double)total_bytes_written) / time_diff;
-       }
+    const char* src_prefix = src_path->path;
+    const char* dst_prefix = dest_path->path;
+    size_t src_prefix_len = strlen(src_prefix);
+    size_t dst_prefix_len = strlen(dst_prefix);
+
+    /* send each file and link on only one side to the rank
+     * responsible for its size and mtime */
+    mfu_exchange pack;
+    mfu_exchange_init(&pack, MPI_COMM_WORLD);
+    dsync_rename_pack_items(&pack, src_cp_list, 0, src_prefix_len, dst_map);
+    dsync_rename_pack_items(&pack, dst_remove_list, 1, dst_prefix_len, src_map);
+    size_t items_size;
+    char* items_buf = mfu_exchange_all(&pack, &items_size);
+
+    /* unpack items */
+    uint64_t item_count = 0;
+    const char* ptr = items_buf;
+    while (ptr < items_buf + items_size) {
+        ptr += 7 * sizeof(uint64_t);
+        dsync_unpack_str(&ptr);
+        item_count++;
+    }
+    dsync_rename_item* items = (dsync_rename_item*) MFU_MALLOC(item_count * sizeof(dsync_rename_item));
+    ptr = items_buf;
+    for (i = 0; i < item_count; i++) {
+        dsync_rename_item* item = &items[i];
+        item->side       = dsync_unpack_u64(&ptr);
+        item->type       = dsync_unpack_u64(&ptr);
+        item->size       = dsync_unpack_u64(&ptr);
+        item->mtime      = dsync_unpack_u64(&ptr);
+        item->mtime_nsec = dsync_unpack_u64(&ptr);
+        item->rank       = dsync_unpack_u64(&ptr);
+        item->index      = dsync_unpack_u64(&ptr);
+        item->name       = dsync_unpack_str(&ptr);
+        item->used       = 0;
+
+        const char* base = strrchr(item->name, '/');
+        item->base = (base != NULL) ? base + 1 : item->name;
+    }
 
-       /* convert uint64 to strings for printing to user */
-       char starttime_str[256];
-       char endtime_str[256];
+    /* pair items that were likely moved */
+    qsort(items, (size_t) item_count, sizeof(dsync_rename_item), dsync_rename_item_cmp);
+    dsync_rename_pair* pairs = (dsync_rename_pair*) MFU_MALLOC(item_count / 2 * sizeof(dsync_rename_pair));
+    uint64_t pair_count = dsync_rename_pair_items(items, item_count, pairs,
+        src_prefix, dst_prefix, mfu_src_file, mfu_dst_file);
+
+    /* send votes for directories that may have been moved,
+     * along with summaries of directories on only one side,
+     * each to the rank responsible for the directory */
+    mfu_exchange_init(&pack, MPI_COMM_WORLD);
+    for (i = 0; i < pair_count; i++) {
+        dsync_rename_pack_votes(&pack, &pairs[i]);
+    }
 
-       struct tm* localstart = localtime(time_started);
-       struct tm cp_localstart = *localstart;
-       struct tm* localend = localtime(time_ended);
-       struct tm cp_localend = *localend;
+    dsync_rename_stats local_stats = {NULL, 0, 0};
+    dsync_rename_add_stats(&local_stats, src_cp_list, 0, src_prefix_len, dst_map);
+    dsync_rename_add_stats(&local_stats, dst_remove_list, 1, dst_prefix_len, src_map);
+    for (i = 0; i < local_stats.size; i++) {
+        const dsync_rename_stat* s = &local_stats.slots[i];
+        if (s->name == NULL) {
+            continue;
+        }
+        int dest = dsync_rename_owner(s->side, s->name, s->len, ranks);
+        mfu_exchange_pack_u64(&pack, dest, DSYNC_RENAME_STAT);
+        mfu_exchange_pack_u64(&pack, dest, s->side);
+        mfu_exchange_pack_u64(&pack, dest, s->files);
+        mfu_exchange_pack_u64(&pack, dest, s->dirs);
+        mfu_exchange_pack_u64(&pack, dest, s->sig);
+        mfu_exchange_pack_u64(&pack, dest, s->exists);
+        mfu_exchange_pack_str(&pack, dest, s->name, s->len);
+    }
+    mfu_free(&local_stats.slots);
+
+    size_t dirs_size;
+    char* dirs_buf = mfu_exchange_all(&pack, &dirs_size);
+
+    /* unpack votes and summaries */
+    uint64_t vote_count = 0;
+    uint64_t stat_count = 0;
+    ptr = dirs_buf;
+    while (ptr < dirs_buf + dirs_size) {
+        uint64_t tag = dsync_unpack_u64(&ptr);
+        if (tag == DSYNC_RENAME_VOTE) {
+            dsync_unpack_str(&ptr);
+            dsync_unpack_str(&ptr);
+            vote_count++;
+        } else {
+            ptr += 5 * sizeof(uint64_t);
+            dsync_unpack_str(&ptr);
+            stat_count++;
+        }
+    }
+    dsync_rename_dir* votes = (dsync_rename_dir*) MFU_MALLOC(vote_count * sizeof(dsync_rename_dir));
+    dsync_rename_stat* stats = (dsync_rename_stat*) MFU_MALLOC(stat_count * sizeof(dsync_rename_stat));
+    vote_count = 0;
+    stat_count = 0;
+    ptr = dirs_buf;
+    while (ptr < dirs_buf + dirs_size) {
+        uint64_t tag = dsync_unpack_u64(&ptr);
+        if (tag == DSYNC_RENAME_VOTE) {
+            dsync_rename_dir* v = &votes[vote_count];
+            v->src    = dsync_unpack_str(&ptr);
+            v->dst    = dsync_unpack_str(&ptr);
+            v->files  = 1;
+            v->nested = 0;
+            vote_count++;
+        } else {
+            dsync_rename_stat* s = &stats[stat_count];
+            s->side   = dsync_unpack_u64(&ptr);
+            s->files  = dsync_unpack_u64(&ptr);
+            s->dirs   = dsync_unpack_u64(&ptr);
+            s->sig    = dsync_unpack_u64(&ptr);
+            s->exists = dsync_unpack_u64(&ptr);
+            s->name   = dsync_unpack_str(&ptr);
+            s->len    = strlen(s->name);
+            stat_count++;
+        }
+    }
 
-       strftime(starttime_str, 256, "%b-%d-%Y, %H:%M:%S", &cp_localstart);
-       strftime(endtime_str, 256, "%b-%d-%Y, %H:%M:%S", &cp_localend);
+    /* merge summaries of the same directory from different ranks */
+    qsort(stats, (size_t) stat_count, sizeof(dsync_rename_stat), dsync_rename_stat_cmp);
+    uint64_t merged = 0;
+    for (i = 0; i < stat_count; i++) {
+        if (merged > 0 && dsync_rename_stat_cmp(&stats[merged - 1], &stats[i]) == 0) {
+            dsync_rename_stat* s = &stats[merged - 1];
+            s->files  += stats[i].files;
+            s->dirs   += stats[i].dirs;
+            s->sig    += stats[i].sig;
+            s->exists |= stats[i].exists;
+        } else {
+            stats[merged] = stats[i];
+            merged++;
+        }
+    }
+    stat_count = merged;
+
+    /* count votes for each pair of directories, and send pairs where
+     * every file below the source directory voted for the same
+     * destination directory to the rank responsible for that directory */
+    mfu_exchange_init(&pack, MPI_COMM_WORLD);
+    qsort(votes, (size_t) vote_count, sizeof(dsync_rename_dir), dsync_rename_dir_src_cmp);
+    i = 0;
+    while (i < vote_count) {
+        uint64_t j = i + 1;
+        while (j < vote_count && dsync_rename_dir_src_cmp(&votes[i], &votes[j]) == 0) {
+            j++;
+        }
+        uint64_t files = j - i;
+
+        const char* src = votes[i].src;
+        const char* dst = votes[i].dst;
+        const dsync_rename_stat* s = dsync_rename_find_stat(stats, stat_count, 0, src, strlen(src));
+        if (s != NULL && s->exists && s->files == files) {
+            int dest = dsync_rename_owner(1, dst, strlen(dst), ranks);
+            mfu_exchange_pack_u64(&pack, dest, files);
+            mfu_exchange_pack_u64(&pack, dest, s->dirs);
+            mfu_exchange_pack_u64(&pack, dest, s->sig);
+            mfu_exchange_pack_str(&pack, dest, src, strlen(src));
+            mfu_exchange_pack_str(&pack, dest, dst, strlen(dst));
+        }
 
-       /* convert read size to units */
-       double read_size_tmp;
-       const char* read_size_units;
-       mfu_format_bytes(total_bytes_read, &read_size_tmp, &read_size_units);
+        i = j;
+    }
 
-       /* convert write size to units */
-       double write_size_tmp;
-       const char* write_size_units;
-       mfu_format_bytes(total_bytes_written, &write_size_tmp, &write_size_units);
+    size_t cands_size;
+    char* cands_buf = mfu_exchange_all(&pack, &cands_size);
+
+    /* unpack candidate directory pairs */
+    uint64_t cand_count = 0;
+    ptr = cands_buf;
+    while (ptr < cands_buf + cands_size) {
+        ptr += 3 * sizeof(uint64_t);
+        dsync_unpack_str(&ptr);
+        dsync_unpack_str(&ptr);
+        cand_count++;
+    }
+    dsync_rename_dir* cands = (dsync_rename_dir*) MFU_MALLOC(cand_count * sizeof(dsync_rename_dir));
+    ptr = cands_buf;
+    for (i = 0; i < cand_count; i++) {
+        dsync_rename_dir* c = &cands[i];
+        c->files  = dsync_unpack_u64(&ptr);
+        c->dirs   = dsync_unpack_u64(&ptr);
+        c->sig    = dsync_unpack_u64(&ptr);
+        c->src    = dsync_unpack_str(&ptr);
+        c->dst    = dsync_unpack_str(&ptr);
+        c->nested = 0;
+    }
 
-       /* convert read bandwidth to units */
-       double read_rate_tmp;
-       const char* read_rate_units;
-       mfu_format_bw(read_rate, &read_rate_tmp, &read_rate_units);
+    /* accept a pair if the destination directory holds the same tree
+     * as the source, taking the first source if there are several */
+    qsort(cands, (size_t) cand_count, sizeof(dsync_rename_dir), dsync_rename_dir_cmp);
+    uint64_t accept_count = 0;
+    for (i = 0; i < cand_count; i++) {
+        const dsync_rename_dir* c = &cands[i];
+        if (accept_count > 0 && strcmp(cands[accept_count - 1].dst, c->dst) == 0) {
+            continue;
+        }
+        const dsync_rename_stat* s = dsync_rename_find_stat(stats, stat_count, 1, c->dst, strlen(c->dst));
+        if (s != NULL && s->exists &&
+            s->files == c->files && s->dirs == c->dirs && s->sig == c->sig)
+        {
+            cands[accept_count] = *c;
+            accept_count++;
+        }
+    }
 
-       /* convert write bandwidth to units */
-       double write_rate_tmp;
-       const char* write_rate_units;
-       mfu_format_bw(write_rate, &write_rate_tmp, &write_rate_units);
+    /* ask whether the parents of each accepted pair were also
+     * accepted, in which case we only need to rename the parent */
+    mfu_exchange_init(&pack, MPI_COMM_WORLD);
+    for (i = 0; i < accept_count; i++) {
+        const char* src = cands[i].src;
+        const char* dst = cands[i].dst;
+        const char* src_base = strrchr(src, '/');
+        const char* dst_base = strrchr(dst, '/');
+        size_t src_len = (size_t) (src_base - src);
+        size_t dst_len = (size_t) (dst_base - dst);
+        if (src_len > 0 && dst_len > 0 && strcmp(src_base, dst_base) == 0) {
+            int dest = dsync_rename_owner(1, dst, dst_len, ranks);
+            mfu_exchange_pack_u64(&pack, dest, (uint64_t) rank);
+            mfu_exchange_pack_u64(&pack, dest, i);
+            mfu_exchange_pack_str(&pack, dest, src, src_len);
+            mfu_exchange_pack_str(&pack, dest, dst, dst_len);
+        }
+    }
 
-       MFU_LOG(MFU_LOG_INFO, "Started   : %s", starttime_str);
-       MFU_LOG(MFU_LOG_INFO, "Completed : %s", endtime_str);
-       MFU_LOG(MFU_LOG_INFO, "Seconds   : %.3lf", time_diff);
-       MFU_LOG(MFU_LOG_INFO, "Items     : %" PRId64, num_files);
-       MFU_LOG(MFU_LOG_INFO, "Item Rate : %lu items in %f seconds (%f items/sec)",
-            num_files, time_diff, file_rate);
-       if (options.contents) {
-           MFU_LOG(MFU_LOG_INFO, "Bytes read   : %.3lf %s (%" PRId64 " bytes)",
-                read_size_tmp, read_size_units, total_bytes_read);
-           MFU_LOG(MFU_LOG_INFO, "Bytes written: %.3lf %s (%" PRId64 " bytes)",
-                write_size_tmp, write_size_units, total_bytes_written);
-           MFU_LOG(MFU_LOG_INFO, "Read Rate    : %.3lf %s (%" PRId64 " bytes in %.3lf seconds)",
-                read_rate_tmp, read_rate_units, total_bytes_read, time_diff);
-           MFU_LOG(MFU_LOG_INFO, "Write Rate   : %.3lf %s (%" PRId64 " bytes in %.3lf seconds)",
-            write_rate_tmp, write_rate_units, total_bytes_written, time_diff);
-       }
+    size_t query_size;
+    char* query_buf = mfu_exchange_all(&pack, &query_size);
+
+    /* reply to ranks whose parent pair we accepted */
+    mfu_exchange_init(&pack, MPI_COMM_WORLD);
+    ptr = query_buf;
+    while (ptr < query_buf + query_size) {
+        uint64_t src_rank = dsync_unpack_u64(&ptr);
+        uint64_t index    = dsync_unpack_u64(&ptr);
+        dsync_rename_dir key;
+        key.src = dsync_unpack_str(&ptr);
+        key.dst = dsync_unpack_str(&ptr);
+        if (bsearch(&key, cands, (size_t) accept_count, sizeof(dsync_rename_dir), dsync_rename_dir_cmp) != NULL) {
+            mfu_exchange_pack_u64(&pack, (int) src_rank, index);
+        }
+    }
+    mfu_free(&query_buf);
+
+    size_t reply_size;
+    char* reply_buf = mfu_exchange_all(&pack, &reply_size);
+    ptr = reply_buf;
+    while (ptr < reply_buf + reply_size) {
+        uint64_t index = dsync_unpack_u64(&ptr);
+        cands[index].nested = 1;
+    }
+    mfu_free(&reply_buf);
+
+    /* gather the top most directory pairs to all ranks,
+     * by packing a copy of each for every rank */
+    mfu_exchange_init(&pack, MPI_COMM_WORLD);
+    for (i = 0; i < accept_count; i++) {
+        if (!cands[i].nested) {
+            int r;
+            for (r = 0; r < ranks; r++) {
+                mfu_exchange_pack_str(&pack, r, cands[i].src, strlen(cands[i].src));
+                mfu_exchange_pack_str(&pack, r, cands[i].dst, strlen(cands[i].dst));
+            }
+        }
     }
-}
 
-/* loop on the dest map to check for files only in the dst list
- * and copy to a remove_list for the --sync option */
-static void dsync_only_dst(strmap* src_map,
-    strmap* dst_map, mfu_flist dst_list, mfu_flist dst_remove_list)
-{
-    /* iterate over each item in dest map */
-    const strmap_node* node;
-    strmap_foreach(dst_map, node) {
-        /* get file name */
-        const char* key = strmap_node_key(node);
+    size_t all_bytes;
+    char* all_buf = mfu_exchange_all(&pack, &all_bytes);
 
-        /* get index of destination file */
-        uint64_t dst_index;
-        int ret = dsync_strmap_item_index(dst_map, key, &dst_index);
-        assert(ret == 0);
+    uint64_t dir_count = 0;
+    ptr = all_buf;
+    while (ptr < all_buf + all_bytes) {
+        dsync_unpack_str(&ptr);
+        dsync_unpack_str(&ptr);
+        dir_count++;
+    }
+    const char** dir_srcs = (const char**) MFU_MALLOC(dir_count * sizeof(char*));
+    const char** dir_dsts = (const char**) MFU_MALLOC(dir_count * sizeof(char*));
+    int* renamed = (int*) MFU_CALLOC(dir_count + 1, sizeof(int));
+    ptr = all_buf;
+    for (i = 0; i < dir_count; i++) {
+        dir_srcs[i] = dsync_unpack_str(&ptr);
+        dir_dsts[i] = dsync_unpack_str(&ptr);
+    }
 
-        /* get index of source file */
-        uint64_t src_index;
-        ret = dsync_strmap_item_index(src_map, key, &src_index);
-        if (ret) {
-            /* This file only exist in dest */
-            mfu_flist_file_copy(dst_list, dst_index, dst_remove_list);
+    /* rename directories, spreading them across ranks */
+    for (i = 0; i < dir_count; i++) {
+        if (i % (uint64_t) ranks != (uint64_t) rank) {
+            continue;
+        }
+        char* old_name = dsync_rename_join(dst_prefix, dir_dsts[i], strlen(dir_dsts[i]));
+        char* new_name = dsync_rename_join(dst_prefix, dir_srcs[i], strlen(dir_srcs[i]));
+        if (dsync_rename_path(old_name, new_name, dst_prefix_len, mfu_dst_file) == 0) {
+            MFU_LOG(MFU_LOG_DBG, "Renamed `%s' to `%s'", old_name, new_name);
+            renamed[i] = 1;
+        } else {
+            MFU_LOG(MFU_LOG_WARN, "Failed to rename `%s' to `%s', will copy instead (errno=%d %s)",
+                old_name, new_name, errno, strerror(errno));
+        }
+        mfu_free(&new_name);
+        mfu_free(&old_name);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, renamed, (int) dir_count, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    /* keep names of directories that were renamed, sorted for lookups */
+    uint64_t renamed_dirs = 0;
+    for (i = 0; i < dir_count; i++) {
+        if (renamed[i]) {
+            dir_srcs[renamed_dirs] = dir_srcs[i];
+            dir_dsts[renamed_dirs] = dir_dsts[i];
+            renamed_dirs++;
+        }
+    }
+    qsort(dir_srcs, (size_t) renamed_dirs, sizeof(char*), dsync_strcmp_ptr);
+    qsort(dir_dsts, (size_t) renamed_dirs, sizeof(char*), dsync_strcmp_ptr);
+
+    /* rename remaining paired items, and tell owners of the items
+     * in the copy and remove lists which ones were renamed */
+    uint64_t renamed_files = 0;
+    mfu_exchange_init(&pack, MPI_COMM_WORLD);
+    for (i = 0; i < pair_count; i++) {
+        const dsync_rename_item* src = pairs[i].src;
+        const dsync_rename_item* dst = pairs[i].dst;
+        if (dsync_rename_covered(dir_srcs, renamed_dirs, src->name) ||
+            dsync_rename_covered(dir_dsts, renamed_dirs, dst->name))
+        {
+            continue;
+        }
+
+        char* old_name = dsync_rename_join(dst_prefix, dst->name, strlen(dst->name));
+        char* new_name = dsync_rename_join(dst_prefix, src->name, strlen(src->name));
+        if (dsync_rename_path(old_name, new_name, dst_prefix_len, mfu_dst_file) == 0) {
+            MFU_LOG(MFU_LOG_DBG, "Renamed `%s' to `%s'", old_name, new_name);
+            mfu_exchange_pack_u64(&pack, (int) src->rank, 0);
+            mfu_exchange_pack_u64(&pack, (int) src->rank, src->index);
+            mfu_exchange_pack_u64(&pack, (int) dst->rank, 1);
+            mfu_exchange_pack_u64(&pack, (int) dst->rank, dst->index);
+            renamed_files++;
+        } else {
+            MFU_LOG(MFU_LOG_WARN, "Failed to rename `%s' to `%s', will copy instead (errno=%d %s)",
+                old_name, new_name, errno, strerror(errno));
+        }
+        mfu_free(&new_name);
+        mfu_free(&old_name);
+    }
+
+    size_t drop_size;
+    char* drop_buf = mfu_exchange_all(&pack, &drop_size);
+
+    /* flag items that no longer need to be copied or removed */
+    uint64_t cp_size     = mfu_flist_size(src_cp_list);
+    uint64_t remove_size = mfu_flist_size(dst_remove_list);
+    char* cp_drop     = (char*) MFU_CALLOC(cp_size + 1, sizeof(char));
+    char* remove_drop = (char*) MFU_CALLOC(remove_size + 1, sizeof(char));
+    ptr = drop_buf;
+    while (ptr < drop_buf + drop_size) {
+        uint64_t side  = dsync_unpack_u64(&ptr);
+        uint64_t index = dsync_unpack_u64(&ptr);
+        if (side == 0) {
+            cp_drop[index] = 1;
+        } else {
+            remove_drop[index] = 1;
+        }
+    }
+    mfu_free(&drop_buf);
+
+    /* build new lists without the renamed items, and set metadata
+     * on renamed items to match the source */
+    mfu_flist cp_list     = mfu_flist_subset(src_cp_list);
+    mfu_flist remove_list = mfu_flist_subset(dst_remove_list);
+    mfu_flist meta_list   = mfu_flist_subset(src_cp_list);
+    for (i = 0; i < cp_size; i++) {
+        const char* name = mfu_flist_file_get_name(src_cp_list, i) + src_prefix_len;
+        if (cp_drop[i] || dsync_rename_covered(dir_srcs, renamed_dirs, name)) {
+            char* dst_name = dsync_rename_join(dst_prefix, name, strlen(name));
+            dsync_rename_sync_meta(src_cp_list, i, meta_list, dst_name, mfu_dst_file);
+            mfu_free(&dst_name);
+        } else {
+            mfu_flist_file_copy(src_cp_list, i, cp_list);
+        }
+    }
+    for (i = 0; i < remove_size; i++) {
+        const char* name = mfu_flist_file_get_name(dst_remove_list, i) + dst_prefix_len;
+        if (!remove_drop[i] && !dsync_rename_covered(dir_dsts, renamed_dirs, name)) {
+            mfu_flist_file_copy(dst_remove_list, i, remove_list);
         }
     }
+    mfu_flist_free(&meta_list);
+    mfu_flist_summarize(cp_list);
+    mfu_flist_summarize(remove_list);
+
+    /* report what we renamed, every rank has the list of directories */
+    uint64_t all_renamed_files;
+    MPI_Allreduce(&renamed_files, &all_renamed_files, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) {
+        MFU_LOG(MFU_LOG_INFO, "Renamed %llu directories and %llu files in destination",
+            (unsigned long long) renamed_dirs, (unsigned long long) all_renamed_files);
+    }
+
+    mfu_free(&remove_drop);
+    mfu_free(&cp_drop);
+    mfu_free(&renamed);
+    mfu_free(&dir_dsts);
+    mfu_free(&dir_srcs);
+    mfu_free(&all_buf);
+    mfu_free(&cands);
+    mfu_free(&cands_buf);
+    mfu_free(&stats);
+    mfu_free(&votes);
+    mfu_free(&dirs_buf);
+    mfu_free(&pairs);
+    mfu_free(&items);
+    mfu_free(&items_buf);
+
+    *out_cp_list     = cp_list;
+    *out_remove_list = remove_list;
 }
 
 static int dsync_sync_files(
-    strmap* src_map,
-    strmap* dst_map,
+    mfu_statemap* src_map,
+    mfu_statemap* dst_map,
     const mfu_param_path* src_path,
     const mfu_param_path* dest_path,
     const mfu_param_path* link_path,
@@ -1344,6 +2593,9 @@ static int dsync_sync_files(
     mfu_flist dst_remove_list,
     mfu_flist link_dst_list,
     mfu_flist src_cp_list,
+    mfu_flist src_compare_list,
+    mfu_flist dst_compare_list,
+    int* compare_results,
     mfu_copy_opts_t* copy_opts,
     mfu_file_t* mfu_src_file,
     mfu_file_t* mfu_dst_file)
@@ -1375,35 +2627,68 @@ static int dsync_sync_files(
         dsync_only_dst(src_map, dst_map, dst_list, dst_remove_list);
     }
 
+    /* rename items in the destination that were moved in the source,
+     * rather than deleting them and copying them again */
+    mfu_flist remove_list = dst_remove_list;
+    mfu_flist cp_list     = src_cp_list;
+    if (options.renames) {
+        dsync_rename_items(src_path, dest_path, src_map, dst_map,
+            src_cp_list, dst_remove_list, &cp_list, &remove_list,
+            mfu_src_file, mfu_dst_file);
+    }
+
     /* summarize dst remove list and remove files */
-    mfu_flist_summarize(dst_remove_list);
+    mfu_flist_summarize(remove_list);
 
     /* delete files from destination if needed */
-    uint64_t remove_size = mfu_flist_global_size(dst_remove_list);
+    uint64_t remove_size = mfu_flist_global_size(remove_list);
     if (remove_size > 0) {
         if (rank == 0) {
             MFU_LOG(MFU_LOG_INFO, "Deleting items from destination");
         }
-        mfu_flist_unlink(dst_remove_list, 0, mfu_dst_file);
+        mfu_flist_unlink(remove_list, 0, mfu_dst_file);
     }
 
     /* summarize the src copy list for files
      * that need to be copied into dest directory */
-    mfu_flist_summarize(src_cp_list);
+    mfu_flist_summarize(cp_list);
+
+    /* get number of files whose contents are compared during the copy */
+    uint64_t compare_size = 0;
+    if (src_compare_list != NULL) {
+        compare_size = mfu_flist_global_size(src_compare_list);
+    }
 
     /* copy files from source to destination if needed */
-    uint64_t copy_size = mfu_flist_global_size(src_cp_list);
-    if (copy_size > 0) {
+    uint64_t copy_size = mfu_flist_global_size(cp_list);
+    if (compare_size > 0) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Copying items to destination while comparing contents of %llu items",
+                (unsigned long long) compare_size);
+        }
+        tmp_rc = mfu_flist_copy_compare(cp_list, 1, src_path, dest_path,
+                                        src_compare_list, dst_compare_list, compare_results,
+                                        copy_opts, mfu_src_file, mfu_dst_file);
+        if (tmp_rc < 0) {
+            rc = -1;
+        }
+    } else if (copy_size > 0) {
         if (rank == 0) {
             MFU_LOG(MFU_LOG_INFO, "Copying items to destination");
         }
-        tmp_rc = mfu_flist_copy(src_cp_list, 1, src_path, dest_path, copy_opts,
+        tmp_rc = mfu_flist_copy(cp_list, 1, src_path, dest_path, copy_opts,
                                 mfu_src_file, mfu_dst_file);
         if (tmp_rc < 0) {
             rc = -1;
         }
     }
 
+    /* free lists left after renaming */
+    if (options.renames) {
+        mfu_flist_free(&remove_list);
+        mfu_flist_free(&cp_list);
+    }
+
     if (link_path) {
         /* summarize the link dst list for files 
          * that need to be copied into dest directory */ 
@@ -1429,9 +2714,9 @@ static int dsync_sync_files(
 /* compare entries from src to items in link-dest */
 static int dsync_strmap_compare_link_dest(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist link_list,
-    strmap* link_map,
+    mfu_statemap* link_map,
     mfu_flist link_same_list,
     mfu_copy_opts_t* copy_opts,
     mfu_file_t* mfu_src_file,
@@ -1453,10 +2738,10 @@ static int dsync_strmap_compare_link_dest(
     mfu_flist link_compare_list = mfu_flist_subset(link_list);
 
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
+    uint64_t node;
+    mfu_statemap_foreach(src_map, node) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_statemap_key(src_map, node);
 
         /* get index of source file */
         uint64_t src_index;
@@ -1581,11 +2866,11 @@ static int dsync_strmap_compare_link_dest(
 /* compare entries from src into dst */
 static int dsync_strmap_compare(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist dst_list,
-    strmap* dst_map,
+    mfu_statemap* dst_map,
     mfu_flist link_list,
-    strmap* link_map,
+    mfu_statemap* link_map,
     size_t strlen_prefix,
     mfu_copy_opts_t* copy_opts,
     const mfu_param_path* src_path,
@@ -1621,6 +2906,10 @@ static int dsync_strmap_compare(
     /* list to track files to be deleted from destination */
     mfu_flist dst_remove_list = mfu_flist_subset(dst_list);
 
+    /* lists to track changed files to be patched in place */
+    mfu_flist src_delta_list = mfu_flist_subset(src_list);
+    mfu_flist dst_delta_list = mfu_flist_subset(dst_list);
+
     /* list to track files that are the same in destination and source directories */
     mfu_flist dst_same_list = MFU_FLIST_NULL;
 
@@ -1646,10 +2935,10 @@ static int dsync_strmap_compare(
     strmap* metadata_refresh = strmap_new();
 
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
+    uint64_t node;
+    mfu_statemap_foreach(src_map, node) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_statemap_key(src_map, node);
 
         /* get index of source file */
         uint64_t src_index;
@@ -1762,6 +3051,16 @@ static int dsync_strmap_compare(
         tmp_rc = dsync_strmap_item_state(src_map, key, DCMPF_SIZE, &state);
         assert(tmp_rc == 0);
         if (state == DCMPS_DIFFER) {
+            /* compare chunks of large files and only rewrite those that differ */
+            if (dsync_delta_file(dst_list, dst_index, link_path, copy_opts, mfu_dst_file)) {
+                mfu_flist_file_copy(src_list, src_index, src_delta_list);
+                mfu_flist_file_copy(dst_list, dst_index, dst_delta_list);
+
+                /* patching changes the mtime, so always refresh it */
+                strmap_setf(metadata_refresh, "%llu=%llu", src_index, dst_index);
+                continue;
+            }
+
             /* file size is different, their contents should be different */
             dsync_strmap_item_update(src_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
             dsync_strmap_item_update(dst_map, key, DCMPF_CONTENT, DCMPS_DIFFER);
@@ -1781,6 +3080,16 @@ static int dsync_strmap_compare(
          * we can do this comparison in parallel more effectively.  For
          * now copy these files to the list of files we need to compare. */
 
+        /* without --contents, a change in mtime alone would mean
+         * copying the file again, so patch large files instead */
+        if (!options.contents && mtime_state == DCMPS_DIFFER &&
+            dsync_delta_file(dst_list, dst_index, link_path, copy_opts, mfu_dst_file))
+        {
+            mfu_flist_file_copy(src_list, src_index, src_delta_list);
+            mfu_flist_file_copy(dst_list, dst_index, dst_delta_list);
+            continue;
+        }
+
         /* make a copy of the src and dest files where the data needs
          * to be compared and store in src & dest compare lists */
         mfu_flist_file_copy(src_list, src_index, src_compare_list);
@@ -1790,15 +3099,22 @@ static int dsync_strmap_compare(
     /* summarize lists of files for which we need to compare data contents */
     mfu_flist_summarize(src_compare_list);
     mfu_flist_summarize(dst_compare_list);
+    mfu_flist_summarize(src_delta_list);
+    mfu_flist_summarize(dst_delta_list);
 
     /* initalize total_bytes_read to zero */
     uint64_t total_files         = 0;
     uint64_t total_bytes_read    = 0;
     uint64_t total_bytes_written = 0;
 
+    /* compare contents while copying, rather than first comparing and
+     * then copying, the data of differing files is replaced in place
+     * either way, hardlinks need the result before the copy starts */
+    int stream = (options.stream && options.contents && !options.dry_run && link_path == NULL);
+
     /* compare the contents of the files if we have anything in the compare list */
     uint64_t cmp_global_size = mfu_flist_global_size(src_compare_list);
-    if (cmp_global_size > 0) {
+    if (cmp_global_size > 0 && !stream) {
         total_files = cmp_global_size;
 
         /* do not overwrite files, just compare if hardlinks enabled */
@@ -1840,6 +3156,26 @@ static int dsync_strmap_compare(
         }
     }
 
+    /* patch changed files in place rather than copying them again */
+    uint64_t delta_global_size = mfu_flist_global_size(src_delta_list);
+    if (delta_global_size > 0) {
+        total_files += delta_global_size;
+
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_INFO, "Patching changed data of %llu items",
+                (unsigned long long) delta_global_size);
+        }
+
+        tmp_rc = dsync_strmap_compare_delta(src_delta_list, src_map,
+            dst_delta_list, dst_map, src_list, src_cp_list, dst_remove_list,
+            strlen_prefix, copy_opts, &total_bytes_read, &total_bytes_written,
+            mfu_src_file, mfu_dst_file
+        );
+        if (tmp_rc < 0) {
+            rc = -1;
+        }
+    }
+
     /* wait for all procs to finish before stopping timer */
     MPI_Barrier(MPI_COMM_WORLD);
 
@@ -1888,28 +3224,80 @@ static int dsync_strmap_compare(
             cp_list = src_real_cp_list;
         }
 
+        /* pass along files to compare during the copy */
+        mfu_flist stream_src_list = MFU_FLIST_NULL;
+        mfu_flist stream_dst_list = MFU_FLIST_NULL;
+        int* stream_results = NULL;
+        if (stream) {
+            stream_src_list = src_compare_list;
+            stream_dst_list = dst_compare_list;
+            stream_results  = (int*) MFU_MALLOC(mfu_flist_size(src_compare_list) * sizeof(int));
+        }
+
         /* sync the files that are in the source and destination directories */
         tmp_rc = dsync_sync_files(src_map, dst_map,
             src_path, dest_path, link_path, dst_list, dst_remove_list,
-            link_dst_list, cp_list, copy_opts, mfu_src_file, mfu_dst_file);
+            link_dst_list, cp_list, stream_src_list, stream_dst_list, stream_results,
+            copy_opts, mfu_src_file, mfu_dst_file);
         if (tmp_rc < 0) {
             rc = -1;
         }
 
-        /* NOTE: this will set metadata on any files that were deleted from
-         * the destination and copied fresh from the source a second time,
-         * which is not efficient, but should still be correct */
+        /* record results of comparing contents during the copy */
+        if (stream && cmp_global_size > 0) {
+            uint64_t i;
+            uint64_t size = mfu_flist_size(src_compare_list);
+            for (i = 0; i < size; i++) {
+                /* ignore prefix portion of path to use as key */
+                const char* name = mfu_flist_file_get_name(src_compare_list, i);
+                name += strlen_prefix;
+
+                if (stream_results[i] != 0) {
+                    dsync_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
+                    dsync_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_DIFFER);
+                } else {
+                    dsync_strmap_item_update(src_map, name, DCMPF_CONTENT, DCMPS_COMMON);
+                    dsync_strmap_item_update(dst_map, name, DCMPF_CONTENT, DCMPS_COMMON);
+                }
+            }
+        }
+        mfu_free(&stream_results);
+
+        /* items that were deleted and copied fresh from the source
+         * already have the source metadata, so only fix up the metadata
+         * of items whose data was kept in place */
+        strmap* recopied = strmap_new();
+        uint64_t idx;
+        uint64_t cp_size = mfu_flist_size(src_cp_list);
+        for (idx = 0; idx < cp_size; idx++) {
+            /* remember the item and drop it from the refresh list */
+            const char* key = mfu_flist_file_get_name(src_cp_list, idx) + strlen_prefix;
+            strmap_set(recopied, key, "1");
+
+            uint64_t src_index;
+            tmp_rc = dsync_strmap_item_index(src_map, key, &src_index);
+            if (tmp_rc == 0) {
+                strmap_unsetf(metadata_refresh, "%llu", (unsigned long long) src_index);
+            }
+        }
 
+        /* count items we'll update across all ranks */
+        uint64_t refresh_count = (uint64_t) strmap_size(metadata_refresh);
+        uint64_t refresh_total = 0;
+        MPI_Allreduce(&refresh_count, &refresh_total, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
         if (rank == 0) {
-            MFU_LOG(MFU_LOG_INFO, "Updating timestamps on newly copied files");
+            MFU_LOG(MFU_LOG_INFO, "Updating metadata in place on %llu items",
+                (unsigned long long) refresh_total);
         }
 
-        /* update metadata on files */
-        strmap_foreach(metadata_refresh, node) {
+        /* update ownership, permissions, and timestamps on items
+         * whose data is unchanged or was patched in place */
+        const strmap_node* refresh_node;
+        strmap_foreach(metadata_refresh, refresh_node) {
             /* extract source and destination indices */
             unsigned long long src_i, dst_i;
-            const char* key = strmap_node_key(node);
-            const char* val = strmap_node_value(node);
+            const char* key = strmap_node_key(refresh_node);
+            const char* val = strmap_node_value(refresh_node);
             sscanf(key, "%llu", &src_i);
             sscanf(val, "%llu", &dst_i);
             uint64_t src_index = (uint64_t) src_i;
@@ -1922,10 +3310,57 @@ static int dsync_strmap_compare(
                 rc = -1;
             }
         }
+
+        /* when copying xattrs, update them on items kept in place whose
+         * captured xattrs differ from the source, items with too many
+         * xattrs to capture are compared by reading them from each side */
+        if (copy_opts->copy_xattrs != XATTR_COPY_NONE) {
+            mfu_statemap_foreach(src_map, node) {
+                const char* key = mfu_statemap_key(src_map, node);
+                if (strmap_get(recopied, key) != NULL) {
+                    continue;
+                }
+
+                /* skip items that only exist in the source */
+                uint64_t src_index, dst_index;
+                tmp_rc = dsync_strmap_item_index(dst_map, key, &dst_index);
+                if (tmp_rc != 0) {
+                    continue;
+                }
+                tmp_rc = dsync_strmap_item_index(src_map, key, &src_index);
+                assert(tmp_rc == 0);
+
+                /* items whose type differs were replaced */
+                mode_t src_mode = (mode_t) mfu_flist_file_get_mode(src_list, src_index);
+                mode_t dst_mode = (mode_t) mfu_flist_file_get_mode(dst_list, dst_index);
+                if ((src_mode & S_IFMT) != (dst_mode & S_IFMT)) {
+                    continue;
+                }
+
+                /* skip items whose xattrs already match */
+                size_t src_xsize, dst_xsize;
+                const void* src_xattrs = mfu_flist_file_get_xattrs(src_list, src_index, &src_xsize);
+                const void* dst_xattrs = mfu_flist_file_get_xattrs(dst_list, dst_index, &dst_xsize);
+                if (src_xattrs != NULL && dst_xattrs != NULL &&
+                    mfu_xattrs_match(src_xattrs, src_xsize, dst_xattrs, dst_xsize))
+                {
+                    continue;
+                }
+
+                const char* dst_name = mfu_flist_file_get_name(dst_list, dst_index);
+                tmp_rc = mfu_flist_file_sync_xattrs(src_list, src_index, dst_name,
+                                                    copy_opts, mfu_src_file, mfu_dst_file);
+                if (tmp_rc < 0) {
+                    rc = -1;
+                }
+            }
+        }
+
+        strmap_delete(&recopied);
     }
 
     if (rank == 0) {
-        MFU_LOG(MFU_LOG_INFO, "Completed updating timestamps");
+        MFU_LOG(MFU_LOG_INFO, "Completed updating metadata");
     }
 
     /* done with our list of files for refreshing metadata */
@@ -1938,6 +3373,8 @@ static int dsync_strmap_compare(
     /* free the compare flists */
     mfu_flist_free(&dst_compare_list);
     mfu_flist_free(&src_compare_list);
+    mfu_flist_free(&dst_delta_list);
+    mfu_flist_free(&src_delta_list);
 
     /* free lists used for hardlinks */
     if (link_path) {
@@ -1957,15 +3394,15 @@ static int dsync_strmap_compare(
 }
 
 /* loop on the src map to check the results */
-static void dsync_strmap_check_src(strmap* src_map,
-                                  strmap* dst_map)
+static void dsync_strmap_check_src(mfu_statemap* src_map,
+                                  mfu_statemap* dst_map)
 {
     assert(dsync_option_need_compare(DCMPF_EXIST));
     /* iterate over each item in source map */
-    const strmap_node* node;
-    strmap_foreach(src_map, node) {
+    uint64_t node;
+    mfu_statemap_foreach(src_map, node) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_statemap_key(src_map, node);
         int only_src = 0;
 
         /* get index of source file */
@@ -2044,16 +3481,16 @@ static void dsync_strmap_check_src(strmap* src_map,
 }
 
 /* loop on the dest map to check the results */
-static void dsync_strmap_check_dst(strmap* src_map,
-    strmap* dst_map)
+static void dsync_strmap_check_dst(mfu_statemap* src_map,
+    mfu_statemap* dst_map)
 {
     assert(dsync_option_need_compare(DCMPF_EXIST));
 
     /* iterate over each item in dest map */
-    const strmap_node* node;
-    strmap_foreach(dst_map, node) {
+    uint64_t node;
+    mfu_statemap_foreach(dst_map, node) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_statemap_key(dst_map, node);
         int only_dest = 0;
 
         /* get index of destination file */
@@ -2145,8 +3582,8 @@ static void dsync_strmap_check_dst(strmap* src_map,
 
 /* check the result maps are valid */
 static void dsync_strmap_check(
-    strmap* src_map,
-    strmap* dst_map)
+    mfu_statemap* src_map,
+    mfu_statemap* dst_map)
 {
     dsync_strmap_check_src(src_map, dst_map);
     dsync_strmap_check_dst(src_map, dst_map);
@@ -2240,7 +3677,7 @@ static void dsync_expression_print(
 
 static int dsync_expression_match(
     struct dsync_expression *expression,
-    strmap* map,
+    mfu_statemap* map,
     const char* key)
 {
     int ret;
@@ -2368,7 +3805,7 @@ static void dsync_conjunction_print(
 /* if matched return 1, else return 0 */
 static int dsync_conjunction_match(
     struct dsync_conjunction *conjunction,
-    strmap* map,
+    mfu_statemap* map,
     const char* key)
 {
     struct dsync_expression* expression;
@@ -2456,7 +3893,7 @@ static void dsync_disjunction_print(
 /* if matched return 1, else return 0 */
 static int dsync_disjunction_match(
     struct dsync_disjunction* disjunction,
-    strmap* map,
+    mfu_statemap* map,
     const char* key,
     int is_src)
 {
@@ -2549,19 +3986,19 @@ static void dsync_option_add_comparison(dsync_field field)
 
 static int dsync_output_flist_match(
     struct dsync_output *output,
-    strmap* map,
+    mfu_statemap* map,
     mfu_flist flist,
     mfu_flist new_flist,
     mfu_flist *matched_flist,
     int is_src)
 {
-    const strmap_node* node;
+    uint64_t node;
     struct dsync_conjunction *conjunction;
 
     /* iterate over each item in map */
-    strmap_foreach(map, node) {
+    mfu_statemap_foreach(map, node) {
         /* get file name */
-        const char* key = strmap_node_key(node);
+        const char* key = mfu_statemap_key(map, node);
 
         /* get index of file */
         uint64_t idx;
@@ -2592,9 +4029,9 @@ static int dsync_output_flist_match(
 static int dsync_output_write(
     struct dsync_output *output,
     mfu_flist src_flist,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist dst_flist,
-    strmap* dst_map)
+    mfu_statemap* dst_map)
 {
     int ret = 0;
     mfu_flist new_flist = mfu_flist_subset(src_flist);
@@ -2645,9 +4082,9 @@ static int dsync_output_write(
 
 static int dsync_outputs_write(
     mfu_flist src_list,
-    strmap* src_map,
+    mfu_statemap* src_map,
     mfu_flist dst_list,
-    strmap* dst_map)
+    mfu_statemap* dst_map)
 {
     struct dsync_output* output;
     int ret = 0;
@@ -2998,6 +4435,9 @@ int main(int argc, char **argv)
     /* walk by default because there is no input file option */
     int walk = 1;
 
+    /* whether to capture xattrs while walking the source */
+    int walk_xattrs = 0;
+
     /* By default, show info log messages. */
     /* we back off a level on CIRCLE verbosity since its INFO is verbose */
     CIRCLE_loglevel CIRCLE_debug = CIRCLE_LOG_WARN;
@@ -3023,17 +4463,29 @@ int main(int argc, char **argv)
         {"bufsize",        1, 0, 'B'},
         {"chunksize",      1, 0, 'k'},
         {"xattrs",         1, 0, 'X'},
+        {"walk-xattrs",    0, 0, 'E'},
         {"daos-api",       1, 0, 'y'},
         {"contents",       0, 0, 'c'},
         {"delete",         0, 0, 'D'},
         {"dereference",    0, 0, 'L'},
         {"no-dereference", 0, 0, 'P'},
         {"direct",         0, 0, 's'},
+        {"direct-threshold", 1, 0, 'T'},
         {"open-noatime",   0, 0, 'U'},
         {"output",         1, 0, 'o'}, // undocumented
         {"debug",          0, 0, 'd'}, // undocumented
         {"link-dest",      1, 0, 'l'},
+        {"digest",         0, 0, 'G'},
+        {"digest-cache",   0, 0, 'C'},
+        {"detect-renames", 0, 0, 'N'},
+        {"data-readers",   1, 0, 'r'},
+        {"delta",          0, 0, 'Z'},
+        {"stream",         0, 0, 'A'},
         {"sparse",         0, 0, 'S'},
+        {"preallocate",    0, 0, 'F'},
+#ifdef LUSTRE_SUPPORT
+        {"stripe-bytes",   1, 0, 'W'},
+#endif
         {"progress",       1, 0, 'R'},
         {"verbose",        0, 0, 'v'},
         {"quiet",          0, 0, 'q'},
@@ -3096,6 +4548,9 @@ int main(int argc, char **argv)
                 usage = 1;
             }
             break;
+        case 'E':
+            walk_xattrs = 1;
+            break;
 #ifdef DAOS_SUPPORT
         case 'y':
             if (daos_parse_api_str(optarg, &daos_args->api) != 0) {
@@ -3132,6 +4587,21 @@ int main(int argc, char **argv)
                 MFU_LOG(MFU_LOG_INFO, "Using O_DIRECT");
             }
             break;
+        case 'T':
+            if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS) {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR,
+                            "Failed to parse direct threshold: '%s'", optarg);
+                }
+                usage = 1;
+            } else {
+                copy_opts->direct = true;
+                copy_opts->direct_threshold = (uint64_t)bytes;
+                if(rank == 0) {
+                    MFU_LOG(MFU_LOG_INFO, "Using O_DIRECT for files of at least %llu bytes", bytes);
+                }
+            }
+            break;
         case 'U':
             copy_opts->open_noatime = true;
             if(rank == 0) {
@@ -3141,6 +4611,27 @@ int main(int argc, char **argv)
         case 'l':
             options.link_dest = MFU_STRDUP(optarg);
             break;
+        case 'G':
+            options.digest = 1;
+            options.contents++;
+            break;
+        case 'r':
+            copy_opts->reader_ranks = atoi(optarg);
+            break;
+        case 'C':
+            options.digest = 1;
+            options.contents++;
+            copy_opts->digest_cache = 1;
+            break;
+        case 'N':
+            options.renames = 1;
+            break;
+        case 'Z':
+            options.delta = 1;
+            break;
+        case 'A':
+            options.stream = 1;
+            break;
         case 'o':
             ret = dsync_option_output_parse(optarg, 0);
             if (ret) {
@@ -3153,6 +4644,32 @@ int main(int argc, char **argv)
         case 'S':
             copy_opts->sparse = 1;
             break;
+        case 'F':
+            if (copy_opts->create_opts == NULL) {
+                copy_opts->create_opts = mfu_create_opts_new();
+            }
+            copy_opts->create_opts->preallocate = true;
+            if(rank == 0) {
+                MFU_LOG(MFU_LOG_INFO, "Preallocating space for new files");
+            }
+            break;
+#ifdef LUSTRE_SUPPORT
+        case 'W':
+            if (mfu_abtoull(optarg, &bytes) != MFU_SUCCESS || bytes == 0) {
+                if (rank == 0) {
+                    MFU_LOG(MFU_LOG_ERR,
+                            "Failed to parse stripe bytes: '%s'", optarg);
+                }
+                usage = 1;
+            } else {
+                if (copy_opts->create_opts == NULL) {
+                    copy_opts->create_opts = mfu_create_opts_new();
+                }
+                copy_opts->create_opts->lustre_stripe       = true;
+                copy_opts->create_opts->lustre_stripe_bytes = (uint64_t)bytes;
+            }
+            break;
+#endif
         case 'R':
             mfu_progress_timeout = atoi(optarg);
             break;
@@ -3186,6 +4703,40 @@ int main(int argc, char **argv)
         usage = 1;
     }
 
+    /* check that we leave at least one rank to read the destination */
+    if (copy_opts->reader_ranks < 0 || copy_opts->reader_ranks >= ranks) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Number of data readers must be less than the number of ranks %d: %d invalid",
+                ranks, copy_opts->reader_ranks);
+        }
+        usage = 1;
+    }
+
+    /* items in the destination are only moved if we'd otherwise delete them */
+    if (options.renames && !options.delete) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_WARN, "Ignoring --detect-renames since --delete is not set");
+        }
+        options.renames = 0;
+    }
+
+    /* only comparing contents takes long enough to overlap with the copy */
+    if (options.stream && !options.contents) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_WARN, "Ignoring --stream since --contents is not set");
+        }
+        options.stream = 0;
+    }
+
+    /* streaming compares chunks byte by byte while they are copied,
+     * so it can't use digests */
+    if (options.stream && options.digest) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Cannot combine --stream with --digest or --digest-cache");
+        }
+        usage = 1;
+    }
+
     /* Generate default output */
     if (list_empty(&options.outputs)) {
         /*
@@ -3202,6 +4753,16 @@ int main(int argc, char **argv)
         }
     }
 
+    /* capture the xattrs we will copy during the walks, so we can
+     * tell which items need their xattrs updated by comparing the two
+     * sides, and so we don't list and read them again when copying */
+    if (walk_xattrs || copy_opts->copy_xattrs != XATTR_COPY_NONE) {
+        walk_opts->xattrs = copy_opts->copy_xattrs;
+        if (walk_opts->xattrs == XATTR_COPY_NONE) {
+            walk_opts->xattrs = XATTR_COPY_ALL;
+        }
+    }
+
     /* we should have two arguments left, source and dest paths */
     int numargs = argc - optind;
 
@@ -3288,11 +4849,13 @@ int main(int argc, char **argv)
         }
     }
 
-    /* walk source path */
+    /* walk source path, only data readers read the source */
     if (rank == 0) {
         MFU_LOG(MFU_LOG_INFO, "Walking source path");
     }
+    walk_opts->reader_ranks = copy_opts->reader_ranks;
     mfu_flist_walk_param_paths(1, srcpath, walk_opts, flist_tmp_src, mfu_src_file);
+    walk_opts->reader_ranks = 0;
 
     /* check that we actually got something so that we don't delete
      * an entire target directory because of a typo on the source dir */
@@ -3315,6 +4878,16 @@ int main(int argc, char **argv)
      * We never dereference the destination */
     int tmp_dereference = walk_opts->dereference;
     walk_opts->dereference = 0;
+
+    /* capture xattrs of destination items with the same filter as the
+     * source when we copy xattrs or compare ACLs, so both can be
+     * compared without reading them again from each item */
+    attr_copy_t tmp_xattrs = walk_opts->xattrs;
+    if (copy_opts->copy_xattrs == XATTR_COPY_NONE &&
+        ! dsync_option_need_compare(DCMPF_ACL))
+    {
+        walk_opts->xattrs = XATTR_COPY_NONE;
+    }
     if (rank == 0) {
         MFU_LOG(MFU_LOG_INFO, "Walking destination path");
     }
@@ -3325,11 +4898,13 @@ int main(int argc, char **argv)
         if (rank == 0) {
             MFU_LOG(MFU_LOG_INFO, "Walking link-dest path");
         }
+        walk_opts->xattrs = XATTR_COPY_NONE;
         mfu_flist_walk_param_paths(1, linkpath, walk_opts, flist_tmp_link, mfu_dst_file);
     }
 
-    /* reset the dereference flag */
+    /* reset the dereference and xattrs flags */
     walk_opts->dereference = tmp_dereference;
+    walk_opts->xattrs = tmp_xattrs;
 
     /* store src and dest path strings */
     const char* path_src = srcpath->path;
@@ -3357,9 +4932,9 @@ int main(int argc, char **argv)
     }
 
     /* map each file name to its index and its comparison state */
-    strmap* map_src = dsync_strmap_creat(flist_src, path_src);
-    strmap* map_dst = dsync_strmap_creat(flist_dst, path_dst);
-    strmap* map_link = NULL;
+    mfu_statemap* map_src = dsync_strmap_creat(flist_src, path_src);
+    mfu_statemap* map_dst = dsync_strmap_creat(flist_dst, path_dst);
+    mfu_statemap* map_link = NULL;
     if (options.link_dest != NULL) {
         map_link = dsync_strmap_creat(flist_link, path_link);
     }
@@ -3372,10 +4947,10 @@ int main(int argc, char **argv)
     }
 
     /* free maps of file names to comparison state info */
-    strmap_delete(&map_src);
-    strmap_delete(&map_dst);
+    mfu_statemap_delete(&map_src);
+    mfu_statemap_delete(&map_dst);
     if (options.link_dest != NULL) {
-        strmap_delete(&map_link);
+        mfu_statemap_delete(&map_link);
     }
 
     /* free file lists */
@@ -130,13 +130,17 @@ static void print_usage(void)
 {
     printf("\n");
     printf("Usage: dtar [options] <source ...>\n");
+    printf("       dtar [options] -x|-t -f <archive> [member ...]\n");
     printf("\n");
     printf("Options:\n");
     printf("  -c, --create            - create archive\n");
+    printf("  -r, --append            - add items that are not in archive\n");
+    printf("  -u, --update            - add items that are not in archive or that changed\n");
     printf("  -x, --extract           - extract archive\n");
+    printf("  -t, --list              - list archive\n");
     printf("  -f, --file <FILE>       - specify archive file\n");
     printf("  -C, --chdir <DIR>       - change directory to DIR before executing\n");
-//    printf("  -j, --compress          - compress archive\n");
+    printf("  -j, --compress          - compress archive with bzip2\n");
 //    printf("  -p, --preserve          - preserve attributes\n");
     printf("      --preserve-owner    - preserve owner/group (default effective uid/gid)\n");
     printf("      --preserve-times    - preserve atime/mtime (default current time)\n");
@@ -181,16 +185,21 @@ int main(int argc, char** argv)
 
     int     opts_help     = 0;
     int     opts_create   = 0;
+    int     opts_append   = 0;
+    int     opts_update   = 0;
     int     opts_extract  = 0;
-    int     opts_compress = 0;
+    int     opts_list     = 0;
     char*   opts_tarfile  = NULL;
     char*   opts_chdir    = NULL;
 
     int option_index = 0;
     static struct option long_options[] = {
         {"create",    0, 0, 'c'},
+        {"append",    0, 0, 'r'},
+        {"update",    0, 0, 'u'},
         {"extract",   0, 0, 'x'},
-        //{"compress",  0, 0, 'j'},
+        {"list",      0, 0, 't'},
+        {"compress",  0, 0, 'j'},
         {"file",      1, 0, 'f'},
         {"chdir",     1, 0, 'C'},
         {"preserve",  0, 0, 'p'},
@@ -217,7 +226,7 @@ int main(int argc, char** argv)
     int usage = 0;
     while (1) {
         int c = getopt_long(
-                    argc, argv, "cxf:C:pb:k:vqh",
+                    argc, argv, "cruxtjf:C:pb:k:vqh",
                     long_options, &option_index
                 );
 
@@ -230,9 +239,18 @@ int main(int argc, char** argv)
             case 'c':
                 opts_create = 1;
                 break;
+            case 'r':
+                opts_append = 1;
+                break;
+            case 'u':
+                opts_update = 1;
+                break;
             case 'x':
                 opts_extract = 1;
                 break;
+            case 't':
+                opts_list = 1;
+                break;
             case 'f':
                 opts_tarfile = MFU_STRDUP(optarg);
                 break;
@@ -240,7 +258,7 @@ int main(int argc, char** argv)
                 opts_chdir = MFU_STRDUP(optarg);
                 break;
             case 'j':
-                opts_compress = 1;
+                archive_opts->compress = true;
                 break;
             case 'p':
                 archive_opts->preserve = true;
@@ -287,6 +305,13 @@ int main(int argc, char** argv)
                                 "Failed to parse chunk size: '%s'", optarg);
                     }
                     usage = 1;
+                } else if (bytes > MFU_ARCHIVE_CHUNK_MAX) {
+                    if (rank == 0) {
+                        MFU_LOG(MFU_LOG_ERR,
+                                "Chunk size must be at most %llu bytes: '%s'",
+                                (unsigned long long) MFU_ARCHIVE_CHUNK_MAX, optarg);
+                    }
+                    usage = 1;
                 } else {
                     archive_opts->chunk_size = (size_t) bytes;
                 }
@@ -335,16 +360,39 @@ int main(int argc, char** argv)
         usage = 1;
     }
 
-    if (!opts_create && !opts_extract && !opts_help) {
+    int modes = opts_create + opts_append + opts_update + opts_extract + opts_list;
+    if (modes == 0 && !opts_help) {
         if (rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "One of extract(x) or create(c) needs to be specified");
+            MFU_LOG(MFU_LOG_ERR, "One of extract(x), list(t), create(c), append(r), or update(u) needs to be specified");
         }
         usage = 1;
     }
 
-    if (opts_create && opts_extract) {
+    if (modes > 1) {
+        if (rank == 0) {
+            MFU_LOG(MFU_LOG_ERR, "Only one of extraction(x), list(t), create(c), append(r), or update(u) can be specified");
+        }
+        usage = 1;
+    }
+
+    /* appending and updating write to an existing archive,
+     * otherwise they work like creating one */
+    if (opts_append || opts_update) {
+        if (archive_opts->compress) {
+            if (rank == 0) {
+                MFU_LOG(MFU_LOG_ERR, "Cannot append to a compressed archive(j)");
+            }
+            usage = 1;
+        }
+        archive_opts->append = true;
+        archive_opts->update = (opts_update != 0);
+        opts_create = 1;
+    }
+
+    /* when listing or extracting selected members, we need the archive file */
+    if ((opts_list || (opts_extract && optind < argc)) && opts_tarfile == NULL) {
         if (rank == 0) {
-            MFU_LOG(MFU_LOG_ERR, "Only one of extraction(x) or create(c) can be specified");
+            MFU_LOG(MFU_LOG_ERR, "Must specify a file name(-f)");
         }
         usage = 1;
     }
@@ -410,7 +458,8 @@ int main(int argc, char** argv)
 
         /* if we have an existing archive, it is deleted in check_archive so that we don't
          * walk it to be included as an entry of the archive itself in the target archive
-         * happens to be in the directory we are walking */
+         * happens to be in the directory we are walking, when appending, the archive is
+         * kept and skipped while comparing walked items to its entries */
 
         /* check that source and destination are okay */
         int valid;
@@ -440,25 +489,6 @@ int main(int argc, char** argv)
         /* create the archive file */
         ret = mfu_flist_archive_create(flist, opts_tarfile, numpaths, paths, &cwd_param, archive_opts);
 
-#if 0
-        /* compress archive file */
-        if (opts_compress) {
-            struct stat st;
-            char fname[50];
-            char fname1[50];
-            strncpy(fname1, opts_tarfile, 50);
-            strncpy(fname, opts_tarfile, 50);
-            if ((mfu_file_stat(strcat(fname, ".bz2"), &st, mfu_src_file) == 0)) {
-                if (rank == 0) {
-                    MFU_LOG(MFU_LOG_INFO, "Output file already exists: '%s'", fname);
-                }
-                exit(0);
-            }
-            dbz2_compress(opts_blocksize, opts_tarfile, opts_memory);
-            remove(fname1);
-        }
-#endif
-
         /* free the file list */
         mfu_flist_free(&flist);
 
@@ -466,28 +496,28 @@ int main(int argc, char** argv)
         mfu_param_path_free_all(numpaths, paths);
         mfu_param_path_free(&destpath);
         mfu_free(&paths);
-    } else if (opts_extract) {
-        char* tarfile = opts_tarfile;
-#if 0
-        if (opts_compress) {
-            char fname[50];
-            char fname_out[50];
-            strncpy(fname, opts_tarfile, 50);
-            strncpy(fname_out, opts_tarfile, 50);
-            size_t len = strlen(fname_out);
-            fname_out[len - 4] = '\0';
-            struct stat st;
-            if ((mfu_file_stat(fname_out, &st, mfu_src_file) == 0)) {
-                if (rank == 0) {
-                    MFU_LOG(MFU_LOG_ERR, "Output file already exists '%s'", fname_out);
-                }
-                exit(0);
+    } else if (opts_extract || opts_list) {
+        /* record names or patterns of members to extract or list,
+         * drop trailing slashes and leading "./" to match names in archive */
+        archive_opts->member_count = (uint64_t) numpaths;
+        archive_opts->members = (char**) MFU_MALLOC(numpaths * sizeof(char*));
+        int i;
+        for (i = 0; i < numpaths; i++) {
+            const char* member = pathlist[i];
+            while (strncmp(member, "./", 2) == 0) {
+                member += 2;
             }
-            //decompress(fname, fname_out);
-            remove(fname);
-            tarfile = fname_out;
+            char* name = MFU_STRDUP(member);
+            size_t len = strlen(name);
+            while (len > 1 && name[len - 1] == '/') {
+                name[--len] = '\0';
+            }
+            archive_opts->members[i] = name;
         }
-#endif
+        archive_opts->list = (opts_list != 0);
+
+        /* compressed archives are detected and decompressed automatically */
+        char* tarfile = opts_tarfile;
         ret = mfu_flist_archive_extract(tarfile, &cwd_param, archive_opts);
     } else {
         if (rank == 0) {
@@ -420,3 +420,52 @@ test_10()
 }
 
 run_test 10 "Same, extras and diff comparison"
+
+test_11()
+{
+	# same size and mtime, contents differ in the last byte
+	dd if=/dev/urandom of=$TEST_SRC/$tfile bs=1k count=512 2>/dev/null
+	cp $TEST_SRC/$tfile $TEST_DST/$tfile
+	printf 'x' | dd of=$TEST_DST/$tfile bs=1 seek=524287 conv=notrunc 2>/dev/null
+	touch -r $TEST_SRC/$tfile $TEST_DST/$tfile
+	dd if=/dev/urandom of=$TEST_SRC/same_${tfile} bs=1k count=512 2>/dev/null
+	cp -p $TEST_SRC/same_${tfile} $TEST_DST/same_${tfile}
+	cmp -s $TEST_SRC/$tfile $TEST_DST/$tfile \
+		&& error "test file was not changed"
+	$DCMP --digest --chunksize 64KB $TEST_DST $TEST_SRC \
+		-o CONTENT=DIFFER:$OUTPUT_FILE
+	in_flist $OUTPUT_FILE $TEST_SRC/$tfile \
+		|| error "$TEST_SRC/$tfile is not printed"
+	in_flist $OUTPUT_FILE $TEST_SRC/same_${tfile} \
+		&& error "$TEST_SRC/same_${tfile} is printed"
+	return 0
+}
+run_test 11 "check CONTENT = DIFFER with --digest"
+
+test_12()
+{
+	# one small file of a single chunk, and one file with several
+	# chunks whose last chunk differs
+	echo "aaaa" > $TEST_SRC/$tfile
+	echo "bbbb" > $TEST_DST/$tfile
+	touch -r $TEST_SRC/$tfile $TEST_DST/$tfile
+	dd if=/dev/urandom of=$TEST_SRC/big_${tfile} bs=1k count=512 2>/dev/null
+	cp $TEST_SRC/big_${tfile} $TEST_DST/big_${tfile}
+	printf 'x' | dd of=$TEST_DST/big_${tfile} bs=1 seek=524287 conv=notrunc 2>/dev/null
+	touch -r $TEST_SRC/big_${tfile} $TEST_DST/big_${tfile}
+
+	# every file contributes at least one chunk to the sample,
+	# so the difference in a single chunk file is always found
+	$DCMP --sample 0.01 --chunksize 64KB $TEST_DST $TEST_SRC \
+		-o CONTENT=DIFFER:$OUTPUT_FILE
+	in_flist $OUTPUT_FILE $TEST_SRC/$tfile \
+		|| error "$TEST_SRC/$tfile is not printed with --sample 0.01"
+
+	# sampling every chunk finds the difference anywhere in a file
+	$DCMP --sample 1 --chunksize 64KB $TEST_DST $TEST_SRC \
+		-o CONTENT=DIFFER:$OUTPUT_FILE
+	in_flist $OUTPUT_FILE $TEST_SRC/big_${tfile} \
+		|| error "$TEST_SRC/big_${tfile} is not printed with --sample 1"
+	return 0
+}
+run_test 12 "check CONTENT = DIFFER with --sample"
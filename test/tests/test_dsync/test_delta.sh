@@ -0,0 +1,79 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dsync --delta patches changed files in place
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DSYNC_TEST_BIN=${DSYNC_TEST_BIN:-${1}}
+DSYNC_SRC_DIR=${DSYNC_SRC_DIR:-${2}}
+DSYNC_DEST_DIR=${DSYNC_DEST_DIR:-${3}}
+
+echo "Using dsync binary at: $DSYNC_TEST_BIN"
+echo "Using src directory at: $DSYNC_SRC_DIR"
+echo "Using dest directory at: $DSYNC_DEST_DIR"
+
+SRC=$DSYNC_SRC_DIR/delta
+DEST=$DSYNC_DEST_DIR/delta
+
+function check()
+{
+	local result=$1
+	local msg=$2
+
+	if [ "$result" -eq 0 ]; then
+		echo "PASSED $msg"
+	else
+		echo "FAILED $msg"
+		exit 1
+	fi
+}
+
+# Create the source
+echo Preparing Source
+rm -rf $SRC $DEST
+mkdir -p $SRC
+dd if=/dev/urandom of=$SRC/modified bs=1M count=8 2>/dev/null
+dd if=/dev/urandom of=$SRC/appended bs=1M count=4 2>/dev/null
+dd if=/dev/urandom of=$SRC/truncated bs=1M count=4 2>/dev/null
+
+$DSYNC_TEST_BIN --quiet --chunksize 1MB $SRC $DEST
+diff -r $SRC $DEST
+check $? "initial sync"
+
+modified_ino=$(stat -c %i $DEST/modified)
+appended_ino=$(stat -c %i $DEST/appended)
+truncated_ino=$(stat -c %i $DEST/truncated)
+
+# Change a few bytes in the middle of one file, append to another,
+# and shrink a third, wait so the new mtimes differ
+sleep 1
+printf 'delta' | dd of=$SRC/modified bs=1 seek=5000000 conv=notrunc 2>/dev/null
+dd if=/dev/urandom of=$SRC/appended bs=1M count=1 seek=4 conv=notrunc 2>/dev/null
+truncate -s 3000000 $SRC/truncated
+
+$DSYNC_TEST_BIN --quiet --chunksize 1MB --delta $SRC $DEST
+diff -r $SRC $DEST
+check $? "sync with --delta"
+
+test "$(stat -c %i $DEST/modified)" = "$modified_ino"
+check $? "modified file patched in place"
+
+test "$(stat -c %i $DEST/appended)" = "$appended_ino"
+check $? "appended file patched in place"
+
+test "$(stat -c %i $DEST/truncated)" = "$truncated_ino"
+check $? "truncated file patched in place"
+
+test "$(stat -c %Y $SRC/modified)" = "$(stat -c %Y $DEST/modified)"
+check $? "mtime of patched file updated"
+
+# Clean up
+rm -rf $SRC $DEST
+
+exit 0
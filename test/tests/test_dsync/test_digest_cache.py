@@ -0,0 +1,15 @@
+#!/usr/bin/env python2
+import subprocess
+
+# change paths here for bash script as necessary
+mpifu_path     = "~/mpifileutils/test/tests/test_dsync/test_digest_cache.sh"
+
+# vars in bash script
+dsync_test_bin   = "/root/mpifileutils/install/bin/dsync"
+dsync_src_dir    = "/mnt/lustre"
+dsync_dest_dir   = "/mnt/lustre2"
+
+def test_digest_cache():
+        p = subprocess.Popen(["%s %s %s %s" % (mpifu_path, dsync_test_bin,
+          dsync_src_dir, dsync_dest_dir)], shell=True,
+          executable="/bin/bash").communicate()
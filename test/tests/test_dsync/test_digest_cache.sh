@@ -0,0 +1,77 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dsync --digest-cache caches chunk digests in an
+#   xattr and does not trust them once a file has been rewritten
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DSYNC_TEST_BIN=${DSYNC_TEST_BIN:-${1}}
+DSYNC_SRC_DIR=${DSYNC_SRC_DIR:-${2}}
+DSYNC_DEST_DIR=${DSYNC_DEST_DIR:-${3}}
+
+echo "Using dsync binary at: $DSYNC_TEST_BIN"
+echo "Using src directory at: $DSYNC_SRC_DIR"
+echo "Using dest directory at: $DSYNC_DEST_DIR"
+
+DIGEST_XATTR="user.mfu.digest"
+
+function check()
+{
+	local result=$1
+	local msg=$2
+
+	if [ "$result" -eq 0 ]; then
+		echo "PASSED $msg"
+	else
+		echo "FAILED $msg"
+		exit 1
+	fi
+}
+
+# Create the source
+echo Preparing Source
+rm -rf $DSYNC_SRC_DIR/digest_cache $DSYNC_DEST_DIR/digest_cache
+mkdir -p $DSYNC_SRC_DIR/digest_cache
+dd if=/dev/urandom of=$DSYNC_SRC_DIR/digest_cache/aaa bs=1M count=8 2>/dev/null
+dd if=/dev/urandom of=$DSYNC_SRC_DIR/digest_cache/bbb bs=1k count=5 2>/dev/null
+
+# The first sync copies everything
+$DSYNC_TEST_BIN --quiet --digest-cache $DSYNC_SRC_DIR/digest_cache $DSYNC_DEST_DIR/digest_cache
+diff -r $DSYNC_SRC_DIR/digest_cache $DSYNC_DEST_DIR/digest_cache
+check $? "initial sync"
+
+# A second sync compares both sides and caches their digests
+$DSYNC_TEST_BIN --quiet --digest-cache $DSYNC_SRC_DIR/digest_cache $DSYNC_DEST_DIR/digest_cache
+getfattr --absolute-names -n $DIGEST_XATTR $DSYNC_SRC_DIR/digest_cache/aaa > /dev/null 2>&1
+if [ $? -ne 0 ]; then
+	echo "SKIPPED cache checks, file system does not keep $DIGEST_XATTR"
+	rm -rf $DSYNC_SRC_DIR/digest_cache $DSYNC_DEST_DIR/digest_cache
+	exit 0
+fi
+getfattr --absolute-names -n $DIGEST_XATTR $DSYNC_DEST_DIR/digest_cache/aaa > /dev/null 2>&1
+check $? "digests cached on both sides"
+
+# Rewrite one block of the source without changing its size or mtime,
+# the cached digests describe the old data and must not be used
+touch -r $DSYNC_SRC_DIR/digest_cache/aaa $DSYNC_SRC_DIR/digest_cache/aaa.mtime
+dd if=/dev/urandom of=$DSYNC_SRC_DIR/digest_cache/aaa bs=4k count=1 seek=100 conv=notrunc 2>/dev/null
+touch -r $DSYNC_SRC_DIR/digest_cache/aaa.mtime $DSYNC_SRC_DIR/digest_cache/aaa
+rm -f $DSYNC_SRC_DIR/digest_cache/aaa.mtime
+
+$DSYNC_TEST_BIN --quiet --digest-cache $DSYNC_SRC_DIR/digest_cache $DSYNC_DEST_DIR/digest_cache
+cmp $DSYNC_SRC_DIR/digest_cache/aaa $DSYNC_DEST_DIR/digest_cache/aaa
+check $? "rewritten file with same size and mtime is copied"
+
+cmp $DSYNC_SRC_DIR/digest_cache/bbb $DSYNC_DEST_DIR/digest_cache/bbb
+check $? "unchanged file is intact"
+
+# Clean up
+rm -rf $DSYNC_SRC_DIR/digest_cache $DSYNC_DEST_DIR/digest_cache
+
+exit 0
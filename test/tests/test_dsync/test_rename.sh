@@ -0,0 +1,76 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   A test to check that dsync --detect-renames renames files and
+#   directories that were moved in the source rather than copying them
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DSYNC_TEST_BIN=${DSYNC_TEST_BIN:-${1}}
+DSYNC_SRC_DIR=${DSYNC_SRC_DIR:-${2}}
+DSYNC_DEST_DIR=${DSYNC_DEST_DIR:-${3}}
+
+echo "Using dsync binary at: $DSYNC_TEST_BIN"
+echo "Using src directory at: $DSYNC_SRC_DIR"
+echo "Using dest directory at: $DSYNC_DEST_DIR"
+
+SRC=$DSYNC_SRC_DIR/rename
+DEST=$DSYNC_DEST_DIR/rename
+
+function check()
+{
+	local result=$1
+	local msg=$2
+
+	if [ "$result" -eq 0 ]; then
+		echo "PASSED $msg"
+	else
+		echo "FAILED $msg"
+		exit 1
+	fi
+}
+
+# Create the source
+echo Preparing Source
+rm -rf $SRC $DEST
+mkdir -p $SRC/dir/sub
+for name in aaa bbb sub/ccc; do
+	dd if=/dev/urandom of=$SRC/dir/$name bs=1k count=64 2>/dev/null
+done
+dd if=/dev/urandom of=$SRC/file bs=1k count=16 2>/dev/null
+
+$DSYNC_TEST_BIN --quiet $SRC $DEST
+diff -r $SRC $DEST
+check $? "initial sync"
+
+# remember the inodes of the destination items before we move them
+dir_ino=$(stat -c %i $DEST/dir)
+file_ino=$(stat -c %i $DEST/file)
+
+# Move a directory and a file in the source
+mv $SRC/dir $SRC/moved
+mkdir -p $SRC/other
+mv $SRC/file $SRC/other/renamed
+
+$DSYNC_TEST_BIN --quiet --delete --detect-renames $SRC $DEST
+diff -r $SRC $DEST
+check $? "sync after moves"
+
+test ! -e $DEST/dir -a ! -e $DEST/file
+check $? "old names removed from destination"
+
+test "$(stat -c %i $DEST/moved)" = "$dir_ino"
+check $? "moved directory renamed in destination"
+
+test "$(stat -c %i $DEST/other/renamed)" = "$file_ino"
+check $? "moved file renamed in destination"
+
+# Clean up
+rm -rf $SRC $DEST
+
+exit 0
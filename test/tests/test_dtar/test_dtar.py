@@ -0,0 +1,14 @@
+#!/usr/bin/env python2
+import subprocess
+
+# change paths here for bash script as necessary
+mpifu_path     = "~/mpifileutils/test/tests/test_dtar/test_dtar.sh"
+
+# vars in bash script
+dtar_test_bin   = "/root/mpifileutils/install/bin/dtar"
+dtar_test_dir   = "/mnt/lustre"
+
+def test_dtar():
+        p = subprocess.Popen(["%s %s %s" % (mpifu_path, dtar_test_bin,
+          dtar_test_dir)], shell=True,
+          executable="/bin/bash").communicate()
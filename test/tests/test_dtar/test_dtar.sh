@@ -0,0 +1,184 @@
+#!/bin/bash
+
+##############################################################################
+# Description:
+#
+#   Round trip tests for dtar: archives that dtar creates or updates
+#   must extract to the same tree, with dtar and with tar
+#
+##############################################################################
+
+# Turn on verbose output
+#set -x
+
+DTAR_TEST_BIN=${DTAR_TEST_BIN:-${1}}
+DTAR_TEST_DIR=${DTAR_TEST_DIR:-${2}}
+
+echo "Using dtar binary at: $DTAR_TEST_BIN"
+echo "Using test directory at: $DTAR_TEST_DIR"
+
+function check()
+{
+	local result=$1
+	local msg=$2
+
+	if [ "$result" -eq 0 ]; then
+		echo "PASSED $msg"
+	else
+		echo "FAILED $msg"
+		exit 1
+	fi
+}
+
+# create a tree of directories, files of several sizes, and a symlink
+function make_tree()
+{
+	local dir=$1
+
+	mkdir -p $dir/sub/deeper
+	dd if=/dev/urandom of=$dir/big bs=1k count=3000 2>/dev/null
+	dd if=/dev/urandom of=$dir/sub/medium bs=1k count=300 2>/dev/null
+	echo "small file" > $dir/sub/deeper/small
+	touch $dir/empty
+	ln -s sub/medium $dir/link
+}
+
+# extract archive with dtar into a new directory
+function extract()
+{
+	local archive=$1
+	local dest=$2
+	shift 2
+
+	rm -rf $dest
+	mkdir -p $dest
+	$DTAR_TEST_BIN --quiet -C $dest -x -f $archive "$@"
+}
+
+# Create the source
+echo Preparing Source
+WORK=$DTAR_TEST_DIR/dtar_test
+rm -rf $WORK
+mkdir -p $WORK
+cd $WORK
+make_tree src
+
+# Compressed archives are written in frames that bzip2 and tar can read
+echo
+echo Testing --compress
+$DTAR_TEST_BIN --quiet -c -j -k 256KB -f $WORK/src.tar.bz2 src
+check $? "create compressed archive"
+
+bzip2 -t $WORK/src.tar.bz2
+check $? "compressed archive is valid bzip2"
+
+extract $WORK/src.tar.bz2 $WORK/out
+diff -r src out/src
+check $? "extract compressed archive with dtar"
+
+rm -rf $WORK/out && mkdir -p $WORK/out
+tar -C $WORK/out -xjf $WORK/src.tar.bz2
+diff -r src out/src
+check $? "extract compressed archive with tar"
+
+# Listing shows every entry without changing the archive,
+# and naming members extracts only those
+echo
+echo Testing --list and member selection
+sum_before=$(md5sum < $WORK/src.tar.bz2)
+$DTAR_TEST_BIN -t -f $WORK/src.tar.bz2 > $WORK/list.txt
+check $? "list compressed archive"
+
+for name in src/big src/sub/medium src/sub/deeper/small src/empty src/link; do
+	grep -q "$name" $WORK/list.txt
+	check $? "list shows $name"
+done
+
+test "$(md5sum < $WORK/src.tar.bz2)" = "$sum_before" -a ! -e $WORK/src.tar.bz2.dtaridx
+check $? "listing leaves archive unchanged"
+
+extract $WORK/src.tar.bz2 $WORK/out src/sub/deeper
+cmp src/sub/deeper/small out/src/sub/deeper/small
+check $? "extract selected member"
+
+test ! -e out/src/big -a ! -e out/src/sub/medium
+check $? "extract skips members not selected"
+
+# Many small files are coalesced into aggregated writes on create
+echo
+echo Testing small file coalescing
+mkdir -p src/many
+for i in $(seq 1 300); do
+	head -c $((i * 7)) /dev/urandom > src/many/file.$i
+done
+$DTAR_TEST_BIN --quiet -c -f $WORK/many.tar src
+check $? "create archive of small files"
+
+test "$(tar -tf $WORK/many.tar | grep -c '^src/many/file\.')" -eq 300
+check $? "tar lists every small file"
+
+extract $WORK/many.tar $WORK/out
+diff -r src out/src
+check $? "extract archive of small files with dtar"
+
+rm -rf $WORK/out && mkdir -p $WORK/out
+tar -C $WORK/out -xf $WORK/many.tar
+diff -r src out/src
+check $? "extract archive of small files with tar"
+
+# Archives made of several independent bzip2 streams, like those from
+# pbzip2, are decoded in parallel
+echo
+echo Testing multi-member archives
+tar -cf $WORK/plain.tar src
+rm -f $WORK/multi.tar.bz2 $WORK/part.*
+split -b 256k $WORK/plain.tar $WORK/part.
+for part in $WORK/part.*; do
+	bzip2 -c $part >> $WORK/multi.tar.bz2
+done
+rm -f $WORK/part.*
+test "$(ls -l $WORK/plain.tar | awk '{print $5}')" -gt $((3 * 256 * 1024))
+check $? "archive spans several members"
+
+extract $WORK/multi.tar.bz2 $WORK/out
+diff -r src out/src
+check $? "extract multi-member archive"
+
+# Append adds only new items, and update also adds changed items,
+# both without rewriting the entries already in the archive
+echo
+echo Testing --append and --update
+$DTAR_TEST_BIN --quiet -c -f $WORK/grow.tar src
+check $? "create archive to append to"
+
+echo "new file" > src/appended
+$DTAR_TEST_BIN --quiet -r -f $WORK/grow.tar src
+check $? "append to archive"
+
+test "$(tar -tf $WORK/grow.tar | grep -c '^src/big$')" -eq 1
+check $? "append does not add unchanged items again"
+
+extract $WORK/grow.tar $WORK/out
+diff -r src out/src
+check $? "extract appended archive"
+
+sleep 1
+echo "changed contents" > src/sub/deeper/small
+echo "another new file" > src/updated
+$DTAR_TEST_BIN --quiet -u -f $WORK/grow.tar src
+check $? "update archive"
+
+extract $WORK/grow.tar $WORK/out
+diff -r src out/src
+check $? "extract updated archive with dtar"
+
+rm -rf $WORK/out && mkdir -p $WORK/out
+tar -C $WORK/out -xf $WORK/grow.tar
+diff -r src out/src
+check $? "extract updated archive with tar"
+
+# Clean up
+cd $DTAR_TEST_DIR
+rm -rf $WORK
+
+exit 0